@@ -0,0 +1,220 @@
+/**********************************************************************
+Copyright ©2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+•	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+•	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+
+/**
+ * BatchRunner
+ * Runs samples back-to-back in one process on the shared CLRuntime, so the
+ * context, command-queues, programs and device buffers are created once for
+ * the whole batch instead of once per sample. The allocation and staging
+ * counters are printed after every sample.
+ *
+ * Usage : BatchRunner [--list] [--self-test] [--repeat N] [--keep-going]
+ *                     [Sample [options]] [+ Sample [options]] ...
+ * Without samples, every registered sample is run with -q. --self-test
+ * checks the host-side bookkeeping of the runtime without a device.
+ *
+ * "TransferProfile" is not a sample : it measures the transfer paths of the
+ * device and writes the profile the following samples transfer with, e.g.
+ *   BatchRunner TransferProfile + BlackScholes + Reduction
+ * "LaunchProfile" likewise measures the kernel launch strategies and writes
+ * the profile LaunchBatcher selects from. Both are left out of the default
+ * batch.
+ */
+
+#include "CLRuntime.hpp"
+#include "LaunchBatcher.hpp"
+#include "CLTrace.hpp"
+
+/**
+* One sample of the batch and its command line
+*/
+struct BatchItem
+{
+    std::string name;                   /**< Registered sample name */
+    std::vector<std::string> args;      /**< Options of the sample */
+};
+
+static void
+usage()
+{
+    std::cout << "Usage : BatchRunner [--list] [--self-test] [--repeat N]"
+              << " [--keep-going]"
+              << " [Sample [options]] [+ Sample [options]] ..." << std::endl;
+}
+
+int
+main(int argc, char * argv[])
+{
+    CLRuntime& runtime = CLRuntime::getInstance();
+
+    int repeat = 1;
+    bool keepGoing = false;
+    std::vector<BatchItem> batch;
+
+    int arg = 1;
+    for(; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        std::string option(argv[arg]);
+        if(option == "--list")
+        {
+            std::vector<std::string> names = runtime.sampleNames();
+            for(size_t i = 0; i < names.size(); i++)
+            {
+                std::cout << names[i] << std::endl;
+            }
+            return SDK_SUCCESS;
+        }
+        else if(option == "--self-test")
+        {
+            int status = StagingRing::selfTest();
+            std::cout << "StagingRing : "
+                      << (status == SDK_SUCCESS ? "passed" : "FAILED")
+                      << std::endl;
+            return status;
+        }
+        else if(option == "--repeat" && arg + 1 < argc)
+        {
+            repeat = atoi(argv[++arg]);
+        }
+        else if(option == "--keep-going")
+        {
+            keepGoing = true;
+        }
+        else
+        {
+            usage();
+            return SDK_FAILURE;
+        }
+    }
+
+    // Samples are separated by "+"
+    for(; arg < argc; arg++)
+    {
+        if(std::string(argv[arg]) == "+")
+        {
+            continue;
+        }
+        BatchItem item;
+        item.name = argv[arg];
+        while(arg + 1 < argc && std::string(argv[arg + 1]) != "+")
+        {
+            item.args.push_back(argv[++arg]);
+        }
+        batch.push_back(item);
+    }
+
+    if(batch.empty())
+    {
+        std::vector<std::string> names = runtime.sampleNames();
+        for(size_t i = 0; i < names.size(); i++)
+        {
+            if(names[i] == TRANSFER_PROFILE_SAMPLE ||
+                    names[i] == LAUNCH_PROFILE_SAMPLE)
+            {
+                continue;
+            }
+            BatchItem item;
+            item.name = names[i];
+            item.args.push_back("-q");
+            batch.push_back(item);
+        }
+    }
+
+    for(size_t i = 0; i < batch.size(); i++)
+    {
+        if(runtime.findSample(batch[i].name) == NULL)
+        {
+            std::cout << "Unknown sample " << batch[i].name
+                      << " (--list shows the registered ones)" << std::endl;
+            return SDK_FAILURE;
+        }
+    }
+
+    if(repeat < 1)
+    {
+        std::cout << "Error, repeat cannot be 0 or negative. Exiting.." << std::endl;
+        return SDK_FAILURE;
+    }
+
+    SDKTimer *sampleTimer = new SDKTimer();
+    int failures = 0;
+
+    for(int r = 0; r < repeat; r++)
+    {
+        for(size_t i = 0; i < batch.size(); i++)
+        {
+            // argv of the sample, argv[0] is its name
+            std::vector<std::string> args = batch[i].args;
+            args.insert(args.begin(), batch[i].name);
+            std::vector<char*> sampleArgv;
+            for(size_t j = 0; j < args.size(); j++)
+            {
+                sampleArgv.push_back(&args[j][0]);
+            }
+            sampleArgv.push_back(NULL);
+
+            std::cout << "=========== " << batch[i].name
+                      << " ===========" << std::endl;
+
+            runtime.resetRunStats();
+            CL_TRACE_SCOPE(batch[i].name);
+
+            int timer = sampleTimer->createTimer();
+            sampleTimer->resetTimer(timer);
+            sampleTimer->startTimer(timer);
+
+            int status = runtime.findSample(batch[i].name)((int)args.size(),
+                         &sampleArgv[0]);
+
+            sampleTimer->stopTimer(timer);
+            double time = sampleTimer->readTimer(timer);
+
+            // Samples return SDK_EXPECTED_FAILURE on unsupported devices
+            std::cout << batch[i].name << " : "
+                      << (status == SDK_SUCCESS ? "succeeded" :
+                          status == SDK_EXPECTED_FAILURE ? "skipped" : "FAILED")
+                      << " in " << time << " sec" << std::endl;
+
+            // Allocation and transfer counters of this run
+            runtime.printRunStats();
+
+            if(status != SDK_SUCCESS && status != SDK_EXPECTED_FAILURE)
+            {
+                failures++;
+                if(!keepGoing)
+                {
+                    runtime.releaseAll();
+                    delete sampleTimer;
+                    return SDK_FAILURE;
+                }
+            }
+        }
+    }
+
+    std::cout << std::endl;
+    runtime.printStats();
+
+    runtime.releaseAll();
+    delete sampleTimer;
+
+    if(failures)
+    {
+        std::cout << failures << " sample run(s) failed" << std::endl;
+        return SDK_FAILURE;
+    }
+    return SDK_SUCCESS;
+}
@@ -0,0 +1,763 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+
+#include "BufferPool.hpp"
+
+bool
+BufferPool::ClassKey::operator<(const ClassKey& other) const
+{
+    if(context != other.context)
+    {
+        return context < other.context;
+    }
+    if(flags != other.flags)
+    {
+        return flags < other.flags;
+    }
+    return size < other.size;
+}
+
+BufferPool::BufferPool()
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+size_t
+BufferPool::sizeClass(size_t size, size_t alignment)
+{
+    if(size <= SLAB_LIMIT)
+    {
+        // Powers of two, so every chunk of a slab stays aligned
+        size_t sizeClass = alignment > MIN_SIZE_CLASS ? alignment : MIN_SIZE_CLASS;
+        while(sizeClass < size)
+        {
+            sizeClass <<= 1;
+        }
+        return sizeClass;
+    }
+
+    // Eight classes per octave : less than 12.5% waste for large buffers
+    size_t step = 1;
+    while((step << 1) <= size)
+    {
+        step <<= 1;
+    }
+    step >>= 3;
+    return ((size + step - 1) / step) * step;
+}
+
+size_t
+BufferPool::getAlignment(cl_context context)
+{
+    std::map<cl_context, size_t>::iterator it = alignments.find(context);
+    if(it != alignments.end())
+    {
+        return it->second;
+    }
+
+    // Sub-buffer origins must be aligned for every device of the context
+    size_t alignment = MIN_SIZE_CLASS;
+    size_t devicesSize = 0;
+    if(clGetContextInfo(context, CL_CONTEXT_DEVICES, 0, NULL,
+                        &devicesSize) == CL_SUCCESS)
+    {
+        std::vector<cl_device_id> devices(devicesSize / sizeof(cl_device_id));
+        if(!devices.empty() && clGetContextInfo(context, CL_CONTEXT_DEVICES,
+                                                devicesSize, &devices[0], NULL) == CL_SUCCESS)
+        {
+            for(size_t i = 0; i < devices.size(); i++)
+            {
+                cl_uint alignBits = 0;
+                if(clGetDeviceInfo(devices[i], CL_DEVICE_MEM_BASE_ADDR_ALIGN,
+                                   sizeof(cl_uint), &alignBits, NULL) == CL_SUCCESS &&
+                        alignBits / 8 > alignment)
+                {
+                    alignment = alignBits / 8;
+                }
+            }
+        }
+    }
+
+    alignments[context] = alignment;
+    return alignment;
+}
+
+cl_mem
+BufferPool::carve(const ClassKey& key, cl_int* status)
+{
+    size_t slab = slabs.size();
+    for(size_t i = 0; i < slabs.size(); i++)
+    {
+        if(slabs[i].key.context == key.context && slabs[i].key.flags == key.flags &&
+                slabs[i].key.size == key.size)
+        {
+            slab = i;
+            break;
+        }
+    }
+
+    if(slab == slabs.size())
+    {
+        Slab newSlab;
+        newSlab.key = key;
+        newSlab.next = 0;
+        newSlab.buffer = clCreateBuffer(key.context, key.flags, SLAB_SIZE, NULL,
+                                        status);
+        if(*status != CL_SUCCESS)
+        {
+            return NULL;
+        }
+        stats.deviceAllocations++;
+        stats.deviceBytes += SLAB_SIZE;
+        parents.push_back(newSlab.buffer);
+        slabs.push_back(newSlab);
+    }
+
+    // Sub-buffers inherit the flags of the slab
+    cl_buffer_region region = {slabs[slab].next, key.size};
+    cl_mem buffer = clCreateSubBuffer(slabs[slab].buffer,
+                                      0,
+                                      CL_BUFFER_CREATE_TYPE_REGION,
+                                      &region,
+                                      status);
+    if(*status != CL_SUCCESS)
+    {
+        return NULL;
+    }
+
+    slabs[slab].next += key.size;
+    if(slabs[slab].next + key.size > SLAB_SIZE)
+    {
+        // Full, the parent stays in 'parents' until releaseAll()
+        slabs.erase(slabs.begin() + slab);
+    }
+    return buffer;
+}
+
+cl_mem
+BufferPool::allocate(cl_context context, cl_mem_flags flags, size_t size,
+                     cl_int* status)
+{
+    cl_int err = CL_SUCCESS;
+    cl_mem buffer = NULL;
+
+    lock.lock();
+
+    stats.requests++;
+    stats.requestedBytes += size;
+
+    ClassKey key;
+    key.context = context;
+    key.flags = flags;
+    key.size = sizeClass(size, getAlignment(context));
+
+    std::vector<cl_mem>& freeList = freeLists[key];
+    if(!freeList.empty())
+    {
+        buffer = freeList.back();
+        freeList.pop_back();
+        blocks[buffer].users = 1;
+        stats.reused++;
+    }
+    else
+    {
+        bool subBuffer = key.size <= SLAB_LIMIT;
+        if(subBuffer)
+        {
+            buffer = carve(key, &err);
+        }
+        else
+        {
+            buffer = clCreateBuffer(context, flags, key.size, NULL, &err);
+            if(err == CL_SUCCESS)
+            {
+                stats.deviceAllocations++;
+                stats.deviceBytes += key.size;
+            }
+        }
+
+        if(err == CL_SUCCESS)
+        {
+            Block block = {key, 1, subBuffer};
+            blocks[buffer] = block;
+        }
+    }
+
+    if(err == CL_SUCCESS)
+    {
+        stats.inUseBytes += key.size;
+        if(stats.inUseBytes > stats.peakBytes)
+        {
+            stats.peakBytes = stats.inUseBytes;
+        }
+    }
+
+    lock.unlock();
+
+    if(status != NULL)
+    {
+        *status = err;
+    }
+    return err == CL_SUCCESS ? buffer : NULL;
+}
+
+bool
+BufferPool::owns(cl_mem buffer)
+{
+    lock.lock();
+    bool found = blocks.find(buffer) != blocks.end();
+    lock.unlock();
+    return found;
+}
+
+cl_int
+BufferPool::retain(cl_mem buffer)
+{
+    cl_int status = CL_SUCCESS;
+
+    lock.lock();
+    std::map<cl_mem, Block>::iterator it = blocks.find(buffer);
+    if(it == blocks.end() || it->second.users == 0)
+    {
+        status = CL_INVALID_MEM_OBJECT;
+    }
+    else
+    {
+        it->second.users++;
+    }
+    lock.unlock();
+
+    return status;
+}
+
+cl_int
+BufferPool::release(cl_mem buffer)
+{
+    cl_int status = CL_SUCCESS;
+
+    lock.lock();
+    std::map<cl_mem, Block>::iterator it = blocks.find(buffer);
+    if(it == blocks.end() || it->second.users == 0)
+    {
+        status = CL_INVALID_MEM_OBJECT;
+    }
+    else if(--it->second.users == 0)
+    {
+        freeLists[it->second.key].push_back(buffer);
+        stats.inUseBytes -= it->second.key.size;
+    }
+    lock.unlock();
+
+    return status;
+}
+
+int
+BufferPool::releaseAll()
+{
+    cl_int status;
+
+    lock.lock();
+
+    // Sub-buffers before their slabs
+    for(std::map<cl_mem, Block>::iterator it = blocks.begin(); it != blocks.end();
+            ++it)
+    {
+        if(it->second.users != 0)
+        {
+            std::cout << "Warning : pooled buffer of " << it->second.key.size
+                      << " bytes still in use" << std::endl;
+        }
+        status = clReleaseMemObject(it->first);
+        if(status != CL_SUCCESS)
+        {
+            lock.unlock();
+            CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
+        }
+    }
+
+    for(size_t i = 0; i < parents.size(); i++)
+    {
+        status = clReleaseMemObject(parents[i]);
+        if(status != CL_SUCCESS)
+        {
+            lock.unlock();
+            CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(slab)");
+        }
+    }
+
+    blocks.clear();
+    freeLists.clear();
+    slabs.clear();
+    parents.clear();
+    alignments.clear();
+    stats.inUseBytes = 0;
+
+    lock.unlock();
+    return SDK_SUCCESS;
+}
+
+PoolStats
+BufferPool::getStats()
+{
+    lock.lock();
+    PoolStats current = stats;
+    lock.unlock();
+    return current;
+}
+
+void
+BufferPool::resetStats()
+{
+    lock.lock();
+    cl_ulong inUse = stats.inUseBytes;
+    memset(&stats, 0, sizeof(stats));
+    stats.inUseBytes = inUse;
+    stats.peakBytes = inUse;
+    lock.unlock();
+}
+
+
+/**
+* Host side copy of a staged non-blocking read
+*/
+struct StagedRead
+{
+    void* dst;              /**< Destination of the caller */
+    const void* src;        /**< Ring bytes */
+    size_t bytes;           /**< Size of the read */
+    cl_event readEvent;     /**< Device to ring transfer */
+    cl_event userEvent;     /**< Event returned to the caller */
+};
+
+/**
+* Completes a staged read : called by the OpenCL runtime once the data is
+* in the ring
+*/
+static void CL_CALLBACK
+stagedReadComplete(cl_event event, cl_int status, void* userData)
+{
+    StagedRead* read = (StagedRead*)userData;
+    if(status == CL_COMPLETE)
+    {
+        memcpy(read->dst, read->src, read->bytes);
+    }
+    clSetUserEventStatus(read->userEvent, status == CL_COMPLETE ? CL_COMPLETE :
+                         status);
+    clReleaseEvent(read->readEvent);
+    clReleaseEvent(read->userEvent);
+    delete read;
+}
+
+StagingRing::StagingRing()
+    : context(NULL), mapQueue(NULL), buffer(NULL), host(NULL), size(0), head(0)
+{
+    resetStats();
+}
+
+int
+StagingRing::create(cl_context context, cl_command_queue queue, size_t bytes)
+{
+    cl_int status;
+
+    this->context = context;
+    size = bytes;
+    head = 0;
+
+    buffer = clCreateBuffer(context,
+                            CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                            size,
+                            NULL,
+                            &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (staging)");
+
+    // Mapped once : the pointer stays valid until release()
+    host = (char*)clEnqueueMapBuffer(queue,
+                                     buffer,
+                                     CL_TRUE,
+                                     CL_MAP_READ | CL_MAP_WRITE,
+                                     0,
+                                     size,
+                                     0,
+                                     NULL,
+                                     NULL,
+                                     &status);
+    CHECK_OPENCL_ERROR(status, "clEnqueueMapBuffer failed. (staging)");
+
+    mapQueue = queue;
+    status = clRetainCommandQueue(mapQueue);
+    CHECK_OPENCL_ERROR(status, "clRetainCommandQueue failed.");
+
+    return SDK_SUCCESS;
+}
+
+size_t
+StagingRing::place(size_t size, size_t bytes, const std::deque<Span>& spans,
+                   size_t& head, size_t& retire)
+{
+    if(head + bytes > size)
+    {
+        head = 0;
+    }
+    size_t begin = head;
+    head += bytes;
+
+    /*
+     * After a wrap the spans left between the old head and the end of the
+     * ring are still at the front, so every span is checked, not only the
+     * oldest one. Spans retire in allocation order up to the newest one in
+     * the way.
+     */
+    retire = 0;
+    for(size_t i = 0; i < spans.size(); i++)
+    {
+        if(spans[i].begin < begin + bytes && spans[i].end > begin)
+        {
+            retire = i + 1;
+        }
+    }
+    return begin;
+}
+
+int
+StagingRing::reserve(size_t bytes, size_t& begin)
+{
+    cl_int status;
+    size_t retire;
+
+    bytes = ((bytes + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT) *
+            STAGING_ALIGNMENT;
+    begin = place(size, bytes, inFlight, head, retire);
+
+    for(; retire > 0; retire--)
+    {
+        Span& span = inFlight.front();
+        status = clFlush(span.queue);
+        CHECK_OPENCL_ERROR(status, "clFlush failed.");
+        status = clWaitForEvents(1, &span.event);
+        CHECK_OPENCL_ERROR(status, "clWaitForEvents failed.");
+        status = clReleaseEvent(span.event);
+        CHECK_OPENCL_ERROR(status, "clReleaseEvent failed.");
+        inFlight.pop_front();
+        stats.stalls++;
+    }
+
+    return SDK_SUCCESS;
+}
+
+int
+StagingRing::selfTest()
+{
+    /*
+     * 16 unit ring : [0,10) [10,14), the wrap retires [0,10) for [0,4),
+     * then [4,9), and the next wrap has to retire the stale [10,14) and
+     * both live spans before it can hand out [0,8)
+     */
+    const size_t ringSize = 16;
+    const size_t sizes[] = {10, 4, 4, 5, 8};
+    const size_t begins[] = {0, 10, 0, 4, 0};
+    const size_t retires[] = {0, 0, 1, 0, 3};
+
+    std::deque<Span> spans;
+    size_t head = 0;
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        size_t retire;
+        size_t begin = place(ringSize, sizes[i], spans, head, retire);
+        if(begin != begins[i] || retire != retires[i])
+        {
+            std::cout << "StagingRing : allocation " << i << " got ["
+                      << begin << "," << begin + sizes[i] << ") retiring "
+                      << retire << ", expected [" << begins[i] << ","
+                      << begins[i] + sizes[i] << ") retiring " << retires[i]
+                      << std::endl;
+            return SDK_FAILURE;
+        }
+        spans.erase(spans.begin(), spans.begin() + retire);
+
+        // No span still in flight may share a byte with the new one
+        for(size_t j = 0; j < spans.size(); j++)
+        {
+            if(spans[j].begin < begin + sizes[i] && spans[j].end > begin)
+            {
+                std::cout << "StagingRing : allocation " << i
+                          << " reuses a span in flight" << std::endl;
+                return SDK_FAILURE;
+            }
+        }
+        Span span = {begin, begin + sizes[i], NULL, NULL};
+        spans.push_back(span);
+    }
+    return SDK_SUCCESS;
+}
+
+int
+StagingRing::track(size_t begin, size_t bytes, cl_event event,
+                   cl_command_queue queue)
+{
+    Span span = {begin, begin + bytes, event, queue};
+    inFlight.push_back(span);
+    return SDK_SUCCESS;
+}
+
+cl_int
+StagingRing::write(cl_command_queue queue, cl_mem dst, cl_bool blocking,
+                   size_t offset, size_t bytes, const void* ptr,
+                   cl_uint numEvents, const cl_event* waitList,
+                   cl_event* event)
+{
+    cl_int status = CL_SUCCESS;
+
+    if(bytes == 0)
+    {
+        return clEnqueueWriteBuffer(queue, dst, blocking, offset, bytes, ptr,
+                                    numEvents, waitList, event);
+    }
+
+    lock.lock();
+
+    // Chunks of half the ring keep two transfers in flight
+    std::vector<cl_event> chunkEvents;
+    size_t chunk = size / 2;
+    for(size_t done = 0; done < bytes && status == CL_SUCCESS; done += chunk)
+    {
+        size_t n = (bytes - done < chunk) ? bytes - done : chunk;
+        size_t begin;
+        if(reserve(n, begin) != SDK_SUCCESS)
+        {
+            status = CL_OUT_OF_RESOURCES;
+            break;
+        }
+        memcpy(host + begin, (const char*)ptr + done, n);
+
+        cl_event copyEvent;
+        status = clEnqueueWriteBuffer(queue, dst, CL_FALSE, offset + done, n,
+                                      host + begin, numEvents, waitList,
+                                      &copyEvent);
+        if(status != CL_SUCCESS)
+        {
+            break;
+        }
+        track(begin, n, copyEvent, queue);
+
+        if(event != NULL)
+        {
+            status = clRetainEvent(copyEvent);
+            chunkEvents.push_back(copyEvent);
+        }
+    }
+
+    /*
+     * One chunk is its own event. Several chunks get a marker, an
+     * out-of-order queue does not order them before the last one
+     */
+    if(status == CL_SUCCESS && event != NULL)
+    {
+        if(chunkEvents.size() == 1)
+        {
+            *event = chunkEvents[0];
+            chunkEvents.clear();
+        }
+        else
+        {
+            status = clEnqueueMarkerWithWaitList(queue, (cl_uint)chunkEvents.size(),
+                                                 &chunkEvents[0], event);
+        }
+    }
+    for(size_t i = 0; i < chunkEvents.size(); i++)
+    {
+        clReleaseEvent(chunkEvents[i]);
+    }
+
+    if(status == CL_SUCCESS)
+    {
+        stats.uploads++;
+        stats.stagedBytes += bytes;
+    }
+
+    lock.unlock();
+    return status;
+}
+
+cl_int
+StagingRing::read(cl_command_queue queue, cl_mem src, cl_bool blocking,
+                  size_t offset, size_t bytes, void* ptr,
+                  cl_uint numEvents, const cl_event* waitList,
+                  cl_event* event)
+{
+    cl_int status = CL_SUCCESS;
+
+    // Without an event there is no way to tell when the copy is done
+    if(bytes == 0 || (!blocking && (event == NULL || bytes > size / 2)))
+    {
+        lock.lock();
+        stats.directBytes += bytes;
+        lock.unlock();
+        return clEnqueueReadBuffer(queue, src, blocking, offset, bytes, ptr,
+                                   numEvents, waitList, event);
+    }
+
+    lock.lock();
+
+    if(!blocking)
+    {
+        size_t begin;
+        if(reserve(bytes, begin) != SDK_SUCCESS)
+        {
+            lock.unlock();
+            return CL_OUT_OF_RESOURCES;
+        }
+
+        StagedRead* staged = new StagedRead;
+        staged->dst = ptr;
+        staged->src = host + begin;
+        staged->bytes = bytes;
+        staged->readEvent = NULL;
+        staged->userEvent = NULL;
+
+        status = clEnqueueReadBuffer(queue, src, CL_FALSE, offset, bytes,
+                                     host + begin, numEvents, waitList,
+                                     &staged->readEvent);
+        if(status == CL_SUCCESS)
+        {
+            staged->userEvent = clCreateUserEvent(context, &status);
+        }
+        if(status == CL_SUCCESS)
+        {
+            /*
+             * References : caller, ring span and callback. The callback can
+             * run and delete 'staged' before clSetEventCallback returns, so
+             * the span is tracked on a local copy of the event.
+             */
+            cl_event userEvent = staged->userEvent;
+            clRetainEvent(userEvent);
+            clRetainEvent(userEvent);
+            status = clSetEventCallback(staged->readEvent, CL_COMPLETE,
+                                        stagedReadComplete, staged);
+            if(status == CL_SUCCESS)
+            {
+                track(begin, bytes, userEvent, queue);
+                *event = userEvent;
+            }
+            else
+            {
+                clSetUserEventStatus(userEvent, status);
+                clReleaseEvent(userEvent);
+                clReleaseEvent(userEvent);
+            }
+        }
+        if(status != CL_SUCCESS)
+        {
+            // Nothing copies out of the ring, it is free once the read is done
+            if(staged->readEvent != NULL)
+            {
+                clWaitForEvents(1, &staged->readEvent);
+                clReleaseEvent(staged->readEvent);
+            }
+            if(staged->userEvent != NULL)
+            {
+                clReleaseEvent(staged->userEvent);
+            }
+            delete staged;
+        }
+    }
+    else
+    {
+        size_t chunk = size / 2;
+        for(size_t done = 0; done < bytes && status == CL_SUCCESS; done += chunk)
+        {
+            size_t n = (bytes - done < chunk) ? bytes - done : chunk;
+            size_t begin;
+            if(reserve(n, begin) != SDK_SUCCESS)
+            {
+                status = CL_OUT_OF_RESOURCES;
+                break;
+            }
+
+            bool last = (done + n == bytes);
+            status = clEnqueueReadBuffer(queue, src, CL_TRUE, offset + done, n,
+                                         host + begin, numEvents, waitList,
+                                         last ? event : NULL);
+            if(status == CL_SUCCESS)
+            {
+                memcpy((char*)ptr + done, host + begin, n);
+            }
+        }
+    }
+
+    if(status == CL_SUCCESS)
+    {
+        stats.downloads++;
+        stats.stagedBytes += bytes;
+    }
+
+    lock.unlock();
+    return status;
+}
+
+int
+StagingRing::release()
+{
+    cl_int status;
+
+    if(buffer == NULL)
+    {
+        return SDK_SUCCESS;
+    }
+
+    lock.lock();
+    while(!inFlight.empty())
+    {
+        Span& span = inFlight.front();
+        clFlush(span.queue);
+        clWaitForEvents(1, &span.event);
+        clReleaseEvent(span.event);
+        inFlight.pop_front();
+    }
+    lock.unlock();
+
+    status = clEnqueueUnmapMemObject(mapQueue, buffer, host, 0, NULL, NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueUnmapMemObject failed. (staging)");
+
+    status = clFinish(mapQueue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed.");
+
+    status = clReleaseMemObject(buffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (staging)");
+
+    status = clReleaseCommandQueue(mapQueue);
+    CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.");
+
+    buffer = NULL;
+    host = NULL;
+    mapQueue = NULL;
+    return SDK_SUCCESS;
+}
+
+StagingStats
+StagingRing::getStats()
+{
+    lock.lock();
+    StagingStats current = stats;
+    lock.unlock();
+    return current;
+}
+
+void
+StagingRing::resetStats()
+{
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,281 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+
+#ifndef BUFFER_POOL_H_
+#define BUFFER_POOL_H_
+
+/**
+ * BufferPool
+ * Size-classed pool of device buffers. Requests up to SLAB_LIMIT bytes are
+ * rounded to a power of two and carved out of SLAB_SIZE slabs as
+ * sub-buffers, larger requests get a buffer of their own rounded to an
+ * eighth of their octave. Freed buffers go back to the free list of their
+ * (context, flags, size class) and are handed out again without touching
+ * the OpenCL runtime.
+ *
+ * StagingRing
+ * Pinned host staging for uploads and downloads : a CL_MEM_ALLOC_HOST_PTR
+ * buffer kept mapped for the lifetime of the runtime and used as a ring.
+ * Writes copy the host data into the ring and return immediately, reads
+ * land in the ring and are copied out, so every transfer is a DMA from
+ * pinned memory.
+ */
+
+#include <CL/cl.h>
+#include <vector>
+#include <map>
+#include <deque>
+#include "CLUtil.hpp"
+#include "SDKThread.hpp"
+
+using namespace appsdk;
+
+#define SLAB_SIZE (16 << 20)        ///< Size of a slab of small buffers
+#define SLAB_LIMIT (1 << 20)        ///< Largest sub-allocated request
+#define MIN_SIZE_CLASS 256          ///< Smallest size class
+#define STAGING_SIZE (16 << 20)     ///< Size of a staging ring
+#define STAGING_ALIGNMENT 256       ///< Alignment of a staged transfer
+
+/**
+* Allocation counters of a pool, reset per run
+*/
+struct PoolStats
+{
+    cl_ulong requests;              /**< allocate() calls */
+    cl_ulong requestedBytes;        /**< Bytes asked for */
+    cl_ulong reused;                /**< Requests served from a free list */
+    cl_ulong deviceAllocations;     /**< clCreateBuffer calls (slabs included) */
+    cl_ulong deviceBytes;           /**< Bytes of these clCreateBuffer calls */
+    cl_ulong inUseBytes;            /**< Bytes of the buffers handed out */
+    cl_ulong peakBytes;             /**< Peak of inUseBytes */
+};
+
+/**
+* Transfer counters of the staging rings, reset per run
+*/
+struct StagingStats
+{
+    cl_ulong uploads;               /**< Staged writes */
+    cl_ulong downloads;             /**< Staged reads */
+    cl_ulong stagedBytes;           /**< Bytes through the rings */
+    cl_ulong directBytes;           /**< Bytes transferred without staging */
+    cl_ulong stalls;                /**< Waits for ring space */
+};
+
+/**
+* BufferPool
+* Thread safe size-classed device buffer pool
+*/
+class BufferPool
+{
+        /**
+        * Free list key : buffers of one list are interchangeable
+        */
+        struct ClassKey
+        {
+            cl_context context;
+            cl_mem_flags flags;
+            size_t size;
+            bool operator<(const ClassKey& other) const;
+        };
+
+        /**
+        * Buffer known to the pool
+        */
+        struct Block
+        {
+            ClassKey key;           /**< Size class of the buffer */
+            cl_uint users;          /**< References, 0 when on a free list */
+            bool subBuffer;         /**< Carved out of a slab */
+        };
+
+        /**
+        * Slab of one size class
+        */
+        struct Slab
+        {
+            ClassKey key;           /**< Size class of the chunks */
+            cl_mem buffer;          /**< Parent buffer */
+            size_t next;            /**< Offset of the first unused chunk */
+        };
+
+        std::map<cl_mem, Block> blocks;                 /**< All pooled buffers */
+        std::map<ClassKey, std::vector<cl_mem> > freeLists;
+        std::vector<Slab> slabs;                        /**< Slabs with room left */
+        std::vector<cl_mem> parents;                    /**< All slab buffers */
+        std::map<cl_context, size_t> alignments;        /**< Sub-buffer alignment */
+        PoolStats stats;
+        ThreadLock lock;
+
+        size_t getAlignment(cl_context context);
+        cl_mem carve(const ClassKey& key, cl_int* status);
+
+    public:
+        BufferPool();
+
+        /**
+        * Size class of a request
+        * @param size requested bytes
+        * @param alignment smallest class
+        */
+        static size_t sizeClass(size_t size, size_t alignment);
+
+        /**
+        * Returns a buffer of at least 'size' bytes
+        * @param context context of the buffer
+        * @param flags creation flags, no host pointer flags
+        * @param size size in bytes
+        * @param status error code
+        */
+        cl_mem allocate(cl_context context, cl_mem_flags flags, size_t size,
+                        cl_int* status);
+
+        /**
+        * Tells if the buffer comes from the pool
+        */
+        bool owns(cl_mem buffer);
+
+        /**
+        * Adds a reference to a pooled buffer
+        */
+        cl_int retain(cl_mem buffer);
+
+        /**
+        * Drops a reference, the last one puts the buffer on its free list
+        */
+        cl_int release(cl_mem buffer);
+
+        /**
+        * Releases every buffer and slab of the pool
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int releaseAll();
+
+        /**
+        * Counters since the last resetStats()
+        */
+        PoolStats getStats();
+
+        /**
+        * Starts a new run, the bytes in use are kept
+        */
+        void resetStats();
+};
+
+/**
+* StagingRing
+* Pinned staging ring of one context
+*/
+class StagingRing
+{
+        /**
+        * Ring bytes in use by an enqueued transfer
+        */
+        struct Span
+        {
+            size_t begin;               /**< First byte */
+            size_t end;                 /**< Past the last byte */
+            cl_event event;             /**< Completes when the bytes are free */
+            cl_command_queue queue;     /**< Queue to flush before waiting */
+        };
+
+        cl_context context;             /**< Context of the ring */
+        cl_command_queue mapQueue;      /**< Queue the ring was mapped with */
+        cl_mem buffer;                  /**< CL_MEM_ALLOC_HOST_PTR buffer */
+        char* host;                     /**< Persistent mapping */
+        size_t size;                    /**< Ring size */
+        size_t head;                    /**< Next free byte */
+        std::deque<Span> inFlight;      /**< Spans in allocation order */
+        StagingStats stats;
+        ThreadLock lock;
+
+        /**
+        * Places 'bytes' at the head of the ring, wrapping to the start when
+        * they do not fit before the end
+        * @param retire number of spans at the front of 'spans' to wait for
+        * before the bytes are free
+        * @return first byte of the placement
+        */
+        static size_t place(size_t size, size_t bytes,
+                            const std::deque<Span>& spans, size_t& head,
+                            size_t& retire);
+
+        int reserve(size_t bytes, size_t& begin);
+        int track(size_t begin, size_t bytes, cl_event event,
+                  cl_command_queue queue);
+
+    public:
+        StagingRing();
+
+        /**
+        * Allocates and maps the ring
+        * @param context context of the ring
+        * @param queue queue used for the mapping
+        * @param bytes ring size
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int create(cl_context context, cl_command_queue queue, size_t bytes);
+
+        /**
+        * Same as clEnqueueWriteBuffer. The data is copied into the ring
+        * before returning, a blocking write therefore does not wait for
+        * the transfer. A write larger than half the ring goes in chunks,
+        * its event is then a marker over all of them.
+        */
+        cl_int write(cl_command_queue queue, cl_mem dst, cl_bool blocking,
+                     size_t offset, size_t bytes, const void* ptr,
+                     cl_uint numEvents, const cl_event* waitList,
+                     cl_event* event);
+
+        /**
+        * Same as clEnqueueReadBuffer. A non-blocking read returns a user
+        * event completed once the data is copied out of the ring, it goes
+        * straight to 'ptr' when no event is asked for. The copy out runs in
+        * an event callback after the queue is done with the read, so the
+        * caller must wait on the returned event before touching 'ptr';
+        * clFinish on the queue is not enough.
+        */
+        cl_int read(cl_command_queue queue, cl_mem src, cl_bool blocking,
+                    size_t offset, size_t bytes, void* ptr,
+                    cl_uint numEvents, const cl_event* waitList,
+                    cl_event* event);
+
+        /**
+        * Waits for the transfers in flight, unmaps and releases the ring
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int release();
+
+        /**
+        * Counters since the last resetStats()
+        */
+        StagingStats getStats();
+
+        /**
+        * Starts a new run
+        */
+        void resetStats();
+
+        /**
+        * Checks the span placement on a small ring, including a wrap past
+        * spans still in flight
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        static int selfTest();
+};
+
+#endif  // BUFFER_POOL_H_
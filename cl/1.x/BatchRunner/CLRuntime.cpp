@@ -0,0 +1,546 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+
+#include "CLRuntime.hpp"
+
+CLRuntime::CLRuntime()
+    : contextsCreated(0), contextHits(0), queuesCreated(0), queueHits(0),
+      programsBuilt(0), programHits(0), unpooledBuffers(0)
+{
+    memset(pathBytes, 0, sizeof(pathBytes));
+}
+
+CLRuntime::~CLRuntime()
+{
+    /*
+     * Nothing is released here : the OpenCL runtime may already be unloaded
+     * at static destruction, BatchRunner calls releaseAll() before exiting
+     */
+}
+
+CLRuntime&
+CLRuntime::getInstance()
+{
+    // Constructed on first use, also from the static registrars
+    static CLRuntime runtime;
+    return runtime;
+}
+
+int
+CLRuntime::registerSample(const char* name, SampleEntry entry)
+{
+    if(findSample(name) != NULL)
+    {
+        std::cout << "Sample " << name << " registered twice" << std::endl;
+        return SDK_FAILURE;
+    }
+    samples.push_back(std::make_pair(std::string(name), entry));
+    return SDK_SUCCESS;
+}
+
+SampleEntry
+CLRuntime::findSample(const std::string& name) const
+{
+    for(size_t i = 0; i < samples.size(); i++)
+    {
+        if(samples[i].first == name)
+        {
+            return samples[i].second;
+        }
+    }
+    return NULL;
+}
+
+std::vector<std::string>
+CLRuntime::sampleNames() const
+{
+    std::vector<std::string> names;
+    for(size_t i = 0; i < samples.size(); i++)
+    {
+        names.push_back(samples[i].first);
+    }
+    return names;
+}
+
+int
+CLRuntime::getContext(CLCommandArgs* sampleArgs, cl_device_type dType,
+                      cl_platform_id& platform, cl_context& context)
+{
+    cl_int status;
+
+    /*
+     * Have a look at the available platforms and pick either
+     * the AMD one if available or a reasonable default.
+     */
+    platform = NULL;
+    int retValue = getPlatform(platform, sampleArgs->platformId,
+                               sampleArgs->isPlatformEnabled());
+    CHECK_ERROR(retValue, SDK_SUCCESS, "getPlatform() failed");
+
+    for(size_t i = 0; i < contexts.size(); i++)
+    {
+        if(contexts[i].platform == platform && contexts[i].dType == dType)
+        {
+            context = contexts[i].context;
+            status = clRetainContext(context);
+            CHECK_OPENCL_ERROR(status, "clRetainContext failed.");
+            contextHits++;
+            return SDK_SUCCESS;
+        }
+    }
+
+    // Display available devices.
+    retValue = displayDevices(platform, dType);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "displayDevices() failed");
+
+    cl_context_properties cps[3] =
+    {
+        CL_CONTEXT_PLATFORM,
+        (cl_context_properties)platform,
+        0
+    };
+
+    context = clCreateContextFromType(cps,
+                                      dType,
+                                      NULL,
+                                      NULL,
+                                      &status);
+    CHECK_OPENCL_ERROR(status, "clCreateContextFromType failed.");
+    contextsCreated++;
+
+    // One reference for the cache, one for the sample
+    ContextEntry entry = {platform, dType, context};
+    contexts.push_back(entry);
+    status = clRetainContext(context);
+    CHECK_OPENCL_ERROR(status, "clRetainContext failed.");
+
+    return SDK_SUCCESS;
+}
+
+int
+CLRuntime::getCommandQueue(cl_context context, cl_device_id device,
+                           cl_command_queue_properties prop,
+                           cl_command_queue& queue)
+{
+    cl_int status;
+
+    for(size_t i = 0; i < queues.size(); i++)
+    {
+        if(queues[i].context == context && queues[i].device == device &&
+                queues[i].prop == prop)
+        {
+            queue = queues[i].queue;
+            status = clRetainCommandQueue(queue);
+            CHECK_OPENCL_ERROR(status, "clRetainCommandQueue failed.");
+            queueHits++;
+            return SDK_SUCCESS;
+        }
+    }
+
+    queue = clCreateCommandQueue(context, device, prop, &status);
+    CHECK_OPENCL_ERROR(status, "clCreateCommandQueue failed.");
+    queuesCreated++;
+
+    QueueEntry entry = {context, device, prop, queue};
+    queues.push_back(entry);
+    status = clRetainCommandQueue(queue);
+    CHECK_OPENCL_ERROR(status, "clRetainCommandQueue failed.");
+
+    return SDK_SUCCESS;
+}
+
+int
+CLRuntime::getProgram(cl_context context, const buildProgramData& buildData,
+                      cl_program& program)
+{
+    cl_int status;
+
+    // Everything buildOpenCLProgram() depends on
+    std::ostringstream key;
+    key << context << '|' << buildData.devices[buildData.deviceId] << '|'
+        << buildData.kernelName << '|' << buildData.flagsStr << '|'
+        << buildData.flagsFileName << '|' << buildData.binaryName;
+
+    std::map<std::string, cl_program>::iterator it = programs.find(key.str());
+    if(it != programs.end())
+    {
+        program = it->second;
+        status = clRetainProgram(program);
+        CHECK_OPENCL_ERROR(status, "clRetainProgram failed.");
+        programHits++;
+        return SDK_SUCCESS;
+    }
+
+    int retValue = buildOpenCLProgram(program, context, buildData);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "buildOpenCLProgram() failed");
+    programsBuilt++;
+
+    programs[key.str()] = program;
+    status = clRetainProgram(program);
+    CHECK_OPENCL_ERROR(status, "clRetainProgram failed.");
+
+    return SDK_SUCCESS;
+}
+
+cl_mem
+CLRuntime::createBuffer(cl_context context, cl_mem_flags flags, size_t size,
+                        void* hostPtr, cl_int* status)
+{
+    // The contents of these buffers come from the host pointer
+    if(flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR))
+    {
+        unpooledBuffers++;
+        return clCreateBuffer(context, flags, size, hostPtr, status);
+    }
+
+    return pool.allocate(context, flags, size, status);
+}
+
+cl_int
+CLRuntime::retainBuffer(cl_mem buffer)
+{
+    if(pool.owns(buffer))
+    {
+        return pool.retain(buffer);
+    }
+    return clRetainMemObject(buffer);
+}
+
+cl_int
+CLRuntime::releaseBuffer(cl_mem buffer)
+{
+    if(pool.owns(buffer))
+    {
+        return pool.release(buffer);
+    }
+
+    // Not pooled
+    return clReleaseMemObject(buffer);
+}
+
+StagingRing*
+CLRuntime::getStagingRing(cl_command_queue queue)
+{
+    cl_context context;
+    if(clGetCommandQueueInfo(queue, CL_QUEUE_CONTEXT, sizeof(cl_context),
+                             &context, NULL) != CL_SUCCESS)
+    {
+        return NULL;
+    }
+
+    // Sample threads transfer concurrently
+    transferLock.lock();
+    std::map<cl_context, StagingRing*>::iterator it = rings.find(context);
+    if(it != rings.end())
+    {
+        StagingRing* ring = it->second;
+        transferLock.unlock();
+        return ring;
+    }
+
+    StagingRing* ring = new StagingRing;
+    if(ring->create(context, queue, STAGING_SIZE) != SDK_SUCCESS)
+    {
+        delete ring;
+        ring = NULL;
+    }
+    else
+    {
+        rings[context] = ring;
+    }
+    transferLock.unlock();
+    return ring;
+}
+
+TransferProfile*
+CLRuntime::getProfile(cl_command_queue queue)
+{
+    cl_device_id device;
+    if(clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id),
+                             &device, NULL) != CL_SUCCESS)
+    {
+        return NULL;
+    }
+
+    transferLock.lock();
+    std::map<cl_device_id, TransferProfile*>::iterator it = profiles.find(
+                device);
+    if(it != profiles.end())
+    {
+        TransferProfile* profile = it->second;
+        transferLock.unlock();
+        return profile;
+    }
+
+    // Looked up once, a device without a profile keeps an empty one
+    TransferProfile* profile = new TransferProfile;
+    std::string file = TransferProfile::fileName(device);
+    if(profile->load(file) == SDK_SUCCESS)
+    {
+        std::cout << "Transfers use " << file << std::endl;
+    }
+    profiles[device] = profile;
+    transferLock.unlock();
+    return profile;
+}
+
+int
+CLRuntime::profileTransfers(cl_command_queue queue, const TransferSweep& sweep)
+{
+    cl_device_id device;
+    cl_int status = clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE,
+                                          sizeof(cl_device_id), &device, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetCommandQueueInfo failed.");
+
+    TransferProfile* profile = new TransferProfile;
+    int retValue = profile->measure(queue, getStagingRing(queue), sweep);
+    if(retValue == SDK_SUCCESS)
+    {
+        retValue = profile->save(TransferProfile::fileName(device));
+    }
+    if(retValue != SDK_SUCCESS)
+    {
+        delete profile;
+        CHECK_ERROR(retValue, SDK_SUCCESS, "TransferProfile::measure() failed");
+    }
+
+    transferLock.lock();
+    std::map<cl_device_id, TransferProfile*>::iterator it = profiles.find(
+                device);
+    if(it != profiles.end())
+    {
+        delete it->second;
+    }
+    profiles[device] = profile;
+    transferLock.unlock();
+    return SDK_SUCCESS;
+}
+
+const TransferProfile*
+CLRuntime::getTransferProfile(cl_command_queue queue)
+{
+    return getProfile(queue);
+}
+
+cl_int
+CLRuntime::writeBuffer(cl_command_queue queue, cl_mem buffer,
+                       cl_bool blocking, size_t offset, size_t size,
+                       const void* ptr, cl_uint numEvents,
+                       const cl_event* waitList, cl_event* event)
+{
+    TransferProfile* profile = getProfile(queue);
+    TransferPath path = profile ? profile->selectUpload(size) : PATH_STAGED;
+    StagingRing* ring = getStagingRing(queue);
+
+    cl_int status = TransferProfile::upload(path, ring, queue, buffer, blocking,
+                                            offset, size, ptr, numEvents,
+                                            waitList, event);
+
+    // Buffers the path cannot handle, e.g. CL_MEM_HOST_NO_ACCESS ones
+    if(status != CL_SUCCESS && path != PATH_STAGED)
+    {
+        path = PATH_STAGED;
+        status = TransferProfile::upload(path, ring, queue, buffer, blocking,
+                                         offset, size, ptr, numEvents, waitList,
+                                         event);
+    }
+    if(status == CL_SUCCESS)
+    {
+        transferLock.lock();
+        pathBytes[path] += size;
+        transferLock.unlock();
+    }
+    return status;
+}
+
+cl_int
+CLRuntime::readBuffer(cl_command_queue queue, cl_mem buffer,
+                      cl_bool blocking, size_t offset, size_t size,
+                      void* ptr, cl_uint numEvents,
+                      const cl_event* waitList, cl_event* event)
+{
+    TransferProfile* profile = getProfile(queue);
+    TransferPath path = profile ? profile->selectDownload(size) : PATH_STAGED;
+    StagingRing* ring = getStagingRing(queue);
+
+    cl_int status = TransferProfile::download(path, ring, queue, buffer,
+                    blocking, offset, size, ptr,
+                    numEvents, waitList, event);
+    if(status != CL_SUCCESS && path != PATH_STAGED)
+    {
+        path = PATH_STAGED;
+        status = TransferProfile::download(path, ring, queue, buffer, blocking,
+                                           offset, size, ptr, numEvents,
+                                           waitList, event);
+    }
+    if(status == CL_SUCCESS)
+    {
+        transferLock.lock();
+        pathBytes[path] += size;
+        transferLock.unlock();
+    }
+    return status;
+}
+
+int
+CLRuntime::releaseAll()
+{
+    cl_int status;
+
+    // Staging rings are unmapped with queues of the cache
+    transferLock.lock();
+    for(std::map<cl_context, StagingRing*>::iterator it = rings.begin();
+            it != rings.end(); ++it)
+    {
+        int retValue = it->second->release();
+        delete it->second;
+        if(retValue != SDK_SUCCESS)
+        {
+            rings.erase(rings.begin(), ++it);
+            transferLock.unlock();
+            CHECK_ERROR(retValue, SDK_SUCCESS, "StagingRing::release() failed");
+        }
+    }
+    rings.clear();
+
+    for(std::map<cl_device_id, TransferProfile*>::iterator it = profiles.begin();
+            it != profiles.end(); ++it)
+    {
+        delete it->second;
+    }
+    profiles.clear();
+    transferLock.unlock();
+
+    int retValue = pool.releaseAll();
+    CHECK_ERROR(retValue, SDK_SUCCESS, "BufferPool::releaseAll() failed");
+
+    for(std::map<std::string, cl_program>::iterator it = programs.begin();
+            it != programs.end(); ++it)
+    {
+        status = clReleaseProgram(it->second);
+        CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.");
+    }
+    programs.clear();
+
+    for(size_t i = 0; i < queues.size(); i++)
+    {
+        status = clReleaseCommandQueue(queues[i].queue);
+        CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.");
+    }
+    queues.clear();
+
+    for(size_t i = 0; i < contexts.size(); i++)
+    {
+        status = clReleaseContext(contexts[i].context);
+        CHECK_OPENCL_ERROR(status, "clReleaseContext failed.");
+    }
+    contexts.clear();
+
+    return SDK_SUCCESS;
+}
+
+void
+CLRuntime::printStats() const
+{
+    std::string strArray[4] =
+    {
+        "Contexts (created/cached)",
+        "Queues (created/cached)",
+        "Programs (built/cached)",
+        "Unpooled buffers"
+    };
+    std::string stats[4];
+
+    stats[0] = toString(contextsCreated, std::dec) + "/" + toString(contextHits,
+               std::dec);
+    stats[1] = toString(queuesCreated, std::dec) + "/" + toString(queueHits,
+               std::dec);
+    stats[2] = toString(programsBuilt, std::dec) + "/" + toString(programHits,
+               std::dec);
+    stats[3] = toString(unpooledBuffers, std::dec);
+
+    printStatistics(strArray, stats, 4);
+}
+
+void
+CLRuntime::resetRunStats()
+{
+    transferLock.lock();
+    memset(pathBytes, 0, sizeof(pathBytes));
+    pool.resetStats();
+    for(std::map<cl_context, StagingRing*>::iterator it = rings.begin();
+            it != rings.end(); ++it)
+    {
+        it->second->resetStats();
+    }
+    transferLock.unlock();
+}
+
+void
+CLRuntime::printRunStats()
+{
+    PoolStats poolStats = pool.getStats();
+
+    StagingStats staging;
+    memset(&staging, 0, sizeof(staging));
+    transferLock.lock();
+    for(std::map<cl_context, StagingRing*>::iterator it = rings.begin();
+            it != rings.end(); ++it)
+    {
+        StagingStats ringStats = it->second->getStats();
+        staging.uploads += ringStats.uploads;
+        staging.downloads += ringStats.downloads;
+        staging.stagedBytes += ringStats.stagedBytes;
+        staging.directBytes += ringStats.directBytes;
+        staging.stalls += ringStats.stalls;
+    }
+    cl_ulong bytesPerPath[NUM_TRANSFER_PATHS];
+    memcpy(bytesPerPath, pathBytes, sizeof(bytesPerPath));
+    transferLock.unlock();
+
+    std::string strArray[9] =
+    {
+        "Allocations",
+        "Bytes requested",
+        "Reused",
+        "clCreateBuffer",
+        "Bytes allocated",
+        "Peak bytes",
+        "Staged transfers",
+        "Staged/direct bytes",
+        "Bytes per path"
+    };
+    std::string stats[9];
+
+    stats[0] = toString(poolStats.requests, std::dec);
+    stats[1] = toString(poolStats.requestedBytes, std::dec);
+    stats[2] = toString(poolStats.reused, std::dec);
+    stats[3] = toString(poolStats.deviceAllocations, std::dec);
+    stats[4] = toString(poolStats.deviceBytes, std::dec);
+    stats[5] = toString(poolStats.peakBytes, std::dec);
+    stats[6] = toString(staging.uploads + staging.downloads, std::dec);
+    stats[7] = toString(staging.stagedBytes, std::dec) + "/" + toString(
+                   staging.directBytes, std::dec);
+
+    // direct/staged/mapped/hostptr/persistent
+    for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+    {
+        stats[8] += (p ? "/" : "") + toString(bytesPerPath[p], std::dec);
+    }
+
+    printStatistics(strArray, stats, 9);
+}
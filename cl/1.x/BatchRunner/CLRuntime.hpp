@@ -0,0 +1,285 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+
+#ifndef CL_RUNTIME_H_
+#define CL_RUNTIME_H_
+
+/**
+ * CLRuntime
+ * Process wide OpenCL runtime shared by the samples built into BatchRunner.
+ * Platform, context, command-queue and program handles are created on first
+ * use and cached, device buffers are reference counted and recycled through
+ * a size-classed pool and host transfers take the fastest path measured
+ * for the device and size (TransferProfile), pinned staging rings when the
+ * device has no profile.
+ * A sample gets retained handles, so its own clRelease* calls in cleanup()
+ * stay balanced and the objects outlive the sample.
+ */
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <sstream>
+#include "CLUtil.hpp"
+#include "BufferPool.hpp"
+#include "TransferProfile.hpp"
+
+using namespace appsdk;
+
+/**
+* SampleEntry
+* Entry point of a sample registered with the runtime : the former main()
+* of the sample, called with the sample's own command line.
+*/
+typedef int (*SampleEntry)(int argc, char* argv[]);
+
+/**
+* CLRuntime
+* Singleton holding the cached OpenCL objects and the sample registry
+*/
+class CLRuntime
+{
+        /**
+        * Cached context of a (platform, device type) pair
+        */
+        struct ContextEntry
+        {
+            cl_platform_id platform;        /**< Platform of the context */
+            cl_device_type dType;           /**< Device type of the context */
+            cl_context context;             /**< Context */
+        };
+
+        /**
+        * Cached command-queue of a (context, device, properties) tuple
+        */
+        struct QueueEntry
+        {
+            cl_context context;                     /**< Context of the queue */
+            cl_device_id device;                    /**< Device of the queue */
+            cl_command_queue_properties prop;       /**< Queue properties */
+            cl_command_queue queue;                 /**< Command-queue */
+        };
+
+        std::vector<ContextEntry> contexts;         /**< Cached contexts */
+        std::vector<QueueEntry> queues;             /**< Cached command-queues */
+        std::map<std::string, cl_program> programs; /**< Built programs by key */
+        BufferPool pool;                            /**< Device buffers */
+        std::map<cl_context, StagingRing*> rings;   /**< Staging per context */
+        std::map<cl_device_id, TransferProfile*>
+        profiles;                                   /**< Loaded per device */
+        ThreadLock transferLock;    /**< Guards rings, profiles, pathBytes */
+        std::vector<std::pair<std::string, SampleEntry> >
+        samples;                                    /**< Registered samples */
+
+        cl_uint contextsCreated;        /**< clCreateContextFromType calls */
+        cl_uint contextHits;            /**< Contexts served from the cache */
+        cl_uint queuesCreated;          /**< clCreateCommandQueue calls */
+        cl_uint queueHits;              /**< Queues served from the cache */
+        cl_uint programsBuilt;          /**< buildOpenCLProgram calls */
+        cl_uint programHits;            /**< Programs served from the cache */
+        cl_uint unpooledBuffers;        /**< Buffers with a host pointer */
+        cl_ulong pathBytes[NUM_TRANSFER_PATHS];  /**< Bytes per path of the run */
+
+        StagingRing* getStagingRing(cl_command_queue queue);
+        TransferProfile* getProfile(cl_command_queue queue);
+
+        CLRuntime();
+        ~CLRuntime();
+        CLRuntime(const CLRuntime&);
+        CLRuntime& operator=(const CLRuntime&);
+
+    public:
+
+        /**
+        * Returns the process wide runtime
+        */
+        static CLRuntime& getInstance();
+
+        /**
+        * Registers a sample entry point, see REGISTER_SAMPLE
+        * @param name name the sample is run by
+        * @param entry former main() of the sample
+        * @return SDK_SUCCESS on success and SDK_FAILURE on a duplicate name
+        */
+        int registerSample(const char* name, SampleEntry entry);
+
+        /**
+        * Finds a registered sample
+        * @param name name of the sample
+        * @return entry point, NULL if not registered
+        */
+        SampleEntry findSample(const std::string& name) const;
+
+        /**
+        * Names of the registered samples in registration order
+        */
+        std::vector<std::string> sampleNames() const;
+
+        /**
+        * Returns the context of the platform selected by the command line and
+        * of the given device type, creating it on first use
+        * @param sampleArgs command line of the sample (platformId)
+        * @param dType device type
+        * @param platform selected platform
+        * @param context retained context, released by the sample
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int getContext(CLCommandArgs* sampleArgs, cl_device_type dType,
+                       cl_platform_id& platform, cl_context& context);
+
+        /**
+        * Returns an in-order command-queue, creating it on first use
+        * @param context context of the queue
+        * @param device device of the queue
+        * @param prop queue properties
+        * @param queue retained command-queue, released by the sample
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int getCommandQueue(cl_context context, cl_device_id device,
+                            cl_command_queue_properties prop,
+                            cl_command_queue& queue);
+
+        /**
+        * Returns the program of a kernel file built with the given options,
+        * building it on first use
+        * @param context context of the program
+        * @param buildData same as for buildOpenCLProgram()
+        * @param program retained program, released by the sample
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int getProgram(cl_context context, const buildProgramData& buildData,
+                       cl_program& program);
+
+        /**
+        * Returns a buffer of at least 'size' bytes from the pool. Buffers
+        * initialised from a host pointer are never pooled.
+        * @param context context of the buffer
+        * @param flags creation flags
+        * @param size size in bytes
+        * @param hostPtr host pointer for CL_MEM_USE/COPY_HOST_PTR
+        * @param status error code
+        * @return buffer, to be given back with releaseBuffer()
+        */
+        cl_mem createBuffer(cl_context context, cl_mem_flags flags, size_t size,
+                            void* hostPtr, cl_int* status);
+
+        /**
+        * Adds a reference to a pooled buffer
+        * @param buffer buffer from createBuffer()
+        */
+        cl_int retainBuffer(cl_mem buffer);
+
+        /**
+        * Drops a reference, the last one returns the buffer to the pool
+        * @param buffer buffer from createBuffer()
+        */
+        cl_int releaseBuffer(cl_mem buffer);
+
+        /**
+        * Same as clEnqueueWriteBuffer, through the fastest upload path of
+        * the device for this size
+        */
+        cl_int writeBuffer(cl_command_queue queue, cl_mem buffer,
+                           cl_bool blocking, size_t offset, size_t size,
+                           const void* ptr, cl_uint numEvents,
+                           const cl_event* waitList, cl_event* event);
+
+        /**
+        * Same as clEnqueueReadBuffer, through the fastest download path of
+        * the device for this size. Non-blocking reads may complete through
+        * a host copy after the queue finishes: wait on 'event' before
+        * using 'ptr', clFinish alone does not cover it.
+        */
+        cl_int readBuffer(cl_command_queue queue, cl_mem buffer,
+                          cl_bool blocking, size_t offset, size_t size,
+                          void* ptr, cl_uint numEvents,
+                          const cl_event* waitList, cl_event* event);
+
+        /**
+        * Measures the transfer paths of the device of the queue, writes its
+        * profile and uses it for the following transfers
+        * @param queue queue of the device
+        * @param sweep sizes and iterations
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int profileTransfers(cl_command_queue queue, const TransferSweep& sweep);
+
+        /**
+        * Transfer profile of the device of the queue, loaded on first use.
+        * Empty when the device has not been profiled.
+        */
+        const TransferProfile* getTransferProfile(cl_command_queue queue);
+
+        /**
+        * Releases every cached object. Handles still held by samples stay
+        * valid until they release them.
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int releaseAll();
+
+        /**
+        * Prints the cache counters
+        */
+        void printStats() const;
+
+        /**
+        * Starts the allocation and transfer counters of a new run
+        */
+        void resetRunStats();
+
+        /**
+        * Prints the allocation and transfer counters of the run
+        */
+        void printRunStats();
+};
+
+/**
+* SampleRegistrar
+* Registers a sample with the runtime during static initialisation
+*/
+class SampleRegistrar
+{
+    public:
+        SampleRegistrar(const char* name, SampleEntry entry)
+        {
+            CLRuntime::getInstance().registerSample(name, entry);
+        }
+};
+
+/**
+* Registers 'entry' as the sample 'name' of BatchRunner
+*/
+#define REGISTER_SAMPLE(name, entry) \
+    static SampleRegistrar entry##Registrar(name, entry)
+
+/**
+* Buffer calls of the samples built into BatchRunner: pooled buffers and
+* staged transfers. Standalone builds map them to the plain OpenCL calls.
+*/
+#define CREATE_BUFFER(context, flags, size, hostPtr, status) \
+    CLRuntime::getInstance().createBuffer(context, flags, size, hostPtr, status)
+#define RELEASE_BUFFER(buffer) CLRuntime::getInstance().releaseBuffer(buffer)
+#define WRITE_BUFFER(queue, buffer, blocking, offset, size, ptr, n, list, event) \
+    CLRuntime::getInstance().writeBuffer(queue, buffer, blocking, offset, size, \
+                                         ptr, n, list, event)
+#define READ_BUFFER(queue, buffer, blocking, offset, size, ptr, n, list, event) \
+    CLRuntime::getInstance().readBuffer(queue, buffer, blocking, offset, size, \
+                                        ptr, n, list, event)
+
+#endif  // CL_RUNTIME_H_
@@ -0,0 +1,955 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef CL_TRACE_H_
+#define CL_TRACE_H_
+
+/**
+ * CLTrace
+ * Timeline of every OpenCL command of a sample, written as a Chrome trace
+ * (chrome://tracing or ui.perfetto.dev). With CL_TRACE defined and this
+ * header force-included in front of the sample (the CL_TRACE CMake option
+ * does both) the clEnqueue* calls are routed through wrappers that keep
+ * the event of every command, queues are created with profiling enabled
+ * and a completion callback collects the queued, submit, start and end
+ * times of the command. Blocking calls, program builds and CL_TRACE_SCOPE
+ * phases go to the host row, device times are moved to the host clock
+ * through the queued time of the first command of each device.
+ *
+ * The trace is written at exit to $CL_TRACE_FILE, cl_trace.json when not
+ * set. Without CL_TRACE only an empty CL_TRACE_SCOPE is defined.
+ */
+
+#ifdef CL_TRACE
+
+#include <CL/cl.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include "SDKThread.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define CL_TRACE_DEFAULT_FILE "cl_trace.json"   ///< Used when CL_TRACE_FILE is not set
+#define CL_TRACE_MAX_COMMANDS 1000000           ///< Commands beyond are counted, not kept
+
+/**
+* Host clock in ns
+*/
+inline cl_ulong clTraceHostTime()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (cl_ulong)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec s;
+    clock_gettime(CLOCK_MONOTONIC, &s);
+    return (cl_ulong)s.tv_sec * 1000000000 + (cl_ulong)s.tv_nsec;
+#endif
+}
+
+/**
+* CLTrace
+* Process wide recorder of OpenCL commands and host phases
+*/
+class CLTrace
+{
+        /**
+        * Enqueued command, device times filled by the completion callback
+        */
+        struct Command
+        {
+            std::string name;
+            const char* category;
+            cl_command_queue queue;
+            size_t bytes;               /**< Bytes moved, 0 for kernels */
+            size_t items;               /**< Work-items of a kernel */
+            cl_ulong hostEnqueue;       /**< Host clock before the enqueue */
+            cl_ulong queued;
+            cl_ulong submit;
+            cl_ulong start;
+            cl_ulong end;
+            bool complete;              /**< Profiling available */
+        };
+
+        /**
+        * Host phase or blocking call, host clock
+        */
+        struct HostSpan
+        {
+            std::string name;
+            const char* category;
+            cl_ulong start;
+            cl_ulong end;
+        };
+
+        /**
+        * One process row of the trace per device
+        */
+        struct Device
+        {
+            cl_uint pid;
+            std::string name;
+            bool hasOffset;
+            cl_ulong offset;            /**< Device clock - host clock */
+            cl_uint queues;             /**< Queues seen so far */
+        };
+
+        /**
+        * One thread row per queue
+        */
+        struct Lane
+        {
+            cl_device_id device;
+            cl_uint tid;
+        };
+
+        appsdk::ThreadLock lock;
+        std::vector<Command*> commands;
+        std::vector<HostSpan> spans;
+        std::map<cl_device_id, Device> devices;
+        std::map<cl_command_queue, Lane> lanes;
+        std::map<cl_kernel, std::string> kernelNames;
+        cl_ulong dropped;               /**< Commands past CL_TRACE_MAX_COMMANDS */
+
+        CLTrace() : dropped(0)
+        {
+        }
+
+        static CLTrace* create()
+        {
+            CLTrace* trace = new CLTrace;
+            atexit(writeAtExit);
+            return trace;
+        }
+
+        static void writeAtExit()
+        {
+            const char* fileName = getenv("CL_TRACE_FILE");
+            getInstance().write(fileName ? fileName : CL_TRACE_DEFAULT_FILE);
+        }
+
+        /**
+        * Row of a queue, the caller holds the lock
+        */
+        Lane& getLane(cl_command_queue queue)
+        {
+            std::map<cl_command_queue, Lane>::iterator it = lanes.find(queue);
+            if(it != lanes.end())
+            {
+                return it->second;
+            }
+
+            cl_device_id device = NULL;
+            clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(device), &device,
+                                  NULL);
+            if(devices.find(device) == devices.end())
+            {
+                Device info;
+                info.pid = (cl_uint)devices.size() + 1;
+                info.hasOffset = false;
+                info.offset = 0;
+                info.queues = 0;
+                char name[256] = "";
+                clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+                info.name = name;
+                devices[device] = info;
+            }
+
+            Lane lane;
+            lane.device = device;
+            lane.tid = devices[device].queues++;
+            lanes[queue] = lane;
+            return lanes[queue];
+        }
+
+        static void CL_CALLBACK complete(cl_event event, cl_int status,
+                                         void* data)
+        {
+            Command* command = (Command*)data;
+            cl_ulong times[4];
+            const cl_profiling_info info[4] =
+            {
+                CL_PROFILING_COMMAND_QUEUED, CL_PROFILING_COMMAND_SUBMIT,
+                CL_PROFILING_COMMAND_START, CL_PROFILING_COMMAND_END
+            };
+            bool valid = status == CL_COMPLETE;
+            for(int i = 0; i < 4 && valid; i++)
+            {
+                valid = clGetEventProfilingInfo(event, info[i], sizeof(cl_ulong),
+                                                &times[i], NULL) == CL_SUCCESS;
+            }
+            clReleaseEvent(event);
+
+            CLTrace& trace = getInstance();
+            trace.lock.lock();
+            if(valid)
+            {
+                command->queued = times[0];
+                command->submit = times[1];
+                command->start = times[2];
+                command->end = times[3];
+                command->complete = true;
+
+                Device& device = trace.devices[trace.getLane(command->queue).device];
+                if(!device.hasOffset)
+                {
+                    device.offset = command->queued - command->hostEnqueue;
+                    device.hasOffset = true;
+                }
+            }
+            trace.lock.unlock();
+        }
+
+        static void writeString(std::ofstream& file, const std::string& text)
+        {
+            file << '"';
+            for(size_t i = 0; i < text.size(); i++)
+            {
+                if(text[i] == '"' || text[i] == '\\')
+                {
+                    file << '\\';
+                }
+                file << text[i];
+            }
+            file << '"';
+        }
+
+    public:
+        static CLTrace& getInstance()
+        {
+            static CLTrace* instance = create();
+            return *instance;
+        }
+
+        /**
+        * Records an enqueued command
+        * @param queue queue of the command
+        * @param event event returned by the enqueue
+        * @param userEvent event pointer given by the sample, may be NULL
+        */
+        void command(cl_command_queue queue, cl_event event, cl_event* userEvent,
+                     const char* category, const std::string& name, size_t bytes,
+                     size_t items, cl_ulong hostEnqueue)
+        {
+            // The sample gets the event, the trace keeps a reference
+            if(userEvent)
+            {
+                *userEvent = event;
+                clRetainEvent(event);
+            }
+
+            lock.lock();
+            if(commands.size() >= CL_TRACE_MAX_COMMANDS)
+            {
+                dropped++;
+                lock.unlock();
+                clReleaseEvent(event);
+                return;
+            }
+
+            Command* command = new Command;
+            command->name = name;
+            command->category = category;
+            command->queue = queue;
+            command->bytes = bytes;
+            command->items = items;
+            command->hostEnqueue = hostEnqueue;
+            command->queued = command->submit = command->start = command->end = 0;
+            command->complete = false;
+            commands.push_back(command);
+            getLane(queue);
+            lock.unlock();
+
+            if(clSetEventCallback(event, CL_COMPLETE, complete, command) != CL_SUCCESS)
+            {
+                clReleaseEvent(event);
+            }
+        }
+
+        /**
+        * Records a host phase or blocking call
+        */
+        void hostSpan(const std::string& name, const char* category,
+                      cl_ulong start, cl_ulong end)
+        {
+            HostSpan span;
+            span.name = name;
+            span.category = category;
+            span.start = start;
+            span.end = end;
+
+            lock.lock();
+            spans.push_back(span);
+            lock.unlock();
+        }
+
+        /**
+        * Function name of a kernel, cached
+        */
+        std::string kernelName(cl_kernel kernel)
+        {
+            lock.lock();
+            std::map<cl_kernel, std::string>::iterator it = kernelNames.find(kernel);
+            if(it != kernelNames.end())
+            {
+                std::string name = it->second;
+                lock.unlock();
+                return name;
+            }
+            lock.unlock();
+
+            char name[256] = "kernel";
+            clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name) - 1, name,
+                            NULL);
+
+            lock.lock();
+            kernelNames[kernel] = name;
+            lock.unlock();
+            return name;
+        }
+
+        /**
+        * Writes the completed commands and the host spans
+        * @param fileName JSON file
+        */
+        void write(const std::string& fileName)
+        {
+            lock.lock();
+
+            std::ofstream file(fileName.c_str());
+            if(!file)
+            {
+                std::cout << "CLTrace : cannot open " << fileName << std::endl;
+                lock.unlock();
+                return;
+            }
+
+            // Time 0 of the trace is the first host event
+            cl_ulong origin = 0;
+            bool first = true;
+            for(size_t i = 0; i < spans.size(); i++)
+            {
+                if(first || spans[i].start < origin)
+                {
+                    origin = spans[i].start;
+                    first = false;
+                }
+            }
+            for(size_t i = 0; i < commands.size(); i++)
+            {
+                if(first || commands[i]->hostEnqueue < origin)
+                {
+                    origin = commands[i]->hostEnqueue;
+                    first = false;
+                }
+            }
+
+            file.setf(std::ios::fixed);
+            file.precision(3);
+            file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::endl;
+            file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+                 << "\"args\":{\"name\":\"Host\"}}";
+
+            for(std::map<cl_device_id, Device>::iterator it = devices.begin();
+                    it != devices.end(); it++)
+            {
+                file << "," << std::endl << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":"
+                     << it->second.pid << ",\"args\":{\"name\":";
+                writeString(file, it->second.name);
+                file << "}}";
+            }
+            for(std::map<cl_command_queue, Lane>::iterator it = lanes.begin();
+                    it != lanes.end(); it++)
+            {
+                file << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"
+                     << devices[it->second.device].pid << ",\"tid\":" << it->second.tid
+                     << ",\"args\":{\"name\":\"Queue " << it->second.tid << "\"}}";
+            }
+
+            for(size_t i = 0; i < spans.size(); i++)
+            {
+                file << "," << std::endl << "{\"name\":";
+                writeString(file, spans[i].name);
+                file << ",\"cat\":\"" << spans[i].category
+                     << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+                     << (spans[i].start - origin) / 1e3 << ",\"dur\":"
+                     << (spans[i].end - spans[i].start) / 1e3 << "}";
+            }
+
+            size_t written = 0;
+            for(size_t i = 0; i < commands.size(); i++)
+            {
+                const Command& command = *commands[i];
+                if(!command.complete)
+                {
+                    continue;
+                }
+                const Lane& lane = lanes[command.queue];
+                const Device& device = devices[lane.device];
+                cl_ulong start = command.start - device.offset;
+
+                file << "," << std::endl << "{\"name\":";
+                writeString(file, command.name);
+                file << ",\"cat\":\"" << command.category
+                     << "\",\"ph\":\"X\",\"pid\":" << device.pid << ",\"tid\":"
+                     << lane.tid << ",\"ts\":" << (start - origin) / 1e3
+                     << ",\"dur\":" << (command.end - command.start) / 1e3
+                     << ",\"args\":{\"queued_to_start_us\":"
+                     << (cl_long)(command.start - command.queued) / 1e3
+                     << ",\"submit_to_start_us\":"
+                     << (cl_long)(command.start - command.submit) / 1e3;
+                if(command.bytes)
+                {
+                    file << ",\"bytes\":" << command.bytes;
+                }
+                if(command.items)
+                {
+                    file << ",\"work_items\":" << command.items;
+                }
+                file << "}}";
+                written++;
+            }
+            file << std::endl << "]}" << std::endl;
+
+            std::cout << "CLTrace : " << written << " commands and " << spans.size()
+                      << " host spans written to " << fileName;
+            if(written < commands.size() || dropped)
+            {
+                std::cout << " (" << commands.size() - written + dropped
+                          << " without profiling or over the limit)";
+            }
+            std::cout << std::endl;
+
+            lock.unlock();
+        }
+};
+
+/**
+* Host phase lasting for the scope of the object
+*/
+class CLTraceScope
+{
+        std::string name;
+        const char* category;
+        cl_ulong start;
+
+    public:
+        CLTraceScope(const std::string& name, const char* category = "phase")
+            : name(name), category(category), start(clTraceHostTime())
+        {
+        }
+
+        ~CLTraceScope()
+        {
+            CLTrace::getInstance().hostSpan(name, category, start, clTraceHostTime());
+        }
+};
+
+#define CL_TRACE_CONCAT_(a, b) a##b
+#define CL_TRACE_CONCAT(a, b) CL_TRACE_CONCAT_(a, b)
+#define CL_TRACE_SCOPE(name) \
+    CLTraceScope CL_TRACE_CONCAT(clTraceScope, __LINE__)(name)
+
+/**
+* Bytes of an image region
+*/
+inline size_t clTraceImageBytes(cl_mem image, const size_t* region)
+{
+    size_t elementSize = 0;
+    clGetImageInfo(image, CL_IMAGE_ELEMENT_SIZE, sizeof(elementSize), &elementSize,
+                   NULL);
+    return elementSize * region[0] * region[1] * region[2];
+}
+
+/*
+ * Wrappers : same signature as the OpenCL call, the event is always asked
+ * for and handed to CLTrace
+ */
+
+#define CL_TRACE_RECORD(queue, category, name, bytes, items) \
+    if(status == CL_SUCCESS) \
+    { \
+        CLTrace::getInstance().command(queue, traced, event, category, name, \
+                                       bytes, items, host); \
+    }
+
+#define CL_TRACE_BLOCKING(blocking, name) \
+    if(blocking) \
+    { \
+        CLTrace::getInstance().hostSpan(name, "wait", host, clTraceHostTime()); \
+    }
+
+inline cl_command_queue CL_API_CALL
+clTraceCreateCommandQueue(cl_context context, cl_device_id device,
+                          cl_command_queue_properties properties,
+                          cl_int* errcode)
+{
+    return clCreateCommandQueue(context, device,
+                                properties | CL_QUEUE_PROFILING_ENABLE, errcode);
+}
+
+#ifdef CL_VERSION_2_0
+inline cl_command_queue CL_API_CALL
+clTraceCreateCommandQueueWithProperties(cl_context context, cl_device_id device,
+                                        const cl_queue_properties* properties,
+                                        cl_int* errcode)
+{
+    std::vector<cl_queue_properties> traced;
+    bool found = false;
+    for(size_t i = 0; properties && properties[i]; i += 2)
+    {
+        cl_queue_properties value = properties[i + 1];
+        if(properties[i] == CL_QUEUE_PROPERTIES)
+        {
+            found = true;
+            // Device-side queues are left alone
+            if(!(value & CL_QUEUE_ON_DEVICE))
+            {
+                value |= CL_QUEUE_PROFILING_ENABLE;
+            }
+        }
+        traced.push_back(properties[i]);
+        traced.push_back(value);
+    }
+    if(!found)
+    {
+        traced.push_back(CL_QUEUE_PROPERTIES);
+        traced.push_back(CL_QUEUE_PROFILING_ENABLE);
+    }
+    traced.push_back(0);
+    return clCreateCommandQueueWithProperties(context, device, &traced[0], errcode);
+}
+#endif
+
+inline cl_int CL_API_CALL
+clTraceEnqueueNDRangeKernel(cl_command_queue queue, cl_kernel kernel,
+                            cl_uint workDim, const size_t* globalOffset,
+                            const size_t* globalSize, const size_t* localSize,
+                            cl_uint numEvents, const cl_event* waitList,
+                            cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueNDRangeKernel(queue, kernel, workDim, globalOffset,
+                                           globalSize, localSize, numEvents,
+                                           waitList, &traced);
+    size_t items = 1;
+    for(cl_uint i = 0; globalSize && i < workDim; i++)
+    {
+        items *= globalSize[i];
+    }
+    CL_TRACE_RECORD(queue, "kernel", CLTrace::getInstance().kernelName(kernel), 0,
+                    items);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueTask(cl_command_queue queue, cl_kernel kernel, cl_uint numEvents,
+                   const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueTask(queue, kernel, numEvents, waitList, &traced);
+    CL_TRACE_RECORD(queue, "kernel", CLTrace::getInstance().kernelName(kernel), 0, 1);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueReadBuffer(cl_command_queue queue, cl_mem buffer, cl_bool blocking,
+                         size_t offset, size_t size, void* ptr, cl_uint numEvents,
+                         const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueReadBuffer(queue, buffer, blocking, offset, size, ptr,
+                                        numEvents, waitList, &traced);
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueReadBuffer");
+    CL_TRACE_RECORD(queue, "read", "ReadBuffer", size, 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueWriteBuffer(cl_command_queue queue, cl_mem buffer, cl_bool blocking,
+                          size_t offset, size_t size, const void* ptr,
+                          cl_uint numEvents, const cl_event* waitList,
+                          cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueWriteBuffer(queue, buffer, blocking, offset, size, ptr,
+                                         numEvents, waitList, &traced);
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueWriteBuffer");
+    CL_TRACE_RECORD(queue, "write", "WriteBuffer", size, 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueReadBufferRect(cl_command_queue queue, cl_mem buffer,
+                             cl_bool blocking, const size_t* bufferOrigin,
+                             const size_t* hostOrigin, const size_t* region,
+                             size_t bufferRowPitch, size_t bufferSlicePitch,
+                             size_t hostRowPitch, size_t hostSlicePitch,
+                             void* ptr, cl_uint numEvents,
+                             const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueReadBufferRect(queue, buffer, blocking, bufferOrigin,
+                                            hostOrigin, region, bufferRowPitch,
+                                            bufferSlicePitch, hostRowPitch,
+                                            hostSlicePitch, ptr, numEvents,
+                                            waitList, &traced);
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueReadBufferRect");
+    CL_TRACE_RECORD(queue, "read", "ReadBufferRect",
+                    region[0] * region[1] * region[2], 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueWriteBufferRect(cl_command_queue queue, cl_mem buffer,
+                              cl_bool blocking, const size_t* bufferOrigin,
+                              const size_t* hostOrigin, const size_t* region,
+                              size_t bufferRowPitch, size_t bufferSlicePitch,
+                              size_t hostRowPitch, size_t hostSlicePitch,
+                              const void* ptr, cl_uint numEvents,
+                              const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueWriteBufferRect(queue, buffer, blocking, bufferOrigin,
+                                             hostOrigin, region, bufferRowPitch,
+                                             bufferSlicePitch, hostRowPitch,
+                                             hostSlicePitch, ptr, numEvents,
+                                             waitList, &traced);
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueWriteBufferRect");
+    CL_TRACE_RECORD(queue, "write", "WriteBufferRect",
+                    region[0] * region[1] * region[2], 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueCopyBuffer(cl_command_queue queue, cl_mem src, cl_mem dst,
+                         size_t srcOffset, size_t dstOffset, size_t size,
+                         cl_uint numEvents, const cl_event* waitList,
+                         cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueCopyBuffer(queue, src, dst, srcOffset, dstOffset, size,
+                                        numEvents, waitList, &traced);
+    CL_TRACE_RECORD(queue, "copy", "CopyBuffer", size, 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueReadImage(cl_command_queue queue, cl_mem image, cl_bool blocking,
+                        const size_t* origin, const size_t* region,
+                        size_t rowPitch, size_t slicePitch, void* ptr,
+                        cl_uint numEvents, const cl_event* waitList,
+                        cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueReadImage(queue, image, blocking, origin, region,
+                                       rowPitch, slicePitch, ptr, numEvents,
+                                       waitList, &traced);
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueReadImage");
+    CL_TRACE_RECORD(queue, "read", "ReadImage", clTraceImageBytes(image, region), 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueWriteImage(cl_command_queue queue, cl_mem image, cl_bool blocking,
+                         const size_t* origin, const size_t* region,
+                         size_t rowPitch, size_t slicePitch, const void* ptr,
+                         cl_uint numEvents, const cl_event* waitList,
+                         cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueWriteImage(queue, image, blocking, origin, region,
+                                        rowPitch, slicePitch, ptr, numEvents,
+                                        waitList, &traced);
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueWriteImage");
+    CL_TRACE_RECORD(queue, "write", "WriteImage", clTraceImageBytes(image, region),
+                    0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueCopyImage(cl_command_queue queue, cl_mem src, cl_mem dst,
+                        const size_t* srcOrigin, const size_t* dstOrigin,
+                        const size_t* region, cl_uint numEvents,
+                        const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueCopyImage(queue, src, dst, srcOrigin, dstOrigin, region,
+                                       numEvents, waitList, &traced);
+    CL_TRACE_RECORD(queue, "copy", "CopyImage", clTraceImageBytes(src, region), 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueCopyImageToBuffer(cl_command_queue queue, cl_mem src, cl_mem dst,
+                                const size_t* srcOrigin, const size_t* region,
+                                size_t dstOffset, cl_uint numEvents,
+                                const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueCopyImageToBuffer(queue, src, dst, srcOrigin, region,
+                                               dstOffset, numEvents, waitList,
+                                               &traced);
+    CL_TRACE_RECORD(queue, "copy", "CopyImageToBuffer",
+                    clTraceImageBytes(src, region), 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueCopyBufferToImage(cl_command_queue queue, cl_mem src, cl_mem dst,
+                                size_t srcOffset, const size_t* dstOrigin,
+                                const size_t* region, cl_uint numEvents,
+                                const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueCopyBufferToImage(queue, src, dst, srcOffset, dstOrigin,
+                                               region, numEvents, waitList,
+                                               &traced);
+    CL_TRACE_RECORD(queue, "copy", "CopyBufferToImage",
+                    clTraceImageBytes(dst, region), 0);
+    return status;
+}
+
+inline void* CL_API_CALL
+clTraceEnqueueMapBuffer(cl_command_queue queue, cl_mem buffer, cl_bool blocking,
+                        cl_map_flags flags, size_t offset, size_t size,
+                        cl_uint numEvents, const cl_event* waitList,
+                        cl_event* event, cl_int* errcode)
+{
+    cl_event traced;
+    cl_int status;
+    cl_ulong host = clTraceHostTime();
+    void* ptr = clEnqueueMapBuffer(queue, buffer, blocking, flags, offset, size,
+                                   numEvents, waitList, &traced, &status);
+    if(errcode)
+    {
+        *errcode = status;
+    }
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueMapBuffer");
+    CL_TRACE_RECORD(queue, "map", "MapBuffer", size, 0);
+    return ptr;
+}
+
+inline void* CL_API_CALL
+clTraceEnqueueMapImage(cl_command_queue queue, cl_mem image, cl_bool blocking,
+                       cl_map_flags flags, const size_t* origin,
+                       const size_t* region, size_t* rowPitch, size_t* slicePitch,
+                       cl_uint numEvents, const cl_event* waitList,
+                       cl_event* event, cl_int* errcode)
+{
+    cl_event traced;
+    cl_int status;
+    cl_ulong host = clTraceHostTime();
+    void* ptr = clEnqueueMapImage(queue, image, blocking, flags, origin, region,
+                                  rowPitch, slicePitch, numEvents, waitList,
+                                  &traced, &status);
+    if(errcode)
+    {
+        *errcode = status;
+    }
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueMapImage");
+    CL_TRACE_RECORD(queue, "map", "MapImage", clTraceImageBytes(image, region), 0);
+    return ptr;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueUnmapMemObject(cl_command_queue queue, cl_mem memobj, void* ptr,
+                             cl_uint numEvents, const cl_event* waitList,
+                             cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueUnmapMemObject(queue, memobj, ptr, numEvents, waitList,
+                                            &traced);
+    CL_TRACE_RECORD(queue, "unmap", "UnmapMemObject", 0, 0);
+    return status;
+}
+
+#ifdef CL_VERSION_1_2
+inline cl_int CL_API_CALL
+clTraceEnqueueFillBuffer(cl_command_queue queue, cl_mem buffer,
+                         const void* pattern, size_t patternSize, size_t offset,
+                         size_t size, cl_uint numEvents, const cl_event* waitList,
+                         cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueFillBuffer(queue, buffer, pattern, patternSize, offset,
+                                        size, numEvents, waitList, &traced);
+    CL_TRACE_RECORD(queue, "fill", "FillBuffer", size, 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueFillImage(cl_command_queue queue, cl_mem image,
+                        const void* color, const size_t* origin,
+                        const size_t* region, cl_uint numEvents,
+                        const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueFillImage(queue, image, color, origin, region,
+                                       numEvents, waitList, &traced);
+    CL_TRACE_RECORD(queue, "fill", "FillImage", clTraceImageBytes(image, region), 0);
+    return status;
+}
+#endif
+
+#ifdef CL_VERSION_2_0
+inline cl_int CL_API_CALL
+clTraceEnqueueSVMMemcpy(cl_command_queue queue, cl_bool blocking, void* dst,
+                        const void* src, size_t size, cl_uint numEvents,
+                        const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueSVMMemcpy(queue, blocking, dst, src, size, numEvents,
+                                       waitList, &traced);
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueSVMMemcpy");
+    CL_TRACE_RECORD(queue, "copy", "SVMMemcpy", size, 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueSVMMemFill(cl_command_queue queue, void* ptr, const void* pattern,
+                         size_t patternSize, size_t size, cl_uint numEvents,
+                         const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueSVMMemFill(queue, ptr, pattern, patternSize, size,
+                                        numEvents, waitList, &traced);
+    CL_TRACE_RECORD(queue, "fill", "SVMMemFill", size, 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueSVMMap(cl_command_queue queue, cl_bool blocking, cl_map_flags flags,
+                     void* ptr, size_t size, cl_uint numEvents,
+                     const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueSVMMap(queue, blocking, flags, ptr, size, numEvents,
+                                    waitList, &traced);
+    CL_TRACE_BLOCKING(blocking, "blocking clEnqueueSVMMap");
+    CL_TRACE_RECORD(queue, "map", "SVMMap", size, 0);
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceEnqueueSVMUnmap(cl_command_queue queue, void* ptr, cl_uint numEvents,
+                       const cl_event* waitList, cl_event* event)
+{
+    cl_event traced;
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clEnqueueSVMUnmap(queue, ptr, numEvents, waitList, &traced);
+    CL_TRACE_RECORD(queue, "unmap", "SVMUnmap", 0, 0);
+    return status;
+}
+#endif
+
+inline cl_int CL_API_CALL
+clTraceFinish(cl_command_queue queue)
+{
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clFinish(queue);
+    CL_TRACE_BLOCKING(true, "clFinish");
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceWaitForEvents(cl_uint numEvents, const cl_event* eventList)
+{
+    cl_ulong host = clTraceHostTime();
+    cl_int status = clWaitForEvents(numEvents, eventList);
+    CL_TRACE_BLOCKING(true, "clWaitForEvents");
+    return status;
+}
+
+inline cl_int CL_API_CALL
+clTraceBuildProgram(cl_program program, cl_uint numDevices,
+                    const cl_device_id* deviceList, const char* options,
+                    void (CL_CALLBACK* notify)(cl_program, void*), void* userData)
+{
+    CLTraceScope scope("clBuildProgram", "build");
+    return clBuildProgram(program, numDevices, deviceList, options, notify,
+                          userData);
+}
+
+/*
+ * From here on the sample calls the wrappers
+ */
+#define clCreateCommandQueue clTraceCreateCommandQueue
+#define clEnqueueNDRangeKernel clTraceEnqueueNDRangeKernel
+#define clEnqueueTask clTraceEnqueueTask
+#define clEnqueueReadBuffer clTraceEnqueueReadBuffer
+#define clEnqueueWriteBuffer clTraceEnqueueWriteBuffer
+#define clEnqueueReadBufferRect clTraceEnqueueReadBufferRect
+#define clEnqueueWriteBufferRect clTraceEnqueueWriteBufferRect
+#define clEnqueueCopyBuffer clTraceEnqueueCopyBuffer
+#define clEnqueueReadImage clTraceEnqueueReadImage
+#define clEnqueueWriteImage clTraceEnqueueWriteImage
+#define clEnqueueCopyImage clTraceEnqueueCopyImage
+#define clEnqueueCopyImageToBuffer clTraceEnqueueCopyImageToBuffer
+#define clEnqueueCopyBufferToImage clTraceEnqueueCopyBufferToImage
+#define clEnqueueMapBuffer clTraceEnqueueMapBuffer
+#define clEnqueueMapImage clTraceEnqueueMapImage
+#define clEnqueueUnmapMemObject clTraceEnqueueUnmapMemObject
+#define clFinish clTraceFinish
+#define clWaitForEvents clTraceWaitForEvents
+#define clBuildProgram clTraceBuildProgram
+#ifdef CL_VERSION_1_2
+#define clEnqueueFillBuffer clTraceEnqueueFillBuffer
+#define clEnqueueFillImage clTraceEnqueueFillImage
+#endif
+#ifdef CL_VERSION_2_0
+#define clCreateCommandQueueWithProperties clTraceCreateCommandQueueWithProperties
+#define clEnqueueSVMMemcpy clTraceEnqueueSVMMemcpy
+#define clEnqueueSVMMemFill clTraceEnqueueSVMMemFill
+#define clEnqueueSVMMap clTraceEnqueueSVMMap
+#define clEnqueueSVMUnmap clTraceEnqueueSVMUnmap
+#endif
+
+#else
+
+#define CL_TRACE_SCOPE(name)
+
+#endif  // CL_TRACE
+
+#endif  // CL_TRACE_H_
@@ -0,0 +1,416 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "LaunchBatcher.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cctype>
+
+static const char* strategyNames[NUM_LAUNCH_STRATEGIES] =
+{
+    "sync",
+    "flush",
+    "batched",
+    "persistent",
+    "device"
+};
+
+LaunchProfile::LaunchProfile()
+    : passes(0)
+{
+}
+
+const char*
+LaunchProfile::strategyName(LaunchStrategy strategy)
+{
+    return strategy == LAUNCH_AUTO ? "auto" : strategyNames[strategy];
+}
+
+int
+LaunchProfile::parseStrategy(const std::string& name, LaunchStrategy& strategy)
+{
+    if(name == "auto")
+    {
+        strategy = LAUNCH_AUTO;
+        return SDK_SUCCESS;
+    }
+    for(int s = 0; s < NUM_LAUNCH_STRATEGIES; s++)
+    {
+        if(name == strategyNames[s])
+        {
+            strategy = (LaunchStrategy)s;
+            return SDK_SUCCESS;
+        }
+    }
+    return SDK_FAILURE;
+}
+
+std::string
+LaunchProfile::fileName(cl_device_id device)
+{
+    char name[256] = "";
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+
+    std::string file = "LaunchProfile_";
+    for(const char* c = name; *c != '\0'; c++)
+    {
+        file += isalnum((unsigned char)*c) ? *c : '_';
+    }
+    return file + ".txt";
+}
+
+void
+LaunchProfile::reset(const std::string& device, cl_uint passes)
+{
+    this->device = device;
+    this->passes = passes;
+    points.clear();
+}
+
+void
+LaunchProfile::addPoint(size_t workItems,
+                        const double usPerPass[NUM_LAUNCH_STRATEGIES])
+{
+    Point point;
+    point.workItems = workItems;
+    memcpy(point.usPerPass, usPerPass, sizeof(point.usPerPass));
+    points.push_back(point);
+}
+
+int
+LaunchProfile::save(const std::string& file) const
+{
+    std::ofstream out(file.c_str());
+    if(!out)
+    {
+        std::cout << "Failed to open " << file << std::endl;
+        return SDK_FAILURE;
+    }
+
+    out << "# Launch profile, microseconds per pass, 0 when not measured"
+        << std::endl;
+    out << "device " << device << std::endl;
+    out << "passes " << passes << std::endl;
+
+    out << "# point <work-items> <";
+    for(int s = 0; s < NUM_LAUNCH_STRATEGIES; s++)
+    {
+        out << (s ? " " : "") << strategyNames[s];
+    }
+    out << ">" << std::endl;
+    for(size_t i = 0; i < points.size(); i++)
+    {
+        out << "point " << points[i].workItems;
+        for(int s = 0; s < NUM_LAUNCH_STRATEGIES; s++)
+        {
+            out << " " << points[i].usPerPass[s];
+        }
+        out << std::endl;
+    }
+
+    return out.good() ? SDK_SUCCESS : SDK_FAILURE;
+}
+
+int
+LaunchProfile::load(const std::string& file)
+{
+    std::ifstream in(file.c_str());
+    if(!in)
+    {
+        return SDK_FAILURE;
+    }
+
+    points.clear();
+
+    std::string line;
+    while(std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        if(kind == "device")
+        {
+            std::getline(fields >> std::ws, device);
+        }
+        else if(kind == "passes")
+        {
+            fields >> passes;
+        }
+        else if(kind == "point")
+        {
+            Point point;
+            fields >> point.workItems;
+            for(int s = 0; s < NUM_LAUNCH_STRATEGIES; s++)
+            {
+                fields >> point.usPerPass[s];
+            }
+            if(!fields)
+            {
+                std::cout << "Malformed line in " << file << " : " << line
+                          << std::endl;
+                points.clear();
+                return SDK_FAILURE;
+            }
+            points.push_back(point);
+        }
+    }
+
+    for(size_t i = 1; i < points.size(); i++)
+    {
+        if(points[i].workItems <= points[i - 1].workItems)
+        {
+            std::cout << "Work sizes of " << file << " are not increasing"
+                      << std::endl;
+            points.clear();
+            return SDK_FAILURE;
+        }
+    }
+
+    return SDK_SUCCESS;
+}
+
+bool
+LaunchProfile::empty() const
+{
+    return points.empty();
+}
+
+LaunchStrategy
+LaunchProfile::select(size_t workItems, bool persistent,
+                      bool deviceEnqueue) const
+{
+    if(points.empty())
+    {
+        return LAUNCH_FLUSH_EVERY;
+    }
+
+    // Work sizes are compared by ratio, the sweep is geometric
+    size_t i = 0;
+    while(i + 1 < points.size() && points[i + 1].workItems <= workItems)
+    {
+        i++;
+    }
+    if(i + 1 < points.size() && workItems > points[i].workItems &&
+            (double)workItems / points[i].workItems >
+            (double)points[i + 1].workItems / workItems)
+    {
+        i++;
+    }
+
+    LaunchStrategy best = LAUNCH_FLUSH_EVERY;
+    for(int s = 0; s < NUM_LAUNCH_STRATEGIES; s++)
+    {
+        double time = points[i].usPerPass[s];
+        if(time <= 0 || (s == LAUNCH_PERSISTENT && !persistent) ||
+                (s == LAUNCH_DEVICE_ENQUEUE && !deviceEnqueue))
+        {
+            continue;
+        }
+        if(points[i].usPerPass[best] <= 0 || time < points[i].usPerPass[best])
+        {
+            best = (LaunchStrategy)s;
+        }
+    }
+    return best;
+}
+
+void
+LaunchProfile::print() const
+{
+    std::cout << "Launch profile of " << device << ", " << passes
+              << " passes (us per pass)" << std::endl << std::setw(12)
+              << "Work-items";
+    for(int s = 0; s < NUM_LAUNCH_STRATEGIES; s++)
+    {
+        std::cout << std::setw(12) << strategyNames[s];
+    }
+    std::cout << std::setw(12) << "best" << std::endl;
+
+    LaunchStrategy previous = LAUNCH_AUTO;
+    std::ostringstream crossovers;
+    for(size_t i = 0; i < points.size(); i++)
+    {
+        std::cout << std::setw(12) << points[i].workItems << std::fixed
+                  << std::setprecision(2);
+        for(int s = 0; s < NUM_LAUNCH_STRATEGIES; s++)
+        {
+            std::cout << std::setw(12) << points[i].usPerPass[s];
+        }
+        LaunchStrategy best = select(points[i].workItems, true, true);
+        std::cout << std::setw(12) << strategyNames[best] << std::endl;
+
+        if(previous != LAUNCH_AUTO && best != previous)
+        {
+            crossovers << "  " << strategyNames[previous] << " -> "
+                       << strategyNames[best] << " between "
+                       << points[i - 1].workItems << " and "
+                       << points[i].workItems << " work-items" << std::endl;
+        }
+        previous = best;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+
+    std::cout << std::endl << "Crossovers" << std::endl;
+    std::cout << (crossovers.str().empty() ? std::string("  none\n") :
+                  crossovers.str()) << std::endl;
+}
+
+LaunchBatcher::LaunchBatcher()
+    : queue(NULL),
+      requested(LAUNCH_AUTO),
+      current(LAUNCH_FLUSH_EVERY),
+      deviceEnqueue(false),
+      unflushed(0),
+      launches(0),
+      flushes(0),
+      waits(0)
+{
+    memset(sequences, 0, sizeof(sequences));
+}
+
+int
+LaunchBatcher::create(cl_command_queue queue, LaunchStrategy strategy)
+{
+    this->queue = queue;
+    requested = strategy;
+
+    cl_device_id device;
+    cl_int status = clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE,
+                                          sizeof(device), &device, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetCommandQueueInfo failed.");
+
+    cl_command_queue_properties properties;
+    status = clGetCommandQueueInfo(queue, CL_QUEUE_PROPERTIES,
+                                   sizeof(properties), &properties, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetCommandQueueInfo failed.");
+    if(properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+    {
+        std::cout << "LaunchBatcher needs an in-order command-queue"
+                  << std::endl;
+        return SDK_FAILURE;
+    }
+
+    // "OpenCL <major>.<minor> <vendor info>"
+    char version[128] = "";
+    status = clGetDeviceInfo(device, CL_DEVICE_VERSION, sizeof(version),
+                             version, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo failed.");
+    deviceEnqueue = strlen(version) > 7 && version[7] >= '2';
+
+    if(requested == LAUNCH_AUTO &&
+            profile.load(LaunchProfile::fileName(device)) != SDK_SUCCESS)
+    {
+        profile.reset("", 0);
+    }
+    return SDK_SUCCESS;
+}
+
+LaunchStrategy
+LaunchBatcher::begin(size_t workItems, bool persistent, bool deviceEnqueue)
+{
+    deviceEnqueue = deviceEnqueue && this->deviceEnqueue;
+
+    if(requested == LAUNCH_AUTO)
+    {
+        current = profile.select(workItems, persistent, deviceEnqueue);
+    }
+    else if(requested == LAUNCH_DEVICE_ENQUEUE && !deviceEnqueue)
+    {
+        current = persistent ? LAUNCH_PERSISTENT : LAUNCH_BATCHED;
+    }
+    else if(requested == LAUNCH_PERSISTENT && !persistent)
+    {
+        current = LAUNCH_BATCHED;
+    }
+    else
+    {
+        current = requested;
+    }
+
+    sequences[current]++;
+    unflushed = 0;
+    return current;
+}
+
+cl_int
+LaunchBatcher::launch(cl_kernel kernel, cl_uint workDim, const size_t* global,
+                      const size_t* local)
+{
+    cl_int status = clEnqueueNDRangeKernel(queue, kernel, workDim, NULL,
+                                           global, local, 0, NULL, NULL);
+    if(status != CL_SUCCESS)
+    {
+        return status;
+    }
+    launches++;
+    unflushed++;
+
+    if(current == LAUNCH_SYNC)
+    {
+        status = clFinish(queue);
+        flushes++;
+        waits++;
+        unflushed = 0;
+    }
+    else if(current == LAUNCH_FLUSH_EVERY && unflushed >= LAUNCH_FLUSH_INTERVAL)
+    {
+        status = clFlush(queue);
+        flushes++;
+        unflushed = 0;
+    }
+    return status;
+}
+
+int
+LaunchBatcher::end()
+{
+    if(unflushed == 0 && current == LAUNCH_SYNC)
+    {
+        return SDK_SUCCESS;
+    }
+
+    cl_int status = clFinish(queue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed.");
+    if(unflushed != 0)
+    {
+        flushes++;
+    }
+    waits++;
+    unflushed = 0;
+    return SDK_SUCCESS;
+}
+
+bool
+LaunchBatcher::canEnqueueOnDevice() const
+{
+    return deviceEnqueue;
+}
+
+void
+LaunchBatcher::printStats() const
+{
+    std::cout << "Launches : " << launches << ", flushes : " << flushes
+              << ", host waits : " << waits << std::endl << "Sequences :";
+    for(int s = 0; s < NUM_LAUNCH_STRATEGIES; s++)
+    {
+        std::cout << " " << strategyNames[s] << " " << sequences[s];
+    }
+    std::cout << (requested == LAUNCH_AUTO && profile.empty() ?
+                  " (no launch profile)" : "") << std::endl;
+}
@@ -0,0 +1,218 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef LAUNCH_BATCHER_H_
+#define LAUNCH_BATCHER_H_
+
+/**
+ * LaunchBatcher
+ * Issues sequences of small dependent kernel launches (the per-pass
+ * launches of FloydWarshall, BitonicSort, ...) on an in-order queue with a
+ * strategy picked per sequence :
+ *   sync       : flush and wait after every launch
+ *   flush      : flush every LAUNCH_FLUSH_INTERVAL launches, one wait
+ *   batched    : one flush and one wait for the whole sequence
+ *   persistent : a single work-group runs every pass in a loop with
+ *                barriers, one launch for the sequence
+ *   device     : a parent kernel enqueues the passes on the device
+ *                (OpenCL 2.0)
+ * The last two need a fused kernel from the caller. LAUNCH_AUTO takes the
+ * strategy with the lowest time per pass measured for the device at the
+ * nearest work size, read from LaunchProfile_<device>.txt written by the
+ * LaunchProfile entry of BatchRunner. Without a profile, flush.
+ *
+ * LaunchProfile
+ * Time per pass of every strategy over a sweep of work sizes.
+ */
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+#include "CLUtil.hpp"
+
+using namespace appsdk;
+
+#define LAUNCH_PROFILE_SAMPLE "LaunchProfile"   ///< Entry of BatchRunner
+#define LAUNCH_FLUSH_INTERVAL 16        ///< Launches between two flushes
+
+/**
+* Ways to issue a sequence of dependent launches
+*/
+enum LaunchStrategy
+{
+    LAUNCH_SYNC,
+    LAUNCH_FLUSH_EVERY,
+    LAUNCH_BATCHED,
+    LAUNCH_PERSISTENT,
+    LAUNCH_DEVICE_ENQUEUE,
+    NUM_LAUNCH_STRATEGIES,
+    LAUNCH_AUTO = NUM_LAUNCH_STRATEGIES
+};
+
+/**
+* LaunchProfile
+* Measured time per pass of the strategies of one device
+*/
+class LaunchProfile
+{
+        /**
+        * Microseconds per pass of every strategy at one work size, 0 when
+        * not measured
+        */
+        struct Point
+        {
+            size_t workItems;
+            double usPerPass[NUM_LAUNCH_STRATEGIES];
+        };
+
+        std::string device;             /**< Name of the device */
+        cl_uint passes;                 /**< Passes per measured sequence */
+        std::vector<Point> points;      /**< By increasing work size */
+
+    public:
+        LaunchProfile();
+
+        /**
+        * Name of a strategy, also accepted by parseStrategy()
+        */
+        static const char* strategyName(LaunchStrategy strategy);
+
+        /**
+        * Strategy of a name, "auto" included
+        * @return SDK_SUCCESS on success and SDK_FAILURE on an unknown name
+        */
+        static int parseStrategy(const std::string& name,
+                                 LaunchStrategy& strategy);
+
+        /**
+        * Profile file of a device
+        */
+        static std::string fileName(cl_device_id device);
+
+        /**
+        * Starts a new profile
+        * @param device name of the device
+        * @param passes passes per measured sequence
+        */
+        void reset(const std::string& device, cl_uint passes);
+
+        /**
+        * Adds the times of one work size, sizes must increase
+        */
+        void addPoint(size_t workItems,
+                      const double usPerPass[NUM_LAUNCH_STRATEGIES]);
+
+        /**
+        * Writes the profile
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int save(const std::string& file) const;
+
+        /**
+        * Reads a profile written by save()
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int load(const std::string& file);
+
+        /**
+        * Tells if the profile holds measurements
+        */
+        bool empty() const;
+
+        /**
+        * Fastest strategy at the nearest measured work size
+        * @param workItems work-items of one launch
+        * @param persistent the caller has a persistent kernel
+        * @param deviceEnqueue the caller has a device-enqueue kernel
+        * @return LAUNCH_FLUSH_EVERY for an empty profile
+        */
+        LaunchStrategy select(size_t workItems, bool persistent,
+                              bool deviceEnqueue) const;
+
+        /**
+        * Prints the times and the work sizes where the fastest strategy
+        * changes
+        */
+        void print() const;
+};
+
+/**
+* LaunchBatcher
+* Launch sequencing of one in-order command-queue
+*/
+class LaunchBatcher
+{
+        cl_command_queue queue;         /**< In-order queue of the launches */
+        LaunchStrategy requested;       /**< Strategy asked for */
+        LaunchStrategy current;         /**< Strategy of the open sequence */
+        LaunchProfile profile;          /**< Profile of the device */
+        bool deviceEnqueue;             /**< Device runs OpenCL 2.0 */
+        cl_uint unflushed;              /**< Launches since the last flush */
+
+        cl_ulong launches;              /**< Kernels enqueued */
+        cl_ulong flushes;               /**< clFlush calls */
+        cl_ulong waits;                 /**< Host waits */
+        cl_ulong sequences[NUM_LAUNCH_STRATEGIES];  /**< Sequences per strategy */
+
+    public:
+        LaunchBatcher();
+
+        /**
+        * Attaches the batcher to a queue and loads the profile of its device
+        * for LAUNCH_AUTO
+        * @param queue in-order command-queue
+        * @param strategy strategy of every sequence, LAUNCH_AUTO to select
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int create(cl_command_queue queue, LaunchStrategy strategy = LAUNCH_AUTO);
+
+        /**
+        * Opens a sequence and returns its strategy. The persistent and
+        * device-enqueue strategies are only returned when the caller has the
+        * matching kernel, and then run as a single launch.
+        * @param workItems work-items of one launch of the sequence
+        * @param persistent the caller has a persistent kernel
+        * @param deviceEnqueue the caller has a device-enqueue kernel
+        */
+        LaunchStrategy begin(size_t workItems, bool persistent,
+                             bool deviceEnqueue = false);
+
+        /**
+        * Enqueues one launch of the open sequence, flushing and waiting as
+        * its strategy requires. Arguments are taken when enqueued, so they
+        * can be changed between launches.
+        */
+        cl_int launch(cl_kernel kernel, cl_uint workDim, const size_t* global,
+                      const size_t* local);
+
+        /**
+        * Closes the sequence : waits for its launches
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int end();
+
+        /**
+        * Tells if the device can enqueue kernels
+        */
+        bool canEnqueueOnDevice() const;
+
+        /**
+        * Counters since create()
+        */
+        void printStats() const;
+};
+
+#endif  // LAUNCH_BATCHER_H_
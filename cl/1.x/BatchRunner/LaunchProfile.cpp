@@ -0,0 +1,408 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "LaunchBatcher.hpp"
+#include "CLRuntime.hpp"
+#include <vector>
+#include <cstring>
+
+#define LAUNCH_PASSES 64                ///< Passes of a measured sequence
+#define MAX_LAUNCH_ITEMS (1 << 20)      ///< Largest work size of the sweep
+#define LAUNCH_ITERATIONS 8             ///< Timed sequences per point
+#define LAUNCH_GROUP_SIZE 256           ///< Work-group size of the passes
+
+/**
+* Kernels of the measured sequence, NULL when not available
+*/
+struct LaunchKernels
+{
+    cl_kernel pass;                     /**< One pass per launch */
+    cl_kernel persistent;               /**< Every pass in one work-group */
+    cl_kernel device;                   /**< Passes enqueued by the device */
+};
+
+/**
+* Runs one sequence of 'passes' passes over the first 'n' elements of the
+* buffer already set as argument 0 of the kernels
+* @return strategy the batcher used, LAUNCH_AUTO on failure
+*/
+static LaunchStrategy
+runSequence(LaunchBatcher& batcher, const LaunchKernels& kernels, cl_uint n,
+            cl_uint passes, size_t localSize)
+{
+    size_t globalSize = (n + localSize - 1) / localSize * localSize;
+    LaunchStrategy strategy = batcher.begin(n, kernels.persistent != NULL,
+                                            kernels.device != NULL);
+    cl_uint first = 0;
+    cl_int status = CL_SUCCESS;
+
+    if(strategy == LAUNCH_PERSISTENT)
+    {
+        status |= clSetKernelArg(kernels.persistent, 2, sizeof(cl_uint), &first);
+        status |= clSetKernelArg(kernels.persistent, 3, sizeof(cl_uint), &passes);
+        if(status == CL_SUCCESS)
+        {
+            status = batcher.launch(kernels.persistent, 1, &localSize, &localSize);
+        }
+    }
+    else if(strategy == LAUNCH_DEVICE_ENQUEUE)
+    {
+        status |= clSetKernelArg(kernels.device, 2, sizeof(cl_uint), &first);
+        status |= clSetKernelArg(kernels.device, 3, sizeof(cl_uint), &passes);
+        if(status == CL_SUCCESS)
+        {
+            status = batcher.launch(kernels.device, 1, &globalSize, &localSize);
+        }
+    }
+    else
+    {
+        for(cl_uint pass = 0; pass < passes && status == CL_SUCCESS; pass++)
+        {
+            status = clSetKernelArg(kernels.pass, 2, sizeof(cl_uint), &pass);
+            if(status == CL_SUCCESS)
+            {
+                status = batcher.launch(kernels.pass, 1, &globalSize, &localSize);
+            }
+        }
+    }
+
+    if(status != CL_SUCCESS)
+    {
+        std::cout << "Launch failed with error " << status
+                  << std::endl;
+        batcher.end();
+        return LAUNCH_AUTO;
+    }
+    return batcher.end() == SDK_SUCCESS ? strategy : LAUNCH_AUTO;
+}
+
+/**
+* Sets the buffer and the work size of the kernels of a sequence
+*/
+static cl_int
+setSequenceArgs(const LaunchKernels& kernels, cl_mem buffer, cl_uint n)
+{
+    cl_int status = CL_SUCCESS;
+    cl_kernel all[] = {kernels.pass, kernels.persistent, kernels.device};
+    for(int k = 0; k < 3; k++)
+    {
+        if(all[k] != NULL)
+        {
+            status |= clSetKernelArg(all[k], 0, sizeof(cl_mem), &buffer);
+            status |= clSetKernelArg(all[k], 1, sizeof(cl_uint), &n);
+        }
+    }
+    return status;
+}
+
+/**
+* Builds launchDevicePass and the default device queue it enqueues on
+* @return the kernel, NULL when the device can not run it
+*/
+static cl_kernel
+createDeviceKernel(CLCommandArgs* sampleArgs, cl_context context,
+                   cl_device_id* devices, cl_command_queue& deviceQueue)
+{
+    deviceQueue = NULL;
+#ifdef CL_VERSION_2_0
+    cl_int status;
+    cl_queue_properties props[] =
+    {
+        CL_QUEUE_PROPERTIES,
+        CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE | CL_QUEUE_ON_DEVICE |
+        CL_QUEUE_ON_DEVICE_DEFAULT,
+        0
+    };
+    deviceQueue = clCreateCommandQueueWithProperties(context,
+                  devices[sampleArgs->deviceId], props, &status);
+    if(status != CL_SUCCESS)
+    {
+        deviceQueue = NULL;
+        return NULL;
+    }
+
+    buildProgramData buildData;
+    buildData.kernelName = std::string("LaunchProfile_DeviceEnqueue.cl");
+    buildData.devices = devices;
+    buildData.deviceId = sampleArgs->deviceId;
+    buildData.flagsStr = std::string("-cl-std=CL2.0");
+
+    cl_program program;
+    if(CLRuntime::getInstance().getProgram(context, buildData, program) !=
+            SDK_SUCCESS)
+    {
+        return NULL;
+    }
+    cl_kernel kernel = clCreateKernel(program, "launchDevicePass", &status);
+    clReleaseProgram(program);
+    return status == CL_SUCCESS ? kernel : NULL;
+#else
+    return NULL;
+#endif
+}
+
+/**
+* BatchRunner entry : measures the time per pass of every launch strategy
+* over a sweep of work sizes and writes the launch profile of the selected
+* device, read by LaunchBatcher in the samples run after it
+*/
+static int
+runLaunchProfile(int argc, char* argv[])
+{
+    CLRuntime& runtime = CLRuntime::getInstance();
+    CLCommandArgs* sampleArgs = new CLCommandArgs();
+    sampleArgs->sampleVerStr = "AMD-APP-SDK-v3.0.130.3";
+
+    int passes = LAUNCH_PASSES;
+    int maxItems = MAX_LAUNCH_ITEMS;
+    int iterations = LAUNCH_ITERATIONS;
+
+    CHECK_ERROR((sampleArgs->initialize()), SDK_SUCCESS,
+                "OpenCL resource initialization  failed");
+
+    Option* option = new Option;
+    CHECK_ALLOCATION(option, "Memory allocation error.\n");
+
+    option->_sVersion = "";
+    option->_lVersion = "passes";
+    option->_description = "Dependent passes of a measured sequence";
+    option->_type = CA_ARG_INT;
+    option->_value = &passes;
+    sampleArgs->AddOption(option);
+
+    option->_sVersion = "";
+    option->_lVersion = "max-items";
+    option->_description = "Largest work size of the sweep, from 64 by 4";
+    option->_type = CA_ARG_INT;
+    option->_value = &maxItems;
+    sampleArgs->AddOption(option);
+
+    option->_sVersion = "i";
+    option->_lVersion = "iterations";
+    option->_description = "Timed sequences per work size and strategy";
+    option->_type = CA_ARG_INT;
+    option->_value = &iterations;
+    sampleArgs->AddOption(option);
+
+    delete option;
+
+    if(sampleArgs->parseCommandLine(argc, argv))
+    {
+        delete sampleArgs;
+        return SDK_FAILURE;
+    }
+
+    if(passes < 1 || maxItems < 64 || iterations < 1)
+    {
+        std::cout << "Error, passes and iterations must be positive and "
+                  << "max-items at least 64. Exiting.." << std::endl;
+        delete sampleArgs;
+        return SDK_FAILURE;
+    }
+
+    cl_device_type dType;
+    if(sampleArgs->deviceType.compare("cpu") == 0)
+    {
+        dType = CL_DEVICE_TYPE_CPU;
+    }
+    else //deviceType = "gpu"
+    {
+        dType = CL_DEVICE_TYPE_GPU;
+        if(sampleArgs->isThereGPU() == false)
+        {
+            std::cout << "GPU not found. Falling back to CPU device" << std::endl;
+            dType = CL_DEVICE_TYPE_CPU;
+        }
+    }
+
+    cl_platform_id platform = NULL;
+    cl_context context;
+    int retValue = runtime.getContext(sampleArgs, dType, platform, context);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::getContext() failed");
+
+    cl_device_id* devices = NULL;
+    retValue = getDevices(context, &devices, sampleArgs->deviceId,
+                          sampleArgs->isDeviceIdEnabled());
+    CHECK_ERROR(retValue, SDK_SUCCESS, "getDevices() failed");
+    cl_device_id device = devices[sampleArgs->deviceId];
+
+    cl_command_queue queue;
+    retValue = runtime.getCommandQueue(context, device, 0, queue);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::getCommandQueue() failed");
+
+    buildProgramData buildData;
+    buildData.kernelName = std::string("LaunchProfile_Kernels.cl");
+    buildData.devices = devices;
+    buildData.deviceId = sampleArgs->deviceId;
+    buildData.flagsStr = std::string("");
+
+    cl_program program;
+    retValue = runtime.getProgram(context, buildData, program);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::getProgram() failed");
+
+    cl_int status;
+    LaunchKernels kernels;
+    kernels.pass = clCreateKernel(program, "launchPass", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (launchPass)");
+    kernels.persistent = clCreateKernel(program, "launchPersistent", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (launchPersistent)");
+
+    LaunchBatcher probe;
+    retValue = probe.create(queue, LAUNCH_SYNC);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "LaunchBatcher::create() failed");
+    cl_command_queue deviceQueue = NULL;
+    kernels.device = NULL;
+    if(probe.canEnqueueOnDevice())
+    {
+        kernels.device = createDeviceKernel(sampleArgs, context, devices,
+                                            deviceQueue);
+    }
+    if(kernels.device == NULL)
+    {
+        std::cout << "Device-side enqueue not available, not measured"
+                  << std::endl;
+    }
+
+    size_t localSize = LAUNCH_GROUP_SIZE;
+    size_t kernelGroupSize;
+    status = clGetKernelWorkGroupInfo(kernels.persistent, device,
+                                      CL_KERNEL_WORK_GROUP_SIZE,
+                                      sizeof(size_t), &kernelGroupSize, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetKernelWorkGroupInfo failed.");
+    if(kernelGroupSize < localSize)
+    {
+        localSize = kernelGroupSize;
+    }
+
+    cl_uint bufferItems = (cl_uint)((maxItems + localSize - 1) / localSize *
+                                    localSize);
+    cl_mem buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+                                   bufferItems * sizeof(cl_uint), NULL, &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (buffer)");
+
+    std::vector<cl_uint> initial(maxItems);
+    std::vector<cl_uint> expected(maxItems);
+    std::vector<cl_uint> result(maxItems);
+    for(int i = 0; i < maxItems; i++)
+    {
+        initial[i] = (cl_uint)i;
+        expected[i] = (cl_uint)i;
+        for(cl_uint pass = 0; pass < (cl_uint)passes; pass++)
+        {
+            expected[i] = expected[i] * 3u + pass;
+        }
+    }
+
+    char deviceName[256] = "";
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(deviceName), deviceName,
+                    NULL);
+    LaunchProfile profile;
+    profile.reset(deviceName, (cl_uint)passes);
+
+    SDKTimer* timer = new SDKTimer();
+    int t = timer->createTimer();
+    bool verified = true;
+
+    for(cl_uint n = 64; n <= (cl_uint)maxItems; n *= 4)
+    {
+        double usPerPass[NUM_LAUNCH_STRATEGIES];
+        status = setSequenceArgs(kernels, buffer, n);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.");
+
+        for(int s = 0; s < NUM_LAUNCH_STRATEGIES; s++)
+        {
+            LaunchStrategy strategy = (LaunchStrategy)s;
+            usPerPass[s] = 0;
+
+            LaunchBatcher batcher;
+            retValue = batcher.create(queue, strategy);
+            CHECK_ERROR(retValue, SDK_SUCCESS, "LaunchBatcher::create() failed");
+
+            // One checked sequence, also the warm-up
+            status = clEnqueueWriteBuffer(queue, buffer, CL_TRUE, 0,
+                                          n * sizeof(cl_uint), &initial[0], 0,
+                                          NULL, NULL);
+            CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed.");
+            if(runSequence(batcher, kernels, n, passes, localSize) != strategy)
+            {
+                continue;
+            }
+            status = clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0,
+                                         n * sizeof(cl_uint), &result[0], 0,
+                                         NULL, NULL);
+            CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.");
+            if(memcmp(&result[0], &expected[0], n * sizeof(cl_uint)) != 0)
+            {
+                std::cout << "Wrong result of " << LaunchProfile::strategyName(
+                              strategy) << " at " << n << " work-items"
+                          << std::endl;
+                verified = false;
+                continue;
+            }
+
+            timer->resetTimer(t);
+            timer->startTimer(t);
+            for(int i = 0; i < iterations; i++)
+            {
+                runSequence(batcher, kernels, n, passes, localSize);
+            }
+            timer->stopTimer(t);
+            usPerPass[s] = timer->readTimer(t) * 1e6 / ((double)iterations *
+                           passes);
+        }
+        profile.addPoint(n, usPerPass);
+    }
+
+    delete timer;
+
+    retValue = profile.save(LaunchProfile::fileName(device));
+    CHECK_ERROR(retValue, SDK_SUCCESS, "LaunchProfile::save() failed");
+    if(!sampleArgs->quiet)
+    {
+        profile.print();
+    }
+    std::cout << "Profile written to " << LaunchProfile::fileName(device)
+              << std::endl;
+
+    status = clReleaseMemObject(buffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (buffer)");
+    status = clReleaseKernel(kernels.pass);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed. (launchPass)");
+    status = clReleaseKernel(kernels.persistent);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed. (launchPersistent)");
+    if(kernels.device != NULL)
+    {
+        status = clReleaseKernel(kernels.device);
+        CHECK_OPENCL_ERROR(status, "clReleaseKernel failed. (launchDevicePass)");
+    }
+    if(deviceQueue != NULL)
+    {
+        status = clReleaseCommandQueue(deviceQueue);
+        CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.");
+    }
+    status = clReleaseProgram(program);
+    CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.");
+    status = clReleaseCommandQueue(queue);
+    CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.");
+    status = clReleaseContext(context);
+    CHECK_OPENCL_ERROR(status, "clReleaseContext failed.");
+
+    FREE(devices);
+    delete sampleArgs;
+    return verified ? SDK_SUCCESS : SDK_FAILURE;
+}
+
+REGISTER_SAMPLE(LAUNCH_PROFILE_SAMPLE, runLaunchProfile);
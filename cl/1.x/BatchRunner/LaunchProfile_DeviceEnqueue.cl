@@ -0,0 +1,41 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+
+/**
+ * Device-side enqueue variant of launchPass, built with -cl-std=CL2.0 :
+ * work-item 0 of each pass enqueues the next one on the default device
+ * queue, the child starting once its parent has completed
+ */
+__kernel
+void launchDevicePass(__global uint *data, const uint n, const uint pass,
+                      const uint last)
+{
+    uint i = get_global_id(0);
+    if(i < n)
+    {
+        data[i] = data[i] * 3u + pass;
+    }
+
+    if(i == 0 && pass + 1 < last)
+    {
+        queue_t q = get_default_queue();
+        ndrange_t range = ndrange_1D(get_global_size(0), get_local_size(0));
+
+        void (^nextPass)(void) = ^{launchDevicePass(data, n, pass + 1, last);};
+        enqueue_kernel(q, CLK_ENQUEUE_FLAGS_WAIT_KERNEL, range, nextPass);
+    }
+}
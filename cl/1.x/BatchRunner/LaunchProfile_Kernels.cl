@@ -0,0 +1,51 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+
+/**
+ * One pass of the launch overhead sequence : every element is updated from
+ * itself, so the result only depends on the order of the passes
+ */
+__kernel
+void launchPass(__global uint *data, const uint n, const uint pass)
+{
+    uint i = get_global_id(0);
+    if(i < n)
+    {
+        data[i] = data[i] * 3u + pass;
+    }
+}
+
+/**
+ * Passes first .. first + count - 1 in a single work-group, separated by a
+ * barrier as a dependent pass would need
+ */
+__kernel
+void launchPersistent(__global uint *data, const uint n, const uint first,
+                      const uint count)
+{
+    uint lid = get_local_id(0);
+    uint localSize = get_local_size(0);
+
+    for(uint pass = first; pass < first + count; pass++)
+    {
+        for(uint i = lid; i < n; i += localSize)
+        {
+            data[i] = data[i] * 3u + pass;
+        }
+        barrier(CLK_GLOBAL_MEM_FENCE);
+    }
+}
@@ -0,0 +1,853 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "TaskGraph.hpp"
+#include "CLTrace.hpp"
+#include <fstream>
+#include <algorithm>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/**
+* Writes 'text' as a JSON string : quotes, backslashes and control
+* characters of task names are escaped
+*/
+static void
+writeJsonString(std::ostream& out, const std::string& text)
+{
+    out << '"';
+    for(size_t i = 0; i < text.size(); i++)
+    {
+        unsigned char c = (unsigned char)text[i];
+        if(c == '"' || c == '\\')
+        {
+            out << '\\' << text[i];
+        }
+        else if(c < 0x20)
+        {
+            char code[8];
+            sprintf(code, "\\u%04x", c);
+            out << code;
+        }
+        else
+        {
+            out << text[i];
+        }
+    }
+    out << '"';
+}
+
+TaskGraph::TaskGraph()
+{
+    context = NULL;
+    device = NULL;
+    computeQueues = 0;
+    outOfOrder = false;
+    scheduled = false;
+    executions = 0;
+}
+
+cl_ulong
+TaskGraph::hostTime()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (cl_ulong)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec s;
+    clock_gettime(CLOCK_MONOTONIC, &s);
+    return (cl_ulong)s.tv_sec * 1000000000 + (cl_ulong)s.tv_nsec;
+#endif
+}
+
+int
+TaskGraph::create(cl_context context, cl_device_id device, cl_uint numQueues)
+{
+    if(numQueues < 1 || numQueues > MAX_GRAPH_QUEUES)
+    {
+        std::cout << "TaskGraph : number of queues must be between 1 and "
+                  << MAX_GRAPH_QUEUES << std::endl;
+        return SDK_FAILURE;
+    }
+
+    this->context = context;
+    this->device = device;
+
+    cl_command_queue_properties supported = 0;
+    cl_int status = clGetDeviceInfo(device, CL_DEVICE_QUEUE_PROPERTIES,
+                                    sizeof(supported), &supported, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo(CL_DEVICE_QUEUE_PROPERTIES) failed.");
+
+    // Out-of-order queues only need the wait lists, in-order ones work too
+    outOfOrder = (supported & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+    cl_command_queue_properties prop = CL_QUEUE_PROFILING_ENABLE;
+    if(outOfOrder)
+    {
+        prop |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+    }
+
+    for(cl_uint i = 0; i < numQueues; i++)
+    {
+        cl_command_queue queue = clCreateCommandQueue(context, device, prop,
+                                 &status);
+        CHECK_OPENCL_ERROR(status, "clCreateCommandQueue failed.");
+        queues.push_back(queue);
+    }
+
+    // With more than one queue the last one is kept for the transfers
+    computeQueues = numQueues > 1 ? numQueues - 1 : 1;
+    return SDK_SUCCESS;
+}
+
+int
+TaskGraph::addTask(const std::string& name, TaskType type)
+{
+    if(!pending.empty())
+    {
+        std::cout << "TaskGraph : tasks cannot be added while executing"
+                  << std::endl;
+        return -1;
+    }
+
+    Task task;
+    task.name = name;
+    task.type = type;
+    task.kernel = NULL;
+    task.workDim = 0;
+    task.hasLocalSize = false;
+    task.buffer = NULL;
+    task.dstBuffer = NULL;
+    task.offset = 0;
+    task.dstOffset = 0;
+    task.size = 0;
+    task.ptr = NULL;
+    task.function = NULL;
+    task.data = NULL;
+    task.level = 0;
+    task.queue = 0;
+    task.event = NULL;
+    tasks.push_back(task);
+
+    scheduled = false;
+    return (int)tasks.size() - 1;
+}
+
+int
+TaskGraph::addKernel(const std::string& name, cl_kernel kernel,
+                     cl_uint workDim, const size_t* globalSize,
+                     const size_t* localSize)
+{
+    if(workDim < 1 || workDim > 3)
+    {
+        std::cout << "TaskGraph : invalid work dimension for " << name
+                  << std::endl;
+        return -1;
+    }
+
+    int index = addTask(name, TASK_KERNEL);
+    if(index < 0)
+    {
+        return -1;
+    }
+
+    Task& task = tasks[index];
+    task.kernel = kernel;
+    task.workDim = workDim;
+    task.hasLocalSize = localSize != NULL;
+    for(cl_uint i = 0; i < workDim; i++)
+    {
+        task.globalSize[i] = globalSize[i];
+        task.localSize[i] = localSize ? localSize[i] : 0;
+    }
+    return index;
+}
+
+int
+TaskGraph::setArg(int task, cl_uint index, size_t size, const void* value)
+{
+    if(task < 0 || task >= (int)tasks.size() || tasks[task].type != TASK_KERNEL)
+    {
+        std::cout << "TaskGraph : setArg on a task that is not a kernel"
+                  << std::endl;
+        return SDK_FAILURE;
+    }
+
+    KernelArg arg;
+    arg.index = index;
+    arg.size = size;
+    if(value)
+    {
+        arg.value.assign((const char*)value, (const char*)value + size);
+    }
+
+    // A second setArg of the same index replaces the first one
+    std::vector<KernelArg>& args = tasks[task].args;
+    for(size_t i = 0; i < args.size(); i++)
+    {
+        if(args[i].index == index)
+        {
+            args[i] = arg;
+            return SDK_SUCCESS;
+        }
+    }
+    args.push_back(arg);
+    return SDK_SUCCESS;
+}
+
+int
+TaskGraph::addWrite(const std::string& name, cl_mem buffer, size_t offset,
+                    size_t size, const void* ptr)
+{
+    int index = addTask(name, TASK_WRITE);
+    if(index >= 0)
+    {
+        tasks[index].buffer = buffer;
+        tasks[index].offset = offset;
+        tasks[index].size = size;
+        tasks[index].ptr = (void*)ptr;
+    }
+    return index;
+}
+
+int
+TaskGraph::addRead(const std::string& name, cl_mem buffer, size_t offset,
+                   size_t size, void* ptr)
+{
+    int index = addTask(name, TASK_READ);
+    if(index >= 0)
+    {
+        tasks[index].buffer = buffer;
+        tasks[index].offset = offset;
+        tasks[index].size = size;
+        tasks[index].ptr = ptr;
+    }
+    return index;
+}
+
+int
+TaskGraph::addCopy(const std::string& name, cl_mem src, size_t srcOffset,
+                   cl_mem dst, size_t dstOffset, size_t size)
+{
+    int index = addTask(name, TASK_COPY);
+    if(index >= 0)
+    {
+        tasks[index].buffer = src;
+        tasks[index].offset = srcOffset;
+        tasks[index].dstBuffer = dst;
+        tasks[index].dstOffset = dstOffset;
+        tasks[index].size = size;
+    }
+    return index;
+}
+
+int
+TaskGraph::addHost(const std::string& name, HostFunction function, void* data)
+{
+    int index = addTask(name, TASK_HOST);
+    if(index >= 0)
+    {
+        tasks[index].function = function;
+        tasks[index].data = data;
+    }
+    return index;
+}
+
+int
+TaskGraph::dependsOn(int task, int dependency)
+{
+    if(task < 0 || task >= (int)tasks.size() || dependency < 0 ||
+            dependency >= (int)tasks.size() || task == dependency)
+    {
+        std::cout << "TaskGraph : invalid dependency " << task << " -> "
+                  << dependency << std::endl;
+        return SDK_FAILURE;
+    }
+    if(!pending.empty())
+    {
+        std::cout << "TaskGraph : dependencies cannot change while executing"
+                  << std::endl;
+        return SDK_FAILURE;
+    }
+
+    std::vector<int>& dependencies = tasks[task].dependencies;
+    if(std::find(dependencies.begin(), dependencies.end(), dependency) ==
+            dependencies.end())
+    {
+        dependencies.push_back(dependency);
+        tasks[dependency].dependents.push_back(task);
+    }
+    scheduled = false;
+    return SDK_SUCCESS;
+}
+
+int
+TaskGraph::schedule()
+{
+    if(queues.empty())
+    {
+        std::cout << "TaskGraph : create() was not called" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    // Topological order, levels are the longest path from a root
+    std::vector<size_t> remaining(tasks.size());
+    std::vector<int> ready;
+    for(size_t i = 0; i < tasks.size(); i++)
+    {
+        remaining[i] = tasks[i].dependencies.size();
+        tasks[i].level = 0;
+        if(remaining[i] == 0)
+        {
+            ready.push_back((int)i);
+        }
+    }
+
+    order.clear();
+    for(size_t next = 0; next < ready.size(); next++)
+    {
+        int index = ready[next];
+        order.push_back(index);
+        for(size_t j = 0; j < tasks[index].dependents.size(); j++)
+        {
+            int dependent = tasks[index].dependents[j];
+            tasks[dependent].level = std::max(tasks[dependent].level,
+                                              tasks[index].level + 1);
+            if(--remaining[dependent] == 0)
+            {
+                ready.push_back(dependent);
+            }
+        }
+    }
+
+    if(order.size() != tasks.size())
+    {
+        std::cout << "TaskGraph : the dependencies have a cycle" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    /*
+     * A kernel continues the queue of the first kernel it depends on, so
+     * chains stay on one queue and cross-queue waits are only needed where
+     * the graph forks or joins. The other kernels are spread round-robin.
+     */
+    cl_uint transferQueue = (cl_uint)queues.size() - 1;
+    cl_uint nextQueue = 0;
+    std::vector<bool> continued(tasks.size(), false);
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        Task& task = tasks[order[i]];
+        if(task.type == TASK_HOST)
+        {
+            task.queue = (cl_uint)queues.size();
+            continue;
+        }
+        if(task.type != TASK_KERNEL)
+        {
+            task.queue = transferQueue;
+            continue;
+        }
+
+        int parent = -1;
+        for(size_t j = 0; j < task.dependencies.size(); j++)
+        {
+            int dependency = task.dependencies[j];
+            if(tasks[dependency].type == TASK_KERNEL && !continued[dependency])
+            {
+                parent = dependency;
+                break;
+            }
+        }
+
+        if(parent >= 0)
+        {
+            continued[parent] = true;
+            task.queue = tasks[parent].queue;
+        }
+        else
+        {
+            task.queue = nextQueue;
+            nextQueue = (nextQueue + 1) % computeQueues;
+        }
+    }
+
+    scheduled = true;
+    return SDK_SUCCESS;
+}
+
+int
+TaskGraph::enqueueTask(int index, const std::vector<cl_event>& previous)
+{
+    Task& task = tasks[index];
+
+    std::vector<cl_event> waitList;
+    for(size_t i = 0; i < task.dependencies.size(); i++)
+    {
+        waitList.push_back(tasks[task.dependencies[i]].event);
+    }
+    if(task.dependencies.empty())
+    {
+        waitList = previous;
+    }
+    cl_uint numEvents = (cl_uint)waitList.size();
+    const cl_event* events = numEvents ? &waitList[0] : NULL;
+
+    cl_command_queue queue = queues[task.queue];
+    cl_int status = CL_SUCCESS;
+    switch(task.type)
+    {
+    case TASK_KERNEL:
+        for(size_t i = 0; i < task.args.size(); i++)
+        {
+            const KernelArg& arg = task.args[i];
+            status = clSetKernelArg(task.kernel, arg.index, arg.size,
+                                    arg.value.empty() ? NULL : &arg.value[0]);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.");
+        }
+        status = clEnqueueNDRangeKernel(queue, task.kernel, task.workDim, NULL,
+                                        task.globalSize,
+                                        task.hasLocalSize ? task.localSize : NULL,
+                                        numEvents, events, &task.event);
+        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+        break;
+    case TASK_WRITE:
+        status = clEnqueueWriteBuffer(queue, task.buffer, CL_FALSE, task.offset,
+                                      task.size, task.ptr, numEvents, events,
+                                      &task.event);
+        CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed.");
+        break;
+    case TASK_READ:
+        status = clEnqueueReadBuffer(queue, task.buffer, CL_FALSE, task.offset,
+                                     task.size, task.ptr, numEvents, events,
+                                     &task.event);
+        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.");
+        break;
+    case TASK_COPY:
+        status = clEnqueueCopyBuffer(queue, task.buffer, task.dstBuffer,
+                                     task.offset, task.dstOffset, task.size,
+                                     numEvents, events, &task.event);
+        CHECK_OPENCL_ERROR(status, "clEnqueueCopyBuffer failed.");
+        break;
+    default:
+        return SDK_FAILURE;
+    }
+
+    return SDK_SUCCESS;
+}
+
+void
+TaskGraph::runHostTask(HostRun* run)
+{
+    Task& task = run->graph->tasks[run->task];
+    if(run->status == CL_SUCCESS)
+    {
+        CL_TRACE_SCOPE(task.name);
+        run->start = hostTime();
+        if(task.function(task.data) != SDK_SUCCESS)
+        {
+            run->status = CL_INVALID_OPERATION;
+        }
+        run->end = hostTime();
+    }
+
+    /*
+     * Commands waiting on a user event set to an error are implementation
+     * defined and may never run, so the event always completes and wait()
+     * reports the failure
+     */
+    clSetUserEventStatus(run->event, CL_COMPLETE);
+}
+
+void CL_CALLBACK
+TaskGraph::inputComplete(cl_event event, cl_int status, void* data)
+{
+    HostRun* run = (HostRun*)data;
+
+    run->graph->lock.lock();
+    if(status < 0)
+    {
+        run->status = status;
+    }
+    bool ready = --run->waiting == 0;
+    run->graph->lock.unlock();
+
+    if(ready)
+    {
+        runHostTask(run);
+    }
+}
+
+int
+TaskGraph::armHostTask(HostRun* run, const std::vector<cl_event>& previous)
+{
+    Task& task = tasks[run->task];
+
+    std::vector<cl_event> inputs;
+    for(size_t i = 0; i < task.dependencies.size(); i++)
+    {
+        inputs.push_back(tasks[task.dependencies[i]].event);
+    }
+    if(task.dependencies.empty())
+    {
+        inputs = previous;
+    }
+
+    if(inputs.empty())
+    {
+        // Nothing to wait for, the device already has its work
+        runHostTask(run);
+        return SDK_SUCCESS;
+    }
+
+    // Set before the first callback, which may fire immediately
+    run->waiting = (cl_uint)inputs.size();
+    for(size_t i = 0; i < inputs.size(); i++)
+    {
+        cl_int status = clSetEventCallback(inputs[i], CL_COMPLETE,
+                                           inputComplete, run);
+        CHECK_OPENCL_ERROR(status, "clSetEventCallback failed.");
+    }
+    return SDK_SUCCESS;
+}
+
+int
+TaskGraph::execute()
+{
+    if(!scheduled && schedule() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
+    // Every task leads to a sink, so the sinks complete an execution
+    std::vector<cl_event> previous;
+    if(!pending.empty())
+    {
+        for(size_t i = 0; i < tasks.size(); i++)
+        {
+            if(tasks[i].dependents.empty())
+            {
+                previous.push_back(tasks[i].event);
+            }
+        }
+    }
+
+    Execution execution;
+    execution.hostEnqueue = 0;
+    execution.firstDeviceTask = -1;
+
+    // User events first : device tasks may wait on host tasks
+    cl_int status;
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        Task& task = tasks[order[i]];
+        task.event = NULL;
+        if(task.type == TASK_HOST)
+        {
+            HostRun* run = new HostRun;
+            run->graph = this;
+            run->task = order[i];
+            run->waiting = 0;
+            run->status = CL_SUCCESS;
+            run->start = 0;
+            run->end = 0;
+            run->event = clCreateUserEvent(context, &status);
+            CHECK_OPENCL_ERROR(status, "clCreateUserEvent failed.");
+            task.event = run->event;
+            execution.hostRuns.push_back(run);
+        }
+    }
+
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        if(tasks[order[i]].type == TASK_HOST)
+        {
+            continue;
+        }
+        if(execution.firstDeviceTask < 0)
+        {
+            execution.firstDeviceTask = order[i];
+            execution.hostEnqueue = hostTime();
+        }
+        if(enqueueTask(order[i], previous) != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+    }
+
+    for(size_t i = 0; i < queues.size(); i++)
+    {
+        status = clFlush(queues[i]);
+        CHECK_OPENCL_ERROR(status, "clFlush failed.");
+    }
+
+    for(size_t i = 0; i < execution.hostRuns.size(); i++)
+    {
+        if(armHostTask(execution.hostRuns[i], previous) != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+    }
+
+    for(size_t i = 0; i < tasks.size(); i++)
+    {
+        execution.events.push_back(tasks[i].event);
+    }
+    pending.push_back(execution);
+    return SDK_SUCCESS;
+}
+
+int
+TaskGraph::wait()
+{
+    int result = SDK_SUCCESS;
+    cl_uint hostLane = (cl_uint)queues.size();
+
+    for(size_t e = 0; e < pending.size(); e++)
+    {
+        Execution& execution = pending[e];
+
+        // One by one : a failed event must not leave the others running
+        for(size_t i = 0; i < execution.events.size(); i++)
+        {
+            if(clWaitForEvents(1, &execution.events[i]) != CL_SUCCESS)
+            {
+                std::cout << "TaskGraph : task " << tasks[i].name << " failed"
+                          << std::endl;
+                result = SDK_FAILURE;
+            }
+        }
+
+        // Host times are moved to the device clock through the first enqueue
+        cl_ulong offset = 0;
+        if(execution.firstDeviceTask >= 0)
+        {
+            cl_ulong queued = 0;
+            if(clGetEventProfilingInfo(execution.events[execution.firstDeviceTask],
+                                       CL_PROFILING_COMMAND_QUEUED, sizeof(queued),
+                                       &queued, NULL) == CL_SUCCESS)
+            {
+                offset = queued - execution.hostEnqueue;
+            }
+        }
+
+        for(size_t i = 0; i < execution.hostRuns.size(); i++)
+        {
+            HostRun* run = execution.hostRuns[i];
+            if(run->status != CL_SUCCESS)
+            {
+                std::cout << "TaskGraph : host task " << tasks[run->task].name
+                          << " failed" << std::endl;
+                result = SDK_FAILURE;
+            }
+        }
+
+        if(result == SDK_SUCCESS)
+        {
+            for(size_t i = 0; i < tasks.size(); i++)
+            {
+                if(tasks[i].type == TASK_HOST)
+                {
+                    continue;
+                }
+                Record record;
+                record.task = (int)i;
+                record.lane = tasks[i].queue;
+                record.execution = executions;
+                cl_int status = clGetEventProfilingInfo(execution.events[i],
+                                                        CL_PROFILING_COMMAND_START,
+                                                        sizeof(cl_ulong), &record.start, NULL);
+                status |= clGetEventProfilingInfo(execution.events[i],
+                                                  CL_PROFILING_COMMAND_END,
+                                                  sizeof(cl_ulong), &record.end, NULL);
+                if(status == CL_SUCCESS)
+                {
+                    records.push_back(record);
+                }
+            }
+
+            for(size_t i = 0; i < execution.hostRuns.size(); i++)
+            {
+                HostRun* run = execution.hostRuns[i];
+                Record record;
+                record.task = run->task;
+                record.lane = hostLane;
+                record.execution = executions;
+                record.start = run->start + offset;
+                record.end = run->end + offset;
+                records.push_back(record);
+            }
+        }
+        executions++;
+
+        for(size_t i = 0; i < execution.events.size(); i++)
+        {
+            clReleaseEvent(execution.events[i]);
+        }
+        for(size_t i = 0; i < execution.hostRuns.size(); i++)
+        {
+            delete execution.hostRuns[i];
+        }
+    }
+
+    pending.clear();
+    for(size_t i = 0; i < tasks.size(); i++)
+    {
+        tasks[i].event = NULL;
+    }
+    return result;
+}
+
+cl_uint
+TaskGraph::getNumQueues()
+{
+    return (cl_uint)queues.size();
+}
+
+void
+TaskGraph::printStats()
+{
+    // Busy time, makespan and peak overlap of every execution
+    cl_ulong busy = 0;
+    cl_ulong makespan = 0;
+    int peak = 0;
+    size_t first = 0;
+    while(first < records.size())
+    {
+        size_t last = first;
+        cl_ulong begin = records[first].start;
+        cl_ulong end = records[first].end;
+        std::vector<std::pair<cl_ulong, int> > edges;
+        while(last < records.size() &&
+                records[last].execution == records[first].execution)
+        {
+            busy += records[last].end - records[last].start;
+            begin = std::min(begin, records[last].start);
+            end = std::max(end, records[last].end);
+            edges.push_back(std::make_pair(records[last].start, 1));
+            edges.push_back(std::make_pair(records[last].end, -1));
+            last++;
+        }
+        makespan += end - begin;
+
+        // Ends sort before starts at the same time
+        std::sort(edges.begin(), edges.end());
+        int running = 0;
+        for(size_t i = 0; i < edges.size(); i++)
+        {
+            running += edges[i].second;
+            peak = std::max(peak, running);
+        }
+        first = last;
+    }
+
+    std::string strArray[7] =
+    {
+        "Tasks", "Queues", "Out-of-order", "Executions", "Avg. makespan (ms)",
+        "Avg. concurrency", "Peak concurrency"
+    };
+    std::string stats[7];
+    stats[0] = toString(tasks.size(), std::dec);
+    stats[1] = toString(queues.size(), std::dec);
+    stats[2] = outOfOrder ? "yes" : "no";
+    stats[3] = toString(executions, std::dec);
+    stats[4] = toString(executions ? makespan / 1e6 / executions : 0.0, std::dec);
+    stats[5] = toString(makespan ? (double)busy / makespan : 0.0, std::dec);
+    stats[6] = toString(peak, std::dec);
+    printStatistics(strArray, stats, 7);
+}
+
+void
+TaskGraph::resetStats()
+{
+    records.clear();
+    executions = 0;
+}
+
+int
+TaskGraph::writeTrace(const std::string& fileName)
+{
+    std::ofstream trace(fileName.c_str());
+    if(!trace)
+    {
+        std::cout << "TaskGraph : cannot open " << fileName << std::endl;
+        return SDK_FAILURE;
+    }
+
+    cl_ulong origin = 0;
+    for(size_t i = 0; i < records.size(); i++)
+    {
+        if(i == 0 || records[i].start < origin)
+        {
+            origin = records[i].start;
+        }
+    }
+
+    trace << "{\"traceEvents\":[" << std::endl;
+    for(cl_uint lane = 0; lane <= queues.size(); lane++)
+    {
+        std::string laneName = lane == queues.size() ? "Host" :
+                               "Queue " + toString(lane, std::dec) +
+                               (queues.size() > 1 && lane == queues.size() - 1 ?
+                                " (transfers)" : "");
+        trace << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+              << lane << ",\"args\":{\"name\":\"" << laneName << "\"}}," << std::endl;
+    }
+
+    const char* categories[] = { "kernel", "write", "read", "copy", "host" };
+    trace.setf(std::ios::fixed);
+    trace.precision(3);
+    for(size_t i = 0; i < records.size(); i++)
+    {
+        const Record& record = records[i];
+        const Task& task = tasks[record.task];
+        trace << "{\"name\":";
+        writeJsonString(trace, task.name);
+        trace << ",\"cat\":\"" << categories[task.type]
+              << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << record.lane
+              << ",\"ts\":" << (record.start - origin) / 1e3
+              << ",\"dur\":" << (record.end - record.start) / 1e3
+              << ",\"args\":{\"execution\":" << record.execution;
+        if(task.size)
+        {
+            trace << ",\"bytes\":" << task.size;
+        }
+        trace << "}}" << (i + 1 < records.size() ? "," : "") << std::endl;
+    }
+    trace << "]}" << std::endl;
+
+    return SDK_SUCCESS;
+}
+
+int
+TaskGraph::release()
+{
+    int result = wait();
+
+    for(size_t i = 0; i < queues.size(); i++)
+    {
+        cl_int status = clReleaseCommandQueue(queues[i]);
+        CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.");
+    }
+    queues.clear();
+    scheduled = false;
+    return result;
+}
@@ -0,0 +1,262 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef TASK_GRAPH_H_
+#define TASK_GRAPH_H_
+
+/**
+ * TaskGraph
+ * Declarative schedule of the kernels, transfers and host callbacks of a
+ * sample. Every task names the tasks it depends on, execute() enqueues the
+ * whole graph at once on a set of queues with event wait lists for the
+ * dependencies and returns without waiting : independent kernels land on
+ * different compute queues, transfers go to a queue of their own so they
+ * overlap with compute, and host callbacks run from event callbacks as soon
+ * as their inputs are ready. Queues are created out-of-order when the
+ * device allows it. Profiling of the executed tasks gives the achieved
+ * concurrency and a Chrome trace (chrome://tracing) of every queue.
+ */
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+#include "CLUtil.hpp"
+#include "SDKThread.hpp"
+
+using namespace appsdk;
+
+#define MAX_GRAPH_QUEUES 8          ///< Most queues of a graph
+
+/**
+* TaskGraph
+* Dependency graph of OpenCL commands and host callbacks
+*/
+class TaskGraph
+{
+    public:
+        enum TaskType
+        {
+            TASK_KERNEL,
+            TASK_WRITE,
+            TASK_READ,
+            TASK_COPY,
+            TASK_HOST
+        };
+
+        /**
+        * Host callback, returns SDK_SUCCESS or SDK_FAILURE. It runs on a
+        * thread of the OpenCL runtime and must not block on the graph.
+        */
+        typedef int (*HostFunction)(void* data);
+
+    private:
+        /**
+        * Kernel argument captured when the task is declared
+        */
+        struct KernelArg
+        {
+            cl_uint index;
+            size_t size;
+            std::vector<char> value;    /**< Empty for local memory */
+        };
+
+        struct Task
+        {
+            std::string name;
+            TaskType type;
+            cl_kernel kernel;
+            cl_uint workDim;
+            size_t globalSize[3];
+            size_t localSize[3];
+            bool hasLocalSize;
+            std::vector<KernelArg> args;
+            cl_mem buffer;              /**< Source of a copy */
+            cl_mem dstBuffer;           /**< Destination of a copy */
+            size_t offset;
+            size_t dstOffset;
+            size_t size;                /**< Bytes of a transfer */
+            void* ptr;                  /**< Host side of a transfer */
+            HostFunction function;
+            void* data;
+            std::vector<int> dependencies;
+            std::vector<int> dependents;
+            cl_uint level;              /**< Longest path from a root */
+            cl_uint queue;              /**< Assigned queue */
+            cl_event event;             /**< Completion of the last execution */
+        };
+
+        /**
+        * One execution of a host task, owned by its Execution
+        */
+        struct HostRun
+        {
+            TaskGraph* graph;
+            int task;
+            cl_event event;             /**< User event completed by the task */
+            cl_uint waiting;            /**< Inputs not complete yet */
+            cl_int status;              /**< Failed input or callback */
+            cl_ulong start;             /**< Host clock, ns */
+            cl_ulong end;
+        };
+
+        /**
+        * Executed command, in device clock ns
+        */
+        struct Record
+        {
+            int task;
+            cl_uint lane;               /**< Queue, host tasks after the queues */
+            cl_uint execution;
+            cl_ulong start;
+            cl_ulong end;
+        };
+
+        /**
+        * Execution not waited for yet
+        */
+        struct Execution
+        {
+            std::vector<cl_event> events;   /**< One per task */
+            std::vector<HostRun*> hostRuns; /**< One per host task */
+            cl_ulong hostEnqueue;           /**< Host clock at the first enqueue */
+            int firstDeviceTask;            /**< Task enqueued at hostEnqueue */
+        };
+
+        cl_context context;
+        cl_device_id device;
+        std::vector<cl_command_queue> queues;
+        cl_uint computeQueues;          /**< Queues 0..computeQueues-1 run kernels */
+        bool outOfOrder;                /**< Queues created out-of-order */
+        std::vector<Task> tasks;
+        std::vector<int> order;         /**< Topological order */
+        bool scheduled;
+        std::vector<Execution> pending;
+        std::vector<Record> records;
+        cl_uint executions;
+        ThreadLock lock;
+
+        int addTask(const std::string& name, TaskType type);
+        int schedule();
+        int enqueueTask(int index, const std::vector<cl_event>& previous);
+        int armHostTask(HostRun* run, const std::vector<cl_event>& previous);
+        static void runHostTask(HostRun* run);
+        static void CL_CALLBACK inputComplete(cl_event event, cl_int status,
+                                              void* data);
+        static cl_ulong hostTime();
+
+    public:
+        TaskGraph();
+
+        /**
+        * Creates the queues of the graph
+        * @param context context of the queues
+        * @param device device of the queues
+        * @param numQueues queues to use, the last one takes the transfers
+        * when there is more than one
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int create(cl_context context, cl_device_id device, cl_uint numQueues);
+
+        /**
+        * Declares an NDRange launch, arguments are set with setArg()
+        * @return task id, -1 on failure
+        */
+        int addKernel(const std::string& name, cl_kernel kernel, cl_uint workDim,
+                      const size_t* globalSize, const size_t* localSize);
+
+        /**
+        * Captures an argument of a kernel task, a NULL value declares
+        * 'size' bytes of local memory
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int setArg(int task, cl_uint index, size_t size, const void* value);
+
+        /**
+        * Declares a host to device transfer of 'size' bytes
+        * @return task id, -1 on failure
+        */
+        int addWrite(const std::string& name, cl_mem buffer, size_t offset,
+                     size_t size, const void* ptr);
+
+        /**
+        * Declares a device to host transfer of 'size' bytes
+        * @return task id, -1 on failure
+        */
+        int addRead(const std::string& name, cl_mem buffer, size_t offset,
+                    size_t size, void* ptr);
+
+        /**
+        * Declares a device to device copy of 'size' bytes
+        * @return task id, -1 on failure
+        */
+        int addCopy(const std::string& name, cl_mem src, size_t srcOffset,
+                    cl_mem dst, size_t dstOffset, size_t size);
+
+        /**
+        * Declares a host callback
+        * @return task id, -1 on failure
+        */
+        int addHost(const std::string& name, HostFunction function, void* data);
+
+        /**
+        * 'task' starts after 'dependency' completed
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int dependsOn(int task, int dependency);
+
+        /**
+        * Enqueues every task and flushes the queues without waiting. A
+        * second execution starts once the previous one completed.
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int execute();
+
+        /**
+        * Waits for the executions in flight and collects their profiling
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int wait();
+
+        /**
+        * Number of queues actually running the graph
+        */
+        cl_uint getNumQueues();
+
+        /**
+        * Prints the achieved concurrency of the waited executions
+        */
+        void printStats();
+
+        /**
+        * Forgets the waited executions, e.g. after a warm-up
+        */
+        void resetStats();
+
+        /**
+        * Writes the waited executions as a Chrome trace
+        * @param fileName JSON file
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int writeTrace(const std::string& fileName);
+
+        /**
+        * Waits and releases the queues, the collected profiling is kept
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int release();
+};
+
+#endif  // TASK_GRAPH_H_
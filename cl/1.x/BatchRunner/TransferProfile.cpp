@@ -0,0 +1,1101 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "TransferProfile.hpp"
+#include "CLRuntime.hpp"
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <cctype>
+
+static const char* pathNames[NUM_TRANSFER_PATHS] =
+{
+    "direct",
+    "staged",
+    "mapped",
+    "hostptr",
+    "persistent"
+};
+
+static const char* imageNames[NUM_IMAGE_TRANSFERS] =
+{
+    "write",
+    "read",
+    "map",
+    "from-buffer",
+    "to-buffer"
+};
+
+/**
+* Image formats of the sweep
+*/
+static const struct
+{
+    cl_image_format format;
+    size_t elementSize;
+    const char* name;
+} imageFormats[] =
+{
+    { { CL_RGBA, CL_UNSIGNED_INT8 }, 4, "RGBA8" },
+    { { CL_R, CL_FLOAT }, 4, "R32F" },
+    { { CL_RGBA, CL_FLOAT }, 16, "RGBA32F" }
+};
+
+static const int numImageFormats = sizeof(imageFormats) /
+                                   sizeof(imageFormats[0]);
+
+/**
+* Hands the last command of a transfer to the caller : waits for it when the
+* transfer is blocking, then returns it through 'event' or releases it
+*/
+static cl_int
+complete(cl_int status, cl_event done, cl_bool blocking, cl_event* event)
+{
+    if(status != CL_SUCCESS)
+    {
+        return status;
+    }
+    if(blocking)
+    {
+        status = clWaitForEvents(1, &done);
+    }
+    if(event != NULL && status == CL_SUCCESS)
+    {
+        *event = done;
+    }
+    else
+    {
+        clReleaseEvent(done);
+    }
+    return status;
+}
+
+static cl_context
+queueContext(cl_command_queue queue)
+{
+    cl_context context = NULL;
+    clGetCommandQueueInfo(queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context,
+                          NULL);
+    return context;
+}
+
+/**
+* CL_MEM_USE_PERSISTENT_MEM_AMD is only known to the AMD platform
+*/
+static bool
+isAmdDevice(cl_device_id device)
+{
+    cl_platform_id platform;
+    char vendor[256] = "";
+    if(clGetDeviceInfo(device, CL_DEVICE_PLATFORM, sizeof(platform), &platform,
+                       NULL) != CL_SUCCESS ||
+            clGetPlatformInfo(platform, CL_PLATFORM_VENDOR, sizeof(vendor), vendor,
+                              NULL) != CL_SUCCESS)
+    {
+        return false;
+    }
+    return strcmp(vendor, "Advanced Micro Devices, Inc.") == 0;
+}
+
+static cl_int
+mappedUpload(cl_command_queue queue, cl_mem buffer, cl_bool blocking,
+             size_t offset, size_t size, const void* ptr, cl_uint numEvents,
+             const cl_event* waitList, cl_event* event)
+{
+    cl_int status;
+    void* mapped = clEnqueueMapBuffer(queue, buffer, CL_TRUE,
+                                      CL_MAP_WRITE_INVALIDATE_REGION, offset,
+                                      size, numEvents, waitList, NULL, &status);
+    if(status != CL_SUCCESS)
+    {
+        return status;
+    }
+    memcpy(mapped, ptr, size);
+
+    cl_event done;
+    status = clEnqueueUnmapMemObject(queue, buffer, mapped, 0, NULL, &done);
+    return complete(status, done, blocking, event);
+}
+
+static cl_int
+mappedDownload(cl_command_queue queue, cl_mem buffer, cl_bool blocking,
+               size_t offset, size_t size, void* ptr, cl_uint numEvents,
+               const cl_event* waitList, cl_event* event)
+{
+    cl_int status;
+    void* mapped = clEnqueueMapBuffer(queue, buffer, CL_TRUE, CL_MAP_READ,
+                                      offset, size, numEvents, waitList, NULL,
+                                      &status);
+    if(status != CL_SUCCESS)
+    {
+        return status;
+    }
+    memcpy(ptr, mapped, size);
+
+    cl_event done;
+    status = clEnqueueUnmapMemObject(queue, buffer, mapped, 0, NULL, &done);
+    return complete(status, done, blocking, event);
+}
+
+static cl_int
+hostPtrUpload(cl_command_queue queue, cl_mem buffer, cl_bool blocking,
+              size_t offset, size_t size, const void* ptr, cl_uint numEvents,
+              const cl_event* waitList, cl_event* event)
+{
+    cl_int status;
+    cl_mem wrap = clCreateBuffer(queueContext(queue),
+                                 CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, size,
+                                 (void*)ptr, &status);
+    if(status != CL_SUCCESS)
+    {
+        return status;
+    }
+
+    // The wrapper lives until the copy is done
+    cl_event done;
+    status = clEnqueueCopyBuffer(queue, wrap, buffer, 0, offset, size,
+                                 numEvents, waitList, &done);
+    clReleaseMemObject(wrap);
+    return complete(status, done, blocking, event);
+}
+
+static cl_int
+hostPtrDownload(cl_command_queue queue, cl_mem buffer, cl_bool blocking,
+                size_t offset, size_t size, void* ptr, cl_uint numEvents,
+                const cl_event* waitList, cl_event* event)
+{
+    cl_int status;
+    cl_mem wrap = clCreateBuffer(queueContext(queue),
+                                 CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, size,
+                                 ptr, &status);
+    if(status != CL_SUCCESS)
+    {
+        return status;
+    }
+
+    /*
+     * The copy lands in the wrapper, mapping it makes 'ptr' up to date. The
+     * commands are chained by events for out-of-order queues.
+     */
+    cl_event copied;
+    status = clEnqueueCopyBuffer(queue, buffer, wrap, offset, 0, size,
+                                 numEvents, waitList, &copied);
+    if(status != CL_SUCCESS)
+    {
+        clReleaseMemObject(wrap);
+        return status;
+    }
+
+    cl_event mappedEvent;
+    void* mapped = clEnqueueMapBuffer(queue, wrap, CL_FALSE, CL_MAP_READ, 0,
+                                      size, 1, &copied, &mappedEvent, &status);
+    clReleaseEvent(copied);
+    if(status != CL_SUCCESS)
+    {
+        clReleaseMemObject(wrap);
+        return status;
+    }
+
+    cl_event done;
+    status = clEnqueueUnmapMemObject(queue, wrap, mapped, 1, &mappedEvent,
+                                     &done);
+    clReleaseEvent(mappedEvent);
+    clReleaseMemObject(wrap);
+    return complete(status, done, blocking, event);
+}
+
+static cl_int
+persistentUpload(cl_command_queue queue, cl_mem buffer, cl_bool blocking,
+                 size_t offset, size_t size, const void* ptr,
+                 cl_uint numEvents, const cl_event* waitList, cl_event* event)
+{
+    cl_int status;
+    cl_mem stage = clCreateBuffer(queueContext(queue),
+                                  CL_MEM_READ_ONLY | CL_MEM_USE_PERSISTENT_MEM_AMD,
+                                  size, NULL, &status);
+    if(status != CL_SUCCESS)
+    {
+        return status;
+    }
+
+    void* mapped = clEnqueueMapBuffer(queue, stage, CL_TRUE,
+                                      CL_MAP_WRITE_INVALIDATE_REGION, 0, size,
+                                      0, NULL, NULL, &status);
+    if(status != CL_SUCCESS)
+    {
+        clReleaseMemObject(stage);
+        return status;
+    }
+    memcpy(mapped, ptr, size);
+
+    cl_event unmapped;
+    status = clEnqueueUnmapMemObject(queue, stage, mapped, 0, NULL, &unmapped);
+    if(status != CL_SUCCESS)
+    {
+        clReleaseMemObject(stage);
+        return status;
+    }
+
+    // The device copy waits for the caller's events and the unmap
+    std::vector<cl_event> wait(waitList, waitList + numEvents);
+    wait.push_back(unmapped);
+
+    cl_event done;
+    status = clEnqueueCopyBuffer(queue, stage, buffer, 0, offset, size,
+                                 (cl_uint)wait.size(), &wait[0], &done);
+    clReleaseEvent(unmapped);
+    clReleaseMemObject(stage);
+    return complete(status, done, blocking, event);
+}
+
+static cl_int
+persistentDownload(cl_command_queue queue, cl_mem buffer, cl_bool blocking,
+                   size_t offset, size_t size, void* ptr, cl_uint numEvents,
+                   const cl_event* waitList, cl_event* event)
+{
+    cl_int status;
+    cl_mem stage = clCreateBuffer(queueContext(queue),
+                                  CL_MEM_READ_WRITE | CL_MEM_USE_PERSISTENT_MEM_AMD,
+                                  size, NULL, &status);
+    if(status != CL_SUCCESS)
+    {
+        return status;
+    }
+
+    cl_event copied;
+    status = clEnqueueCopyBuffer(queue, buffer, stage, offset, 0, size,
+                                 numEvents, waitList, &copied);
+    if(status != CL_SUCCESS)
+    {
+        clReleaseMemObject(stage);
+        return status;
+    }
+
+    void* mapped = clEnqueueMapBuffer(queue, stage, CL_TRUE, CL_MAP_READ, 0,
+                                      size, 1, &copied, NULL, &status);
+    clReleaseEvent(copied);
+    if(status != CL_SUCCESS)
+    {
+        clReleaseMemObject(stage);
+        return status;
+    }
+    memcpy(ptr, mapped, size);
+
+    cl_event done;
+    status = clEnqueueUnmapMemObject(queue, stage, mapped, 0, NULL, &done);
+    clReleaseMemObject(stage);
+    return complete(status, done, blocking, event);
+}
+
+TransferProfile::TransferProfile()
+{
+}
+
+const char*
+TransferProfile::pathName(TransferPath path)
+{
+    return pathNames[path];
+}
+
+std::string
+TransferProfile::fileName(cl_device_id device)
+{
+    char name[256] = "";
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+
+    std::string file = "TransferProfile_";
+    for(const char* c = name; *c != '\0'; c++)
+    {
+        file += isalnum((unsigned char)*c) ? *c : '_';
+    }
+    return file + ".txt";
+}
+
+cl_int
+TransferProfile::upload(TransferPath path, StagingRing* ring,
+                        cl_command_queue queue, cl_mem buffer,
+                        cl_bool blocking, size_t offset, size_t size,
+                        const void* ptr, cl_uint numEvents,
+                        const cl_event* waitList, cl_event* event)
+{
+    if(size == 0)
+    {
+        path = PATH_DIRECT;
+    }
+
+    switch(path)
+    {
+    case PATH_STAGED:
+        if(ring != NULL)
+        {
+            return ring->write(queue, buffer, blocking, offset, size, ptr,
+                               numEvents, waitList, event);
+        }
+        break;
+    case PATH_MAPPED:
+        return mappedUpload(queue, buffer, blocking, offset, size, ptr,
+                            numEvents, waitList, event);
+    case PATH_HOST_PTR:
+        return hostPtrUpload(queue, buffer, blocking, offset, size, ptr,
+                             numEvents, waitList, event);
+    case PATH_PERSISTENT:
+        return persistentUpload(queue, buffer, blocking, offset, size, ptr,
+                                numEvents, waitList, event);
+    default:
+        break;
+    }
+
+    return clEnqueueWriteBuffer(queue, buffer, blocking, offset, size, ptr,
+                                numEvents, waitList, event);
+}
+
+cl_int
+TransferProfile::download(TransferPath path, StagingRing* ring,
+                          cl_command_queue queue, cl_mem buffer,
+                          cl_bool blocking, size_t offset, size_t size,
+                          void* ptr, cl_uint numEvents,
+                          const cl_event* waitList, cl_event* event)
+{
+    if(size == 0)
+    {
+        path = PATH_DIRECT;
+    }
+
+    switch(path)
+    {
+    case PATH_STAGED:
+        if(ring != NULL)
+        {
+            return ring->read(queue, buffer, blocking, offset, size, ptr,
+                              numEvents, waitList, event);
+        }
+        break;
+    case PATH_MAPPED:
+        return mappedDownload(queue, buffer, blocking, offset, size, ptr,
+                              numEvents, waitList, event);
+    case PATH_HOST_PTR:
+        return hostPtrDownload(queue, buffer, blocking, offset, size, ptr,
+                               numEvents, waitList, event);
+    case PATH_PERSISTENT:
+        return persistentDownload(queue, buffer, blocking, offset, size, ptr,
+                                  numEvents, waitList, event);
+    default:
+        break;
+    }
+
+    return clEnqueueReadBuffer(queue, buffer, blocking, offset, size, ptr,
+                               numEvents, waitList, event);
+}
+
+int
+TransferProfile::measure(cl_command_queue queue, StagingRing* ring,
+                         const TransferSweep& sweep)
+{
+    cl_int status;
+
+    cl_context context = queueContext(queue);
+    cl_device_id deviceId;
+    status = clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id),
+                                   &deviceId, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetCommandQueueInfo failed.");
+
+    char name[256] = "";
+    status = clGetDeviceInfo(deviceId, CL_DEVICE_NAME, sizeof(name), name, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo(CL_DEVICE_NAME) failed.");
+    device = name;
+
+    cl_ulong maxAlloc;
+    status = clGetDeviceInfo(deviceId, CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+                             sizeof(cl_ulong), &maxAlloc, NULL);
+    CHECK_OPENCL_ERROR(status,
+                       "clGetDeviceInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE) failed.");
+
+    bool persistent = isAmdDevice(deviceId);
+
+    size_t maxSize = sweep.maxSize;
+    if(maxSize > maxAlloc)
+    {
+        maxSize = (size_t)maxAlloc;
+    }
+    if(sweep.minSize == 0 || sweep.minSize > maxSize || sweep.iterations < 1)
+    {
+        std::cout << "Invalid transfer sweep" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    buffers.clear();
+    images.clear();
+
+    // Pageable host memory, as the samples use
+    std::vector<unsigned char> host(maxSize);
+    std::vector<unsigned char> check(maxSize);
+
+    cl_mem buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, maxSize, NULL,
+                                   &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (buffer)");
+
+    SDKTimer* timer = new SDKTimer();
+    int t = timer->createTimer();
+
+    for(size_t size = sweep.minSize; size <= maxSize; size *= 4)
+    {
+        BufferPoint point;
+        point.size = size;
+
+        for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+        {
+            TransferPath path = (TransferPath)p;
+            point.upload[p] = 0;
+            point.download[p] = 0;
+            if((path == PATH_STAGED && ring == NULL) ||
+                    (path == PATH_PERSISTENT && !persistent))
+            {
+                continue;
+            }
+
+            for(size_t i = 0; i < size; i++)
+            {
+                host[i] = (unsigned char)(i * 7 + p + size);
+            }
+
+            // Upload through the path, read back directly
+            status = upload(path, ring, queue, buffer, CL_TRUE, 0, size,
+                            &host[0], 0, NULL, NULL);
+            if(status == CL_SUCCESS)
+            {
+                status = clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0, size,
+                                             &check[0], 0, NULL, NULL);
+            }
+            if(status == CL_SUCCESS && memcmp(&host[0], &check[0], size) == 0)
+            {
+                // Blocking, as the samples transfer
+                timer->resetTimer(t);
+                timer->startTimer(t);
+                for(int i = 0; i < sweep.iterations && status == CL_SUCCESS; i++)
+                {
+                    status = upload(path, ring, queue, buffer, CL_TRUE, 0, size,
+                                    &host[0], 0, NULL, NULL);
+                }
+                clFinish(queue);
+                timer->stopTimer(t);
+                if(status == CL_SUCCESS)
+                {
+                    point.upload[p] = (double)size * sweep.iterations /
+                                      timer->readTimer(t) * 1e-9;
+                }
+            }
+
+            // Written directly, downloaded through the path
+            memset(&check[0], 0, size);
+            status = clEnqueueWriteBuffer(queue, buffer, CL_TRUE, 0, size,
+                                          &host[0], 0, NULL, NULL);
+            if(status == CL_SUCCESS)
+            {
+                status = download(path, ring, queue, buffer, CL_TRUE, 0, size,
+                                  &check[0], 0, NULL, NULL);
+            }
+            if(status == CL_SUCCESS && memcmp(&host[0], &check[0], size) == 0)
+            {
+                timer->resetTimer(t);
+                timer->startTimer(t);
+                for(int i = 0; i < sweep.iterations && status == CL_SUCCESS; i++)
+                {
+                    status = download(path, ring, queue, buffer, CL_TRUE, 0, size,
+                                      &check[0], 0, NULL, NULL);
+                }
+                clFinish(queue);
+                timer->stopTimer(t);
+                if(status == CL_SUCCESS)
+                {
+                    point.download[p] = (double)size * sweep.iterations /
+                                        timer->readTimer(t) * 1e-9;
+                }
+            }
+        }
+        buffers.push_back(point);
+
+        // Next size would overflow
+        if(size > maxSize / 4)
+        {
+            break;
+        }
+    }
+
+    delete timer;
+
+    status = clReleaseMemObject(buffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (buffer)");
+
+    if(sweep.images)
+    {
+        return measureImages(queue, sweep);
+    }
+    return SDK_SUCCESS;
+}
+
+int
+TransferProfile::measureImages(cl_command_queue queue,
+                               const TransferSweep& sweep)
+{
+    cl_int status;
+
+    cl_context context = queueContext(queue);
+    cl_device_id deviceId;
+    status = clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id),
+                                   &deviceId, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetCommandQueueInfo failed.");
+
+    cl_bool imageSupport = CL_FALSE;
+    size_t maxWidth = 0, maxHeight = 0;
+    cl_ulong maxAlloc = 0;
+    clGetDeviceInfo(deviceId, CL_DEVICE_IMAGE_SUPPORT, sizeof(cl_bool),
+                    &imageSupport, NULL);
+    clGetDeviceInfo(deviceId, CL_DEVICE_IMAGE2D_MAX_WIDTH, sizeof(size_t),
+                    &maxWidth, NULL);
+    clGetDeviceInfo(deviceId, CL_DEVICE_IMAGE2D_MAX_HEIGHT, sizeof(size_t),
+                    &maxHeight, NULL);
+    clGetDeviceInfo(deviceId, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong),
+                    &maxAlloc, NULL);
+    if(!imageSupport)
+    {
+        return SDK_SUCCESS;
+    }
+
+    cl_uint numSupported = 0;
+    status = clGetSupportedImageFormats(context, CL_MEM_READ_WRITE,
+                                        CL_MEM_OBJECT_IMAGE2D, 0, NULL,
+                                        &numSupported);
+    CHECK_OPENCL_ERROR(status, "clGetSupportedImageFormats failed.");
+    std::vector<cl_image_format> supported(numSupported);
+    if(numSupported > 0)
+    {
+        status = clGetSupportedImageFormats(context, CL_MEM_READ_WRITE,
+                                            CL_MEM_OBJECT_IMAGE2D, numSupported,
+                                            &supported[0], NULL);
+        CHECK_OPENCL_ERROR(status, "clGetSupportedImageFormats failed.");
+    }
+
+    // Images below a few rows say little about the copy engines
+    size_t minSize = sweep.minSize < (64 << 10) ? (64 << 10) : sweep.minSize;
+    size_t maxSize = sweep.maxSize < (size_t)maxAlloc ? sweep.maxSize :
+                     (size_t)maxAlloc;
+    if(minSize > maxSize)
+    {
+        return SDK_SUCCESS;
+    }
+
+    std::vector<unsigned char> host(maxSize, 1);
+    cl_mem buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, maxSize, NULL,
+                                   &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (buffer)");
+
+    SDKTimer* timer = new SDKTimer();
+    int t = timer->createTimer();
+
+    for(int f = 0; f < numImageFormats; f++)
+    {
+        bool found = false;
+        for(size_t i = 0; i < supported.size(); i++)
+        {
+            found |= supported[i].image_channel_order ==
+                     imageFormats[f].format.image_channel_order &&
+                     supported[i].image_channel_data_type ==
+                     imageFormats[f].format.image_channel_data_type;
+        }
+        if(!found)
+        {
+            continue;
+        }
+
+        for(size_t size = minSize; size <= maxSize; size *= 4)
+        {
+            // Square power of two image of 'size' bytes, or close to it
+            size_t elements = size / imageFormats[f].elementSize;
+            size_t width = 1;
+            while(width * width * 4 <= elements)
+            {
+                width *= 2;
+            }
+            size_t height = elements / width;
+            if(width > maxWidth || height > maxHeight || height == 0)
+            {
+                break;
+            }
+
+            cl_image_desc desc;
+            memset(&desc, 0, sizeof(desc));
+            desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+            desc.image_width = width;
+            desc.image_height = height;
+
+            cl_mem image = clCreateImage(context, CL_MEM_READ_WRITE,
+                                         &imageFormats[f].format, &desc, NULL,
+                                         &status);
+            if(status != CL_SUCCESS)
+            {
+                break;
+            }
+
+            ImagePoint point;
+            point.format = imageFormats[f].name;
+            point.size = width * height * imageFormats[f].elementSize;
+
+            size_t origin[3] = {0, 0, 0};
+            size_t region[3] = {width, height, 1};
+            size_t row = width * imageFormats[f].elementSize;
+
+            for(int op = 0; op < NUM_IMAGE_TRANSFERS; op++)
+            {
+                status = CL_SUCCESS;
+                timer->resetTimer(t);
+                timer->startTimer(t);
+                for(int i = 0; i < sweep.iterations && status == CL_SUCCESS; i++)
+                {
+                    switch(op)
+                    {
+                    case IMAGE_WRITE:
+                        status = clEnqueueWriteImage(queue, image, CL_TRUE, origin,
+                                                     region, row, 0, &host[0], 0,
+                                                     NULL, NULL);
+                        break;
+                    case IMAGE_READ:
+                        status = clEnqueueReadImage(queue, image, CL_TRUE, origin,
+                                                    region, row, 0, &host[0], 0,
+                                                    NULL, NULL);
+                        break;
+                    case IMAGE_MAP:
+                    {
+                        size_t pitch;
+                        unsigned char* mapped = (unsigned char*)clEnqueueMapImage(
+                                                    queue, image, CL_TRUE,
+                                                    CL_MAP_WRITE_INVALIDATE_REGION,
+                                                    origin, region, &pitch, NULL, 0,
+                                                    NULL, NULL, &status);
+                        if(status != CL_SUCCESS)
+                        {
+                            break;
+                        }
+                        for(size_t y = 0; y < height; y++)
+                        {
+                            memcpy(mapped + y * pitch, &host[y * row], row);
+                        }
+                        status = clEnqueueUnmapMemObject(queue, image, mapped, 0,
+                                                         NULL, NULL);
+                        break;
+                    }
+                    case IMAGE_FROM_BUFFER:
+                        status = clEnqueueCopyBufferToImage(queue, buffer, image, 0,
+                                                            origin, region, 0, NULL,
+                                                            NULL);
+                        break;
+                    case IMAGE_TO_BUFFER:
+                        status = clEnqueueCopyImageToBuffer(queue, image, buffer,
+                                                            origin, region, 0, 0,
+                                                            NULL, NULL);
+                        break;
+                    }
+                }
+                clFinish(queue);
+                timer->stopTimer(t);
+                point.bandwidth[op] = status != CL_SUCCESS ? 0 :
+                                      (double)point.size * sweep.iterations /
+                                      timer->readTimer(t) * 1e-9;
+            }
+            images.push_back(point);
+
+            clReleaseMemObject(image);
+
+            if(size > maxSize / 4)
+            {
+                break;
+            }
+        }
+    }
+
+    delete timer;
+
+    status = clReleaseMemObject(buffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (buffer)");
+
+    return SDK_SUCCESS;
+}
+
+int
+TransferProfile::save(const std::string& file) const
+{
+    std::ofstream out(file.c_str());
+    if(!out)
+    {
+        std::cout << "Failed to open " << file << std::endl;
+        return SDK_FAILURE;
+    }
+
+    out << "# Transfer profile, bandwidths in GB/s, 0 when not available"
+        << std::endl;
+    out << "device " << device << std::endl;
+
+    out << "# buffer <bytes> <upload :";
+    for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+    {
+        out << " " << pathNames[p];
+    }
+    out << "> <download : same paths>" << std::endl;
+    for(size_t i = 0; i < buffers.size(); i++)
+    {
+        out << "buffer " << buffers[i].size;
+        for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+        {
+            out << " " << buffers[i].upload[p];
+        }
+        for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+        {
+            out << " " << buffers[i].download[p];
+        }
+        out << std::endl;
+    }
+
+    out << "# image <format> <bytes> <";
+    for(int op = 0; op < NUM_IMAGE_TRANSFERS; op++)
+    {
+        out << (op ? " " : "") << imageNames[op];
+    }
+    out << ">" << std::endl;
+    for(size_t i = 0; i < images.size(); i++)
+    {
+        out << "image " << images[i].format << " " << images[i].size;
+        for(int op = 0; op < NUM_IMAGE_TRANSFERS; op++)
+        {
+            out << " " << images[i].bandwidth[op];
+        }
+        out << std::endl;
+    }
+
+    return out.good() ? SDK_SUCCESS : SDK_FAILURE;
+}
+
+int
+TransferProfile::load(const std::string& file)
+{
+    std::ifstream in(file.c_str());
+    if(!in)
+    {
+        return SDK_FAILURE;
+    }
+
+    buffers.clear();
+    images.clear();
+
+    std::string line;
+    while(std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        if(kind == "device")
+        {
+            std::getline(fields >> std::ws, device);
+        }
+        else if(kind == "buffer")
+        {
+            BufferPoint point;
+            fields >> point.size;
+            for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+            {
+                fields >> point.upload[p];
+            }
+            for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+            {
+                fields >> point.download[p];
+            }
+            if(!fields)
+            {
+                std::cout << "Malformed line in " << file << " : " << line
+                          << std::endl;
+                return SDK_FAILURE;
+            }
+            buffers.push_back(point);
+        }
+        else if(kind == "image")
+        {
+            ImagePoint point;
+            fields >> point.format >> point.size;
+            for(int op = 0; op < NUM_IMAGE_TRANSFERS; op++)
+            {
+                fields >> point.bandwidth[op];
+            }
+            if(fields)
+            {
+                images.push_back(point);
+            }
+        }
+    }
+
+    // nearest() relies on increasing sizes
+    for(size_t i = 1; i < buffers.size(); i++)
+    {
+        if(buffers[i].size <= buffers[i - 1].size)
+        {
+            std::cout << "Sizes of " << file << " are not increasing" << std::endl;
+            buffers.clear();
+            return SDK_FAILURE;
+        }
+    }
+
+    return SDK_SUCCESS;
+}
+
+bool
+TransferProfile::empty() const
+{
+    return buffers.empty();
+}
+
+const TransferProfile::BufferPoint*
+TransferProfile::nearest(size_t size) const
+{
+    if(buffers.empty())
+    {
+        return NULL;
+    }
+
+    // Sizes are compared by ratio, the sweep is geometric
+    size_t i = 0;
+    while(i + 1 < buffers.size() && buffers[i + 1].size <= size)
+    {
+        i++;
+    }
+    if(i + 1 < buffers.size() && size > buffers[i].size &&
+            (double)size / buffers[i].size > (double)buffers[i + 1].size / size)
+    {
+        i++;
+    }
+    return &buffers[i];
+}
+
+TransferPath
+TransferProfile::selectUpload(size_t size) const
+{
+    const BufferPoint* point = nearest(size);
+    TransferPath best = PATH_STAGED;
+    if(point == NULL)
+    {
+        return best;
+    }
+    for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+    {
+        if(point->upload[p] > point->upload[best])
+        {
+            best = (TransferPath)p;
+        }
+    }
+    return best;
+}
+
+TransferPath
+TransferProfile::selectDownload(size_t size) const
+{
+    const BufferPoint* point = nearest(size);
+    TransferPath best = PATH_STAGED;
+    if(point == NULL)
+    {
+        return best;
+    }
+    for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+    {
+        if(point->download[p] > point->download[best])
+        {
+            best = (TransferPath)p;
+        }
+    }
+    return best;
+}
+
+void
+TransferProfile::print() const
+{
+    std::cout << "Transfer profile of " << device << " (GB/s)" << std::endl;
+
+    for(int direction = 0; direction < 2; direction++)
+    {
+        std::cout << std::endl << (direction ? "Download" : "Upload")
+                  << std::endl << std::setw(12) << "Bytes";
+        for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+        {
+            std::cout << std::setw(12) << pathNames[p];
+        }
+        std::cout << std::setw(12) << "best" << std::endl;
+
+        for(size_t i = 0; i < buffers.size(); i++)
+        {
+            const double* bandwidth = direction ? buffers[i].download :
+                                      buffers[i].upload;
+            std::cout << std::setw(12) << buffers[i].size << std::fixed
+                      << std::setprecision(2);
+            for(int p = 0; p < NUM_TRANSFER_PATHS; p++)
+            {
+                std::cout << std::setw(12) << bandwidth[p];
+            }
+            TransferPath best = direction ? selectDownload(buffers[i].size) :
+                                selectUpload(buffers[i].size);
+            std::cout << std::setw(12) << pathNames[best] << std::endl;
+        }
+    }
+
+    if(!images.empty())
+    {
+        std::cout << std::endl << "Images" << std::endl << std::setw(12)
+                  << "Format" << std::setw(12) << "Bytes";
+        for(int op = 0; op < NUM_IMAGE_TRANSFERS; op++)
+        {
+            std::cout << std::setw(12) << imageNames[op];
+        }
+        std::cout << std::endl;
+
+        for(size_t i = 0; i < images.size(); i++)
+        {
+            std::cout << std::setw(12) << images[i].format << std::setw(12)
+                      << images[i].size;
+            for(int op = 0; op < NUM_IMAGE_TRANSFERS; op++)
+            {
+                std::cout << std::setw(12) << images[i].bandwidth[op];
+            }
+            std::cout << std::endl;
+        }
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6) << std::endl;
+}
+
+/**
+* BatchRunner entry : measures the transfer paths of the selected device and
+* writes its profile, used by the samples run after it
+*/
+static int
+runTransferProfile(int argc, char* argv[])
+{
+    CLRuntime& runtime = CLRuntime::getInstance();
+    CLCommandArgs* sampleArgs = new CLCommandArgs();
+    sampleArgs->sampleVerStr = "AMD-APP-SDK-v3.0.130.3";
+
+    int minSize = MIN_PROFILE_SIZE;
+    int maxSize = MAX_PROFILE_SIZE;
+    int iterations = PROFILE_ITERATIONS;
+    bool skipImages = false;
+
+    CHECK_ERROR((sampleArgs->initialize()), SDK_SUCCESS,
+                "OpenCL resource initialization  failed");
+
+    Option* option = new Option;
+    CHECK_ALLOCATION(option, "Memory allocation error.\n");
+
+    option->_sVersion = "";
+    option->_lVersion = "min-size";
+    option->_description = "Smallest transfer of the sweep in bytes";
+    option->_type = CA_ARG_INT;
+    option->_value = &minSize;
+    sampleArgs->AddOption(option);
+
+    option->_sVersion = "";
+    option->_lVersion = "max-size";
+    option->_description = "Largest transfer of the sweep in bytes";
+    option->_type = CA_ARG_INT;
+    option->_value = &maxSize;
+    sampleArgs->AddOption(option);
+
+    option->_sVersion = "i";
+    option->_lVersion = "iterations";
+    option->_description = "Timed transfers per size and path";
+    option->_type = CA_ARG_INT;
+    option->_value = &iterations;
+    sampleArgs->AddOption(option);
+
+    option->_sVersion = "";
+    option->_lVersion = "skip-images";
+    option->_description = "Do not measure the image formats";
+    option->_type = CA_NO_ARGUMENT;
+    option->_value = &skipImages;
+    sampleArgs->AddOption(option);
+
+    delete option;
+
+    if(sampleArgs->parseCommandLine(argc, argv))
+    {
+        delete sampleArgs;
+        return SDK_FAILURE;
+    }
+
+    if(minSize < 1 || maxSize < minSize || iterations < 1)
+    {
+        std::cout << "Error, sizes and iterations must be positive with "
+                  << "min-size <= max-size. Exiting.." << std::endl;
+        delete sampleArgs;
+        return SDK_FAILURE;
+    }
+
+    cl_device_type dType;
+    if(sampleArgs->deviceType.compare("cpu") == 0)
+    {
+        dType = CL_DEVICE_TYPE_CPU;
+    }
+    else //deviceType = "gpu"
+    {
+        dType = CL_DEVICE_TYPE_GPU;
+        if(sampleArgs->isThereGPU() == false)
+        {
+            std::cout << "GPU not found. Falling back to CPU device" << std::endl;
+            dType = CL_DEVICE_TYPE_CPU;
+        }
+    }
+
+    cl_platform_id platform = NULL;
+    cl_context context;
+    int retValue = runtime.getContext(sampleArgs, dType, platform, context);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::getContext() failed");
+
+    cl_device_id* devices = NULL;
+    retValue = getDevices(context, &devices, sampleArgs->deviceId,
+                          sampleArgs->isDeviceIdEnabled());
+    CHECK_ERROR(retValue, SDK_SUCCESS, "getDevices() failed");
+    cl_device_id device = devices[sampleArgs->deviceId];
+
+    cl_command_queue queue;
+    retValue = runtime.getCommandQueue(context, device, 0, queue);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::getCommandQueue() failed");
+
+    TransferSweep sweep = {(size_t)minSize, (size_t)maxSize, iterations,
+                           !skipImages
+                          };
+    retValue = runtime.profileTransfers(queue, sweep);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::profileTransfers() failed");
+
+    if(!sampleArgs->quiet)
+    {
+        runtime.getTransferProfile(queue)->print();
+    }
+    std::cout << "Profile written to " << TransferProfile::fileName(device)
+              << std::endl;
+
+    cl_int status = clReleaseCommandQueue(queue);
+    CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.");
+    status = clReleaseContext(context);
+    CHECK_OPENCL_ERROR(status, "clReleaseContext failed.");
+
+    FREE(devices);
+    delete sampleArgs;
+    return SDK_SUCCESS;
+}
+
+REGISTER_SAMPLE(TRANSFER_PROFILE_SAMPLE, runTransferProfile);
@@ -0,0 +1,209 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef TRANSFER_PROFILE_H_
+#define TRANSFER_PROFILE_H_
+
+/**
+ * TransferProfile
+ * Measured bandwidth of the host <-> device transfer paths of one device
+ * over a sweep of transfer sizes, and the selector that picks the fastest
+ * path for a given size. The buffer paths are
+ *   direct     : clEnqueueWrite/ReadBuffer from pageable host memory
+ *   staged     : through the pinned StagingRing (CL_MEM_ALLOC_HOST_PTR)
+ *   mapped     : the device buffer is mapped and filled with memcpy
+ *   host ptr   : the host memory is wrapped in a CL_MEM_USE_HOST_PTR buffer
+ *                and moved with clEnqueueCopyBuffer
+ *   persistent : memcpy to a CL_MEM_USE_PERSISTENT_MEM_AMD buffer, then a
+ *                device copy (AMD platforms only)
+ * Image formats are measured for write, read, map and copies from and to a
+ * buffer. They are kept in the profile for reference, the selector only
+ * covers buffers.
+ *
+ * A profile is a text file per device, TransferProfile_<device>.txt in the
+ * working directory, written by the TransferProfile entry of BatchRunner
+ * and loaded by CLRuntime the first time a queue of the device transfers.
+ * Without a profile every transfer is staged.
+ */
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+#include "CLUtil.hpp"
+#include "BufferPool.hpp"
+
+using namespace appsdk;
+
+#define TRANSFER_PROFILE_SAMPLE "TransferProfile"   ///< Entry of BatchRunner
+#define MIN_PROFILE_SIZE (4 << 10)      ///< Smallest size of the sweep
+#define MAX_PROFILE_SIZE (64 << 20)     ///< Largest size of the sweep
+#define PROFILE_ITERATIONS 16           ///< Timed transfers per point
+
+/**
+* Transfer paths of a buffer upload or download
+*/
+enum TransferPath
+{
+    PATH_DIRECT,
+    PATH_STAGED,
+    PATH_MAPPED,
+    PATH_HOST_PTR,
+    PATH_PERSISTENT,
+    NUM_TRANSFER_PATHS
+};
+
+/**
+* Image operations of the sweep
+*/
+enum ImageTransfer
+{
+    IMAGE_WRITE,
+    IMAGE_READ,
+    IMAGE_MAP,
+    IMAGE_FROM_BUFFER,
+    IMAGE_TO_BUFFER,
+    NUM_IMAGE_TRANSFERS
+};
+
+/**
+* Parameters of a measurement
+*/
+struct TransferSweep
+{
+    size_t minSize;                 /**< First size, multiplied by 4 */
+    size_t maxSize;                 /**< Last size */
+    int iterations;                 /**< Timed transfers per point */
+    bool images;                    /**< Also measure image formats */
+};
+
+/**
+* TransferProfile
+* Bandwidth table of one device and best path selection
+*/
+class TransferProfile
+{
+        /**
+        * Bandwidth in GB/s of every path at one size, 0 when the path is
+        * not available or failed its check
+        */
+        struct BufferPoint
+        {
+            size_t size;
+            double upload[NUM_TRANSFER_PATHS];
+            double download[NUM_TRANSFER_PATHS];
+        };
+
+        /**
+        * Bandwidth in GB/s of the image operations of one format and size
+        */
+        struct ImagePoint
+        {
+            std::string format;
+            size_t size;
+            double bandwidth[NUM_IMAGE_TRANSFERS];
+        };
+
+        std::string device;                 /**< Name of the device */
+        std::vector<BufferPoint> buffers;   /**< By increasing size */
+        std::vector<ImagePoint> images;
+
+        const BufferPoint* nearest(size_t size) const;
+        int measureImages(cl_command_queue queue, const TransferSweep& sweep);
+
+    public:
+        TransferProfile();
+
+        /**
+        * Name of a path as printed and written to the profile
+        */
+        static const char* pathName(TransferPath path);
+
+        /**
+        * Profile file of a device
+        */
+        static std::string fileName(cl_device_id device);
+
+        /**
+        * Same as clEnqueueWriteBuffer through the given path. The mapped and
+        * persistent paths copy on the host and return once the data is in
+        * OpenCL memory.
+        * @param ring staging ring of the context, used by PATH_STAGED
+        */
+        static cl_int upload(TransferPath path, StagingRing* ring,
+                             cl_command_queue queue, cl_mem buffer,
+                             cl_bool blocking, size_t offset, size_t size,
+                             const void* ptr, cl_uint numEvents,
+                             const cl_event* waitList, cl_event* event);
+
+        /**
+        * Same as clEnqueueReadBuffer through the given path. The mapped and
+        * persistent paths always return with the data in 'ptr'.
+        * @param ring staging ring of the context, used by PATH_STAGED
+        */
+        static cl_int download(TransferPath path, StagingRing* ring,
+                               cl_command_queue queue, cl_mem buffer,
+                               cl_bool blocking, size_t offset, size_t size,
+                               void* ptr, cl_uint numEvents,
+                               const cl_event* waitList, cl_event* event);
+
+        /**
+        * Measures every path of the device of the queue. Each path is
+        * checked against a direct transfer first, a path giving wrong
+        * data is left out.
+        * @param queue in-order queue of the device
+        * @param ring staging ring of the context of the queue
+        * @param sweep sizes and iterations
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int measure(cl_command_queue queue, StagingRing* ring,
+                    const TransferSweep& sweep);
+
+        /**
+        * Writes the profile
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int save(const std::string& file) const;
+
+        /**
+        * Reads a profile written by save()
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int load(const std::string& file);
+
+        /**
+        * Tells if the profile holds measurements
+        */
+        bool empty() const;
+
+        /**
+        * Fastest upload path for 'size' bytes, taken at the nearest measured
+        * size. PATH_STAGED for an empty profile.
+        */
+        TransferPath selectUpload(size_t size) const;
+
+        /**
+        * Fastest download path for 'size' bytes, PATH_STAGED for an empty
+        * profile
+        */
+        TransferPath selectDownload(size_t size) const;
+
+        /**
+        * Prints the bandwidth tables
+        */
+        void print() const;
+};
+
+#endif  // TRANSFER_PROFILE_H_
@@ -14,45 +14,438 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************************************/
 
-
 #include "BinomialOption.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <emmintrin.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
+// Depth distributions of a generated book
+static const char* depthNames[] = {"fixed", "uniform", "bimodal"};
+static const int numDepths = 3;
 
-int
-BinomialOption::setupBinomialOption()
+// Shallowest generated tree
+#define MIN_STEPS 16
+
+/**
+ * Batches of the sorted book priced by one host thread
+ */
+struct BinomialThreadData
+{
+    const cl_float* params;             /**< option parameters, SoA */
+    const cl_int* info;                 /**< steps and flags */
+    const cl_int* order;                /**< options sorted by decreasing depth */
+    cl_float* result;
+    int numOptions;
+    int maxSteps;                       /**< deepest tree of the book */
+    int firstBatch;                     /**< batches firstBatch, firstBatch + stride, ... */
+    int stride;
+};
+
+/**
+ * Orders options by decreasing number of time steps
+ */
+struct DeeperFirst
 {
+    const cl_int* info;
 
-    // Make numSamples multiple of 4
-    numSamples = (numSamples / 4)? (numSamples / 4) * 4: 4;
+    DeeperFirst(const cl_int* info) : info(info) {}
 
-    samplesPerVectorWidth = numSamples / 4;
+    bool operator()(cl_int a, cl_int b) const
+    {
+        return (info[a] & INFO_STEPS_MASK) > (info[b] & INFO_STEPS_MASK);
+    }
+};
 
-#if defined (_WIN32)
-    randArray = (cl_float*)_aligned_malloc(samplesPerVectorWidth * sizeof(
-            cl_float4), 16);
+static int numCPUCores()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return (int)systemInfo.dwNumberOfProcessors;
 #else
-    randArray = (cl_float*)memalign(16, samplesPerVectorWidth * sizeof(cl_float4));
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
 #endif
-    CHECK_ALLOCATION(randArray, "Failed to allocate host memory. (randArray)");
+}
+
+/**
+ * Four options with SSE, lane i prices batch[i]. The levels of the
+ * trees are interleaved (value[k * 4 + i]) so one instruction updates
+ * node k of all four trees. The rounds follow the kernel: all trees
+ * start at their leaves, a lane stops once its tree reached the root.
+ */
+static void priceBatch(const BinomialThreadData* d, const cl_int* batch, int count,
+                       float* value, float* price)
+{
+    float lanePuByr[4];
+    float lanePdByr[4];
+    float laneU[4];
+    float laneX[4];
+    float laneSign[4];
+    float laneSteps[4];
+    float laneAmerican[4];
+    int rounds = 0;
+
+    for(int i = 0; i < 4; ++i)
+    {
+        // missing lanes repeat the first option and are not stored
+        int option = batch[i < count ? i : 0];
+        int flags = d->info[option];
+        int numSteps = flags & INFO_STEPS_MASK;
+
+        float s = d->params[PARAM_SPOT * d->numOptions + option];
+        float x = d->params[PARAM_STRIKE * d->numOptions + option];
+        float riskFree = d->params[PARAM_RATE * d->numOptions + option];
+        float volatility = d->params[PARAM_VOLATILITY * d->numOptions + option];
+        float optionYears = d->params[PARAM_YEARS * d->numOptions + option];
+
+        float dt = optionYears * (1.0f / (float)numSteps);
+        float vsdt = volatility * sqrtf(dt);
+        float rdt = riskFree * dt;
+        float r = expf(rdt);
+        float rInv = 1.0f / r;
+        float u = expf(vsdt);
+        float dn = 1.0f / u;
+        float pu = (r - dn) / (u - dn);
+        float pd = 1.0f - pu;
+        float sign = (flags & INFO_PUT) ? -1.0f : 1.0f;
+
+        lanePuByr[i] = pu * rInv;
+        lanePdByr[i] = pd * rInv;
+        laneU[i] = u;
+        laneX[i] = x;
+        laneSign[i] = sign;
+        laneSteps[i] = (float)numSteps;
+        laneAmerican[i] = (flags & INFO_AMERICAN) ? 1.0f : 0.0f;
+
+        /**
+         * Compute values at expiration date:
+         * Call option value at period end is v(t) = s(t) - x
+         * If s(t) is greater than x, or zero otherwise...
+         * The computation is similar for put options...
+         */
+        for(int k = 0; k <= numSteps; ++k)
+        {
+            price[k * 4 + i] = s * expf(vsdt * (2.0f * k - (float)numSteps));
+            float profit = sign * (price[k * 4 + i] - x);
+            value[k * 4 + i] = profit > 0.0f ? profit : 0.0f;
+        }
+        rounds = numSteps > rounds ? numSteps : rounds;
+    }
+
+    __m128 puByr = _mm_loadu_ps(lanePuByr);
+    __m128 pdByr = _mm_loadu_ps(lanePdByr);
+    __m128 u = _mm_loadu_ps(laneU);
+    __m128 x = _mm_loadu_ps(laneX);
+    __m128 sign = _mm_loadu_ps(laneSign);
+    __m128 steps = _mm_loadu_ps(laneSteps);
+    __m128 american = _mm_cmpneq_ps(_mm_loadu_ps(laneAmerican), _mm_setzero_ps());
+
+    /**
+     * walk backwards up on the binomial trees, level j = steps - round,
+     * nodes 0 .. j - 1 are reduced in place
+     */
+    for(int round = 0; round < rounds; ++round)
+    {
+        __m128 j = _mm_sub_ps(steps, _mm_set1_ps((float)round));
+        for(int k = 0; k < rounds - round; ++k)
+        {
+            __m128 active = _mm_cmplt_ps(_mm_set1_ps((float)k), j);
+            __m128 down = _mm_load_ps(value + k * 4);
+            __m128 up = _mm_load_ps(value + (k + 1) * 4);
+            __m128 v = _mm_add_ps(_mm_mul_ps(puByr, up), _mm_mul_ps(pdByr, down));
+
+            __m128 p = _mm_load_ps(price + k * 4);
+            __m128 q = _mm_mul_ps(p, u);
+            __m128 exercise = _mm_mul_ps(sign, _mm_sub_ps(q, x));
+            v = _mm_or_ps(_mm_and_ps(american, _mm_max_ps(exercise, v)),
+                          _mm_andnot_ps(american, v));
+
+            _mm_store_ps(value + k * 4, _mm_or_ps(_mm_and_ps(active, v),
+                                                  _mm_andnot_ps(active, down)));
+            _mm_store_ps(price + k * 4, _mm_or_ps(_mm_and_ps(active, q),
+                                                  _mm_andnot_ps(active, p)));
+        }
+    }
+
+    //Copy the roots to result
+    for(int i = 0; i < count; ++i)
+    {
+        d->result[batch[i]] = value[i];
+    }
+}
+
+void* binomialHostThread(void* data)
+{
+    const BinomialThreadData* d = (const BinomialThreadData*)data;
+    size_t nodes = (size_t)(d->maxSteps + 1) * 4;
+    float* value = (float*)_mm_malloc(nodes * sizeof(float), 16);
+    float* price = (float*)_mm_malloc(nodes * sizeof(float), 16);
+    memset(value, 0, nodes * sizeof(float));
+    memset(price, 0, nodes * sizeof(float));
+
+    int numBatches = (d->numOptions + 3) / 4;
+    for(int b = d->firstBatch; b < numBatches; b += d->stride)
+    {
+        int count = d->numOptions - b * 4;
+        priceBatch(d, d->order + b * 4, count < 4 ? count : 4, value, price);
+    }
+
+    _mm_free(value);
+    _mm_free(price);
+    return NULL;
+}
+
+
+float
+BinomialOption::random(float randMax, float randMin)
+{
+    float result;
+    result =(float)rand() / (float)RAND_MAX;
+
+    return ((1.0f - result) * randMin + result * randMax);
+}
+
+int
+BinomialOption::readOptions(std::string fileName)
+{
+    std::ifstream file(fileName.c_str());
+    if(!file)
+    {
+        std::cout << "Error: Unable to open " << fileName << std::endl;
+        return SDK_FAILURE;
+    }
+
+    std::vector<cl_float> fields[PARAM_COUNT];
+    std::vector<cl_int> flags;
+    std::string line;
+    int lineNumber = 0;
+    while(std::getline(file, line))
+    {
+        ++lineNumber;
+        std::istringstream fieldStream(line);
+        std::string first;
+        if(!(fieldStream >> first) || first[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream lineStream(line);
+        float value[PARAM_COUNT];
+        int steps;
+        std::string style = "E";
+        std::string type = "C";
+        lineStream >> value[PARAM_SPOT] >> value[PARAM_STRIKE] >> value[PARAM_RATE]
+                   >> value[PARAM_VOLATILITY] >> value[PARAM_YEARS] >> steps;
+        if(!lineStream || steps < 1 || steps > INFO_STEPS_MASK)
+        {
+            std::cout << "Error: " << fileName << ":" << lineNumber
+                      << ": expected spot strike rate volatility years steps [E|A] [C|P]"
+                      << std::endl;
+            return SDK_FAILURE;
+        }
+        lineStream >> style >> type;
+
+        for(int f = 0; f < PARAM_COUNT; ++f)
+        {
+            fields[f].push_back(value[f]);
+        }
+        cl_int optionInfo = steps;
+        if(style[0] == 'A' || style[0] == 'a')
+        {
+            optionInfo |= INFO_AMERICAN;
+        }
+        if(type[0] == 'P' || type[0] == 'p')
+        {
+            optionInfo |= INFO_PUT;
+        }
+        flags.push_back(optionInfo);
+    }
+
+    if(flags.empty())
+    {
+        std::cout << "Error: " << fileName << " holds no options" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    numSamples = (cl_int)flags.size();
+    params = (cl_float*)malloc(PARAM_COUNT * numSamples * sizeof(cl_float));
+    CHECK_ALLOCATION(params, "Failed to allocate host memory. (params)");
+    info = (cl_int*)malloc(numSamples * sizeof(cl_int));
+    CHECK_ALLOCATION(info, "Failed to allocate host memory. (info)");
+
+    for(int f = 0; f < PARAM_COUNT; ++f)
+    {
+        memcpy(params + f * numSamples, &fields[f][0], numSamples * sizeof(cl_float));
+    }
+    memcpy(info, &flags[0], numSamples * sizeof(cl_int));
+
+    numSteps = 0;
+    for(int i = 0; i < numSamples; ++i)
+    {
+        int steps = info[i] & INFO_STEPS_MASK;
+        numSteps = steps > numSteps ? steps : numSteps;
+    }
+
+    return SDK_SUCCESS;
+}
+
+void
+BinomialOption::generateOptions(int distribution)
+{
+    int minSteps = MIN_STEPS < numSteps ? MIN_STEPS : numSteps;
+    int shallowSteps = 4 * minSteps < numSteps ? 4 * minSteps : numSteps;
+    int deepSteps = numSteps / 2 > minSteps ? numSteps / 2 : minSteps;
 
     for(int i = 0; i < numSamples; i++)
     {
-        randArray[i] = (float)rand() / (float)RAND_MAX;
+        float s = random(30.0f, 5.0f);
+        params[PARAM_SPOT * numSamples + i] = s;
+        params[PARAM_STRIKE * numSamples + i] = s * random(1.2f, 0.8f);
+        params[PARAM_RATE * numSamples + i] = RISKFREE * random(1.5f, 0.5f);
+        params[PARAM_VOLATILITY * numSamples + i] = VOLATILITY * random(1.5f, 0.5f);
+        params[PARAM_YEARS * numSamples + i] = random(10.0f, 0.25f);
+
+        int steps = numSteps;
+        if(distribution == 1)
+        {
+            steps = (int)random((float)numSteps + 1.0f, (float)minSteps);
+        }
+        else if(distribution == 2)
+        {
+            // three shallow trees for every deep one
+            steps = (i % 4) ? (int)random((float)shallowSteps + 1.0f, (float)minSteps)
+                    : (int)random((float)numSteps + 1.0f, (float)deepSteps);
+        }
+        steps = steps < numSteps ? steps : numSteps;
+
+        // every other option is an American put
+        info[i] = (i % 2) ? (steps | INFO_AMERICAN | INFO_PUT) : steps;
     }
+}
 
-#if defined (_WIN32)
-    output = (cl_float*)_aligned_malloc(samplesPerVectorWidth * sizeof(cl_float4),
-                                        16);
-#else
-    output = (cl_float*)memalign(16, samplesPerVectorWidth * sizeof(cl_float4));
-#endif
+int
+BinomialOption::setupBinomialOption()
+{
+    if(cpuThreads <= 0)
+    {
+        cpuThreads = numCPUCores();
+    }
 
+    if(!optionFile.empty())
+    {
+        if(readOptions(optionFile) != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+    }
+    else
+    {
+        for(depth = 0; depth < numDepths; ++depth)
+        {
+            if(depthName == depthNames[depth])
+            {
+                break;
+            }
+        }
+        if(depth == numDepths)
+        {
+            std::cout << "Error: Unknown depth distribution " << depthName
+                      << " (fixed, uniform or bimodal)" << std::endl;
+            return SDK_FAILURE;
+        }
+
+        numSamples = numSamples > 0 ? numSamples : 1;
+        numSteps = numSteps > 0 ? numSteps : 1;
+
+        params = (cl_float*)malloc(PARAM_COUNT * numSamples * sizeof(cl_float));
+        CHECK_ALLOCATION(params, "Failed to allocate host memory. (params)");
+        info = (cl_int*)malloc(numSamples * sizeof(cl_int));
+        CHECK_ALLOCATION(info, "Failed to allocate host memory. (info)");
+
+        generateOptions(depth);
+    }
+
+    output = (cl_float*)malloc(numSamples * sizeof(cl_float));
     CHECK_ALLOCATION(output, "Failed to allocate host memory. (output)");
-    memset(output, 0, samplesPerVectorWidth * sizeof(cl_float4));
+    memset(output, 0, numSamples * sizeof(cl_float));
 
     return SDK_SUCCESS;
 }
 
+void
+BinomialOption::packOptions(bool pack)
+{
+    order.resize(numSamples);
+    for(int i = 0; i < numSamples; ++i)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), DeeperFirst(info));
+
+    // First fit decreasing, a new group starts with its deepest tree
+    std::vector<int> freeLanes;
+    std::vector<cl_int> groupOf(numSamples);
+    std::vector<cl_int> firstLane(numSamples);
+    size_t firstOpen = 0;
+    groupSteps.clear();
+    for(int i = 0; i < numSamples; ++i)
+    {
+        int option = order[i];
+        int steps = info[option] & INFO_STEPS_MASK;
+        size_t g = pack ? firstOpen : freeLanes.size();
+        while(g < freeLanes.size() && freeLanes[g] < steps + 1)
+        {
+            ++g;
+        }
+        if(g == freeLanes.size())
+        {
+            freeLanes.push_back((int)groupSize);
+            groupSteps.push_back(steps);
+        }
+        groupOf[option] = (cl_int)g;
+        firstLane[option] = (cl_int)groupSize - freeLanes[g];
+        freeLanes[g] -= steps + 1;
+
+        // groups before firstOpen cannot take the smallest tree
+        while(firstOpen < freeLanes.size() && freeLanes[firstOpen] < 2)
+        {
+            ++firstOpen;
+        }
+    }
+    numGroups = (cl_int)groupSteps.size();
+
+    cl_int2 idle;
+    idle.s[0] = -1;
+    idle.s[1] = 0;
+    laneMap.assign((size_t)numGroups * groupSize, idle);
+
+    double updates = 0;
+    for(int option = 0; option < numSamples; ++option)
+    {
+        int steps = info[option] & INFO_STEPS_MASK;
+        cl_int2* lane = &laneMap[groupOf[option] * groupSize + firstLane[option]];
+        for(int k = 0; k <= steps; ++k)
+        {
+            lane[k].s[0] = option;
+            lane[k].s[1] = k;
+        }
+        updates += 0.5 * steps * (steps + 1);
+    }
+
+    double slots = 0;
+    for(int g = 0; g < numGroups; ++g)
+    {
+        slots += (double)groupSize * groupSteps[g];
+    }
+    utilization = updates / slots;
+}
+
 
 int
 BinomialOption::genBinaryImage()
@@ -70,6 +463,7 @@ BinomialOption::genBinaryImage()
     return status;
 }
 
+
 int
 BinomialOption::setupCL()
 {
@@ -146,18 +540,34 @@ BinomialOption::setupCL()
         inMemFlags |= CL_MEM_USE_PERSISTENT_MEM_AMD;
     }
 
-    // Create memory object for stock price
-    randBuffer = clCreateBuffer(context,
+    // Create memory object for the option parameters
+    paramBuffer = clCreateBuffer(context,
+                                 inMemFlags,
+                                 PARAM_COUNT * numSamples * sizeof(cl_float),
+                                 NULL,
+                                 &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (paramBuffer)");
+
+    // Create memory object for steps, style and type
+    infoBuffer = clCreateBuffer(context,
                                 inMemFlags,
-                                samplesPerVectorWidth * sizeof(cl_float4),
+                                numSamples * sizeof(cl_int),
                                 NULL,
                                 &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (randBuffer)");
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (infoBuffer)");
+
+    // There are never more groups than options
+    groupBuffer = clCreateBuffer(context,
+                                 CL_MEM_READ_ONLY,
+                                 numSamples * sizeof(cl_int),
+                                 NULL,
+                                 &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (groupBuffer)");
 
     // Create memory object for output array
     outBuffer = clCreateBuffer(context,
                                CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                               samplesPerVectorWidth * sizeof(cl_float4),
+                               numSamples * sizeof(cl_float),
                                NULL,
                                &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (outBuffer)");
@@ -191,120 +601,186 @@ BinomialOption::setupCL()
              devices[sampleArgs->deviceId]);
     CHECK_OPENCL_ERROR(status, "kernelInfo.setKernelWorkGroupInfo failed");
 
-    // If group-size is gerater than maximum supported on kernel
-    if((size_t)(numSteps + 1) > kernelInfo.kernelWorkGroupSize)
+    groupSize = GROUP_SIZE;
+    groupSize = groupSize < kernelInfo.kernelWorkGroupSize ? groupSize :
+                kernelInfo.kernelWorkGroupSize;
+    groupSize = groupSize < deviceInfo.maxWorkGroupSize ? groupSize :
+                deviceInfo.maxWorkGroupSize;
+    groupSize = groupSize < deviceInfo.maxWorkItemSizes[0] ? groupSize :
+                deviceInfo.maxWorkItemSizes[0];
+
+    // If a tree does not fit into a group
+    if((size_t)(numSteps + 1) > groupSize)
     {
         if(!sampleArgs->quiet)
         {
             std::cout << "Out of Resources!" << std::endl;
             std::cout << "Group Size specified : " << (numSteps + 1) << std::endl;
             std::cout << "Max Group Size supported on the kernel : "
-                      << kernelInfo.kernelWorkGroupSize << std::endl;
+                      << groupSize << std::endl;
             std::cout << "Using appropiate group-size." << std::endl;
             std::cout << "-------------------------------------------" << std::endl;
         }
-        numSteps = (cl_int)kernelInfo.kernelWorkGroupSize - 2;
+        numSteps = (cl_int)groupSize - 1;
+        for(int i = 0; i < numSamples; ++i)
+        {
+            if((info[i] & INFO_STEPS_MASK) > numSteps)
+            {
+                info[i] = (info[i] & ~INFO_STEPS_MASK) | numSteps;
+            }
+        }
+    }
+
+    if(2 * groupSize * sizeof(cl_float) + kernelInfo.localMemoryUsed >
+            deviceInfo.localMemSize)
+    {
+        std::cout << "Unsupported: Insufficient local memory on device." << std::endl;
+        return SDK_FAILURE;
     }
 
     return SDK_SUCCESS;
 }
 
-
 int
-BinomialOption::runCLKernels()
+BinomialOption::writeOptions()
 {
     cl_int status;
-    cl_event ndrEvt;
-    cl_int eventStatus = CL_QUEUED;
-
-    cl_event inMapEvt;
-    void* mapPtr = clEnqueueMapBuffer(commandQueue,
-                                      randBuffer,
-                                      CL_FALSE,
-                                      CL_MAP_WRITE,
-                                      0,
-                                      samplesPerVectorWidth * sizeof(cl_float4),
-                                      0,
-                                      NULL,
-                                      &inMapEvt,
-                                      &status);
-    CHECK_OPENCL_ERROR(status, "clEnqueueMapBuffer failed. (inputBuffer)");
 
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.");
-
-    status = waitForEventAndRelease(&inMapEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(inMapEvt) Failed");
+    // The lane map grows with the number of groups of the packing
+    size_t lanes = (size_t)numGroups * groupSize;
+    if(lanes > laneCapacity)
+    {
+        if(laneBuffer)
+        {
+            status = clReleaseMemObject(laneBuffer);
+            CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (laneBuffer)");
+        }
+        laneBuffer = clCreateBuffer(context,
+                                    CL_MEM_READ_ONLY,
+                                    lanes * sizeof(cl_int2),
+                                    NULL,
+                                    &status);
+        CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (laneBuffer)");
+        laneCapacity = lanes;
+    }
 
-    memcpy(mapPtr, randArray, samplesPerVectorWidth * sizeof(cl_float4));
+    status = clEnqueueWriteBuffer(commandQueue,
+                                  paramBuffer,
+                                  CL_FALSE,
+                                  0,
+                                  PARAM_COUNT * numSamples * sizeof(cl_float),
+                                  params,
+                                  0,
+                                  NULL,
+                                  NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (paramBuffer)");
+
+    status = clEnqueueWriteBuffer(commandQueue,
+                                  infoBuffer,
+                                  CL_FALSE,
+                                  0,
+                                  numSamples * sizeof(cl_int),
+                                  info,
+                                  0,
+                                  NULL,
+                                  NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (infoBuffer)");
+
+    status = clEnqueueWriteBuffer(commandQueue,
+                                  groupBuffer,
+                                  CL_FALSE,
+                                  0,
+                                  numGroups * sizeof(cl_int),
+                                  &groupSteps[0],
+                                  0,
+                                  NULL,
+                                  NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (groupBuffer)");
+
+    status = clEnqueueWriteBuffer(commandQueue,
+                                  laneBuffer,
+                                  CL_FALSE,
+                                  0,
+                                  lanes * sizeof(cl_int2),
+                                  &laneMap[0],
+                                  0,
+                                  NULL,
+                                  NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (laneBuffer)");
+
+    status = clFinish(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed.");
 
-    cl_event inUnmapEvent;
+    return SDK_SUCCESS;
+}
 
-    status = clEnqueueUnmapMemObject(commandQueue,
-                                     randBuffer,
-                                     mapPtr,
-                                     0,
-                                     NULL,
-                                     &inUnmapEvent);
-    CHECK_OPENCL_ERROR(status, "clEnqueueUnmapMemObject failed. (randBuffer)");
 
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.");
+int
+BinomialOption::runCLKernels()
+{
+    cl_int status;
+    cl_event ndrEvt;
 
-    status = waitForEventAndRelease(&inUnmapEvent);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(inUnmapEvent) Failed");
+    if(writeOptions() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
 
     // Set appropriate arguments to the kernel
     status = clSetKernelArg(kernel,
                             0,
-                            sizeof(int),
-                            (void*)&numSteps);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(numSteps) failed.");
+                            sizeof(cl_int),
+                            (void*)&numSamples);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(numSamples) failed.");
 
     status = clSetKernelArg(kernel,
                             1,
                             sizeof(cl_mem),
-                            (void*)&randBuffer);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(randBuffer) failed.");
+                            (void*)&paramBuffer);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(paramBuffer) failed.");
 
     status = clSetKernelArg(kernel,
                             2,
                             sizeof(cl_mem),
+                            (void*)&infoBuffer);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(infoBuffer) failed.");
+
+    status = clSetKernelArg(kernel,
+                            3,
+                            sizeof(cl_mem),
+                            (void*)&laneBuffer);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(laneBuffer) failed.");
+
+    status = clSetKernelArg(kernel,
+                            4,
+                            sizeof(cl_mem),
+                            (void*)&groupBuffer);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(groupBuffer) failed.");
+
+    status = clSetKernelArg(kernel,
+                            5,
+                            sizeof(cl_mem),
                             (void*)&outBuffer);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg(outBuffer) failed.");
 
     status = clSetKernelArg(kernel,
-                            3,
-                            (numSteps + 1) * sizeof(cl_float4),
+                            6,
+                            groupSize * sizeof(cl_float),
                             NULL);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg(callA) failed.");
 
     status = clSetKernelArg(kernel,
-                            4,
-                            numSteps * sizeof(cl_float4),
+                            7,
+                            groupSize * sizeof(cl_float),
                             NULL);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg(callB) failed.");
 
     //Set global and local thread size
-    size_t globalThreads[] = {samplesPerVectorWidth * (numSteps + 1)};
-    size_t localThreads[] = {numSteps + 1};
-
-    if(localThreads[0] > deviceInfo.maxWorkItemSizes[0] ||
-            localThreads[0] > deviceInfo.maxWorkGroupSize)
-    {
-        std::cout << "Unsupported: Device does not support"
-                  "requested number of work items.";
-        return SDK_FAILURE;
-    }
-
-    if(kernelInfo.localMemoryUsed > deviceInfo.localMemSize)
-    {
-        std::cout << "Unsupported: Insufficient local memory on device." << std::endl;
-        return SDK_FAILURE;
-    }
+    size_t globalThreads[] = {numGroups * groupSize};
+    size_t localThreads[] = {groupSize};
 
     /**
-     * This algorithm reduces each group of work-items to a single value
+     * Every group reduces its trees to their roots
      * on OpenCL device
      */
     // Enqueue a kernel run call.
@@ -327,16 +803,16 @@ BinomialOption::runCLKernels()
     CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
 
     cl_event outMapEvt;
-    cl_uint* outMapPtr = (cl_uint*)clEnqueueMapBuffer(commandQueue,
-                         outBuffer,
-                         CL_FALSE,
-                         CL_MAP_READ,
-                         0,
-                         samplesPerVectorWidth * sizeof(cl_float4),
-                         0,
-                         NULL,
-                         &outMapEvt,
-                         &status);
+    cl_float* outMapPtr = (cl_float*)clEnqueueMapBuffer(commandQueue,
+                          outBuffer,
+                          CL_FALSE,
+                          CL_MAP_READ,
+                          0,
+                          numSamples * sizeof(cl_float),
+                          0,
+                          NULL,
+                          &outMapEvt,
+                          &status);
     CHECK_OPENCL_ERROR(status, "clEnqueueMapBuffer(outputBuffer) failed.");
 
     status = clFlush(commandQueue);
@@ -344,7 +820,7 @@ BinomialOption::runCLKernels()
 
     status = waitForEventAndRelease(&outMapEvt);
     CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(outMapEvt) Failed");
-    memcpy(output, outMapPtr, samplesPerVectorWidth * sizeof(cl_float4));
+    memcpy(output, outMapPtr, numSamples * sizeof(cl_float));
 
     cl_event outUnmapEvt;
     status = clEnqueueUnmapMemObject(commandQueue,
@@ -364,86 +840,128 @@ BinomialOption::runCLKernels()
 }
 
 /*
- * Reduces the input array (in place)
- * length specifies the length of the array
+ * Prices the book on the host, the batches of four options are
+ * handed out round robin so every thread gets deep and shallow trees
  */
 int
 BinomialOption::binomialOptionCPUReference()
 {
-    refOutput = (float*)malloc(samplesPerVectorWidth * sizeof(cl_float4));
-    CHECK_ALLOCATION(refOutput, "Failed to allocate host memory. (refOutput)");
-
-    float* stepsArray = (float*)malloc((numSteps + 1) * sizeof(cl_float4));
-    CHECK_ALLOCATION(stepsArray, "Failed to allocate host memory. (stepsArray)");
-
-    // Iterate for all samples
-    for(int bid = 0; bid < numSamples; ++bid)
-    {
-        float s[4];
-        float x[4];
-        float vsdt[4];
-        float puByr[4];
-        float pdByr[4];
-        float optionYears[4];
-
-        float inRand[4];
-
-        for(int i = 0; i < 4; ++i)
-        {
-            inRand[i] = randArray[bid + i];
-            s[i] = (1.0f - inRand[i]) * 5.0f + inRand[i] * 30.f;
-            x[i] = (1.0f - inRand[i]) * 1.0f + inRand[i] * 100.f;
-            optionYears[i] = (1.0f - inRand[i]) * 0.25f + inRand[i] * 10.f;
-            float dt = optionYears[i] * (1.0f / (float)numSteps);
-            vsdt[i] = VOLATILITY * sqrtf(dt);
-            float rdt = RISKFREE * dt;
-            float r = expf(rdt);
-            float rInv = 1.0f / r;
-            float u = expf(vsdt[i]);
-            float d = 1.0f / u;
-            float pu = (r - d)/(u - d);
-            float pd = 1.0f - pu;
-            puByr[i] = pu * rInv;
-            pdByr[i] = pd * rInv;
+    if(refOutput == NULL)
+    {
+        refOutput = (float*)malloc(numSamples * sizeof(cl_float));
+        CHECK_ALLOCATION(refOutput, "Failed to allocate host memory. (refOutput)");
+    }
+
+    int numBatches = (numSamples + 3) / 4;
+    int threads = cpuThreads < numBatches ? cpuThreads : numBatches;
+    BinomialThreadData* work = new BinomialThreadData[threads];
+    SDKThread* workers = new SDKThread[threads - 1];
+
+    for(int t = 0; t < threads; ++t)
+    {
+        work[t].params = params;
+        work[t].info = info;
+        work[t].order = &order[0];
+        work[t].result = refOutput;
+        work[t].numOptions = numSamples;
+        work[t].maxSteps = info[order[0]] & INFO_STEPS_MASK;
+        work[t].firstBatch = t;
+        work[t].stride = threads;
+    }
+
+    // the calling thread takes the last share
+    for(int t = 0; t < threads - 1; ++t)
+    {
+        workers[t].create(::binomialHostThread, (void *)(work + t));
+    }
+    binomialHostThread(work + threads - 1);
+    for(int t = 0; t < threads - 1; ++t)
+    {
+        workers[t].join();
+    }
+
+    delete []workers;
+    delete []work;
+
+    return SDK_SUCCESS;
+}
+
+int
+BinomialOption::runBenchmark()
+{
+    std::string strArray[9] =
+    {
+        "Depths",
+        "Option Samples",
+        "Groups",
+        "Groups(packed)",
+        "Utilization",
+        "Utilization(packed)",
+        "Options/sec",
+        "Options/sec(packed)",
+        "CPU Options/sec"
+    };
+
+    // A book from a file is the only distribution
+    int first = optionFile.empty() ? 0 : numDepths;
+    int last = optionFile.empty() ? numDepths - 1 : numDepths;
+    for(int distribution = first; distribution <= last; ++distribution)
+    {
+        std::string stats[9];
+        stats[0] = distribution < numDepths ? depthNames[distribution] : optionFile;
+        stats[1] = toString(numSamples, std::dec);
+        if(distribution < numDepths)
+        {
+            generateOptions(distribution);
         }
-        /**
-         * Compute values at expiration date:
-         * Call option value at period end is v(t) = s(t) - x
-         * If s(t) is greater than x, or zero otherwise...
-         * The computation is similar for put options...
-         */
-        for(int j = 0; j <= numSteps; j++)
+
+        for(int pack = 0; pack < 2; ++pack)
         {
-            for(int i = 0; i < 4; ++i)
+            packOptions(pack != 0);
+
+            // Warm up
+            if(runCLKernels())
             {
-                float profit = s[i] * expf(vsdt[i] * (2.0f * j - numSteps)) - x[i];
-                stepsArray[j * 4 + i] = profit > 0.0f ? profit : 0.0f;
+                return SDK_FAILURE;
             }
-        }
 
-        /**
-         * walk backwards up on the binomial tree of depth numSteps
-         * Reduce the price step by step
-         */
-        for(int j = numSteps; j > 0; --j)
-        {
-            for(int k = 0; k <= j - 1; ++k)
+            int timer = sampleTimer->createTimer();
+            sampleTimer->resetTimer(timer);
+            sampleTimer->startTimer(timer);
+            for(int i = 0; i < iterations; i++)
             {
-                for(int i = 0; i < 4; ++i)
+                if(runCLKernels())
                 {
-                    int index_k = k * 4 + i;
-                    int index_k_1 = (k + 1) * 4 + i;
-                    stepsArray[index_k] = pdByr[i] * stepsArray[index_k_1] + puByr[i] *
-                                          stepsArray[index_k];
+                    return SDK_FAILURE;
                 }
             }
+            sampleTimer->stopTimer(timer);
+            double time = (double)(sampleTimer->readTimer(timer)) / iterations;
+
+            stats[2 + pack] = toString(numGroups, std::dec);
+            stats[4 + pack] = toString(utilization, std::dec);
+            stats[6 + pack] = toString(numSamples / time, std::dec);
         }
 
-        //Copy the root to result
-        refOutput[bid] = stepsArray[0];
-    }
+        int timer = sampleTimer->createTimer();
+        sampleTimer->resetTimer(timer);
+        sampleTimer->startTimer(timer);
+        if(binomialOptionCPUReference() != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+        sampleTimer->stopTimer(timer);
+        stats[8] = toString(numSamples / (double)(sampleTimer->readTimer(timer)),
+                            std::dec);
 
-    free(stepsArray);
+        printStatistics(strArray, stats, 9);
+
+        if(sampleArgs->verify && !compare(output, refOutput, numSamples, 0.001f))
+        {
+            std::cout << "Failed! (" << stats[0] << ")\n" << std::endl;
+            return SDK_FAILURE;
+        }
+    }
 
     return SDK_SUCCESS;
 }
@@ -482,6 +1000,96 @@ int BinomialOption::initialize()
 
     delete num_iterations;
 
+    Option* num_steps = new Option;
+    CHECK_ALLOCATION(num_steps,
+                     "Error. Failed to allocate memory (num_steps)\n");
+
+    num_steps->_sVersion = "";
+    num_steps->_lVersion = "steps";
+    num_steps->_description =
+        "Time steps of the deepest generated tree (at most group size - 1)";
+    num_steps->_type = CA_ARG_INT;
+    num_steps->_value = &numSteps;
+
+    sampleArgs->AddOption(num_steps);
+
+    delete num_steps;
+
+    Option* option_file = new Option;
+    CHECK_ALLOCATION(option_file,
+                     "Error. Failed to allocate memory (option_file)\n");
+
+    option_file->_sVersion = "";
+    option_file->_lVersion = "file";
+    option_file->_description =
+        "Book to price, one option per line: "
+        "spot strike rate volatility years steps [E|A] [C|P]";
+    option_file->_type = CA_ARG_STRING;
+    option_file->_value = &optionFile;
+
+    sampleArgs->AddOption(option_file);
+
+    delete option_file;
+
+    Option* depth_option = new Option;
+    CHECK_ALLOCATION(depth_option,
+                     "Error. Failed to allocate memory (depth_option)\n");
+
+    depth_option->_sVersion = "";
+    depth_option->_lVersion = "depths";
+    depth_option->_description =
+        "Tree depths of a generated book : fixed, uniform or bimodal";
+    depth_option->_type = CA_ARG_STRING;
+    depth_option->_value = &depthName;
+
+    sampleArgs->AddOption(depth_option);
+
+    delete depth_option;
+
+    Option* nopack_option = new Option;
+    CHECK_ALLOCATION(nopack_option,
+                     "Error. Failed to allocate memory (nopack_option)\n");
+
+    nopack_option->_sVersion = "";
+    nopack_option->_lVersion = "noPack";
+    nopack_option->_description = "Give every option its own work-group";
+    nopack_option->_type = CA_NO_ARGUMENT;
+    nopack_option->_value = &noPack;
+
+    sampleArgs->AddOption(nopack_option);
+
+    delete nopack_option;
+
+    Option* bench_option = new Option;
+    CHECK_ALLOCATION(bench_option,
+                     "Error. Failed to allocate memory (bench_option)\n");
+
+    bench_option->_sVersion = "";
+    bench_option->_lVersion = "bench";
+    bench_option->_description =
+        "Options/sec of every depth distribution, packed and unpacked";
+    bench_option->_type = CA_NO_ARGUMENT;
+    bench_option->_value = &bench;
+
+    sampleArgs->AddOption(bench_option);
+
+    delete bench_option;
+
+    Option* threads_option = new Option;
+    CHECK_ALLOCATION(threads_option,
+                     "Error. Failed to allocate memory (threads_option)\n");
+
+    threads_option->_sVersion = "c";
+    threads_option->_lVersion = "cpuThreads";
+    threads_option->_description =
+        "Threads of the host engine used for verification (default: all cores)";
+    threads_option->_type = CA_ARG_INT;
+    threads_option->_value = &cpuThreads;
+
+    sampleArgs->AddOption(threads_option);
+
+    delete threads_option;
+
     return SDK_SUCCESS;
 }
 
@@ -503,12 +1111,19 @@ int BinomialOption::setup()
     // Compute setup time
     setupTime = (double)(sampleTimer->readTimer(timer));
 
+    packOptions(!noPack);
+
     return SDK_SUCCESS;
 }
 
 
 int BinomialOption::run()
 {
+    if(bench)
+    {
+        return runBenchmark();
+    }
+
     // Warm up
     for(int i = 0; i < 2 && iterations != 1; i++)
     {
@@ -553,12 +1168,19 @@ int BinomialOption::verifyResults()
     {
         /**
          * reference implementation
-         * it overwrites the input array with the output
+         * the host engine prices the same book
          */
+        int timer = sampleTimer->createTimer();
+        sampleTimer->resetTimer(timer);
+        sampleTimer->startTimer(timer);
+
         int result = SDK_SUCCESS;
         result = binomialOptionCPUReference();
         CHECK_ERROR(result, SDK_SUCCESS, "OpenCL  verifyResults  failed");
 
+        sampleTimer->stopTimer(timer);
+        cpuTime = (double)(sampleTimer->readTimer(timer));
+
         // compare the results and see if they match
         if(compare(output, refOutput, numSamples, 0.001f))
         {
@@ -588,11 +1210,13 @@ int BinomialOption::verifyResults()
 
 void BinomialOption::printStats()
 {
-    if(sampleArgs->timing)
+    if(sampleArgs->timing && !bench)
     {
-        std::string strArray[4] =
+        std::string strArray[8] =
         {
             "Option Samples",
+            "Groups",
+            "Utilization",
             "Time(sec)",
             "Transfer+kernel(sec)" ,
             "Options/sec"
@@ -600,13 +1224,24 @@ void BinomialOption::printStats()
 
         sampleTimer->totalTime = setupTime + kernelTime;
 
-        std::string stats[4];
+        std::string stats[8];
         stats[0] = toString(numSamples, std::dec);
-        stats[1] = toString(sampleTimer->totalTime, std::dec);
-        stats[2] = toString(kernelTime, std::dec);
-        stats[3] = toString(numSamples / sampleTimer->totalTime, std::dec);
+        stats[1] = toString(numGroups, std::dec);
+        stats[2] = toString(utilization, std::dec);
+        stats[3] = toString(sampleTimer->totalTime, std::dec);
+        stats[4] = toString(kernelTime, std::dec);
+        stats[5] = toString(numSamples / sampleTimer->totalTime, std::dec);
+        int count = 6;
+
+        if(sampleArgs->verify && cpuTime > 0)
+        {
+            strArray[count] = "CPU Threads";
+            stats[count++] = toString(cpuThreads, std::dec);
+            strArray[count] = "CPU Options/sec";
+            stats[count++] = toString(numSamples / cpuTime, std::dec);
+        }
 
-        printStatistics(strArray, stats, 4);
+        printStatistics(strArray, stats, count);
     }
 }
 
@@ -622,9 +1257,21 @@ BinomialOption::cleanup()
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.");
 
-    status = clReleaseMemObject(randBuffer);
+    status = clReleaseMemObject(paramBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
 
+    status = clReleaseMemObject(infoBuffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
+
+    status = clReleaseMemObject(groupBuffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
+
+    if(laneBuffer)
+    {
+        status = clReleaseMemObject(laneBuffer);
+        CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
+    }
+
     status = clReleaseMemObject(outBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
 
@@ -639,19 +1286,9 @@ BinomialOption::cleanup()
 
 BinomialOption::~BinomialOption()
 {
-
-#ifdef _WIN32
-    ALIGNED_FREE(randArray);
-#else
-    FREE(randArray);
-#endif
-
-#ifdef _WIN32
-    ALIGNED_FREE(output);
-#else
+    FREE(params);
+    FREE(info);
     FREE(output);
-#endif
-
     FREE(refOutput);
 
     FREE(devices);
@@ -26,6 +26,8 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <assert.h>
 #include <string.h>
 #include <malloc.h>
+#include <vector>
+#include <string>
 
 #include "CLUtil.hpp"
 
@@ -46,6 +48,33 @@ using namespace appsdk;
  */
 #define VOLATILITY 0.30f
 
+/**
+ * \GROUP_SIZE 256
+ * \brief Work-items per group, one tree node per work-item.
+ * Options of a book are packed into groups, so the deepest
+ * tree is limited to GROUP_SIZE - 1 steps.
+ */
+#define GROUP_SIZE 256
+
+/**
+ * Option parameters are stored structure of arrays,
+ * one row of numSamples values per field
+ */
+#define PARAM_SPOT      0
+#define PARAM_STRIKE    1
+#define PARAM_RATE      2
+#define PARAM_VOLATILITY 3
+#define PARAM_YEARS     4
+#define PARAM_COUNT     5
+
+/**
+ * info[] holds the number of time steps in the low 16 bits
+ * and the exercise style and option type above them
+ */
+#define INFO_STEPS_MASK 0xffff
+#define INFO_AMERICAN   0x10000
+#define INFO_PUT        0x20000
+
 
 /**
  * BinomialOption
@@ -56,15 +85,32 @@ class BinomialOption
 {
         cl_double setupTime;            /**< Time taken to setup OpenCL resources and building kernel */
         cl_double kernelTime;           /**< Time taken to run kernel and read result back */
+        cl_double cpuTime;              /**< Time taken by the host engine */
         cl_int numSamples;              /**< No. of  samples*/
-        cl_int samplesPerVectorWidth;   /**< No. of samples per vector width */
-        cl_int numSteps;                /**< No. of time steps*/
-        cl_float* randArray;            /**< Array of float random numbers */
+        cl_int numSteps;                /**< No. of time steps of the deepest generated tree */
+        cl_float* params;               /**< Option parameters, PARAM_COUNT rows of numSamples */
+        cl_int* info;                   /**< Steps, exercise style and type of every option */
         cl_float* output;               /**< Output result */
         cl_float* refOutput;            /**< Reference result */
+        std::string optionFile;         /**< Book to price, generated when empty */
+        std::string depthName;          /**< Depth distribution of a generated book */
+        int depth;                      /**< Depth distribution, index into depthNames */
+        bool noPack;                    /**< One option per work-group */
+        bool bench;                     /**< Compare depth distributions */
+        int cpuThreads;                 /**< Threads of the host engine */
+        size_t groupSize;               /**< Work-items per group */
+        cl_int numGroups;               /**< Work-groups of the current packing */
+        std::vector<cl_int> order;      /**< Options sorted by decreasing depth */
+        std::vector<cl_int2> laneMap;   /**< Option and tree node of every work-item */
+        std::vector<cl_int> groupSteps; /**< Deepest tree of every work-group */
+        double utilization;             /**< Node updates per work-item step */
         cl_context context;             /**< CL context */
         cl_device_id *devices;          /**< CL device list */
-        cl_mem randBuffer;              /**< CL memory buffer for random numbers */
+        cl_mem paramBuffer;             /**< CL memory buffer for option parameters */
+        cl_mem infoBuffer;              /**< CL memory buffer for steps and flags */
+        cl_mem laneBuffer;              /**< CL memory buffer for the lane map */
+        cl_mem groupBuffer;             /**< CL memory buffer for the group depths */
+        size_t laneCapacity;            /**< Work-items laneBuffer can hold */
         cl_mem outBuffer;               /**< CL memory buffer for output*/
         cl_command_queue commandQueue;  /**< CL command queue */
         cl_program program;             /**< CL program  */
@@ -78,6 +124,35 @@ class BinomialOption
 
         float random(float randMax, float randMin);
 
+        /**
+         * Read a book, one option per line:
+         * spot strike rate volatility years steps [E|A] [C|P]
+         * Empty lines and lines starting with # are skipped
+         * @param fileName name of the book
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int readOptions(std::string fileName);
+
+        /**
+         * Generate a random book of numSamples options, half of them
+         * American puts, with tree depths drawn from a distribution
+         * @param distribution index into depthNames
+         */
+        void generateOptions(int distribution);
+
+        /**
+         * Sort the options by depth and pack their trees into
+         * work-groups first fit, fills laneMap and groupSteps
+         * @param pack false to give every option its own group
+         */
+        void packOptions(bool pack);
+
+        /**
+         * Copy the book and the lane map to the device
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int writeOptions();
+
     public:
         CLCommandArgs   *sampleArgs;   /**< CLCommand argument class */
         /**
@@ -87,10 +162,23 @@ class BinomialOption
         BinomialOption()
             : setupTime(0),
               kernelTime(0),
-              randArray(NULL),
+              cpuTime(0),
+              params(NULL),
+              info(NULL),
               output(NULL),
               refOutput(NULL),
+              depthName("fixed"),
+              depth(0),
+              noPack(false),
+              bench(false),
+              cpuThreads(0),
+              groupSize(GROUP_SIZE),
+              numGroups(0),
+              utilization(0),
               devices(NULL),
+              laneBuffer(NULL),
+              groupBuffer(NULL),
+              laneCapacity(0),
               iterations(1)
         {
             numSamples = 256;
@@ -133,11 +221,20 @@ class BinomialOption
 
         /**
          * Reference CPU implementation of Binomial Option
-         * for performance comparison
+         * for performance comparison. Batches of four options of
+         * similar depth are priced with SSE, the batches are
+         * spread over cpuThreads threads
          * @return SDK_SUCCESS on success and SDK_FAILURE on failure
          */
         int binomialOptionCPUReference();
 
+        /**
+         * Options per second of the device and the host engine
+         * for every depth distribution, packed and unpacked
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int runBenchmark();
+
         /**
          * Override from SDKSample. Print sample stats.
          */
@@ -18,74 +18,118 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
  * For a description of the algorithm and the terms used, please see the
  * documentation for this sample.
  *
- * Each group invocation of this kernel, calculates the option value for a 
- * given stoke price, option strike price, time to expiration date, risk 
- * free interest and volatility factor.
+ * Each work-item holds one node of a binomial tree. The host packs the
+ * trees of several options into a group (laneMap gives the option and
+ * the node of every work-item), an option with n time steps takes n + 1
+ * consecutive work-items, so the maximum number of steps is limited by
+ * the group size.
  *
- * Multiple groups calculate the same with different input values.
- * Number of work-items in each group is same as number of leaf nodes
- * So, the maximum number of steps is limited by loca memory size available
+ * Every option has its own stock price, strike price, time to expiration
+ * date, risk free interest, volatility, number of steps, exercise style
+ * and type. All trees of a group start at their leaves together, an
+ * option of n steps reaches its root after n rounds and stores it, the
+ * group runs as many rounds as its deepest tree.
  *
- * Each work-item calculate the leaf-node value and update local memory. 
- * These leaf nodes are further reduced to the root of the tree (time step 0). 
+ * American options compare the continuation value with the value of
+ * exercising at every node. The stock price of the node is carried along:
+ * node k of level j has price s * u^(2k - j), one level up the same node
+ * has price s * u^(2k - j + 1).
  */
 
-#define RISKFREE 0.02f
-#define VOLATILITY 0.30f
+#define PARAM_SPOT      0
+#define PARAM_STRIKE    1
+#define PARAM_RATE      2
+#define PARAM_VOLATILITY 3
+#define PARAM_YEARS     4
+
+#define INFO_STEPS_MASK 0xffff
+#define INFO_AMERICAN   0x10000
+#define INFO_PUT        0x20000
 
 __kernel
 void 
 binomial_options(
-    int numSteps,
-    const __global float4* randArray,
-    __global float4* output,
-    __local float4* callA,
-    __local float4* callB)
+    int numOptions,
+    const __global float* params,
+    const __global int* info,
+    const __global int2* laneMap,
+    const __global int* groupSteps,
+    __global float* output,
+    __local float* callA,
+    __local float* callB)
 {
-    // load shared mem
     unsigned int tid = get_local_id(0);
-    unsigned int bid = get_group_id(0);
-
-    float4 inRand = randArray[bid];
-
-    float4 s = (1.0f - inRand) * 5.0f + inRand * 30.f;
-    float4 x = (1.0f - inRand) * 1.0f + inRand * 100.f;
-    float4 optionYears = (1.0f - inRand) * 0.25f + inRand * 10.f; 
-    float4 dt = optionYears * (1.0f / (float)numSteps);
-    float4 vsdt = VOLATILITY * sqrt(dt);
-    float4 rdt = RISKFREE * dt;
-    float4 r = exp(rdt);
-    float4 rInv = 1.0f / r;
-    float4 u = exp(vsdt);
-    float4 d = 1.0f / u;
-    float4 pu = (r - d)/(u - d);
-    float4 pd = 1.0f - pu;
-    float4 puByr = pu * rInv;
-    float4 pdByr = pd * rInv;
-
-    float4 profit = s * exp(vsdt * (2.0f * tid - (float)numSteps)) - x;
-    callA[tid].x = profit.x > 0 ? profit.x : 0.0f;
-    callA[tid].y = profit.y > 0 ? profit.y : 0.0f;
-    callA[tid].z = profit.z > 0 ? profit.z: 0.0f;
-    callA[tid].w = profit.w > 0 ? profit.w: 0.0f;
+    int2 lane = laneMap[get_global_id(0)];
+    int option = lane.x;
+    int k = lane.y;
+    int rounds = groupSteps[get_group_id(0)];
+
+    int numSteps = 0;
+    float x = 0.0f;
+    float u = 1.0f;
+    float price = 0.0f;
+    float puByr = 0.0f;
+    float pdByr = 0.0f;
+    float sign = 1.0f;
+    int american = 0;
+
+    if(option >= 0)
+    {
+        int flags = info[option];
+        numSteps = flags & INFO_STEPS_MASK;
+        american = (flags & INFO_AMERICAN) != 0;
+        sign = (flags & INFO_PUT) ? -1.0f : 1.0f;
+
+        float s = params[PARAM_SPOT * numOptions + option];
+        x = params[PARAM_STRIKE * numOptions + option];
+        float riskFree = params[PARAM_RATE * numOptions + option];
+        float volatility = params[PARAM_VOLATILITY * numOptions + option];
+        float optionYears = params[PARAM_YEARS * numOptions + option];
+
+        float dt = optionYears * (1.0f / (float)numSteps);
+        float vsdt = volatility * sqrt(dt);
+        float rdt = riskFree * dt;
+        float r = exp(rdt);
+        float rInv = 1.0f / r;
+        u = exp(vsdt);
+        float d = 1.0f / u;
+        float pu = (r - d)/(u - d);
+        float pd = 1.0f - pu;
+        puByr = pu * rInv;
+        pdByr = pd * rInv;
+
+        price = s * exp(vsdt * (2.0f * k - (float)numSteps));
+        float profit = sign * (price - x);
+        callA[tid] = profit > 0.0f ? profit : 0.0f;
+    }
 
     barrier(CLK_LOCAL_MEM_FENCE);
 
-    for(int j = numSteps; j > 0; j -= 2)
+    // Level j = numSteps - round of every tree, nodes 0 .. j - 1 are reduced
+    for(int round = 0; round < rounds; ++round)
     {
-        if(tid < j)
+        int j = numSteps - round;
+        if(k < j)
         {
-            callB[tid] = puByr * callA[tid] + pdByr * callA[tid + 1];
-        }
-        barrier(CLK_LOCAL_MEM_FENCE);
+            float value = puByr * callA[tid + 1] + pdByr * callA[tid];
+            price *= u;
+            if(american)
+            {
+                float exercise = sign * (price - x);
+                value = exercise > value ? exercise : value;
+            }
+            callB[tid] = value;
 
-        if(tid < j - 1)
-        {
-            callA[tid] = puByr * callB[tid] + pdByr * callB[tid + 1];
+            // write the root of this tree to global mem
+            if(j == 1)
+            {
+                output[option] = value;
+            }
         }
         barrier(CLK_LOCAL_MEM_FENCE);
-    }
 
-    // write result for this block to global mem
-    if(tid == 0) output[bid] = callA[0];
-}
\ No newline at end of file
+        __local float* swap = callA;
+        callA = callB;
+        callB = swap;
+    }
+}
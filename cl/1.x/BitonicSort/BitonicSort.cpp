@@ -211,6 +211,29 @@ BitonicSort::setupCL(void)
     kernel = clCreateKernel(program, "bitonicSort", &status);
     CHECK_OPENCL_ERROR(status, "clCreateKernel failed.");
 
+    persistentKernel = clCreateKernel(program, "bitonicSortPersistent", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (bitonicSortPersistent)");
+
+    status = clGetKernelWorkGroupInfo(persistentKernel,
+                                      devices[sampleArgs->deviceId],
+                                      CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t),
+                                      &persistentGroupSize, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetKernelWorkGroupInfo failed.");
+    if(persistentGroupSize > GROUP_SIZE)
+    {
+        persistentGroupSize = GROUP_SIZE;
+    }
+
+    // The passes are issued by the batcher, see runCLKernels()
+    LaunchStrategy strategy;
+    if(LaunchProfile::parseStrategy(launchStrategy, strategy) != SDK_SUCCESS)
+    {
+        std::cout << "Unknown launch strategy " << launchStrategy << std::endl;
+        return SDK_FAILURE;
+    }
+    retValue = batcher.create(commandQueue, strategy);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "LaunchBatcher::create() failed");
+
     return SDK_SUCCESS;
 }
 
@@ -306,6 +329,33 @@ BitonicSort::runCLKernels(void)
                  (void *)&sortFlag);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (increasing)");
 
+    /*
+     * The passes only depend on each other, the batcher decides how often
+     * the host flushes and waits, or runs them all in one work-group
+     */
+    LaunchStrategy strategy = batcher.begin(length / 2, true);
+    if(strategy == LAUNCH_PERSISTENT)
+    {
+        cl_uint numPairs = length / 2;
+        status = clSetKernelArg(persistentKernel, 0, sizeof(cl_mem),
+                                (void *)&inputBuffer);
+        status |= clSetKernelArg(persistentKernel, 1, sizeof(cl_uint),
+                                 (void *)&numStages);
+        status |= clSetKernelArg(persistentKernel, 2, sizeof(cl_uint),
+                                 (void *)&numPairs);
+        status |= clSetKernelArg(persistentKernel, 3, sizeof(cl_uint),
+                                 (void *)&sortFlag);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (persistentKernel)");
+
+        status = batcher.launch(persistentKernel, 1, &persistentGroupSize,
+                                &persistentGroupSize);
+        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+
+        status = batcher.end();
+        CHECK_ERROR(status, 0, "LaunchBatcher::end() failed");
+        return SDK_SUCCESS;
+    }
+
     for(stage = 0; stage < numStages; ++stage)
     {
         // stage of the algorithm
@@ -334,27 +384,13 @@ BitonicSort::runCLKernels(void)
              * Each thread writes a sorted pair.
              * So, the number of  threads (global) is half the length.
              */
-            cl_event ndrEvt;
-            status = clEnqueueNDRangeKernel(
-                         commandQueue,
-                         kernel,
-                         1,
-                         NULL,
-                         globalThreads,
-                         localThreads,
-                         0,
-                         NULL,
-                         &ndrEvt);
-
+            status = batcher.launch(kernel, 1, globalThreads, localThreads);
             CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
-
-            status = clFlush(commandQueue);
-            CHECK_OPENCL_ERROR(status, "clFlush failed.");
-
-            status = waitForEventAndRelease(&ndrEvt);
-            CHECK_ERROR(status, 0, "WaitForEventAndRelease(ndrEvt) Failed");
         }
     }
+
+    status = batcher.end();
+    CHECK_ERROR(status, 0, "LaunchBatcher::end() failed");
     return SDK_SUCCESS;
 }
 
@@ -467,6 +503,19 @@ int BitonicSort::initialize()
 
     delete num_iterations;
 
+    Option* launch_option = new Option;
+    CHECK_ALLOCATION(launch_option, "Memory allocation error.\n");
+
+    launch_option->_sVersion = "";
+    launch_option->_lVersion = "launch";
+    launch_option->_description =
+        "Launch strategy of the passes : sync, flush, batched, persistent or auto";
+    launch_option->_type = CA_ARG_STRING;
+    launch_option->_value = &launchStrategy;
+    sampleArgs->AddOption(launch_option);
+
+    delete launch_option;
+
     return SDK_SUCCESS;
 }
 
@@ -608,6 +657,7 @@ void BitonicSort::printStats()
         stats[3]  = toString(( length/sampleTimer->totalTime ), std::dec);
 
         printStatistics(strArray, stats, 4);
+        batcher.printStats();
     }
 }
 int BitonicSort::cleanup()
@@ -618,6 +668,9 @@ int BitonicSort::cleanup()
     status = clReleaseKernel(kernel);
     CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.");
 
+    status = clReleaseKernel(persistentKernel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed. (persistentKernel)");
+
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.");
 
@@ -25,6 +25,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <string.h>
 
 #include "CLUtil.hpp"
+#include "LaunchBatcher.hpp"
 
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.2"
 
@@ -59,6 +60,10 @@ class BitonicSort
         cl_kernel              kernel;    /**< CL kernel */
         int                iterations;    /**< Number of iterations to execute kernel */
         KernelWorkGroupInfo kernelInfo;/**< Structure to store kernel related info */
+        cl_kernel    persistentKernel;    /**< Every pass in one work-group */
+        size_t    persistentGroupSize;    /**< Work-group size of persistentKernel */
+        LaunchBatcher         batcher;    /**< Issues the passes */
+        std::string    launchStrategy;    /**< Strategy name given with --launch */
 
         SDKTimer    *sampleTimer;      /**< SDKTimer object */
     public:
@@ -79,6 +84,8 @@ class BitonicSort
             setupTime = 0;
             totalKernelTime = 0;
             iterations = 1;
+            persistentGroupSize = 0;
+            launchStrategy = "auto";
             sampleArgs = new CLCommandArgs() ;
             sampleTimer = new SDKTimer();
             sampleArgs->sampleVerStr = SAMPLE_VERSION;
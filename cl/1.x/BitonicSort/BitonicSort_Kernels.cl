@@ -38,14 +38,14 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
  * has been explained in detail in the document mentioned above.
  */
 
-__kernel 
-void bitonicSort(__global uint * theArray,
-                 const uint stage, 
-                 const uint passOfStage,
-                 const uint direction)
+inline
+void bitonicCompare(__global uint * theArray,
+                    const uint stage,
+                    const uint passOfStage,
+                    const uint direction,
+                    const uint threadId)
 {
     uint sortIncreasing = direction;
-    uint threadId = get_global_id(0);
     
     uint pairDistance = 1 << (stage - passOfStage);
     uint blockWidth   = 2 * pairDistance;
@@ -87,3 +87,40 @@ void bitonicSort(__global uint * theArray,
         theArray[rightId] = lesser;
     }
 }
+
+__kernel 
+void bitonicSort(__global uint * theArray,
+                 const uint stage, 
+                 const uint passOfStage,
+                 const uint direction)
+{
+    bitonicCompare(theArray, stage, passOfStage, direction, get_global_id(0));
+}
+
+/*
+ * Every stage and pass of bitonicSort in a single work-group, for arrays
+ * small enough that a launch per pass costs more than the pass itself.
+ * numPairs is half the length of the array, the barrier orders the passes.
+ */
+
+__kernel
+void bitonicSortPersistent(__global uint * theArray,
+                           const uint numStages,
+                           const uint numPairs,
+                           const uint direction)
+{
+    uint localId = get_local_id(0);
+    uint localSize = get_local_size(0);
+
+    for(uint stage = 0; stage < numStages; ++stage)
+    {
+        for(uint passOfStage = 0; passOfStage < stage + 1; ++passOfStage)
+        {
+            for(uint threadId = localId; threadId < numPairs; threadId += localSize)
+            {
+                bitonicCompare(theArray, stage, passOfStage, direction, threadId);
+            }
+            barrier(CLK_GLOBAL_MEM_FENCE);
+        }
+    }
+}
@@ -186,6 +186,13 @@ BlackScholes::setupCL(void)
         }
     }
 
+#ifdef BATCH_RUNNER
+    // Context of the batch, created by the first sample that needs it
+    cl_platform_id platform = NULL;
+    int retValue = CLRuntime::getInstance().getContext(sampleArgs, dType,
+                   platform, context);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::getContext() failed");
+#else
     /*
      * Have a look at the available platforms and pick either
      * the AMD one if available or a reasonable default.
@@ -214,6 +221,7 @@ BlackScholes::setupCL(void)
                                       NULL,
                                       &status);
     CHECK_OPENCL_ERROR(status, "clCreateContextFromType failed.");
+#endif
 
     // getting device on which to run the sample
     status = getDevices(context, &devices,sampleArgs-> deviceId,
@@ -223,11 +231,17 @@ BlackScholes::setupCL(void)
     {
         // The block is to move the declaration of prop closer to its use
         cl_command_queue_properties prop = CL_QUEUE_PROFILING_ENABLE;
+#ifdef BATCH_RUNNER
+        status = CLRuntime::getInstance().getCommandQueue(context,
+                 devices[sampleArgs->deviceId], prop, commandQueue);
+        CHECK_ERROR(status, SDK_SUCCESS, "CLRuntime::getCommandQueue() failed");
+#else
         commandQueue = clCreateCommandQueue(context,
                                             devices[sampleArgs->deviceId],
                                             prop,
                                             &status);
         CHECK_OPENCL_ERROR(status, "clCreateCommandQueue failed.");
+#endif
     }
     //Set device info of given cl_device_id
     retValue = deviceInfo.setDeviceInfo(devices[sampleArgs->deviceId]);
@@ -241,25 +255,25 @@ BlackScholes::setupCL(void)
         inMemFlags |= CL_MEM_USE_PERSISTENT_MEM_AMD;
     }
 
-    randBuf = clCreateBuffer(context,
-                             inMemFlags,
-                             sizeof(cl_float4) * width  * height,
-                             NULL,
-                             &status);
+    randBuf = CREATE_BUFFER(context,
+                            inMemFlags,
+                            sizeof(cl_float4) * width  * height,
+                            NULL,
+                            &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (randBuf)");
 
-    callPriceBuf = clCreateBuffer(context,
-                                  CL_MEM_WRITE_ONLY,
-                                  sizeof(cl_float4) * width * height,
-                                  NULL,
-                                  &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (callPriceBuf)");
-
-    putPriceBuf = clCreateBuffer(context,
+    callPriceBuf = CREATE_BUFFER(context,
                                  CL_MEM_WRITE_ONLY,
                                  sizeof(cl_float4) * width * height,
                                  NULL,
                                  &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (callPriceBuf)");
+
+    putPriceBuf = CREATE_BUFFER(context,
+                                CL_MEM_WRITE_ONLY,
+                                sizeof(cl_float4) * width * height,
+                                NULL,
+                                &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (putPriceBuf)");
 
     // create a CL program using the kernel source
@@ -278,7 +292,11 @@ BlackScholes::setupCL(void)
         buildData.flagsFileName = std::string(sampleArgs->flags.c_str());
     }
 
+#ifdef BATCH_RUNNER
+    retValue = CLRuntime::getInstance().getProgram(context, buildData, program);
+#else
     retValue = buildOpenCLProgram(program, context, buildData);
+#endif
     CHECK_ERROR(retValue, SDK_SUCCESS, "buildOpenCLProgram() failed");
 
 
@@ -434,27 +452,27 @@ BlackScholes::runCLKernels(void)
     cl_event putEvent;
 
     // Enqueue the results to application pointer
-    status = clEnqueueReadBuffer(commandQueue,
-                                 callPriceBuf,
-                                 CL_FALSE,
-                                 0,
-                                 width * height * sizeof(cl_float4),
-                                 deviceCallPrice,
-                                 0,
-                                 NULL,
-                                 &callEvent);
+    status = READ_BUFFER(commandQueue,
+                         callPriceBuf,
+                         CL_FALSE,
+                         0,
+                         width * height * sizeof(cl_float4),
+                         deviceCallPrice,
+                         0,
+                         NULL,
+                         &callEvent);
     CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.");
 
     // Enqueue the results to application pointer
-    status = clEnqueueReadBuffer(commandQueue,
-                                 putPriceBuf,
-                                 CL_FALSE,
-                                 0,
-                                 width * height * sizeof(cl_float4),
-                                 devicePutPrice,
-                                 0,
-                                 NULL,
-                                 &putEvent);
+    status = READ_BUFFER(commandQueue,
+                         putPriceBuf,
+                         CL_FALSE,
+                         0,
+                         width * height * sizeof(cl_float4),
+                         devicePutPrice,
+                         0,
+                         NULL,
+                         &putEvent);
     CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.");
 
     status = clFlush(commandQueue);
@@ -656,13 +674,13 @@ int BlackScholes::cleanup()
 {
     // Releases OpenCL resources (Context, Memory etc.)
     cl_int status;
-    status = clReleaseMemObject(randBuf);
+    status = RELEASE_BUFFER(randBuf);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject(randBuf) failed.");
 
-    status = clReleaseMemObject(callPriceBuf);
+    status = RELEASE_BUFFER(callPriceBuf);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject(callPriceBuf) failed.");
 
-    status = clReleaseMemObject(putPriceBuf);
+    status = RELEASE_BUFFER(putPriceBuf);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject(callPriceBuf) failed.");
 
     status = clReleaseKernel(kernel);
@@ -694,8 +712,13 @@ int BlackScholes::cleanup()
     return SDK_SUCCESS;
 }
 
+#ifdef BATCH_RUNNER
+static int
+runBlackScholes(int argc, char * argv[])
+#else
 int
 main(int argc, char * argv[])
+#endif
 {
     // Create MonteCalroAsian object
     BlackScholes clBlackScholes;
@@ -748,3 +771,7 @@ main(int argc, char * argv[])
 
     return SDK_SUCCESS;
 }
+
+#ifdef BATCH_RUNNER
+REGISTER_SAMPLE("BlackScholes", runBlackScholes);
+#endif
@@ -25,6 +25,16 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #include "CLUtil.hpp"
 
+#ifdef BATCH_RUNNER
+// Shared runtime of BatchRunner : pooled buffers and staged transfers
+#include "CLRuntime.hpp"
+#else
+#define CREATE_BUFFER clCreateBuffer
+#define RELEASE_BUFFER clReleaseMemObject
+#define WRITE_BUFFER clEnqueueWriteBuffer
+#define READ_BUFFER clEnqueueReadBuffer
+#endif
+
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.3"
 
 using namespace appsdk;
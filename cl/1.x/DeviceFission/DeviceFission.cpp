@@ -15,6 +15,9 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 ********************************************************************/
 
 #include "DeviceFission.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 
 
 
@@ -123,31 +126,26 @@ DeviceFission::setupCLPlatform()
     subKernel = (cl_kernel*)malloc(numSubDevices * sizeof(cl_kernel));
     CHECK_ALLOCATION(subKernel, "Failed to allocate memory. (subKernel)");
 
-    // Get maxSubDevices from clGetDeviceInfo
-    cl_uint maxSubDevices;
-    status = clGetDeviceInfo(cpuDevice, CL_DEVICE_PARTITION_MAX_SUB_DEVICES,
-                             sizeof(maxSubDevices), &maxSubDevices, NULL);
-    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo failed. (maxSubDevices)")
+    // Get maxSubDevices and the supported partitions of the CPU device
+    retValue = partitionManager.create(rContext, cpuDevice);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "PartitionManager::create() failed");
 
+    cl_uint maxSubDevices = partitionManager.maxSubDevices();
     if(maxSubDevices <= 1)
     {
         std::cout<<"Error: The CPU should have more than one core to run this sample."<<std::endl;
         return SDK_FAILURE;
     }
 
-    // Initialize required partition property
-    cl_device_partition_property partitionPrty[5] =
-    {
-        CL_DEVICE_PARTITION_BY_COUNTS,
-        maxSubDevices / 2, maxSubDevices / 2,
-        CL_DEVICE_PARTITION_BY_COUNTS_LIST_END,
-        0
-    };
+    // Create sub-devices of half the compute units each
+    std::vector<cl_uint> counts(numSubDevices, maxSubDevices / 2);
+    retValue = partitionManager.partitionByCounts(counts);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "PartitionManager::partitionByCounts() failed");
 
-    // Create sub-devices
-    status = clCreateSubDevices(cpuDevice, partitionPrty, numSubDevices, subDevices,
-                                NULL);
-    CHECK_OPENCL_ERROR( status, "clCreateSubDevices failed.");
+    for(cl_uint i = 0; i < numSubDevices; i++)
+    {
+        subDevices[i] = partitionManager.device(i);
+    }
 
     return SDK_SUCCESS;
 }
@@ -194,15 +192,16 @@ DeviceFission::setupCLRuntime()
             cl_command_queue));
     CHECK_ALLOCATION(subCmdQueue,"Failed to allocate memory. (subCmdQueue)");
 
-    // Create command queue subCmdQueue
+    // Create command queue subCmdQueue, tenant i runs on sub-device i
     for(cl_uint i = 0; i < numSubDevices; i++)
     {
-        // Create command queue
-        subCmdQueue[i] = clCreateCommandQueue(rContext,
-                                              subDevices[i],
-                                              0,
-                                              &status);
-        CHECK_OPENCL_ERROR(status, "clCreateCommandQueue failed. (subCmdQueue)");
+        int tenant = partitionManager.addTenant(0);
+        if(tenant < 0)
+        {
+            error("PartitionManager::addTenant() failed. (subCmdQueue)");
+            return SDK_FAILURE;
+        }
+        subCmdQueue[i] = partitionManager.queue(tenant);
     }
 
     // Create memory objects for input
@@ -517,6 +516,459 @@ DeviceFission::runCLKernels()
     return SDK_SUCCESS;
 }
 
+/*
+ * Runs the jobs of one tenant back to back, latencies come from the
+ * event profiling of every job
+ */
+static void* tenantThread(void* data)
+{
+    TenantWork* work = (TenantWork*)data;
+    work->latencies.clear();
+
+    for(cl_int j = 0; j < work->jobs; ++j)
+    {
+        cl_event jobEvent;
+        cl_ulong queued = 0;
+        cl_ulong end = 0;
+
+        work->status = clEnqueueNDRangeKernel(work->queue,
+                                              work->kernel,
+                                              1,
+                                              NULL,
+                                              &work->globalSize,
+                                              NULL,
+                                              0,
+                                              NULL,
+                                              &jobEvent);
+        if(work->status != CL_SUCCESS)
+        {
+            return NULL;
+        }
+
+        work->status = clWaitForEvents(1, &jobEvent);
+        if(work->status == CL_SUCCESS)
+        {
+            work->status = clGetEventProfilingInfo(jobEvent,
+                                                   CL_PROFILING_COMMAND_QUEUED,
+                                                   sizeof(cl_ulong),
+                                                   &queued,
+                                                   NULL);
+        }
+        if(work->status == CL_SUCCESS)
+        {
+            work->status = clGetEventProfilingInfo(jobEvent,
+                                                   CL_PROFILING_COMMAND_END,
+                                                   sizeof(cl_ulong),
+                                                   &end,
+                                                   NULL);
+        }
+        clReleaseEvent(jobEvent);
+        if(work->status != CL_SUCCESS)
+        {
+            return NULL;
+        }
+
+        work->latencies.push_back((end - queued) * 1e-6);
+    }
+
+    return NULL;
+}
+
+/*
+ * Latency below which a fraction 'q' of the sorted latencies lies
+ */
+static double percentile(const std::vector<double>& sorted, double q)
+{
+    if(sorted.empty())
+    {
+        return 0.0;
+    }
+    size_t index = (size_t)(q * sorted.size() + 0.999999);
+    index = (index == 0) ? 0 : index - 1;
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int
+DeviceFission::partitionColocation()
+{
+    cl_uint rootUnits = colocation.rootComputeUnits();
+
+    if(partitionMode == "equal")
+    {
+        // One partition per tenant unless the size is given
+        cl_uint units = (unitsPerPartition > 0) ? (cl_uint)unitsPerPartition :
+                        std::max(rootUnits / tenants, 1u);
+        return colocation.partitionEqually(units);
+    }
+
+    if(partitionMode == "counts")
+    {
+        std::vector<cl_uint> counts;
+        std::stringstream list(countsList);
+        std::string entry;
+        while(std::getline(list, entry, ','))
+        {
+            int count = atoi(entry.c_str());
+            if(count <= 0)
+            {
+                std::cout << "Error: Invalid compute unit count : " << entry << std::endl;
+                return SDK_FAILURE;
+            }
+            counts.push_back((cl_uint)count);
+        }
+
+        // Without a list the tenants get equal counts
+        if(counts.empty())
+        {
+            counts.assign(tenants, std::max(rootUnits / tenants, 1u));
+        }
+        return colocation.partitionByCounts(counts);
+    }
+
+    cl_device_affinity_domain domain = CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE;
+    if(affinityName == "numa")
+    {
+        domain = CL_DEVICE_AFFINITY_DOMAIN_NUMA;
+    }
+    else if(affinityName == "l4")
+    {
+        domain = CL_DEVICE_AFFINITY_DOMAIN_L4_CACHE;
+    }
+    else if(affinityName == "l3")
+    {
+        domain = CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE;
+    }
+    else if(affinityName == "l2")
+    {
+        domain = CL_DEVICE_AFFINITY_DOMAIN_L2_CACHE;
+    }
+    else if(affinityName == "l1")
+    {
+        domain = CL_DEVICE_AFFINITY_DOMAIN_L1_CACHE;
+    }
+    return colocation.partitionByAffinity(domain);
+}
+
+int
+DeviceFission::runColocationPhase(const char* name, const std::string& source)
+{
+    cl_int status;
+
+    // The program is built for the devices the tenants run on now
+    const char* src = source.c_str();
+    size_t sourceSize[] = {source.size()};
+    cl_program program = clCreateProgramWithSource(rContext,
+                                                   1,
+                                                   &src,
+                                                   sourceSize,
+                                                   &status);
+    CHECK_OPENCL_ERROR(status, "clCreateProgramWithSource failed.(colocation)");
+
+    status = clBuildProgram(program,
+                            colocation.numDevices(),
+                            colocation.devices(),
+                            NULL,
+                            NULL,
+                            NULL);
+    if(status != CL_SUCCESS)
+    {
+        clReleaseProgram(program);
+    }
+    CHECK_OPENCL_ERROR(status, "clBuildProgram failed.(colocation)");
+
+    // Even tenants are compute bound, odd tenants memory bound
+    std::vector<TenantWork> work(tenants);
+    for(cl_int t = 0; t < tenants; ++t)
+    {
+        bool compute = (t % 2 == 0);
+        work[t].queue = colocation.queue(t);
+        work[t].jobs = jobs;
+        work[t].status = CL_SUCCESS;
+        work[t].globalSize = compute ? jobLength : jobLength / 4;
+        work[t].kernel = clCreateKernel(program, compute ? "Compute" : "Stream", &status);
+        CHECK_OPENCL_ERROR(status, "clCreateKernel failed.(colocation)");
+
+        status = clSetKernelArg(work[t].kernel, 0, sizeof(cl_mem), (void*)&tenantIn[t]);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (tenantIn)");
+
+        status = clSetKernelArg(work[t].kernel, 1, sizeof(cl_mem), (void*)&tenantOut[t]);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (tenantOut)");
+
+        if(compute)
+        {
+            status = clSetKernelArg(work[t].kernel, 2, sizeof(cl_int), (void*)&rounds);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (rounds)");
+        }
+    }
+
+    // All tenants submit at the same time, each from its own thread
+    int timer = sampleTimer->createTimer();
+    sampleTimer->resetTimer(timer);
+    sampleTimer->startTimer(timer);
+
+    SDKThread* threads = new SDKThread[tenants];
+    for(cl_int t = 0; t < tenants; ++t)
+    {
+        threads[t].create(tenantThread, (void*)&work[t]);
+    }
+    for(cl_int t = 0; t < tenants; ++t)
+    {
+        threads[t].join();
+    }
+    delete [] threads;
+
+    sampleTimer->stopTimer(timer);
+
+    ColocationPhase phase;
+    phase.name = name;
+    phase.seconds = (double)(sampleTimer->readTimer(timer));
+    for(cl_int t = 0; t < tenants; ++t)
+    {
+        phase.units.push_back(colocation.numPartitions() ?
+                              colocation.computeUnits(colocation.tenantPartition(t)) :
+                              colocation.rootComputeUnits());
+        phase.latencies.push_back(work[t].latencies);
+    }
+    phases.push_back(phase);
+
+    for(cl_int t = 0; t < tenants; ++t)
+    {
+        if(work[t].status != CL_SUCCESS)
+        {
+            std::cout << "Error: Tenant " << t << " failed in phase " << name << std::endl;
+            return SDK_FAILURE;
+        }
+    }
+
+    // Output of the last job of every tenant
+    if(sampleArgs->verify)
+    {
+        for(cl_int t = 0; t < tenants; ++t)
+        {
+            status = clEnqueueReadBuffer(colocation.queue(t),
+                                         tenantOut[t],
+                                         CL_TRUE,
+                                         0,
+                                         jobLength * sizeof(cl_int),
+                                         tenantOutput,
+                                         0,
+                                         NULL,
+                                         NULL);
+            CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed. (tenantOut)");
+
+            for(cl_uint i = 0; i < jobLength; ++i)
+            {
+                cl_uint x = (cl_uint)tenantInput[i];
+                if(t % 2 == 0)
+                {
+                    for(cl_int r = 0; r < rounds; ++r)
+                    {
+                        x = x * 1664525u + 1013904223u;
+                        x ^= x >> 16;
+                    }
+                }
+                else
+                {
+                    x += 1;
+                }
+
+                if(tenantOutput[i] != (cl_int)x)
+                {
+                    colocationPassed = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    for(cl_int t = 0; t < tenants; ++t)
+    {
+        status = clReleaseKernel(work[t].kernel);
+        CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(colocation)");
+    }
+
+    status = clReleaseProgram(program);
+    CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.(colocation)");
+
+    return SDK_SUCCESS;
+}
+
+int
+DeviceFission::runColocation()
+{
+    cl_int status;
+
+    SDKFile kernelFile;
+    std::string kernelPath = getPath() + "DeviceFission_Kernels.cl";
+    if(!kernelFile.open(kernelPath.c_str()))
+    {
+        std::cout << "Failed to load kernel file: " << kernelPath << std::endl;
+        return SDK_FAILURE;
+    }
+
+    int retValue = colocation.create(rContext, cpuDevice);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "PartitionManager::create() failed");
+
+    if((cl_uint)tenants > colocation.maxSubDevices())
+    {
+        std::cout << "Error: More tenants than CL_DEVICE_PARTITION_MAX_SUB_DEVICES" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    tenantInput = (cl_int*)malloc(jobLength * sizeof(cl_int));
+    CHECK_ALLOCATION(tenantInput, "Failed to allocate host memory. (tenantInput)");
+    fillRandom<cl_int>(tenantInput, jobLength, 1, 0, 255);
+
+    tenantOutput = (cl_int*)malloc(jobLength * sizeof(cl_int));
+    CHECK_ALLOCATION(tenantOutput, "Failed to allocate host memory. (tenantOutput)");
+
+    // Every tenant has its own queue and buffers
+    for(cl_int t = 0; t < tenants; ++t)
+    {
+        if(colocation.addTenant(CL_QUEUE_PROFILING_ENABLE) < 0)
+        {
+            error("PartitionManager::addTenant() failed. (colocation)");
+            return SDK_FAILURE;
+        }
+
+        cl_mem in = clCreateBuffer(rContext,
+                                   CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                   jobLength * sizeof(cl_int),
+                                   tenantInput,
+                                   &status);
+        CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (tenantIn)");
+        tenantIn.push_back(in);
+
+        cl_mem out = clCreateBuffer(rContext,
+                                    CL_MEM_WRITE_ONLY,
+                                    jobLength * sizeof(cl_int),
+                                    NULL,
+                                    &status);
+        CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (tenantOut)");
+        tenantOut.push_back(out);
+    }
+
+    // Without fission every tenant queue runs on the whole device
+    if(runColocationPhase("shared", kernelFile.source()) != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
+    if(partitionColocation() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
+    if(runColocationPhase("fission", kernelFile.source()) != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
+    /*
+     * Resize between jobs: every tenant gets its own partition with
+     * compute units in proportion to its mean job latency under fission,
+     * so the slower tenant grows and the faster one shrinks
+     */
+    cl_uint rootUnits = colocation.rootComputeUnits();
+    if(!colocation.supports(CL_DEVICE_PARTITION_BY_COUNTS) || (cl_uint)tenants > rootUnits)
+    {
+        std::cout << "Partitions cannot be resized by counts, skipping the resized phase" << std::endl;
+        return SDK_SUCCESS;
+    }
+
+    const ColocationPhase& fission = phases.back();
+    std::vector<double> mean(tenants, 0.0);
+    double total = 0.0;
+    for(cl_int t = 0; t < tenants; ++t)
+    {
+        const std::vector<double>& latencies = fission.latencies[t];
+        for(size_t j = 0; j < latencies.size(); ++j)
+        {
+            mean[t] += latencies[j];
+        }
+        mean[t] /= std::max(latencies.size(), (size_t)1);
+        total += mean[t];
+    }
+
+    std::vector<cl_uint> counts(tenants);
+    cl_uint used = 0;
+    for(cl_int t = 0; t < tenants; ++t)
+    {
+        double share = (total > 0.0) ? mean[t] / total : 1.0 / tenants;
+        counts[t] = std::max((cl_uint)(rootUnits * share + 0.5), 1u);
+        used += counts[t];
+    }
+
+    // Rounding may hand out more units than there are
+    while(used > rootUnits)
+    {
+        cl_uint largest = (cl_uint)(std::max_element(counts.begin(), counts.end()) - counts.begin());
+        counts[largest]--;
+        used--;
+    }
+
+    if(colocation.partitionByCounts(counts) != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
+    return runColocationPhase("resized", kernelFile.source());
+}
+
+void
+DeviceFission::printColocationStats()
+{
+    std::cout << std::endl << "Co-located tenants, " << jobs
+              << " jobs each (latency from queued to end)" << std::endl;
+    std::cout << std::setw(10) << std::left << "Phase"
+              << std::setw(8) << "Tenant"
+              << std::setw(10) << "Workload" << std::right
+              << std::setw(7) << "Units"
+              << std::setw(11) << "Jobs/sec"
+              << std::setw(11) << "p50(ms)"
+              << std::setw(11) << "p95(ms)"
+              << std::setw(11) << "p99(ms)"
+              << std::setw(11) << "Max(ms)" << std::endl;
+
+    for(size_t p = 0; p < phases.size(); ++p)
+    {
+        const ColocationPhase& phase = phases[p];
+        std::vector<double> all;
+
+        // One row per tenant, then the phase as a whole
+        for(size_t t = 0; t <= phase.latencies.size(); ++t)
+        {
+            bool total = (t == phase.latencies.size());
+            std::vector<double> sorted = total ? all : phase.latencies[t];
+            std::sort(sorted.begin(), sorted.end());
+            if(!total)
+            {
+                all.insert(all.end(), sorted.begin(), sorted.end());
+            }
+
+            std::cout << std::setw(10) << std::left << phase.name
+                      << std::setw(8) << (total ? std::string("all") : toString(t, std::dec))
+                      << std::setw(10) << (total ? "" : (t % 2 == 0 ? "compute" : "stream"))
+                      << std::right;
+            if(total)
+            {
+                std::cout << std::setw(7) << "-";
+            }
+            else
+            {
+                std::cout << std::setw(7) << phase.units[t];
+            }
+            std::cout << std::fixed << std::setprecision(3)
+                      << std::setw(11) << (phase.seconds > 0.0 ? sorted.size() / phase.seconds : 0.0)
+                      << std::setw(11) << percentile(sorted, 0.50)
+                      << std::setw(11) << percentile(sorted, 0.95)
+                      << std::setw(11) << percentile(sorted, 0.99)
+                      << std::setw(11) << (sorted.empty() ? 0.0 : sorted.back()) << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+}
+
 int DeviceFission::initialize()
 {
     // Call base class Initialize to get default configuration
@@ -555,12 +1007,107 @@ int DeviceFission::initialize()
     sampleArgs->AddOption(array_length);
     delete array_length;
 
+    Option* colocation_option = new Option;
+    CHECK_ALLOCATION(colocation_option, "Memory allocation error.\n");
+
+    colocation_option->_sVersion = "";
+    colocation_option->_lVersion = "colocate";
+    colocation_option->_description =
+        "Benchmark co-located tenants sharing the device, on partitions and on resized partitions";
+    colocation_option->_type = CA_NO_ARGUMENT;
+    colocation_option->_value = &colocate;
+    sampleArgs->AddOption(colocation_option);
+
+    colocation_option->_sVersion = "";
+    colocation_option->_lVersion = "tenants";
+    colocation_option->_description = "Number of co-located tenants (Default value 2)";
+    colocation_option->_type = CA_ARG_INT;
+    colocation_option->_value = &tenants;
+    sampleArgs->AddOption(colocation_option);
+
+    colocation_option->_sVersion = "";
+    colocation_option->_lVersion = "jobs";
+    colocation_option->_description = "Jobs every tenant runs per phase (Default value 64)";
+    colocation_option->_type = CA_ARG_INT;
+    colocation_option->_value = &jobs;
+    sampleArgs->AddOption(colocation_option);
+
+    colocation_option->_sVersion = "";
+    colocation_option->_lVersion = "jobLength";
+    colocation_option->_description = "Elements a job processes, multiple of 4 (Default value 1048576)";
+    colocation_option->_type = CA_ARG_INT;
+    colocation_option->_value = &jobLength;
+    sampleArgs->AddOption(colocation_option);
+
+    colocation_option->_sVersion = "";
+    colocation_option->_lVersion = "rounds";
+    colocation_option->_description = "Hash rounds of the compute bound tenants (Default value 64)";
+    colocation_option->_type = CA_ARG_INT;
+    colocation_option->_value = &rounds;
+    sampleArgs->AddOption(colocation_option);
+
+    colocation_option->_sVersion = "";
+    colocation_option->_lVersion = "partition";
+    colocation_option->_description = "Partition of the tenants [equal|counts|affinity]";
+    colocation_option->_type = CA_ARG_STRING;
+    colocation_option->_value = &partitionMode;
+    sampleArgs->AddOption(colocation_option);
+
+    colocation_option->_sVersion = "";
+    colocation_option->_lVersion = "units";
+    colocation_option->_description = "Compute units per partition of --partition equal (Default one partition per tenant)";
+    colocation_option->_type = CA_ARG_INT;
+    colocation_option->_value = &unitsPerPartition;
+    sampleArgs->AddOption(colocation_option);
+
+    colocation_option->_sVersion = "";
+    colocation_option->_lVersion = "counts";
+    colocation_option->_description = "Comma separated compute units of --partition counts, e.g. 4,2,2";
+    colocation_option->_type = CA_ARG_STRING;
+    colocation_option->_value = &countsList;
+    sampleArgs->AddOption(colocation_option);
+
+    colocation_option->_sVersion = "";
+    colocation_option->_lVersion = "affinity";
+    colocation_option->_description = "Domain of --partition affinity [numa|l4|l3|l2|l1|next]";
+    colocation_option->_type = CA_ARG_STRING;
+    colocation_option->_value = &affinityName;
+    sampleArgs->AddOption(colocation_option);
+    delete colocation_option;
+
     return SDK_SUCCESS;
 }
 
 int
 DeviceFission::setup()
 {
+    if(colocate)
+    {
+        if(tenants < 1 || jobs < 1 || rounds < 0)
+        {
+            std::cout << "Tenants and jobs should be at least 1, rounds at least 0" << std::endl;
+            return SDK_FAILURE;
+        }
+
+        if(partitionMode != "equal" && partitionMode != "counts" && partitionMode != "affinity")
+        {
+            std::cout << "Unknown partition : " << partitionMode
+                      << " (expected equal, counts or affinity)" << std::endl;
+            return SDK_FAILURE;
+        }
+
+        if(affinityName != "numa" && affinityName != "l4" && affinityName != "l3" &&
+                affinityName != "l2" && affinityName != "l1" && affinityName != "next")
+        {
+            std::cout << "Unknown affinity domain : " << affinityName
+                      << " (expected numa, l4, l3, l2, l1 or next)" << std::endl;
+            return SDK_FAILURE;
+        }
+
+        // Stream reads int4
+        jobLength = std::max((jobLength / 4) * 4, 4u);
+    }
+
     cl_int retValue = setupCLPlatform();
     if(retValue != SDK_SUCCESS)
     {
@@ -596,6 +1143,11 @@ int DeviceFission::run()
                            half_length, 1);
     }
 
+    if(colocate && runColocation() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
     return SDK_SUCCESS;
 }
 
@@ -615,7 +1167,7 @@ int DeviceFission::verifyResults()
                 subDevicesRlt = CL_FALSE;
             }
         }
-        if(subDevicesRlt)
+        if(subDevicesRlt && colocationPassed)
         {
             std::cout << "Passed!\n" << std::endl;
             return SDK_SUCCESS;
@@ -647,12 +1199,6 @@ DeviceFission::cleanup()
 
     for(cl_uint i = 0; i < numSubDevices; ++i)
     {
-        status = clReleaseCommandQueue(subCmdQueue[i]);
-        CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed. (subCmdQueue)");
-
-        status = clReleaseDevice(subDevices[i]);
-        CHECK_OPENCL_ERROR(status, "clReleaseDevice failed. (subDevices)");
-
         status = clReleaseKernel(subKernel[i]);
         CHECK_OPENCL_ERROR(status, "clReleaseKernel failed. (subKernel)");
 
@@ -660,6 +1206,23 @@ DeviceFission::cleanup()
         CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (subOutBuf)");
 
     }
+
+    for(size_t t = 0; t < tenantIn.size(); ++t)
+    {
+        status = clReleaseMemObject(tenantIn[t]);
+        CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (tenantIn)");
+
+        status = clReleaseMemObject(tenantOut[t]);
+        CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (tenantOut)");
+    }
+    tenantIn.clear();
+    tenantOut.clear();
+
+    // Queues and sub-devices of both partitions
+    if(partitionManager.release() != SDK_SUCCESS || colocation.release() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
     for(cl_uint i = 0; i < deviceListSize / sizeof(cl_device_id) ; ++i)
     {
         status = clReleaseDevice(Devices[i]);
@@ -683,6 +1246,8 @@ DeviceFission::~DeviceFission()
     FREE(subKernel);
     FREE(subCmdQueue);
     FREE(subOutBuf);
+    FREE(tenantInput);
+    FREE(tenantOutput);
 }
 
 void
@@ -700,6 +1265,11 @@ DeviceFission::printStats()
 
         printStatistics(strArray, stats, 2);
     }
+
+    if(colocate)
+    {
+        printColocationStats();
+    }
 }
 int
 main(int argc, char * argv[])
@@ -24,8 +24,12 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <assert.h>
 #include <malloc.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 #include "CLUtil.hpp"
+#include "SDKThread.hpp"
+#include "PartitionManager.hpp"
 
 using namespace appsdk;
 
@@ -35,6 +39,11 @@ using namespace appsdk;
 #define DEFAULT_INPUT_SIZE 1024
 #define VALUES_PRINTED 20
 
+#define DEFAULT_TENANTS 2
+#define DEFAULT_JOBS 64
+#define DEFAULT_JOB_LENGTH (1 << 20)
+#define DEFAULT_ROUNDS 64
+
 // Init extension function pointers
 #define INIT_CL_EXT_FCN_PTR(name) \
     if(!pfn_##name) { \
@@ -45,6 +54,32 @@ using namespace appsdk;
         } \
     }
 
+/**
+ * TenantWork
+ * Jobs of one co-located tenant, run back to back by its own host thread
+ */
+struct TenantWork
+{
+    cl_command_queue queue;             /**< Tenant queue, with profiling */
+    cl_kernel kernel;                   /**< Compute or Stream */
+    size_t globalSize;                  /**< Work-items of a job */
+    cl_int jobs;                        /**< Jobs to run */
+    std::vector<double> latencies;      /**< Queued to end of every job (ms) */
+    cl_int status;                      /**< CL_SUCCESS unless a job failed */
+};
+
+/**
+ * ColocationPhase
+ * Latencies of all tenants under one placement
+ */
+struct ColocationPhase
+{
+    std::string name;                   /**< shared, fission or resized */
+    std::vector<cl_uint> units;         /**< Compute units of every tenant's device */
+    std::vector<std::vector<double> > latencies;
+    double seconds;                     /**< Wall time of the phase */
+};
+
 /**
  * DeviceFission
  * Class implements OpenCL  DeviceFission sample
@@ -76,6 +111,25 @@ class DeviceFission
 
         cl_kernel *subKernel;           /**< CL kernel for sub-devices */
 
+        PartitionManager partitionManager;  /**< Sub-devices and queues of Add and Sub */
+
+        bool colocate;                  /**< Run the co-located tenant benchmark */
+        cl_int tenants;                 /**< Number of co-located tenants */
+        cl_int jobs;                    /**< Jobs every tenant runs per phase */
+        cl_uint jobLength;              /**< Elements a job processes */
+        cl_int rounds;                  /**< Hash rounds of the compute bound tenants */
+        std::string partitionMode;      /**< equal, counts or affinity */
+        cl_int unitsPerPartition;       /**< Compute units per partition of 'equal' */
+        std::string countsList;         /**< Comma separated compute units of 'counts' */
+        std::string affinityName;       /**< numa, l4, l3, l2, l1 or next */
+        PartitionManager colocation;    /**< Sub-devices and queues of the tenants */
+        std::vector<cl_mem> tenantIn;   /**< Input buffer of every tenant */
+        std::vector<cl_mem> tenantOut;  /**< Output buffer of every tenant */
+        cl_int *tenantInput;            /**< Host input of the tenants */
+        cl_int *tenantOutput;           /**< Host output of the last job of a tenant */
+        std::vector<ColocationPhase> phases;
+        bool colocationPassed;          /**< Outputs of all phases verified */
+
         size_t kernelWorkGroupSize;     /**< Group size returned by kernel */
         size_t groupSize;               /**< Work-group size */
         SDKDeviceInfo deviceInfo;/**< Structure to store device information */
@@ -103,7 +157,18 @@ class DeviceFission
                numSubDevices(2),
                length(DEFAULT_INPUT_SIZE),
                groupSize(GROUP_SIZE),
-               deviceListSize(0)
+               deviceListSize(0),
+               colocate(false),
+               tenants(DEFAULT_TENANTS),
+               jobs(DEFAULT_JOBS),
+               jobLength(DEFAULT_JOB_LENGTH),
+               rounds(DEFAULT_ROUNDS),
+               partitionMode("equal"),
+               unitsPerPartition(0),
+               affinityName("next"),
+               tenantInput(NULL),
+               tenantOutput(NULL),
+               colocationPassed(true)
         {
             sampleArgs = new CLCommandArgs(true) ;
             sampleTimer = new SDKTimer();
@@ -154,6 +219,32 @@ class DeviceFission
          */
         int runCLKernels();
 
+        /**
+         * Runs the tenants sharing the root device, on the partitions
+         * selected by partitionMode and on partitions resized by counts to
+         * the tenants' measured latencies
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int runColocation();
+
+        /**
+         * Runs every tenant's jobs on its current queue, one host thread
+         * per tenant, and records the phase
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int runColocationPhase(const char* name, const std::string& source);
+
+        /**
+         * Partitions 'colocation' as selected by partitionMode
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int partitionColocation();
+
+        /**
+        * Prints throughput and latency percentiles of every tenant and phase
+        */
+        void printColocationStats();
+
         /**
         * Override from SDKSample. Print sample stats.
         */
@@ -32,3 +32,33 @@ Sub(__global int* input, __global int* output)
     size_t xPos = get_global_id(0);
     output[xPos] = input[xPos] - 1;
 }
+
+/*
+ * Compute bound tenant of the co-location benchmark,
+ * hashes every element 'rounds' times
+ */
+__kernel
+void 
+Compute(__global int* input, __global int* output, int rounds)
+{
+    size_t xPos = get_global_id(0);
+    uint x = (uint)input[xPos];
+    for(int i = 0; i < rounds; ++i)
+    {
+        x = x * 1664525u + 1013904223u;
+        x ^= x >> 16;
+    }
+    output[xPos] = (int)x;
+}
+
+/*
+ * Memory bound tenant of the co-location benchmark,
+ * streams the input to the output
+ */
+__kernel
+void 
+Stream(__global int4* input, __global int4* output)
+{
+    size_t xPos = get_global_id(0);
+    output[xPos] = input[xPos] + (int4)(1);
+}
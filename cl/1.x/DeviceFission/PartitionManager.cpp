@@ -0,0 +1,347 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+   Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "PartitionManager.hpp"
+
+PartitionManager::PartitionManager()
+    : context(NULL),
+      root(NULL),
+      rootUnits(0),
+      maxSubDeviceCount(0),
+      affinityDomains(0)
+{
+}
+
+PartitionManager::~PartitionManager()
+{
+    release();
+}
+
+int
+PartitionManager::create(cl_context ctx, cl_device_id rootDevice)
+{
+    cl_int status;
+    context = ctx;
+    root = rootDevice;
+
+    status = clGetDeviceInfo(root, CL_DEVICE_MAX_COMPUTE_UNITS,
+                             sizeof(rootUnits), &rootUnits, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo failed. (CL_DEVICE_MAX_COMPUTE_UNITS)");
+
+    status = clGetDeviceInfo(root, CL_DEVICE_PARTITION_MAX_SUB_DEVICES,
+                             sizeof(maxSubDeviceCount), &maxSubDeviceCount, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo failed. (CL_DEVICE_PARTITION_MAX_SUB_DEVICES)");
+
+    // Partition types the device supports, a 0 entry when there is none
+    size_t size = 0;
+    status = clGetDeviceInfo(root, CL_DEVICE_PARTITION_PROPERTIES, 0, NULL, &size);
+    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo failed. (CL_DEVICE_PARTITION_PROPERTIES)");
+
+    partitionTypes.resize(size / sizeof(cl_device_partition_property));
+    if(!partitionTypes.empty())
+    {
+        status = clGetDeviceInfo(root, CL_DEVICE_PARTITION_PROPERTIES, size,
+                                 &partitionTypes[0], NULL);
+        CHECK_OPENCL_ERROR(status, "clGetDeviceInfo failed. (CL_DEVICE_PARTITION_PROPERTIES)");
+    }
+
+    status = clGetDeviceInfo(root, CL_DEVICE_PARTITION_AFFINITY_DOMAIN,
+                             sizeof(affinityDomains), &affinityDomains, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo failed. (CL_DEVICE_PARTITION_AFFINITY_DOMAIN)");
+
+    return SDK_SUCCESS;
+}
+
+bool
+PartitionManager::supports(cl_device_partition_property type) const
+{
+    for(size_t i = 0; i < partitionTypes.size(); ++i)
+    {
+        if(partitionTypes[i] == type)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+PartitionManager::supportsAffinity(cl_device_affinity_domain domain) const
+{
+    return supports(CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN) &&
+           (affinityDomains & domain) != 0;
+}
+
+int
+PartitionManager::partitionEqually(cl_uint units)
+{
+    if(!supports(CL_DEVICE_PARTITION_EQUALLY))
+    {
+        std::cout << "Error: Device does not support CL_DEVICE_PARTITION_EQUALLY" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    cl_device_partition_property properties[3] =
+    {
+        CL_DEVICE_PARTITION_EQUALLY,
+        (cl_device_partition_property)units,
+        0
+    };
+    return partition(properties);
+}
+
+int
+PartitionManager::partitionByCounts(const std::vector<cl_uint>& counts)
+{
+    if(!supports(CL_DEVICE_PARTITION_BY_COUNTS))
+    {
+        std::cout << "Error: Device does not support CL_DEVICE_PARTITION_BY_COUNTS" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    std::vector<cl_device_partition_property> properties;
+    properties.push_back(CL_DEVICE_PARTITION_BY_COUNTS);
+    for(size_t i = 0; i < counts.size(); ++i)
+    {
+        properties.push_back((cl_device_partition_property)counts[i]);
+    }
+    properties.push_back(CL_DEVICE_PARTITION_BY_COUNTS_LIST_END);
+    properties.push_back(0);
+    return partition(&properties[0]);
+}
+
+int
+PartitionManager::partitionByAffinity(cl_device_affinity_domain domain)
+{
+    if(!supportsAffinity(domain))
+    {
+        std::cout << "Error: Device does not support this affinity domain" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    cl_device_partition_property properties[3] =
+    {
+        CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN,
+        (cl_device_partition_property)domain,
+        0
+    };
+    return partition(properties);
+}
+
+int
+PartitionManager::unpartition()
+{
+    if(releaseQueues() != SDK_SUCCESS || releasePartitions() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+    return createQueues();
+}
+
+int
+PartitionManager::partition(const cl_device_partition_property* properties)
+{
+    cl_int status;
+
+    // Queues of the old partitions have to drain before their devices go
+    if(releaseQueues() != SDK_SUCCESS || releasePartitions() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
+    // The number of sub-devices is only known to the runtime for affinity domains
+    cl_uint count = 0;
+    status = clCreateSubDevices(root, properties, 0, NULL, &count);
+    CHECK_OPENCL_ERROR(status, "clCreateSubDevices failed. (count)");
+
+    if(count == 0)
+    {
+        std::cout << "Error: Partition yields no sub-devices" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    partitions.resize(count);
+    status = clCreateSubDevices(root, properties, count, &partitions[0], NULL);
+    if(status != CL_SUCCESS)
+    {
+        partitions.clear();
+    }
+    CHECK_OPENCL_ERROR(status, "clCreateSubDevices failed.");
+
+    partitionUnits.resize(count);
+    for(cl_uint i = 0; i < count; ++i)
+    {
+        status = clGetDeviceInfo(partitions[i], CL_DEVICE_MAX_COMPUTE_UNITS,
+                                 sizeof(cl_uint), &partitionUnits[i], NULL);
+        CHECK_OPENCL_ERROR(status, "clGetDeviceInfo failed. (sub-device CL_DEVICE_MAX_COMPUTE_UNITS)");
+    }
+
+    // Tenants keep their slot, wrapped to the new number of partitions
+    for(size_t t = 0; t < tenants.size(); ++t)
+    {
+        tenants[t].partition = (cl_uint)(t % count);
+    }
+
+    return createQueues();
+}
+
+int
+PartitionManager::addTenant(cl_command_queue_properties properties)
+{
+    Tenant tenant;
+    tenant.queue = NULL;
+    tenant.properties = properties;
+    tenant.partition = partitions.empty() ? 0 : (cl_uint)(tenants.size() % partitions.size());
+
+    if(createQueue(tenant) != SDK_SUCCESS)
+    {
+        return -1;
+    }
+
+    tenants.push_back(tenant);
+    return (int)tenants.size() - 1;
+}
+
+int
+PartitionManager::assign(int tenant, cl_uint partition)
+{
+    cl_int status;
+    if(partition >= partitions.size())
+    {
+        std::cout << "Error: Partition " << partition << " does not exist" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    Tenant& t = tenants[tenant];
+    if(t.partition == partition && t.queue != NULL)
+    {
+        return SDK_SUCCESS;
+    }
+
+    status = clFinish(t.queue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed. (tenant queue)");
+
+    status = clReleaseCommandQueue(t.queue);
+    CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed. (tenant queue)");
+
+    t.queue = NULL;
+    t.partition = partition;
+    return createQueue(t);
+}
+
+cl_device_id
+PartitionManager::tenantDevice(int tenant) const
+{
+    return partitions.empty() ? root : partitions[tenants[tenant].partition];
+}
+
+const cl_device_id*
+PartitionManager::devices() const
+{
+    return partitions.empty() ? &root : &partitions[0];
+}
+
+cl_uint
+PartitionManager::numDevices() const
+{
+    return partitions.empty() ? 1 : (cl_uint)partitions.size();
+}
+
+int
+PartitionManager::finish()
+{
+    cl_int status;
+    for(size_t t = 0; t < tenants.size(); ++t)
+    {
+        if(tenants[t].queue)
+        {
+            status = clFinish(tenants[t].queue);
+            CHECK_OPENCL_ERROR(status, "clFinish failed. (tenant queue)");
+        }
+    }
+    return SDK_SUCCESS;
+}
+
+int
+PartitionManager::release()
+{
+    int status = releaseQueues();
+    tenants.clear();
+    if(releasePartitions() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+    return status;
+}
+
+int
+PartitionManager::createQueue(Tenant& tenant)
+{
+    cl_int status;
+    tenant.queue = clCreateCommandQueue(context,
+                                        partitions.empty() ? root : partitions[tenant.partition],
+                                        tenant.properties,
+                                        &status);
+    CHECK_OPENCL_ERROR(status, "clCreateCommandQueue failed. (tenant queue)");
+    return SDK_SUCCESS;
+}
+
+int
+PartitionManager::createQueues()
+{
+    for(size_t t = 0; t < tenants.size(); ++t)
+    {
+        if(createQueue(tenants[t]) != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+    }
+    return SDK_SUCCESS;
+}
+
+int
+PartitionManager::releaseQueues()
+{
+    cl_int status;
+    for(size_t t = 0; t < tenants.size(); ++t)
+    {
+        if(tenants[t].queue)
+        {
+            status = clFinish(tenants[t].queue);
+            CHECK_OPENCL_ERROR(status, "clFinish failed. (tenant queue)");
+
+            status = clReleaseCommandQueue(tenants[t].queue);
+            CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed. (tenant queue)");
+
+            tenants[t].queue = NULL;
+        }
+    }
+    return SDK_SUCCESS;
+}
+
+int
+PartitionManager::releasePartitions()
+{
+    cl_int status;
+    for(size_t i = 0; i < partitions.size(); ++i)
+    {
+        status = clReleaseDevice(partitions[i]);
+        CHECK_OPENCL_ERROR(status, "clReleaseDevice failed. (sub-device)");
+    }
+    partitions.clear();
+    partitionUnits.clear();
+    return SDK_SUCCESS;
+}
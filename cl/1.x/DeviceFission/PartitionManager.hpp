@@ -0,0 +1,147 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+   Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef PARTITION_MANAGER_H_
+#define PARTITION_MANAGER_H_
+
+#include <vector>
+#include "CLUtil.hpp"
+
+using namespace appsdk;
+
+/**
+ * PartitionManager
+ * Splits a root device into sub-devices and gives every tenant a command
+ * queue on one of them, so that tenants sharing a many-core CPU do not
+ * compete for the same compute units. Without a partition all tenants
+ * share the root device, which is the baseline fission is measured
+ * against.
+ *
+ * Partitioning again (equally, by counts or by affinity domain) finishes
+ * every tenant queue, releases the old sub-devices and recreates the
+ * tenant queues on the new ones; queue() handles taken before are then
+ * no longer valid.
+ */
+class PartitionManager
+{
+    public:
+        PartitionManager();
+        ~PartitionManager();
+
+        /**
+         * Queries the partitioning capabilities of 'root' in 'context'
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int create(cl_context context, cl_device_id root);
+
+        /**
+         * Sub-devices of 'units' compute units each, as many as fit
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int partitionEqually(cl_uint units);
+
+        /**
+         * One sub-device per entry of 'counts' with that many compute units
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int partitionByCounts(const std::vector<cl_uint>& counts);
+
+        /**
+         * One sub-device per NUMA node or cache of the given level, or
+         * per the next partitionable domain for
+         * CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int partitionByAffinity(cl_device_affinity_domain domain);
+
+        /**
+         * Releases the sub-devices, tenants share the root device again
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int unpartition();
+
+        /**
+         * Adds a tenant with its own queue, placed on partition
+         * (tenant % numPartitions()) until assign() moves it
+         * @return the tenant or -1 on failure
+         */
+        int addTenant(cl_command_queue_properties properties);
+
+        /**
+         * Moves 'tenant' to 'partition', finishing its queue first
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int assign(int tenant, cl_uint partition);
+
+        /**
+         * Finishes all tenant queues
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int finish();
+
+        /**
+         * Releases the tenant queues and the sub-devices
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int release();
+
+        bool supports(cl_device_partition_property type) const;
+        bool supportsAffinity(cl_device_affinity_domain domain) const;
+
+        cl_uint maxSubDevices() const { return maxSubDeviceCount; }
+        cl_uint rootComputeUnits() const { return rootUnits; }
+
+        // 0 while tenants share the root device
+        cl_uint numPartitions() const { return (cl_uint)partitions.size(); }
+        cl_device_id device(cl_uint partition) const { return partitions[partition]; }
+        cl_uint computeUnits(cl_uint partition) const { return partitionUnits[partition]; }
+
+        // Devices a program has to be built for: the partitions, or the root device
+        const cl_device_id* devices() const;
+        cl_uint numDevices() const;
+
+        int numTenants() const { return (int)tenants.size(); }
+        cl_command_queue queue(int tenant) const { return tenants[tenant].queue; }
+        cl_uint tenantPartition(int tenant) const { return tenants[tenant].partition; }
+        cl_device_id tenantDevice(int tenant) const;
+
+    private:
+        struct Tenant
+        {
+            cl_command_queue queue;
+            cl_command_queue_properties properties;
+            cl_uint partition;
+        };
+
+        int partition(const cl_device_partition_property* properties);
+        int releasePartitions();
+        int createQueue(Tenant& tenant);
+        int releaseQueues();
+        int createQueues();
+
+        cl_context context;
+        cl_device_id root;
+        cl_uint rootUnits;                      /**< Compute units of the root device */
+        cl_uint maxSubDeviceCount;              /**< CL_DEVICE_PARTITION_MAX_SUB_DEVICES */
+        cl_device_affinity_domain affinityDomains;
+        std::vector<cl_device_partition_property> partitionTypes;
+
+        std::vector<cl_device_id> partitions;   /**< Sub-devices of the current partition */
+        std::vector<cl_uint> partitionUnits;    /**< Compute units of every sub-device */
+        std::vector<Tenant> tenants;
+};
+
+#endif // PARTITION_MANAGER_H_
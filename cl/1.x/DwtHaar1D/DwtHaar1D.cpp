@@ -17,97 +17,288 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #include "DwtHaar1D.hpp"
 #include <math.h>
+#include <algorithm>
+#include <xmmintrin.h>
 
-int
-DwtHaar1D::calApproxFinalOnHost()
+/**
+ * Lifting schemes of the supported wavelets
+ */
+static const LiftingScheme liftingSchemes[] =
 {
-    // Copy inData to hOutData
-    cl_float *tempOutData = (cl_float*)malloc(signalLength * sizeof(cl_float));
-    CHECK_ALLOCATION(tempOutData, "Failed to allocate host memory. (tempOutData)");
+    {
+        "haar", 2,
+        {
+            {LIFT_PREDICT, -1.0f, 0.0f, 0.0f},
+            {LIFT_UPDATE, 0.5f, 0.0f, 0.0f}
+        },
+        1.41421356f, -0.70710678f
+    },
+    {
+        "d4", 3,
+        {
+            {LIFT_UPDATE, 1.73205081f, 0.0f, 0.0f},
+            {LIFT_PREDICT, -0.43301270f, 0.06698730f, -1.0f},
+            {LIFT_UPDATE, 0.0f, -1.0f, 1.0f}
+        },
+        0.51763809f, 1.93185165f
+    },
+    {
+        "cdf97", 4,
+        {
+            {LIFT_PREDICT, -1.58613434f, -1.58613434f, 1.0f},
+            {LIFT_UPDATE, -0.05298012f, -0.05298012f, -1.0f},
+            {LIFT_PREDICT, 0.88291108f, 0.88291108f, 1.0f},
+            {LIFT_UPDATE, 0.44350685f, 0.44350685f, -1.0f}
+        },
+        1.14960440f, 0.86986445f
+    }
+};
+
+/**
+ * dst[i] += a * src[i] + b * src[i + offset] for every i < dstLen, taking
+ * samples outside src from the nearest end of src
+ */
+static void
+liftStepHost(cl_float *dst, int dstLen, const cl_float *src, int srcLen,
+             cl_float a, cl_float b, int offset)
+{
+    int lo = std::min(dstLen, offset < 0 ? -offset : 0);
+    int hi = std::min(dstLen, srcLen - (offset > 0 ? offset : 0));
+    int i = 0;
 
-    memcpy(tempOutData, inData, signalLength * sizeof(cl_float));
+    for(; i < lo; ++i)
+    {
+        dst[i] += a * src[std::min(i, srcLen - 1)]
+                  + b * src[std::max(0, std::min(i + offset, srcLen - 1))];
+    }
 
-    for(cl_uint i = 0; i < signalLength; ++i)
+    __m128 va = _mm_set1_ps(a);
+    __m128 vb = _mm_set1_ps(b);
+    for(; i + 4 <= hi; i += 4)
     {
-        tempOutData[i] = tempOutData[i] / sqrt((float)signalLength);
+        __m128 v = _mm_add_ps(_mm_mul_ps(va, _mm_loadu_ps(src + i)),
+                              _mm_mul_ps(vb, _mm_loadu_ps(src + i + offset)));
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), v));
     }
 
-    cl_uint length = signalLength;
-    while(length > 1u)
+    for(; i < dstLen; ++i)
     {
-        for(cl_uint i = 0; i < length / 2; ++i)
-        {
-            cl_float data0 = tempOutData[2 * i];
-            cl_float data1 = tempOutData[2 * i + 1];
+        dst[i] += a * src[std::min(i, srcLen - 1)]
+                  + b * src[std::max(0, std::min(i + offset, srcLen - 1))];
+    }
+}
 
-            hOutData[i] = (data0 + data1) / sqrt((float)2);
-            hOutData[length / 2 + i] = (data0 - data1) / sqrt((float)2);
+/**
+ * dst[i] *= k for every i < len
+ */
+static void
+scaleHost(cl_float *dst, int len, cl_float k)
+{
+    __m128 vk = _mm_set1_ps(k);
+    int i = 0;
+    for(; i + 4 <= len; i += 4)
+    {
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), vk));
+    }
+    for(; i < len; ++i)
+    {
+        dst[i] *= k;
+    }
+}
+
+void
+DwtHaar1D::liftLineHost(const cl_float *x, cl_uint n, cl_float *s, cl_float *d)
+{
+    if(n < 2)
+    {
+        s[0] = x[0];
+        return;
+    }
+
+    int ns = (int)(n + 1) / 2;
+    int nd = (int)n / 2;
+
+    // Split even and odd samples, 8 at a time
+    int i = 0;
+    for(; i + 4 <= nd; i += 4)
+    {
+        __m128 lo = _mm_loadu_ps(x + 2 * i);
+        __m128 hi = _mm_loadu_ps(x + 2 * i + 4);
+        _mm_storeu_ps(s + i, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(d + i, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    for(; i < ns; ++i)
+    {
+        s[i] = x[2 * i];
+        if(i < nd)
+        {
+            d[i] = x[2 * i + 1];
         }
-        // Copy inData to hOutData
-        memcpy(tempOutData, hOutData, signalLength * sizeof(cl_float));
+    }
 
-        length >>= 1;
+    for(cl_uint k = 0; k < scheme->numSteps; ++k)
+    {
+        const cl_float *step = scheme->steps[k];
+        if((int)step[0] == LIFT_PREDICT)
+        {
+            liftStepHost(d, nd, s, ns, step[1], step[2], (int)step[3]);
+        }
+        else
+        {
+            liftStepHost(s, ns, d, nd, step[1], step[2], (int)step[3]);
+        }
     }
 
-    FREE(tempOutData);
-    return SDK_SUCCESS;
+    scaleHost(s, ns, scheme->scaleS);
+    scaleHost(d, nd, scheme->scaleD);
 }
 
 int
-DwtHaar1D::getLevels(unsigned int length, unsigned int* levels)
+DwtHaar1D::calApproxFinalOnHost()
 {
-    cl_int returnVal = SDK_FAILURE;
+    cl_uint imageSize = signalLength * signalHeight;
+    cl_uint maxLength = std::max(signalLength, signalHeight);
+
+    memcpy(hOutData, inData, imageSize * numSignals * sizeof(cl_float));
 
-    for(unsigned int i = 0; i < 24; ++i)
+    cl_float *lineData = (cl_float*)malloc(maxLength * sizeof(cl_float));
+    CHECK_ALLOCATION(lineData, "Failed to allocate host memory. (lineData)");
+    cl_float *sData = (cl_float*)malloc(maxLength * sizeof(cl_float));
+    CHECK_ALLOCATION(sData, "Failed to allocate host memory. (sData)");
+    cl_float *dData = (cl_float*)malloc(maxLength * sizeof(cl_float));
+    CHECK_ALLOCATION(dData, "Failed to allocate host memory. (dData)");
+
+    for(cl_uint b = 0; b < numSignals; ++b)
     {
-        if(length == (1 << i))
+        cl_float *image = hOutData + b * imageSize;
+
+        for(cl_uint level = 0; level < totalLevels; ++level)
         {
-            *levels = i;
-            returnVal = SDK_SUCCESS;
-            break;
+            cl_uint w = widths[level];
+            cl_uint h = heights[level];
+
+            // Rows
+            for(cl_uint y = 0; y < h; ++y)
+            {
+                cl_float *row = image + y * signalLength;
+                memcpy(lineData, row, w * sizeof(cl_float));
+                liftLineHost(lineData, w, row, row + (w + 1) / 2);
+            }
+
+            if(signalHeight == 1)
+            {
+                continue;
+            }
+
+            // Columns
+            for(cl_uint x = 0; x < w; ++x)
+            {
+                for(cl_uint y = 0; y < h; ++y)
+                {
+                    lineData[y] = image[y * signalLength + x];
+                }
+                liftLineHost(lineData, h, sData, dData);
+
+                cl_uint hs = (h + 1) / 2;
+                for(cl_uint y = 0; y < hs; ++y)
+                {
+                    image[y * signalLength + x] = sData[y];
+                }
+                for(cl_uint y = hs; y < h; ++y)
+                {
+                    image[y * signalLength + x] = dData[y - hs];
+                }
+            }
         }
     }
 
-    return returnVal;
+    FREE(lineData);
+    FREE(sData);
+    FREE(dData);
+    return SDK_SUCCESS;
+}
+
+cl_uint
+DwtHaar1D::getLevels(cl_uint length)
+{
+    cl_uint levels = 0;
+    while(length > 1)
+    {
+        length = (length + 1) / 2;
+        ++levels;
+    }
+    return levels;
 }
 
 int DwtHaar1D::setupDwtHaar1D()
 {
-    // signal length must be power of 2
-    signalLength = roundToPowerOf2<cl_uint>(signalLength);
+    if(signalLength < 1 || signalHeight < 1 || numSignals < 1)
+    {
+        std::cout << "Error: signalLength, signalHeight and numSignals must be "
+                  "greater than 0" << std::endl;
+        return SDK_FAILURE;
+    }
 
-    unsigned int levels = 0;
-    int result = getLevels(signalLength, &levels);
-    CHECK_ERROR(result,SDK_SUCCESS, "signalLength > 2 ^ 23 not supported");
+    scheme = NULL;
+    for(size_t i = 0; i < sizeof(liftingSchemes) / sizeof(liftingSchemes[0]); ++i)
+    {
+        if(waveletName == liftingSchemes[i].name)
+        {
+            scheme = &liftingSchemes[i];
+        }
+    }
+    if(scheme == NULL)
+    {
+        std::cout << "Error: unknown wavelet " << waveletName
+                  << " (expected haar, d4 or cdf97)" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    // Levels until a single approximation coefficient is left
+    totalLevels = getLevels(std::max(signalLength, signalHeight));
+    if(numLevels != 0 && numLevels < totalLevels)
+    {
+        totalLevels = numLevels;
+    }
+
+    widths.assign(1, signalLength);
+    heights.assign(1, signalHeight);
+    for(cl_uint i = 0; i < totalLevels; ++i)
+    {
+        widths.push_back((widths[i] + 1) / 2);
+        heights.push_back((heights[i] + 1) / 2);
+    }
+
+    cl_uint total = signalLength * signalHeight * numSignals;
 
     // Allocate and init memory used by host
-    inData = (cl_float*)malloc(signalLength * sizeof(cl_float));
+    inData = (cl_float*)malloc(total * sizeof(cl_float));
     CHECK_ALLOCATION(inData, "Failed to allocate host memory. (inData)");
 
-    for(unsigned int i = 0; i < signalLength; i++)
+    for(unsigned int i = 0; i < total; i++)
     {
         inData[i] = (cl_float)(rand() % 10);
     }
 
-    dOutData = (cl_float*) malloc(signalLength * sizeof(cl_float));
+    dOutData = (cl_float*) malloc(total * sizeof(cl_float));
     CHECK_ALLOCATION(dOutData, "Failed to allocate host memory. (dOutData)");
 
-    memset(dOutData, 0, signalLength * sizeof(cl_float));
+    memset(dOutData, 0, total * sizeof(cl_float));
 
-    dPartialOutData = (cl_float*) malloc(signalLength * sizeof(cl_float));
-    CHECK_ALLOCATION(dPartialOutData,
-                     "Failed to allocate host memory.(dPartialOutData)");
+    dReconData = (cl_float*) malloc(total * sizeof(cl_float));
+    CHECK_ALLOCATION(dReconData,
+                     "Failed to allocate host memory.(dReconData)");
 
-    memset(dPartialOutData, 0, signalLength * sizeof(cl_float));
+    memset(dReconData, 0, total * sizeof(cl_float));
 
-    hOutData = (cl_float*)malloc(signalLength * sizeof(cl_float));
+    hOutData = (cl_float*)malloc(total * sizeof(cl_float));
     CHECK_ALLOCATION(hOutData, "Failed to allocate host memory. (hOutData)");
 
-    memset(hOutData, 0, signalLength * sizeof(cl_float));
+    memset(hOutData, 0, total * sizeof(cl_float));
 
     if(!sampleArgs->quiet)
     {
-        printArray<cl_float>("Input Signal", inData, 256, 1);
+        printArray<cl_float>("Input Signal", inData, std::min(total, 256u), 1);
     }
 
     return SDK_SUCCESS;
@@ -207,26 +398,45 @@ DwtHaar1D::setupCL(void)
         inMemFlags |= CL_MEM_USE_PERSISTENT_MEM_AMD;
     }
 
+    size_t bufSize = signalLength * signalHeight * numSignals * sizeof(cl_float);
+
     inDataBuf = clCreateBuffer(context,
                                inMemFlags,
-                               sizeof(cl_float) * signalLength,
+                               bufSize,
                                NULL,
                                &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (inDataBuf)");
 
     dOutDataBuf = clCreateBuffer(context,
-                                 CL_MEM_WRITE_ONLY,
-                                 signalLength * sizeof(cl_float),
+                                 CL_MEM_READ_WRITE,
+                                 bufSize,
                                  NULL,
                                  &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (dOutDataBuf)");
 
-    dPartialOutDataBuf = clCreateBuffer(context,
-                                        CL_MEM_WRITE_ONLY,
-                                        signalLength * sizeof(cl_float),
-                                        NULL,
-                                        &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (dPartialOutDataBuf)");
+    for(int i = 0; i < 2; ++i)
+    {
+        tempBuf[i] = clCreateBuffer(context,
+                                    CL_MEM_READ_WRITE,
+                                    bufSize,
+                                    NULL,
+                                    &status);
+        CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (tempBuf)");
+    }
+
+    dReconDataBuf = clCreateBuffer(context,
+                                   CL_MEM_READ_WRITE,
+                                   bufSize,
+                                   NULL,
+                                   &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (dReconDataBuf)");
+
+    stepsBuf = clCreateBuffer(context,
+                              CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                              sizeof(scheme->steps),
+                              (void*)scheme->steps,
+                              &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (stepsBuf)");
 
     // create a CL program using the kernel source
     buildProgramData buildData;
@@ -248,32 +458,50 @@ DwtHaar1D::setupCL(void)
     CHECK_ERROR(retValue, 0, "buildOpenCLProgram() failed");
 
     // get a kernel object handle for a kernel with the given name
-    kernel = clCreateKernel(program, "dwtHaar1D", &status);
-    CHECK_OPENCL_ERROR(status, "clCreateKernel failed.");
+    kernel = clCreateKernel(program, "dwtLiftLevel", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (dwtLiftLevel)");
 
-    status = kernelInfo.setKernelWorkGroupInfo(kernel,
-             devices[sampleArgs->deviceId]);
-    CHECK_ERROR(status, SDK_SUCCESS, " setKernelWorkGroupInfo() failed");
+    localKernel = clCreateKernel(program, "dwtLiftLocal", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (dwtLiftLocal)");
 
-    return SDK_SUCCESS;
+    inverseKernel = clCreateKernel(program, "idwtLiftLevel", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (idwtLiftLevel)");
+
+    return setWorkGroupSize();
 }
 
 int DwtHaar1D::setWorkGroupSize()
 {
     cl_int status = 0;
+    cl_kernel kernels[3] = {kernel, localKernel, inverseKernel};
+
+    localThreads = GROUP_SIZE;
+    for(int i = 0; i < 3; ++i)
+    {
+        status = kernelInfo.setKernelWorkGroupInfo(kernels[i],
+                 devices[sampleArgs->deviceId]);
+        CHECK_ERROR(status, SDK_SUCCESS, " setKernelWorkGroupInfo() failed");
+
+        if(localThreads > kernelInfo.kernelWorkGroupSize)
+        {
+            localThreads = kernelInfo.kernelWorkGroupSize;
+        }
+    }
 
-    globalThreads = curSignalLength >> 1;
-    localThreads = groupSize;
+    if(localThreads > deviceInfo.maxWorkItemSizes[0])
+    {
+        localThreads = deviceInfo.maxWorkItemSizes[0];
+    }
 
-    if(localThreads > deviceInfo.maxWorkItemSizes[0] ||
-            localThreads > deviceInfo.maxWorkGroupSize)
+    if(localThreads < 2)
     {
         std::cout << "Unsupported: Device does not support"
                   "requested number of work items.";
         return SDK_FAILURE;
     }
 
-    if(kernelInfo.localMemoryUsed > deviceInfo.localMemSize)
+    // dwtLiftLocal keeps 4 samples per work-item in local memory
+    if(4 * localThreads * sizeof(cl_float) > deviceInfo.localMemSize)
     {
         std::cout << "Unsupported: Insufficient local memory on device." <<
                   std::endl;
@@ -281,103 +509,285 @@ int DwtHaar1D::setWorkGroupSize()
     }
     return SDK_SUCCESS;
 }
-int DwtHaar1D::runDwtHaar1DKernel()
+
+int
+DwtHaar1D::enqueueLevel(cl_kernel kern, cl_mem buf0, cl_mem buf1, cl_mem buf2,
+                        cl_uint n, cl_uint numLines, cl_uint4 layout)
 {
     cl_int status;
+    cl_mem bufs[3] = {buf0, buf1, buf2};
 
-    status = this->setWorkGroupSize();
-    CHECK_ERROR(status, SDK_SUCCESS, "setWorkGroupSize failed");
+    for(cl_uint i = 0; i < 3; ++i)
+    {
+        status = clSetKernelArg(kern, i, sizeof(cl_mem), (void*)&bufs[i]);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (buffers)");
+    }
 
-    // Force write to inData Buf to update its values
-    cl_event writeEvt;
-    status = clEnqueueWriteBuffer(
+    // Tiles with HALO = 2 samples on each side, for each channel
+    status = clSetKernelArg(kern, 3, (localThreads + 4) * sizeof(cl_float), NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (sTile)");
+
+    status = clSetKernelArg(kern, 4, (localThreads + 4) * sizeof(cl_float), NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (dTile)");
+
+    status = clSetKernelArg(kern, 5, sizeof(cl_mem), (void*)&stepsBuf);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (stepsBuf)");
+
+    status = clSetKernelArg(kern, 6, sizeof(cl_uint), (void*)&scheme->numSteps);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (numSteps)");
+
+    cl_float2 scale;
+    scale.s[0] = scheme->scaleS;
+    scale.s[1] = scheme->scaleD;
+    status = clSetKernelArg(kern, 7, sizeof(cl_float2), (void*)&scale);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (scale)");
+
+    status = clSetKernelArg(kern, 8, sizeof(cl_uint), (void*)&n);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (n)");
+
+    status = clSetKernelArg(kern, 9, sizeof(cl_uint4), (void*)&layout);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (layout)");
+
+    size_t numGroups = ((n + 1) / 2 + localThreads - 1) / localThreads;
+    size_t globalThreads[2] = {numGroups * localThreads, numLines};
+    size_t localSize[2] = {localThreads, 1};
+
+    status = clEnqueueNDRangeKernel(
                  commandQueue,
-                 inDataBuf,
-                 CL_FALSE,
-                 0,
-                 curSignalLength * sizeof(cl_float),
-                 inData,
+                 kern,
+                 2,
+                 NULL,
+                 globalThreads,
+                 localSize,
                  0,
                  NULL,
-                 &writeEvt);
-    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (inDataBuf)");
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
 
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.");
+    return SDK_SUCCESS;
+}
 
-    status = waitForEventAndRelease(&writeEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(writeEvt1) Failed");
-
-    // Whether sort is to be in increasing order. CL_TRUE implies increasing
-    status = clSetKernelArg(kernel,
-                            0,
-                            sizeof(cl_mem),
-                            (void*)&inDataBuf);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (inDataBuf)");
-
-    status = clSetKernelArg(kernel,
-                            1,
-                            sizeof(cl_mem),
-                            (void*)&dOutDataBuf);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (dOutDataBuf)");
-
-    status = clSetKernelArg(kernel,
-                            2,
-                            sizeof(cl_mem),
-                            (void*)&dPartialOutDataBuf);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (dPartialOutData)");
-
-    status = clSetKernelArg(kernel,
-                            3,
-                            (localThreads * 2 * sizeof(cl_float)),
-                            NULL);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (local memory)");
-
-    status = clSetKernelArg(kernel,
-                            4,
-                            sizeof(cl_uint),
-                            (void*)&totalLevels);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (totalLevels)");
-
-    status = clSetKernelArg(kernel,
-                            5,
-                            sizeof(cl_uint),
-                            (void*)&curSignalLength);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (curSignalLength)");
-
-    status = clSetKernelArg(kernel,
-                            6,
-                            sizeof(cl_uint),
-                            (void*)&levelsDone);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (levelsDone)");
-
-    status = clSetKernelArg(kernel,
-                            7,
-                            sizeof(cl_uint),
-                            (void*)&maxLevelsOnDevice);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (levelsDone)");
+/**
+ * Layout of the rows of a batch of images (see elementOffset in the kernels)
+ */
+static cl_uint4
+rowLayout(cl_uint rows, cl_uint width, cl_uint height)
+{
+    cl_uint4 layout;
+    layout.s[0] = rows;
+    layout.s[1] = width * height;
+    layout.s[2] = width;
+    layout.s[3] = 1;
+    return layout;
+}
+
+/**
+ * Layout of the columns of a batch of images
+ */
+static cl_uint4
+columnLayout(cl_uint columns, cl_uint width, cl_uint height)
+{
+    cl_uint4 layout;
+    layout.s[0] = columns;
+    layout.s[1] = width * height;
+    layout.s[2] = 1;
+    layout.s[3] = width;
+    return layout;
+}
+
+int
+DwtHaar1D::runForwardKernels()
+{
+    cl_int status;
+    size_t bufSize = signalLength * signalHeight * numSignals * sizeof(cl_float);
+
+    if(totalLevels == 0)
+    {
+        status = clEnqueueCopyBuffer(commandQueue, inDataBuf, dOutDataBuf, 0, 0,
+                                     bufSize, 0, NULL, NULL);
+        CHECK_OPENCL_ERROR(status, "clEnqueueCopyBuffer failed.");
+        return SDK_SUCCESS;
+    }
+
+    if(signalHeight > 1)
+    {
+        // Separable 2-D: rows into tempBuf[0], then columns into dOutDataBuf
+        for(cl_uint level = 0; level < totalLevels; ++level)
+        {
+            cl_uint w = widths[level];
+            cl_uint h = heights[level];
+            cl_mem src = (level == 0) ? inDataBuf : dOutDataBuf;
+
+            status = enqueueLevel(kernel, src, tempBuf[0], tempBuf[0], w,
+                                  h * numSignals,
+                                  rowLayout(h, signalLength, signalHeight));
+            CHECK_ERROR(status, SDK_SUCCESS, "enqueueLevel failed. (rows)");
+
+            status = enqueueLevel(kernel, tempBuf[0], dOutDataBuf, dOutDataBuf, h,
+                                  w * numSignals,
+                                  columnLayout(w, signalLength, signalHeight));
+            CHECK_ERROR(status, SDK_SUCCESS, "enqueueLevel failed. (columns)");
+        }
+        return SDK_SUCCESS;
+    }
 
     /*
-    * Enqueue a kernel run call.
-    */
-    cl_event ndrEvt;
+     * 1-D: levels longer than a work-group can hold are computed one launch
+     * per level, approximations ping-ponging between the temporary buffers,
+     * the remaining levels in a single dwtLiftLocal launch
+     */
+    cl_uint4 layout = rowLayout(numSignals, signalLength, 1);
+    cl_mem src = inDataBuf;
+    cl_uint level = 0;
+    while(level < totalLevels && widths[level] > 2 * localThreads)
+    {
+        cl_mem sDst = (level + 1 == totalLevels) ? dOutDataBuf : tempBuf[level & 1];
+        status = enqueueLevel(kernel, src, sDst, dOutDataBuf, widths[level],
+                              numSignals, layout);
+        CHECK_ERROR(status, SDK_SUCCESS, "enqueueLevel failed.");
+
+        src = sDst;
+        ++level;
+    }
+
+    if(level == totalLevels)
+    {
+        return SDK_SUCCESS;
+    }
+
+    cl_uint n = widths[level];
+    cl_uint levels = totalLevels - level;
+    cl_mem bufs[3] = {src, dOutDataBuf, dOutDataBuf};
+
+    for(cl_uint i = 0; i < 3; ++i)
+    {
+        status = clSetKernelArg(localKernel, i, sizeof(cl_mem), (void*)&bufs[i]);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (buffers)");
+    }
+
+    status = clSetKernelArg(localKernel, 3, 2 * localThreads * sizeof(cl_float),
+                            NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (xLocal)");
+
+    status = clSetKernelArg(localKernel, 4, localThreads * sizeof(cl_float), NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (sLocal)");
+
+    status = clSetKernelArg(localKernel, 5, localThreads * sizeof(cl_float), NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (dLocal)");
+
+    status = clSetKernelArg(localKernel, 6, sizeof(cl_mem), (void*)&stepsBuf);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (stepsBuf)");
+
+    status = clSetKernelArg(localKernel, 7, sizeof(cl_uint),
+                            (void*)&scheme->numSteps);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (numSteps)");
+
+    cl_float2 scale;
+    scale.s[0] = scheme->scaleS;
+    scale.s[1] = scheme->scaleD;
+    status = clSetKernelArg(localKernel, 8, sizeof(cl_float2), (void*)&scale);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (scale)");
+
+    status = clSetKernelArg(localKernel, 9, sizeof(cl_uint), (void*)&n);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (n)");
+
+    status = clSetKernelArg(localKernel, 10, sizeof(cl_uint), (void*)&levels);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (levels)");
+
+    status = clSetKernelArg(localKernel, 11, sizeof(cl_uint4), (void*)&layout);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (layout)");
+
+    size_t globalThreads[2] = {localThreads, numSignals};
+    size_t localSize[2] = {localThreads, 1};
+
     status = clEnqueueNDRangeKernel(
                  commandQueue,
-                 kernel,
-                 1,
+                 localKernel,
+                 2,
                  NULL,
-                 &globalThreads,
-                 &localThreads,
+                 globalThreads,
+                 localSize,
                  0,
                  NULL,
-                 &ndrEvt);
-    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. (dwtLiftLocal)");
 
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.");
+    return SDK_SUCCESS;
+}
+
+int
+DwtHaar1D::runInverseKernels()
+{
+    cl_int status;
+    size_t bufSize = signalLength * signalHeight * numSignals * sizeof(cl_float);
+
+    if(totalLevels == 0 || signalHeight > 1)
+    {
+        status = clEnqueueCopyBuffer(commandQueue, dOutDataBuf, dReconDataBuf, 0, 0,
+                                     bufSize, 0, NULL, NULL);
+        CHECK_OPENCL_ERROR(status, "clEnqueueCopyBuffer failed.");
+    }
+
+    if(signalHeight > 1)
+    {
+        // Coarsest level first: columns into tempBuf[0], rows back in place
+        for(cl_uint level = totalLevels; level > 0; --level)
+        {
+            cl_uint w = widths[level - 1];
+            cl_uint h = heights[level - 1];
+
+            status = enqueueLevel(inverseKernel, dReconDataBuf, dReconDataBuf,
+                                  tempBuf[0], h, w * numSignals,
+                                  columnLayout(w, signalLength, signalHeight));
+            CHECK_ERROR(status, SDK_SUCCESS, "enqueueLevel failed. (columns)");
+
+            status = enqueueLevel(inverseKernel, tempBuf[0], tempBuf[0],
+                                  dReconDataBuf, w, h * numSignals,
+                                  rowLayout(h, signalLength, signalHeight));
+            CHECK_ERROR(status, SDK_SUCCESS, "enqueueLevel failed. (rows)");
+        }
+        return SDK_SUCCESS;
+    }
+
+    cl_uint4 layout = rowLayout(numSignals, signalLength, 1);
+    for(cl_uint level = totalLevels; level > 0; --level)
+    {
+        cl_uint l = level - 1;
+        cl_mem sSrc = (level == totalLevels) ? dOutDataBuf : tempBuf[level & 1];
+        cl_mem dst = (l == 0) ? dReconDataBuf : tempBuf[l & 1];
+
+        status = enqueueLevel(inverseKernel, sSrc, dOutDataBuf, dst, widths[l],
+                              numSignals, layout);
+        CHECK_ERROR(status, SDK_SUCCESS, "enqueueLevel failed.");
+    }
+
+    return SDK_SUCCESS;
+}
+
+int
+DwtHaar1D::runCLKernels(void)
+{
+    cl_int status;
+    size_t bufSize = signalLength * signalHeight * numSignals * sizeof(cl_float);
+
+    status = clEnqueueWriteBuffer(
+                 commandQueue,
+                 inDataBuf,
+                 CL_FALSE,
+                 0,
+                 bufSize,
+                 inData,
+                 0,
+                 NULL,
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (inDataBuf)");
+
+    // All levels are enqueued back to back, nothing returns to the host
+    status = runForwardKernels();
+    CHECK_ERROR(status, SDK_SUCCESS, "runForwardKernels() failed");
 
-    status = waitForEventAndRelease(&ndrEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt1) Failed");
+    status = runInverseKernels();
+    CHECK_ERROR(status, SDK_SUCCESS, "runInverseKernels() failed");
 
     // Enqueue the results to application pointer
     cl_event readEvt1;
@@ -386,7 +796,7 @@ int DwtHaar1D::runDwtHaar1DKernel()
                  dOutDataBuf,
                  CL_FALSE,
                  0,
-                 signalLength * sizeof(cl_float),
+                 bufSize,
                  dOutData,
                  0,
                  NULL,
@@ -397,11 +807,11 @@ int DwtHaar1D::runDwtHaar1DKernel()
     cl_event readEvt2;
     status = clEnqueueReadBuffer(
                  commandQueue,
-                 dPartialOutDataBuf,
+                 dReconDataBuf,
                  CL_FALSE,
                  0,
-                 signalLength * sizeof(cl_float),
-                 dPartialOutData,
+                 bufSize,
+                 dReconData,
                  0,
                  NULL,
                  &readEvt2);
@@ -419,73 +829,6 @@ int DwtHaar1D::runDwtHaar1DKernel()
     return SDK_SUCCESS;
 }
 
-int
-DwtHaar1D::runCLKernels(void)
-{
-
-    // Calculate thread-histograms
-    unsigned int levels = 0;
-    unsigned int curLevels = 0;
-    unsigned int actualLevels = 0;
-
-    int result = getLevels(signalLength, &levels);
-    CHECK_ERROR(result, SDK_SUCCESS, "getLevels() failed");
-
-    actualLevels = levels;
-
-    //max levels on device should be decided by kernelWorkGroupSize
-    int tempVar = (int)(log((float)kernelInfo.kernelWorkGroupSize) / log((float)2));
-    maxLevelsOnDevice = tempVar + 1;
-
-    cl_float* temp = (cl_float*)malloc(signalLength * sizeof(cl_float));
-    memcpy(temp, inData, signalLength * sizeof(cl_float));
-
-    levelsDone = 0;
-    int one = 1;
-    while((unsigned int)levelsDone < actualLevels)
-    {
-        curLevels = (levels < maxLevelsOnDevice) ? levels : maxLevelsOnDevice;
-
-        // Set the signal length for current iteration
-        if(levelsDone == 0)
-        {
-            curSignalLength = signalLength;
-        }
-        else
-        {
-            curSignalLength = (one << levels);
-        }
-
-        // Set group size
-        groupSize = (1 << curLevels) / 2;
-
-        totalLevels = levels;
-        runDwtHaar1DKernel();
-
-        if(levels <= maxLevelsOnDevice)
-        {
-            dOutData[0] = dPartialOutData[0];
-            memcpy(hOutData, dOutData, (one << curLevels) * sizeof(cl_float));
-            memcpy(dOutData + (one << curLevels), hOutData + (one << curLevels),
-                   (signalLength  - (one << curLevels)) * sizeof(cl_float));
-            break;
-        }
-        else
-        {
-            levels -= maxLevelsOnDevice;
-            memcpy(hOutData, dOutData, curSignalLength * sizeof(cl_float));
-            memcpy(inData, dPartialOutData, (one << levels) * sizeof(cl_float));
-            levelsDone += (int)maxLevelsOnDevice;
-        }
-
-    }
-
-    memcpy(inData, temp, signalLength * sizeof(cl_float));
-    free(temp);
-
-    return SDK_SUCCESS;
-}
-
 int
 DwtHaar1D::initialize()
 {
@@ -501,13 +844,67 @@ DwtHaar1D::initialize()
 
     length_option->_sVersion = "x";
     length_option->_lVersion = "signalLength";
-    length_option->_description = "Length of the signal";
+    length_option->_description = "Length of the signal (width of the images)";
     length_option->_type = CA_ARG_INT;
     length_option->_value = &signalLength;
 
     sampleArgs->AddOption(length_option);
     delete length_option;
 
+    Option* height_option = new Option;
+    CHECK_ALLOCATION(height_option,
+                     "Error. Failed to allocate memory (height_option)\n");
+
+    height_option->_sVersion = "y";
+    height_option->_lVersion = "signalHeight";
+    height_option->_description =
+        "Height of the images for a 2-D transform, 1 for 1-D signals";
+    height_option->_type = CA_ARG_INT;
+    height_option->_value = &signalHeight;
+
+    sampleArgs->AddOption(height_option);
+    delete height_option;
+
+    Option* signals_option = new Option;
+    CHECK_ALLOCATION(signals_option,
+                     "Error. Failed to allocate memory (signals_option)\n");
+
+    signals_option->_sVersion = "n";
+    signals_option->_lVersion = "numSignals";
+    signals_option->_description = "Number of signals or images transformed in one launch";
+    signals_option->_type = CA_ARG_INT;
+    signals_option->_value = &numSignals;
+
+    sampleArgs->AddOption(signals_option);
+    delete signals_option;
+
+    Option* levels_option = new Option;
+    CHECK_ALLOCATION(levels_option,
+                     "Error. Failed to allocate memory (levels_option)\n");
+
+    levels_option->_sVersion = "l";
+    levels_option->_lVersion = "levels";
+    levels_option->_description =
+        "Number of decomposition levels (0 for a full decomposition)";
+    levels_option->_type = CA_ARG_INT;
+    levels_option->_value = &numLevels;
+
+    sampleArgs->AddOption(levels_option);
+    delete levels_option;
+
+    Option* wavelet_option = new Option;
+    CHECK_ALLOCATION(wavelet_option,
+                     "Error. Failed to allocate memory (wavelet_option)\n");
+
+    wavelet_option->_sVersion = "w";
+    wavelet_option->_lVersion = "wavelet";
+    wavelet_option->_description = "Wavelet to use : haar, d4 or cdf97";
+    wavelet_option->_type = CA_ARG_STRING;
+    wavelet_option->_value = &waveletName;
+
+    sampleArgs->AddOption(wavelet_option);
+    delete wavelet_option;
+
     Option* iteration_option = new Option;
     CHECK_ALLOCATION(iteration_option,
                      "Error. Failed to allocate memory (iteration_option)\n");
@@ -584,7 +981,8 @@ int DwtHaar1D::run()
 
     if(!sampleArgs->quiet)
     {
-        printArray<cl_float>("dOutData", dOutData, 256, 1);
+        printArray<cl_float>("dOutData", dOutData,
+                             std::min(signalLength * signalHeight, 256u), 1);
     }
 
     return SDK_SUCCESS;
@@ -595,15 +993,40 @@ DwtHaar1D::verifyResults()
 {
     if(sampleArgs->verify)
     {
+        cl_uint total = signalLength * signalHeight * numSignals;
+
         // Rreference implementation on host device
+        int timer = sampleTimer->createTimer();
+        sampleTimer->resetTimer(timer);
+        sampleTimer->startTimer(timer);
+
         calApproxFinalOnHost();
 
+        sampleTimer->stopTimer(timer);
+        hostTime = (double)(sampleTimer->readTimer(timer));
+
+        // Coefficients grow with the levels, compare relative to the largest
+        cl_float maxCoef = 1.0f;
+        cl_float maxInput = 1.0f;
+        for(cl_uint i = 0; i < total; ++i)
+        {
+            maxCoef = std::max(maxCoef, (cl_float)fabs(hOutData[i]));
+            maxInput = std::max(maxInput, (cl_float)fabs(inData[i]));
+        }
+
         // Compare the results and see if they match
         bool result = true;
-        for(cl_uint i = 0; i < signalLength; ++i)
+        for(cl_uint i = 0; i < total; ++i)
         {
-            if(fabs(dOutData[i] - hOutData[i]) > 0.1f)
+            if(fabs(dOutData[i] - hOutData[i]) > 1e-4f * maxCoef)
+            {
+                std::cout << "Coefficient mismatch at " << i << std::endl;
+                result = false;
+                break;
+            }
+            if(fabs(dReconData[i] - inData[i]) > 1e-3f * maxInput)
             {
+                std::cout << "Reconstruction mismatch at " << i << std::endl;
                 result = false;
                 break;
             }
@@ -628,15 +1051,26 @@ void DwtHaar1D::printStats()
 {
     if(sampleArgs->timing)
     {
-        std::string strArray[3] = {"SignalLength", "Time(sec)", "[Transfer+Kernel]Time(sec)"};
+        std::string strArray[6] =
+        {
+            "SignalLength",
+            "SignalHeight",
+            "Signals",
+            "Time(sec)",
+            "[Transfer+Kernel]Time(sec)",
+            "Host Time(sec)"
+        };
         sampleTimer->totalTime = setupTime + kernelTime;
 
-        std::string stats[3];
+        std::string stats[6];
         stats[0] = toString(signalLength, std::dec);
-        stats[1] = toString(sampleTimer->totalTime, std::dec);
-        stats[2] = toString(kernelTime, std::dec);
+        stats[1] = toString(signalHeight, std::dec);
+        stats[2] = toString(numSignals, std::dec);
+        stats[3] = toString(sampleTimer->totalTime, std::dec);
+        stats[4] = toString(kernelTime, std::dec);
+        stats[5] = toString(hostTime, std::dec);
 
-        printStatistics(strArray, stats, 3);
+        printStatistics(strArray, stats, 6);
     }
 }
 
@@ -651,12 +1085,27 @@ int DwtHaar1D::cleanup()
     status = clReleaseMemObject(dOutDataBuf);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(dOutDataBuf)");
 
-    status = clReleaseMemObject(dPartialOutDataBuf);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(dPartialOutDataBuf)");
+    for(int i = 0; i < 2; ++i)
+    {
+        status = clReleaseMemObject(tempBuf[i]);
+        CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(tempBuf)");
+    }
+
+    status = clReleaseMemObject(dReconDataBuf);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(dReconDataBuf)");
+
+    status = clReleaseMemObject(stepsBuf);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(stepsBuf)");
 
     status = clReleaseKernel(kernel);
     CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernel)");
 
+    status = clReleaseKernel(localKernel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(localKernel)");
+
+    status = clReleaseKernel(inverseKernel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(inverseKernel)");
+
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.(program)");
 
@@ -669,7 +1118,7 @@ int DwtHaar1D::cleanup()
     // Release program resources (input memory etc.)
     FREE(inData);
     FREE(dOutData);
-    FREE(dPartialOutData);
+    FREE(dReconData);
     FREE(hOutData);
     FREE(devices);
 
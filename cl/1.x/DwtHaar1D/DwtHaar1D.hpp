@@ -30,46 +30,79 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 #include "CLUtil.hpp"
 
 using namespace appsdk;
 
 #define SIGNAL_LENGTH (1 << 10)
+#define MAX_LIFT_STEPS 4
+#define GROUP_SIZE 256
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.2"
 
 /**
- * DwtHaar1D
- * Class implements One-dimensional Haar wavelet decomposition
+ * Lifting step of a wavelet. Mirrors the float4 steps read by the kernels
+ * PREDICT : d[i] += a * s[i] + b * s[i + offset]
+ * UPDATE  : s[i] += a * d[i] + b * d[i + offset]
+ */
+enum LiftType
+{
+    LIFT_PREDICT = 0,
+    LIFT_UPDATE = 1
+};
+
+typedef struct
+{
+    const char *name;                   /**< name used on the command line */
+    cl_uint numSteps;                   /**< number of lifting steps */
+    cl_float steps[MAX_LIFT_STEPS][4];  /**< type, a, b, offset of every step */
+    cl_float scaleS;                    /**< scaling of approximation coefficients */
+    cl_float scaleD;                    /**< scaling of detail coefficients */
+} LiftingScheme;
 
+/**
+ * DwtHaar1D
+ * Class implements multi-level 1-D and separable 2-D wavelet decomposition
+ * and reconstruction of batches of signals of arbitrary length, using
+ * the lifting schemes of the Haar, Daubechies-4 and CDF 9/7 wavelets
  */
 
 class DwtHaar1D
 {
 
-        cl_uint signalLength;           /**< Signal length (Must be power of 2)*/
+        cl_uint signalLength;           /**< Signal length (width of images for 2-D) */
+        cl_uint signalHeight;           /**< Height of images, 1 for 1-D signals */
+        cl_uint numSignals;             /**< Number of signals or images in the batch */
+        cl_uint numLevels;              /**< Decomposition levels, 0 for a full decomposition */
+        std::string waveletName;        /**< haar, d4 or cdf97 */
+        const LiftingScheme *scheme;    /**< lifting scheme of the selected wavelet */
         cl_float *inData;               /**< input data */
-        cl_float *dOutData;             /**< output data */
-        cl_float *dPartialOutData;      /**< paritial decomposed signal */
-        cl_float *hOutData;             /**< output data calculated on host */
+        cl_float *dOutData;             /**< coefficients calculated on device */
+        cl_float *dReconData;           /**< signal reconstructed on device */
+        cl_float *hOutData;             /**< coefficients calculated on host */
 
         cl_double setupTime;            /**< time taken to setup OpenCL resources and building kernel */
         cl_double kernelTime;           /**< time taken to run kernel and read result back */
+        cl_double hostTime;             /**< time taken by the host decomposition */
 
         cl_context context;             /**< CL context */
         cl_device_id *devices;          /**< CL device list */
 
         cl_mem inDataBuf;               /**< CL memory buffer for input data */
-        cl_mem dOutDataBuf;             /**< CL memory buffer for output data */
-        cl_mem dPartialOutDataBuf;      /**< CL memory buffer for paritial decomposed signal */
+        cl_mem dOutDataBuf;             /**< CL memory buffer for coefficients */
+        cl_mem tempBuf[2];              /**< CL memory buffers for intermediate levels */
+        cl_mem dReconDataBuf;           /**< CL memory buffer for reconstructed signal */
+        cl_mem stepsBuf;                /**< CL memory buffer for lifting steps */
 
         cl_command_queue commandQueue;  /**< CL command queue */
         cl_program program;             /**< CL program  */
-        cl_kernel kernel;               /**< CL kernel for histogram */
-        cl_uint maxLevelsOnDevice;      /**< Maximum levels to be computed on device */
+        cl_kernel kernel;               /**< CL kernel for one decomposition level */
+        cl_kernel localKernel;          /**< CL kernel for levels fitting in local memory */
+        cl_kernel inverseKernel;        /**< CL kernel for one reconstruction level */
         int iterations;                 /**< Number of iterations to be executed on kernel */
-        size_t        globalThreads;    /**< global NDRange */
-        size_t         localThreads;    /**< Local Work Group Size */
+        size_t localThreads;            /**< Local Work Group Size */
         SDKDeviceInfo deviceInfo;        /**< Structure to store device information*/
         KernelWorkGroupInfo
         kernelInfo;      /**< Structure to store kernel related info */
@@ -87,11 +120,17 @@ class DwtHaar1D
         DwtHaar1D()
             :
             signalLength(SIGNAL_LENGTH),
+            signalHeight(1),
+            numSignals(1),
+            numLevels(0),
+            waveletName("haar"),
+            scheme(NULL),
             setupTime(0),
             kernelTime(0),
+            hostTime(0),
             inData(NULL),
             dOutData(NULL),
-            dPartialOutData(NULL),
+            dReconData(NULL),
             hOutData(NULL),
             devices(NULL),
             iterations(1)
@@ -114,8 +153,7 @@ class DwtHaar1D
         int setupDwtHaar1D();
 
         /**
-         * Calculates the value of WorkGroup Size based in global NDRange
-         * and kernel properties
+         * Calculates the value of WorkGroup Size based on kernel properties
          *  @return returns SDK_SUCCESS on success and SDK_FAILURE otherwise
          */
         int setWorkGroupSize();
@@ -185,35 +223,58 @@ class DwtHaar1D
 
     private:
 
-        cl_int groupSize;       /**< Work items in a group */
-        cl_int totalLevels;     /**< Total decomposition levels required for given signal length */
-        cl_int curSignalLength; /**< Length of signal for given iteration */
-        cl_int levelsDone;      /**< levels done */
+        cl_uint totalLevels;            /**< Decomposition levels performed */
+        std::vector<cl_uint> widths;    /**< Width of the approximation at each level */
+        std::vector<cl_uint> heights;   /**< Height of the approximation at each level */
 
         /**
-         * @brief   Get number of decomposition levels to perform a full decomposition
-         *          and also check if the input signal size is suitable
-         * @return  returns the number of decomposition levels if they could be detrmined
-         *          and the signal length is supported by the implementation,
-         *          otherwise it returns SDK_FAILURE
+         * @brief   Get number of decomposition levels to perform a full
+         *          decomposition of a signal of given length
          * @param   length  Length of input signal
-         * @param   levels  Number of decoposition levels neessary to perform a full
-         *                  decomposition
-         *
+         * @return  number of levels after which one approximation
+         *          coefficient is left
          */
-        int getLevels(unsigned int length, unsigned int* levels);
+        cl_uint getLevels(cl_uint length);
 
         /**
-         * @brief   Runs the dwtHaar1D kernel to calculate
-         *          the approximation coefficients on device
+         * @brief   Enqueues one level of dwtLiftLevel or idwtLiftLevel
+         * @param   kern      kernel to enqueue
+         * @param   buf0      first buffer argument of the kernel
+         * @param   buf1      second buffer argument of the kernel
+         * @param   buf2      third buffer argument of the kernel
+         * @param   n         length of the lines
+         * @param   numLines  number of lines
+         * @param   layout    lines per image, image, line and sample strides
          * @return returns SDK_SUCCESS on success and SDK_FAILURE otherwise
          */
-        int runDwtHaar1DKernel();
+        int enqueueLevel(cl_kernel kern, cl_mem buf0, cl_mem buf1, cl_mem buf2,
+                         cl_uint n, cl_uint numLines, cl_uint4 layout);
+
+        /**
+         * @brief   Enqueues the decomposition of all levels of the batch
+         * @return returns SDK_SUCCESS on success and SDK_FAILURE otherwise
+         */
+        int runForwardKernels();
+
+        /**
+         * @brief   Enqueues the reconstruction of all levels of the batch
+         * @return returns SDK_SUCCESS on success and SDK_FAILURE otherwise
+         */
+        int runInverseKernels();
+
+        /**
+         * @brief   Decomposes one line on host into s and d using SSE for
+         *          the interior of every lifting step
+         * @param   x   input line
+         * @param   n   length of the line
+         * @param   s   (n + 1) / 2 approximation coefficients
+         * @param   d   n / 2 detail coefficients
+         */
+        void liftLineHost(const cl_float *x, cl_uint n, cl_float *s, cl_float *d);
 
         /**
-        * @brief   Reference implementation to calculates
-        *          the approximation coefficients on host
-        *          by normalized decomposition
+        * @brief   Reference implementation to calculate all decomposition
+        *          levels of the batch on host
         * @return returns SDK_SUCCESS on success and SDK_FAILURE otherwise
         */
         int calApproxFinalOnHost();
@@ -17,92 +17,313 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 /*
  * For a description of the algorithm and the terms used, please see the
  * documentation for this sample.
+ *
+ * Every wavelet is a sequence of lifting steps on the even (s) and odd (d)
+ * samples of a line. A step is passed as float4(type, a, b, offset):
+ *   LIFT_PREDICT : d[i] += a * s[i] + b * s[i + offset]
+ *   LIFT_UPDATE  : s[i] += a * d[i] + b * d[i + offset]
+ * The last step is followed by s *= scale.x and d *= scale.y.
+ * A sample outside a channel takes the value of the nearest sample of that
+ * channel, which is the whole-sample symmetric extension of the signal, so
+ * lines of any length are decomposed and reconstructed exactly.
  */
 
+#define LIFT_PREDICT 0
+#define HALO 2
 
 /**
- * @brief   Calculates decomposed signal with maximum of 9 levels by using 
- *          1D Haar wavelet decomposition 
- * @param   inSignal        input signal
- * @param   coefsSignal     Coefficient details of signal after 9 levels of decompostion 
- * @param   AverageSignal   Averages of signal after 9 levels of decompostion
- * @param   sharedArray     shared array 
- * @param   tLevels         actual levels required for full decomposition 
- * @param   signalLength    length of signal
- * @param   levelsDone      level of decompositions done 
- * @param   mLevels	    maximum number of levels to be processed on device
+ * @brief   Offset of sample k of a line in a batch of lines
+ * @param   line    index of the line in the batch
+ * @param   k       index of the sample in the line
+ * @param   layout  lines per image, elements between images,
+ *                  elements between lines, elements between samples
+ */
+inline uint elementOffset(uint line, uint k, uint4 layout)
+{
+    return (line / layout.x) * layout.y + (line % layout.x) * layout.z
+           + k * layout.w;
+}
+
+/**
+ * @brief   Applies one lifting step to the tiles of a work-group and
+ *          restores the boundary extension of the updated channel
+ * @param   sTile   even samples of the tile with HALO samples on each side
+ * @param   dTile   odd samples of the tile with HALO samples on each side
+ * @param   step    lifting step
+ * @param   sign    1 to apply the step, -1 to undo it
+ * @param   first   index in the channel of the first sample of the tiles
+ * @param   ns      number of even samples in the line
+ * @param   nd      number of odd samples in the line
+ */
+void liftTile(__local float *sTile,
+              __local float *dTile,
+              float4 step,
+              float sign,
+              int first,
+              int ns,
+              int nd)
+{
+    int localId = (int)get_local_id(0);
+    int localSize = (int)get_local_size(0);
+    int tileLen = localSize + 2 * HALO;
+    int offset = (int)step.w;
+
+    bool predict = ((int)step.x == LIFT_PREDICT);
+    __local float *dst = predict ? dTile : sTile;
+    __local float *src = predict ? sTile : dTile;
+    int dstLen = predict ? nd : ns;
+
+    for(int p = localId; p < tileLen; p += localSize)
+    {
+        int q = p + offset;
+        if(q >= 0 && q < tileLen)
+        {
+            dst[p] += sign * (step.y * src[p] + step.z * src[q]);
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(int p = localId; p < tileLen; p += localSize)
+    {
+        int g = first + p;
+        int c = clamp(g, 0, dstLen - 1);
+        if(c != g)
+        {
+            dst[p] = dst[c - first];
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+/**
+ * @brief   Computes one decomposition level of a batch of lines.
+ *          Approximation coefficients go to the first (n + 1) / 2 samples
+ *          of sDst and detail coefficients to the following n / 2 samples
+ *          of dDst
+ * @param   src         input lines
+ * @param   sDst        approximation coefficients
+ * @param   dDst        detail coefficients
+ * @param   sTile       local memory for even samples
+ * @param   dTile       local memory for odd samples
+ * @param   steps       lifting steps of the wavelet
+ * @param   numSteps    number of lifting steps
+ * @param   scale       scaling of approximation and detail coefficients
+ * @param   n           length of the lines at this level
+ * @param   layout      layout of the lines (see elementOffset)
  */
 __kernel
-void dwtHaar1D(
-                __global float *inSignal,
-                __global float *coefsSignal,
-                __global float *AverageSignal,
-                __local float *sharedArray,
-                uint tLevels,
-                uint signalLength,
-                uint levelsDone,
-		uint mLevels)
-              
+void dwtLiftLevel(__global const float *src,
+                  __global float *sDst,
+                  __global float *dDst,
+                  __local float *sTile,
+                  __local float *dTile,
+                  __constant float4 *steps,
+                  uint numSteps,
+                  float2 scale,
+                  uint n,
+                  uint4 layout)
 {
-    size_t localId = get_local_id(0);
-    size_t groupId = get_group_id(0);
-    size_t globalId = get_global_id(0);
-    size_t localSize = get_local_size(0);
-    
-    /**
-     * Read input signal data from global memory
-     * to shared memory
-     */
-    float t0 = inSignal[groupId * localSize * 2 + localId];
-    float t1 = inSignal[groupId * localSize * 2 + localSize + localId];
-    // Divide with signal length for normalized decomposition
-    if(0 == levelsDone)
+    int localId = (int)get_local_id(0);
+    int localSize = (int)get_local_size(0);
+    uint line = get_global_id(1);
+
+    if(n < 2)
+    {
+        if(get_global_id(0) == 0)
+        {
+            sDst[elementOffset(line, 0, layout)] = src[elementOffset(line, 0, layout)];
+        }
+        return;
+    }
+
+    int ns = (int)(n + 1) / 2;
+    int nd = (int)n / 2;
+    int first = (int)get_group_id(0) * localSize - HALO;
+    int tileLen = localSize + 2 * HALO;
+
+    for(int p = localId; p < tileLen; p += localSize)
     {
-       float r = rsqrt((float)signalLength);
-       t0 *= r;
-       t1 *= r;
+        int g = first + p;
+        sTile[p] = src[elementOffset(line, 2 * clamp(g, 0, ns - 1), layout)];
+        dTile[p] = src[elementOffset(line, 2 * clamp(g, 0, nd - 1) + 1, layout)];
     }
-    sharedArray[localId] = t0;
-    sharedArray[localSize + localId] = t1;
-     
     barrier(CLK_LOCAL_MEM_FENCE);
-    
-    uint levels = tLevels > mLevels ? mLevels: tLevels;
-    uint activeThreads = (1 << levels) / 2;
-    uint midOutPos = signalLength / 2;
-    
-    float rsqrt_two = rsqrt(2.0f);
-    for(uint i = 0; i < levels; ++i)
+
+    for(uint k = 0; k < numSteps; ++k)
     {
+        liftTile(sTile, dTile, steps[k], 1.0f, first, ns, nd);
+    }
+
+    int i = first + HALO + localId;
+    if(i < ns)
+    {
+        sDst[elementOffset(line, i, layout)] = sTile[HALO + localId] * scale.x;
+    }
+    if(i < nd)
+    {
+        dDst[elementOffset(line, ns + i, layout)] = dTile[HALO + localId] * scale.y;
+    }
+}
+
+/**
+ * @brief   Reconstructs one level of a batch of lines from the
+ *          approximation coefficients in sSrc and the detail
+ *          coefficients in dSrc (see dwtLiftLevel)
+ * @param   sSrc        approximation coefficients
+ * @param   dSrc        detail coefficients
+ * @param   dst         reconstructed lines
+ * @param   sTile       local memory for even samples
+ * @param   dTile       local memory for odd samples
+ * @param   steps       lifting steps of the wavelet
+ * @param   numSteps    number of lifting steps
+ * @param   scale       scaling of approximation and detail coefficients
+ * @param   n           length of the reconstructed lines
+ * @param   layout      layout of the lines (see elementOffset)
+ */
+__kernel
+void idwtLiftLevel(__global const float *sSrc,
+                   __global const float *dSrc,
+                   __global float *dst,
+                   __local float *sTile,
+                   __local float *dTile,
+                   __constant float4 *steps,
+                   uint numSteps,
+                   float2 scale,
+                   uint n,
+                   uint4 layout)
+{
+    int localId = (int)get_local_id(0);
+    int localSize = (int)get_local_size(0);
+    uint line = get_global_id(1);
 
-        float data0, data1;
-        if(localId < activeThreads)
+    if(n < 2)
+    {
+        if(get_global_id(0) == 0)
         {
-            data0 = sharedArray[2 * localId];
-            data1 = sharedArray[2 * localId + 1];
+            dst[elementOffset(line, 0, layout)] = sSrc[elementOffset(line, 0, layout)];
         }
+        return;
+    }
+
+    int ns = (int)(n + 1) / 2;
+    int nd = (int)n / 2;
+    int first = (int)get_group_id(0) * localSize - HALO;
+    int tileLen = localSize + 2 * HALO;
 
-        /* make sure all work items have read from sharedArray before modifying it */
+    for(int p = localId; p < tileLen; p += localSize)
+    {
+        int g = first + p;
+        sTile[p] = sSrc[elementOffset(line, clamp(g, 0, ns - 1), layout)] / scale.x;
+        dTile[p] = dSrc[elementOffset(line, ns + clamp(g, 0, nd - 1), layout)] / scale.y;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(uint k = numSteps; k > 0; --k)
+    {
+        liftTile(sTile, dTile, steps[k - 1], -1.0f, first, ns, nd);
+    }
+
+    int i = first + HALO + localId;
+    if(i < ns)
+    {
+        dst[elementOffset(line, 2 * i, layout)] = sTile[HALO + localId];
+    }
+    if(i < nd)
+    {
+        dst[elementOffset(line, 2 * i + 1, layout)] = dTile[HALO + localId];
+    }
+}
+
+/**
+ * @brief   Computes the remaining decomposition levels of a batch of lines
+ *          that fit in local memory, one work-group per line. Produces the
+ *          same coefficients as repeated dwtLiftLevel launches
+ * @param   src         input lines
+ * @param   sDst        final approximation coefficients
+ * @param   dDst        detail coefficients of every level
+ * @param   xLocal      local memory for 2 * get_local_size(0) samples
+ * @param   sLocal      local memory for get_local_size(0) even samples
+ * @param   dLocal      local memory for get_local_size(0) odd samples
+ * @param   steps       lifting steps of the wavelet
+ * @param   numSteps    number of lifting steps
+ * @param   scale       scaling of approximation and detail coefficients
+ * @param   n           length of the lines, at most 2 * get_local_size(0)
+ * @param   levels      number of levels to compute
+ * @param   layout      layout of the lines (see elementOffset)
+ */
+__kernel
+void dwtLiftLocal(__global const float *src,
+                  __global float *sDst,
+                  __global float *dDst,
+                  __local float *xLocal,
+                  __local float *sLocal,
+                  __local float *dLocal,
+                  __constant float4 *steps,
+                  uint numSteps,
+                  float2 scale,
+                  uint n,
+                  uint levels,
+                  uint4 layout)
+{
+    int localId = (int)get_local_id(0);
+    int localSize = (int)get_local_size(0);
+    uint line = get_global_id(1);
+    int len = (int)n;
+
+    for(int p = localId; p < len; p += localSize)
+    {
+        xLocal[p] = src[elementOffset(line, p, layout)];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(uint level = 0; level < levels && len > 1; ++level)
+    {
+        int ns = (len + 1) / 2;
+        int nd = len / 2;
+
+        for(int p = localId; p < ns; p += localSize)
+        {
+            sLocal[p] = xLocal[2 * p];
+            if(p < nd)
+            {
+                dLocal[p] = xLocal[2 * p + 1];
+            }
+        }
         barrier(CLK_LOCAL_MEM_FENCE);
 
-        if(localId < activeThreads)
+        for(uint k = 0; k < numSteps; ++k)
         {
-            sharedArray[localId] = (data0 + data1) * rsqrt_two;
-            uint globalPos = midOutPos + groupId * activeThreads + localId;
-            coefsSignal[globalPos] = (data0 - data1) * rsqrt_two;
-       
-            midOutPos >>= 1;
+            float4 step = steps[k];
+            int offset = (int)step.w;
+            bool predict = ((int)step.x == LIFT_PREDICT);
+            __local float *dst = predict ? dLocal : sLocal;
+            __local float *other = predict ? sLocal : dLocal;
+            int dstLen = predict ? nd : ns;
+            int otherLen = predict ? ns : nd;
+
+            for(int p = localId; p < dstLen; p += localSize)
+            {
+                dst[p] += step.y * other[clamp(p, 0, otherLen - 1)]
+                          + step.z * other[clamp(p + offset, 0, otherLen - 1)];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
         }
-        activeThreads >>= 1;
-        barrier(CLK_LOCAL_MEM_FENCE);   
+
+        for(int p = localId; p < ns; p += localSize)
+        {
+            xLocal[p] = sLocal[p] * scale.x;
+            if(p < nd)
+            {
+                dDst[elementOffset(line, ns + p, layout)] = dLocal[p] * scale.y;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        len = ns;
     }
-    
-    /**
-     * Write 0th element for the next decomposition
-     * steps which are performed on host 
-     */
-    
-     if(0 == localId)
-        AverageSignal[groupId] = sharedArray[0];
-}
 
+    for(int p = localId; p < len; p += localSize)
+    {
+        sDst[elementOffset(line, p, layout)] = xLocal[p];
+    }
+}
@@ -16,19 +16,25 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 
 #include "FastWalshTransform.hpp"
+#include <xmmintrin.h>
 
 int
 FastWalshTransform::setupFastWalshTransform()
 {
-    cl_uint inputSizeBytes;
+    size_t inputSizeBytes;
 
     if(length < 512)
     {
         length = 512;
     }
 
+    if(batch < 1)
+    {
+        batch = 1;
+    }
+
     // allocate and init memory used by host
-    inputSizeBytes = length * sizeof(cl_float);
+    inputSizeBytes = (size_t)length * batch * sizeof(cl_float);
     input = (cl_float *) malloc(inputSizeBytes);
     CHECK_ALLOCATION(input, "Failed to allocate host memory. (input)");
 
@@ -36,7 +42,7 @@ FastWalshTransform::setupFastWalshTransform()
     CHECK_ALLOCATION(output, "Failed to allocate host memory. (output)");
 
     // random initialisation of input
-    fillRandom<cl_float>(input, length, 1, 0, 255);
+    fillRandom<cl_float>(input, length, batch, 0, 255);
 
     if(sampleArgs->verify)
     {
@@ -148,10 +154,19 @@ FastWalshTransform::setupCL(void)
     retValue = deviceInfo.setDeviceInfo(devices[sampleArgs->deviceId]);
     CHECK_ERROR(retValue, SDK_SUCCESS, "SDKDeviceInfo::setDeviceInfo() failed");
 
+    // All vectors of the batch live in one buffer
+    if((cl_ulong)length * batch * sizeof(cl_float) > deviceInfo.maxMemAllocSize)
+    {
+        std::cout << "Error: " << batch << " vectors of " << length
+                  << " elements exceed CL_DEVICE_MAX_MEM_ALLOC_SIZE, reduce --batch"
+                  << std::endl;
+        return SDK_FAILURE;
+    }
+
     inputBuffer = clCreateBuffer(
                       context,
                       CL_MEM_READ_WRITE,
-                      sizeof(cl_float) * length,
+                      sizeof(cl_float) * length * batch,
                       0,
                       &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (inputBuffer)");
@@ -176,8 +191,56 @@ FastWalshTransform::setupCL(void)
     CHECK_ERROR(retValue, SDK_SUCCESS, "buildOpenCLProgram() failed");
 
     // get a kernel object handle for a kernel with the given name
-    kernel = clCreateKernel(program, "fastWalshTransform", &status);
-    CHECK_OPENCL_ERROR(status, "clCreateKernel failed.");
+    localKernel = clCreateKernel(program, "fastWalshTransformLocal", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (fastWalshTransformLocal)");
+
+    radixKernel = clCreateKernel(program, "fastWalshTransformRadix", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (fastWalshTransformRadix)");
+
+    // Check group size against kernelWorkGroupSize
+    status = kernelInfo.setKernelWorkGroupInfo(localKernel,
+             devices[sampleArgs->deviceId]);
+    CHECK_OPENCL_ERROR(status, "kernelInfo.setKernelWorkGroupInfo failed.");
+
+    size_t localThreads = GROUP_SIZE;
+    if(localThreads > kernelInfo.kernelWorkGroupSize)
+    {
+        if(!sampleArgs->quiet)
+        {
+            std::cout << "Out of Resources!" << std::endl;
+            std::cout << "Group Size specified : " << localThreads << std::endl;
+            std::cout << "Max Group Size supported on the kernel : "
+                      << kernelInfo.kernelWorkGroupSize << std::endl;
+            std::cout<<"Changing the group size to " << kernelInfo.kernelWorkGroupSize
+                     << std::endl;
+        }
+        localThreads = kernelInfo.kernelWorkGroupSize;
+    }
+
+    // Each work-item of localKernel owns 4 elements of the block
+    blockSize = 4 * localThreads;
+    while(blockSize > (size_t)length ||
+            blockSize * sizeof(cl_float) > deviceInfo.localMemSize)
+    {
+        blockSize >>= 1;
+    }
+
+    status = kernelInfo.setKernelWorkGroupInfo(radixKernel,
+             devices[sampleArgs->deviceId]);
+    CHECK_OPENCL_ERROR(status, "kernelInfo.setKernelWorkGroupInfo failed.");
+
+    radixGroupSize = GROUP_SIZE;
+    if(radixGroupSize > kernelInfo.kernelWorkGroupSize)
+    {
+        radixGroupSize = kernelInfo.kernelWorkGroupSize;
+    }
+
+    numGlobalPasses = 1;
+    for(cl_uint step = (cl_uint)blockSize; step < (cl_uint)length;
+            step *= MAX_RADIX)
+    {
+        numGlobalPasses++;
+    }
 
     return SDK_SUCCESS;
 }
@@ -197,7 +260,7 @@ FastWalshTransform::runCLKernels(void)
                  inputBuffer,
                  CL_FALSE,
                  0,
-                 length * sizeof(cl_float),
+                 (size_t)length * batch * sizeof(cl_float),
                  input,
                  0,
                  NULL,
@@ -211,76 +274,99 @@ FastWalshTransform::runCLKernels(void)
     CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(writeEvt) Failed");
 
     /*
-     * The kernel performs a butterfly operation and it runs for half the
-     * total number of input elements in the array.
-     * In each pass of the kernel two corresponding elements are found using
-     * the butterfly operation on an array of numbers and their sum and difference
-     * is stored in the same locations as the numbers
+     * The stages with step < blockSize run in local memory in one launch.
+     * Every further launch applies up to log2(MAX_RADIX) stages with each
+     * work-item keeping MAX_RADIX elements in registers. All launches are
+     * enqueued back to back, the in-order queue serializes them.
      */
-    globalThreads[0] = length / 2;
-    localThreads[0]  = 256;
+    globalThreads[0] = (size_t)(length / 4) * batch;
+    localThreads[0]  = blockSize / 4;
 
-    // Check group size against kernelWorkGroupSize
-    status = kernelInfo.setKernelWorkGroupInfo(kernel,
-             devices[sampleArgs->deviceId]);
-    CHECK_OPENCL_ERROR(status, "kernelInfo.setKernelWorkGroupInfo failed.");
+    status = clSetKernelArg(
+                 localKernel,
+                 0,
+                 sizeof(cl_mem),
+                 (void *)&inputBuffer);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (inputBuffer)");
 
-    if((cl_uint)(localThreads[0]) > kernelInfo.kernelWorkGroupSize)
-    {
-        if(!sampleArgs->quiet)
-        {
-            std::cout << "Out of Resources!" << std::endl;
-            std::cout << "Group Size specified : " << localThreads[0] << std::endl;
-            std::cout << "Max Group Size supported on the kernel : "
-                      << kernelInfo.kernelWorkGroupSize << std::endl;
-            std::cout<<"Changing the group size to " << kernelInfo.kernelWorkGroupSize
-                     << std::endl;
-        }
-        localThreads[0] = kernelInfo.kernelWorkGroupSize;
-    }
+    status = clSetKernelArg(
+                 localKernel,
+                 1,
+                 blockSize * sizeof(cl_float),
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (block)");
 
-    // Set appropriate arguments to the kernel
+    status = clEnqueueNDRangeKernel(
+                 commandQueue,
+                 localKernel,
+                 1,
+                 NULL,
+                 globalThreads,
+                 localThreads,
+                 0,
+                 NULL,
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. (localKernel)");
 
     // the input array - also acts as output
     status = clSetKernelArg(
-                 kernel,
+                 radixKernel,
                  0,
                  sizeof(cl_mem),
                  (void *)&inputBuffer);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (inputBuffer)");
 
-    for(cl_int step = 1; step < length; step <<= 1)
+    status = clSetKernelArg(
+                 radixKernel,
+                 3,
+                 sizeof(cl_uint),
+                 (void *)&length);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (length)");
+
+    for(cl_uint step = (cl_uint)blockSize; step < (cl_uint)length;
+            step *= MAX_RADIX)
     {
+        cl_uint radix = MAX_RADIX;
+        if(step * radix > (cl_uint)length)
+        {
+            radix = length / step;
+        }
+
         // stage of the algorithm
         status = clSetKernelArg(
-                     kernel,
+                     radixKernel,
                      1,
-                     sizeof(cl_int),
+                     sizeof(cl_uint),
                      (void *)&step);
         CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (step)");
 
-        // Enqueue a kernel run call
-        cl_event ndrEvt;
+        status = clSetKernelArg(
+                     radixKernel,
+                     2,
+                     sizeof(cl_uint),
+                     (void *)&radix);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (radix)");
+
+        size_t radixGlobal[2] = {length / radix, (size_t)batch};
+        size_t radixLocal[2] = {radixGroupSize, 1};
+        while(radixLocal[0] > radixGlobal[0] || radixGlobal[0] % radixLocal[0])
+        {
+            radixLocal[0] >>= 1;
+        }
+
         status = clEnqueueNDRangeKernel(
                      commandQueue,
-                     kernel,
-                     1,
+                     radixKernel,
+                     2,
                      NULL,
-                     globalThreads,
-                     localThreads,
+                     radixGlobal,
+                     radixLocal,
                      0,
                      NULL,
-                     &ndrEvt);
-        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
-
-        status = clFlush(commandQueue);
-        CHECK_OPENCL_ERROR(status, "clFlush failed.(commandQueue)");
-
-        status = waitForEventAndRelease(&ndrEvt);
-        CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
+                     NULL);
+        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. (radixKernel)");
     }
 
-
     // Enqueue readBuffer
     cl_event readEvt;
     status = clEnqueueReadBuffer(
@@ -288,7 +374,7 @@ FastWalshTransform::runCLKernels(void)
                  inputBuffer,
                  CL_FALSE,
                  0,
-                 length *  sizeof(cl_float),
+                 (size_t)length * batch * sizeof(cl_float),
                  output,
                  0,
                  NULL,
@@ -341,6 +427,92 @@ FastWalshTransform::fastWalshTransformCPUReference(
     }
 }
 
+/**
+ * Applies the stages firstStep <= step < endStep to span elements,
+ * two stages per sweep with SSE radix-4 butterflies. firstStep >= 4
+ */
+static void
+radix4Passes(cl_float * p, cl_uint span, cl_uint firstStep, cl_uint endStep)
+{
+    cl_uint step = firstStep;
+    for(; 4 * step <= endStep; step <<= 2)
+    {
+        for(cl_uint group = 0; group < span; group += 4 * step)
+        {
+            cl_float *p0 = p + group;
+            cl_float *p1 = p0 + step;
+            cl_float *p2 = p1 + step;
+            cl_float *p3 = p2 + step;
+            for(cl_uint i = 0; i < step; i += 4)
+            {
+                __m128 a0 = _mm_loadu_ps(p0 + i);
+                __m128 a1 = _mm_loadu_ps(p1 + i);
+                __m128 a2 = _mm_loadu_ps(p2 + i);
+                __m128 a3 = _mm_loadu_ps(p3 + i);
+
+                __m128 t0 = _mm_add_ps(a0, a1);
+                __m128 t1 = _mm_sub_ps(a0, a1);
+                __m128 t2 = _mm_add_ps(a2, a3);
+                __m128 t3 = _mm_sub_ps(a2, a3);
+
+                _mm_storeu_ps(p0 + i, _mm_add_ps(t0, t2));
+                _mm_storeu_ps(p1 + i, _mm_add_ps(t1, t3));
+                _mm_storeu_ps(p2 + i, _mm_sub_ps(t0, t2));
+                _mm_storeu_ps(p3 + i, _mm_sub_ps(t1, t3));
+            }
+        }
+    }
+
+    if(step < endStep)
+    {
+        // odd number of stages left : one radix-2 sweep
+        for(cl_uint group = 0; group < span; group += 2 * step)
+        {
+            cl_float *p0 = p + group;
+            cl_float *p1 = p0 + step;
+            for(cl_uint i = 0; i < step; i += 4)
+            {
+                __m128 a0 = _mm_loadu_ps(p0 + i);
+                __m128 a1 = _mm_loadu_ps(p1 + i);
+                _mm_storeu_ps(p0 + i, _mm_add_ps(a0, a1));
+                _mm_storeu_ps(p1 + i, _mm_sub_ps(a0, a1));
+            }
+        }
+    }
+}
+
+void
+FastWalshTransform::fastWalshTransformCPU(
+    cl_float * vinput,
+    const cl_uint length)
+{
+    cl_uint block = length < CPU_BLOCK_SIZE ? length : CPU_BLOCK_SIZE;
+    const __m128 sign1 = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+    const __m128 sign2 = _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f);
+
+    // all stages with step < block, one cache-resident block at a time
+    for(cl_uint b = 0; b < length; b += block)
+    {
+        cl_float *p = vinput + b;
+
+        // steps 1 and 2 within each register
+        for(cl_uint i = 0; i < block; i += 4)
+        {
+            __m128 v = _mm_loadu_ps(p + i);
+            v = _mm_add_ps(_mm_mul_ps(v, sign1),
+                           _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+            v = _mm_add_ps(_mm_mul_ps(v, sign2),
+                           _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+            _mm_storeu_ps(p + i, v);
+        }
+
+        radix4Passes(p, block, 4, block);
+    }
+
+    // stages spanning several blocks
+    radix4Passes(vinput, length, block, length);
+}
+
 int
 FastWalshTransform::initialize()
 {
@@ -356,12 +528,23 @@ FastWalshTransform::initialize()
 
     signal_length->_sVersion = "x";
     signal_length->_lVersion = "length";
-    signal_length->_description = "Length of input array";
+    signal_length->_description = "Length of each input vector";
     signal_length->_type = CA_ARG_INT;
     signal_length->_value = &length;
     sampleArgs->AddOption(signal_length);
     delete signal_length;
 
+    Option* num_vectors = new Option;
+    CHECK_ALLOCATION(num_vectors, "Memory allocation error.\n");
+
+    num_vectors->_sVersion = "b";
+    num_vectors->_lVersion = "batch";
+    num_vectors->_description = "Number of vectors transformed per launch";
+    num_vectors->_type = CA_ARG_INT;
+    num_vectors->_value = &batch;
+    sampleArgs->AddOption(num_vectors);
+    delete num_vectors;
+
     Option* num_iterations = new Option;
     CHECK_ALLOCATION(num_iterations, "Memory allocation error.\n");
 
@@ -442,7 +625,7 @@ FastWalshTransform::run()
 
     if(!sampleArgs->quiet)
     {
-        printArray<cl_float>("Output", input, length, 1);
+        printArray<cl_float>("Output", output, length, 1);
     }
 
     return SDK_SUCCESS;
@@ -461,13 +644,45 @@ FastWalshTransform::verifyResults()
         sampleTimer->resetTimer(refTimer);
         sampleTimer->startTimer(refTimer);
 
-        fastWalshTransformCPUReference(verificationInput, length);
+        for(cl_int i = 0; i < batch; ++i)
+        {
+            fastWalshTransformCPUReference(verificationInput + (size_t)i * length,
+                                           length);
+        }
 
         sampleTimer->stopTimer(refTimer);
         referenceKernelTime = sampleTimer->readTimer(refTimer);
 
+        // blocked SIMD host implementation
+        size_t totalLength = (size_t)length * batch;
+        cl_float *hostOutput = (cl_float *) malloc(totalLength * sizeof(cl_float));
+        CHECK_ALLOCATION(hostOutput, "Failed to allocate host memory. (hostOutput)");
+        memcpy(hostOutput, input, totalLength * sizeof(cl_float));
+
+        int hostTimer = sampleTimer->createTimer();
+        sampleTimer->resetTimer(hostTimer);
+        sampleTimer->startTimer(hostTimer);
+
+        for(cl_int i = 0; i < batch; ++i)
+        {
+            fastWalshTransformCPU(hostOutput + (size_t)i * length, length);
+        }
+
+        sampleTimer->stopTimer(hostTimer);
+        hostKernelTime = sampleTimer->readTimer(hostTimer);
+
+        // sums of up to 2^20 values are rounded differently per stage order
+        bool hostPassed = compare(hostOutput, verificationInput, (int)totalLength,
+                                  1e-5f);
+        FREE(hostOutput);
+        if(!hostPassed)
+        {
+            std::cout << "Host SIMD implementation mismatch" << std::endl;
+        }
+
         // compare the results and see if they match
-        if(compare(output, verificationInput, length))
+        if(hostPassed &&
+                compare(output, verificationInput, (int)totalLength, 1e-5f))
         {
             std::cout << "Passed!\n" << std::endl;
             return SDK_SUCCESS;
@@ -487,16 +702,29 @@ FastWalshTransform::printStats()
 {
     if(sampleArgs->timing)
     {
-        std::string strArray[3] = {"Length", "Time(sec)", "[Transfer+Kernel]Time(sec)"};
-        std::string stats[3];
+        std::string strArray[7] =
+        {
+            "Length",
+            "Batch",
+            "Global passes",
+            "Time(sec)",
+            "[Transfer+Kernel]Time(sec)",
+            "Vectors/sec",
+            "Host SIMD Time(sec)"
+        };
+        std::string stats[7];
 
         sampleTimer->totalTime = setupTime + totalKernelTime ;
 
         stats[0] = toString(length, std::dec);
-        stats[1] = toString(sampleTimer->totalTime, std::dec);
-        stats[2] = toString(totalKernelTime, std::dec);
-
-        printStatistics(strArray, stats, 3);
+        stats[1] = toString(batch, std::dec);
+        stats[2] = toString(numGlobalPasses, std::dec);
+        stats[3] = toString(sampleTimer->totalTime, std::dec);
+        stats[4] = toString(totalKernelTime, std::dec);
+        stats[5] = toString(batch / totalKernelTime, std::dec);
+        stats[6] = toString(hostKernelTime, std::dec);
+
+        printStatistics(strArray, stats, 7);
     }
 }
 int
@@ -505,8 +733,11 @@ FastWalshTransform::cleanup()
     // Releases OpenCL resources (Context, Memory etc.)
     cl_int status;
 
-    status = clReleaseKernel(kernel);
-    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernel)");
+    status = clReleaseKernel(localKernel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(localKernel)");
+
+    status = clReleaseKernel(radixKernel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(radixKernel)");
 
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.(program)");
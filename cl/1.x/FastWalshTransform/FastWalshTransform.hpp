@@ -27,6 +27,9 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "CLUtil.hpp"
 
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.2"
+#define GROUP_SIZE 256
+#define MAX_RADIX 16
+#define CPU_BLOCK_SIZE 2048
 
 using namespace appsdk;
 
@@ -44,7 +47,9 @@ class FastWalshTransform
         cl_double     totalKernelTime;       /**< Time for kernel execution */
         cl_double    totalProgramTime;       /**< Time for program execution */
         cl_double referenceKernelTime;       /**< Time for reference implementation */
-        cl_int                 length;       /**< Length of the input array */
+        cl_double      hostKernelTime;       /**< Time for blocked SIMD host implementation */
+        cl_int                 length;       /**< Length of each input vector */
+        cl_int                  batch;       /**< Number of vectors transformed per launch */
         cl_float               *input;       /**< Input array */
         cl_float              *output;       /**< Ouput array */
         cl_float
@@ -55,7 +60,11 @@ class FastWalshTransform
         cl_mem           outputBuffer;       /**< CL memory buffer */
         cl_command_queue commandQueue;       /**< CL command queue */
         cl_program            program;       /**< CL program  */
-        cl_kernel              kernel;       /**< CL kernel */
+        cl_kernel         localKernel;       /**< CL kernel for stages fitting in local memory */
+        cl_kernel         radixKernel;       /**< CL kernel for the remaining stages */
+        size_t              blockSize;       /**< Elements transformed per work-group by localKernel */
+        size_t         radixGroupSize;       /**< Work-group size for radixKernel */
+        cl_uint       numGlobalPasses;       /**< Launches needed for one transform */
         int
         iterations;       /**< Number of iterations for kernel execution */
         SDKDeviceInfo deviceInfo;        /**< Structure to store device information*/
@@ -76,10 +85,13 @@ class FastWalshTransform
         {
             seed = 123;
             length = 1024;
+            batch = 1;
             input = NULL;
             verificationInput = NULL;
             setupTime = 0;
             totalKernelTime = 0;
+            referenceKernelTime = 0;
+            hostKernelTime = 0;
             iterations = 1;
             sampleArgs = new CLCommandArgs() ;
             sampleTimer = new SDKTimer();
@@ -126,6 +138,17 @@ class FastWalshTransform
             cl_float * input,
             const cl_uint length);
 
+        /**
+         * Cache-blocked SSE implementation of inplace FastWalsh Transform.
+         * Stages with step < CPU_BLOCK_SIZE are applied block by block,
+         * the larger ones two at a time with radix-4 butterflies
+         * @param input input array which also stores the output
+         * @param length length of the array
+         */
+        void fastWalshTransformCPU(
+            cl_float * input,
+            const cl_uint length);
+
         /**
          * Override from SDKSample. Print sample stats.
          */
@@ -15,23 +15,119 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 ********************************************************************/
 
 /*
+ * Every butterfly stage of the transform combines elements at distance
+ * step and the stages commute, so any group of consecutive stages can be
+ * applied to a set of elements in any order.
  */
 
-__kernel 
-void fastWalshTransform(__global float * tArray,
-                        __const  int   step 
-                       )
+#define MAX_RADIX 16
+
+/**
+ * @brief   Applies all stages with step < 4 * get_local_size(0) to
+ *          consecutive blocks of 4 * get_local_size(0) elements in local
+ *          memory, two stages per barrier
+ * @param   tArray  vectors to transform, in place
+ * @param   block   local memory for 4 * get_local_size(0) elements
+ */
+__kernel
+void fastWalshTransformLocal(__global float * tArray,
+                             __local  float * block)
+{
+    uint lid = get_local_id(0);
+    uint localSize = get_local_size(0);
+    uint blockSize = 4 * localSize;
+    __global float *src = tArray + get_group_id(0) * blockSize;
+
+    for(uint i = lid; i < blockSize; i += localSize)
+    {
+        block[i] = src[i];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    uint step = 1;
+    for(; 4 * step <= blockSize; step <<= 2)
+    {
+        // radix-4 : stages step and 2 * step
+        uint base = (lid / step) * 4 * step + lid % step;
+        float a0 = block[base];
+        float a1 = block[base + step];
+        float a2 = block[base + 2 * step];
+        float a3 = block[base + 3 * step];
+
+        float t0 = a0 + a1;
+        float t1 = a0 - a1;
+        float t2 = a2 + a3;
+        float t3 = a2 - a3;
+
+        block[base]            = t0 + t2;
+        block[base + step]     = t1 + t3;
+        block[base + 2 * step] = t0 - t2;
+        block[base + 3 * step] = t1 - t3;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(step < blockSize)
+    {
+        // odd number of stages : one radix-2 stage, two pairs per work-item
+        for(uint pairId = lid; pairId < blockSize / 2; pairId += localSize)
+        {
+            uint pair = (pairId / step) * 2 * step + pairId % step;
+            float T1 = block[pair];
+            float T2 = block[pair + step];
+            block[pair]        = T1 + T2;
+            block[pair + step] = T1 - T2;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for(uint i = lid; i < blockSize; i += localSize)
+    {
+        src[i] = block[i];
+    }
+}
+
+/**
+ * @brief   Applies log2(radix) consecutive stages starting at step, each
+ *          work-item transforming radix elements at distance step in
+ *          registers. One launch replaces log2(radix) radix-2 launches
+ * @param   tArray  vectors to transform, in place
+ * @param   step    first stage of the pass
+ * @param   radix   number of elements per work-item, at most MAX_RADIX
+ * @param   length  length of each vector
+ */
+__kernel
+void fastWalshTransformRadix(__global float * tArray,
+                             const uint step,
+                             const uint radix,
+                             const uint length)
 {
-		unsigned int tid = get_global_id(0);
-		
-        const unsigned int group = tid%step;
-        const unsigned int pair  = 2*step*(tid/step) + group;
-
-        const unsigned int match = pair + step;
-        
-        float T1          = tArray[pair];
-        float T2          = tArray[match];
-       
-        tArray[pair]             = T1 + T2; 
-        tArray[match]            = T1 - T2;
+    uint tid = get_global_id(0);
+    __global float *vec = tArray + (size_t)get_global_id(1) * length;
+
+    uint base = (tid / step) * radix * step + tid % step;
+
+    float x[MAX_RADIX];
+    for(uint k = 0; k < radix; ++k)
+    {
+        x[k] = vec[base + k * step];
+    }
+
+    for(uint s = 1; s < radix; s <<= 1)
+    {
+        for(uint k = 0; k < radix; ++k)
+        {
+            if((k & s) == 0)
+            {
+                float T1 = x[k];
+                float T2 = x[k + s];
+                x[k]     = T1 + T2;
+                x[k + s] = T1 - T2;
+            }
+        }
+    }
+
+    for(uint k = 0; k < radix; ++k)
+    {
+        vec[base + k * step] = x[k];
+    }
 }
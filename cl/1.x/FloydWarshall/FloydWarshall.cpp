@@ -221,6 +221,30 @@ FloydWarshall::setupCL(void)
     kernel = clCreateKernel(program, "floydWarshallPass", &status);
     CHECK_OPENCL_ERROR(status, "clCreateKernel failed.");
 
+    persistentKernel = clCreateKernel(program, "floydWarshallPersistent",
+                                      &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (floydWarshallPersistent)");
+
+    status = clGetKernelWorkGroupInfo(persistentKernel,
+                                      devices[sampleArgs->deviceId],
+                                      CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t),
+                                      &persistentGroupSize, NULL);
+    CHECK_OPENCL_ERROR(status, "clGetKernelWorkGroupInfo failed.");
+    if(persistentGroupSize > 256)
+    {
+        persistentGroupSize = 256;
+    }
+
+    // The passes are issued by the batcher, see runCLKernels()
+    LaunchStrategy strategy;
+    if(LaunchProfile::parseStrategy(launchStrategy, strategy) != SDK_SUCCESS)
+    {
+        std::cout << "Unknown launch strategy " << launchStrategy << std::endl;
+        return SDK_FAILURE;
+    }
+    retValue = batcher.create(commandQueue, strategy);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "LaunchBatcher::create() failed");
+
     return SDK_SUCCESS;
 }
 
@@ -334,40 +358,48 @@ FloydWarshall::runCLKernels(void)
                             (void*)&numNodes);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (numNodes)");
 
-    for(cl_uint i = 0; i < numPasses; i += 1)
+    /*
+     * The passes only depend on each other, the batcher decides how often
+     * the host flushes and waits, or runs them all in one work-group
+     */
+    LaunchStrategy strategy = batcher.begin(numNodes * numNodes, true);
+    if(strategy == LAUNCH_PERSISTENT)
     {
-        /*
-         * Kernel needs which pass of the algorithm is running
-         * which is sent as the Fourth argument
-         */
-        status = clSetKernelArg(kernel,
-                                3,
-                                sizeof(cl_uint),
-                                (void*)&i);
-        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (pass)");
-
-
-        // Enqueue a kernel run call.
-
-        cl_event ndrEvt;
-        status = clEnqueueNDRangeKernel(commandQueue,
-                                        kernel,
-                                        2,
-                                        NULL,
-                                        globalThreads,
-                                        localThreads,
-                                        0,
-                                        NULL,
-                                        &ndrEvt);
+        status = clSetKernelArg(persistentKernel, 0, sizeof(cl_mem),
+                                (void*)&pathDistanceBuffer);
+        status |= clSetKernelArg(persistentKernel, 1, sizeof(cl_mem),
+                                 (void*)&pathBuffer);
+        status |= clSetKernelArg(persistentKernel, 2, sizeof(cl_uint),
+                                 (void*)&numNodes);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (persistentKernel)");
+
+        status = batcher.launch(persistentKernel, 1, &persistentGroupSize,
+                                &persistentGroupSize);
         CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
-
-        status = clFlush(commandQueue);
-        CHECK_OPENCL_ERROR(status, "clFlush failed.");
-
-        status = waitForEventAndRelease(&ndrEvt);
-        CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
+    }
+    else
+    {
+        for(cl_uint i = 0; i < numPasses; i += 1)
+        {
+            /*
+             * Kernel needs which pass of the algorithm is running
+             * which is sent as the Fourth argument
+             */
+            status = clSetKernelArg(kernel,
+                                    3,
+                                    sizeof(cl_uint),
+                                    (void*)&i);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (pass)");
+
+            // Enqueue a kernel run call.
+            status = batcher.launch(kernel, 2, globalThreads, localThreads);
+            CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+        }
     }
 
+    status = batcher.end();
+    CHECK_ERROR(status, SDK_SUCCESS, "LaunchBatcher::end() failed");
+
     // Enqueue readBuffer
     cl_event readEvt1;
     status = clEnqueueReadBuffer(commandQueue,
@@ -501,6 +533,19 @@ int FloydWarshall::initialize()
     sampleArgs->AddOption(num_iterations);
     delete num_iterations;
 
+    Option* launch_option = new Option;
+    CHECK_ALLOCATION(launch_option, "Memory allocation error.\n");
+
+    launch_option->_sVersion = "";
+    launch_option->_lVersion = "launch";
+    launch_option->_description =
+        "Launch strategy of the passes : sync, flush, batched, persistent or auto";
+    launch_option->_type = CA_ARG_STRING;
+    launch_option->_value = &launchStrategy;
+
+    sampleArgs->AddOption(launch_option);
+    delete launch_option;
+
     return SDK_SUCCESS;
 }
 
@@ -627,6 +672,7 @@ void FloydWarshall::printStats()
         stats[2] = toString(totalKernelTime, std::dec);
 
         printStatistics(strArray, stats, 3);
+        batcher.printStats();
     }
 }
 
@@ -638,6 +684,9 @@ int FloydWarshall::cleanup()
     status = clReleaseKernel(kernel);
     CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.");
 
+    status = clReleaseKernel(persistentKernel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed. (persistentKernel)");
+
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.");
 
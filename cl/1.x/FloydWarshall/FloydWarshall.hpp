@@ -30,6 +30,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <string.h>
 
 #include "CLUtil.hpp"
+#include "LaunchBatcher.hpp"
 
 using namespace appsdk;
 
@@ -72,6 +73,10 @@ class FloydWarshall
         blockSize;      /**< use local memory of size blockSize x blockSize */
         KernelWorkGroupInfo
         kernelInfo;/**< KernelWorkGroupInfo object to hold kernel properties */
+        cl_kernel         persistentKernel; /**< Every pass in one work-group */
+        size_t         persistentGroupSize; /**< Work-group size of persistentKernel */
+        LaunchBatcher              batcher; /**< Issues the passes */
+        std::string         launchStrategy; /**< Strategy name given with --launch */
         SDKTimer    *sampleTimer;      /**< SDKTimer object */
 
     public:
@@ -94,6 +99,8 @@ class FloydWarshall
             totalKernelTime = 0;
             iterations = 1;
             blockSize = 16;
+            persistentGroupSize = 0;
+            launchStrategy = "auto";
             sampleArgs = new CLCommandArgs() ;
             sampleTimer = new SDKTimer();
             sampleArgs->sampleVerStr = SAMPLE_VERSION;
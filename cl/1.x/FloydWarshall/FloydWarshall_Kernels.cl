@@ -66,3 +66,39 @@ void floydWarshallPass(__global uint * pathDistanceBuffer,
     }
 }
 
+
+/*!
+ * All the passes of floydWarshallPass in a single work-group, for graphs
+ * small enough that a launch per pass costs more than the pass itself.
+ * Row k and column k do not change in pass k, so the elements of a pass
+ * can be updated in any order, the barrier orders the passes.
+ */
+
+__kernel
+void floydWarshallPersistent(__global uint * pathDistanceBuffer,
+                             __global uint * pathBuffer,
+                             const unsigned int numNodes)
+{
+    uint localId = get_local_id(0);
+    uint localSize = get_local_size(0);
+    uint numElements = numNodes * numNodes;
+
+    for(uint k = 0; k < numNodes; k++)
+    {
+        for(uint i = localId; i < numElements; i += localSize)
+        {
+            uint yValue = i / numNodes;
+            uint xValue = i - yValue * numNodes;
+
+            int oldWeight = pathDistanceBuffer[yValue * numNodes + xValue];
+            int tempWeight = (pathDistanceBuffer[yValue * numNodes + k] + pathDistanceBuffer[k * numNodes + xValue]);
+
+            if (tempWeight < oldWeight)
+            {
+                pathDistanceBuffer[yValue * numNodes + xValue] = tempWeight;
+                pathBuffer[yValue * numNodes + xValue] = k;
+            }
+        }
+        barrier(CLK_GLOBAL_MEM_FENCE);
+    }
+}
@@ -20,19 +20,26 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <GL/glut.h>
 #include <cmath>
 #include <malloc.h>
+#include <vector>
+#include <emmintrin.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 // Directions
 double e[9][2] = {{0,0}, {1,0}, {0,1}, {-1,0}, {0,-1}, {1,1}, {-1,1}, {-1,-1}, {1,-1}};
 
+// Opposite directions
+int opp[9] = {0, 3, 4, 1, 2, 7, 8, 5, 6};
+
 // Weights
 cl_double w[9] = {4.0 / 9.0, 1.0 / 9.0, 1.0 / 9.0, 1.0 / 9.0, 1.0 / 9.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0};
 
 // Omega
 const double omega = 1.2f;
 
-// Verify flag
-bool verifyFlag = 0;
-
 FluidSimulation2D* me;           /**< Pointing to FluidSimulation2D class */
 cl_bool display;
 GLuint texnum;
@@ -47,6 +54,36 @@ int drawParticles = 1;
 int frames = 0;
 int t0 = 0, te;
 
+/**
+ * Rows of the lattice updated by one host thread in one time step
+ */
+struct LBMThreadData
+{
+    cl_double* f;                       /**< distributions, SoA */
+    const cl_uchar* type;               /**< cell types */
+    int width;
+    int height;
+    int odd;                            /**< parity of the time step */
+    int rowBegin;
+    int rowEnd;
+};
+
+static size_t roundUp(size_t value, size_t multiple)
+{
+    return ((value + multiple - 1) / multiple) * multiple;
+}
+
+static int numCPUCores()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return (int)systemInfo.dwNumberOfProcessors;
+#else
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
 // Calculates equivalent distribution
 double computefEq(cl_double weight, double dir[2], double rho,
                   cl_double2 velocity)
@@ -57,6 +94,229 @@ double computefEq(cl_double weight, double dir[2], double rho,
     return rho * weight * (1.0 + 3.0 * eu + 4.5 * eu * eu - 1.5 * u2);
 }
 
+/*
+* Slots of the populations arriving at (x, y), same rule as the kernel
+*/
+static void siteSlots(const LBMThreadData* d, int x, int y, size_t slot[9])
+{
+    size_t sites = (size_t)d->width * d->height;
+    size_t pos = x + (size_t)d->width * y;
+    for(int q = 0; q < 9; ++q)
+    {
+        int sx = x - (int)e[q][0];
+        int sy = y - (int)e[q][1];
+        if(d->odd && sx >= 0 && sx < d->width && sy >= 0 && sy < d->height)
+        {
+            slot[q] = opp[q] * sites + sx + (size_t)d->width * sy;
+        }
+        else
+        {
+            slot[q] = q * sites + pos;
+        }
+    }
+}
+
+/*
+* One site, used on the edges of the lattice and the row tails
+*/
+static void updateSite(const LBMThreadData* d, int x, int y)
+{
+    size_t slot[9];
+    siteSlots(d, x, y, slot);
+
+    double fin[9], fout[9];
+    for(int q = 0; q < 9; ++q)
+    {
+        fin[q] = d->f[slot[q]];
+    }
+
+    if(d->type[x + (size_t)d->width * y])
+    {
+        for(int q = 0; q < 9; ++q)
+        {
+            fout[q] = fin[opp[q]];
+        }
+    }
+    else
+    {
+        cl_double2 vel;
+        double rho = 0;
+        vel.s[0] = vel.s[1] = 0;
+        for(int q = 0; q < 9; ++q)
+        {
+            rho += fin[q];
+            vel.s[0] += e[q][0] * fin[q];
+            vel.s[1] += e[q][1] * fin[q];
+        }
+        vel.s[0] /= rho;
+        vel.s[1] /= rho;
+
+        for(int q = 0; q < 9; ++q)
+        {
+            fout[q] = (1 - omega) * fin[q] + omega * computefEq(w[q], e[q], rho, vel);
+        }
+    }
+
+    for(int q = 0; q < 9; ++q)
+    {
+        d->f[slot[opp[q]]] = fout[q];
+    }
+}
+
+/*
+* Two neighbouring interior sites (x, y) and (x + 1, y) with SSE2.
+* Away from the edges the slots of both sites are adjacent in every array,
+* boundary cells are blended in with a mask.
+*/
+static void updatePair(const LBMThreadData* d, int x, int y)
+{
+    size_t sites = (size_t)d->width * d->height;
+    size_t pos = x + (size_t)d->width * y;
+
+    cl_double* src[9];
+    for(int q = 0; q < 9; ++q)
+    {
+        src[q] = d->odd
+                 ? d->f + opp[q] * sites + pos - (int)e[q][0] - d->width * (int)e[q][1]
+                 : d->f + q * sites + pos;
+    }
+
+    __m128d fin[9];
+    for(int q = 0; q < 9; ++q)
+    {
+        fin[q] = _mm_loadu_pd(src[q]);
+    }
+
+    __m128d rho = _mm_setzero_pd();
+    __m128d ux = _mm_setzero_pd();
+    __m128d uy = _mm_setzero_pd();
+    for(int q = 0; q < 9; ++q)
+    {
+        rho = _mm_add_pd(rho, fin[q]);
+        ux = _mm_add_pd(ux, _mm_mul_pd(_mm_set1_pd(e[q][0]), fin[q]));
+        uy = _mm_add_pd(uy, _mm_mul_pd(_mm_set1_pd(e[q][1]), fin[q]));
+    }
+    ux = _mm_div_pd(ux, rho);
+    uy = _mm_div_pd(uy, rho);
+    __m128d u2 = _mm_add_pd(_mm_mul_pd(ux, ux), _mm_mul_pd(uy, uy));
+
+    const cl_uchar* t = d->type + pos;
+    __m128d boundary = _mm_castsi128_pd(_mm_set_epi64x(t[1] ? -1 : 0,
+                                        t[0] ? -1 : 0));
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d keep = _mm_set1_pd(1 - omega);
+    __m128d relax = _mm_set1_pd(omega);
+
+    for(int q = 0; q < 9; ++q)
+    {
+        __m128d eu = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(e[q][0]), ux),
+                                _mm_mul_pd(_mm_set1_pd(e[q][1]), uy));
+        __m128d poly = _mm_add_pd(one, _mm_mul_pd(_mm_set1_pd(3.0), eu));
+        poly = _mm_add_pd(poly, _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(4.5), eu), eu));
+        poly = _mm_sub_pd(poly, _mm_mul_pd(_mm_set1_pd(1.5), u2));
+        __m128d fEq = _mm_mul_pd(_mm_mul_pd(rho, _mm_set1_pd(w[q])), poly);
+        __m128d fluid = _mm_add_pd(_mm_mul_pd(keep, fin[q]), _mm_mul_pd(relax, fEq));
+        __m128d fout = _mm_or_pd(_mm_and_pd(boundary, fin[opp[q]]),
+                                 _mm_andnot_pd(boundary, fluid));
+        _mm_storeu_pd(src[opp[q]], fout);
+    }
+}
+
+void* lbmHostThread(void* data)
+{
+    const LBMThreadData* d = (const LBMThreadData*)data;
+    for(int y = d->rowBegin; y < d->rowEnd; ++y)
+    {
+        if(y == 0 || y == d->height - 1)
+        {
+            for(int x = 0; x < d->width; ++x)
+            {
+                updateSite(d, x, y);
+            }
+            continue;
+        }
+
+        updateSite(d, 0, y);
+        int x = 1;
+        for(; x + 1 < d->width - 1; x += 2)
+        {
+            updatePair(d, x, y);
+        }
+        for(; x < d->width; ++x)
+        {
+            updateSite(d, x, y);
+        }
+    }
+    return NULL;
+}
+
+/*
+* Checkpoint streams: every double is XORed with its predecessor in the
+* same array and only the bytes up to the highest non-zero one are kept.
+* A header byte holds the byte counts of two values.
+*/
+static void compressDoubles(const cl_double* values, size_t count,
+                            std::vector<cl_uchar>& out)
+{
+    cl_ulong prev = 0;
+    for(size_t i = 0; i < count; i += 2)
+    {
+        cl_ulong x[2] = {0, 0};
+        int bytes[2] = {0, 0};
+        for(int k = 0; k < 2 && i + k < count; ++k)
+        {
+            cl_ulong bits;
+            memcpy(&bits, values + i + k, sizeof(bits));
+            x[k] = bits ^ prev;
+            prev = bits;
+            for(cl_ulong v = x[k]; v != 0; v >>= 8)
+            {
+                bytes[k]++;
+            }
+        }
+
+        out.push_back((cl_uchar)(bytes[0] | (bytes[1] << 4)));
+        for(int k = 0; k < 2; ++k)
+        {
+            for(int b = 0; b < bytes[k]; ++b)
+            {
+                out.push_back((cl_uchar)(x[k] >> (8 * b)));
+            }
+        }
+    }
+}
+
+static bool decompressDoubles(const cl_uchar* in, size_t size,
+                              cl_double* values, size_t count)
+{
+    cl_ulong prev = 0;
+    size_t p = 0;
+    for(size_t i = 0; i < count; i += 2)
+    {
+        if(p >= size)
+        {
+            return false;
+        }
+        int bytes[2] = {in[p] & 0xf, in[p] >> 4};
+        p++;
+        for(int k = 0; k < 2 && i + k < count; ++k)
+        {
+            if(bytes[k] > 8 || p + bytes[k] > size)
+            {
+                return false;
+            }
+            cl_ulong x = 0;
+            for(int b = 0; b < bytes[k]; ++b)
+            {
+                x |= (cl_ulong)in[p++] << (8 * b);
+            }
+            prev ^= x;
+            memcpy(values + i + k, &prev, sizeof(prev));
+        }
+    }
+    return p == size;
+}
+
 // Returns the velocity at (x, y) location relative to lattice
 cl_double2 FluidSimulation2D::getVelocity(int x, int y)
 {
@@ -87,13 +347,15 @@ void FluidSimulation2D::setUOutput(int x, int y, double v[2])
 {
     double rho, uu[2];
 
-    int pos = x + dims[0] * y;
+    size_t sites = (size_t)dims[0] * dims[1];
+    size_t pos = x + (size_t)dims[0] * y;
 
     // Calculate density from input distribution
-    rho = h_of0[pos] + h_of1234[pos * 4 + 0] +  h_of1234[pos * 4 + 1] +
-          h_of1234[pos * 4 + 2] + h_of1234[pos * 4 + 3] +
-          h_of5678[pos * 4 + 0] + h_of5678[pos * 4 + 1] + h_of5678[pos * 4 + 2] +
-          h_of5678[pos * 4 + 3];
+    rho = 0;
+    for(int q = 0; q < LBQ; ++q)
+    {
+        rho += h_f[q * sites + pos];
+    }
 
     uu[0] = u[pos].s[0];
     uu[1] = u[pos].s[1];
@@ -107,16 +369,10 @@ void FluidSimulation2D::setUOutput(int x, int y, double v[2])
     newVel.s[1] = uu[1];
 
     // Calculate new distribution based on input speed
-    h_if0[pos] = computefEq(w[0], e[0], rho, newVel);
-    h_if1234[pos * 4 + 0] = computefEq(w[1], e[1], rho, newVel);
-    h_if1234[pos * 4 + 1] = computefEq(w[2], e[2], rho, newVel);
-    h_if1234[pos * 4 + 2] = computefEq(w[3], e[3], rho, newVel);
-    h_if1234[pos * 4 + 3] = computefEq(w[4], e[4], rho, newVel);
-
-    h_if5678[pos * 4 + 0] = computefEq(w[5], e[5], rho, newVel);
-    h_if5678[pos * 4 + 1] = computefEq(w[6], e[6], rho, newVel);
-    h_if5678[pos * 4 + 2] = computefEq(w[7], e[7], rho, newVel);
-    h_if5678[pos * 4 + 3] = computefEq(w[8], e[8], rho, newVel);
+    for(int q = 0; q < LBQ; ++q)
+    {
+        h_f[q * sites + pos] = computefEq(w[q], e[q], rho, newVel);
+    }
 }
 
 
@@ -136,28 +392,23 @@ void FluidSimulation2D::reset()
     cl_double2 u0;
     u0.s[0] = u0.s[1] = 0.0f;
 
+    size_t sites = (size_t)dims[0] * dims[1];
+
     for (int y = 0; y < dims[1]; y++)
     {
         for (int x = 0; x < dims[0]; x++)
         {
-            int pos = x + y * dims[0];
+            size_t pos = x + (size_t)y * dims[0];
 
             double den = 10.0f;
 
             // Initialize the velocity buffer
             u[pos] = u0;
 
-            //rho[pos] = 10.0f;
-            h_if0[pos] = computefEq(w[0], e[0], den, u0);
-            h_if1234[pos * 4 + 0] = computefEq(w[1], e[1], den, u0);
-            h_if1234[pos * 4 + 1] = computefEq(w[2], e[2], den, u0);
-            h_if1234[pos * 4 + 2] = computefEq(w[3], e[3], den, u0);
-            h_if1234[pos * 4 + 3] = computefEq(w[4], e[4], den, u0);
-
-            h_if5678[pos * 4 + 0] = computefEq(w[5], e[5], den, u0);
-            h_if5678[pos * 4 + 1] = computefEq(w[6], e[6], den, u0);
-            h_if5678[pos * 4 + 2] = computefEq(w[7], e[7], den, u0);
-            h_if5678[pos * 4 + 3] = computefEq(w[8], e[8], den, u0);
+            for(int q = 0; q < LBQ; ++q)
+            {
+                h_f[q * sites + pos] = computefEq(w[q], e[q], den, u0);
+            }
 
             // Initialize boundary cells
             if (x == 0 || x == (dims[0] - 1) || y == 0 || y == (dims[1] - 1))
@@ -178,61 +429,168 @@ void FluidSimulation2D::reset()
 int
 FluidSimulation2D::setupFluidSimulation2D()
 {
+    if(cpuThreads <= 0)
+    {
+        cpuThreads = numCPUCores();
+    }
 
-    size_t temp = dims[0] * dims[1];
+    if(!restartFile.empty())
+    {
+        // Grid size and time step come from the checkpoint
+        if(readCheckpoint(restartFile) != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+    }
+    else
+    {
+        if(dims[0] < 3 || dims[1] < 3)
+        {
+            std::cout << "Error: width and height must be at least 3" << std::endl;
+            return SDK_FAILURE;
+        }
 
-    // Allocate memory for host buffers
-    h_if0 = (cl_double*)malloc(sizeof(cl_double) * temp);
-    CHECK_ALLOCATION(h_if0, "Memory allocation failed(h_if0)");
+        size_t temp = (size_t)dims[0] * dims[1];
 
-    h_if1234 = (cl_double*)malloc(sizeof(cl_double4) * temp);
-    CHECK_ALLOCATION(h_if0, "Memory allocation failed(h_if1324)");
+        // Allocate memory for host buffers
+        h_f = (cl_double*)malloc(sizeof(cl_double) * LBQ * temp);
+        CHECK_ALLOCATION(h_f, "Memory allocation failed(h_f)");
 
-    h_if5678 = (cl_double*)malloc(sizeof(cl_double4) * temp);
-    CHECK_ALLOCATION(h_if0, "Memory allocation failed(h_if5678)");
+        h_type = (cl_uchar*)malloc(sizeof(cl_uchar) * temp);
+        CHECK_ALLOCATION(h_type, "Memory allocation failed(h_type)");
+    }
 
-    h_of0 = (cl_double*)malloc(sizeof(cl_double) * temp);
-    CHECK_ALLOCATION(h_if0, "Memory allocation failed(h_of0)");
+    size_t temp = (size_t)dims[0] * dims[1];
 
-    h_of1234 = (cl_double*)malloc(sizeof(cl_double4) * temp);
-    CHECK_ALLOCATION(h_if0, "Memory allocation failed(h_of1234)");
+    u = (cl_double2*)malloc(sizeof(cl_double2) * temp);
+    CHECK_ALLOCATION(u, "Memory allocation failed(u)");
 
-    h_of5678 = (cl_double*)malloc(sizeof(cl_double4) * temp);
-    CHECK_ALLOCATION(h_if0, "Memory allocation failed(h_of5678)");
+    if(restartFile.empty())
+    {
+        reset();
+    }
+    else
+    {
+        memset(u, 0, sizeof(cl_double2) * temp);
+    }
+    startStep = stepsDone;
 
     if(sampleArgs->verify)
     {
-        v_of0 = (cl_double*)malloc(sizeof(cl_double) * temp);
-        CHECK_ALLOCATION(h_if0, "Memory allocation failed(v_of0)");
+        // Initial state for the host engine
+        v_f = (cl_double*)malloc(sizeof(cl_double) * LBQ * temp);
+        CHECK_ALLOCATION(v_f, "Memory allocation failed(v_f)");
+        memcpy(v_f, h_f, sizeof(cl_double) * LBQ * temp);
+    }
 
-        v_of1234 = (cl_double*)malloc(sizeof(cl_double4) * temp);
-        CHECK_ALLOCATION(h_if0, "Memory allocation failed(v_of1234)");
+    return SDK_SUCCESS;
+}
 
-        v_of5678 = (cl_double*)malloc(sizeof(cl_double4) * temp);
-        CHECK_ALLOCATION(h_if0, "Memory allocation failed(v_of5678)");
+int
+FluidSimulation2D::writeCheckpoint(std::string fileName)
+{
+    size_t sites = (size_t)dims[0] * dims[1];
 
-        v_ef0 = (cl_double*)malloc(sizeof(cl_double) * temp);
-        CHECK_ALLOCATION(h_if0, "Memory allocation failed(v_ef0)");
+    FILE* fp = fopen(fileName.c_str(), "wb");
+    if(fp == NULL)
+    {
+        std::cout << "Failed to open checkpoint " << fileName << std::endl;
+        return SDK_FAILURE;
+    }
 
-        v_ef1234 = (cl_double*)malloc(sizeof(cl_double4) * temp);
-        CHECK_ALLOCATION(h_if0, "Memory allocation failed(v_ef1234)");
+    cl_uint header[5] = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION,
+                         (cl_uint)dims[0], (cl_uint)dims[1], (cl_uint)stepsDone
+                        };
+    cl_double omegaValue = omega;
+    bool ok = fwrite(header, sizeof(header), 1, fp) == 1
+              && fwrite(&omegaValue, sizeof(omegaValue), 1, fp) == 1
+              && fwrite(h_type, sizeof(cl_uchar), sites, fp) == sites;
+    checkpointBytes = sizeof(header) + sizeof(omegaValue) + sites;
+
+    std::vector<cl_uchar> stream;
+    for(int q = 0; q < LBQ && ok; ++q)
+    {
+        stream.clear();
+        compressDoubles(h_f + q * sites, sites, stream);
+        cl_ulong size = stream.size();
+        ok = fwrite(&size, sizeof(size), 1, fp) == 1
+             && fwrite(&stream[0], 1, stream.size(), fp) == stream.size();
+        checkpointBytes += sizeof(size) + stream.size();
+    }
 
-        v_ef5678 = (cl_double*)malloc(sizeof(cl_double4) * temp);
-        CHECK_ALLOCATION(h_if0, "Memory allocation failed(v_ef5678)");
+    if(fclose(fp) != 0 || !ok)
+    {
+        std::cout << "Failed to write checkpoint " << fileName << std::endl;
+        return SDK_FAILURE;
+    }
+    return SDK_SUCCESS;
+}
+
+int
+FluidSimulation2D::readCheckpoint(std::string fileName)
+{
+    FILE* fp = fopen(fileName.c_str(), "rb");
+    if(fp == NULL)
+    {
+        std::cout << "Failed to open checkpoint " << fileName << std::endl;
+        return SDK_FAILURE;
+    }
+
+    cl_uint header[5];
+    cl_double omegaValue;
+    if(fread(header, sizeof(header), 1, fp) != 1
+            || fread(&omegaValue, sizeof(omegaValue), 1, fp) != 1
+            || header[0] != CHECKPOINT_MAGIC || header[1] != CHECKPOINT_VERSION
+            || header[2] < 3 || header[3] < 3)
+    {
+        fclose(fp);
+        std::cout << "Error: " << fileName << " is not a valid checkpoint" << std::endl;
+        return SDK_FAILURE;
     }
 
+    if(omegaValue != omega)
+    {
+        std::cout << "Warning: checkpoint was written with omega = "
+                  << omegaValue << std::endl;
+    }
 
-    h_type = (cl_bool*)malloc(sizeof(cl_bool) * temp);
-    CHECK_ALLOCATION(h_if0, "Memory allocation failed(h_type)");
+    dims[0] = (int)header[2];
+    dims[1] = (int)header[3];
+    stepsDone = (int)header[4];
+    size_t sites = (size_t)dims[0] * dims[1];
 
-    rho = (cl_double*)malloc(sizeof(cl_double) * temp);
-    CHECK_ALLOCATION(h_if0, "Memory allocation failed(rho)");
+    h_f = (cl_double*)malloc(sizeof(cl_double) * LBQ * sites);
+    h_type = (cl_uchar*)malloc(sizeof(cl_uchar) * sites);
+    if(h_f == NULL || h_type == NULL)
+    {
+        fclose(fp);
+        std::cout << "Memory allocation failed(checkpoint)" << std::endl;
+        return SDK_FAILURE;
+    }
 
-    u = (cl_double2*)malloc(sizeof(cl_double2) * temp);
-    CHECK_ALLOCATION(h_if0, "Memory allocation failed(u)");
+    bool ok = fread(h_type, sizeof(cl_uchar), sites, fp) == sites;
 
-    reset();
+    std::vector<cl_uchar> stream;
+    for(int q = 0; q < LBQ && ok; ++q)
+    {
+        cl_ulong size;
+        ok = fread(&size, sizeof(size), 1, fp) == 1
+             && size <= 17 * sites;
+        if(ok)
+        {
+            stream.resize((size_t)size + 1);
+            ok = fread(&stream[0], 1, (size_t)size, fp) == size
+                 && decompressDoubles(&stream[0], (size_t)size, h_f + q * sites, sites);
+        }
+    }
+    fclose(fp);
 
+    if(!ok)
+    {
+        std::cout << "Error: checkpoint " << fileName << " is truncated or corrupt"
+                  << std::endl;
+        return SDK_FAILURE;
+    }
     return SDK_SUCCESS;
 }
 
@@ -341,104 +699,22 @@ FluidSimulation2D::setupCL()
         }
     }
 
+    size_t temp = (size_t)dims[0] * dims[1];
+    if(sizeof(cl_double) * LBQ * temp > deviceInfo.maxMemAllocSize)
+    {
+        OPENCL_EXPECTED_ERROR("Unsupported: Lattice does not fit in a single device allocation!");
+    }
 
     /*
     * Create and initialize memory objects
     */
 
-    size_t temp = dims[0] * dims[1];
-    d_if0 = clCreateBuffer(context,
-                           CL_MEM_READ_WRITE,
-                           sizeof(cl_double) * temp,
-                           0,
-                           &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (d_if0)");
-
-    status = clEnqueueWriteBuffer(commandQueue,
-                                  d_if0,
-                                  1,
-                                  0,
-                                  sizeof(cl_double) * temp,
-                                  h_if0,
-                                  0, 0, 0);
-    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_if0)");
-
-    d_if1234 = clCreateBuffer(context,
-                              CL_MEM_READ_WRITE,
-                              sizeof(cl_double4) * temp,
-                              0,
-                              &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (d_if1234)");
-
-    status = clEnqueueWriteBuffer(commandQueue,
-                                  d_if1234,
-                                  1,
-                                  0,
-                                  sizeof(cl_double4) * temp,
-                                  h_if1234,
-                                  0, 0, 0);
-    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_if1234)");
-
-    d_if5678 = clCreateBuffer(context,
-                              CL_MEM_READ_WRITE,
-                              sizeof(cl_double4) * temp,
-                              0,
-                              &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (d_if5678)");
-
-    status = clEnqueueWriteBuffer(commandQueue,
-                                  d_if5678,
-                                  1,
-                                  0,
-                                  sizeof(cl_double4) * temp,
-                                  h_if5678,
-                                  0, 0, 0);
-    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_if5678)");
-
-    d_of0 = clCreateBuffer(context,
-                           CL_MEM_READ_WRITE,
-                           sizeof(cl_double) * temp,
-                           0,
-                           &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (d_of0)");
-
-    d_of1234 = clCreateBuffer(context,
-                              CL_MEM_READ_WRITE,
-                              sizeof(cl_double4) * temp,
-                              0,
-                              &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (d_of1234)");
-
-    d_of5678 = clCreateBuffer(context,
-                              CL_MEM_READ_WRITE,
-                              sizeof(cl_double4) * temp,
-                              0,
-                              &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (d_of5678)");
-
-    status = clEnqueueCopyBuffer(commandQueue,
-                                 d_if0,
-                                 d_of0,
-                                 0, 0, sizeof(cl_double) * temp,
-                                 0, 0, 0);
-    CHECK_OPENCL_ERROR(status, "clEnqueueCopyBuffer failed. (d_if0->d_of0)");
-
-    status = clEnqueueCopyBuffer(commandQueue,
-                                 d_if1234,
-                                 d_of1234,
-                                 0, 0, sizeof(cl_double4) * temp,
-                                 0, 0, 0);
-    CHECK_OPENCL_ERROR(status, "clEnqueueCopyBuffer failed. (d_if1234->d_of1234)");
-
-    status = clEnqueueCopyBuffer(commandQueue,
-                                 d_if5678,
-                                 d_of5678,
-                                 0, 0, sizeof(cl_double4) * temp,
-                                 0, 0, 0);
-    CHECK_OPENCL_ERROR(status, "clEnqueueCopyBuffer failed. (d_if5678->d_of5678)");
-
-    status = clFinish(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFinish failed.");
+    d_f = clCreateBuffer(context,
+                         CL_MEM_READ_WRITE,
+                         sizeof(cl_double) * LBQ * temp,
+                         0,
+                         &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (d_f)");
 
     // Set Presistent memory only for AMD platform
     cl_mem_flags inMemFlags = CL_MEM_READ_ONLY;
@@ -450,25 +726,11 @@ FluidSimulation2D::setupCL()
     //Constant arrays
     type = clCreateBuffer(context,
                           inMemFlags,
-                          sizeof(cl_bool) * temp,
+                          sizeof(cl_uchar) * temp,
                           0,
                           &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (type)");
 
-    weight = clCreateBuffer(context,
-                            CL_MEM_READ_ONLY,
-                            sizeof(cl_double) * 9,
-                            0,
-                            &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (weight)");
-
-    status = clEnqueueWriteBuffer(commandQueue,
-                                  weight,
-                                  1, 0, sizeof(cl_double) * 9,
-                                  w,
-                                  0, 0, 0);
-    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (weight)");
-
     velocity = clCreateBuffer(context,
                               CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
                               sizeof(cl_double2) * temp,
@@ -480,7 +742,7 @@ FluidSimulation2D::setupCL()
     buildData.kernelName = std::string("FluidSimulation2D_Kernels.cl");
     buildData.devices = devices;
     buildData.deviceId = sampleArgs->deviceId;
-    buildData.flagsStr = std::string("");
+    buildData.flagsStr = buildOptions;
     if(sampleArgs->isLoadBinaryEnabled())
     {
         buildData.binaryName = std::string(sampleArgs->loadBinary.c_str());
@@ -510,27 +772,13 @@ FluidSimulation2D::setupCLKernels()
 {
     cl_int status;
 
-    // Set appropriate arguments to the kernel
-
-    // initialize direction buffer
-    for(int i = 0; i < 8; i++)
-    {
-        dirX.s[i] = e[i + 1][0];
-        dirY.s[i] = e[i + 1][1];
-    }
-
-    // Set kernel arguments
-    status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_if0);
-    status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_of0);
-    status |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_if1234);
-    status |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &d_of1234);
-    status |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &d_if5678);
-    status |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &d_of5678);
-    status |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &type);
-    status |= clSetKernelArg(kernel, 7, sizeof(cl_double8), &dirX);
-    status |= clSetKernelArg(kernel, 8, sizeof(cl_double8), &dirY);
-    status |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &weight);
-    status |= clSetKernelArg(kernel, 10, sizeof(cl_double), &omega);
+    // Set the arguments that do not change between time steps
+    status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_f);
+    status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &type);
+    status |= clSetKernelArg(kernel, 2, sizeof(cl_int), &dims[0]);
+    status |= clSetKernelArg(kernel, 3, sizeof(cl_int), &dims[1]);
+    status |= clSetKernelArg(kernel, 4, sizeof(cl_double), &omega);
+    status |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &velocity);
 
     CHECK_OPENCL_ERROR(status, "clSetKernelArgs failed.");
 
@@ -560,473 +808,253 @@ FluidSimulation2D::setupCLKernels()
 }
 
 int
-FluidSimulation2D::runCLKernels()
+FluidSimulation2D::writeState()
 {
     cl_int status;
-    static int i = 1;
-    size_t temp = dims[0] * dims[1];
-
-    //Enqueue write data to device
+    size_t temp = (size_t)dims[0] * dims[1];
 
-    // Write the cell type data each frame
+    // Write the cell type data and the distributions
     cl_event typeEvt;
     status = clEnqueueWriteBuffer(commandQueue,
                                   type,
                                   CL_FALSE,
                                   0,
-                                  sizeof(cl_bool) * temp,
+                                  sizeof(cl_uchar) * temp,
                                   h_type,
                                   0, 0, &typeEvt);
     CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (h_type)");
 
+    cl_event inWriteEvt;
+    status = clEnqueueWriteBuffer(commandQueue,
+                                  d_f,
+                                  CL_FALSE,
+                                  0,
+                                  sizeof(cl_double) * LBQ * temp,
+                                  h_f,
+                                  0, 0, &inWriteEvt);
+    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_f)");
+
     status = clFlush(commandQueue);
     CHECK_OPENCL_ERROR(status, "clFlush failed.");
 
     status = waitForEventAndRelease(&typeEvt);
     CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(typeEvt) Failed");
 
-    cl_event inWriteEvt1;
-    cl_event inWriteEvt2;
-    cl_event inWriteEvt3;
-    // If odd frame (starts from odd frame)
-    // Then inputs : d_if0, d_if1234, d_if5678
-    // Outputs : d_of0, f_of1234, d_of5678
-    // Else they are swapped
-    if(i % 2)
-    {
-        status = clEnqueueWriteBuffer(commandQueue,
-                                      d_if0,
-                                      CL_FALSE,
-                                      0,
-                                      sizeof(cl_double) * temp,
-                                      h_if0,
-                                      0, 0, &inWriteEvt1);
-        CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_if0)");
-
-        status = clEnqueueWriteBuffer(commandQueue,
-                                      d_if1234,
-                                      CL_FALSE,
-                                      0,
-                                      sizeof(cl_double4) * temp,
-                                      h_if1234,
-                                      0, 0, &inWriteEvt2);
-        CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_if1234)");
-
-        status = clEnqueueWriteBuffer(commandQueue,
-                                      d_if5678,
-                                      CL_FALSE,
-                                      0,
-                                      sizeof(cl_double4) * temp,
-                                      h_if5678,
-                                      0, 0, &inWriteEvt3);
-        CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_if5678)");
-    }
-    else
-    {
-        status = clEnqueueWriteBuffer(commandQueue,
-                                      d_of0,
-                                      CL_FALSE,
-                                      0,
-                                      sizeof(cl_double) * temp,
-                                      h_if0,
-                                      0, 0, &inWriteEvt1);
-        CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_of0)");
-
-        status = clEnqueueWriteBuffer(commandQueue,
-                                      d_of1234,
-                                      CL_FALSE,
-                                      0,
-                                      sizeof(cl_double4) * temp,
-                                      h_if1234,
-                                      0, 0, &inWriteEvt2);
-        CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_of1234)");
-
-        status = clEnqueueWriteBuffer(commandQueue,
-                                      d_of5678,
-                                      CL_FALSE,
-                                      0,
-                                      sizeof(cl_double4) * temp,
-                                      h_if5678,
-                                      0, 0, &inWriteEvt3);
-        CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (d_of5678)");
-    }
-
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.");
-
-    status = waitForEventAndRelease(&inWriteEvt1);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(inWriteEvt1) Failed");
-
-    status = waitForEventAndRelease(&inWriteEvt2);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(inWriteEvt2) Failed");
+    status = waitForEventAndRelease(&inWriteEvt);
+    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(inWriteEvt) Failed");
 
-    status = waitForEventAndRelease(&inWriteEvt3);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(inWriteEvt3) Failed");
-
-    // Set kernel arguments
-    status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_if0);
-    status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_of0);
-    status |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_if1234);
-    status |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &d_of1234);
-    status |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &d_if5678);
-    status |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &d_of5678);
-    status |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &type);
-    status |= clSetKernelArg(kernel, 7, sizeof(cl_double8), &dirX);
-    status |= clSetKernelArg(kernel, 8, sizeof(cl_double8), &dirY);
-    status |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &weight);
-    status |= clSetKernelArg(kernel, 10, sizeof(cl_double), &omega);
-    status |= clSetKernelArg(kernel, 11, sizeof(cl_mem), &velocity);
-
-    CHECK_OPENCL_ERROR(status, "clSetKernelArgs failed.)");
-
-    size_t localThreads[2] = {groupSize, 1};
-    size_t globalThreads[2] = {dims[0], dims[1]};
-
-    status = clEnqueueNDRangeKernel(commandQueue,
-                                    kernel,
-                                    2,
-                                    0,
-                                    globalThreads,
-                                    localThreads,
-                                    0, 0, 0);
-    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.)");
+    return SDK_SUCCESS;
+}
 
-    status = clFinish(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFinish failed.");
+int
+FluidSimulation2D::readState(bool readVelocity)
+{
+    cl_int status;
+    size_t temp = (size_t)dims[0] * dims[1];
 
     cl_event velocityEvt;
-    status = clEnqueueReadBuffer(commandQueue,
-                                 velocity,
-                                 CL_FALSE,
-                                 0,
-                                 sizeof(cl_double2) * temp,
-                                 u,
-                                 0, 0, &velocityEvt);
-    CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(velocity)");
-
-    cl_event outReadEvt1;
-    cl_event outReadEvt2;
-    cl_event outReadEvt3;
-    //Read back the data into host buffer
-    if(i % 2)
+    if(readVelocity)
     {
         status = clEnqueueReadBuffer(commandQueue,
-                                     d_of0,
-                                     CL_FALSE,
-                                     0,
-                                     sizeof(cl_double) * temp,
-                                     h_of0,
-                                     0, 0, &outReadEvt1);
-        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(d_of0)");
-
-        status = clEnqueueReadBuffer(commandQueue,
-                                     d_of1234,
-                                     CL_FALSE,
-                                     0,
-                                     sizeof(cl_double4) * temp,
-                                     h_of1234,
-                                     0, 0, &outReadEvt2);
-        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(d_of1234)");
-
-        status = clEnqueueReadBuffer(commandQueue,
-                                     d_of5678,
+                                     velocity,
                                      CL_FALSE,
                                      0,
-                                     sizeof(cl_double4) * temp,
-                                     h_of5678,
-                                     0, 0, &outReadEvt3);
-        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(d_of5678)");
+                                     sizeof(cl_double2) * temp,
+                                     u,
+                                     0, 0, &velocityEvt);
+        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(velocity)");
     }
-    else
-    {
-        status = clEnqueueReadBuffer(commandQueue,
-                                     d_if0,
-                                     CL_FALSE,
-                                     0,
-                                     sizeof(cl_double) * temp,
-                                     h_of0,
-                                     0, 0, &outReadEvt1);
-        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(d_if0)");
 
-        status = clEnqueueReadBuffer(commandQueue,
-                                     d_if1234,
-                                     CL_FALSE,
-                                     0,
-                                     sizeof(cl_double4) * temp,
-                                     h_of1234,
-                                     0, 0, &outReadEvt2);
-        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(d_if1234)");
-
-        status = clEnqueueReadBuffer(commandQueue,
-                                     d_if5678,
-                                     CL_FALSE,
-                                     0,
-                                     sizeof(cl_double4) * temp,
-                                     h_of5678,
-                                     0, 0, &outReadEvt3);
-        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(d_if5678)");
-    }
+    cl_event outReadEvt;
+    status = clEnqueueReadBuffer(commandQueue,
+                                 d_f,
+                                 CL_FALSE,
+                                 0,
+                                 sizeof(cl_double) * LBQ * temp,
+                                 h_f,
+                                 0, 0, &outReadEvt);
+    CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(d_f)");
 
     status = clFlush(commandQueue);
     CHECK_OPENCL_ERROR(status, "clFlush failed.");
 
-    status = waitForEventAndRelease(&velocityEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(velocityEvt) Failed");
-
-    status = waitForEventAndRelease(&outReadEvt1);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(outReadEvt1) Failed");
-
-    status = waitForEventAndRelease(&outReadEvt2);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(outReadEvt2) Failed");
-
-    status = waitForEventAndRelease(&outReadEvt3);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(outReadEvt3) Failed");
+    if(readVelocity)
+    {
+        status = waitForEventAndRelease(&velocityEvt);
+        CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(velocityEvt) Failed");
+    }
 
-    // Copy from host output to the next input
-    memcpy(h_if0, h_of0, sizeof(cl_double) * temp);
-    memcpy(h_if1234, h_of1234, sizeof(cl_double4) * temp);
-    memcpy(h_if5678, h_of5678, sizeof(cl_double4) * temp);
+    status = waitForEventAndRelease(&outReadEvt);
+    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(outReadEvt) Failed");
 
-    cl_mem temp0, temp1234, temp5678;
+    return SDK_SUCCESS;
+}
 
-    //swap input and output buffers
-    temp0 = d_of0;
-    temp1234 = d_of1234;
-    temp5678 = d_of5678;
+int
+FluidSimulation2D::stepCL(int steps, bool writeVelocity)
+{
+    cl_int status;
 
-    d_of0 = d_if0;
-    d_of1234 = d_if1234;
-    d_of5678 = d_if5678;
+    size_t localThreads[2] = {groupSize, 1};
+    size_t globalThreads[2] = {roundUp(dims[0], groupSize), (size_t)dims[1]};
 
-    d_if0 = temp0;
-    d_if1234 = temp1234;
-    d_if5678 = temp5678;
+    for(int i = 0; i < steps; ++i)
+    {
+        cl_int odd = stepsDone % 2;
+        cl_int velocityFlag = (writeVelocity && i == steps - 1) ? 1 : 0;
+        status = clSetKernelArg(kernel, 5, sizeof(cl_int), &odd);
+        status |= clSetKernelArg(kernel, 7, sizeof(cl_int), &velocityFlag);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArgs failed.)");
+
+        status = clEnqueueNDRangeKernel(commandQueue,
+                                        kernel,
+                                        2,
+                                        0,
+                                        globalThreads,
+                                        localThreads,
+                                        0, 0, 0);
+        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.)");
+
+        stepsDone++;
+    }
 
-    i++;
+    status = clFlush(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFlush failed.");
 
     return SDK_SUCCESS;
 }
 
-void FluidSimulation2D::collide(int x, int y)
+int
+FluidSimulation2D::runCLKernels()
 {
-    int pos = x + y * dims[0];
-
-    // Boundary
-    if (h_type[pos] == 1)
+    // The host copy is edited by the mouse, upload it every frame
+    if(writeState() != SDK_SUCCESS)
     {
-        // Swap the frequency distributions
-        cl_double4 temp1234, temp5678;
-
-        v_ef0[pos] = h_if0[pos];
-
-        temp1234.s[0] = h_if1234[pos * 4 + 0];
-        temp1234.s[1] = h_if1234[pos * 4 + 1];
-        temp1234.s[2] = h_if1234[pos * 4 + 2];
-        temp1234.s[3] = h_if1234[pos * 4 + 3];
-
-        v_ef1234[pos * 4 + 0] = temp1234.s[2];
-        v_ef1234[pos * 4 + 1] = temp1234.s[3];
-        v_ef1234[pos * 4 + 2] = temp1234.s[0];
-        v_ef1234[pos * 4 + 3] = temp1234.s[1];
-
-        temp5678.s[0] = h_if5678[pos * 4 + 0];
-        temp5678.s[1] = h_if5678[pos * 4 + 1];
-        temp5678.s[2] = h_if5678[pos * 4 + 2];
-        temp5678.s[3] = h_if5678[pos * 4 + 3];
-
-        v_ef5678[pos * 4 + 0] = temp5678.s[2];
-        v_ef5678[pos * 4 + 1] = temp5678.s[3];
-        v_ef5678[pos * 4 + 2] = temp5678.s[0];
-        v_ef5678[pos * 4 + 3] = temp5678.s[1];
-
-        rho[pos] = 0;
-        u[pos].s[0] = u[pos].s[1] = 0;
+        return SDK_FAILURE;
     }
-    //Fluid
-    else
-    {
-        cl_double2 vel;
 
-        // Calculate density from input distribution
-        cl_double den = h_if0[pos] + h_if1234[pos * 4 + 0] +  h_if1234[pos * 4 + 1] +
-                        h_if1234[pos * 4 + 2] + h_if1234[pos * 4 + 3] +
-                        h_if5678[pos * 4 + 0] + h_if5678[pos * 4 + 1] + h_if5678[pos * 4 + 2] +
-                        h_if5678[pos * 4 + 3];
-
-        // Calculate velocity vector in x-direction
-        vel.s[0] = h_if0[pos] * e[0][0] + h_if1234[pos * 4 + 0] * e[1][0] +
-                   h_if1234[pos * 4 + 1] * e[2][0]
-                   + h_if1234[pos * 4 + 2] * e[3][0] + h_if1234[pos * 4 + 3] * e[4][0] +
-                   h_if5678[pos * 4 + 0] * e[5][0]
-                   + h_if5678[pos * 4 + 1] * e[6][0] + h_if5678[pos * 4 + 2] * e[7][0] +
-                   h_if5678[pos * 4 + 3] * e[8][0];
-
-        // Calculate velocity vector in y-direction
-        vel.s[1] = h_if0[pos] * e[0][1] + h_if1234[pos * 4 + 0] * e[1][1] +
-                   h_if1234[pos * 4 + 1] * e[2][1]
-                   + h_if1234[pos * 4 + 2] * e[3][1] + h_if1234[pos * 4 + 3] * e[4][1] +
-                   h_if5678[pos * 4 + 0] * e[5][1]
-                   + h_if5678[pos * 4 + 1] * e[6][1] + h_if5678[pos * 4 + 2] * e[7][1] +
-                   h_if5678[pos * 4 + 3] * e[8][1];
-
-        vel.s[0] /= den;
-        vel.s[0] /= den;
-
-        // Calculate Equivalent distribution
-        v_ef0[pos] = computefEq(w[0], e[0], den, vel);
-        v_ef1234[pos * 4 + 0] = computefEq(w[1], e[1], den, vel);
-        v_ef1234[pos * 4 + 1] = computefEq(w[2], e[2], den, vel);
-        v_ef1234[pos * 4 + 2] = computefEq(w[3], e[3], den, vel);
-        v_ef1234[pos * 4 + 3] = computefEq(w[4], e[4], den, vel);
-
-        v_ef5678[pos * 4 + 0] = computefEq(w[5], e[5], den, vel);
-        v_ef5678[pos * 4 + 1] = computefEq(w[6], e[6], den, vel);
-        v_ef5678[pos * 4 + 2] = computefEq(w[7], e[7], den, vel);
-        v_ef5678[pos * 4 + 3] = computefEq(w[8], e[8], den, vel);
-
-        v_ef0[pos] = (1 - omega) * h_if0[pos] + omega * v_ef0[pos];
-        v_ef1234[pos * 4 + 0] = (1 - omega) * h_if1234[pos * 4 + 0] + omega *
-                                v_ef1234[pos * 4 + 0];
-        v_ef1234[pos * 4 + 1] = (1 - omega) * h_if1234[pos * 4 + 1] + omega *
-                                v_ef1234[pos * 4 + 1];
-        v_ef1234[pos * 4 + 2] = (1 - omega) * h_if1234[pos * 4 + 2] + omega *
-                                v_ef1234[pos * 4 + 2];
-        v_ef1234[pos * 4 + 3] = (1 - omega) * h_if1234[pos * 4 + 3] + omega *
-                                v_ef1234[pos * 4 + 3];
-        v_ef5678[pos * 4 + 0] = (1 - omega) * h_if5678[pos * 4 + 0] + omega *
-                                v_ef5678[pos * 4 + 0];
-        v_ef5678[pos * 4 + 1] = (1 - omega) * h_if5678[pos * 4 + 1] + omega *
-                                v_ef5678[pos * 4 + 1];
-        v_ef5678[pos * 4 + 2] = (1 - omega) * h_if5678[pos * 4 + 2] + omega *
-                                v_ef5678[pos * 4 + 2];
-        v_ef5678[pos * 4 + 3] = (1 - omega) * h_if5678[pos * 4 + 3] + omega *
-                                v_ef5678[pos * 4 + 3];
+    // An even and an odd step leave the distributions in their natural
+    // slots, a state restarted after an even step needs the odd one only
+    if(stepCL(stepsDone % 2 ? 1 : 2, true) != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
     }
+
+    return readState(true);
 }
 
-void FluidSimulation2D::streamToNeighbors(int x, int y)
+int
+FluidSimulation2D::runHeadless()
 {
-    if (x == 0 || x == dims[0]-1 || y == 0 || y == dims[1]-1)
+    cl_int status;
+
+    if(writeState() != SDK_SUCCESS)
     {
-        return;
+        return SDK_FAILURE;
     }
 
-    for (int k = 0; k < 9; k++)
+    // Warm up
+    if(iterations != 1 && stepCL(2, false) != SDK_SUCCESS)
     {
-        int nx = x + (int)e[k][0];
-        int ny = y + (int)e[k][1];
-
-        int pos = nx + dims[0] * ny;
-        switch(k)
-        {
-        case 0:
-            v_of0[pos] = v_ef0[pos];
-            break;
-        case 1:
-            v_of1234[pos * 4 + 0] = v_ef1234[pos * 4 + 0];
-            break;
-        case 2:
-            v_of1234[pos * 4 + 1] = v_ef1234[pos * 4 + 1];
-            break;
-        case 3:
-            v_of1234[pos * 4 + 2] = v_ef1234[pos * 4 + 2];
-            break;
-        case 4:
-            v_of1234[pos * 4 + 3] = v_ef1234[pos * 4 + 3];
-            break;
-        case 5:
-            v_of5678[pos * 4 + 0] = v_ef5678[pos * 4 + 0];
-            break;
-        case 6:
-            v_of5678[pos * 4 + 1] = v_ef5678[pos * 4 + 1];
-            break;
-        case 7:
-            v_of5678[pos * 4 + 2] = v_ef5678[pos * 4 + 2];
-            break;
-        case 8:
-            v_of5678[pos * 4 + 3] = v_ef5678[pos * 4 + 3];
-            break;
-
-        }
+        return SDK_FAILURE;
     }
-}
 
+    status = clFinish(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed.");
 
-/*
-* lbm simulation on cpu
-*/
-void
-FluidSimulation2D::CPUReference()
-{
-    // Copy from host output to the next input
-    memcpy(v_of0, h_if0, sizeof(cl_double) * dims[0] * dims[1]);
-    memcpy(v_of1234, h_if1234, sizeof(cl_double4) * dims[0] * dims[1]);
-    memcpy(v_of5678, h_if5678, sizeof(cl_double4) * dims[0] * dims[1]);
+    int timer = sampleTimer->createTimer();
+    sampleTimer->resetTimer(timer);
+    sampleTimer->startTimer(timer);
 
-    for (int y = 0; y < dims[1]; y++)
+    int checkpointTimer = sampleTimer->createTimer();
+    sampleTimer->resetTimer(checkpointTimer);
+
+    bool periodic = !checkpointFile.empty() && checkpointInterval > 0;
+    for(int done = 0; done < iterations;)
     {
-        for (int x = 0; x < dims[0]; x++)
+        int steps = iterations - done;
+        if(periodic && steps > checkpointInterval)
         {
-            collide(x, y);
+            steps = checkpointInterval;
         }
-    }
-    for (int y = 0; y < dims[1]; y++)
-    {
-        for (int x = 0; x < dims[0]; x++)
+
+        if(stepCL(steps, done + steps == iterations) != SDK_SUCCESS)
         {
-            streamToNeighbors(x, y);
+            return SDK_FAILURE;
         }
-    }
+        done += steps;
 
-    int flag0 = 0;
-    for (int y = 0; y < dims[1]; y++)
-    {
-        for (int x = 0; x < dims[0]; x++)
+        // The device keeps stepping from its own copy, only the
+        // snapshot travels to the host
+        if(periodic && done < iterations)
         {
-            int pos = x + y * dims[0];
-            if(h_of0[pos] - v_of0[pos] > 1e-5)
+            sampleTimer->startTimer(checkpointTimer);
+            if(readState(false) != SDK_SUCCESS ||
+                    writeCheckpoint(checkpointFile) != SDK_SUCCESS)
             {
-                flag0 = 1;
-                break;
+                return SDK_FAILURE;
             }
+            sampleTimer->stopTimer(checkpointTimer);
         }
     }
 
-    int flag1234 = 0;
-    for (int y = 0; y < dims[1]; y++)
+    status = clFinish(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed.");
+
+    sampleTimer->stopTimer(timer);
+    checkpointTime = (double)(sampleTimer->readTimer(checkpointTimer));
+
+    // Compute kernel time per time step
+    kernelTime = ((double)(sampleTimer->readTimer(timer)) - checkpointTime) /
+                 iterations;
+
+    if(readState(true) != SDK_SUCCESS)
     {
-        for (int x = 0; x < dims[0]; x++)
-        {
-            int pos = x + y * dims[0];
-            if(h_of1234[pos] - v_of1234[pos] > 1e-2)
-            {
-                std::cout << pos << "=" << h_of1234[pos] - v_of1234[pos] << std::endl;
-                flag1234 = 1;
-                break;
-            }
-        }
+        return SDK_FAILURE;
     }
 
-    int flag5678 = 0;
-    for (int y = 0; y < dims[1]; y++)
+    if(!checkpointFile.empty())
     {
-        for (int x = 0; x < dims[0]; x++)
-        {
-            int pos = x + y * dims[0];
-            if(h_of5678[pos] - v_of5678[pos] > 1e-2)
-            {
-                std::cout << pos << "=" << h_of1234[pos] - v_of1234[pos] << std::endl;
-                flag5678 = 1;
-                break;
-            }
-        }
+        return writeCheckpoint(checkpointFile);
     }
 
-    if(!flag0 && !flag1234 && !flag5678)
+    return SDK_SUCCESS;
+}
+
+void
+FluidSimulation2D::CPUSimulate(int steps, int firstStep)
+{
+    int threads = cpuThreads < dims[1] ? cpuThreads : dims[1];
+    LBMThreadData* work = new LBMThreadData[threads];
+    SDKThread* workers = new SDKThread[threads - 1];
+
+    for(int i = 0; i < steps; ++i)
     {
-        verifyFlag = 1;
+        for(int t = 0; t < threads; ++t)
+        {
+            work[t].f = v_f;
+            work[t].type = h_type;
+            work[t].width = dims[0];
+            work[t].height = dims[1];
+            work[t].odd = (firstStep + i) % 2;
+            work[t].rowBegin = (int)((size_t)dims[1] * t / threads);
+            work[t].rowEnd = (int)((size_t)dims[1] * (t + 1) / threads);
+        }
+
+        // the calling thread takes the last share
+        for(int t = 0; t < threads - 1; ++t)
+        {
+            workers[t].create(::lbmHostThread, (void *)(work + t));
+        }
+        lbmHostThread(work + threads - 1);
+        for(int t = 0; t < threads - 1; ++t)
+        {
+            workers[t].join();
+        }
     }
 
+    delete []workers;
+    delete []work;
 }
 
 int
@@ -1044,19 +1072,118 @@ FluidSimulation2D::initialize()
 
     num_iterations->_sVersion = "i";
     num_iterations->_lVersion = "iterations";
-    num_iterations->_description = "Number of iterations";
+    num_iterations->_description = "Number of time steps";
     num_iterations->_type = CA_ARG_INT;
     num_iterations->_value = &iterations;
 
     sampleArgs->AddOption(num_iterations);
     delete num_iterations;
 
+    Option *width_option = new Option;
+    CHECK_ALLOCATION(width_option,
+                     "Error. Failed to allocate memory (width_option)\n");
+
+    width_option->_sVersion = "x";
+    width_option->_lVersion = "width";
+    width_option->_description = "Width of the lattice";
+    width_option->_type = CA_ARG_INT;
+    width_option->_value = &dims[0];
+
+    sampleArgs->AddOption(width_option);
+    delete width_option;
+
+    Option *height_option = new Option;
+    CHECK_ALLOCATION(height_option,
+                     "Error. Failed to allocate memory (height_option)\n");
+
+    height_option->_sVersion = "y";
+    height_option->_lVersion = "height";
+    height_option->_description = "Height of the lattice";
+    height_option->_type = CA_ARG_INT;
+    height_option->_value = &dims[1];
+
+    sampleArgs->AddOption(height_option);
+    delete height_option;
+
+    Option *headless_option = new Option;
+    CHECK_ALLOCATION(headless_option,
+                     "Error. Failed to allocate memory (headless_option)\n");
+
+    headless_option->_sVersion = "hl";
+    headless_option->_lVersion = "headless";
+    headless_option->_description = "Run without a window and report MLUPS";
+    headless_option->_type = CA_NO_ARGUMENT;
+    headless_option->_value = &headless;
+
+    sampleArgs->AddOption(headless_option);
+    delete headless_option;
+
+    Option *checkpoint_option = new Option;
+    CHECK_ALLOCATION(checkpoint_option,
+                     "Error. Failed to allocate memory (checkpoint_option)\n");
+
+    checkpoint_option->_sVersion = "";
+    checkpoint_option->_lVersion = "checkpoint";
+    checkpoint_option->_description = "Write the state to this file in headless mode";
+    checkpoint_option->_type = CA_ARG_STRING;
+    checkpoint_option->_value = &checkpointFile;
+
+    sampleArgs->AddOption(checkpoint_option);
+    delete checkpoint_option;
+
+    Option *interval_option = new Option;
+    CHECK_ALLOCATION(interval_option,
+                     "Error. Failed to allocate memory (interval_option)\n");
+
+    interval_option->_sVersion = "";
+    interval_option->_lVersion = "interval";
+    interval_option->_description =
+        "Time steps between checkpoints (0 = only at the end)";
+    interval_option->_type = CA_ARG_INT;
+    interval_option->_value = &checkpointInterval;
+
+    sampleArgs->AddOption(interval_option);
+    delete interval_option;
+
+    Option *restart_option = new Option;
+    CHECK_ALLOCATION(restart_option,
+                     "Error. Failed to allocate memory (restart_option)\n");
+
+    restart_option->_sVersion = "";
+    restart_option->_lVersion = "restart";
+    restart_option->_description = "Start from this checkpoint";
+    restart_option->_type = CA_ARG_STRING;
+    restart_option->_value = &restartFile;
+
+    sampleArgs->AddOption(restart_option);
+    delete restart_option;
+
+    Option *threads_option = new Option;
+    CHECK_ALLOCATION(threads_option,
+                     "Error. Failed to allocate memory (threads_option)\n");
+
+    threads_option->_sVersion = "c";
+    threads_option->_lVersion = "cpuThreads";
+    threads_option->_description =
+        "Threads of the host engine used for verification (default: all cores)";
+    threads_option->_type = CA_ARG_INT;
+    threads_option->_value = &cpuThreads;
+
+    sampleArgs->AddOption(threads_option);
+    delete threads_option;
+
     return SDK_SUCCESS;
 }
 
 int
 FluidSimulation2D::setup()
 {
+    if(iterations < 1)
+    {
+        std::cout << "Error: iterations must be at least 1" << std::endl;
+        return SDK_FAILURE;
+    }
+
     if(setupFluidSimulation2D() != SDK_SUCCESS)
     {
         return SDK_FAILURE;
@@ -1077,7 +1204,7 @@ FluidSimulation2D::setup()
     // Compute setup time
     setupTime = (double)(sampleTimer->readTimer(timer));
 
-    display = !sampleArgs->quiet && !sampleArgs->verify;
+    display = !sampleArgs->quiet && !sampleArgs->verify && !headless;
 
     return SDK_SUCCESS;
 }
@@ -1102,13 +1229,15 @@ void render()
     glBindTexture(GL_TEXTURE_2D, texnum);
     glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 
-    unsigned char bitmap[LBWIDTH * LBHEIGHT * 4]; // rgba unsigned bytes
+    int width = me->getWidth();
+    int height = me->getHeight();
+    std::vector<unsigned char> bitmap((size_t)width * height * 4); // rgba unsigned bytes
 
     double m, r, g, b;
 
-    for(int y = 0; y < LBHEIGHT; y++)
+    for(int y = 0; y < height; y++)
     {
-        for(int x = 0; x < LBWIDTH; x++)
+        for(int x = 0; x < width; x++)
         {
             if(me->isBoundary(x , y))
             {
@@ -1121,15 +1250,15 @@ void render()
                 bluewhite.GetColor(m * 20, r, g, b);
             }
 
-            bitmap[(x + y * LBWIDTH) * 4 + 0] = (unsigned char)(r * 255);
-            bitmap[(x + y * LBWIDTH) * 4 + 1] = (unsigned char)(g * 255);
-            bitmap[(x + y * LBWIDTH) * 4 + 2] = (unsigned char)(b * 255);
-            bitmap[(x + y * LBWIDTH) * 4 + 3] = 255;
+            bitmap[(x + y * width) * 4 + 0] = (unsigned char)(r * 255);
+            bitmap[(x + y * width) * 4 + 1] = (unsigned char)(g * 255);
+            bitmap[(x + y * width) * 4 + 2] = (unsigned char)(b * 255);
+            bitmap[(x + y * width) * 4 + 3] = 255;
         }
     }
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, LBWIDTH, LBHEIGHT, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, bitmap);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, &bitmap[0]);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
@@ -1197,14 +1326,14 @@ void mouse(int button, int state, int x, int y)
     drawBoundary = false;
     addVelocity = false;
 
-    x = (double)x * (double)((double)LBWIDTH / (double)winwidth);
-    y = (double)y * (double)((double)LBHEIGHT / (double)winheight);
+    x = (double)x * (double)((double)me->getWidth() / (double)winwidth);
+    y = (double)y * (double)((double)me->getHeight() / (double)winheight);
 
     if (state == GLUT_DOWN)
     {
         if (button == GLUT_LEFT_BUTTON)
         {
-            if (me->isFluid(x, y) && x >= 0 && x < LBWIDTH && y >= 0 && y < LBHEIGHT)
+            if (me->isFluid(x, y) && x >= 0 && x < me->getWidth() && y >= 0 && y < me->getHeight())
             {
                 addVelocity = true;
                 oldx = x;
@@ -1216,9 +1345,9 @@ void mouse(int button, int state, int x, int y)
         {
             drawBoundary = true;
 
-            if (x >= 0 && x < LBWIDTH && y >= 0 && y < LBHEIGHT)
+            if (x >= 0 && x < me->getWidth() && y >= 0 && y < me->getHeight())
             {
-                me->setSite(x, LBHEIGHT - 1-y, 1, u);
+                me->setSite(x, me->getHeight() - 1-y, 1, u);
             }
         }
     }
@@ -1228,15 +1357,15 @@ void motion(int x, int y)
 {
     double m, u[2] = {0, 0};
 
-    x = (double)x * (double)((double)LBWIDTH / (double)winwidth);
-    y = (double)y * (double)((double)LBHEIGHT / (double)winheight);
+    x = (double)x * (double)((double)me->getWidth() / (double)winwidth);
+    y = (double)y * (double)((double)me->getHeight() / (double)winheight);
 
-    if (drawBoundary && (x >= 0 && x < LBWIDTH && y >= 0 && y < LBHEIGHT))
+    if (drawBoundary && (x >= 0 && x < me->getWidth() && y >= 0 && y < me->getHeight()))
     {
-        me->setSite(x, LBHEIGHT - 1 - y, 1, u);
+        me->setSite(x, me->getHeight() - 1 - y, 1, u);
     }
 
-    if (addVelocity && (x >= 0 && x < LBWIDTH && y >= 0 && y < LBHEIGHT))
+    if (addVelocity && (x >= 0 && x < me->getWidth() && y >= 0 && y < me->getHeight()))
     {
         if (me->isFluid(x, y))
         {
@@ -1247,7 +1376,7 @@ void motion(int x, int y)
             u[0] /= (1 + 2 * m);
             u[1] /= (1 + 2 * m);
 
-            me->setSite(x, LBHEIGHT - 1 - y, 0, u);
+            me->setSite(x, me->getHeight() - 1 - y, 0, u);
         }
     }
 }
@@ -1280,6 +1409,7 @@ void keyboard(unsigned char key, int x, int y)
 }
 
 
+
 int
 FluidSimulation2D::run()
 {
@@ -1296,24 +1426,7 @@ FluidSimulation2D::run()
 
     if(display == 0)
     {
-        // Warm up
-        for(int i = 0; i < 2 && iterations != 1; ++i)
-        {
-            runCLKernels();
-        }
-
-        int timer = sampleTimer->createTimer();
-        sampleTimer->resetTimer(timer);
-        sampleTimer->startTimer(timer);
-
-        for(int i = 0; i < iterations; ++i)
-        {
-            runCLKernels();
-        }
-
-        sampleTimer->stopTimer(timer);
-        // Compute kernel time
-        kernelTime = (double)(sampleTimer->readTimer(timer)) / iterations;
+        return runHeadless();
     }
 
     return SDK_SUCCESS;
@@ -1325,12 +1438,19 @@ FluidSimulation2D::verifyResults()
     if(sampleArgs->verify)
     {
         /* reference implementation
-        * it overwrites the input array with the output
+        * the host engine repeats every device step from the initial state
         */
-        CPUReference();
+        int timer = sampleTimer->createTimer();
+        sampleTimer->resetTimer(timer);
+        sampleTimer->startTimer(timer);
+
+        CPUSimulate(stepsDone - startStep, startStep);
+
+        sampleTimer->stopTimer(timer);
+        cpuTime = (double)(sampleTimer->readTimer(timer));
 
         // compare the results and see if they match
-        if(verifyFlag)
+        if(compare(h_f, v_f, (int)(LBQ * (size_t)dims[0] * dims[1]), 1e-8))
         {
             std::cout << "Passed!\n" << std::endl;
             return SDK_SUCCESS;
@@ -1350,23 +1470,46 @@ FluidSimulation2D::printStats()
 {
     if(sampleArgs->timing)
     {
-        std::string strArray[4] =
+        std::string strArray[9] =
         {
             "Width",
             "Height",
+            "Steps",
             "Time(sec)",
-            "[Transfer+Kernel]Time(sec)"
+            "[Transfer+Kernel]Time(sec)",
+            "MLUPS"
         };
 
-        std::string stats[4];
-        sampleTimer->totalTime = setupTime + kernelTime;
+        std::string stats[9];
+        sampleTimer->totalTime = setupTime + kernelTime * iterations;
+
+        double sites = (double)dims[0] * dims[1];
 
         stats[0] = toString(dims[0], std::dec);
         stats[1] = toString(dims[1], std::dec);
-        stats[2] = toString(sampleTimer->totalTime, std::dec);
-        stats[3] = toString(kernelTime, std::dec);
+        stats[2] = toString(iterations, std::dec);
+        stats[3] = toString(sampleTimer->totalTime, std::dec);
+        stats[4] = toString(kernelTime, std::dec);
+        stats[5] = toString(sites / kernelTime / 1e6, std::dec);
+        int count = 6;
 
-        printStatistics(strArray, stats, 4);
+        if(sampleArgs->verify && cpuTime > 0)
+        {
+            strArray[count] = "CPU Threads";
+            stats[count++] = toString(cpuThreads, std::dec);
+            strArray[count] = "CPU MLUPS";
+            stats[count++] = toString(sites * (stepsDone - startStep) / cpuTime / 1e6,
+                                      std::dec);
+        }
+
+        if(checkpointBytes > 0)
+        {
+            strArray[count] = "Checkpoint Ratio";
+            stats[count++] = toString((double)(LBQ * sites * sizeof(cl_double)) /
+                                      checkpointBytes, std::dec);
+        }
+
+        printStatistics(strArray, stats, count);
     }
 }
 int
@@ -1381,30 +1524,12 @@ FluidSimulation2D::cleanup()
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.(program)");
 
-    status = clReleaseMemObject(d_if0);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(d_if0)");
-
-    status = clReleaseMemObject(d_of0);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(d_of0)");
-
-    status = clReleaseMemObject(d_if1234);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(d_if1234)");
-
-    status = clReleaseMemObject(d_of1234);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(d_of1234)");
-
-    status = clReleaseMemObject(d_if5678);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (d_if5678)");
-
-    status = clReleaseMemObject(d_of5678);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(d_of5678)");
+    status = clReleaseMemObject(d_f);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(d_f)");
 
     status = clReleaseMemObject(type);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(type)");
 
-    status = clReleaseMemObject(weight);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(weight)");
-
     status = clReleaseMemObject(velocity);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(velocity)");
 
@@ -1420,20 +1545,10 @@ FluidSimulation2D::cleanup()
 FluidSimulation2D::~FluidSimulation2D()
 {
     /* release program resources */
-    FREE(h_if0);
-    FREE(h_if1234);
-    FREE(h_if1234);
-    FREE(h_of0);
-    FREE(h_of1234);
-    FREE(h_of1234);
-    FREE(v_ef0);
-    FREE(v_ef1234);
-    FREE(v_ef5678);
-    FREE(v_of0);
-    FREE(v_of1234);
-    FREE(v_of1234);
+    FREE(h_f);
+    FREE(v_f);
+    FREE(u);
     FREE(h_type);
-    FREE(h_weight);
     FREE(devices);
 }
 
@@ -32,11 +32,15 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 using namespace appsdk;
 
-#define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.3"
+#define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.4"
 
 #define GROUP_SIZE  256
-#define LBWIDTH     256
-#define LBHEIGHT    256
+#define LBWIDTH     256                         /**< default width of the lattice */
+#define LBHEIGHT    256                         /**< default height of the lattice */
+#define LBQ         9                           /**< distributions per site (D2Q9) */
+
+#define CHECKPOINT_MAGIC   0x434d424c           /**< "LBMC" */
+#define CHECKPOINT_VERSION 1
 
 int winwidth = LBWIDTH;
 int winheight = LBHEIGHT;
@@ -45,13 +49,16 @@ int winheight = LBHEIGHT;
 /**
 * FluidSimulation2D
 * Class implements OpenCL  FluidSimulation2D sample
-
+* D2Q9 lattice Boltzmann solver. The distributions are stored
+* structure of arrays and streamed in place with the AA pattern.
 */
 
 class FluidSimulation2D
 {
         cl_double setupTime;                        /**< time taken to setup OpenCL resources and building kernel */
         cl_double kernelTime;                       /**< time taken to run kernel and read result back */
+        cl_double cpuTime;                          /**< time taken by the host engine */
+        cl_double checkpointTime;                   /**< time spent writing checkpoints */
 
         size_t maxWorkGroupSize;                    /**< Max allowed work-items in a group */
         cl_uint maxDimensions;                      /**< Max group dimensions allowed */
@@ -62,25 +69,15 @@ class FluidSimulation2D
         int dims[2];                                /**< Dimension of LBM simulation area */
 
         // 2D Host buffers
-        cl_double *rho;                              /**< Density */
         cl_double2 *u;                               /**< Velocity */
-        cl_double *h_if0, *h_if1234, *h_if5678;      /**< Host input buffers */
-        cl_double *h_of0, *h_of1234, *h_of5678;      /**< Host output buffers */
+        cl_double *h_f;                              /**< Distributions, LBQ arrays of dims[0] x dims[1] */
+        cl_double *v_f;                              /**< Distributions of the host engine for verification */
 
-        cl_double *v_ef0, *v_ef1234,
-                  *v_ef5678;      /**< Host Eq distribution buffers for verification */
-        cl_double *v_of0, *v_of1234,
-                  *v_of5678;      /**< Host output buffers for verification */
-
-        cl_bool *h_type;                            /**< Cell Type - Boundary = 1 or Fluid = 0 */
-        cl_double *h_weight;                         /**< Weights for each direction */
-        cl_double8 dirX, dirY;                       /**< Directions */
+        cl_uchar *h_type;                           /**< Cell Type - Boundary = 1 or Fluid = 0 */
 
         // Device buffers
-        cl_mem d_if0, d_if1234, d_if5678;           /**< Input distributions */
-        cl_mem d_of0, d_of1234, d_of5678;           /**< Output distributions */
-        cl_mem type;                                /**< Constant bool array for position type = boundary or fluid */
-        cl_mem weight;                              /**< Weights for each distribution */
+        cl_mem d_f;                                 /**< Distributions, updated in place */
+        cl_mem type;                                /**< Constant array for position type = boundary or fluid */
         cl_mem velocity;                            /**< 2D Velocity vector buffer */
 
         //OpenCL objects
@@ -92,7 +89,15 @@ class FluidSimulation2D
 
         //size_t kernelWorkGroupSize;                     /**< Group size returned by kernel */
         size_t groupSize;                               /**< Work-Group size */
-        int iterations;
+        int iterations;                                 /**< Number of time steps */
+        int stepsDone;                                  /**< Time steps in d_f, its parity selects the AA step */
+        int startStep;                                  /**< Time step of the initial state */
+        bool headless;                                  /**< Never open a window */
+        std::string checkpointFile;                     /**< Checkpoint written while running */
+        std::string restartFile;                        /**< Checkpoint to start from */
+        int checkpointInterval;                         /**< Time steps between checkpoints */
+        size_t checkpointBytes;                         /**< Size of the last checkpoint */
+        int cpuThreads;                                 /**< Threads of the host engine */
 
         cl_bool reqdExtSupport;
         SDKDeviceInfo
@@ -112,10 +117,37 @@ class FluidSimulation2D
         cl_double2 getVelocity(int x, int y);
         void setSite(int x, int y, bool cellType, double u[2]);
         void setUOutput(int x, int y, double u[2]);
+        int getWidth()
+        {
+            return dims[0];
+        }
+        int getHeight()
+        {
+            return dims[1];
+        }
 
-        // Host functions for verification
-        void collide(int x, int y);
-        void streamToNeighbors(int x, int y);
+        /**
+        * Host engine, advances v_f by a number of time steps.
+        * Rows are split over cpuThreads threads, interior sites
+        * are updated two at a time with SSE2
+        * @param steps number of time steps
+        * @param firstStep time step of v_f, selects the AA step
+        */
+        void CPUSimulate(int steps, int firstStep);
+
+        /**
+        * Write h_f and h_type to a compressed checkpoint
+        * @param fileName name of the checkpoint file
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int writeCheckpoint(std::string fileName);
+
+        /**
+        * Load h_f, h_type, the grid size and the time step from a checkpoint
+        * @param fileName name of the checkpoint file
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int readCheckpoint(std::string fileName);
 
         /**
         * Constructor
@@ -126,31 +158,27 @@ class FluidSimulation2D
             :
             setupTime(0),
             kernelTime(0),
+            cpuTime(0),
+            checkpointTime(0),
 
             devices(NULL),
             maxWorkItemSizes(NULL),
             groupSize(GROUP_SIZE),
             iterations(1),
+            stepsDone(0),
+            startStep(0),
+            headless(false),
+            checkpointInterval(0),
+            checkpointBytes(0),
+            cpuThreads(0),
             reqdExtSupport(true)
         {
             dims[0] = LBWIDTH;
             dims[1] = LBHEIGHT;
-            rho = NULL;
             u = NULL;
-            h_if0 = NULL;
-            h_if1234 = NULL;
-            h_if1234 = NULL;
-            h_of0 = NULL;
-            h_of1234 = NULL;
-            h_of1234 = NULL;
-            v_ef0 = NULL;
-            v_ef1234 = NULL;
-            v_ef5678 = NULL;
-            v_of0 = NULL;
-            v_of1234 = NULL;
-            v_of5678 = NULL;
+            h_f = NULL;
+            v_f = NULL;
             h_type = NULL;
-            h_weight = NULL;
             sampleArgs = new CLCommandArgs() ;
             sampleTimer = new SDKTimer();
             sampleArgs->sampleVerStr = SAMPLE_VERSION;
@@ -186,18 +214,38 @@ class FluidSimulation2D
         int setupCLKernels();
 
         /**
-        * Enqueue calls to the kernels
-        * on to the command queue, wait till end of kernel execution.
-        * Get kernel start and end time if timing is enabled
+        * Copy h_type and h_f to the device
+        * @return SDK_UCCESS on success and SDK_FAILURE on failure
+        */
+        int writeState();
+
+        /**
+        * Copy d_f (and the velocities if requested) back to the host
+        * @return SDK_UCCESS on success and SDK_FAILURE on failure
+        */
+        int readState(bool readVelocity);
+
+        /**
+        * Enqueue time steps on the device without waiting for them
+        * @param steps number of time steps
+        * @param writeVelocity store the velocities of the last step
+        * @return SDK_UCCESS on success and SDK_FAILURE on failure
+        */
+        int stepCL(int steps, bool writeVelocity);
+
+        /**
+        * One display frame: upload the edited state, run an even and
+        * an odd step and read the result back
         * @return SDK_UCCESS on success and SDK_FAILURE on failure
         */
         int runCLKernels();
 
         /**
-        * Reference CPU implementation of Binomial Option
-        * for performance comparison
+        * Headless run: iterations time steps on the device with
+        * periodic checkpoints, the state stays on the device in between
+        * @return SDK_UCCESS on success and SDK_FAILURE on failure
         */
-        void CPUReference();
+        int runHeadless();
 
         /**
         * Override from SDKSample. Print sample stats.
@@ -144,7 +144,8 @@ GaussianNoiseGL::genBinaryImage()
 {
     bifData binaryData;
     binaryData.kernelName = std::string("GaussianNoiseGL_Kernels.cl");
-    binaryData.flagsStr = std::string("");
+    // The kernel includes CounterRNG.h
+    binaryData.flagsStr = std::string("-I.");
     if(sampleArgs->isComplierFlagsSpecified())
     {
         binaryData.flagsFileName = std::string(sampleArgs->flags.c_str());
@@ -827,7 +828,7 @@ GaussianNoiseGL::setupCL()
     buildData.kernelName = std::string("GaussianNoiseGL_Kernels.cl");
     buildData.devices = devices;
     buildData.deviceId = sampleArgs->deviceId;
-    buildData.flagsStr = std::string("");
+    buildData.flagsStr = std::string("-I.");
 
 
     if(sampleArgs->isComplierFlagsSpecified())
@@ -848,7 +849,7 @@ GaussianNoiseGL::setupCL()
     buildData2.kernelName = std::string("GaussianNoiseGL_Kernels2.cl");
     buildData2.devices = devices;
     buildData2.deviceId = sampleArgs->deviceId;
-    buildData2.flagsStr = std::string("");
+    buildData2.flagsStr = std::string("-I.");
 
     if(sampleArgs->isComplierFlagsSpecified())
     {
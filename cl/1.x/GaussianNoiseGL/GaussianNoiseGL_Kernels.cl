@@ -15,21 +15,11 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 ********************************************************************/
 
 
-#define IA 16807    			// a
-#define IM 2147483647 			// m
-#define AM (1.0/IM) 			// 1/m - To calculate floating point result
-#define IQ 127773
-#define IR 2836
-#define NTAB 4
-#define NDIV (1 + (IM - 1)/ NTAB)
-#define EPS 1.2e-7
-#define RMAX (1.0 - EPS)
 #define FACTOR 60			// Deviation factor
 #define GROUP_SIZE 64
-#define PI 3.14
 
-float ran1(int idum, __local int *iv);
-float2 BoxMuller(float2 uniform);
+/* Defined in GaussianNoiseGL_Kernels2.cl, resolved by clLinkProgram */
+float2 gaussianPair(uint pair);
 
 
 __kernel void gaussian_transform(__global uchar4* inputImage, __write_only  image2d_t outputImage, int factor)
@@ -42,19 +32,8 @@ __kernel void gaussian_transform(__global uchar4* inputImage, __write_only  imag
     float4 texel0 = convert_float4(inputImage[pos0]);
     float4 texel1 = convert_float4(inputImage[pos1]);
 
-    /* Compute the average value for each pixel */
-    float avg0 = (texel0.x + texel0.y + texel0.z + texel0.w) / 4;
-    float avg1 = (texel1.x + texel1.y + texel1.z + texel1.w) / 4;
-
-    __local int iv0[NTAB * GROUP_SIZE];
-    __local int iv1[NTAB * GROUP_SIZE];
-
-    /* Compute uniform deviation for the pixel */
-    float dev0 = ran1(-avg0, iv0);
-    float dev1 = ran1(-avg1, iv1);
-
-    /* Apply the box-muller transform */
-    float2 gaussian = BoxMuller((float2)(dev0, dev1));
+    /* One pair of normal deviates per work-item, one for each texel */
+    float2 gaussian = gaussianPair(get_global_id(0) + get_global_size(0) * get_global_id(1));
 
     float4 out0 = (texel0 + (float4)(gaussian.x * factor))/((float4)255);
     float4 out1 = (texel1 + (float4)(gaussian.y * factor))/((float4)255);
@@ -15,62 +15,23 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 ********************************************************************/
 
 
-#define IA 16807    			// a
-#define IM 2147483647 			// m
-#define AM (1.0/IM) 			// 1/m - To calculate floating point result
-#define IQ 127773
-#define IR 2836
-#define NTAB 4
-#define NDIV (1 + (IM - 1)/ NTAB)
-#define EPS 1.2e-7
-#define RMAX (1.0 - EPS)
-#define FACTOR 60			// Deviation factor
-#define GROUP_SIZE 64
-#define PI 3.14
+#define _OCL_CODE_
+#include "CounterRNG.h"
 
+#define NOISE_SEED 1
 
-/* Generate uniform random deviation */
-// Park-Miller with Bays-Durham shuffle and added safeguards
-// Returns a uniform random deviate between (-FACTOR/2, FACTOR/2)
-// input seed should be negative
-float ran1(int idum, __local int *iv)
+/*
+ * Pair of standard normal deviates for texel pair 'pair' :
+ * Box-Muller on block 'pair' of the counter-based stream 0.
+ * Stateless, so no shuffle table is needed in local memory.
+ */
+float2 gaussianPair(uint pair)
 {
-    int j;
-    int k;
-    int iy = 0;
-    //__local int iv[NTAB * GROUP_SIZE];
-    int tid = get_local_id(0);
+    CRNGPair key;
+    key.v[0] = NOISE_SEED;
+    key.v[1] = 0u;
 
-    for(j = NTAB; j >=0; j--)			//Load the shuffle
-    {
-        k = idum / IQ;
-        idum = IA * (idum - k * IQ) - IR * k;
-
-        if(idum < 0)
-            idum += IM;
-
-        if(j < NTAB)
-            iv[NTAB* tid + j] = idum;
-    }
-    iy = iv[0];
-
-
-    k = idum / IQ;
-    idum = IA * (idum - k * IQ) - IR * k;
-
-    if(idum < 0)
-        idum += IM;
-
-    j = iy / NDIV;
-    iy = iv[NTAB * tid + j];
-    return (AM * iy);	//AM *iy will be between 0.0 and 1.0
+    CRNGBlock r = crngStreamBlock(CRNG_PHILOX, key, 0u, (ulong)pair);
+    CRNGFloat2 z = crngBoxMuller(r.v[0], r.v[1]);
+    return (float2)(z.v[0], z.v[1]);
 }
-
-
-/* Box muller transformation */
-float2 BoxMuller(float2 uniform)
-{
-    float r = sqrt(-2 * log(uniform.x));
-    float theta = 2 * PI * uniform.y;
-    return (float2)(r * sin(theta), r * cos(theta));
-}
\ No newline at end of file
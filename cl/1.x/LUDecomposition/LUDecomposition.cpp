@@ -14,30 +14,224 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************************************/
 
-
 #include "LUDecomposition.hpp"
-#define VECTOR_SIZE 4
-#define SIZE effectiveDimension * effectiveDimension * sizeof(double)
 
-int LUD::setupLUD()
+#include <math.h>
+#include <float.h>
+#include <emmintrin.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define SIZE ((size_t)actualDimension * actualDimension * sizeof(double))
+#define COLUMN_GROUP 64                 /**< work-group size of the per-column kernels */
+#define RESIDUAL_THRESHOLD 16.0         /**< largest accepted scaled residual */
+
+/**
+ * Work of one host thread in one step of the blocked factorization
+ */
+struct LUThreadData
 {
-    /*
-     *Changing dimension to a multiple of block if it is not.
-     *Currently execution will be done on the effective dimention
-     *and results will be shown upto what user requests
-     */
+    double* a;                          /**< matrix */
+    const cl_int* pivot;                /**< row interchanges */
+    double* packed;                     /**< jb x CPU_COLUMN_CHUNK scratch for U12 */
+    int n;                              /**< dimension of the matrix */
+    int k;                              /**< first column of the panel */
+    int jb;                             /**< width of the panel */
+    int leftBegin;                      /**< columns left of the panel, only swapped */
+    int leftEnd;
+    int rightBegin;                     /**< columns right of the panel, swapped, solved and updated */
+    int rightEnd;
+};
+
+static size_t roundUp(size_t value, size_t multiple)
+{
+    return ((value + multiple - 1) / multiple) * multiple;
+}
+
+static int numCPUCores()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return (int)systemInfo.dwNumberOfProcessors;
+#else
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
 
+static void swapRowRange(double* a, size_t n, int j, int p, int begin, int end)
+{
+    double* rj = a + j * n;
+    double* rp = a + p * n;
+    for(int c = begin; c < end; ++c)
+    {
+        double t = rj[c];
+        rj[c] = rp[c];
+        rp[c] = t;
+    }
+}
 
-    if(actualDimension % VECTOR_SIZE != 0)
-        effectiveDimension = actualDimension
-                             - (actualDimension % VECTOR_SIZE)
-                             + VECTOR_SIZE;
-    else
+/**
+ * C[rows x cols] -= L[rows x jb] * U where U is packed in groups of
+ * 4 columns (packed[p * 4 + x]). rows and cols are at most 4, the
+ * 4 x 4 accumulator block stays in eight SSE2 registers.
+ */
+static void gemmMicroKernel(double* c, size_t ldc, const double* l, size_t ldl,
+                            const double* packed, int jb, int rows, int cols)
+{
+    // missing rows read row 0 and are not stored
+    const double* l0 = l;
+    const double* l1 = rows > 1 ? l + ldl : l;
+    const double* l2 = rows > 2 ? l + 2 * ldl : l;
+    const double* l3 = rows > 3 ? l + 3 * ldl : l;
+
+    __m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd();
+    __m128d c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+    __m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd();
+    __m128d c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+    for(int p = 0; p < jb; ++p)
+    {
+        __m128d u0 = _mm_loadu_pd(packed + p * 4);
+        __m128d u1 = _mm_loadu_pd(packed + p * 4 + 2);
+        __m128d a = _mm_load1_pd(l0 + p);
+        c00 = _mm_add_pd(c00, _mm_mul_pd(a, u0));
+        c01 = _mm_add_pd(c01, _mm_mul_pd(a, u1));
+        a = _mm_load1_pd(l1 + p);
+        c10 = _mm_add_pd(c10, _mm_mul_pd(a, u0));
+        c11 = _mm_add_pd(c11, _mm_mul_pd(a, u1));
+        a = _mm_load1_pd(l2 + p);
+        c20 = _mm_add_pd(c20, _mm_mul_pd(a, u0));
+        c21 = _mm_add_pd(c21, _mm_mul_pd(a, u1));
+        a = _mm_load1_pd(l3 + p);
+        c30 = _mm_add_pd(c30, _mm_mul_pd(a, u0));
+        c31 = _mm_add_pd(c31, _mm_mul_pd(a, u1));
+    }
+
+    double acc[4][4];
+    _mm_storeu_pd(acc[0], c00);
+    _mm_storeu_pd(acc[0] + 2, c01);
+    _mm_storeu_pd(acc[1], c10);
+    _mm_storeu_pd(acc[1] + 2, c11);
+    _mm_storeu_pd(acc[2], c20);
+    _mm_storeu_pd(acc[2] + 2, c21);
+    _mm_storeu_pd(acc[3], c30);
+    _mm_storeu_pd(acc[3] + 2, c31);
+
+    for(int r = 0; r < rows; ++r)
     {
-        effectiveDimension = actualDimension;
+        for(int x = 0; x < cols; ++x)
+        {
+            c[r * ldc + x] -= acc[r][x];
+        }
+    }
+}
+
+/**
+ * Row interchanges, U12 = inv(L11) * A12 and A22 -= L21 * U12
+ * on the columns owned by one thread
+ */
+void* luUpdateThread(void* data)
+{
+    LUThreadData* t = (LUThreadData*)data;
+    double* a = t->a;
+    size_t n = t->n;
+    int k = t->k;
+    int jb = t->jb;
+
+    for(int j = k; j < k + jb; ++j)
+    {
+        int p = t->pivot[j];
+        if(p != j)
+        {
+            swapRowRange(a, n, j, p, t->leftBegin, t->leftEnd);
+            swapRowRange(a, n, j, p, t->rightBegin, t->rightEnd);
+        }
+    }
+
+    if(t->rightBegin >= t->rightEnd)
+    {
+        return NULL;
     }
 
-    blockSize = effectiveDimension / VECTOR_SIZE;
+    // U12 = inv(L11) * A12, row oriented so the inner loop is contiguous
+    for(int i = 1; i < jb; ++i)
+    {
+        double* row = a + (k + i) * n;
+        for(int s = 0; s < i; ++s)
+        {
+            double l = row[k + s];
+            const double* src = a + (k + s) * n;
+            for(int c = t->rightBegin; c < t->rightEnd; ++c)
+            {
+                row[c] -= l * src[c];
+            }
+        }
+    }
+
+    // A22 -= L21 * U12 over chunks of columns small enough to stay in cache
+    for(int c0 = t->rightBegin; c0 < t->rightEnd; c0 += CPU_COLUMN_CHUNK)
+    {
+        int c1 = c0 + CPU_COLUMN_CHUNK < t->rightEnd ? c0 + CPU_COLUMN_CHUNK :
+                 t->rightEnd;
+        int groups = (c1 - c0 + 3) / 4;
+
+        // pack U12[:, c0:c1] in groups of 4 columns, zero padded
+        for(int g = 0; g < groups; ++g)
+        {
+            double* dst = t->packed + (size_t)g * jb * 4;
+            for(int p = 0; p < jb; ++p)
+            {
+                const double* src = a + (k + p) * n;
+                for(int x = 0; x < 4; ++x)
+                {
+                    int c = c0 + g * 4 + x;
+                    dst[p * 4 + x] = c < c1 ? src[c] : 0.0;
+                }
+            }
+        }
+
+        for(int i = k + jb; i < (int)n; i += 4)
+        {
+            int rows = (int)n - i < 4 ? (int)n - i : 4;
+            for(int g = 0; g < groups; ++g)
+            {
+                int c = c0 + g * 4;
+                int cols = c1 - c < 4 ? c1 - c : 4;
+                gemmMicroKernel(a + i * n + c, n, a + i * n + k, n,
+                                t->packed + (size_t)g * jb * 4, jb, rows, cols);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int LUD::setupLUD()
+{
+    if(actualDimension < 1 || blockSize < 1 || nrhs < 1 ||
+            batchCount < 0 || batchDim < 1 || batchDim > BATCH_MAX_DIM)
+    {
+        std::cout << "Error : dimension, block and rhs must be positive, "
+                  << "the batch dimension at most " << BATCH_MAX_DIM << std::endl;
+        return SDK_FAILURE;
+    }
+
+    if(blockSize > actualDimension)
+    {
+        blockSize = actualDimension;
+    }
+
+    if(cpuThreads < 1)
+    {
+        cpuThreads = numCPUCores();
+        if(cpuThreads < 1)
+        {
+            cpuThreads = 1;
+        }
+    }
 
 #ifdef _WIN32
     input = static_cast<double*>(_aligned_malloc(SIZE, 4096));
@@ -46,13 +240,13 @@ int LUD::setupLUD()
 #endif
     CHECK_ALLOCATION(input, "Unable to allocate input memory");
 
-    //initialize with random double type elements
+    // random entries of both signs, elimination without pivoting breaks down
     fillRandom<double>(
         input,
-        effectiveDimension,
-        effectiveDimension,
+        actualDimension,
+        actualDimension,
+        -1,
         1,
-        2,
         1);
 
 #ifdef _WIN32
@@ -62,12 +256,48 @@ int LUD::setupLUD()
 #endif
     CHECK_ALLOCATION(matrixGPU, "Unable to allocate memory for GPU input");
 
+    pivotGPU = static_cast<cl_int*>(malloc(actualDimension * sizeof(cl_int)));
+    CHECK_ALLOCATION(pivotGPU, "Unable to allocate memory for GPU pivots");
+
+    rhs = static_cast<double*>(malloc(actualDimension * nrhs * sizeof(double)));
+    CHECK_ALLOCATION(rhs, "Unable to allocate memory for right hand sides");
+    fillRandom<double>(rhs, nrhs, actualDimension, -1, 1, 2);
+
+    solutionGPU = static_cast<double*>(malloc(actualDimension * nrhs * sizeof(
+                                           double)));
+    CHECK_ALLOCATION(solutionGPU, "Unable to allocate memory for GPU solutions");
+
+    if(batchCount)
+    {
+        size_t batchSize = (size_t)batchCount * batchDim;
+        batchInput = static_cast<double*>(malloc(batchSize * batchDim * sizeof(
+                                              double)));
+        CHECK_ALLOCATION(batchInput, "Unable to allocate memory for batch matrices");
+        fillRandom<double>(batchInput, batchDim * batchDim, batchCount, -1, 1, 3);
+
+        batchRhs = static_cast<double*>(malloc(batchSize * sizeof(double)));
+        CHECK_ALLOCATION(batchRhs, "Unable to allocate memory for batch rhs");
+        fillRandom<double>(batchRhs, batchDim, batchCount, -1, 1, 4);
+
+        batchSolution = static_cast<double*>(malloc(batchSize * sizeof(double)));
+        CHECK_ALLOCATION(batchSolution,
+                         "Unable to allocate memory for batch solutions");
+    }
+
     if(sampleArgs->verify)
     {
         matrixCPU = static_cast<double*>(malloc(SIZE));
         CHECK_ALLOCATION(matrixCPU,
                          "Unable to allocate memory for refernce implementation");
         memcpy((void*)matrixCPU, (const void*)input, SIZE);
+
+        pivotCPU = static_cast<cl_int*>(malloc(actualDimension * sizeof(cl_int)));
+        CHECK_ALLOCATION(pivotCPU, "Unable to allocate memory for CPU pivots");
+
+        solutionCPU = static_cast<double*>(malloc(actualDimension * nrhs * sizeof(
+                                               double)));
+        CHECK_ALLOCATION(solutionCPU, "Unable to allocate memory for CPU solutions");
+        memcpy(solutionCPU, rhs, actualDimension * nrhs * sizeof(double));
     }
 
     if(!sampleArgs->quiet)
@@ -193,39 +423,68 @@ int LUD::setupCL(void)
         }
     }
 
-    //Local Memory Required in worst case
-    localMemoryNeeded = (cl_ulong)((deviceInfo.maxWorkGroupSize / 2) * sizeof(
-                                       cl_double));
-
     status = setupLUD();
     if(status != SDK_SUCCESS)
     {
         return status;
     }
 
+    // a 16k x 16k matrix needs 2GB in a single buffer
+    if(SIZE > deviceInfo.maxMemAllocSize)
+    {
+        OPENCL_EXPECTED_ERROR("Matrix is larger than CL_DEVICE_MAX_MEM_ALLOC_SIZE!");
+    }
+
     //Creating Buffers
     inplaceBuffer = clCreateBuffer(
                         context,
                         CL_MEM_READ_WRITE,
-                        sizeof(double) * effectiveDimension * effectiveDimension,
+                        SIZE,
                         NULL,
                         &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (inputBuffer)");
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (inplaceBuffer)");
+
+    pivotBuffer = clCreateBuffer(
+                      context,
+                      CL_MEM_READ_WRITE,
+                      sizeof(cl_int) * actualDimension,
+                      NULL,
+                      &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (pivotBuffer)");
+
+    rhsBuffer = clCreateBuffer(
+                    context,
+                    CL_MEM_READ_WRITE,
+                    sizeof(double) * actualDimension * nrhs,
+                    NULL,
+                    &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (rhsBuffer)");
 
-    inputBuffer2 = clCreateBuffer(
-                       context,
-                       CL_MEM_READ_WRITE,
-                       sizeof(double) * effectiveDimension * effectiveDimension,
-                       NULL,
-                       &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (outputBuffer)");
+    if(batchCount)
+    {
+        batchInputBuffer = clCreateBuffer(
+                               context,
+                               CL_MEM_READ_WRITE,
+                               sizeof(double) * batchCount * batchDim * batchDim,
+                               NULL,
+                               &status);
+        CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (batchInputBuffer)");
+
+        batchRhsBuffer = clCreateBuffer(
+                             context,
+                             CL_MEM_READ_WRITE,
+                             sizeof(double) * batchCount * batchDim,
+                             NULL,
+                             &status);
+        CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (batchRhsBuffer)");
+    }
 
     // create a CL program using the kernel source
     buildProgramData buildData;
     buildData.kernelName = std::string("LUDecomposition_Kernels.cl");
     buildData.devices = devices;
     buildData.deviceId = sampleArgs->deviceId;
-    buildData.flagsStr = std::string("");
+    buildData.flagsStr = buildOptions;
     if(sampleArgs->isLoadBinaryEnabled())
     {
         buildData.binaryName = std::string(sampleArgs->loadBinary.c_str());
@@ -240,293 +499,666 @@ int LUD::setupCL(void)
     CHECK_ERROR(retValue, SDK_SUCCESS, "buildOpenCLProgram() failed");
 
     // get a kernel object handle for a kernel with the given name
-    kernelLUD = clCreateKernel(program, "kernelLUDecompose", &status);
-    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. : kernelLUD");
+    kernelPanel = clCreateKernel(program, "kernelPanelFactor", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. : kernelPanel");
+
+    kernelSwap = clCreateKernel(program, "kernelSwapRows", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. : kernelSwap");
+
+    kernelTrsmLower = clCreateKernel(program, "kernelTrsmLower", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. : kernelTrsmLower");
+
+    kernelTrsmUpper = clCreateKernel(program, "kernelTrsmUpper", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. : kernelTrsmUpper");
+
+    kernelGemm = clCreateKernel(program, "kernelGemmUpdate", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. : kernelGemm");
+
+    kernelBatch = clCreateKernel(program, "kernelBatchedLUSolve", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. : kernelBatch");
+
+    /*
+     * The update kernel needs TILE x TILE work-items, the panel kernel
+     * takes the largest power of 2 the device allows
+     */
+    status = kernelInfo.setKernelWorkGroupInfo(kernelGemm,
+             devices[sampleArgs->deviceId]);
+    CHECK_ERROR(status, SDK_SUCCESS, "setKernelWorkGroupInfo() failed");
+
+    if(kernelInfo.kernelWorkGroupSize < TILE * TILE)
+    {
+        OPENCL_EXPECTED_ERROR("Device does not support the work-group size of kernelGemmUpdate!");
+    }
 
-    kernelCombine = clCreateKernel(program, "kernelLUCombine", &status);
-    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. : kernelCombine");
+    status = kernelInfo.setKernelWorkGroupInfo(kernelBatch,
+             devices[sampleArgs->deviceId]);
+    CHECK_ERROR(status, SDK_SUCCESS, "setKernelWorkGroupInfo() failed");
+
+    if(kernelInfo.kernelWorkGroupSize < BATCH_MAX_DIM)
+    {
+        OPENCL_EXPECTED_ERROR("Device does not support the work-group size of kernelBatchedLUSolve!");
+    }
+
+    status = kernelInfo.setKernelWorkGroupInfo(kernelPanel,
+             devices[sampleArgs->deviceId]);
+    CHECK_ERROR(status, SDK_SUCCESS, "setKernelWorkGroupInfo() failed");
+
+    panelGroup = 1;
+    while(panelGroup * 2 <= PANEL_GROUP &&
+            panelGroup * 2 <= kernelInfo.kernelWorkGroupSize)
+    {
+        panelGroup *= 2;
+    }
 
     return SDK_SUCCESS;
 }
 
-int LUD::runCLKernels(void)
+int LUD::writeBuffer(cl_mem buffer, const void* data, size_t size)
 {
-    cl_int   status;
-    cl_int eventStatus = CL_QUEUED;
-    cl_event inMapEvt;
-    cl_event inUnmapEvt;
-    cl_event outMapEvt;
-    cl_event outUnmapEvt;
-    void* inMapPtr = NULL;
-    void* outMapPtr = NULL;
-
-    inMapPtr = clEnqueueMapBuffer(
-                   commandQueue,
-                   inplaceBuffer,
-                   CL_FALSE,
-                   CL_MAP_WRITE,
-                   0,
-                   SIZE,
-                   0,
-                   NULL,
-                   &inMapEvt,
-                   &status);
-    CHECK_OPENCL_ERROR(status, "clEnqueueMapBuffer failed. (inplaceBuffer)");
+    cl_int status;
+    cl_event mapEvt;
+    cl_event unmapEvt;
+
+    void* mapPtr = clEnqueueMapBuffer(
+                       commandQueue,
+                       buffer,
+                       CL_FALSE,
+                       CL_MAP_WRITE,
+                       0,
+                       size,
+                       0,
+                       NULL,
+                       &mapEvt,
+                       &status);
+    CHECK_OPENCL_ERROR(status, "clEnqueueMapBuffer failed.");
 
     status = clFlush(commandQueue);
     CHECK_OPENCL_ERROR(status, "clFlush failed.");
 
-    status = waitForEventAndRelease(&inMapEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(inMapEvt) Failed");
+    status = waitForEventAndRelease(&mapEvt);
+    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(mapEvt) Failed");
+
+    memcpy(mapPtr, data, size);
 
-    memcpy(inMapPtr, input, SIZE);
     status = clEnqueueUnmapMemObject(
                  commandQueue,
-                 inplaceBuffer,
-                 inMapPtr,
+                 buffer,
+                 mapPtr,
                  0,
                  NULL,
-                 &inUnmapEvt);
-    CHECK_OPENCL_ERROR(status, "clEnqueueUnmapMemObject failed. (inplaceBuffer)");
+                 &unmapEvt);
+    CHECK_OPENCL_ERROR(status, "clEnqueueUnmapMemObject failed.");
 
     status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.(commandQueue)");
+    CHECK_OPENCL_ERROR(status, "clFlush failed.");
 
-    status = waitForEventAndRelease(&inUnmapEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(inUnmapEvt) Failed");
+    status = waitForEventAndRelease(&unmapEvt);
+    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(unmapEvt) Failed");
 
-    size_t globalThreads[2]= {blockSize, effectiveDimension};
-    size_t localThreads[2] = {blockSize, 1};
-    size_t offset[2] = {0, 0};
+    return SDK_SUCCESS;
+}
 
-    /*
-     *Querying some important device paramneters
-     *Finding out the appropritate Work group size for the kernel
-     * See if local memory can be used
-     * Check group size against kernelWorkGroupSize
-     */
+int LUD::readBuffer(cl_mem buffer, void* data, size_t size)
+{
+    cl_int status;
+    cl_event mapEvt;
+    cl_event unmapEvt;
+
+    void* mapPtr = clEnqueueMapBuffer(
+                       commandQueue,
+                       buffer,
+                       CL_FALSE,
+                       CL_MAP_READ,
+                       0,
+                       size,
+                       0,
+                       NULL,
+                       &mapEvt,
+                       &status);
+    CHECK_OPENCL_ERROR(status, "clEnqueueMapBuffer failed.");
 
-    status =  kernelInfo.setKernelWorkGroupInfo(kernelLUD,
-              devices[sampleArgs->deviceId]);
-    CHECK_ERROR(status, SDK_SUCCESS, "setKErnelWorkGroupInfo() failed");
+    status = clFlush(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFlush failed.");
 
-    /*
-     *Setting Common Kernel Arguments
-     */
-    {
-        //kernelLUD
-        // 1st kernel argument - output
-        status = clSetKernelArg(
-                     kernelLUD,
-                     0,
-                     sizeof(cl_mem),
-                     (void *)&inputBuffer2);
-        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. :kernelLUD(inputBuffer2)");
+    status = waitForEventAndRelease(&mapEvt);
+    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(mapEvt) Failed");
 
-        // 2nd kernel argument - input
-        status = clSetKernelArg(
-                     kernelLUD,
-                     1,
-                     sizeof(cl_mem),
-                     (void *)&inplaceBuffer);
-        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. :kernelLUD(inplaceBuffer)");
-    }
+    memcpy(data, mapPtr, size);
 
-    for(int index = 0; index < effectiveDimension - 1; ++index)
-    {
-        /*
-         *  code to find :
-         *  1. new offset
-         *  2. Local Work group size
-         *  3. Global ND range
-         */
-        if(index % VECTOR_SIZE == 0)
-        {
-            offset[0] = (index / VECTOR_SIZE);
-            offset[1] = VECTOR_SIZE * (index / VECTOR_SIZE);
+    status = clEnqueueUnmapMemObject(
+                 commandQueue,
+                 buffer,
+                 mapPtr,
+                 0,
+                 NULL,
+                 &unmapEvt);
+    CHECK_OPENCL_ERROR(status, "clEnqueueUnmapMemObject failed.");
 
-            if(!index)
-            {
-                globalThreads[0] += 1;
-                globalThreads[1] += VECTOR_SIZE;
-            }
-            globalThreads[0] -= 1;
-            globalThreads[1] -= VECTOR_SIZE;
+    status = clFlush(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFlush failed.");
 
-            if(globalThreads[0] <= kernelInfo.kernelWorkGroupSize)
-            {
-                localThreads[0] = globalThreads[0];
-            }
-            else
-            {
-                size_t temp = (int)kernelInfo.kernelWorkGroupSize;
-                for(; temp > 1; temp--)
-                {
-                    if(globalThreads[0] % temp == 0)
-                    {
-                        break;
-                    }
-                }
-                localThreads[0] = temp;
-            }
+    status = waitForEventAndRelease(&unmapEvt);
+    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(unmapEvt) Failed");
 
-            if( globalThreads[1] < kernelInfo.kernelWorkGroupSize / localThreads[0])
-            {
-                localThreads[1] = globalThreads[1];
-            }
-            else
-            {
-                size_t temp = kernelInfo.kernelWorkGroupSize / localThreads[0];
-                for(; temp > 1; temp--)
-                {
-                    if(globalThreads[1] % temp == 0)
-                    {
-                        break;
-                    }
-                }
-                localThreads[1] = temp;
-            }
-        }
+    return SDK_SUCCESS;
+}
 
-        // 3rd kernel argument - index for the matrix
-        status = clSetKernelArg(
-                     kernelLUD,
-                     2,
-                     sizeof(cl_uint),
-                     &index);
-        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. :kernelLUD(index)");
+int LUD::enqueueSwapRows(cl_mem buffer, cl_ulong off, cl_int ld,
+                         cl_int first, cl_int count, cl_int ncols,
+                         cl_int skipBegin, cl_int skipEnd)
+{
+    cl_int status;
 
-        // 4th kernel argument - local spcae for holding ratio
-        status = clSetKernelArg(
-                     kernelLUD,
-                     3,
-                     sizeof(cl_double) * localThreads[1],
-                     NULL);
-        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. :kernelLUD(localBuffer)");
+    status  = clSetKernelArg(kernelSwap, 0, sizeof(cl_mem), (void *)&buffer);
+    status |= clSetKernelArg(kernelSwap, 1, sizeof(cl_ulong), &off);
+    status |= clSetKernelArg(kernelSwap, 2, sizeof(cl_int), &ld);
+    status |= clSetKernelArg(kernelSwap, 3, sizeof(cl_mem), (void *)&pivotBuffer);
+    status |= clSetKernelArg(kernelSwap, 4, sizeof(cl_int), &first);
+    status |= clSetKernelArg(kernelSwap, 5, sizeof(cl_int), &count);
+    status |= clSetKernelArg(kernelSwap, 6, sizeof(cl_int), &ncols);
+    status |= clSetKernelArg(kernelSwap, 7, sizeof(cl_int), &skipBegin);
+    status |= clSetKernelArg(kernelSwap, 8, sizeof(cl_int), &skipEnd);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. :kernelSwap");
 
-        /*
-         * Enqueue a kernel run call.
-         * kernelLUD
-         */
-        status = clEnqueueNDRangeKernel(
-                     commandQueue,
-                     kernelLUD,
-                     2,
-                     offset,
-                     globalThreads,
-                     localThreads,
-                     0,
-                     NULL,
-                     NULL);
-        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+    size_t globalThreads = roundUp(ncols, COLUMN_GROUP);
+    size_t localThreads = COLUMN_GROUP;
 
-        // wait for the kernel call to finish execution
-        status = clFlush(commandQueue);
-        CHECK_OPENCL_ERROR(status, "clFlush failed.");
-    }
+    status = clEnqueueNDRangeKernel(
+                 commandQueue,
+                 kernelSwap,
+                 1,
+                 NULL,
+                 &globalThreads,
+                 &localThreads,
+                 0,
+                 NULL,
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. :kernelSwap");
 
-    /*
-     * This will combine the L & U matrices at the GPU side
-     * so that they can be bought in CPU space as a single matrix
-     */
+    return SDK_SUCCESS;
+}
 
-    // 2nd kernel argument - L matrix
-    status = clSetKernelArg(
-                 kernelCombine,
-                 0,
-                 sizeof(cl_mem),
-                 (void *)&inputBuffer2);
-    CHECK_OPENCL_ERROR(status,
-                       "clSetKernelArg failed. :kernelCombine(inputBuffer2)");
-
-    // 2nd kernel argument - inplace matrix
-    status = clSetKernelArg(
-                 kernelCombine,
+int LUD::enqueueTrsm(cl_kernel kernel, cl_ulong aoff,
+                     cl_mem b, cl_ulong boff, cl_int ldb,
+                     cl_int jb, cl_int ncols)
+{
+    cl_int status;
+
+    status  = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&inplaceBuffer);
+    status |= clSetKernelArg(kernel, 1, sizeof(cl_ulong), &aoff);
+    status |= clSetKernelArg(kernel, 2, sizeof(cl_int), &actualDimension);
+    status |= clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&b);
+    status |= clSetKernelArg(kernel, 4, sizeof(cl_ulong), &boff);
+    status |= clSetKernelArg(kernel, 5, sizeof(cl_int), &ldb);
+    status |= clSetKernelArg(kernel, 6, sizeof(cl_int), &jb);
+    status |= clSetKernelArg(kernel, 7, sizeof(cl_int), &ncols);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. :kernelTrsm");
+
+    size_t globalThreads = roundUp(ncols, COLUMN_GROUP);
+    size_t localThreads = COLUMN_GROUP;
+
+    status = clEnqueueNDRangeKernel(
+                 commandQueue,
+                 kernel,
                  1,
-                 sizeof(cl_mem),
-                 (void *)&inplaceBuffer);
-    CHECK_OPENCL_ERROR(status,
-                       "clSetKernelArg failed. :kernelCombine(inplaceBuffer)");
+                 NULL,
+                 &globalThreads,
+                 &localThreads,
+                 0,
+                 NULL,
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. :kernelTrsm");
+
+    return SDK_SUCCESS;
+}
+
+int LUD::enqueueGemm(cl_ulong aoff, cl_mem b, cl_ulong boff, cl_int ldb,
+                     cl_mem c, cl_ulong coff, cl_int ldc,
+                     cl_int m, cl_int ncols, cl_int kk)
+{
+    cl_int status;
 
-    globalThreads[0] = effectiveDimension;
-    globalThreads[1] = effectiveDimension;
+    status  = clSetKernelArg(kernelGemm, 0, sizeof(cl_mem),
+                             (void *)&inplaceBuffer);
+    status |= clSetKernelArg(kernelGemm, 1, sizeof(cl_ulong), &aoff);
+    status |= clSetKernelArg(kernelGemm, 2, sizeof(cl_int), &actualDimension);
+    status |= clSetKernelArg(kernelGemm, 3, sizeof(cl_mem), (void *)&b);
+    status |= clSetKernelArg(kernelGemm, 4, sizeof(cl_ulong), &boff);
+    status |= clSetKernelArg(kernelGemm, 5, sizeof(cl_int), &ldb);
+    status |= clSetKernelArg(kernelGemm, 6, sizeof(cl_mem), (void *)&c);
+    status |= clSetKernelArg(kernelGemm, 7, sizeof(cl_ulong), &coff);
+    status |= clSetKernelArg(kernelGemm, 8, sizeof(cl_int), &ldc);
+    status |= clSetKernelArg(kernelGemm, 9, sizeof(cl_int), &m);
+    status |= clSetKernelArg(kernelGemm, 10, sizeof(cl_int), &ncols);
+    status |= clSetKernelArg(kernelGemm, 11, sizeof(cl_int), &kk);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. :kernelGemm");
+
+    size_t globalThreads[2] = {roundUp(ncols, BLOCK) / WPT,
+                               roundUp(m, BLOCK) / WPT
+                              };
+    size_t localThreads[2] = {TILE, TILE};
 
     status = clEnqueueNDRangeKernel(
                  commandQueue,
-                 kernelCombine,
+                 kernelGemm,
                  2,
                  NULL,
                  globalThreads,
-                 NULL,
+                 localThreads,
                  0,
                  NULL,
                  NULL);
-    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. ");
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. :kernelGemm");
 
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.");
+    return SDK_SUCCESS;
+}
 
-    // Get final matrix data
-    outMapPtr = clEnqueueMapBuffer(
-                    commandQueue,
-                    inplaceBuffer,
-                    CL_FALSE,
-                    CL_MAP_READ,
-                    0,
-                    SIZE,
-                    0,
-                    NULL,
-                    &outMapEvt,
-                    &status);
-    CHECK_OPENCL_ERROR(status, "clEnqueueMapBuffer failed. (inplaceBuffer)");
-	 
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.");
+int LUD::enqueueFactorization()
+{
+    cl_int status;
+    cl_int n = actualDimension;
 
-    status = waitForEventAndRelease(&outMapEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(outMapEvt) Failed");
+    for(cl_int k = 0; k < n; k += blockSize)
+    {
+        cl_int jb = (n - k < blockSize) ? n - k : blockSize;
+        cl_int rest = n - k - jb;
+
+        // factorize the panel A[k:n, k:k+jb]
+        status  = clSetKernelArg(kernelPanel, 0, sizeof(cl_mem),
+                                 (void *)&inplaceBuffer);
+        status |= clSetKernelArg(kernelPanel, 1, sizeof(cl_mem),
+                                 (void *)&pivotBuffer);
+        status |= clSetKernelArg(kernelPanel, 2, sizeof(cl_int), &n);
+        status |= clSetKernelArg(kernelPanel, 3, sizeof(cl_int), &k);
+        status |= clSetKernelArg(kernelPanel, 4, sizeof(cl_int), &jb);
+        status |= clSetKernelArg(kernelPanel, 5, sizeof(cl_double) * panelGroup, NULL);
+        status |= clSetKernelArg(kernelPanel, 6, sizeof(cl_int) * panelGroup, NULL);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. :kernelPanel");
+
+        status = clEnqueueNDRangeKernel(
+                     commandQueue,
+                     kernelPanel,
+                     1,
+                     NULL,
+                     &panelGroup,
+                     &panelGroup,
+                     0,
+                     NULL,
+                     NULL);
+        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. :kernelPanel");
 
-    memcpy(matrixGPU, outMapPtr, SIZE);
+        // apply the interchanges to the columns left and right of the panel
+        if(k > 0 || rest > 0)
+        {
+            status = enqueueSwapRows(inplaceBuffer, 0, n, k, jb, n, k, k + jb);
+            CHECK_ERROR(status, SDK_SUCCESS, "enqueueSwapRows() failed");
+        }
 
-    status = clEnqueueUnmapMemObject(
-                 commandQueue,
-                 inplaceBuffer,
-                 outMapPtr,
-                 0,
-                 NULL,
-                 &outUnmapEvt);
-    CHECK_OPENCL_ERROR(status, "clEnqueueUnmapMemObject failed. (inplaceBuffer)");
+        if(rest > 0)
+        {
+            // U12 = inv(L11) * A12
+            status = enqueueTrsm(kernelTrsmLower, (cl_ulong)k * n + k,
+                                 inplaceBuffer, (cl_ulong)k * n + k + jb, n,
+                                 jb, rest);
+            CHECK_ERROR(status, SDK_SUCCESS, "enqueueTrsm() failed");
+
+            // A22 -= L21 * U12
+            status = enqueueGemm((cl_ulong)(k + jb) * n + k,
+                                 inplaceBuffer, (cl_ulong)k * n + k + jb, n,
+                                 inplaceBuffer, (cl_ulong)(k + jb) * n + k + jb, n,
+                                 rest, rest, jb);
+            CHECK_ERROR(status, SDK_SUCCESS, "enqueueGemm() failed");
+        }
+
+        status = clFlush(commandQueue);
+        CHECK_OPENCL_ERROR(status, "clFlush failed.");
+    }
+
+    return SDK_SUCCESS;
+}
+
+int LUD::enqueueSolve()
+{
+    cl_int status;
+    cl_int n = actualDimension;
+
+    // B = P * B
+    status = enqueueSwapRows(rhsBuffer, 0, nrhs, 0, n, nrhs, 0, 0);
+    CHECK_ERROR(status, SDK_SUCCESS, "enqueueSwapRows() failed");
+
+    // L * Y = B, a triangular solve per diagonal block then a GEMM below it
+    for(cl_int i = 0; i < n; i += blockSize)
+    {
+        cl_int ib = (n - i < blockSize) ? n - i : blockSize;
+
+        status = enqueueTrsm(kernelTrsmLower, (cl_ulong)i * n + i,
+                             rhsBuffer, (cl_ulong)i * nrhs, nrhs, ib, nrhs);
+        CHECK_ERROR(status, SDK_SUCCESS, "enqueueTrsm() failed");
+
+        if(i + ib < n)
+        {
+            status = enqueueGemm((cl_ulong)(i + ib) * n + i,
+                                 rhsBuffer, (cl_ulong)i * nrhs, nrhs,
+                                 rhsBuffer, (cl_ulong)(i + ib) * nrhs, nrhs,
+                                 n - i - ib, nrhs, ib);
+            CHECK_ERROR(status, SDK_SUCCESS, "enqueueGemm() failed");
+        }
+    }
+
+    // U * X = Y, from the last block upwards with a GEMM above each block
+    for(cl_int i = ((n - 1) / blockSize) * blockSize; i >= 0; i -= blockSize)
+    {
+        cl_int ib = (n - i < blockSize) ? n - i : blockSize;
+
+        status = enqueueTrsm(kernelTrsmUpper, (cl_ulong)i * n + i,
+                             rhsBuffer, (cl_ulong)i * nrhs, nrhs, ib, nrhs);
+        CHECK_ERROR(status, SDK_SUCCESS, "enqueueTrsm() failed");
+
+        if(i > 0)
+        {
+            status = enqueueGemm((cl_ulong)i,
+                                 rhsBuffer, (cl_ulong)i * nrhs, nrhs,
+                                 rhsBuffer, 0, nrhs,
+                                 i, nrhs, ib);
+            CHECK_ERROR(status, SDK_SUCCESS, "enqueueGemm() failed");
+        }
+    }
 
     status = clFlush(commandQueue);
     CHECK_OPENCL_ERROR(status, "clFlush failed.");
 
-    status = waitForEventAndRelease(&outUnmapEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(outUnmapEvt) Failed");
+    return SDK_SUCCESS;
+}
+
+int LUD::runCLKernels(void)
+{
+    cl_int   status;
+
+    status = writeBuffer(inplaceBuffer, input, SIZE);
+    CHECK_ERROR(status, SDK_SUCCESS, "writeBuffer(inplaceBuffer) failed");
+
+    status = writeBuffer(rhsBuffer, rhs, sizeof(double) * actualDimension * nrhs);
+    CHECK_ERROR(status, SDK_SUCCESS, "writeBuffer(rhsBuffer) failed");
+
+    if(batchCount)
+    {
+        status = writeBuffer(batchInputBuffer, batchInput,
+                             sizeof(double) * batchCount * batchDim * batchDim);
+        CHECK_ERROR(status, SDK_SUCCESS, "writeBuffer(batchInputBuffer) failed");
+
+        status = writeBuffer(batchRhsBuffer, batchRhs,
+                             sizeof(double) * batchCount * batchDim);
+        CHECK_ERROR(status, SDK_SUCCESS, "writeBuffer(batchRhsBuffer) failed");
+    }
+
+    int timer = sampleTimer->createTimer();
+
+    // P * A = L * U
+    sampleTimer->resetTimer(timer);
+    sampleTimer->startTimer(timer);
+
+    status = enqueueFactorization();
+    CHECK_ERROR(status, SDK_SUCCESS, "enqueueFactorization() failed");
+
+    status = clFinish(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed.");
+
+    sampleTimer->stopTimer(timer);
+    factorKernelTime += sampleTimer->readTimer(timer);
+
+    // X = inv(A) * B
+    sampleTimer->resetTimer(timer);
+    sampleTimer->startTimer(timer);
+
+    status = enqueueSolve();
+    CHECK_ERROR(status, SDK_SUCCESS, "enqueueSolve() failed");
+
+    status = clFinish(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed.");
+
+    sampleTimer->stopTimer(timer);
+    solveKernelTime += sampleTimer->readTimer(timer);
+
+    if(batchCount)
+    {
+        status  = clSetKernelArg(kernelBatch, 0, sizeof(cl_mem),
+                                 (void *)&batchInputBuffer);
+        status |= clSetKernelArg(kernelBatch, 1, sizeof(cl_mem),
+                                 (void *)&batchRhsBuffer);
+        status |= clSetKernelArg(kernelBatch, 2, sizeof(cl_int), &batchDim);
+        status |= clSetKernelArg(kernelBatch, 3,
+                                 sizeof(cl_double) * batchDim * batchDim, NULL);
+        status |= clSetKernelArg(kernelBatch, 4, sizeof(cl_double) * batchDim, NULL);
+        status |= clSetKernelArg(kernelBatch, 5, sizeof(cl_int), NULL);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. :kernelBatch");
+
+        size_t globalThreads = (size_t)batchCount * BATCH_MAX_DIM;
+        size_t localThreads = BATCH_MAX_DIM;
+
+        sampleTimer->resetTimer(timer);
+        sampleTimer->startTimer(timer);
+
+        status = clEnqueueNDRangeKernel(
+                     commandQueue,
+                     kernelBatch,
+                     1,
+                     NULL,
+                     &globalThreads,
+                     &localThreads,
+                     0,
+                     NULL,
+                     NULL);
+        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. :kernelBatch");
+
+        status = clFinish(commandQueue);
+        CHECK_OPENCL_ERROR(status, "clFinish failed.");
+
+        sampleTimer->stopTimer(timer);
+        batchKernelTime += sampleTimer->readTimer(timer);
+    }
+
+    // Get final matrix data
+    status = readBuffer(inplaceBuffer, matrixGPU, SIZE);
+    CHECK_ERROR(status, SDK_SUCCESS, "readBuffer(inplaceBuffer) failed");
+
+    status = readBuffer(pivotBuffer, pivotGPU, sizeof(cl_int) * actualDimension);
+    CHECK_ERROR(status, SDK_SUCCESS, "readBuffer(pivotBuffer) failed");
+
+    status = readBuffer(rhsBuffer, solutionGPU,
+                        sizeof(double) * actualDimension * nrhs);
+    CHECK_ERROR(status, SDK_SUCCESS, "readBuffer(rhsBuffer) failed");
+
+    if(batchCount)
+    {
+        status = readBuffer(batchRhsBuffer, batchSolution,
+                            sizeof(double) * batchCount * batchDim);
+        CHECK_ERROR(status, SDK_SUCCESS, "readBuffer(batchRhsBuffer) failed");
+    }
 
     return SDK_SUCCESS;
 }
 
-void LUD::LUDCPUReference(double* matrixCPU, const cl_uint effectiveDimension)
+void LUD::LUDCPUReference(double* matrixCPU, cl_int* pivot,
+                          const cl_int dimension)
 {
-    for(unsigned int d = 0 ; d < effectiveDimension-1 ; d++)
+    size_t n = dimension;
+    int threads = cpuThreads;
+
+    LUThreadData* work = new LUThreadData[threads];
+    for(int t = 0; t < threads; ++t)
+    {
+        work[t].packed = new double[(size_t)blockSize * CPU_COLUMN_CHUNK];
+    }
+
+    for(int k = 0; k < dimension; k += blockSize)
     {
-        for(unsigned i = d + 1 ; i < effectiveDimension; i++)
+        int jb = (dimension - k < blockSize) ? dimension - k : blockSize;
+
+        // unblocked factorization of the panel with partial pivoting
+        for(int j = k; j < k + jb; ++j)
         {
-            double ratio = matrixCPU[i * effectiveDimension + d]
-                           / matrixCPU[d * effectiveDimension + d];
-            for(unsigned int j = d; j < effectiveDimension; j++)
+            int p = j;
+            double best = fabs(matrixCPU[j * n + j]);
+            for(int r = j + 1; r < dimension; ++r)
             {
-                matrixCPU[ i * effectiveDimension + j]
-                -= matrixCPU[d * effectiveDimension + j] * ratio;
-                if(j == d)
+                double v = fabs(matrixCPU[r * n + j]);
+                if(v > best)
                 {
-                    matrixCPU[i * effectiveDimension + j] = ratio;
+                    best = v;
+                    p = r;
                 }
             }
+            pivot[j] = p;
+            if(p != j)
+            {
+                swapRowRange(matrixCPU, n, j, p, k, k + jb);
+            }
+
+            double d = matrixCPU[j * n + j];
+            if(d == 0.0)
+            {
+                continue;
+            }
+            const double* prow = matrixCPU + j * n;
+            for(int r = j + 1; r < dimension; ++r)
+            {
+                double* row = matrixCPU + r * n;
+                double l = row[j] / d;
+                row[j] = l;
+                for(int c = j + 1; c < k + jb; ++c)
+                {
+                    row[c] -= l * prow[c];
+                }
+            }
+        }
+
+        // split the columns outside the panel, right part in groups of 4
+        int right = dimension - k - jb;
+        int rightGroups = (right + 3) / 4;
+        for(int t = 0; t < threads; ++t)
+        {
+            work[t].a = matrixCPU;
+            work[t].pivot = pivot;
+            work[t].n = dimension;
+            work[t].k = k;
+            work[t].jb = jb;
+            work[t].leftBegin = (int)((size_t)k * t / threads);
+            work[t].leftEnd = (int)((size_t)k * (t + 1) / threads);
+            int g0 = (int)((size_t)rightGroups * t / threads);
+            int g1 = (int)((size_t)rightGroups * (t + 1) / threads);
+            work[t].rightBegin = k + jb + 4 * g0;
+            work[t].rightEnd = k + jb + 4 * g1 < dimension ? k + jb + 4 * g1 : dimension;
+        }
+
+        // the calling thread takes the last share
+        SDKThread* workers = new SDKThread[threads - 1];
+        for(int t = 0; t < threads - 1; ++t)
+        {
+            workers[t].create(::luUpdateThread, (void *)(work + t));
+        }
+        luUpdateThread(work + threads - 1);
+        for(int t = 0; t < threads - 1; ++t)
+        {
+            workers[t].join();
+        }
+        delete []workers;
+    }
+
+    for(int t = 0; t < threads; ++t)
+    {
+        delete []work[t].packed;
+    }
+    delete []work;
+}
+
+void LUD::LUSolveCPU(const double* lu, const cl_int* pivot, double* b,
+                     const cl_int dimension, const cl_int count)
+{
+    size_t n = dimension;
+
+    for(int j = 0; j < dimension; ++j)
+    {
+        if(pivot[j] != j)
+        {
+            swapRowRange(b, count, j, pivot[j], 0, count);
+        }
+    }
+
+    for(int i = 1; i < dimension; ++i)
+    {
+        double* row = b + i * count;
+        for(int t = 0; t < i; ++t)
+        {
+            double l = lu[i * n + t];
+            for(int c = 0; c < count; ++c)
+            {
+                row[c] -= l * b[t * count + c];
+            }
+        }
+    }
+
+    for(int i = dimension - 1; i >= 0; --i)
+    {
+        double* row = b + i * count;
+        for(int t = i + 1; t < dimension; ++t)
+        {
+            double u = lu[i * n + t];
+            for(int c = 0; c < count; ++c)
+            {
+                row[c] -= u * b[t * count + c];
+            }
+        }
+        for(int c = 0; c < count; ++c)
+        {
+            row[c] /= lu[i * n + i];
         }
     }
 }
 
+double LUD::scaledResidual(const double* a, const double* x, const double* b,
+                           const cl_int dimension, const cl_int count)
+{
+    size_t n = dimension;
+
+    double normA = 0.0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        double sum = 0.0;
+        for(size_t j = 0; j < n; ++j)
+        {
+            sum += fabs(a[i * n + j]);
+        }
+        normA = sum > normA ? sum : normA;
+    }
+
+    double worst = 0.0;
+    for(int c = 0; c < count; ++c)
+    {
+        double normR = 0.0;
+        double normX = 0.0;
+        double normB = 0.0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            double sum = -b[i * count + c];
+            for(size_t j = 0; j < n; ++j)
+            {
+                sum += a[i * n + j] * x[j * count + c];
+            }
+            normR = fabs(sum) > normR ? fabs(sum) : normR;
+            normX = fabs(x[i * count + c]) > normX ? fabs(x[i * count + c]) : normX;
+            normB = fabs(b[i * count + c]) > normB ? fabs(b[i * count + c]) : normB;
+        }
+
+        double residual = normR / ((normA * normX + normB) * n * DBL_EPSILON);
+        // NaN from a singular matrix must fail as well
+        if(!(residual <= worst))
+        {
+            worst = residual;
+        }
+    }
+    return worst;
+}
+
 int LUD::initialize()
 {
     // Call base class Initialize to get default configuration
@@ -560,6 +1192,67 @@ int LUD::initialize()
     sampleArgs->AddOption(iter);
     delete iter;
 
+    Option* blockParam = new Option;
+    CHECK_ALLOCATION(blockParam, "Memory allocation for Option failed\n");
+
+    blockParam->_sVersion = "nb";
+    blockParam->_lVersion = "block";
+    blockParam->_description = "Panel width of the blocked factorization";
+    blockParam->_type = CA_ARG_INT;
+    blockParam->_value = &blockSize;
+
+    sampleArgs->AddOption(blockParam);
+    delete blockParam;
+
+    Option* rhsParam = new Option;
+    CHECK_ALLOCATION(rhsParam, "Memory allocation for Option failed\n");
+
+    rhsParam->_sVersion = "r";
+    rhsParam->_lVersion = "rhs";
+    rhsParam->_description = "Number of right hand sides";
+    rhsParam->_type = CA_ARG_INT;
+    rhsParam->_value = &nrhs;
+
+    sampleArgs->AddOption(rhsParam);
+    delete rhsParam;
+
+    Option* batchParam = new Option;
+    CHECK_ALLOCATION(batchParam, "Memory allocation for Option failed\n");
+
+    batchParam->_sVersion = "b";
+    batchParam->_lVersion = "batch";
+    batchParam->_description = "Number of small systems solved in one launch (0 disables)";
+    batchParam->_type = CA_ARG_INT;
+    batchParam->_value = &batchCount;
+
+    sampleArgs->AddOption(batchParam);
+    delete batchParam;
+
+    Option* batchDimParam = new Option;
+    CHECK_ALLOCATION(batchDimParam, "Memory allocation for Option failed\n");
+
+    batchDimParam->_sVersion = "m";
+    batchDimParam->_lVersion = "batchDimension";
+    batchDimParam->_description = "Dimension of the small systems (at most 32)";
+    batchDimParam->_type = CA_ARG_INT;
+    batchDimParam->_value = &batchDim;
+
+    sampleArgs->AddOption(batchDimParam);
+    delete batchDimParam;
+
+    Option* threadParam = new Option;
+    CHECK_ALLOCATION(threadParam, "Memory allocation for Option failed\n");
+
+    threadParam->_sVersion = "c";
+    threadParam->_lVersion = "cpuThreads";
+    threadParam->_description =
+        "Threads of the reference factorization (0 uses all cores)";
+    threadParam->_type = CA_ARG_INT;
+    threadParam->_value = &cpuThreads;
+
+    sampleArgs->AddOption(threadParam);
+    delete threadParam;
+
     return SDK_SUCCESS;
 }
 
@@ -594,6 +1287,10 @@ int LUD::run()
         }
     }
 
+    factorKernelTime = 0;
+    solveKernelTime = 0;
+    batchKernelTime = 0;
+
     int timer = sampleTimer->createTimer();
     sampleTimer->resetTimer(timer);
     sampleTimer->startTimer(timer);
@@ -614,6 +1311,9 @@ int LUD::run()
 
     sampleTimer->stopTimer(timer);
     totalKernelTime = (double)(sampleTimer->readTimer(timer)) / iterations;
+    factorKernelTime /= iterations;
+    solveKernelTime /= iterations;
+    batchKernelTime /= iterations;
 
     if(!sampleArgs->quiet)
         printArray<double>(
@@ -633,10 +1333,12 @@ int LUD::verifyResults()
         int refTimer = sampleTimer->createTimer();
         sampleTimer->resetTimer(refTimer);
         sampleTimer->startTimer(refTimer);
-        LUDCPUReference(matrixCPU, effectiveDimension);
+        LUDCPUReference(matrixCPU, pivotCPU, actualDimension);
         sampleTimer->stopTimer(refTimer);
         referenceKernelTime = sampleTimer->readTimer(refTimer);
 
+        LUSolveCPU(matrixCPU, pivotCPU, solutionCPU, actualDimension, nrhs);
+
         if(!sampleArgs->quiet)
             printArray<double>(
                 "LU Matrix CPU Reference",
@@ -644,11 +1346,40 @@ int LUD::verifyResults()
                 actualDimension,
                 actualDimension);
 
+        /*
+         * Pivoting may pick different rows on ties, so the factors are not
+         * compared. Both solves must instead have a small backward error.
+         */
+        double cpuResidual = scaledResidual(input, solutionCPU, rhs,
+                                            actualDimension, nrhs);
+        double gpuResidual = scaledResidual(input, solutionGPU, rhs,
+                                            actualDimension, nrhs);
+        double batchResidual = 0.0;
+        for(int s = 0; s < batchCount; ++s)
+        {
+            double residual = scaledResidual(
+                                  batchInput + (size_t)s * batchDim * batchDim,
+                                  batchSolution + (size_t)s * batchDim,
+                                  batchRhs + (size_t)s * batchDim,
+                                  batchDim,
+                                  1);
+            if(!(residual <= batchResidual))
+            {
+                batchResidual = residual;
+            }
+        }
+
+        std::cout << "Scaled residual CPU : " << cpuResidual << std::endl;
+        std::cout << "Scaled residual GPU : " << gpuResidual << std::endl;
+        if(batchCount)
+        {
+            std::cout << "Scaled residual batch : " << batchResidual << std::endl;
+        }
+
         // compare the results and see if they match
-        if(compare(
-                    matrixGPU,
-                    matrixCPU,
-                    effectiveDimension * effectiveDimension))
+        if(cpuResidual < RESIDUAL_THRESHOLD &&
+                gpuResidual < RESIDUAL_THRESHOLD &&
+                batchResidual < RESIDUAL_THRESHOLD)
         {
             std::cout << "Passed!\n" << std::endl;
             return SDK_SUCCESS;
@@ -666,17 +1397,39 @@ void LUD::printStats()
 {
     if(sampleArgs->timing)
     {
-        std::string strArray[4] = {"WxH" , "Time(sec)", "[Transfer+Kernel]Time(sec)"};
-        std::string stats[3];
+        std::string strArray[11] =
+        {
+            "WxH", "Block", "RHS", "Time(sec)", "[Transfer+Kernel]Time(sec)",
+            "LU GFLOPS", "Solve GFLOPS", "Batch", "Batch GFLOPS",
+            "CPU Threads", "CPU LU GFLOPS"
+        };
+        std::string stats[11];
 
         sampleTimer->totalTime = setupTime + totalKernelTime;
 
+        double n = actualDimension;
+        double m = batchDim;
+        double luFlops = 2.0 / 3.0 * n * n * n;
+        double solveFlops = 2.0 * n * n * nrhs;
+        double batchFlops = batchCount * (2.0 / 3.0 * m * m * m + 2.0 * m * m);
+
         stats[0]  = toString(actualDimension, std::dec)
                     + "x" + toString(actualDimension, std::dec);
-        stats[1]  = toString(sampleTimer->totalTime, std::dec);
-        stats[2]  = toString(totalKernelTime, std::dec);
-
-        printStatistics(strArray, stats, 3);
+        stats[1]  = toString(blockSize, std::dec);
+        stats[2]  = toString(nrhs, std::dec);
+        stats[3]  = toString(sampleTimer->totalTime, std::dec);
+        stats[4]  = toString(totalKernelTime, std::dec);
+        stats[5]  = toString(luFlops / factorKernelTime * 1e-9, std::dec);
+        stats[6]  = toString(solveFlops / solveKernelTime * 1e-9, std::dec);
+        stats[7]  = toString(batchCount, std::dec)
+                    + "x" + toString(batchDim, std::dec);
+        stats[8]  = batchCount ?
+                    toString(batchFlops / batchKernelTime * 1e-9, std::dec) : "-";
+        stats[9]  = toString(cpuThreads, std::dec);
+        stats[10] = toString(luFlops / referenceKernelTime * 1e-9, std::dec);
+
+        // the host numbers exist only when the reference ran
+        printStatistics(strArray, stats, sampleArgs->verify ? 11 : 9);
     }
 }
 
@@ -685,11 +1438,23 @@ int LUD::cleanup()
     // Releases OpenCL resources (Context, Memory etc.)
     cl_int status;
 
-    status = clReleaseKernel(kernelLUD);
-    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernelLUD)");
+    status = clReleaseKernel(kernelPanel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernelPanel)");
+
+    status = clReleaseKernel(kernelSwap);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernelSwap)");
+
+    status = clReleaseKernel(kernelTrsmLower);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernelTrsmLower)");
+
+    status = clReleaseKernel(kernelTrsmUpper);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernelTrsmUpper)");
 
-    status = clReleaseKernel(kernelCombine);
-    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernelCombine)");
+    status = clReleaseKernel(kernelGemm);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernelGemm)");
+
+    status = clReleaseKernel(kernelBatch);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernelBatch)");
 
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.(program)");
@@ -697,8 +1462,20 @@ int LUD::cleanup()
     status = clReleaseMemObject(inplaceBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(inplaceBuffer)");
 
-    status = clReleaseMemObject(inputBuffer2);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(inputBuffer2)");
+    status = clReleaseMemObject(pivotBuffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(pivotBuffer)");
+
+    status = clReleaseMemObject(rhsBuffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(rhsBuffer)");
+
+    if(batchCount)
+    {
+        status = clReleaseMemObject(batchInputBuffer);
+        CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(batchInputBuffer)");
+
+        status = clReleaseMemObject(batchRhsBuffer);
+        CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(batchRhsBuffer)");
+    }
 
     status = clReleaseCommandQueue(commandQueue);
     CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.(commandQueue)");
@@ -718,6 +1495,14 @@ int LUD::cleanup()
 #endif
 
     FREE(matrixCPU);
+    FREE(pivotCPU);
+    FREE(pivotGPU);
+    FREE(rhs);
+    FREE(solutionCPU);
+    FREE(solutionGPU);
+    FREE(batchInput);
+    FREE(batchRhs);
+    FREE(batchSolution);
     FREE(devices);
 
     return SDK_SUCCESS;
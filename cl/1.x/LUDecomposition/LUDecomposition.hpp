@@ -13,6 +13,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
  OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************************************/
+
 #ifndef LUDECOMPOSITION_HPP_
 #define LUDECOMPOSITION_HPP_
 
@@ -25,14 +26,25 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 using namespace appsdk;
 
-#define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.3"
+#define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.4"
 
 #define KERNELFILE "LUDecomposition_Kernels.cl"
 
+/* must match the defines in LUDecomposition_Kernels.cl */
+#define TILE 16                         /**< work-group of the update kernel is TILE x TILE */
+#define WPT 4                           /**< outputs per work-item in each direction */
+#define BLOCK (TILE * WPT)              /**< block of C computed by one work-group */
+
+#define PANEL_GROUP 256                 /**< maximum work-group size of the panel kernel */
+#define BATCH_MAX_DIM 32                /**< largest system of the batched solver */
+#define CPU_COLUMN_CHUNK 256            /**< columns updated together by the host GEMM */
+
 /**
  * LUD
  * Class implements OpenCL LU Decomposition sample
-
+ * Right-looking blocked LU with partial pivoting (P * A = L * U),
+ * forward/back substitution for several right hand sides and
+ * a batched solver for many small systems
  */
 class LUD
 {
@@ -42,25 +54,44 @@ class LUD
         cl_double     totalKernelTime;      /**< Time for kernel execution */
         cl_double    totalProgramTime;      /**< Time for program execution */
         cl_double referenceKernelTime;      /**< Time for reference implementation */
+        cl_double      factorKernelTime;    /**< Time for the device factorization */
+        cl_double       solveKernelTime;    /**< Time for the device substitutions */
+        cl_double       batchKernelTime;    /**< Time for the batched solver */
         cl_int
-        effectiveDimension;      /**< effectiveDimension(square matrix) of the input matrix */
-        cl_int
-        actualDimension;      /**< actual dimension (might not be in 2^n form) of input matrix */
+        actualDimension;      /**< dimension of the (square) input matrix */
+        cl_int              blockSize;      /**< panel width of the blocked factorization */
+        cl_int                   nrhs;      /**< number of right hand sides */
+        cl_int             batchCount;      /**< number of small systems, 0 disables the batch */
+        cl_int               batchDim;      /**< dimension of the small systems */
+        cl_int             cpuThreads;      /**< threads of the host factorization */
         cl_double              *input;      /**< Input array */
         cl_double
         *matrixCPU;      /**< Inplace Array for CPU for reference implementation */
         cl_double          *matrixGPU;      /**< Inplace Array for GPU */
-        cl_int              blockSize;       /**< actual dimension / vector size */
+        cl_int              *pivotCPU;      /**< Row interchanges of the reference */
+        cl_int              *pivotGPU;      /**< Row interchanges of the device */
+        cl_double                *rhs;      /**< Right hand sides, n x nrhs */
+        cl_double        *solutionCPU;      /**< Solutions of the reference */
+        cl_double        *solutionGPU;      /**< Solutions of the device */
+        cl_double         *batchInput;      /**< Small matrices, batchCount x batchDim^2 */
+        cl_double           *batchRhs;      /**< Right hand sides of the small systems */
+        cl_double      *batchSolution;      /**< Solutions of the small systems */
         cl_context            context;      /**< CL context */
         cl_device_id         *devices;      /**< CL device list */
-        cl_mem          inplaceBuffer;      /**< CL memory buffer */
-        cl_mem           inputBuffer2;      /**< CL memory output Buffer */
+        cl_mem          inplaceBuffer;      /**< CL memory buffer, factorized in place */
+        cl_mem            pivotBuffer;      /**< CL memory buffer for the row interchanges */
+        cl_mem              rhsBuffer;      /**< CL memory buffer, solved in place */
+        cl_mem       batchInputBuffer;      /**< CL memory buffer for the small matrices */
+        cl_mem         batchRhsBuffer;      /**< CL memory buffer for the small right hand sides */
         cl_command_queue commandQueue;      /**< CL command queue */
         cl_program            program;      /**< CL program  */
-        cl_kernel           kernelLUD;      /**< CL kernel LU Decomposition*/
-        cl_kernel       kernelCombine;      /**< CL Kerenl Combine */
-        cl_ulong    localMemoryNeeded;
-        bool                   useLDS;
+        cl_kernel         kernelPanel;      /**< CL kernel factorizing a panel */
+        cl_kernel          kernelSwap;      /**< CL kernel applying row interchanges */
+        cl_kernel     kernelTrsmLower;      /**< CL kernel unit lower triangular solve */
+        cl_kernel     kernelTrsmUpper;      /**< CL kernel upper triangular solve */
+        cl_kernel          kernelGemm;      /**< CL kernel C -= A * B */
+        cl_kernel         kernelBatch;      /**< CL kernel batched small solver */
+        size_t             panelGroup;      /**< work-group size of the panel kernel */
         int
         iterations;    /**< Number of iterations for kernel execution */
         SDKDeviceInfo
@@ -85,12 +116,27 @@ class LUD
             input               = NULL;
             matrixCPU           = NULL;
             matrixGPU           = NULL;
+            pivotCPU            = NULL;
+            pivotGPU            = NULL;
+            rhs                 = NULL;
+            solutionCPU         = NULL;
+            solutionGPU         = NULL;
+            batchInput          = NULL;
+            batchRhs            = NULL;
+            batchSolution       = NULL;
             devices             = NULL;
             actualDimension     = 16;
-            effectiveDimension  = 16;
-            blockSize           = effectiveDimension/ 4;
+            blockSize           = 64;
+            nrhs                = 4;
+            batchCount          = 1024;
+            batchDim            = 16;
+            cpuThreads          = 0;
             setupTime           = 0;
             totalKernelTime     = 0;
+            referenceKernelTime = 0;
+            factorKernelTime    = 0;
+            solveKernelTime     = 0;
+            batchKernelTime     = 0;
             iterations          = 1;
             sampleArgs = new CLCommandArgs() ;
             sampleTimer = new SDKTimer();
@@ -127,15 +173,107 @@ class LUD
         int runCLKernels();
 
         /**
-         * Reference CPU implementation of matrix transpose
-         * @param output stores the transpose of the input
-         * @param input  input matrix
-         * @param width  width of the input matrix
-         * @param height height of the array
+         * Enqueue the blocked factorization of inplaceBuffer
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int enqueueFactorization();
+
+        /**
+         * Enqueue the substitutions solving rhsBuffer in place
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int enqueueSolve();
+
+        /**
+         * Enqueue kernelSwapRows
+         * @param buffer matrix
+         * @param off offset of the first element
+         * @param ld leading dimension
+         * @param first first row interchange applied
+         * @param count number of row interchanges
+         * @param ncols number of columns
+         * @param skipBegin first column left untouched
+         * @param skipEnd end of the columns left untouched
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int enqueueSwapRows(cl_mem buffer, cl_ulong off, cl_int ld,
+                            cl_int first, cl_int count, cl_int ncols,
+                            cl_int skipBegin, cl_int skipEnd);
+
+        /**
+         * Enqueue kernelTrsmLower or kernelTrsmUpper
+         * on the jb x jb triangle at aoff of inplaceBuffer
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int enqueueTrsm(cl_kernel kernel, cl_ulong aoff,
+                        cl_mem b, cl_ulong boff, cl_int ldb,
+                        cl_int jb, cl_int ncols);
+
+        /**
+         * Enqueue kernelGemmUpdate, C -= A * B with A read from inplaceBuffer
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int enqueueGemm(cl_ulong aoff, cl_mem b, cl_ulong boff, cl_int ldb,
+                        cl_mem c, cl_ulong coff, cl_int ldc,
+                        cl_int m, cl_int ncols, cl_int kk);
+
+        /**
+         * Copy host memory to a buffer through a mapping
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int writeBuffer(cl_mem buffer, const void* data, size_t size);
+
+        /**
+         * Copy a buffer to host memory through a mapping
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int readBuffer(cl_mem buffer, void* data, size_t size);
+
+        /**
+         * Reference CPU implementation of the blocked LU with partial pivoting.
+         * Panels are factorized by the calling thread, the row interchanges,
+         * triangular solves and trailing updates are split by columns over
+         * cpuThreads threads
+         * @param matrixCPU matrix, overwritten by L and U
+         * @param pivot row interchanges
+         * @param dimension dimension of the matrix
          */
         void LUDCPUReference(
             double *matrixCPU,
-            const cl_uint effectiveDimension);
+            cl_int *pivot,
+            const cl_int dimension);
+
+        /**
+         * Forward/back substitution on the host
+         * @param lu factors from LUDCPUReference
+         * @param pivot row interchanges
+         * @param b right hand sides, n x nrhs, overwritten by the solutions
+         * @param dimension dimension of the matrix
+         * @param count number of right hand sides
+         */
+        void LUSolveCPU(
+            const double *lu,
+            const cl_int *pivot,
+            double *b,
+            const cl_int dimension,
+            const cl_int count);
+
+        /**
+         * Scaled residual max_j |A x_j - b_j| / ((|A| |x_j| + |b_j|) n eps)
+         * in the infinity norm, a correct solve gives values of order 1
+         * @param a matrix
+         * @param x solutions, n x count
+         * @param b right hand sides, n x count
+         * @param dimension dimension of the matrix
+         * @param count number of right hand sides
+         * @return largest scaled residual
+         */
+        double scaledResidual(
+            const double *a,
+            const double *x,
+            const double *b,
+            const cl_int dimension,
+            const cl_int count);
 
         /**
          * Override from SDKSample. Print sample stats.
@@ -179,4 +317,3 @@ class LUD
 
 };
 #endif
-
@@ -20,94 +20,403 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #pragma OPENCL EXTENSION cl_amd_fp64 : enable
 #endif
 
-#define VECTOR_SIZE 4
-
-
-/* Kernel to decompose the matrix in LU parts
-    input taken from inlacematrix
-    param d tells which iteration of the kernel is executing
-    output matrix U is generated in the inplacematrix itself
-    output matrix L is generated in the LMatrix*/
-
-__kernel void kernelLUDecompose(__global double4* LMatrix,
-                           __global double4* inplaceMatrix,
-                            int d,
-                            __local double* ratio)
-{	
-    //get the global id of the work item
-    int y = get_global_id(1);
-    int x = get_global_id(0);
-    int lidx = get_local_id(0);
-    int lidy = get_local_id(1);
-    //the range in x axis is dimension / 4
-    int xdimension = get_global_size(0) + d / VECTOR_SIZE;
-    int D = d % VECTOR_SIZE;
-    //printf(" Thread ID %d %d local ID %d  %d\n",x,y,lidx,lidy);
-    if(get_local_id(0) == 0)
+/* must match the defines in LUDecomposition.hpp */
+#define TILE 16                 /* work-group of the update kernel is TILE x TILE */
+#define WPT 4                   /* outputs per work-item in each direction */
+#define BLOCK (TILE * WPT)      /* block of C computed by one work-group */
+
+/*
+ * All matrices are row-major. A matrix argument is a buffer, the offset
+ * of its first element and its leading dimension (row pitch in elements).
+ */
+
+
+/*  Factorizes the panel A[k:n, k:k+jb] with partial pivoting.
+    Runs as a single work-group whose size is a power of 2.
+    For every column the pivot is the first row holding the largest
+    magnitude, its row index is stored in ipiv. Rows are swapped only
+    inside the panel, kernelSwapRows applies the pivots to the other columns.
+    param pivVal, pivIdx local scratch for the pivot search, one per work-item */
+
+__kernel void kernelPanelFactor(__global double* A,
+                                __global int* ipiv,
+                                const int n,
+                                const int k,
+                                const int jb,
+                                __local double* pivVal,
+                                __local int* pivIdx)
+{
+    int lid = get_local_id(0);
+    int groupSize = get_local_size(0);
+
+    for(int j = k; j < k + jb; ++j)
     {
-        
-        //ratio needs to be calculated only once per workitem
-        (D == 0) ? (ratio[lidy] = inplaceMatrix[ y * xdimension + d / VECTOR_SIZE].s0 / inplaceMatrix[ d * xdimension + d / VECTOR_SIZE].s0):1;
-        (D == 1) ? (ratio[lidy] = inplaceMatrix[ y * xdimension + d / VECTOR_SIZE].s1 / inplaceMatrix[ d * xdimension + d / VECTOR_SIZE].s1):1;
-        (D == 2) ? (ratio[lidy] = inplaceMatrix[ y * xdimension + d / VECTOR_SIZE].s2 / inplaceMatrix[ d * xdimension + d / VECTOR_SIZE].s2):1;
-        (D == 3) ? (ratio[lidy] = inplaceMatrix[ y * xdimension + d / VECTOR_SIZE].s3 / inplaceMatrix[ d * xdimension + d / VECTOR_SIZE].s3):1;
+        // per work-item candidate
+        double best = -1.0;
+        int bestRow = j;
+        for(int r = j + lid; r < n; r += groupSize)
+        {
+            double v = fabs(A[(size_t)r * n + j]);
+            if(v > best)
+            {
+                best = v;
+                bestRow = r;
+            }
+        }
+        pivVal[lid] = best;
+        pivIdx[lid] = bestRow;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // tree reduction, ties go to the lower row
+        for(int s = groupSize / 2; s > 0; s >>= 1)
+        {
+            if(lid < s)
+            {
+                double v = pivVal[lid + s];
+                int r = pivIdx[lid + s];
+                if(v > pivVal[lid] || (v == pivVal[lid] && r < pivIdx[lid]))
+                {
+                    pivVal[lid] = v;
+                    pivIdx[lid] = r;
+                }
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        int p = pivIdx[0];
+        if(lid == 0)
+        {
+            ipiv[j] = p;
+        }
+
+        // swap rows j and p inside the panel
+        if(p != j)
+        {
+            for(int c = k + lid; c < k + jb; c += groupSize)
+            {
+                double t = A[(size_t)j * n + c];
+                A[(size_t)j * n + c] = A[(size_t)p * n + c];
+                A[(size_t)p * n + c] = t;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+        // scale the column below the pivot and update the rest of the panel
+        double pivot = A[(size_t)j * n + j];
+        if(pivot != 0.0)
+        {
+            double rcp = 1.0 / pivot;
+            for(int r = j + 1 + lid; r < n; r += groupSize)
+            {
+                size_t row = (size_t)r * n;
+                double l = A[row + j] * rcp;
+                A[row + j] = l;
+                for(int c = j + 1; c < k + jb; ++c)
+                {
+                    A[row + c] -= l * A[(size_t)j * n + c];
+                }
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
     }
-    
-    barrier(CLK_LOCAL_MEM_FENCE);
-    
-    //check which workitems need to be included for computation
-    if(y >= d + 1 && ((x + 1) * VECTOR_SIZE) > d)
+}
+
+
+/*  Applies the row interchanges ipiv[first:first+count] to the columns
+    of A, one work-item per column. Columns in [skipBegin, skipEnd)
+    were already swapped by kernelPanelFactor. */
+
+__kernel void kernelSwapRows(__global double* A,
+                             const ulong aoff,
+                             const int lda,
+                             __global const int* ipiv,
+                             const int first,
+                             const int count,
+                             const int ncols,
+                             const int skipBegin,
+                             const int skipEnd)
+{
+    int c = get_global_id(0);
+    if(c >= ncols || (c >= skipBegin && c < skipEnd))
     {
-        double4 result;
-        
-        //the vectorized part begins here
+        return;
+    }
+
+    __global double* a = A + aoff + c;
+    for(int j = first; j < first + count; ++j)
+    {
+        int p = ipiv[j];
+        if(p != j)
         {
-            result.s0 = inplaceMatrix[y * xdimension + x].s0 - ratio[lidy] * inplaceMatrix[ d * xdimension + x].s0;
-            result.s1 = inplaceMatrix[y * xdimension + x].s1 - ratio[lidy] * inplaceMatrix[ d * xdimension + x].s1;
-            result.s2 = inplaceMatrix[y * xdimension + x].s2 - ratio[lidy] * inplaceMatrix[ d * xdimension + x].s2;
-            result.s3 = inplaceMatrix[y * xdimension + x].s3 - ratio[lidy] * inplaceMatrix[ d * xdimension + x].s3;
+            double t = a[(size_t)j * lda];
+            a[(size_t)j * lda] = a[(size_t)p * lda];
+            a[(size_t)p * lda] = t;
         }
-        
-        
-        if(x == d / VECTOR_SIZE)
+    }
+}
+
+
+/*  B := inv(L) * B where L is the jb x jb unit lower triangle at
+    A + aoff and B is jb x ncols. One work-item per column of B.
+    Used for the U12 block of the factorization and the forward
+    substitution of the solve. */
+
+__kernel void kernelTrsmLower(__global const double* A,
+                              const ulong aoff,
+                              const int lda,
+                              __global double* B,
+                              const ulong boff,
+                              const int ldb,
+                              const int jb,
+                              const int ncols)
+{
+    int c = get_global_id(0);
+    if(c >= ncols)
+    {
+        return;
+    }
+
+    __global const double* L = A + aoff;
+    __global double* b = B + boff + c;
+    for(int i = 1; i < jb; ++i)
+    {
+        double sum = b[(size_t)i * ldb];
+        for(int t = 0; t < i; ++t)
         {
-            (D == 0) ? (LMatrix[y * xdimension + x].s0 = ratio[lidy]) : (inplaceMatrix[y * xdimension + x].s0 = result.s0);
-            (D == 1) ? (LMatrix[y * xdimension + x].s1 = ratio[lidy]) : (inplaceMatrix[y * xdimension + x].s1 = result.s1);
-            (D == 2) ? (LMatrix[y * xdimension + x].s2 = ratio[lidy]) : (inplaceMatrix[y * xdimension + x].s2 = result.s2);
-            (D == 3) ? (LMatrix[y * xdimension + x].s3 = ratio[lidy]) : (inplaceMatrix[y * xdimension + x].s3 = result.s3);
+            sum -= L[(size_t)i * lda + t] * b[(size_t)t * ldb];
         }
-        else
+        b[(size_t)i * ldb] = sum;
+    }
+}
+
+
+/*  B := inv(U) * B where U is the jb x jb upper triangle (with its
+    diagonal) at A + aoff and B is jb x ncols. One work-item per column
+    of B. Used for the back substitution of the solve. */
+
+__kernel void kernelTrsmUpper(__global const double* A,
+                              const ulong aoff,
+                              const int lda,
+                              __global double* B,
+                              const ulong boff,
+                              const int ldb,
+                              const int jb,
+                              const int ncols)
+{
+    int c = get_global_id(0);
+    if(c >= ncols)
+    {
+        return;
+    }
+
+    __global const double* U = A + aoff;
+    __global double* b = B + boff + c;
+    for(int i = jb - 1; i >= 0; --i)
+    {
+        double sum = b[(size_t)i * ldb];
+        for(int t = i + 1; t < jb; ++t)
         {
-            inplaceMatrix[y * xdimension + x].s0 = result.s0;
-            inplaceMatrix[y * xdimension + x].s1 = result.s1;
-            inplaceMatrix[y * xdimension + x].s2 = result.s2;
-            inplaceMatrix[y * xdimension + x].s3 = result.s3;
+            sum -= U[(size_t)i * lda + t] * b[(size_t)t * ldb];
         }
+        b[(size_t)i * ldb] = sum / U[(size_t)i * lda + i];
     }
 }
 
 
-/*	This function will combine L & U into 1 matrix
-    param: inplace matrix contains the U matrix generated by above kernel
-    param: LMatrix contains L MAtrix
-    The kernel will combine them together as one matrix
-    We ignore the diagonal elements of LMatrix during this as 
-    they will all be zero
-    */
+/*  C := C - A * B, C is m x ncols, A is m x kk and B is kk x ncols.
+    This is the trailing update of the factorization
+    (A22 -= L21 * U12) and the block update of both substitutions.
+    Every work-group computes a BLOCK x BLOCK block of C, staging
+    TILE wide slices of A and B in local memory, and every work-item
+    keeps a WPT x WPT block of C in registers.
+    A, B and C may be the same buffer as long as the blocks of A and B
+    do not overlap C. */
 
-
-__kernel void kernelLUCombine(__global double* LMatrix,
-                         __global double* inplaceMatrix)
+__kernel __attribute__((reqd_work_group_size(TILE, TILE, 1)))
+void kernelGemmUpdate(__global const double* A,
+                      const ulong aoff,
+                      const int lda,
+                      __global const double* B,
+                      const ulong boff,
+                      const int ldb,
+                      __global double* C,
+                      const ulong coff,
+                      const int ldc,
+                      const int m,
+                      const int ncols,
+                      const int kk)
 {
-    int i = get_global_id(1);
-    int j = get_global_id(0);
-    int gidx = get_group_id(0);
-    int gidy = get_group_id(1);
-    int dimension = get_global_size(0);
-    if(i>j )
+    __local double As[BLOCK][TILE + 1];
+    __local double Bs[TILE][BLOCK];
+
+    int tx = get_local_id(0);
+    int ty = get_local_id(1);
+    int row0 = get_group_id(1) * BLOCK;
+    int col0 = get_group_id(0) * BLOCK;
+
+    double acc[WPT][WPT];
+    for(int i = 0; i < WPT; ++i)
     {
-        int dimension = get_global_size(0);
-        inplaceMatrix[i * dimension + j] = LMatrix[i * dimension + j];
+        for(int j = 0; j < WPT; ++j)
+        {
+            acc[i][j] = 0.0;
+        }
+    }
+
+    for(int t = 0; t < kk; t += TILE)
+    {
+        for(int i = 0; i < WPT; ++i)
+        {
+            int r = ty + i * TILE;
+            int gr = row0 + r;
+            As[r][tx] = (gr < m && t + tx < kk) ?
+                        A[aoff + (size_t)gr * lda + t + tx] : 0.0;
+
+            int c = tx + i * TILE;
+            int gc = col0 + c;
+            Bs[ty][c] = (gc < ncols && t + ty < kk) ?
+                        B[boff + (size_t)(t + ty) * ldb + gc] : 0.0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for(int p = 0; p < TILE; ++p)
+        {
+            double b[WPT];
+            for(int j = 0; j < WPT; ++j)
+            {
+                b[j] = Bs[p][tx + j * TILE];
+            }
+            for(int i = 0; i < WPT; ++i)
+            {
+                double a = As[ty + i * TILE][p];
+                for(int j = 0; j < WPT; ++j)
+                {
+                    acc[i][j] = fma(-a, b[j], acc[i][j]);
+                }
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for(int i = 0; i < WPT; ++i)
+    {
+        int gr = row0 + ty + i * TILE;
+        if(gr >= m)
+        {
+            continue;
+        }
+        for(int j = 0; j < WPT; ++j)
+        {
+            int gc = col0 + tx + j * TILE;
+            if(gc < ncols)
+            {
+                C[coff + (size_t)gr * ldc + gc] += acc[i][j];
+            }
+        }
     }
 }
 
+
+/*  Factorizes and solves a batch of small systems A x = b of dimension
+    m, one work-group per system with one work-item per row.
+    The matrix and the right hand side are staged in local memory,
+    elimination with partial pivoting is applied to both and the
+    solution is found by back substitution.
+    On exit A holds the LU factors of the permuted matrix and B the
+    solutions.
+    param As, bs local scratch of m * m and m doubles
+    param piv local scratch holding the current pivot row */
+
+__kernel void kernelBatchedLUSolve(__global double* A,
+                                   __global double* B,
+                                   const int m,
+                                   __local double* As,
+                                   __local double* bs,
+                                   __local int* piv)
+{
+    int sys = get_group_id(0);
+    int r = get_local_id(0);
+    __global double* a = A + (size_t)sys * m * m;
+    __global double* b = B + (size_t)sys * m;
+
+    if(r < m)
+    {
+        for(int c = 0; c < m; ++c)
+        {
+            As[r * m + c] = a[r * m + c];
+        }
+        bs[r] = b[r];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(int j = 0; j < m; ++j)
+    {
+        // the systems are small, a serial search is cheaper than a reduction
+        if(r == 0)
+        {
+            int p = j;
+            double best = fabs(As[j * m + j]);
+            for(int i = j + 1; i < m; ++i)
+            {
+                double v = fabs(As[i * m + j]);
+                if(v > best)
+                {
+                    best = v;
+                    p = i;
+                }
+            }
+            piv[0] = p;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        int p = piv[0];
+        if(p != j && r < m)
+        {
+            double t = As[j * m + r];
+            As[j * m + r] = As[p * m + r];
+            As[p * m + r] = t;
+            if(r == 0)
+            {
+                t = bs[j];
+                bs[j] = bs[p];
+                bs[p] = t;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if(r > j && r < m && As[j * m + j] != 0.0)
+        {
+            double l = As[r * m + j] / As[j * m + j];
+            As[r * m + j] = l;
+            for(int c = j + 1; c < m; ++c)
+            {
+                As[r * m + c] -= l * As[j * m + c];
+            }
+            bs[r] -= l * bs[j];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for(int j = m - 1; j >= 0; --j)
+    {
+        if(r == 0)
+        {
+            bs[j] /= As[j * m + j];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if(r < j)
+        {
+            bs[r] -= As[r * m + j] * bs[j];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(r < m)
+    {
+        for(int c = 0; c < m; ++c)
+        {
+            a[r * m + c] = As[r * m + c];
+        }
+        b[r] = bs[r];
+    }
+}
@@ -263,6 +263,207 @@ int min(int a1, int a2)
 }
 #endif
 
+/**
+* Double-double arithmetic for the reference orbit of deep zooms,
+* a value is hi + lo with |lo| <= ulp(hi) / 2
+*/
+struct DoubleDouble
+{
+    double hi;
+    double lo;
+};
+
+static inline DoubleDouble quickTwoSum(double a, double b)
+{
+    DoubleDouble r;
+    r.hi = a + b;
+    r.lo = b - (r.hi - a);
+    return r;
+}
+
+static inline DoubleDouble twoSum(double a, double b)
+{
+    DoubleDouble r;
+    r.hi = a + b;
+    double bb = r.hi - a;
+    r.lo = (a - (r.hi - bb)) + (b - bb);
+    return r;
+}
+
+static inline void split(double a, double &hi, double &lo)
+{
+    double t = 134217729.0 * a;             // 2^27 + 1
+    hi = t - (t - a);
+    lo = a - hi;
+}
+
+static inline DoubleDouble twoProd(double a, double b)
+{
+    DoubleDouble r;
+    double ah, al, bh, bl;
+    r.hi = a * b;
+    split(a, ah, al);
+    split(b, bh, bl);
+    r.lo = ((ah * bh - r.hi) + ah * bl + al * bh) + al * bl;
+    return r;
+}
+
+static inline DoubleDouble ddAdd(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble s = twoSum(a.hi, b.hi);
+    return quickTwoSum(s.hi, s.lo + a.lo + b.lo);
+}
+
+static inline DoubleDouble ddSub(DoubleDouble a, DoubleDouble b)
+{
+    b.hi = -b.hi;
+    b.lo = -b.lo;
+    return ddAdd(a, b);
+}
+
+static inline DoubleDouble ddMul(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble p = twoProd(a.hi, b.hi);
+    return quickTwoSum(p.hi, p.lo + a.hi * b.lo + a.lo * b.hi);
+}
+
+static inline DoubleDouble ddDiv(DoubleDouble a, DoubleDouble b)
+{
+    double q1 = a.hi / b.hi;
+    DoubleDouble r = ddSub(a, ddMul(b, quickTwoSum(q1, 0.0)));
+    double q2 = r.hi / b.hi;
+    r = ddSub(r, ddMul(b, quickTwoSum(q2, 0.0)));
+    double q3 = r.hi / b.hi;
+    return ddAdd(quickTwoSum(q1, q2), quickTwoSum(q3, 0.0));
+}
+
+/**
+* Parse a decimal number ("-0.7436438870371587047521915", "1.5e-20")
+* without rounding it to double first
+*/
+static DoubleDouble ddFromString(const std::string &str)
+{
+    DoubleDouble ten = {10.0, 0.0};
+    DoubleDouble value = {0.0, 0.0};
+    size_t pos = 0;
+    bool negative = false;
+    int exponent = 0;
+
+    if(pos < str.size() && (str[pos] == '-' || str[pos] == '+'))
+    {
+        negative = str[pos++] == '-';
+    }
+    bool fraction = false;
+    for(; pos < str.size(); pos++)
+    {
+        if(str[pos] == '.' && !fraction)
+        {
+            fraction = true;
+            continue;
+        }
+        if(str[pos] < '0' || str[pos] > '9')
+        {
+            break;
+        }
+        DoubleDouble digit = {(double)(str[pos] - '0'), 0.0};
+        value = ddAdd(ddMul(value, ten), digit);
+        exponent -= fraction ? 1 : 0;
+    }
+    if(pos < str.size() && (str[pos] == 'e' || str[pos] == 'E'))
+    {
+        exponent += atoi(str.c_str() + pos + 1);
+    }
+
+    DoubleDouble scale = {1.0, 0.0};
+    for(int e = 0; e < abs(exponent); e++)
+    {
+        scale = ddMul(scale, ten);
+    }
+    value = exponent < 0 ? ddDiv(value, scale) : ddMul(value, scale);
+
+    if(negative)
+    {
+        value.hi = -value.hi;
+        value.lo = -value.lo;
+    }
+    return value;
+}
+
+/**
+* Main cardioid and period-2 bulb test, points inside both never escape
+*/
+template<typename T>
+static int inMainBulbs(T x, T y)
+{
+    T xq = x - (T)0.25;
+    T y2 = y * y;
+    T q = xq * xq + y2;
+    if (q * (q + xq) <= (T)0.25 * y2)
+    {
+        return 1;
+    }
+    return ((x + 1) * (x + 1) + y2) <= (T)0.0625;
+}
+
+/**
+* Escape count of one point, same iteration as escapeCount in the kernels
+*/
+template<typename T>
+static cl_uint escapeCountRef(T x0, T y0, cl_uint maxIterations, float *zz)
+{
+    if (inMainBulbs(x0, y0))
+    {
+        *zz = 0.0f;
+        return maxIterations;
+    }
+
+    T x = x0;
+    T y = y0;
+    cl_uint count = 0;
+    while (count < maxIterations && (x * x + y * y) <= (T)4.0)
+    {
+        T tmp = x * x + x0 - y * y;
+        y = (T)2.0 * x * y + y0;
+        x = tmp;
+        count++;
+    }
+    *zz = (float)(x * x + y * y);
+    return count;
+}
+
+/**
+* Same colour mapping as colorize in the kernels
+*/
+static cl_uint colorizeRef(cl_uint count, float zz, cl_uint maxIterations, cl_int bench)
+{
+    uchar4 color;
+    if (bench)
+    {
+        color.ch.s0 = count & 0xff;
+        color.ch.s1 = (count & 0xff00) >> 8;
+        color.ch.s2 = (count & 0xff0000) >> 16;
+        color.ch.s3 = (count & 0xff000000) >> 24;
+        return color.num;
+    }
+    if (count == maxIterations)
+    {
+        color.ch.s0 = 0;
+        color.ch.s1 = 0;
+        color.ch.s2 = 0;
+        color.ch.s3 = 0xff;
+        return color.num;
+    }
+    float fc = (float)count + 1 - native_log2(native_log2(zz));
+    float c = fc * 2.0f * 3.1416f / 256.0f;
+    color.ch.s0 = (unsigned char)(((1.0f + native_cos(c))*0.5f)*255);
+    color.ch.s1 = (unsigned char)(((1.0f + native_cos(2.0f*c +
+                                    2.0f*3.1416f/3.0f))*0.5f)*255);
+    color.ch.s2 = (unsigned char)(((1.0f + native_cos(c - 2.0f*3.1416f/3.0f))
+                                   *0.5f)*255);
+    color.ch.s3 = 0xff;
+    return color.num;
+}
+
 int
 Mandelbrot::setupMandelbrot()
 {
@@ -280,6 +481,9 @@ Mandelbrot::setupMandelbrot()
                          "Failed to allocate host memory. (verificationOutput)");
     }
 
+    refOrbit = (cl_double2 *)malloc((MAX_ITER + 1) * sizeof(cl_double2));
+    CHECK_ALLOCATION(refOrbit, "Failed to allocate host memory. (refOrbit)");
+
     return SDK_SUCCESS;
 }
 
@@ -406,16 +610,6 @@ Mandelbrot::setupCL(void)
         return SDK_EXPECTED_FAILURE;
     }
 
-    if(numDevices == 3)
-    {
-        if(!sampleArgs->quiet)
-        {
-            cout << "Number of devices must be even,"
-                 << "\nChanging number of devices from three to two\n";
-        }
-        numDevices = 2;
-    }
-
     // Set numDevices to 1 if devicdeId option is used
     if(sampleArgs->isDeviceIdEnabled())
     {
@@ -495,10 +689,21 @@ Mandelbrot::setupCL(void)
         outputBuffer[i] = clCreateBuffer(
                               context,
                               CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                              (sizeof(cl_uint) * width * height) / numDevices,
+                              sizeof(cl_uint) * width * height,
                               NULL,
                               &status);
         CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (outputBuffer)");
+
+        if(enableDouble)
+        {
+            orbitBuffer[i] = clCreateBuffer(
+                                 context,
+                                 CL_MEM_READ_ONLY,
+                                 sizeof(cl_double2) * (MAX_ITER + 1),
+                                 NULL,
+                                 &status);
+            CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (orbitBuffer)");
+        }
     }
 
     // create a CL program using the kernel source
@@ -640,7 +845,11 @@ Mandelbrot::setupCL(void)
     for (cl_uint i = 0; i < numDevices; i++)
     {
         // get a kernel object handle for a kernel with the given name
-        if(enableDouble)
+        if(adaptive)
+        {
+            kernel_vector[i] = clCreateKernel(program, "mandelbrot_tile", &status);
+        }
+        else if(enableDouble)
         {
             kernel_vector[i] = clCreateKernel(program, "mandelbrot_vector_double",
                                               &status);
@@ -651,6 +860,28 @@ Mandelbrot::setupCL(void)
         }
 
         CHECK_OPENCL_ERROR(status, "clCreateKernel failed.");
+
+        if(adaptive)
+        {
+            status = clGetKernelWorkGroupInfo(kernel_vector[i],
+                                              devices[i],
+                                              CL_KERNEL_WORK_GROUP_SIZE,
+                                              sizeof(size_t),
+                                              &kernelWorkGroupSize,
+                                              0);
+            CHECK_OPENCL_ERROR(status, "clGetKernelWorkGroupInfo failed.");
+
+            if(kernelWorkGroupSize < TILE_LOCAL * TILE_LOCAL)
+            {
+                OPENCL_EXPECTED_ERROR("Device does not support the work-group size of mandelbrot_tile");
+            }
+        }
+
+        if(enableDouble)
+        {
+            kernel_perturb[i] = clCreateKernel(program, "mandelbrot_perturb", &status);
+            CHECK_OPENCL_ERROR(status, "clCreateKernel failed.(mandelbrot_perturb)");
+        }
     }
     return SDK_SUCCESS;
 }
@@ -662,48 +893,81 @@ Mandelbrot::runCLKernels(void)
     cl_int   status;
     cl_kernel kernel;
     cl_event events[MAX_DEVICES];
-    cl_int eventStatus = CL_QUEUED;
-
-    size_t globalThreads[1];
-    size_t localThreads[1];
+    bool busy[MAX_DEVICES];
 
     benched = 0;
-    globalThreads[0] = (width * height) / numDevices;
-    localThreads[0]  = 256;
 
-    globalThreads[0] >>= 2;
+    double aspect = (double)width / (double)height;
+    xstep = (xsize / (double)width);
+    // Adjust for aspect ratio
+    double ysize = xsize / aspect;
+    ystep = (-(xsize / aspect) / height);
+    leftx = (xpos - xsize / 2.0);
+    topy = (ypos + ysize / 2.0);
+    topy0 = topy;
+
+    bool deep = usePerturbation();
+    if(deep)
+    {
+        computeReferenceOrbit();
+    }
 
     for (cl_uint i = 0; i < numDevices; i++)
     {
-        kernel = kernel_vector[i];
+        if(deep)
+        {
+            kernel = kernel_perturb[i];
 
-        // Check group size against kernelWorkGroupSize
-        status = clGetKernelWorkGroupInfo(kernel,
-                                          devices[i],
-                                          CL_KERNEL_WORK_GROUP_SIZE,
-                                          sizeof(size_t),
-                                          &kernelWorkGroupSize,
-                                          0);
-        CHECK_OPENCL_ERROR(status, "clGetKernelWorkGroupInfo failed.");
+            status = clEnqueueWriteBuffer(commandQueue[i],
+                                          orbitBuffer[i],
+                                          CL_TRUE,
+                                          0,
+                                          sizeof(cl_double2) * refLength,
+                                          refOrbit,
+                                          0,
+                                          NULL,
+                                          NULL);
+            CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (orbitBuffer)");
 
-        if((cl_uint)(localThreads[0]) > kernelWorkGroupSize)
-        {
-            localThreads[0] = kernelWorkGroupSize;
-        }
+            // offsets of the pixels from the centre
+            cl_double dcLeft = -xsize / 2.0;
+            cl_double dcTop = ysize / 2.0;
 
-        double aspect = (double)width / (double)height;
-        xstep = (xsize / (double)width);
-        // Adjust for aspect ratio
-        double ysize = xsize / aspect;
-        ystep = (-(xsize / aspect) / height);
-        leftx = (xpos - xsize / 2.0);
-        topy = (ypos + ysize / 2.0 -((double)i * ysize) / (double)numDevices);
+            status = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&outputBuffer[i]);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (outputBuffer)");
 
-        if(i == 0)
-        {
-            topy0 = topy;
+            status = clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&orbitBuffer[i]);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (orbitBuffer)");
+
+            status = clSetKernelArg(kernel, 2, sizeof(cl_int), (void *)&refLength);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (refLength)");
+
+            status = clSetKernelArg(kernel, 3, sizeof(cl_double), (void *)&dcLeft);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (dcLeft)");
+
+            status = clSetKernelArg(kernel, 4, sizeof(cl_double), (void *)&dcTop);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (dcTop)");
+
+            status = clSetKernelArg(kernel, 5, sizeof(cl_double), (void *)&xstep);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (xstep)");
+
+            status = clSetKernelArg(kernel, 6, sizeof(cl_double), (void *)&ystep);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (ystep)");
+
+            status = clSetKernelArg(kernel, 7, sizeof(cl_uint), (void *)&maxIterations);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (maxIterations)");
+
+            status = clSetKernelArg(kernel, 8, sizeof(cl_int), (void *)&width);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (width)");
+
+            status = clSetKernelArg(kernel, 9, sizeof(cl_int), (void *)&bench);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (bench)");
+            continue;
         }
 
+        // mandelbrot_vector_* and mandelbrot_tile take the same arguments
+        kernel = kernel_vector[i];
+
         // Set appropriate arguments to the kernel
         status = clSetKernelArg(
                      kernel,
@@ -797,103 +1061,288 @@ Mandelbrot::runCLKernels(void)
                      sizeof(cl_int),
                      (void *)&bench);
         CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (bench)");
+    }
 
-        /*
-         * Enqueue a kernel run call.
-         */
-        status = clEnqueueNDRangeKernel(
-                     commandQueue[i],
-                     kernel,
-                     1,
-                     NULL,
-                     globalThreads,
-                     localThreads,
-                     0,
-                     NULL,
-                     &events[i]);
-        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+    /*
+     * The image is cut into bands of rows. Every device takes the next
+     * band as soon as its previous one is back, so devices of different
+     * speed and bands of different cost stay balanced.
+     */
+    cl_int rows = bandRows;
+    if(rows <= 0)
+    {
+        rows = (numDevices == 1) ? height :
+               (height + BANDS_PER_DEVICE * numDevices - 1) / (BANDS_PER_DEVICE * numDevices);
     }
-    // flush the queues to get things started
+    rows = ((rows + TILE_SIZE - 1) / TILE_SIZE) * TILE_SIZE;
+
+    int timer = sampleTimer->createTimer();
+    sampleTimer->resetTimer(timer);
+    sampleTimer->startTimer(timer);
+
+    cl_int nextRow = 0;
+    cl_uint pending = 0;
     for (cl_uint i = 0; i < numDevices; i++)
     {
-        status = clFlush(commandQueue[i]);
-        CHECK_OPENCL_ERROR(status, "clFlush failed.");
+        busy[i] = false;
+        bandsDone[i] = 0;
+        bandCallbacks[i].sample = this;
+        bandCallbacks[i].device = i;
     }
 
-    // wait for the kernel call to finish execution
-    for (cl_uint i = 0; i < numDevices; i++)
+    /*
+     * The band callbacks queue their device on bandsFinished, the first
+     * one after a drain completes bandWake. The host sleeps on bandWake
+     * instead of polling the band events.
+     */
+    bandsFinished.clear();
+    bandStatus = CL_SUCCESS;
+    bandWake = clCreateUserEvent(context, &status);
+    CHECK_OPENCL_ERROR(status, "clCreateUserEvent failed. (bandWake)");
+
+    while(nextRow < height || pending > 0)
     {
-        status = waitForEventAndRelease(&events[numDevices-i-1]);
-        CHECK_ERROR(status, SDK_SUCCESS,
-                    "WaitForEventAndRelease(events[numDevices - i - 1]) Failed");
+        for (cl_uint i = 0; i < numDevices && nextRow < height; i++)
+        {
+            if(busy[i])
+            {
+                continue;
+            }
+
+            cl_int lastRow = min(nextRow + rows, height);
+            if(enqueueBand(i, deep, nextRow, lastRow, &events[i]) != SDK_SUCCESS)
+            {
+                return SDK_FAILURE;
+            }
+            nextRow = lastRow;
+            busy[i] = true;
+            pending++;
+
+            status = clSetEventCallback(events[i], CL_COMPLETE, bandComplete,
+                                        &bandCallbacks[i]);
+            CHECK_OPENCL_ERROR(status, "clSetEventCallback failed.");
+        }
+
+        bandLock.lock();
+        while(bandsFinished.empty())
+        {
+            cl_event wake = bandWake;
+            bandLock.unlock();
+            status = clWaitForEvents(1, &wake);
+            CHECK_OPENCL_ERROR(status, "clWaitForEvents failed. (bandWake)");
+            bandLock.lock();
+        }
+        std::vector<cl_uint> finished;
+        finished.swap(bandsFinished);
+        cl_int failed = bandStatus;
+
+        // bandWake is complete, the next finished band needs a fresh one
+        status = clReleaseEvent(bandWake);
+        if(status == CL_SUCCESS)
+        {
+            bandWake = clCreateUserEvent(context, &status);
+        }
+        bandLock.unlock();
+        CHECK_OPENCL_ERROR(status, "clCreateUserEvent failed. (bandWake)");
+        CHECK_OPENCL_ERROR(failed, "Band failed.");
+
+        for (size_t j = 0; j < finished.size(); j++)
+        {
+            cl_uint i = finished[j];
+            status = clReleaseEvent(events[i]);
+            CHECK_OPENCL_ERROR(status, "clReleaseEvent failed.");
+            busy[i] = false;
+            pending--;
+            bandsDone[i]++;
+        }
     }
 
+    status = clReleaseEvent(bandWake);
+    CHECK_OPENCL_ERROR(status, "clReleaseEvent failed. (bandWake)");
+
+    sampleTimer->stopTimer(timer);
+    time = (cl_double)sampleTimer->readTimer(timer);
+
     if (sampleArgs->timing && bench)
     {
-        cl_ulong start;
-        cl_ulong stop;
-        status = clGetEventProfilingInfo(events[0],
-                                         CL_PROFILING_COMMAND_SUBMIT,
-                                         sizeof(cl_ulong),
-                                         &start,
-                                         NULL);
-        CHECK_OPENCL_ERROR(status, "clGetEventProfilingInfo failed.");
+        /*
+         * In bench mode the pixels hold their escape counts. Pixels of the
+         * cardioid, the period-2 bulb and filled tiles count maxIterations
+         * without iterating, so this is the rate of a renderer iterating
+         * every pixel, not of the iterations executed.
+         */
+        cl_ulong totalEscapeCounts = 0;
+        for (int i = 0; i < (width * height); i++)
+        {
+            totalEscapeCounts += output[i];
+        }
+        escapeCountRate = (cl_double)totalEscapeCounts / time;
+        printf("%lf Mescape-counts/s\n", escapeCountRate * (double)(1e-6));
+        printf("%lf equivalent MFLOPs\n", 7.0 * escapeCountRate * (double)(1e-6));
+        bench = 0;
+        benched = 1;
+    }
+    return SDK_SUCCESS;
+}
 
-        status = clGetEventProfilingInfo(events[0],
-                                         CL_PROFILING_COMMAND_END,
-                                         sizeof(cl_ulong),
-                                         &stop,
-                                         NULL);
-        CHECK_OPENCL_ERROR(status, "clGetEventProfilingInfo failed.");
+void CL_CALLBACK
+Mandelbrot::bandComplete(cl_event event, cl_int status, void *data)
+{
+    BandCallback *band = (BandCallback *)data;
+    Mandelbrot *sample = band->sample;
 
-        time = (cl_double)(stop - start)*(cl_double)(1e-09);
+    sample->bandLock.lock();
+    if(status < 0 && sample->bandStatus == CL_SUCCESS)
+    {
+        sample->bandStatus = status;
     }
-    for (cl_uint i = 0; i < numDevices; i++)
+    sample->bandsFinished.push_back(band->device);
+    if(sample->bandsFinished.size() == 1)
     {
-        // Enqueue readBuffer
-        status = clEnqueueReadBuffer(
-                     commandQueue[i],
-                     outputBuffer[i],
-                     CL_FALSE,
-                     0,
-                     (width * height * sizeof(cl_int)) / numDevices,
-                     output + (width * height / numDevices) * i,
-                     0,
-                     NULL,
-                     &events[i]);
-        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.");
+        clSetUserEventStatus(sample->bandWake, CL_COMPLETE);
     }
+    sample->bandLock.unlock();
+}
 
-    for (cl_uint i = 0; i < numDevices; i++)
+int
+Mandelbrot::enqueueBand(cl_uint device,
+                        bool deep,
+                        cl_int firstRow,
+                        cl_int lastRow,
+                        cl_event *event)
+{
+    cl_int status;
+    cl_kernel kernel = deep ? kernel_perturb[device] : kernel_vector[device];
+    cl_uint rowArg = deep ? 10 : 8;
+    cl_int rows = lastRow - firstRow;
+
+    status = clSetKernelArg(kernel, rowArg, sizeof(cl_int), (void *)&firstRow);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (firstRow)");
+
+    status = clSetKernelArg(kernel, rowArg + 1, sizeof(cl_int), (void *)&lastRow);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (lastRow)");
+
+    size_t globalThreads[2];
+    size_t localThreads[2];
+    cl_uint dims = 1;
+    size_t *local = localThreads;
+
+    if(deep)
     {
-        status = clFlush(commandQueue[i]);
-        CHECK_OPENCL_ERROR(status, "clFlush failed.");
+        // one work-item per pixel
+        globalThreads[0] = (size_t)rows * width;
+        local = NULL;
     }
-
-    // wait for the kernel call to finish execution
-    for (cl_uint i = 0; i < numDevices; i++)
+    else if(adaptive)
     {
-        status = waitForEventAndRelease(&events[numDevices - i - 1]);
-        CHECK_ERROR(status, SDK_SUCCESS,
-                    "WaitForEventAndRelease(events[numDevices - i - 1]) Failed");
+        // one work-group per tile
+        dims = 2;
+        localThreads[0] = TILE_LOCAL;
+        localThreads[1] = TILE_LOCAL;
+        globalThreads[0] = ((width + TILE_SIZE - 1) / TILE_SIZE) * TILE_LOCAL;
+        globalThreads[1] = ((rows + TILE_SIZE - 1) / TILE_SIZE) * TILE_LOCAL;
     }
-
-    if (sampleArgs->timing && bench)
+    else
     {
-        cl_ulong totalIterations = 0;
-        for (int i = 0; i < (width * height); i++)
+        // four pixels per work-item
+        status = clGetKernelWorkGroupInfo(kernel,
+                                          devices[device],
+                                          CL_KERNEL_WORK_GROUP_SIZE,
+                                          sizeof(size_t),
+                                          &kernelWorkGroupSize,
+                                          0);
+        CHECK_OPENCL_ERROR(status, "clGetKernelWorkGroupInfo failed.");
+
+        localThreads[0] = 256;
+        if((cl_uint)(localThreads[0]) > kernelWorkGroupSize)
         {
-            totalIterations += output[i];
+            localThreads[0] = kernelWorkGroupSize;
         }
-        cl_double flops = 7.0*totalIterations;
-        printf("%lf MFLOPs\n", flops*(double)(1e-6)/time);
-        printf("%lf MFLOPs according to CPU\n", flops*(double)(1e-6)/totalKernelTime);
-        bench = 0;
-        benched = 1;
+        globalThreads[0] = ((size_t)rows * width) >> 2;
+        globalThreads[0] = ((globalThreads[0] + localThreads[0] - 1) / localThreads[0])
+                           * localThreads[0];
     }
+
+    status = clEnqueueNDRangeKernel(
+                 commandQueue[device],
+                 kernel,
+                 dims,
+                 NULL,
+                 globalThreads,
+                 local,
+                 0,
+                 NULL,
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+
+    status = clEnqueueReadBuffer(
+                 commandQueue[device],
+                 outputBuffer[device],
+                 CL_FALSE,
+                 sizeof(cl_uint) * width * firstRow,
+                 sizeof(cl_uint) * width * rows,
+                 output + width * firstRow,
+                 0,
+                 NULL,
+                 event);
+    CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.");
+
+    status = clFlush(commandQueue[device]);
+    CHECK_OPENCL_ERROR(status, "clFlush failed.");
+
     return SDK_SUCCESS;
 }
 
+void
+Mandelbrot::computeReferenceOrbit()
+{
+    // Z_0 = 0, Z_{n+1} = Z_n^2 + C until Z escapes or maxIterations
+    DoubleDouble cx = {xpos, xposLo};
+    DoubleDouble cy = {ypos, yposLo};
+    DoubleDouble zx = {0.0, 0.0};
+    DoubleDouble zy = {0.0, 0.0};
+    DoubleDouble two = {2.0, 0.0};
+
+    refOrbit[0].s[0] = 0.0;
+    refOrbit[0].s[1] = 0.0;
+    refLength = 1;
+
+    for (cl_int n = 0; n < maxIterations; n++)
+    {
+        DoubleDouble x2 = ddMul(zx, zx);
+        DoubleDouble y2 = ddMul(zy, zy);
+        DoubleDouble xy = ddMul(zx, zy);
+        zx = ddAdd(ddSub(x2, y2), cx);
+        zy = ddAdd(ddMul(two, xy), cy);
+
+        refOrbit[refLength].s[0] = zx.hi;
+        refOrbit[refLength].s[1] = zy.hi;
+        refLength++;
+
+        if (zx.hi * zx.hi + zy.hi * zy.hi > 4.0)
+        {
+            break;
+        }
+    }
+}
+
+void
+Mandelbrot::pan(cl_double dx, cl_double dy)
+{
+    DoubleDouble x = {xpos, xposLo};
+    DoubleDouble y = {ypos, yposLo};
+    DoubleDouble d = {dx, 0.0};
+    x = ddAdd(x, d);
+    d.hi = dy;
+    y = ddAdd(y, d);
+
+    setXPos(x.hi);
+    setYPos(y.hi);
+    // keep the low parts unless the centre was clamped
+    xposLo = (xpos == x.hi) ? x.lo : 0.0;
+    yposLo = (ypos == y.hi) ? y.lo : 0.0;
+}
+
 /**
 * Mandelbrot fractal generated with CPU reference implementation
 */
@@ -941,6 +1390,18 @@ Mandelbrot::mandelbrotRefFloat(cl_uint * verificationOutput,
         stay.s1 = (x.s1*x.s1 + y.s1*y.s1) <= 4.0f;
         stay.s2 = (x.s2*x.s2 + y.s2*y.s2) <= 4.0f;
         stay.s3 = (x.s3*x.s3 + y.s3*y.s3) <= 4.0f;
+
+        // points in the main cardioid or the period-2 bulb never escape
+        int4 inside;
+        inside.s0 = inMainBulbs(x0.s0, y0.s0);
+        inside.s1 = inMainBulbs(x0.s1, y0.s1);
+        inside.s2 = inMainBulbs(x0.s2, y0.s2);
+        inside.s3 = inMainBulbs(x0.s3, y0.s3);
+        stay.s0 = stay.s0 && !inside.s0;
+        stay.s1 = stay.s1 && !inside.s1;
+        stay.s2 = stay.s2 && !inside.s2;
+        stay.s3 = stay.s3 && !inside.s3;
+        ccount = inside * maxIterations;
         float4 savx = x;
         float4 savy = y;
 
@@ -1190,6 +1651,18 @@ Mandelbrot::mandelbrotRefDouble(
         stay.s1 = (x.s1*x.s1 + y.s1*y.s1) <= 4.0;
         stay.s2 = (x.s2*x.s2 + y.s2*y.s2) <= 4.0;
         stay.s3 = (x.s3*x.s3 + y.s3*y.s3) <= 4.0;
+
+        // points in the main cardioid or the period-2 bulb never escape
+        int4 inside;
+        inside.s0 = inMainBulbs(x0.s0, y0.s0);
+        inside.s1 = inMainBulbs(x0.s1, y0.s1);
+        inside.s2 = inMainBulbs(x0.s2, y0.s2);
+        inside.s3 = inMainBulbs(x0.s3, y0.s3);
+        stay.s0 = stay.s0 && !inside.s0;
+        stay.s1 = stay.s1 && !inside.s1;
+        stay.s2 = stay.s2 && !inside.s2;
+        stay.s3 = stay.s3 && !inside.s3;
+        ccount = inside * maxIterations;
         double4 savx = x;
         double4 savy = y;
 
@@ -1390,6 +1863,94 @@ Mandelbrot::mandelbrotRefDouble(
     }
 }
 
+/**
+* Reference for mandelbrot_tile, every pixel is iterated
+*/
+
+void
+Mandelbrot::mandelbrotRefAdaptive(cl_uint * verificationOutput)
+{
+    for(int j = 0; j < height; j++)
+    {
+        for(int i = 0; i < width; i++)
+        {
+            float zz;
+            cl_uint count;
+            if(enableDouble)
+            {
+                count = escapeCountRef(leftx + xstep * (double)i,
+                                       topy0 + ystep * (double)j,
+                                       (cl_uint)maxIterations, &zz);
+            }
+            else
+            {
+                count = escapeCountRef((float)leftx + (float)xstep * (float)i,
+                                       (float)topy0 + (float)ystep * (float)j,
+                                       (cl_uint)maxIterations, &zz);
+            }
+            verificationOutput[j * width + i] = colorizeRef(count, zz,
+                                                            (cl_uint)maxIterations, benched);
+        }
+    }
+}
+
+/**
+* Reference for mandelbrot_perturb, uses the same reference orbit
+*/
+
+void
+Mandelbrot::mandelbrotRefPerturb(cl_uint * verificationOutput)
+{
+    double ysize = xsize * (double)height / (double)width;
+    double dcLeft = -xsize / 2.0;
+    double dcTop = ysize / 2.0;
+
+    for(int j = 0; j < height; j++)
+    {
+        for(int i = 0; i < width; i++)
+        {
+            double dcx = dcLeft + xstep * (double)i;
+            double dcy = dcTop + ystep * (double)j;
+            double dzx = 0.0;
+            double dzy = 0.0;
+            double zx = 0.0;
+            double zy = 0.0;
+            double zz = 0.0;
+            int m = 0;
+            cl_uint count = 0;
+
+            while (count < (cl_uint)maxIterations)
+            {
+                double rx = refOrbit[m].s[0];
+                double ry = refOrbit[m].s[1];
+                double nx = 2.0 * (rx * dzx - ry * dzy) + (dzx * dzx - dzy * dzy) + dcx;
+                double ny = 2.0 * (rx * dzy + ry * dzx) + 2.0 * dzx * dzy + dcy;
+                dzx = nx;
+                dzy = ny;
+                m++;
+
+                zx = refOrbit[m].s[0] + dzx;
+                zy = refOrbit[m].s[1] + dzy;
+                zz = zx * zx + zy * zy;
+                if (zz > 4.0)
+                {
+                    break;
+                }
+                count++;
+
+                if (zz < dzx * dzx + dzy * dzy || m == refLength - 1)
+                {
+                    dzx = zx;
+                    dzy = zy;
+                    m = 0;
+                }
+            }
+            verificationOutput[j * width + i] = colorizeRef(count, (float)zz,
+                                                            (cl_uint)maxIterations, benched);
+        }
+    }
+}
+
 
 int Mandelbrot::initialize()
 {
@@ -1487,14 +2048,73 @@ int Mandelbrot::initialize()
     sampleArgs->AddOption(num_FMA);
     delete num_FMA;
 
+    Option* num_adaptive = new Option;
+    CHECK_ALLOCATION(num_adaptive, "Memory allocation error.\n");
+
+    num_adaptive->_lVersion = "adaptive";
+    num_adaptive->_description =
+        "Mariani-Silver tiles, fills rectangles whose border is in the set";
+    num_adaptive->_type = CA_NO_ARGUMENT;
+    num_adaptive->_value = &adaptive;
+    sampleArgs->AddOption(num_adaptive);
+    delete num_adaptive;
+
+    Option* num_perturb = new Option;
+    CHECK_ALLOCATION(num_perturb, "Memory allocation error.\n");
+
+    num_perturb->_lVersion = "perturb";
+    num_perturb->_description =
+        "Perturbation against a double-double reference orbit (implies --double)."
+        " Used anyway once the pixel step is below 1e-13";
+    num_perturb->_type = CA_NO_ARGUMENT;
+    num_perturb->_value = &perturb;
+    sampleArgs->AddOption(num_perturb);
+    delete num_perturb;
+
+    Option* num_bands = new Option;
+    CHECK_ALLOCATION(num_bands, "Memory allocation error.\n");
+
+    num_bands->_lVersion = "bandRows";
+    num_bands->_description =
+        "Rows per band scheduled on the devices (Default : whole image on one device)";
+    num_bands->_type = CA_ARG_INT;
+    num_bands->_value = &bandRows;
+    sampleArgs->AddOption(num_bands);
+    delete num_bands;
+
+    Option* num_bench = new Option;
+    CHECK_ALLOCATION(num_bench, "Memory allocation error.\n");
+
+    num_bench->_lVersion = "bench";
+    num_bench->_description =
+        "Report escape counts per second of the first frame (with -t)";
+    num_bench->_type = CA_NO_ARGUMENT;
+    num_bench->_value = &benchOption;
+    sampleArgs->AddOption(num_bench);
+    delete num_bench;
+
+    return SDK_SUCCESS;
+}
+
+int Mandelbrot::setup()
+{
+    // Make sure width is a multiple of 4
+    width = (width + 3) & ~(4 - 1);
+
+    iterations = 1;
 
+    // the centre is kept in double-double for deep zooms
     if (xpos_str != "")
     {
-        xpos = atof(xpos_str.c_str());
+        DoubleDouble x = ddFromString(xpos_str);
+        xpos = x.hi;
+        xposLo = x.lo;
     }
     if (ypos_str != "")
     {
-        ypos = atof(ypos_str.c_str());
+        DoubleDouble y = ddFromString(ypos_str);
+        ypos = y.hi;
+        yposLo = y.lo;
     }
     if (xsize_str != "")
     {
@@ -1504,15 +2124,22 @@ int Mandelbrot::initialize()
     {
         xsize = 4.0;
     }
-    return SDK_SUCCESS;
-}
 
-int Mandelbrot::setup()
-{
-    // Make sure width is a multiple of 4
-    width = (width + 3) & ~(4 - 1);
+    if (maxIterations > MAX_ITER)
+    {
+        maxIterations = MAX_ITER;
+    }
 
-    iterations = 1;
+    if ((perturb || xsize / (double)width < DEEP_ZOOM_STEP) && !enableDouble)
+    {
+        std::cout << "Deep zoom uses perturbation, enabling double precision" << std::endl;
+        enableDouble = true;
+    }
+
+    if (benchOption)
+    {
+        bench = 1;
+    }
 
     if(setupMandelbrot()!=SDK_SUCCESS)
     {
@@ -1565,7 +2192,15 @@ int Mandelbrot::verifyResults()
         /* reference implementation
          * it overwrites the input array with the output
          */
-        if(enableDouble)
+        if(usePerturbation())
+        {
+            mandelbrotRefPerturb(verificationOutput);
+        }
+        else if(adaptive)
+        {
+            mandelbrotRefAdaptive(verificationOutput);
+        }
+        else if(enableDouble)
             mandelbrotRefDouble(
                 verificationOutput,
                 leftx,
@@ -1574,7 +2209,7 @@ int Mandelbrot::verifyResults()
                 ystep,
                 maxIterations,
                 width,
-                bench);
+                benched);
         else
             mandelbrotRefFloat(
                 verificationOutput,
@@ -1584,7 +2219,7 @@ int Mandelbrot::verifyResults()
                 (cl_float)ystep,
                 maxIterations,
                 width,
-                bench);
+                benched);
 
         int i, j;
         int counter = 0;
@@ -1642,8 +2277,8 @@ void Mandelbrot::printStats()
 {
     if(sampleArgs->timing)
     {
-        std::string strArray[4] = {"Width", "Height", "Time(sec)", "KernelTime(sec)"};
-        std::string stats[4];
+        std::string strArray[7] = {"Width", "Height", "Time(sec)", "KernelTime(sec)"};
+        std::string stats[7];
 
         sampleTimer->totalTime = setupTime + totalKernelTime;
 
@@ -1651,8 +2286,31 @@ void Mandelbrot::printStats()
         stats[1] = toString(height, std::dec);
         stats[2] = toString(sampleTimer->totalTime, std::dec);
         stats[3] = toString(totalKernelTime, std::dec);
+        int count = 4;
 
-        printStatistics(strArray, stats, 4);
+        strArray[count] = "Renderer";
+        stats[count++] = usePerturbation() ? "perturbation" :
+                         (adaptive ? "adaptive" : "vector");
+
+        if(numDevices > 1)
+        {
+            // bands each device took in the last frame
+            std::string bands = toString(bandsDone[0], std::dec);
+            for (cl_uint i = 1; i < numDevices; i++)
+            {
+                bands += "/" + toString(bandsDone[i], std::dec);
+            }
+            strArray[count] = "Bands per device";
+            stats[count++] = bands;
+        }
+
+        if(benched)
+        {
+            strArray[count] = "Escape counts/s";
+            stats[count++] = toString(escapeCountRate, std::dec);
+        }
+
+        printStatistics(strArray, stats, count);
     }
 }
 int Mandelbrot::cleanup()
@@ -1673,6 +2331,15 @@ int Mandelbrot::cleanup()
 
         status = clReleaseCommandQueue(commandQueue[i]);
         CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.");
+
+        if(enableDouble)
+        {
+            status = clReleaseKernel(kernel_perturb[i]);
+            CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(kernel_perturb)");
+
+            status = clReleaseMemObject(orbitBuffer[i]);
+            CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(orbitBuffer)");
+        }
     }
 
     status = clReleaseContext(context);
@@ -1681,6 +2348,7 @@ int Mandelbrot::cleanup()
     // release program resources (input memory etc.)
     FREE(output);
     FREE(verificationOutput);
+    FREE(refOrbit);
     FREE(devices);
 
     return SDK_SUCCESS;
@@ -28,9 +28,11 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <assert.h>
 #include <string.h>
 #include <math.h>
+#include <vector>
 
 
 #include "CLUtil.hpp"
+#include "SDKThread.hpp"
 
 using namespace appsdk;
 
@@ -40,6 +42,11 @@ using namespace appsdk;
 #define MIN_ITER 32
 #define MAX_DEVICES 4
 
+#define TILE_SIZE 32                /**< pixels per side of a mandelbrot_tile work-group */
+#define TILE_LOCAL 8                /**< work-items per side of a mandelbrot_tile work-group */
+#define BANDS_PER_DEVICE 8          /**< default bands per device with several devices */
+#define DEEP_ZOOM_STEP 1e-13        /**< pixel step below which perturbation is used */
+
 /**
  * Mandelbrot
  * Class implements OpenCL Mandelbrot sample
@@ -74,6 +81,32 @@ class Mandelbrot
         cl_double               leftx;
         cl_double               topy;
         cl_double               topy0;
+        cl_double               xposLo;                     /**< low part of the centre in double-double */
+        cl_double               yposLo;
+
+        bool               adaptive;                        /**< Mariani-Silver tiles instead of vector kernel */
+        bool                perturb;                        /**< always use perturbation */
+        bool            benchOption;                        /**< benchmark the first frame */
+        cl_int             bandRows;                        /**< rows per scheduled band, 0 = auto */
+        cl_uint bandsDone[MAX_DEVICES];                     /**< bands rendered by each device */
+        cl_double   escapeCountRate;                        /**< escape counts per second of the last bench */
+
+        /**
+         * Argument of the completion callback of a band
+         */
+        struct BandCallback
+        {
+            Mandelbrot *sample;
+            cl_uint     device;
+        };
+        BandCallback bandCallbacks[MAX_DEVICES];            /**< callback argument of each device */
+        ThreadLock         bandLock;                        /**< guards the three members below */
+        std::vector<cl_uint> bandsFinished;                 /**< devices whose band completed */
+        cl_int           bandStatus;                        /**< first failed band status */
+        cl_event           bandWake;                        /**< completed when bandsFinished fills */
+
+        cl_double2        *refOrbit;                        /**< reference orbit of the centre */
+        cl_int            refLength;                        /**< entries in refOrbit */
 
         std::string          xpos_str;
         std::string          ypos_str;
@@ -88,6 +121,8 @@ class Mandelbrot
         cl_command_queue commandQueue[MAX_DEVICES];             /**< CL command queue */
         cl_program            program;                          /**< CL program  */
         cl_kernel       kernel_vector[MAX_DEVICES];             /**< CL kernel */
+        cl_kernel      kernel_perturb[MAX_DEVICES];             /**< deep zoom kernel */
+        cl_mem            orbitBuffer[MAX_DEVICES];             /**< reference orbit on the device */
         cl_int
         width;                          /**< width of the output image */
         cl_int
@@ -137,6 +172,16 @@ class Mandelbrot
             xpos_str = "";
             ypos_str = "";
             xsize_str = "";
+            xposLo = 0.0;
+            yposLo = 0.0;
+            adaptive = false;
+            perturb = false;
+            benchOption = false;
+            bandRows = 0;
+            escapeCountRate = 0;
+            refOrbit = NULL;
+            refLength = 0;
+            numDevices = 0;
             maxIterations = 1024;
             setupTime = 0;
             totalKernelTime = 0;
@@ -179,6 +224,45 @@ class Mandelbrot
          */
         int runCLKernels();
 
+        /**
+         * Enqueue rows [firstRow, lastRow) on a device and the read back
+         * of these rows into output
+         * @param device    index of the device
+         * @param deep      use the perturbation kernel
+         * @param firstRow  first row of the band
+         * @param lastRow   row after the band
+         * @param event     event of the read back
+         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+         */
+        int enqueueBand(cl_uint device,
+                        bool deep,
+                        cl_int firstRow,
+                        cl_int lastRow,
+                        cl_event *event);
+
+        /**
+         * Event callback of a band : queues the device on bandsFinished
+         * and wakes runCLKernels
+         */
+        static void CL_CALLBACK bandComplete(cl_event event,
+                                             cl_int status,
+                                             void *data);
+
+        /**
+         * Orbit of the image centre in double-double precision,
+         * stored rounded to double in refOrbit
+         */
+        void computeReferenceOrbit();
+
+        /**
+         * True if the pixel step is too small for plain double precision
+         * (or perturbation was requested) and double kernels are built
+         */
+        bool usePerturbation(void)
+        {
+            return enableDouble && (perturb || xsize / (double)width < DEEP_ZOOM_STEP);
+        }
+
 
         /**
          * Mandelbrot image generated with CPU reference implementation
@@ -221,6 +305,19 @@ class Mandelbrot
             cl_int bench);
 
 
+        /**
+         * Reference for the adaptive renderer, iterates every pixel
+         * @param verificationOutput mandelbrot images is stored in this
+         */
+        void mandelbrotRefAdaptive(cl_uint * verificationOutput);
+
+        /**
+         * Reference for the deep zoom renderer, same perturbation
+         * iteration as mandelbrot_perturb
+         * @param verificationOutput mandelbrot images is stored in this
+         */
+        void mandelbrotRefPerturb(cl_uint * verificationOutput);
+
         /**
          * Override from SDKSample. Print sample stats.
          */
@@ -304,6 +401,11 @@ class Mandelbrot
         {
             return ypos;
         }
+        /**
+         * Move the centre by (dx, dy) keeping double-double precision
+         */
+        void pan(cl_double dx, cl_double dy);
+
         inline void setXPos(cl_double xp)
         {
             if (xp < -2.0)
@@ -315,6 +417,7 @@ class Mandelbrot
                 xp = 2.0;
             }
             xpos = xp;
+            xposLo = 0.0;
         }
         inline void setYPos(cl_double yp)
         {
@@ -327,6 +430,7 @@ class Mandelbrot
                 yp = 2.0;
             }
             ypos = yp;
+            yposLo = 0.0;
         }
         inline void setBench(cl_int b)
         {
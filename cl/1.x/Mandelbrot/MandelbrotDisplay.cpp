@@ -61,19 +61,19 @@ idleFunc(void)
     {
         if (mouseX < (width / 4))
         {
-            clMandelbrot.setXPos(clMandelbrot.getXPos() - clMandelbrot.getXStep());
+            clMandelbrot.pan(-clMandelbrot.getXStep(), 0.0);
         }
         else if (mouseX > (3 * width / 4))
         {
-            clMandelbrot.setXPos(clMandelbrot.getXPos() + clMandelbrot.getXStep());
+            clMandelbrot.pan(clMandelbrot.getXStep(), 0.0);
         }
         if (mouseY < (height / 4))
         {
-            clMandelbrot.setYPos(clMandelbrot.getYPos() + clMandelbrot.getYStep());
+            clMandelbrot.pan(0.0, clMandelbrot.getYStep());
         }
         else if (mouseY > (3 * height / 4))
         {
-            clMandelbrot.setYPos(clMandelbrot.getYPos() - clMandelbrot.getYStep());
+            clMandelbrot.pan(0.0, -clMandelbrot.getYStep());
         }
         if (zoomIn)
         {
@@ -25,6 +25,21 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 * @param width              size of the image 
 */
 
+/**
+* Main cardioid and period-2 bulb test, points inside both never escape
+*/
+int inMainBulbsFloat(float x, float y)
+{
+    float xq = x - 0.25f;
+    float y2 = y * y;
+    float q = xq * xq + y2;
+    if (q * (q + xq) <= 0.25f * y2)
+    {
+        return 1;
+    }
+    return ((x + 1.0f) * (x + 1.0f) + y2) <= 0.0625f;
+}
+
 __kernel void mandelbrot_vector_float(
 				__global uchar4 * mandelbrotImage,
                 const    float posx, 
@@ -33,12 +48,18 @@ __kernel void mandelbrot_vector_float(
                 const    float stepSizeY,
                 const    uint maxIterations,
                 const    int width,
-                const    int bench)
+                const    int bench,
+                const    int firstRow,
+                const    int lastRow)
 {
     int tid = get_global_id(0);
 
     int i = tid % (width / 4);
-    int j = tid / (width / 4);
+    int j = firstRow + tid / (width / 4);
+    if (j >= lastRow)
+    {
+        return;
+    }
     
     int4 veci = {4 * i, 4 * i + 1, 4 * i + 2, 4 * i + 3};
     int4 vecj = {j, j, j, j};
@@ -66,6 +87,15 @@ __kernel void mandelbrot_vector_float(
     stay.s1 = (x.s1 * x.s1 + y.s1 * y.s1) <= 4.0f;
     stay.s2 = (x.s2 * x.s2 + y.s2 * y.s2) <= 4.0f;
     stay.s3 = (x.s3 * x.s3 + y.s3 * y.s3) <= 4.0f;
+
+    // points in the main cardioid or the period-2 bulb never escape
+    int4 inside;
+    inside.s0 = inMainBulbsFloat(x0.s0, y0.s0);
+    inside.s1 = inMainBulbsFloat(x0.s1, y0.s1);
+    inside.s2 = inMainBulbsFloat(x0.s2, y0.s2);
+    inside.s3 = inMainBulbsFloat(x0.s3, y0.s3);
+    stay = stay & (1 - inside);
+    ccount = inside * (int)maxIterations;
     float4 savx = x;
     float4 savy = y;
     for(iter=0; (stay.s0 | stay.s1 | stay.s2 | stay.s3) && (iter < maxIterations); iter+= 16)
@@ -198,7 +228,7 @@ __kernel void mandelbrot_vector_float(
         color[0].s2 = (ccount.s0 & 0xff0000) >> 16;
         color[0].s3 = (ccount.s0 & 0xff000000) >> 24;
     }
-    mandelbrotImage[4 * tid] = color[0];    
+    mandelbrotImage[firstRow * width + 4 * tid] = color[0];    
     c = fc.s1 * 2.0f * 3.1416f / 256.0f;
     color[1].s0 = ((1.0f + native_cos(c)) * 0.5f) * 255;
     color[1].s1 = ((1.0f + native_cos(2.0f * c + 2.0f * 3.1416f / 3.0f)) * 0.5f) * 255;
@@ -217,7 +247,7 @@ __kernel void mandelbrot_vector_float(
         color[1].s2 = (ccount.s1 & 0xff0000) >> 16;
         color[1].s3 = (ccount.s1 & 0xff000000) >> 24;
     }
-    mandelbrotImage[4 * tid + 1] = color[1];    
+    mandelbrotImage[firstRow * width + 4 * tid + 1] = color[1];    
     c = fc.s2 * 2.0f * 3.1416f / 256.0f;
     color[2].s0 = ((1.0f + native_cos(c)) * 0.5f) * 255;
     color[2].s1 = ((1.0f + native_cos(2.0f * c + 2.0f * 3.1416f / 3.0f)) * 0.5f) * 255;
@@ -236,7 +266,7 @@ __kernel void mandelbrot_vector_float(
         color[2].s2 = (ccount.s2 & 0xff0000) >> 16;
         color[2].s3 = (ccount.s2 & 0xff000000) >> 24;
     }
-    mandelbrotImage[4 * tid + 2] = color[2];    
+    mandelbrotImage[firstRow * width + 4 * tid + 2] = color[2];    
     c = fc.s3 * 2.0f * 3.1416f / 256.0f;
     color[3].s0 = ((1.0f + native_cos(c)) * 0.5f) * 255;
     color[3].s1 = ((1.0f + native_cos(2.0f * c + 2.0f * 3.1416f / 3.0f)) * 0.5f) * 255;
@@ -255,7 +285,7 @@ __kernel void mandelbrot_vector_float(
         color[3].s2 = (ccount.s3 & 0xff0000) >> 16;
         color[3].s3 = (ccount.s3 & 0xff000000) >> 24;
     }
-    mandelbrotImage[4 * tid + 3] = color[3];
+    mandelbrotImage[firstRow * width + 4 * tid + 3] = color[3];
 }
 
 #define native_log2 log2
@@ -268,6 +298,18 @@ __kernel void mandelbrot_vector_float(
 #pragma OPENCL EXTENSION cl_amd_fp64 : enable
 #endif
 
+int inMainBulbsDouble(double x, double y)
+{
+    double xq = x - 0.25;
+    double y2 = y * y;
+    double q = xq * xq + y2;
+    if (q * (q + xq) <= 0.25 * y2)
+    {
+        return 1;
+    }
+    return ((x + 1.0) * (x + 1.0) + y2) <= 0.0625;
+}
+
 __kernel void mandelbrot_vector_double(
 				__global uchar4 * mandelbrotImage,
 				const    double posx, 
@@ -276,12 +318,18 @@ __kernel void mandelbrot_vector_double(
                 const    double stepSizeY,
                 const    uint maxIterations,
                 const    int width,
-                const    int bench)
+                const    int bench,
+                const    int firstRow,
+                const    int lastRow)
 {
     int tid = get_global_id(0);
 
     int i = tid % (width / 4);
-    int j = tid / (width / 4);
+    int j = firstRow + tid / (width / 4);
+    if (j >= lastRow)
+    {
+        return;
+    }
     
     int4 veci = {4 * i, 4 * i + 1, 4 * i + 2, 4 * i + 3};
     int4 vecj = {j, j, j, j};
@@ -309,6 +357,15 @@ __kernel void mandelbrot_vector_double(
     stay.s1 = (x.s1 * x.s1 + y.s1 * y.s1) <= 4.0;
     stay.s2 = (x.s2 * x.s2 + y.s2 * y.s2) <= 4.0;
     stay.s3 = (x.s3 * x.s3 + y.s3 * y.s3) <= 4.0;
+
+    // points in the main cardioid or the period-2 bulb never escape
+    int4 inside;
+    inside.s0 = inMainBulbsDouble(x0.s0, y0.s0);
+    inside.s1 = inMainBulbsDouble(x0.s1, y0.s1);
+    inside.s2 = inMainBulbsDouble(x0.s2, y0.s2);
+    inside.s3 = inMainBulbsDouble(x0.s3, y0.s3);
+    stay = stay & (1 - inside);
+    ccount = inside * (int)maxIterations;
     double4 savx = x;
     double4 savy = y;
     for(iter=0; (stay.s0 | stay.s1 | stay.s2 | stay.s3) && (iter < maxIterations); iter+= 16)
@@ -441,7 +498,7 @@ __kernel void mandelbrot_vector_double(
         color[0].s2 = (ccount.s0 & 0xff0000) >> 16;
         color[0].s3 = (ccount.s0 & 0xff000000) >> 24;
     }
-    mandelbrotImage[4 * tid] = color[0];    
+    mandelbrotImage[firstRow * width + 4 * tid] = color[0];    
     c = fc.s1 * 2.0 * 3.1416 / 256.0;
     color[1].s0 = ((1.0 + native_cos(c)) * 0.5) * 255;
     color[1].s1 = ((1.0 + native_cos(2.0 * c + 2.0 * 3.1416 / 3.0)) * 0.5) * 255;
@@ -460,7 +517,7 @@ __kernel void mandelbrot_vector_double(
         color[1].s2 = (ccount.s1 & 0xff0000) >> 16;
         color[1].s3 = (ccount.s1 & 0xff000000) >> 24;
     }
-    mandelbrotImage[4 * tid + 1] = color[1];    
+    mandelbrotImage[firstRow * width + 4 * tid + 1] = color[1];    
     c = fc.s2 * 2.0 * 3.1416 / 256.0;
     color[2].s0 = ((1.0 + native_cos(c)) * 0.5) * 255;
     color[2].s1 = ((1.0 + native_cos(2.0 * c + 2.0 * 3.1416 / 3.0)) * 0.5) * 255;
@@ -479,7 +536,7 @@ __kernel void mandelbrot_vector_double(
         color[2].s2 = (ccount.s2 & 0xff0000) >> 16;
         color[2].s3 = (ccount.s2 & 0xff000000) >> 24;
     }
-    mandelbrotImage[4 * tid + 2] = color[2];    
+    mandelbrotImage[firstRow * width + 4 * tid + 2] = color[2];    
     c = fc.s3 * 2.0 * 3.1416 / 256.0;
     color[3].s0 = ((1.0 + native_cos(c)) * 0.5) * 255;
     color[3].s1 = ((1.0 + native_cos(2.0 * c + 2.0 * 3.1416 / 3.0)) * 0.5) * 255;
@@ -498,6 +555,261 @@ __kernel void mandelbrot_vector_double(
         color[3].s2 = (ccount.s3 & 0xff0000) >> 16;
         color[3].s3 = (ccount.s3 & 0xff000000) >> 24;
     }
-    mandelbrotImage[4 * tid + 3] = color[3];
+    mandelbrotImage[firstRow * width + 4 * tid + 3] = color[3];
+}
+#endif // ENABLE_DOUBLE
+
+
+/**
+* Adaptive renderer, one work-group per TILE_SIZE x TILE_SIZE tile.
+* Mariani-Silver subdivision: the border of a rectangle is iterated
+* first, if every border pixel is in the set the interior is filled
+* without iterating it (the set is connected and has no holes), else
+* the rectangle is split into four down to TILE_MIN. Pixels left over
+* are iterated one by one.
+*/
+#define TILE_SIZE    32
+#define TILE_MIN     8
+#define TILE_LOCAL   8
+#define TILE_THREADS (TILE_LOCAL * TILE_LOCAL)
+#define TILE_RECTS   ((TILE_SIZE / TILE_MIN) * (TILE_SIZE / TILE_MIN))
+
+#define PIXEL_UNKNOWN 0
+#define PIXEL_ESCAPED 1
+#define PIXEL_INSIDE  2
+
+#ifdef ENABLE_DOUBLE
+typedef double real;
+#define inMainBulbs inMainBulbsDouble
+#else
+typedef float real;
+#define inMainBulbs inMainBulbsFloat
+#endif
+
+/**
+* Colour of a pixel from its escape count and |z|^2 at escape,
+* the same mapping as the vector kernels
+*/
+uchar4 colorize(uint count, float zz, uint maxIterations, int bench)
+{
+    uchar4 color;
+    if (bench)
+    {
+        color.s0 = count & 0xff;
+        color.s1 = (count & 0xff00) >> 8;
+        color.s2 = (count & 0xff0000) >> 16;
+        color.s3 = (count & 0xff000000) >> 24;
+        return color;
+    }
+    if (count == maxIterations)
+    {
+        return (uchar4)(0, 0, 0, 0xff);
+    }
+    float fc = (float)count + 1 - native_log2(native_log2(zz));
+    float c = fc * 2.0f * 3.1416f / 256.0f;
+    color.s0 = ((1.0f + native_cos(c)) * 0.5f) * 255;
+    color.s1 = ((1.0f + native_cos(2.0f * c + 2.0f * 3.1416f / 3.0f)) * 0.5f) * 255;
+    color.s2 = ((1.0f + native_cos(c - 2.0f * 3.1416f / 3.0f)) * 0.5f) * 255;
+    color.s3 = 0xff;
+    return color;
+}
+
+/**
+* Escape count of one point, z starts at c like the vector kernels
+*/
+uint escapeCount(real x0, real y0, uint maxIterations, float * zz)
+{
+    if (inMainBulbs(x0, y0))
+    {
+        *zz = 0.0f;
+        return maxIterations;
+    }
+
+    real x = x0;
+    real y = y0;
+    uint count = 0;
+    while (count < maxIterations && (x * x + y * y) <= 4.0f)
+    {
+        real tmp = MUL_ADD(-y, y, MUL_ADD(x, x, x0));
+        y = MUL_ADD(2.0f * x, y, y0);
+        x = tmp;
+        count++;
+    }
+    *zz = (float)(x * x + y * y);
+    return count;
+}
+
+__kernel __attribute__((reqd_work_group_size(TILE_LOCAL, TILE_LOCAL, 1)))
+void mandelbrot_tile(
+                __global uchar4 * mandelbrotImage,
+                const    real posx,
+                const    real posy,
+                const    real stepSizeX,
+                const    real stepSizeY,
+                const    uint maxIterations,
+                const    int width,
+                const    int bench,
+                const    int firstRow,
+                const    int lastRow)
+{
+    __local uchar4 color[TILE_SIZE * TILE_SIZE];
+    __local uchar state[TILE_SIZE * TILE_SIZE];
+    __local int allInside[TILE_RECTS];
+
+    int lid = get_local_id(1) * TILE_LOCAL + get_local_id(0);
+    int tileX = get_group_id(0) * TILE_SIZE;
+    int tileY = firstRow + get_group_id(1) * TILE_SIZE;
+
+    // every work-item owns the pixels lid, lid + TILE_THREADS, ...
+    for (int p = lid; p < TILE_SIZE * TILE_SIZE; p += TILE_THREADS)
+    {
+        state[p] = PIXEL_UNKNOWN;
+    }
+
+    for (int size = TILE_SIZE; size >= TILE_MIN; size /= 2)
+    {
+        int rects = TILE_SIZE / size;
+
+        // iterate the borders of the rectangles of this level
+        for (int p = lid; p < TILE_SIZE * TILE_SIZE; p += TILE_THREADS)
+        {
+            int px = p % TILE_SIZE;
+            int py = p / TILE_SIZE;
+            int rx = px % size;
+            int ry = py % size;
+            bool border = rx == 0 || ry == 0 || rx == size - 1 || ry == size - 1;
+            if (border && state[p] == PIXEL_UNKNOWN)
+            {
+                float zz;
+                uint count = escapeCount(posx + stepSizeX * (real)(tileX + px),
+                                         posy + stepSizeY * (real)(tileY + py),
+                                         maxIterations, &zz);
+                color[p] = colorize(count, zz, maxIterations, bench);
+                state[p] = count == maxIterations ? PIXEL_INSIDE : PIXEL_ESCAPED;
+            }
+        }
+        for (int r = lid; r < rects * rects; r += TILE_THREADS)
+        {
+            allInside[r] = 1;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int p = lid; p < TILE_SIZE * TILE_SIZE; p += TILE_THREADS)
+        {
+            int px = p % TILE_SIZE;
+            int py = p / TILE_SIZE;
+            int rx = px % size;
+            int ry = py % size;
+            bool border = rx == 0 || ry == 0 || rx == size - 1 || ry == size - 1;
+            if (border && state[p] != PIXEL_INSIDE)
+            {
+                allInside[(py / size) * rects + px / size] = 0;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // fill the rectangles whose border is in the set
+        for (int p = lid; p < TILE_SIZE * TILE_SIZE; p += TILE_THREADS)
+        {
+            int px = p % TILE_SIZE;
+            int py = p / TILE_SIZE;
+            if (state[p] == PIXEL_UNKNOWN && allInside[(py / size) * rects + px / size])
+            {
+                color[p] = colorize(maxIterations, 0.0f, maxIterations, bench);
+                state[p] = PIXEL_INSIDE;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for (int p = lid; p < TILE_SIZE * TILE_SIZE; p += TILE_THREADS)
+    {
+        int px = p % TILE_SIZE;
+        int py = p / TILE_SIZE;
+        if (state[p] == PIXEL_UNKNOWN)
+        {
+            float zz;
+            uint count = escapeCount(posx + stepSizeX * (real)(tileX + px),
+                                     posy + stepSizeY * (real)(tileY + py),
+                                     maxIterations, &zz);
+            color[p] = colorize(count, zz, maxIterations, bench);
+        }
+        if (tileX + px < width && tileY + py < lastRow)
+        {
+            mandelbrotImage[(tileY + py) * width + tileX + px] = color[p];
+        }
+    }
+}
+
+#ifdef ENABLE_DOUBLE
+/**
+* Deep zoom renderer using perturbation theory.
+* refOrbit holds the orbit Z_n of the image centre computed by the host
+* in extended precision, every pixel iterates only its offset
+* dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc in double precision. When |z| drops
+* below |dz| or the reference orbit ends, z becomes the new offset against
+* Z_0 = 0 (rebasing), which avoids the glitches of a single reference.
+* @param refOrbit           Z_0 = 0, Z_1 = C, ... of the image centre
+* @param refLength          number of entries in refOrbit
+* @param dcLeft             offset of the left edge from the centre
+* @param dcTop              offset of the top edge from the centre
+*/
+__kernel void mandelbrot_perturb(
+                __global uchar4 * mandelbrotImage,
+                __global const double2 * refOrbit,
+                const    int refLength,
+                const    double dcLeft,
+                const    double dcTop,
+                const    double stepSizeX,
+                const    double stepSizeY,
+                const    uint maxIterations,
+                const    int width,
+                const    int bench,
+                const    int firstRow,
+                const    int lastRow)
+{
+    int tid = get_global_id(0);
+
+    int i = tid % width;
+    int j = firstRow + tid / width;
+    if (j >= lastRow)
+    {
+        return;
+    }
+
+    double2 dc = (double2)(dcLeft + stepSizeX * (double)i,
+                           dcTop + stepSizeY * (double)j);
+    double2 dz = (double2)(0.0, 0.0);
+    double2 z;
+    double zz = 0.0;
+    int m = 0;
+    uint count = 0;
+
+    // step n computes z_{n+1}, z_1 = c is the first point the vector kernels test
+    while (count < maxIterations)
+    {
+        double2 ref = refOrbit[m];
+        double2 next;
+        next.x = 2.0 * (ref.x * dz.x - ref.y * dz.y) + (dz.x * dz.x - dz.y * dz.y) + dc.x;
+        next.y = 2.0 * (ref.x * dz.y + ref.y * dz.x) + 2.0 * dz.x * dz.y + dc.y;
+        dz = next;
+        m++;
+
+        z = refOrbit[m] + dz;
+        zz = z.x * z.x + z.y * z.y;
+        if (zz > 4.0)
+        {
+            break;
+        }
+        count++;
+
+        if (zz < dz.x * dz.x + dz.y * dz.y || m == refLength - 1)
+        {
+            dz = z;
+            m = 0;
+        }
+    }
+
+    mandelbrotImage[j * width + i] = colorize(count, (float)zz, maxIterations, bench);
 }
 #endif // ENABLE_DOUBLE
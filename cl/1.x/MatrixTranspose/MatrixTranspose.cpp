@@ -94,6 +94,13 @@ MatrixTranspose::setupCL(void)
         }
     }
 
+#ifdef BATCH_RUNNER
+    // Context of the batch, created by the first sample that needs it
+    cl_platform_id platform = NULL;
+    int retValue = CLRuntime::getInstance().getContext(sampleArgs, dType,
+                   platform, context);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::getContext() failed");
+#else
     /*
      * Have a look at the available platforms and pick either
      * the AMD one if available or a reasonable default.
@@ -127,6 +134,7 @@ MatrixTranspose::setupCL(void)
                   &status);
 
     CHECK_OPENCL_ERROR(status, "clCreateContextFromType failed.");
+#endif
 
     // getting device on which to run the sample
     status = getDevices(context, &devices, sampleArgs->deviceId,
@@ -140,12 +148,18 @@ MatrixTranspose::setupCL(void)
     {
         // The block is to move the declaration of prop closer to its use
         cl_command_queue_properties prop = CL_QUEUE_PROFILING_ENABLE;
+#ifdef BATCH_RUNNER
+        status = CLRuntime::getInstance().getCommandQueue(context,
+                 devices[sampleArgs->deviceId], prop, commandQueue);
+        CHECK_ERROR(status, SDK_SUCCESS, "CLRuntime::getCommandQueue() failed");
+#else
         commandQueue = clCreateCommandQueue(
                            context,
                            devices[sampleArgs->deviceId],
                            prop,
                            &status);
         CHECK_ERROR(status, 0, "clCreateCommandQueue failed.");
+#endif
     }
 
     // Set Persistent memory only for AMD platform
@@ -159,7 +173,7 @@ MatrixTranspose::setupCL(void)
         inMemFlags |= CL_MEM_USE_PERSISTENT_MEM_AMD;
     }
 
-    inputBuffer = clCreateBuffer(
+    inputBuffer = CREATE_BUFFER(
                       context,
                       inMemFlags,
                       sizeof(cl_float) * width * height,
@@ -167,7 +181,7 @@ MatrixTranspose::setupCL(void)
                       &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (inputBuffer)");
 
-    outputBuffer = clCreateBuffer(
+    outputBuffer = CREATE_BUFFER(
                        context,
                        CL_MEM_WRITE_ONLY,
                        sizeof(cl_float) * width * height,
@@ -191,7 +205,11 @@ MatrixTranspose::setupCL(void)
         buildData.flagsFileName = std::string(sampleArgs->flags.c_str());
     }
 
+#ifdef BATCH_RUNNER
+    retValue = CLRuntime::getInstance().getProgram(context, buildData, program);
+#else
     retValue = buildOpenCLProgram(program, context, buildData);
+#endif
     CHECK_ERROR(retValue, SDK_SUCCESS, "buildOpenCLProgram() failed");
 
     // get a kernel object handle for a kernel with the given name
@@ -646,10 +664,10 @@ MatrixTranspose::cleanup()
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.");
 
-    status = clReleaseMemObject(inputBuffer);
+    status = RELEASE_BUFFER(inputBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
 
-    status = clReleaseMemObject(outputBuffer);
+    status = RELEASE_BUFFER(outputBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
 
     status = clReleaseCommandQueue(commandQueue);
@@ -667,8 +685,13 @@ MatrixTranspose::cleanup()
     return SDK_SUCCESS;
 }
 
+#ifdef BATCH_RUNNER
+static int
+runMatrixTranspose(int argc, char * argv[])
+#else
 int
 main(int argc, char * argv[])
+#endif
 {
     // Create MonteCalroAsian object
     MatrixTranspose clMatrixTranspose;
@@ -724,3 +747,6 @@ main(int argc, char * argv[])
     return SDK_SUCCESS;
 }
 
+#ifdef BATCH_RUNNER
+REGISTER_SAMPLE("MatrixTranspose", runMatrixTranspose);
+#endif
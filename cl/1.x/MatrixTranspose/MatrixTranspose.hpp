@@ -25,6 +25,14 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <string.h>
 #include "CLUtil.hpp"
 
+#ifdef BATCH_RUNNER
+// Shared runtime of BatchRunner : pooled buffers and staged transfers
+#include "CLRuntime.hpp"
+#else
+#define CREATE_BUFFER clCreateBuffer
+#define RELEASE_BUFFER clReleaseMemObject
+#endif
+
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.4"
 
 using namespace appsdk;
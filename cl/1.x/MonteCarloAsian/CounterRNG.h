@@ -0,0 +1,824 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef COUNTER_RNG_H_
+#define COUNTER_RNG_H_
+
+/**
+* Counter-based random number generators shared by host and device code.
+*
+* Philox4x32-10 and Threefry4x32-20 (Salmon et al., "Parallel random numbers:
+* as easy as 1, 2, 3") map a 128-bit counter and a key to 128 random bits with
+* no state, so any element of any stream can be produced directly and a stream
+* is skipped ahead by simply advancing the counter.
+*
+* Element i of a stream is word (i % 4) of block (i / 4). The counter of a
+* block is {block.lo, block.hi, stream, 0} and the key is the 64-bit seed.
+*
+* The uniform, Box-Muller normal and Sobol transforms only use integer
+* operations and single precision add/sub/mul, which are correctly rounded on
+* both sides, so the host and the device produce bitwise identical values.
+* crngInverseNormal divides, and single precision division on the device is
+* only accurate to 2.5 ulp, so its results match the host within a tolerance.
+* Kernels including this file must define _OCL_CODE_ first and must not be
+* built with -cl-fast-relaxed-math or -cl-mad-enable.
+*/
+
+#define CRNG_PHILOX             0
+#define CRNG_THREEFRY           1
+
+#define CRNG_PHILOX_M0          0xD2511F53u
+#define CRNG_PHILOX_M1          0xCD9E8D57u
+#define CRNG_PHILOX_W0          0x9E3779B9u
+#define CRNG_PHILOX_W1          0xBB67AE85u
+#define CRNG_THREEFRY_PARITY    0x1BD11BDAu
+
+#define CRNG_SOBOL_DIMENSIONS   8
+#define CRNG_SOBOL_BITS         32
+
+#ifdef _OCL_CODE_
+
+#pragma OPENCL FP_CONTRACT OFF
+
+#define CRNG_FUNC
+#define CRNG_CONSTANT           __constant
+#define CRNG_MULHI(a, b)        mul_hi((a), (b))
+#define CRNG_AS_UINT(x)         as_uint(x)
+#define CRNG_AS_FLOAT(x)        as_float(x)
+typedef ulong crng_ulong;
+
+#else
+
+#include <emmintrin.h>
+#include <string.h>
+
+#define CRNG_FUNC               static inline
+#define CRNG_CONSTANT           static const
+#define CRNG_MULHI(a, b)        ((unsigned int)(((unsigned long long)(a) * (b)) >> 32))
+#define CRNG_AS_UINT(x)         crngAsUint(x)
+#define CRNG_AS_FLOAT(x)        crngAsFloat(x)
+typedef unsigned long long crng_ulong;
+
+static inline unsigned int crngAsUint(float x)
+{
+    unsigned int u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+static inline float crngAsFloat(unsigned int u)
+{
+    float x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+#endif
+
+/* Four 32-bit words : counter, Threefry key or generator output */
+typedef struct CRNGBlock
+{
+    unsigned int v[4];
+} CRNGBlock;
+
+/* Two 32-bit words : Philox key or stream seed */
+typedef struct CRNGPair
+{
+    unsigned int v[2];
+} CRNGPair;
+
+/* Pair of normal deviates */
+typedef struct CRNGFloat2
+{
+    float v[2];
+} CRNGFloat2;
+
+/* ln(1 + f) Taylor coefficients for |f| < sqrt(2) - 1, Horner order */
+CRNG_CONSTANT float crngLogCoeff[18] =
+{
+    1.000000000e+00f, -5.000000000e-01f, 3.333333333e-01f, -2.500000000e-01f,
+    2.000000000e-01f, -1.666666667e-01f, 1.428571429e-01f, -1.250000000e-01f,
+    1.111111111e-01f, -1.000000000e-01f, 9.090909091e-02f, -8.333333333e-02f,
+    7.692307692e-02f, -7.142857143e-02f, 6.666666667e-02f, -6.250000000e-02f,
+    5.882352941e-02f, -5.555555556e-02f
+};
+
+/* sin(t) / t and cos(t) Taylor coefficients in t^2 for 0 <= t < pi/2 */
+CRNG_CONSTANT float crngSinCoeff[7] =
+{
+    1.000000000e+00f, -1.666666667e-01f, 8.333333333e-03f, -1.984126984e-04f,
+    2.755731922e-06f, -2.505210839e-08f, 1.605904384e-10f
+};
+
+CRNG_CONSTANT float crngCosCoeff[8] =
+{
+    1.000000000e+00f, -5.000000000e-01f, 4.166666667e-02f, -1.388888889e-03f,
+    2.480158730e-05f, -2.755731922e-07f, 2.087675699e-09f, -1.147074560e-11f
+};
+
+/* Joe-Kuo direction numbers, first CRNG_SOBOL_DIMENSIONS dimensions */
+CRNG_CONSTANT unsigned int crngSobolDirections[CRNG_SOBOL_DIMENSIONS * CRNG_SOBOL_BITS] =
+{
+    /* dimension 1 */
+    0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u,
+    0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+    0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u,
+    0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+    0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u,
+    0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+    0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u,
+    0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u,
+    /* dimension 2 */
+    0x80000000u, 0xC0000000u, 0xA0000000u, 0xF0000000u,
+    0x88000000u, 0xCC000000u, 0xAA000000u, 0xFF000000u,
+    0x80800000u, 0xC0C00000u, 0xA0A00000u, 0xF0F00000u,
+    0x88880000u, 0xCCCC0000u, 0xAAAA0000u, 0xFFFF0000u,
+    0x80008000u, 0xC000C000u, 0xA000A000u, 0xF000F000u,
+    0x88008800u, 0xCC00CC00u, 0xAA00AA00u, 0xFF00FF00u,
+    0x80808080u, 0xC0C0C0C0u, 0xA0A0A0A0u, 0xF0F0F0F0u,
+    0x88888888u, 0xCCCCCCCCu, 0xAAAAAAAAu, 0xFFFFFFFFu,
+    /* dimension 3 */
+    0x80000000u, 0xC0000000u, 0x60000000u, 0x90000000u,
+    0xE8000000u, 0x5C000000u, 0x8E000000u, 0xC5000000u,
+    0x68800000u, 0x9CC00000u, 0xEE600000u, 0x55900000u,
+    0x80680000u, 0xC09C0000u, 0x60EE0000u, 0x90550000u,
+    0xE8808000u, 0x5CC0C000u, 0x8E606000u, 0xC5909000u,
+    0x6868E800u, 0x9C9C5C00u, 0xEEEE8E00u, 0x5555C500u,
+    0x8000E880u, 0xC0005CC0u, 0x60008E60u, 0x9000C590u,
+    0xE8006868u, 0x5C009C9Cu, 0x8E00EEEEu, 0xC5005555u,
+    /* dimension 4 */
+    0x80000000u, 0xC0000000u, 0x20000000u, 0x50000000u,
+    0xF8000000u, 0x74000000u, 0xA2000000u, 0x93000000u,
+    0xD8800000u, 0x25400000u, 0x59E00000u, 0xE6D00000u,
+    0x78080000u, 0xB40C0000u, 0x82020000u, 0xC3050000u,
+    0x208F8000u, 0x51474000u, 0xFBEA2000u, 0x75D93000u,
+    0xA0858800u, 0x914E5400u, 0xDBE79E00u, 0x25DB6D00u,
+    0x58800080u, 0xE54000C0u, 0x79E00020u, 0xB6D00050u,
+    0x800800F8u, 0xC00C0074u, 0x200200A2u, 0x50050093u,
+    /* dimension 5 */
+    0x80000000u, 0x40000000u, 0x20000000u, 0xB0000000u,
+    0xF8000000u, 0xDC000000u, 0x7A000000u, 0x9D000000u,
+    0x5A800000u, 0x2FC00000u, 0xA1600000u, 0xF0B00000u,
+    0xDA880000u, 0x6FC40000u, 0x81620000u, 0x40BB0000u,
+    0x22878000u, 0xB3C9C000u, 0xFB65A000u, 0xDDB2D000u,
+    0x78022800u, 0x9C0B3C00u, 0x5A0FB600u, 0x2D0DDB00u,
+    0xA2878080u, 0xF3C9C040u, 0xDB65A020u, 0x6DB2D0B0u,
+    0x800228F8u, 0x400B3CDCu, 0x200FB67Au, 0xB00DDB9Du,
+    /* dimension 6 */
+    0x80000000u, 0x40000000u, 0x60000000u, 0x30000000u,
+    0xC8000000u, 0x24000000u, 0x56000000u, 0xFB000000u,
+    0xE0800000u, 0x70400000u, 0xA8600000u, 0x14300000u,
+    0x9EC80000u, 0xDF240000u, 0xB6D60000u, 0x8BBB0000u,
+    0x48008000u, 0x64004000u, 0x36006000u, 0xCB003000u,
+    0x2880C800u, 0x54402400u, 0xFE605600u, 0xEF30FB00u,
+    0x7E48E080u, 0xAF647040u, 0x1EB6A860u, 0x9F8B1430u,
+    0xD6C81EC8u, 0xBB249F24u, 0x80D6D6D6u, 0x40BBBBBBu,
+    /* dimension 7 */
+    0x80000000u, 0xC0000000u, 0xA0000000u, 0xD0000000u,
+    0x58000000u, 0x94000000u, 0x3E000000u, 0xE3000000u,
+    0xBE800000u, 0x23C00000u, 0x1E200000u, 0xF3100000u,
+    0x46780000u, 0x67840000u, 0x78460000u, 0x84670000u,
+    0xC6788000u, 0xA784C000u, 0xD846A000u, 0x5467D000u,
+    0x9E78D800u, 0x33845400u, 0xE6469E00u, 0xB7673300u,
+    0x20F86680u, 0x104477C0u, 0xF8668020u, 0x4477C010u,
+    0x668020F8u, 0x77C01044u, 0x8020F866u, 0xC0104477u,
+    /* dimension 8 */
+    0x80000000u, 0x40000000u, 0xA0000000u, 0x50000000u,
+    0x88000000u, 0x24000000u, 0x12000000u, 0x2D000000u,
+    0x76800000u, 0x9E400000u, 0x08200000u, 0x64100000u,
+    0xB2280000u, 0x7D140000u, 0xFEA20000u, 0xBA490000u,
+    0x1A248000u, 0x491B4000u, 0xC4B5A000u, 0xE3739000u,
+    0xF6800800u, 0xDE400400u, 0xA8200A00u, 0x34100500u,
+    0x3A280880u, 0x59140240u, 0xECA20120u, 0x974902D0u,
+    0x6CA48768u, 0xD75B49E4u, 0xCC95A082u, 0x87639641u,
+};
+
+/**
+* @brief Philox4x32-10 bijection
+* @param ctr 128-bit counter
+* @param key 64-bit key
+* @return 128 random bits
+*/
+CRNG_FUNC CRNGBlock crngPhilox4x32_10(CRNGBlock ctr, CRNGPair key)
+{
+    for(int round = 0; round < 10; ++round)
+    {
+        unsigned int hi0 = CRNG_MULHI(CRNG_PHILOX_M0, ctr.v[0]);
+        unsigned int lo0 = CRNG_PHILOX_M0 * ctr.v[0];
+        unsigned int hi1 = CRNG_MULHI(CRNG_PHILOX_M1, ctr.v[2]);
+        unsigned int lo1 = CRNG_PHILOX_M1 * ctr.v[2];
+
+        ctr.v[0] = hi1 ^ ctr.v[1] ^ key.v[0];
+        ctr.v[1] = lo1;
+        ctr.v[2] = hi0 ^ ctr.v[3] ^ key.v[1];
+        ctr.v[3] = lo0;
+
+        key.v[0] += CRNG_PHILOX_W0;
+        key.v[1] += CRNG_PHILOX_W1;
+    }
+    return ctr;
+}
+
+#define CRNG_ROTL(x, r)         (((x) << (r)) | ((x) >> (32 - (r))))
+
+/* One Threefry mix : (a, b) and (c, d) pairs with rotations r0, r1 */
+#define CRNG_THREEFRY_MIX(a, b, c, d, r0, r1) \
+    a += b; b = CRNG_ROTL(b, r0); b ^= a; \
+    c += d; d = CRNG_ROTL(d, r1); d ^= c;
+
+/* Key injection after every four rounds */
+#define CRNG_THREEFRY_INJECT(x, ks, i) \
+    x.v[0] += ks[(i) % 5]; \
+    x.v[1] += ks[((i) + 1) % 5]; \
+    x.v[2] += ks[((i) + 2) % 5]; \
+    x.v[3] += ks[((i) + 3) % 5] + (i);
+
+/**
+* @brief Threefry4x32-20 bijection
+* @param ctr 128-bit counter
+* @param key 128-bit key
+* @return 128 random bits
+*/
+CRNG_FUNC CRNGBlock crngThreefry4x32_20(CRNGBlock ctr, CRNGBlock key)
+{
+    unsigned int ks[5];
+    ks[4] = CRNG_THREEFRY_PARITY;
+    for(int i = 0; i < 4; ++i)
+    {
+        ks[i] = key.v[i];
+        ks[4] ^= key.v[i];
+    }
+
+    CRNGBlock x = ctr;
+    CRNG_THREEFRY_INJECT(x, ks, 0);
+
+    for(unsigned int i = 1; i <= 5; ++i)
+    {
+        /* Rotation schedule repeats every eight rounds */
+        if(i & 1)
+        {
+            CRNG_THREEFRY_MIX(x.v[0], x.v[1], x.v[2], x.v[3], 10, 26);
+            CRNG_THREEFRY_MIX(x.v[0], x.v[3], x.v[2], x.v[1], 11, 21);
+            CRNG_THREEFRY_MIX(x.v[0], x.v[1], x.v[2], x.v[3], 13, 27);
+            CRNG_THREEFRY_MIX(x.v[0], x.v[3], x.v[2], x.v[1], 23, 5);
+        }
+        else
+        {
+            CRNG_THREEFRY_MIX(x.v[0], x.v[1], x.v[2], x.v[3], 6, 20);
+            CRNG_THREEFRY_MIX(x.v[0], x.v[3], x.v[2], x.v[1], 17, 11);
+            CRNG_THREEFRY_MIX(x.v[0], x.v[1], x.v[2], x.v[3], 25, 10);
+            CRNG_THREEFRY_MIX(x.v[0], x.v[3], x.v[2], x.v[1], 18, 20);
+        }
+        CRNG_THREEFRY_INJECT(x, ks, i);
+    }
+    return x;
+}
+
+/**
+* @brief Block 'block' of stream 'stream'
+* @param generator CRNG_PHILOX or CRNG_THREEFRY
+* @param seed 64-bit seed shared by all streams
+* @param stream independent stream index
+* @param block block index inside the stream (skip-ahead is free)
+*/
+CRNG_FUNC CRNGBlock crngStreamBlock(int generator,
+                                    CRNGPair seed,
+                                    unsigned int stream,
+                                    crng_ulong block)
+{
+    CRNGBlock ctr;
+    ctr.v[0] = (unsigned int)block;
+    ctr.v[1] = (unsigned int)(block >> 32);
+    ctr.v[2] = stream;
+    ctr.v[3] = 0u;
+
+    if(generator == CRNG_THREEFRY)
+    {
+        CRNGBlock key;
+        key.v[0] = seed.v[0];
+        key.v[1] = seed.v[1];
+        key.v[2] = 0u;
+        key.v[3] = 0u;
+        return crngThreefry4x32_20(ctr, key);
+    }
+    return crngPhilox4x32_10(ctr, seed);
+}
+
+/**
+* @brief Uniform float in (0, 1) from the top 23 bits; exact, never 0 or 1
+*/
+CRNG_FUNC float crngUniform(unsigned int bits)
+{
+    return ((float)(int)(bits >> 9) + 0.5f) * 1.1920928955e-7f;
+}
+
+/**
+* @brief Natural logarithm of a normal float in (0, 1]
+*/
+CRNG_FUNC float crngLog(float x)
+{
+    unsigned int bits = CRNG_AS_UINT(x);
+    int e = (int)(bits >> 23) - 127;
+    float m = CRNG_AS_FLOAT((bits & 0x007FFFFFu) | 0x3F800000u);
+
+    /* Keep the mantissa in [sqrt(2)/2, sqrt(2)) */
+    if(m > 1.414213562f)
+    {
+        m = m * 0.5f;
+        e = e + 1;
+    }
+
+    float f = m - 1.0f;
+    float p = crngLogCoeff[17];
+    for(int i = 16; i >= 0; --i)
+    {
+        p = p * f + crngLogCoeff[i];
+    }
+    p = p * f;
+
+    float fe = (float)e;
+    return fe * 6.93145752e-1f + (p + fe * 1.42860677e-6f);
+}
+
+/**
+* @brief Square root of a positive normal float (three Newton steps on rsqrt)
+*/
+CRNG_FUNC float crngSqrt(float x)
+{
+    float y = CRNG_AS_FLOAT(0x5F3759DFu - (CRNG_AS_UINT(x) >> 1));
+    float h = 0.5f * x;
+    y = y * (1.5f - h * y * y);
+    y = y * (1.5f - h * y * y);
+    y = y * (1.5f - h * y * y);
+    return x * y;
+}
+
+/**
+* @brief sin and cos of 2 * pi * bits / 2^32
+* The top two bits select the quadrant, the next 21 bits the angle inside it.
+* @return v[0] = sin, v[1] = cos
+*/
+CRNG_FUNC CRNGFloat2 crngSinCos2Pi(unsigned int bits)
+{
+    unsigned int quadrant = bits >> 30;
+    float t = ((float)(int)((bits >> 9) & 0x1FFFFFu) + 0.5f)
+              * 7.49014167e-7f;                 /* pi / 2 / 2^21 */
+    float t2 = t * t;
+
+    float s = crngSinCoeff[6];
+    for(int i = 5; i >= 0; --i)
+    {
+        s = s * t2 + crngSinCoeff[i];
+    }
+    s = s * t;
+
+    float c = crngCosCoeff[7];
+    for(int i = 6; i >= 0; --i)
+    {
+        c = c * t2 + crngCosCoeff[i];
+    }
+
+    CRNGFloat2 result;
+    result.v[0] = (quadrant & 1u) ? c : s;
+    result.v[1] = (quadrant & 1u) ? s : c;
+    if(quadrant & 2u)
+    {
+        result.v[0] = -result.v[0];
+    }
+    if((quadrant + 1u) & 2u)
+    {
+        result.v[1] = -result.v[1];
+    }
+    return result;
+}
+
+/**
+* @brief Box-Muller transform of two words into two standard normal deviates
+*/
+CRNG_FUNC CRNGFloat2 crngBoxMuller(unsigned int a, unsigned int b)
+{
+    float r = crngSqrt(-2.0f * crngLog(crngUniform(a)));
+    CRNGFloat2 sc = crngSinCos2Pi(b);
+
+    CRNGFloat2 result;
+    result.v[0] = r * sc.v[1];
+    result.v[1] = r * sc.v[0];
+    return result;
+}
+
+/* Acklam's rational approximation of the inverse normal CDF */
+CRNG_CONSTANT float crngInvNormA[6] =
+{
+    -3.969683028665376e+01f, 2.209460984245205e+02f, -2.759285104469687e+02f,
+    1.383577518672690e+02f, -3.066479806614716e+01f, 2.506628277459239e+00f
+};
+CRNG_CONSTANT float crngInvNormB[5] =
+{
+    -5.447609879822406e+01f, 1.615858368580409e+02f, -1.556989798598866e+02f,
+    6.680131188771720e+01f, -1.328068155288572e+01f
+};
+CRNG_CONSTANT float crngInvNormC[6] =
+{
+    -7.784894002430293e-03f, -3.223964580411365e-01f, -2.400758277161838e+00f,
+    -2.549732539343734e+00f, 4.374664141464968e+00f, 2.938163982698783e+00f
+};
+CRNG_CONSTANT float crngInvNormD[4] =
+{
+    7.784695709041462e-03f, 3.224671290700398e-01f, 2.445134137142996e+00f,
+    3.754408661907416e+00f
+};
+
+/**
+* @brief Standard normal deviate of probability p in (0, 1), inverse of the
+*        normal CDF for quasi-random points
+* The division makes it differ from the host by a few ulp on the device
+*/
+CRNG_FUNC float crngInverseNormal(float p)
+{
+    if(p > 0.02425f && p < 0.97575f)
+    {
+        float q = p - 0.5f;
+        float r = q * q;
+        float num = crngInvNormA[0];
+        for(int i = 1; i < 6; ++i)
+        {
+            num = num * r + crngInvNormA[i];
+        }
+        float den = crngInvNormB[0];
+        for(int i = 1; i < 5; ++i)
+        {
+            den = den * r + crngInvNormB[i];
+        }
+        return num * q / (den * r + 1.0f);
+    }
+
+    float q = crngSqrt(-2.0f * crngLog(p < 0.5f ? p : 1.0f - p));
+    float num = crngInvNormC[0];
+    for(int i = 1; i < 6; ++i)
+    {
+        num = num * q + crngInvNormC[i];
+    }
+    float den = crngInvNormD[0];
+    for(int i = 1; i < 4; ++i)
+    {
+        den = den * q + crngInvNormD[i];
+    }
+    float x = num / (den * q + 1.0f);
+    return p < 0.5f ? x : -x;
+}
+
+/**
+* @brief Sobol point 'index' in dimension 'dim' as 32-bit fixed point
+* Gray code ordering: point n is the XOR of the direction numbers selected by
+* the set bits of n ^ (n >> 1), so any point is computed independently.
+*/
+CRNG_FUNC unsigned int crngSobol(unsigned int index, unsigned int dim)
+{
+    unsigned int gray = index ^ (index >> 1);
+    unsigned int result = 0u;
+    for(unsigned int bit = 0; gray != 0u; ++bit, gray >>= 1)
+    {
+        if(gray & 1u)
+        {
+            result ^= crngSobolDirections[dim * CRNG_SOBOL_BITS + bit];
+        }
+    }
+    return result;
+}
+
+#ifndef _OCL_CODE_
+
+/*
+* Host bulk fill API.
+* SSE2 paths run four blocks per step in transposed form (one block per
+* lane) and mirror the scalar code operation for operation, so they produce
+* the same bits as the scalar functions above and as the device kernels.
+* Output layout is always out[4 * block + word].
+*/
+
+/* 32 x 32 -> 64 bit multiply of four lanes, split into high and low words */
+static inline void crngMulHiLoSSE(__m128i a, __m128i m, __m128i* hi, __m128i* lo)
+{
+    const __m128i lowMask = _mm_set_epi32(0, -1, 0, -1);
+    __m128i even = _mm_mul_epu32(a, m);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+
+    *hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(lowMask, odd));
+    *lo = _mm_or_si128(_mm_and_si128(even, lowMask), _mm_slli_epi64(odd, 32));
+}
+
+static inline void crngPhiloxSSE(__m128i* x, CRNGPair key)
+{
+    const __m128i m0 = _mm_set1_epi32((int)CRNG_PHILOX_M0);
+    const __m128i m1 = _mm_set1_epi32((int)CRNG_PHILOX_M1);
+
+    for(int round = 0; round < 10; ++round)
+    {
+        __m128i hi0, lo0, hi1, lo1;
+        crngMulHiLoSSE(x[0], m0, &hi0, &lo0);
+        crngMulHiLoSSE(x[2], m1, &hi1, &lo1);
+
+        __m128i k0 = _mm_set1_epi32((int)key.v[0]);
+        __m128i k1 = _mm_set1_epi32((int)key.v[1]);
+        x[0] = _mm_xor_si128(_mm_xor_si128(hi1, x[1]), k0);
+        x[1] = lo1;
+        x[2] = _mm_xor_si128(_mm_xor_si128(hi0, x[3]), k1);
+        x[3] = lo0;
+
+        key.v[0] += CRNG_PHILOX_W0;
+        key.v[1] += CRNG_PHILOX_W1;
+    }
+}
+
+#define CRNG_ROTL_SSE(x, r) \
+    _mm_or_si128(_mm_slli_epi32((x), (r)), _mm_srli_epi32((x), 32 - (r)))
+
+#define CRNG_THREEFRY_MIX_SSE(a, b, c, d, r0, r1) \
+    a = _mm_add_epi32(a, b); b = _mm_xor_si128(CRNG_ROTL_SSE(b, r0), a); \
+    c = _mm_add_epi32(c, d); d = _mm_xor_si128(CRNG_ROTL_SSE(d, r1), c);
+
+static inline void crngThreefrySSE(__m128i* x, CRNGPair seed)
+{
+    unsigned int ks[5] = { seed.v[0], seed.v[1], 0u, 0u,
+                           CRNG_THREEFRY_PARITY ^ seed.v[0] ^ seed.v[1]
+                         };
+
+    for(unsigned int i = 0; i <= 5; ++i)
+    {
+        if(i != 0)
+        {
+            if(i & 1)
+            {
+                CRNG_THREEFRY_MIX_SSE(x[0], x[1], x[2], x[3], 10, 26);
+                CRNG_THREEFRY_MIX_SSE(x[0], x[3], x[2], x[1], 11, 21);
+                CRNG_THREEFRY_MIX_SSE(x[0], x[1], x[2], x[3], 13, 27);
+                CRNG_THREEFRY_MIX_SSE(x[0], x[3], x[2], x[1], 23, 5);
+            }
+            else
+            {
+                CRNG_THREEFRY_MIX_SSE(x[0], x[1], x[2], x[3], 6, 20);
+                CRNG_THREEFRY_MIX_SSE(x[0], x[3], x[2], x[1], 17, 11);
+                CRNG_THREEFRY_MIX_SSE(x[0], x[1], x[2], x[3], 25, 10);
+                CRNG_THREEFRY_MIX_SSE(x[0], x[3], x[2], x[1], 18, 20);
+            }
+        }
+        for(unsigned int w = 0; w < 4; ++w)
+        {
+            unsigned int k = ks[(i + w) % 5] + ((w == 3) ? i : 0u);
+            x[w] = _mm_add_epi32(x[w], _mm_set1_epi32((int)k));
+        }
+    }
+}
+
+/* Blocks first .. first + 3 of a stream, word w of every block in x[w] */
+static inline void crngStreamBlocksSSE(int generator,
+                                       CRNGPair seed,
+                                       unsigned int stream,
+                                       crng_ulong first,
+                                       __m128i* x)
+{
+    unsigned int lo[4], hi[4];
+    for(int i = 0; i < 4; ++i)
+    {
+        crng_ulong block = first + (crng_ulong)i;
+        lo[i] = (unsigned int)block;
+        hi[i] = (unsigned int)(block >> 32);
+    }
+    x[0] = _mm_setr_epi32((int)lo[0], (int)lo[1], (int)lo[2], (int)lo[3]);
+    x[1] = _mm_setr_epi32((int)hi[0], (int)hi[1], (int)hi[2], (int)hi[3]);
+    x[2] = _mm_set1_epi32((int)stream);
+    x[3] = _mm_setzero_si128();
+
+    if(generator == CRNG_THREEFRY)
+    {
+        crngThreefrySSE(x, seed);
+    }
+    else
+    {
+        crngPhiloxSSE(x, seed);
+    }
+}
+
+/* Back from word-major to block-major order */
+static inline void crngTransposeSSE(__m128i* x)
+{
+    __m128i t0 = _mm_unpacklo_epi32(x[0], x[1]);
+    __m128i t1 = _mm_unpacklo_epi32(x[2], x[3]);
+    __m128i t2 = _mm_unpackhi_epi32(x[0], x[1]);
+    __m128i t3 = _mm_unpackhi_epi32(x[2], x[3]);
+    x[0] = _mm_unpacklo_epi64(t0, t1);
+    x[1] = _mm_unpackhi_epi64(t0, t1);
+    x[2] = _mm_unpacklo_epi64(t2, t3);
+    x[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+static inline __m128 crngUniformSSE(__m128i bits)
+{
+    __m128 v = _mm_cvtepi32_ps(_mm_srli_epi32(bits, 9));
+    return _mm_mul_ps(_mm_add_ps(v, _mm_set1_ps(0.5f)),
+                      _mm_set1_ps(1.1920928955e-7f));
+}
+
+static inline __m128 crngLogSSE(__m128 x)
+{
+    __m128i bits = _mm_castps_si128(x);
+    __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(
+                                    _mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+                                    _mm_set1_epi32(0x3F800000)));
+
+    __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(1.414213562f));
+    m = _mm_or_ps(_mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))),
+                  _mm_andnot_ps(big, m));
+    e = _mm_sub_epi32(e, _mm_castps_si128(big));
+
+    __m128 f = _mm_sub_ps(m, _mm_set1_ps(1.0f));
+    __m128 p = _mm_set1_ps(crngLogCoeff[17]);
+    for(int i = 16; i >= 0; --i)
+    {
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(crngLogCoeff[i]));
+    }
+    p = _mm_mul_ps(p, f);
+
+    __m128 fe = _mm_cvtepi32_ps(e);
+    return _mm_add_ps(_mm_mul_ps(fe, _mm_set1_ps(6.93145752e-1f)),
+                      _mm_add_ps(p, _mm_mul_ps(fe, _mm_set1_ps(1.42860677e-6f))));
+}
+
+static inline __m128 crngSqrtSSE(__m128 x)
+{
+    __m128 y = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x5F3759DF),
+                                _mm_srli_epi32(_mm_castps_si128(x), 1)));
+    __m128 h = _mm_mul_ps(_mm_set1_ps(0.5f), x);
+    __m128 threeHalves = _mm_set1_ps(1.5f);
+    for(int i = 0; i < 3; ++i)
+    {
+        y = _mm_mul_ps(y, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(h, y), y)));
+    }
+    return _mm_mul_ps(x, y);
+}
+
+static inline void crngSinCos2PiSSE(__m128i bits, __m128* sinOut, __m128* cosOut)
+{
+    __m128i quadrant = _mm_srli_epi32(bits, 30);
+    __m128 t = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(bits, 9),
+                               _mm_set1_epi32(0x1FFFFF)));
+    t = _mm_mul_ps(_mm_add_ps(t, _mm_set1_ps(0.5f)), _mm_set1_ps(7.49014167e-7f));
+    __m128 t2 = _mm_mul_ps(t, t);
+
+    __m128 s = _mm_set1_ps(crngSinCoeff[6]);
+    for(int i = 5; i >= 0; --i)
+    {
+        s = _mm_add_ps(_mm_mul_ps(s, t2), _mm_set1_ps(crngSinCoeff[i]));
+    }
+    s = _mm_mul_ps(s, t);
+
+    __m128 c = _mm_set1_ps(crngCosCoeff[7]);
+    for(int i = 6; i >= 0; --i)
+    {
+        c = _mm_add_ps(_mm_mul_ps(c, t2), _mm_set1_ps(crngCosCoeff[i]));
+    }
+
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+    __m128i sinSign = _mm_slli_epi32(_mm_srli_epi32(_mm_and_si128(quadrant, two), 1), 31);
+    __m128i cosSign = _mm_slli_epi32(_mm_srli_epi32(
+                                         _mm_and_si128(_mm_add_epi32(quadrant, one), two), 1), 31);
+
+    __m128 sv = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    __m128 cv = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    *sinOut = _mm_xor_ps(sv, _mm_castsi128_ps(sinSign));
+    *cosOut = _mm_xor_ps(cv, _mm_castsi128_ps(cosSign));
+}
+
+/* Normal pairs from words (0, 1) and (2, 3) of four blocks */
+static inline void crngBoxMullerSSE(const __m128i* x, __m128* z)
+{
+    for(int pair = 0; pair < 2; ++pair)
+    {
+        __m128 r = crngSqrtSSE(_mm_mul_ps(_mm_set1_ps(-2.0f),
+                                          crngLogSSE(crngUniformSSE(x[2 * pair]))));
+        __m128 s, c;
+        crngSinCos2PiSSE(x[2 * pair + 1], &s, &c);
+        z[2 * pair] = _mm_mul_ps(r, c);
+        z[2 * pair + 1] = _mm_mul_ps(r, s);
+    }
+}
+
+/**
+* @brief Fill numBlocks * 4 raw 32-bit words of a stream
+*/
+static inline void crngFillBits(int generator, CRNGPair seed, unsigned int stream,
+                                crng_ulong firstBlock, size_t numBlocks,
+                                unsigned int* out)
+{
+    size_t b = 0;
+    for(; b + 4 <= numBlocks; b += 4)
+    {
+        __m128i x[4];
+        crngStreamBlocksSSE(generator, seed, stream, firstBlock + b, x);
+        crngTransposeSSE(x);
+        for(int i = 0; i < 4; ++i)
+        {
+            _mm_storeu_si128((__m128i*)(out + 4 * (b + i)), x[i]);
+        }
+    }
+    for(; b < numBlocks; ++b)
+    {
+        CRNGBlock r = crngStreamBlock(generator, seed, stream, firstBlock + b);
+        memcpy(out + 4 * b, r.v, sizeof(r.v));
+    }
+}
+
+/**
+* @brief Fill numBlocks * 4 uniform floats in (0, 1)
+*/
+static inline void crngFillUniform(int generator, CRNGPair seed, unsigned int stream,
+                                   crng_ulong firstBlock, size_t numBlocks,
+                                   float* out)
+{
+    size_t b = 0;
+    for(; b + 4 <= numBlocks; b += 4)
+    {
+        __m128i x[4];
+        crngStreamBlocksSSE(generator, seed, stream, firstBlock + b, x);
+        crngTransposeSSE(x);
+        for(int i = 0; i < 4; ++i)
+        {
+            _mm_storeu_ps(out + 4 * (b + i), crngUniformSSE(x[i]));
+        }
+    }
+    for(; b < numBlocks; ++b)
+    {
+        CRNGBlock r = crngStreamBlock(generator, seed, stream, firstBlock + b);
+        for(int w = 0; w < 4; ++w)
+        {
+            out[4 * b + w] = crngUniform(r.v[w]);
+        }
+    }
+}
+
+/**
+* @brief Fill numBlocks * 4 standard normal floats (Box-Muller)
+*/
+static inline void crngFillNormal(int generator, CRNGPair seed, unsigned int stream,
+                                  crng_ulong firstBlock, size_t numBlocks,
+                                  float* out)
+{
+    size_t b = 0;
+    for(; b + 4 <= numBlocks; b += 4)
+    {
+        __m128i x[4];
+        __m128 z[4];
+        crngStreamBlocksSSE(generator, seed, stream, firstBlock + b, x);
+        crngBoxMullerSSE(x, z);
+        crngTransposeSSE((__m128i*)z);
+        for(int i = 0; i < 4; ++i)
+        {
+            _mm_storeu_ps(out + 4 * (b + i), z[i]);
+        }
+    }
+    for(; b < numBlocks; ++b)
+    {
+        CRNGBlock r = crngStreamBlock(generator, seed, stream, firstBlock + b);
+        CRNGFloat2 z0 = crngBoxMuller(r.v[0], r.v[1]);
+        CRNGFloat2 z1 = crngBoxMuller(r.v[2], r.v[3]);
+        out[4 * b + 0] = z0.v[0];
+        out[4 * b + 1] = z0.v[1];
+        out[4 * b + 2] = z1.v[0];
+        out[4 * b + 3] = z1.v[1];
+    }
+}
+
+/**
+* @brief Fill numPoints Sobol points of 'dims' dimensions, out[point * dims + dim]
+*/
+static inline void crngFillSobol(unsigned int firstPoint, size_t numPoints,
+                                 unsigned int dims, float* out)
+{
+    for(size_t n = 0; n < numPoints; ++n)
+    {
+        for(unsigned int d = 0; d < dims; ++d)
+        {
+            out[n * dims + d] = crngUniform(crngSobol(firstPoint + (unsigned int)n, d));
+        }
+    }
+}
+
+#endif // _OCL_CODE_
+
+#endif // COUNTER_RNG_H_
@@ -20,35 +20,70 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <math.h>
 #include <malloc.h>
 
+/**
+ * @brief Cumulative normal distribution (Abramowitz & Stegun 26.2.17)
+ */
+static double
+cnd(double x)
+{
+    // the coeffs
+    const double c1 =  0.319381530;
+    const double c2 = -0.356563782;
+    const double c3 =  1.781477937;
+    const double c4 = -1.821255978;
+    const double c5 =  1.330274429;
+
+    const double oneBySqrt2pi = 0.398942280401;
+
+    double t = 1.0 / (1.0 + 0.2316419 * fabs(x));
+    double y = 1.0 - oneBySqrt2pi * exp(-x * x / 2.0) *
+               t * (c1 +
+                    t * (c2 +
+                         t * (c3 +
+                              t * (c4 + t * c5))));
+
+    return (x < 0) ? (1.0 - y) : y;
+}
 
 int
 MonteCarloAsian::setupMonteCarloAsian()
 {
-    if(!disableAsync)
-    {
-        steps = (steps < 4) ? 4 : steps;
-        steps = (steps / 2) * 2;
-    }
-
 	if (interest <= 0 || interest > 1)
 	{
 		std::cout << "Interest rate must be in the range > 0 and <= 1.0!" << std::endl;
 		return SDK_EXPECTED_FAILURE;
 	}
+
+    if(steps < 1)
+    {
+        std::cout << "Steps must be at least 1!" << std::endl;
+        return SDK_EXPECTED_FAILURE;
+    }
+
+    if(epsilon < 0.0f)
+    {
+        std::cout << "Epsilon must be >= 0!" << std::endl;
+        return SDK_EXPECTED_FAILURE;
+    }
+
     // Validate flags
-    if(dUseOutAllocHostPtr)
-        if(!(disableAsync && disableMapping))
-        {
-            std::cout << "Note : Neglected --dOutAllocHostPtr flag" << std::endl;
-            dUseOutAllocHostPtr = false;
-        }
+    if(disableAsync)
+    {
+        std::cout << "Note : Neglected --dAsync flag, "
+                  << "batches are always accumulated on the device" << std::endl;
+        disableAsync = false;
+    }
 
-    if(dUseInPersistent)
-        if(!(disableAsync && disableMapping))
-        {
-            std::cout << "Note : Neglected --dInPersistent flag" << std::endl;
-            dUseInPersistent = false;
-        }
+    // Fixed mode runs one batch, epsilon mode runs until the target is met
+    if(batches <= 0)
+    {
+        batches = (epsilon > 0.0f) ? MAX_BATCHES : 1;
+    }
+    if(batches > MAX_BATCHES)
+    {
+        std::cout << "Note : batches limited to " << MAX_BATCHES << std::endl;
+        batches = MAX_BATCHES;
+    }
 
     int i = 0;
     const cl_float finalValue = 0.8f;
@@ -69,9 +104,17 @@ MonteCarloAsian::setupMonteCarloAsian()
     memset((void*)price, 0, steps * sizeof(cl_float));
 
     vega = (cl_float*) malloc(steps * sizeof(cl_float));
-    CHECK_ALLOCATION(price, "Failed to allocate host memory. (vega)");
+    CHECK_ALLOCATION(vega, "Failed to allocate host memory. (vega)");
     memset((void*)vega, 0, steps * sizeof(cl_float));
 
+    halfWidth = (cl_float*) malloc(steps * sizeof(cl_float));
+    CHECK_ALLOCATION(halfWidth, "Failed to allocate host memory. (halfWidth)");
+    memset((void*)halfWidth, 0, steps * sizeof(cl_float));
+
+    batchesDone = (cl_int*) malloc(steps * sizeof(cl_int));
+    CHECK_ALLOCATION(batchesDone, "Failed to allocate host memory. (batchesDone)");
+    memset((void*)batchesDone, 0, steps * sizeof(cl_int));
+
     refPrice = (cl_float*) malloc(steps * sizeof(cl_float));
     CHECK_ALLOCATION(refPrice, "Failed to allocate host memory. (refPrice)");
     memset((void*)refPrice, 0, steps * sizeof(cl_float));
@@ -80,47 +123,25 @@ MonteCarloAsian::setupMonteCarloAsian()
     CHECK_ALLOCATION(refVega, "Failed to allocate host memory. (refVega)");
     memset((void*)refVega, 0, steps * sizeof(cl_float));
 
-    // Set samples and exercise points
-    noOfSum = 12;
+    // Running sums : value and Kahan compensation of every moment
+    acc = (cl_float*) malloc(steps * MOMENTS * 2 * sizeof(cl_float));
+    CHECK_ALLOCATION(acc, "Failed to allocate host memory. (acc)");
+    memset((void*)acc, 0, steps * MOMENTS * 2 * sizeof(cl_float));
+
+    // Set samples and exercise points, one Sobol dimension per time step
+    noOfSum = SOBOL_DIMENSIONS + 1;
     noOfTraj = 1024;
 
     width = noOfTraj / 4;
     height = noOfTraj / 2;
 
-#if defined (_WIN32)
-    randNum = (cl_uint*)_aligned_malloc(width * height * sizeof(cl_uint4) * steps,
-                                        16);
-#else
-    randNum = (cl_uint*)memalign(16, width * height * sizeof(cl_uint4) * steps);
-#endif
-    CHECK_ALLOCATION(randNum, "Failed to allocate host memory. (randNum)");
-
-    // Generate random data
-    for(int i = 0; i < (width * height * 4 * steps); i++)
-    {
-        randNum[i] = (cl_uint)rand();
-    }
-
-    priceVals = (cl_float*)malloc(width * height * 2 * sizeof(cl_float4));
-    CHECK_ALLOCATION(priceVals, "Failed to allocate host memory. (priceVals)");
-    memset((void*)priceVals, 0, width * height * 2 * sizeof(cl_float4));
+    // noOfTraj * noOfTraj paths per batch
+    pairsPerBatch = (cl_uint)(width * height * VECTOR_SIZE);
 
-    priceDeriv = (cl_float*)malloc(width * height * 2 * sizeof(cl_float4));
-    CHECK_ALLOCATION(priceDeriv, "Failed to allocate host memory. (priceDeriv)");
-    memset((void*)priceDeriv, 0, width * height * 2 * sizeof(cl_float4));
+    sobolTable = (cl_uint*) malloc((noOfSum - 1) * SOBOL_TABLE_WIDTH * sizeof(cl_uint));
+    CHECK_ALLOCATION(sobolTable, "Failed to allocate host memory. (sobolTable)");
+    generateSobolTable();
 
-    if(!disableAsync && disableMapping)
-    {
-        priceValsAsync = (cl_float*)malloc(width * height * 2 * sizeof(cl_float4));
-        CHECK_ALLOCATION(priceValsAsync,
-                         "Failed to allocate host memory. (priceValsAsync)");
-        memset((void*)priceValsAsync, 0, width * height * 2 * sizeof(cl_float4));
-
-        priceDerivAsync = (cl_float*)malloc(width * height * 2 * sizeof(cl_float4));
-        CHECK_ALLOCATION(priceDerivAsync,
-                         "Failed to allocate host memory. (priceDerivAsync)");
-        memset((void*)priceDerivAsync, 0, width * height * 2 * sizeof(cl_float4));
-    }
     /*
      * Unless quiet mode has been enabled, print the INPUT array.
      * No more than 256 values are printed because it clutters the screen
@@ -137,12 +158,80 @@ MonteCarloAsian::setupMonteCarloAsian()
     return SDK_SUCCESS;
 }
 
+/*
+ * Primitive polynomials of the first SOBOL_DIMENSIONS dimensions (Joe-Kuo):
+ * degree, coefficients 'a' and initial direction numbers 'm'. The first
+ * dimension is a special case, its entry is ignored.
+ */
+static const struct
+{
+    int degree;
+    cl_uint a;
+    cl_uint m[5];
+} sobolPrimitives[SOBOL_DIMENSIONS] =
+{
+    {0, 0, {0}},
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}}
+};
+
+void
+MonteCarloAsian::generateSobolTable()
+{
+    // The shift uses stream 1 of the generator, the paths use stream 0
+    CRNGPair key = {{seed, 0u}};
+
+    // One dimension per time step
+    for(int dim = 0; dim < noOfSum - 1; dim++)
+    {
+        cl_uint *v = sobolTable + dim * SOBOL_TABLE_WIDTH;
+
+        // First dimension is a special case
+        if(dim == 0)
+        {
+            for(int i = 0; i < N_DIRECTIONS; i++)
+            {
+                // All m's are 1
+                v[i] = 1u << (31 - i);
+            }
+        }
+        else
+        {
+            int d = sobolPrimitives[dim].degree;
+            for(int i = 0; i < d; i++)
+            {
+                v[i] = sobolPrimitives[dim].m[i] << (31 - i);
+            }
+
+            for(int i = d; i < N_DIRECTIONS; i++)
+            {
+                v[i] = v[i - d] ^ (v[i - d] >> d);
+                for(int j = 1; j < d; j++)
+                {
+                    v[i] ^= (((sobolPrimitives[dim].a >> (d - 1 - j)) & 1) * v[i - j]);
+                }
+            }
+        }
+
+        // Random digital shift of the dimension
+        v[N_DIRECTIONS] = crngStreamBlock(CRNG_PHILOX, key, 1u, (crng_ulong)dim).v[0];
+    }
+}
+
 int
 MonteCarloAsian::genBinaryImage()
 {
     bifData binaryData;
     binaryData.kernelName = std::string("MonteCarloAsian_Kernels.cl");
-    binaryData.flagsStr = std::string("");
+    binaryData.flagsStr = std::string("-I.");
     if(sampleArgs->isComplierFlagsSpecified())
     {
         binaryData.flagsFileName = std::string(sampleArgs->flags.c_str());
@@ -247,107 +336,51 @@ MonteCarloAsian::setupCL(void)
                                         &status);
     CHECK_OPENCL_ERROR(status, "clCreateCommandQueue(commandQueue) failed.");
 
-    if(!dUseInPersistent)
+    // Sobol table : persistent memory only for AMD platform
+    cl_mem_flags inMemFlags = CL_MEM_READ_ONLY;
+    if(!dUseInPersistent && sampleArgs->isAmdPlatform())
     {
-        // Set Persistent memory only for AMD platform
-        cl_mem_flags inMemFlags = CL_MEM_READ_ONLY;
-        if(sampleArgs->isAmdPlatform())
-        {
-            inMemFlags |= CL_MEM_USE_PERSISTENT_MEM_AMD;
-        }
+        inMemFlags |= CL_MEM_USE_PERSISTENT_MEM_AMD;
+    }
 
-        // Create buffer for randBuf
-        randBuf = clCreateBuffer(context,
-                                 inMemFlags,
-                                 sizeof(cl_uint4) * width  * height,
-                                 NULL,
-                                 &status);
-        CHECK_OPENCL_ERROR(status, "clCreateBuffer(randBuf) failed.");
+    sobolBuf = clCreateBuffer(context,
+                              inMemFlags,
+                              sizeof(cl_uint) * (noOfSum - 1) * SOBOL_TABLE_WIDTH,
+                              NULL,
+                              &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer(sobolBuf) failed.");
 
-        if(!disableAsync)
-        {
-            // create Buffer for randBuf in asynchronous mode
-            randBufAsync = clCreateBuffer(context,
-                                          inMemFlags,
-                                          sizeof(cl_uint4) * width  * height,
-                                          NULL,
-                                          &status);
-            CHECK_OPENCL_ERROR(status, "clCreateBuffer(randBufAsync) failed.");
-        }
-    }
-    else
-    {
-        // create Normal Buffer, if persistent memory is not in used
-        randBuf = clCreateBuffer(context,
-                                 CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-                                 sizeof(cl_uint4) * width  * height,
-                                 randNum,
-                                 &status);
-        CHECK_OPENCL_ERROR(status, "clCreateBuffer(randBuf) failed.");
-    }
+    status = clEnqueueWriteBuffer(commandQueue,
+                                  sobolBuf,
+                                  CL_TRUE,
+                                  0,
+                                  sizeof(cl_uint) * (noOfSum - 1) * SOBOL_TABLE_WIDTH,
+                                  sobolTable,
+                                  0,
+                                  NULL,
+                                  NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer(sobolBuf) failed.");
 
+    // Running sums are read back after every batch
+    cl_mem_flags outMemFlags = CL_MEM_READ_WRITE;
     if(!dUseOutAllocHostPtr)
     {
-        // create Buffer for PriceBuf
-        priceBuf = clCreateBuffer(context,
-                                  CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                                  sizeof(cl_float4) * width * height * 2,
-                                  NULL,
-                                  &status);
-        CHECK_OPENCL_ERROR(status, "clCreateBuffer(priceBuf) failed.");
-
-        // create Buffer for PriceDeriveBuffer
-        priceDerivBuf = clCreateBuffer(context,
-                                       CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                                       sizeof(cl_float4) * width * height * 2,
-                                       NULL,
-                                       &status);
-        CHECK_OPENCL_ERROR(status, "clCreateBuffer(priceDerivBuf) failed.");
-
-        if(!disableAsync)
-        {
-            // create Buffer for priceBufAsync
-            priceBufAsync = clCreateBuffer(context,
-                                           CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                                           sizeof(cl_float4) * width * height * 2,
-                                           NULL,
-                                           &status);
-            CHECK_OPENCL_ERROR(status, "clCreateBuffer(priceBufAsync) failed.");
-
-            // create Buffer for priceDerivBufAsync
-            priceDerivBufAsync = clCreateBuffer(context,
-                                                CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                                                sizeof(cl_float4) * width * height * 2,
-                                                NULL,
-                                                &status);
-            CHECK_OPENCL_ERROR(status, "clCreateBuffer(priceDerivBufAsync) failed.");
-        }
-    }
-    else
-    {
-        // create Buffer for priceBuf
-        priceBuf = clCreateBuffer(context,
-                                  CL_MEM_WRITE_ONLY,
-                                  sizeof(cl_float4) * width * height * 2,
-                                  NULL,
-                                  &status);
-        CHECK_OPENCL_ERROR(status, "clCreateBuffer(priceBuf) failed.");
-
-        // create Buffer for priceDerivBuf
-        priceDerivBuf = clCreateBuffer(context,
-                                       CL_MEM_WRITE_ONLY,
-                                       sizeof(cl_float4) * width * height * 2,
-                                       NULL,
-                                       &status);
-        CHECK_OPENCL_ERROR(status, "clCreateBuffer(priceDerivBuf) failed.");
+        outMemFlags |= CL_MEM_ALLOC_HOST_PTR;
     }
 
+    accBuf = clCreateBuffer(context,
+                            outMemFlags,
+                            sizeof(cl_float) * steps * MOMENTS * 2,
+                            NULL,
+                            &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer(accBuf) failed.");
+
     // Create a CL program using the kernel source
     buildProgramData buildData;
     buildData.kernelName = std::string("MonteCarloAsian_Kernels.cl");
     buildData.devices = devices;
     buildData.deviceId = sampleArgs->deviceId;
-    buildData.flagsStr = std::string("");
+    buildData.flagsStr = std::string("-I.");
     if(sampleArgs->isLoadBinaryEnabled())
     {
         buildData.binaryName = std::string(sampleArgs->loadBinary.c_str());
@@ -362,15 +395,20 @@ MonteCarloAsian::setupCL(void)
     CHECK_ERROR(retValue, SDK_SUCCESS, "sampleCommon::buildOpenCLProgram() failed");
 
     // get a kernel object handle for a kernel with the given name
-    if (vectorWidth == 1)
-    {
-        kernel = clCreateKernel(program, "calPriceVega_Scalar", &status);
-        CHECK_OPENCL_ERROR(status, "clCreateKernel(calPriceVega_Scalar) failed.");
-    }
-    else
+    kernel = clCreateKernel(program, "calPriceVega", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel(calPriceVega) failed.");
+
+    accumulateKernel = clCreateKernel(program, "accumulate", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel(accumulate) failed.");
+
+    // Scalar kernel : one pair per work-item and four times the work-items
+    globalThreads[0] = width, globalThreads[1] = height;
+    localThreads[0] = blockSizeX, localThreads[1] = blockSizeY;
+
+    if(vectorWidth == 1)
     {
-        kernel = clCreateKernel(program, "calPriceVega_Vector", &status);
-        CHECK_OPENCL_ERROR(status, "clCreateKernel(calPriceVega_Vector) failed.");
+        globalThreads[0] *= VECTOR_SIZE;
+        localThreads[0] *= VECTOR_SIZE;
     }
 
     // Check group-size against what is returned by kernel
@@ -378,692 +416,204 @@ MonteCarloAsian::setupCL(void)
              devices[sampleArgs->deviceId]);
     CHECK_OPENCL_ERROR(status, "kernelInfo.setKernelWorkGroupInfo failed");
 
-    if((blockSizeX * blockSizeY) > kernelInfo.kernelWorkGroupSize)
+    if((localThreads[0] * localThreads[1]) > kernelInfo.kernelWorkGroupSize)
     {
         if(!sampleArgs->quiet)
         {
             std::cout << "Out of Resources!" << std::endl;
             std::cout << "Group Size specified : "
-                      << blockSizeX * blockSizeY << std::endl;
+                      << localThreads[0] * localThreads[1] << std::endl;
             std::cout << "Max Group Size supported on the kernel : "
                       << kernelInfo.kernelWorkGroupSize << std::endl;
             std::cout << "Falling back to " << kernelInfo.kernelWorkGroupSize << std::endl;
         }
 
-        // Three possible cases
-        if(blockSizeX > kernelInfo.kernelWorkGroupSize)
-        {
-            blockSizeX = kernelInfo.kernelWorkGroupSize;
-            blockSizeY = 1;
-        }
+        localThreads[0] = kernelInfo.kernelWorkGroupSize;
+        localThreads[1] = 1;
     }
 
+    if(localThreads[0] > deviceInfo.maxWorkItemSizes[0] ||
+            localThreads[1] > deviceInfo.maxWorkItemSizes[1] ||
+            (localThreads[0] * localThreads[1]) > deviceInfo.maxWorkGroupSize)
+    {
+        std::cout << "Unsupported: Device does not support requested"
+                  << ":number of work items.";
+        return SDK_FAILURE;
+    }
+
+    numGroups = (globalThreads[0] / localThreads[0]) *
+                (globalThreads[1] / localThreads[1]);
+
+    // The accumulate kernel runs a single group
+    KernelWorkGroupInfo accumulateInfo;
+    status = accumulateInfo.setKernelWorkGroupInfo(accumulateKernel,
+             devices[sampleArgs->deviceId]);
+    CHECK_OPENCL_ERROR(status, "accumulateInfo.setKernelWorkGroupInfo failed");
+
+    while(accumulateGroupSize > accumulateInfo.kernelWorkGroupSize)
+    {
+        accumulateGroupSize /= 2;
+    }
+
+    partialBuf = clCreateBuffer(context,
+                                CL_MEM_READ_WRITE,
+                                sizeof(cl_float) * numGroups * MOMENTS,
+                                NULL,
+                                &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer(partialBuf) failed.");
 
     return SDK_SUCCESS;
 }
 
 int
-MonteCarloAsian::setKernelArgs(int step, cl_mem *rand, cl_mem *price,
-                               cl_mem *priceDeriv)
+MonteCarloAsian::setKernelArgs(int k, cl_uint firstPair)
 {
     cl_int status;
     float timeStep = maturity / (noOfSum - 1);
 
     // Set up arguments required for kernel 1
-    float c1 = (interest - 0.5f * sigma[step] * sigma[step]) * timeStep;
-    float c2 = sigma[step] * sqrt(timeStep);
-    float c3 = (interest + 0.5f * sigma[step] * sigma[step]);
+    attributes.c1 = (interest - 0.5f * sigma[k] * sigma[k]) * timeStep;
+    attributes.c2 = sigma[k] * sqrt(timeStep);
+    attributes.c3 = (interest + 0.5f * sigma[k] * sigma[k]);
+    attributes.initPrice = initPrice;
+    attributes.strikePrice = strikePrice;
+    attributes.sigma = sigma[k];
+    attributes.timeStep = timeStep;
 
-    if (vectorWidth == 1)
-    {
-        attributesScalar.c1 = c1;
-        attributesScalar.c2 = c2;
-        attributesScalar.c3 = c3;
-        attributesScalar.initPrice = initPrice;
-        attributesScalar.strikePrice = strikePrice;
-        attributesScalar.sigma = sigma[step];
-        attributesScalar.timeStep = timeStep;
-
-        status = clSetKernelArg(kernel, 0, sizeof(attributesScalar),
-                                (void*)&attributesScalar);
-        CHECK_OPENCL_ERROR(status, "clSetKernelArg(attributesScalar) failed.");
-    }
-    else
-    {
-        const cl_float4 c1F4 = {c1, c1, c1, c1};
-        attributes.c1 = c1F4;
-
-        const cl_float4 c2F4 = {c2, c2, c2, c2};
-        attributes.c2 = c2F4;
-
-        const cl_float4 c3F4 = {c3, c3, c3, c3};
-        attributes.c3 = c3F4;
+    status = clSetKernelArg(kernel, 0, sizeof(attributes), (void*)&attributes);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(attributes) failed.");
 
-        const cl_float4 initPriceF4 = {initPrice, initPrice, initPrice, initPrice};
-        attributes.initPrice = initPriceF4;
+    status = clSetKernelArg(kernel, 2, sizeof(cl_uint), (void*)&firstPair);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(firstPair) failed.");
 
-        const cl_float4 strikePriceF4 = {strikePrice, strikePrice, strikePrice, strikePrice};
-        attributes.strikePrice = strikePriceF4;
+    // Set up arguments required for kernel 2
+    status = clSetKernelArg(accumulateKernel, 2, sizeof(cl_int), (void*)&k);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(option) failed.");
 
-        const cl_float4 sigmaF4 = {sigma[step], sigma[step], sigma[step], sigma[step]};
-        attributes.sigma = sigmaF4;
+    return SDK_SUCCESS;
+}
 
-        const cl_float4 timeStepF4 = {timeStep, timeStep, timeStep, timeStep};
-        attributes.timeStep = timeStepF4;
+int
+MonteCarloAsian::readAccumulators()
+{
+    cl_int status;
+    size_t size = steps * MOMENTS * 2 * sizeof(cl_float);
 
-        // Set appropriate arguments to the kernel
-        status = clSetKernelArg(kernel, 0, sizeof(attributes), (void*)&attributes);
-        CHECK_OPENCL_ERROR(status, "clSetKernelArg(attributes) failed.");
-    }
+    if(!disableMapping)
+    {
+        cl_event inEvent;
+        cl_event inUnEvent;
+        void* mapPtr;
+        status = asyncMapBuffer(accBuf, mapPtr, size, CL_MAP_READ, &inEvent);
+        CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(accBuf)");
 
-    status = clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*)rand);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(randBuf) failed.");
+        status = waitForEventAndRelease(&inEvent);
+        CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(inEvent) failed.");
 
-    status = clSetKernelArg(kernel, 3, sizeof(cl_mem), (void*)price);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(priceBuf) failed.");
+        memcpy((void*)acc, mapPtr, size);
 
-    status = clSetKernelArg(kernel, 4, sizeof(cl_mem), (void*)priceDeriv);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(priceDerivBuf) failed.");
+        status = asyncUnmapBuffer(accBuf, mapPtr, &inUnEvent);
+        CHECK_ERROR(status, SDK_SUCCESS, "Failed to unmap device buffer(accBuf).");
 
-    if(vectorWidth == 1)
-    {
-        status = clSetKernelArg(kernel, 5,
-                                blockSizeX*blockSizeY*VECTOR_SIZE*sizeof(cl_float2), NULL);
+        status = waitForEventAndRelease(&inUnEvent);
+        CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(inUnEvent) failed.");
     }
     else
     {
-        status = clSetKernelArg(kernel, 5, blockSizeX*blockSizeY*sizeof(cl_float8),
-                                NULL);
-    }
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(sData1) failed.");
-
-    return SDK_SUCCESS;
-}
-
-int
-MonteCarloAsian::runAsyncWithMappingDisabled()
-{
-    cl_event inWriteEvt1;
-    cl_event inWriteEvt2;
-    cl_event outReadEvt11;
-    cl_event outReadEvt12;
-    cl_event outReadEvt21;
-    cl_event outReadEvt22;
-    cl_event ndrEvt;
-    size_t size = width * height * sizeof(cl_float4);
-    size_t count = width * height * 4;
-    cl_int status;
-    size_t sizeAfterReduction = width * height  / blockSizeX /blockSizeY * 4;
-
-    for(int k = 0; k < steps / 2; k++)
-    {
-        // Fill data of input buffer for kernel 1
-        status = clEnqueueWriteBuffer(
-                     commandQueue,
-                     randBuf,
-                     CL_FALSE,
-                     0,
-                     size,
-                     (randNum + (2 * k * count)),
-                     0,
-                     NULL,
-                     &inWriteEvt1);
-        CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer(randBuf) failed.");
-        status = clFlush(commandQueue);
-        CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-        // Get data from output buffers of kernel 2
-        if(k != 0)
-        {
-            // Wait for kernel 2 to complete
-            status = waitForEventAndRelease(&ndrEvt);
-            CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(ndrEvt) failed.");
-
-            status = clEnqueueReadBuffer(
-                         commandQueue,
-                         priceBufAsync,
-                         CL_FALSE,
-                         0,
-                         size * 2,
-                         priceValsAsync,
-                         0,
-                         NULL,
-                         &outReadEvt21);
-            CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(priceBufAsync) failed.");
-            status = clEnqueueReadBuffer(
-                         commandQueue,
-                         priceDerivBufAsync,
-                         CL_FALSE,
-                         0,
-                         size * 2,
-                         priceDerivAsync,
-                         0,
-                         NULL,
-                         &outReadEvt22);
-            CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(priceDerivBufAsync) failed.");
-            status = clFlush(commandQueue);
-            CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-        }
-        // Set up arguments required for kernel 1
-        status = setKernelArgs(k * 2, &randBuf, &priceBuf, &priceDerivBuf);
-        CHECK_OPENCL_ERROR(status, "setKernelArgs failed.");
-
-        // Wait for input of kernel to complete
-        status = waitForEventAndRelease(&inWriteEvt1);
-        CHECK_OPENCL_ERROR(status, "clWaitForEventsAndRelease(inWriteEvt1) failed.");
-
-        // Enqueue kernel 1
-        status = clEnqueueNDRangeKernel(commandQueue,
-                                        kernel,
-                                        2,
-                                        NULL,
-                                        globalThreads,
-                                        localThreads,
-                                        0,
-                                        NULL,
-                                        &ndrEvt);
-        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel() failed.");
-        status = clFlush(commandQueue);
-        CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-        /* Generate data of input for kernel 2
-         Fill data of input buffer for kernel 2*/
-        if(k <= steps - 1)
-        {
-            // Fill data of input buffer for kernel 2
-            status = clEnqueueWriteBuffer(
-                         commandQueue,
-                         randBufAsync,
-                         CL_FALSE,
-                         0,
-                         size,
-                         (randNum + (((2 * k) +1) * count)),
-                         0,
-                         NULL,
-                         &inWriteEvt2);
-            CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer(randBufAsync) failed.");
-            status = clFlush(commandQueue);
-            CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-        }
-        // Wait for output buffers of kernel 2 to complete
-        // Calculate the results from output of kernel 2
-        if(k != 0)
-        {
-            // Wait for output buffers of kernel 2 to complete
-            status = waitForEventAndRelease(&outReadEvt21);
-            CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(outReadEvt21) failed.");
-            status = waitForEventAndRelease(&outReadEvt22);
-            CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(outReadEvt22) failed.");
-            // Calculate the results from output of kernel 2
-            for(size_t i = 0; i < sizeAfterReduction; i++)
-            {
-                price[k * 2 - 1] += priceValsAsync[i];
-                vega[k * 2 - 1] += priceDerivAsync[i];
-            }
-            price[k * 2 - 1] /= (noOfTraj * noOfTraj);
-            vega[k * 2 - 1] /= (noOfTraj * noOfTraj);
-            price[k * 2 - 1] = exp(-interest * maturity) * price[k * 2 - 1];
-            vega[k * 2 - 1] = exp(-interest * maturity) * vega[k * 2 - 1];
-        }
-        // Wait for kernel 1 to complete
-        status = waitForEventAndRelease(&ndrEvt);
-        CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(ndrEvt) failed.");
-        // Get data from output buffers of kernel 1
-        status = clEnqueueReadBuffer(commandQueue,
-                                     priceBuf,
-                                     CL_TRUE,
-                                     0,
-                                     size * 2,
-                                     priceVals,
-                                     0,
-                                     NULL,
-                                     &outReadEvt11);
-        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(priceBuf) failed.");
+        // Enqueue the results to application pointer
         status = clEnqueueReadBuffer(commandQueue,
-                                     priceDerivBuf,
+                                     accBuf,
                                      CL_TRUE,
                                      0,
-                                     size * 2,
-                                     priceDeriv,
+                                     size,
+                                     acc,
                                      0,
                                      NULL,
-                                     &outReadEvt12);
-        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(priceDerivBuf) failed.");
-        status = clFlush(commandQueue);
-        CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-        // Set up arguments required for kernel 2
-        status = setKernelArgs((k * 2 + 1), &randBufAsync, &priceBufAsync,
-                               &priceDerivBufAsync);
-        CHECK_OPENCL_ERROR(status, "setKernelArgs failed.");
-        // Wait for input of kernel 2 to complete
-        status = waitForEventAndRelease(&inWriteEvt2);
-        CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(inWriteEvt2) failed.");
-
-        // Enqueue kernel 2
-        status = clEnqueueNDRangeKernel(commandQueue,
-                                        kernel,
-                                        2,
-                                        NULL,
-                                        globalThreads,
-                                        localThreads,
-                                        0,
-                                        NULL,
-                                        &ndrEvt);
-        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel() failed.");
-        status = clFlush(commandQueue);
-        CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-
-        // Wait for output buffers of kernel 1 to complete
-        status = waitForEventAndRelease(&outReadEvt11);
-        CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(outReadEvt11) failed.");
-        status = waitForEventAndRelease(&outReadEvt12);
-        CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(outReadEvt12) failed.");
-        for(size_t i = 0; i < sizeAfterReduction; i++)
-        {
-            price[k * 2] += priceVals[i];
-            vega[k * 2] += priceDeriv[i];
-        }
-        price[k * 2] /= (noOfTraj * noOfTraj);
-        vega[k * 2] /= (noOfTraj * noOfTraj);
-        price[k * 2] = exp(-interest * maturity) * price[k * 2];
-        vega[k * 2] = exp(-interest * maturity) * vega[k * 2];
+                                     NULL);
+        CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(accBuf) failed.");
     }
-    // Wait for kernel 1 to complete
-    status = waitForEventAndRelease(&ndrEvt);
-    CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(ndrEvt) failed.");
-    // Gather last kernel 2 execution here
-    status = clEnqueueReadBuffer(
-                 commandQueue,
-                 priceBufAsync,
-                 CL_FALSE,
-                 0,
-                 size * 2,
-                 priceValsAsync,
-                 0,
-                 NULL,
-                 &outReadEvt21);
-    CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(priceBufAsync) failed.");
-    status = clEnqueueReadBuffer(
-                 commandQueue,
-                 priceDerivBufAsync,
-                 CL_FALSE,
-                 0,
-                 size * 2,
-                 priceDerivAsync,
-                 0,
-                 NULL,
-                 &outReadEvt22);
-    CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(priceDerivBufAsync) failed.");
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-    // Wait for output buffers of kernel 2 to complete
-    status = waitForEventAndRelease(&outReadEvt21);
-    CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(outReadEvt21) failed.");
-    status = waitForEventAndRelease(&outReadEvt22);
-    CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(outReadEvt22) failed.");
-
-    // Calculate the results from output of kernel 2
-    for(size_t i = 0; i < sizeAfterReduction; i++)
-    {
-        price[steps - 1] += priceValsAsync[i];
-        vega[steps - 1] += priceDerivAsync[i];
-    }
-    price[steps - 1] /= (noOfTraj * noOfTraj);
-    vega[steps - 1] /= (noOfTraj * noOfTraj);
-    price[steps - 1] = exp(-interest * maturity) * price[steps - 1];
-    vega[steps - 1] = exp(-interest * maturity) * vega[steps - 1];
 
     return SDK_SUCCESS;
 }
 
 int
-MonteCarloAsian::runAsyncWithMappingEnabled()
+MonteCarloAsian::runCLKernels(void)
 {
-    void* inMapPtr1 = NULL;
-    void* inMapPtr2 = NULL;
-    void* outMapPtr11 = NULL;
-    void* outMapPtr12 = NULL;
-    void* outMapPtr21 = NULL;
-    void* outMapPtr22 = NULL;
-    cl_float* ptr21 = NULL;
-    cl_float* ptr22 = NULL;
-    cl_event inMapEvt1;
-    cl_event inMapEvt2;
-    cl_event inUnmapEvt1;
-    cl_event inUnmapEvt2;
-    cl_event outMapEvt11;
-    cl_event outMapEvt12;
-    cl_event outUnmapEvt11;
-    cl_event outUnmapEvt12;
-    cl_event outMapEvt21;
-    cl_event outMapEvt22;
-    cl_event outUnmapEvt21;
-    cl_event outUnmapEvt22;
-    cl_event ndrEvt;
     cl_int status;
-    cl_int eventStatus = CL_QUEUED;
-
-    size_t count = width * height * 4;
-    size_t sizeAfterReduction = width * height  / blockSizeX /blockSizeY * 4;
-    size_t size = width * height * sizeof(cl_float4);
+    cl_int pathsPerItem = (vectorWidth == 1) ? 1 : VECTOR_SIZE;
+    cl_int sampling = (useSobol ? SAMPLING_SOBOL : 0) |
+                      (antithetic ? SAMPLING_ANTITHETIC : 0);
+    cl_int numPartials = (cl_int)numGroups;
+    size_t groupSize = localThreads[0] * localThreads[1];
 
-    for(int k = 0; k < steps / 2; k++)
-    {
-        // Map input buffer for kernel 1
-        status = asyncMapBuffer( randBuf, inMapPtr1, size,
-                                 CL_MAP_WRITE_INVALIDATE_REGION, &inMapEvt1);
-        CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(randBuf)");
-
-        // Wait for map of input of kernel 1
-        status = waitForEventAndRelease(&inMapEvt1);
-        CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(inMapEvt1) failed.");
-
-        memcpy(inMapPtr1, (void*)(randNum + (2 * k * count)), size);
-        // Unmap of input buffer of kernel 1
-        status = asyncUnmapBuffer(randBuf, inMapPtr1, &inUnmapEvt1);
-        CHECK_ERROR(status, SDK_SUCCESS, "Failed to unmap device buffer(randBuf).");
-
-        // Get data from output buffers of kernel 2
-        if(k != 0)
-        {
-            // Wait for kernel 2 to complete
-            status = waitForEventAndRelease(&ndrEvt);
-            CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(ndrEvt) failed.");
-
-            status = asyncMapBuffer( priceBufAsync, outMapPtr21, sizeAfterReduction,
-                                     CL_MAP_READ, &outMapEvt21);
-            CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(priceBufAsync)");
-            status = asyncMapBuffer( priceDerivBufAsync, outMapPtr22, sizeAfterReduction,
-                                     CL_MAP_READ, &outMapEvt22);
-            CHECK_ERROR(status, SDK_SUCCESS,
-                        "Failed to map device buffer.(priceDerivBufAsync)");
-        }
-
-        // Set up arguments required for kernel 1
-        status = setKernelArgs(k * 2, &randBuf, &priceBuf, &priceDerivBuf);
-        CHECK_OPENCL_ERROR(status, "setKernelArgs failed.");
-
-        // Wait for input of kernel 1 to complete
-        status = waitForEventAndRelease(&inUnmapEvt1);
-        CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(inUnmapEvt1) failed.");
-
-        inMapPtr1 = NULL;
-        // Enqueue kernel 1
-        status = clEnqueueNDRangeKernel(commandQueue,
-                                        kernel,
-                                        2,
-                                        NULL,
-                                        globalThreads,
-                                        localThreads,
-                                        0,
-                                        NULL,
-                                        &ndrEvt);
-        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel() failed.");
-        status = clFlush(commandQueue);
-        CHECK_OPENCL_ERROR(status, "clFlush() failed.");
+    status = clSetKernelArg(kernel, 1, sizeof(cl_int), (void*)&noOfSum);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(noOfSum) failed.");
 
-        // Fill data of input buffer for kernel 2
-        if(k <= steps - 1)
-        {
-            // Map input buffer for kernel 1
-            status = asyncMapBuffer( randBufAsync, inMapPtr2, size,
-                                     CL_MAP_WRITE_INVALIDATE_REGION, &inMapEvt2);
-            CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(randBufAsync)");
+    status = clSetKernelArg(kernel, 3, sizeof(cl_int), (void*)&pathsPerItem);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(pathsPerItem) failed.");
 
-            // Wait for map of input of kernel 1
-            status = waitForEventAndRelease(&inMapEvt2);
-            CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(inMapEvt2) failed.");
+    status = clSetKernelArg(kernel, 4, sizeof(cl_uint), (void*)&seed);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(seed) failed.");
 
-            memcpy(inMapPtr2, (void*)(randNum + (((2 * k) +1) * count)), size);
+    status = clSetKernelArg(kernel, 5, sizeof(cl_int), (void*)&sampling);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(sampling) failed.");
 
-            // Unmap of input buffer of kernel 1
-            status = asyncUnmapBuffer(randBufAsync, inMapPtr2, &inUnmapEvt2);
-            CHECK_ERROR(status, SDK_SUCCESS,
-                        "Failed to unmap device buffer(randBufAsync).");
-        }
-        // Wait for output buffers of kernel 2 to complete
-        // Calculate the results from output of kernel 2
-        if(k != 0)
-        {
-            // Wait for output buffers of kernel 2 to complete
-            status = waitForEventAndRelease(&outMapEvt21);
-            CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outMapEvt21) failed.");
-            status = waitForEventAndRelease(&outMapEvt22);
-            CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outMapEvt22) failed.");
-
-            // Calculate the results from output of kernel 2
-            ptr21 = (cl_float*)outMapPtr21;
-            ptr22 = (cl_float*)outMapPtr22;
-            for(size_t i = 0; i < sizeAfterReduction; i++)
-            {
-                price[k * 2 - 1] += ptr21[i];
-                vega[k * 2 - 1] += ptr22[i];
-            }
-            price[k * 2 - 1] /= (noOfTraj * noOfTraj);
-            vega[k * 2 - 1] /= (noOfTraj * noOfTraj);
-            price[k * 2 - 1] = exp(-interest * maturity) * price[k * 2 - 1];
-            vega[k * 2 - 1] = exp(-interest * maturity) * vega[k * 2 - 1];
-
-            // Unmap of output buffers of kernel 2
-            status = asyncUnmapBuffer(priceBufAsync, outMapPtr21, &outUnmapEvt21);
-            CHECK_ERROR(status, SDK_SUCCESS,
-                        "Failed to unmap device buffer(priceBufAsync).");
-            status = asyncUnmapBuffer(priceDerivBufAsync, outMapPtr22, &outUnmapEvt22);
-            CHECK_ERROR(status, SDK_SUCCESS,
-                        "Failed to unmap device buffer(priceDerivBufAsync).");
-
-            status = waitForEventAndRelease(&outUnmapEvt21);
-            CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outUnmapEvt21) failed.");
-            status = waitForEventAndRelease(&outUnmapEvt22);
-            CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outUnmapEvt22) failed.");
-        }
-        // Wait for kernel 1 to complete
-        status = waitForEventAndRelease(&ndrEvt);
-        CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(ndrEvt) failed.");
-
-        // Get data from output buffers of kernel 1
-        status = asyncMapBuffer( priceBuf, outMapPtr11, sizeAfterReduction, CL_MAP_READ,
-                                 &outMapEvt11);
-        CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(priceBuf)");
-        status = asyncMapBuffer( priceDerivBuf, outMapPtr12, sizeAfterReduction,
-                                 CL_MAP_READ, &outMapEvt12);
-        CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(priceDerivBuf)");
-
-        // Set up arguments required for kernel 2
-        status = setKernelArgs((k * 2 + 1), &randBufAsync, &priceBufAsync,
-                               &priceDerivBufAsync);
-        CHECK_OPENCL_ERROR(status, "setKernelArgs failed.");
-        // Wait for input of kernel 2 to complete
-        status = waitForEventAndRelease(&inUnmapEvt2);
-        CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(inUnmapEvt2) failed.");
-
-        // Enqueue kernel 2
-        status = clEnqueueNDRangeKernel(commandQueue,
-                                        kernel,
-                                        2,
-                                        NULL,
-                                        globalThreads,
-                                        localThreads,
-                                        0,
-                                        NULL,
-                                        &ndrEvt);
-        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel() failed.");
-        status = clFlush(commandQueue);
-        CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-        // Wait for output buffers of kernel 1 to complete
-        status = waitForEventAndRelease(&outMapEvt11);
-        CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outMapEvt11) failed.");
-        status = waitForEventAndRelease(&outMapEvt12);
-        CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outMapEvt12) failed.");
-
-        // Calculate the results from output of kernel 2
-        ptr21 = (cl_float*)outMapPtr11;
-        ptr22 = (cl_float*)outMapPtr12;
-        for(size_t i = 0; i < sizeAfterReduction; i++)
-        {
-            price[k * 2] += ptr21[i];
-            vega[k * 2] += ptr22[i];
-
-        }
-        price[k * 2] /= (noOfTraj * noOfTraj);
-        vega[k * 2] /= (noOfTraj * noOfTraj);
-        price[k * 2] = exp(-interest * maturity) * price[k * 2];
-        vega[k * 2] = exp(-interest * maturity) * vega[k * 2];
-
-        // Unmap of output buffers of kernel 2
-        status = asyncUnmapBuffer(priceBuf, outMapPtr11, &outUnmapEvt11);
-        CHECK_ERROR(status, SDK_SUCCESS, "Failed to unmap device buffer(priceBuf).");
-        status = asyncUnmapBuffer(priceDerivBuf, outMapPtr12, &outUnmapEvt12);
-        CHECK_ERROR(status, SDK_SUCCESS,
-                    "Failed to unmap device buffer(priceDerivBuf).");
-
-        status = waitForEventAndRelease(&outUnmapEvt11);
-        CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outUnmapEvt11) failed.");
-        status = waitForEventAndRelease(&outUnmapEvt12);
-        CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outUnmapEvt12) failed.");
-    }
-    // Wait for kernel 1 to complete
-    status = waitForEventAndRelease(&ndrEvt);
-    CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(ndrEvt) failed.");
-
-    // Gather last kernel 2 execution here
-    status = asyncMapBuffer( priceBufAsync, outMapPtr21, sizeAfterReduction,
-                             CL_MAP_READ, &outMapEvt21);
-    CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(priceBufAsync)");
-
-    status = asyncMapBuffer( priceDerivBufAsync, outMapPtr22, sizeAfterReduction,
-                             CL_MAP_READ, &outMapEvt22);
-    CHECK_ERROR(status, SDK_SUCCESS,
-                "Failed to map device buffer.(priceDerivBufAsync)");
-
-    status = waitForEventAndRelease(&outMapEvt21);
-    CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outMapEvt21) failed.");
-    status = waitForEventAndRelease(&outMapEvt22);
-    CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(outMapEvt22) failed.");
-
-    // Calculate the results from output of kernel 2
-    ptr21 = (cl_float*)outMapPtr21;
-    ptr22 = (cl_float*)outMapPtr22;
-    for(size_t i = 0; i < sizeAfterReduction; i++)
-    {
-        price[steps - 1] += ptr21[i];
-        vega[steps - 1] += ptr22[i];
-    }
-    price[steps - 1] /= (noOfTraj * noOfTraj);
-    vega[steps - 1] /= (noOfTraj * noOfTraj);
-    price[steps - 1] = exp(-interest * maturity) * price[steps - 1];
-    vega[steps - 1] = exp(-interest * maturity) * vega[steps - 1];
+    status = clSetKernelArg(kernel, 6, sizeof(cl_mem), (void*)&sobolBuf);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(sobolBuf) failed.");
 
-    return SDK_SUCCESS;
-}
+    status = clSetKernelArg(kernel, 7, sizeof(cl_mem), (void*)&partialBuf);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(partialBuf) failed.");
 
+    status = clSetKernelArg(kernel, 8, groupSize * MOMENTS * sizeof(cl_float), NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(sData) failed.");
 
-int
-MonteCarloAsian::runCLKernels(void)
-{
-    cl_int status;
-    cl_int eventStatus = CL_QUEUED;
-    globalThreads[0] = width, globalThreads[1] = height;
-    localThreads[0] = blockSizeX, localThreads[1] = blockSizeY;
+    status = clSetKernelArg(accumulateKernel, 0, sizeof(cl_mem), (void*)&partialBuf);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(partialBuf) failed.");
 
-    size_t count = width * height * 4;
-    size_t sizeAfterReduction = width * height  / blockSizeX /blockSizeY * 4;
+    status = clSetKernelArg(accumulateKernel, 1, sizeof(cl_int), (void*)&numPartials);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(numPartials) failed.");
 
-    if(vectorWidth == 1)
-    {
-        globalThreads[0] *= VECTOR_SIZE;
-        localThreads[0] *= VECTOR_SIZE;
-    }
+    status = clSetKernelArg(accumulateKernel, 3, sizeof(cl_mem), (void*)&accBuf);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(accBuf) failed.");
 
-    if(localThreads[0] > deviceInfo.maxWorkItemSizes[0] ||
-            localThreads[1] > deviceInfo.maxWorkItemSizes[1] ||
-            (localThreads[0] * localThreads[1]) > deviceInfo.maxWorkGroupSize)
-    {
-        std::cout << "Unsupported: Device does not support requested"
-                  << ":number of work items.";
-        return SDK_FAILURE;
-    }
+    status = clSetKernelArg(accumulateKernel, 4,
+                            accumulateGroupSize * MOMENTS * sizeof(cl_float), NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(sData) failed.");
 
-    status = clSetKernelArg(kernel, 1, sizeof(cl_int), (void*)&noOfSum);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(noOfSum) failed.");
+    // Clear the running sums
+    memset((void*)acc, 0, steps * MOMENTS * 2 * sizeof(cl_float));
+    status = clEnqueueWriteBuffer(commandQueue,
+                                  accBuf,
+                                  CL_TRUE,
+                                  0,
+                                  steps * MOMENTS * 2 * sizeof(cl_float),
+                                  acc,
+                                  0,
+                                  NULL,
+                                  NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer(accBuf) failed.");
 
-    if(vectorWidth == 1)
+    for(int k = 0; k < steps; k++)
     {
-        status = clSetKernelArg(kernel, 6, localThreads[0] * sizeof(cl_uint), NULL);
-        CHECK_OPENCL_ERROR(status, "clSetKernelArg(rand1) failed.");
-
-        status = clSetKernelArg(kernel, 7, localThreads[0] * sizeof(cl_uint), NULL);
-        CHECK_OPENCL_ERROR(status, "clSetKernelArg(rand2) failed.");
+        batchesDone[k] = 0;
+        halfWidth[k] = 0.0f;
     }
 
-    float timeStep = maturity / (noOfSum - 1);
-
-    // Initialize random number generator
-    srand(1);
-    if(!disableAsync)
+    bool converged = false;
+    for(int b = 0; b < batches && !converged; b++)
     {
-        if(disableMapping)
-        {
-            status = runAsyncWithMappingDisabled();
-            if(status != SDK_SUCCESS)
-            {
-                return status;
-            }
-        }
-        else
-        {
-            status = runAsyncWithMappingEnabled();
-            if(status != SDK_SUCCESS)
-            {
-                return status;
-            }
-        }
-    }
-    else
-    {
-        cl_event events[1];
+        cl_uint firstPair = (cl_uint)b * pairsPerBatch;
 
         for(int k = 0; k < steps; k++)
         {
-            if(!dUseInPersistent)
+            // Options within epsilon are not simulated any further
+            if(epsilon > 0.0f && b > 0 && halfWidth[k] < epsilon)
             {
-                if(disableMapping)
-                {
-                    status = clEnqueueWriteBuffer(
-                                 commandQueue,
-                                 randBuf,
-                                 CL_TRUE,
-                                 0,
-                                 width * height * sizeof(cl_float4),
-                                 (randNum + (k * count)),
-                                 0,
-                                 NULL,
-                                 NULL);
-                    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer(randBuf) failed.");
-                }
-                else
-                {
-                    cl_event inEvent;
-                    cl_event inUnEvent;
-                    void* mapPtr;
-                    status = asyncMapBuffer( randBuf, mapPtr, (width * height * sizeof(cl_float4)),
-                                             CL_MAP_WRITE_INVALIDATE_REGION, &inEvent);
-                    CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(randBuf)");
-
-                    status = waitForEventAndRelease(&inEvent);
-                    CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(inEvent) failed.");
-
-                    memcpy(mapPtr, (void*)(randNum + (k * count)),
-                           width * height * sizeof(cl_float4));
-
-                    status = asyncUnmapBuffer(randBuf, mapPtr, &inUnEvent);
-                    CHECK_ERROR(status, SDK_SUCCESS, "Failed to unmap device buffer(randBuf).");
-
-                    status = waitForEventAndRelease(&inUnEvent);
-                    CHECK_OPENCL_ERROR(status, "clWaitForEventAndRelease(inUnEvent) failed.");
-                }
+                continue;
             }
 
-            status = setKernelArgs(k, &randBuf, &priceBuf, &priceDerivBuf);
-            CHECK_OPENCL_ERROR(status, "setKernelArgs failed.");
+            status = setKernelArgs(k, firstPair);
+            CHECK_ERROR(status, SDK_SUCCESS, "setKernelArgs failed.");
 
             // Enqueue a kernel run call.
             status = clEnqueueNDRangeKernel(commandQueue,
@@ -1074,101 +624,62 @@ MonteCarloAsian::runCLKernels(void)
                                             localThreads,
                                             0,
                                             NULL,
-                                            &events[0]);
-
-            CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel() failed.");
-
-            status = clFlush(commandQueue);
-            CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-
-            // wait for the kernel call to finish execution
-            status = waitForEventAndRelease(&events[0]);
-            CHECK_ERROR(status,0, "WaitForEventAndRelease(events[0]) Failed");
-
-            if(!disableMapping)
-            {
-                cl_event inEvent;
-                cl_event inUnEvent;
-                void* mapPtr;
-                status = asyncMapBuffer( priceBuf, mapPtr,
-                                         (width * height * 2 * sizeof(cl_float4)), CL_MAP_READ, &inEvent);
-                CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(priceBuf)");
-
-                status = waitForEventAndRelease(&inEvent);
-                CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(inEvent) failed.");
-
-                memcpy((void*)priceVals, mapPtr, width * height * 2 * sizeof(cl_float4));
-
-                status = asyncUnmapBuffer(priceBuf, mapPtr, &inUnEvent);
-                CHECK_ERROR(status, SDK_SUCCESS, "Failed to unmap device buffer(priceBuf).");
-
-                status = waitForEventAndRelease(&inUnEvent);
-                CHECK_ERROR(status,0, "WaitForEventAndRelease(inUnEvent) Failed");
+                                            NULL);
+            CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel(calPriceVega) failed.");
 
-                status = asyncMapBuffer( priceDerivBuf, mapPtr,
-                                         (width * height * 2 * sizeof(cl_float4)), CL_MAP_READ, &inEvent);
-                CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(priceDerivBuf)");
+            // Add the group sums to the running sums of the option
+            status = clEnqueueNDRangeKernel(commandQueue,
+                                            accumulateKernel,
+                                            1,
+                                            NULL,
+                                            &accumulateGroupSize,
+                                            &accumulateGroupSize,
+                                            0,
+                                            NULL,
+                                            NULL);
+            CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel(accumulate) failed.");
 
-                status = waitForEventAndRelease(&inEvent);
-                CHECK_OPENCL_ERROR(status, "waitForEventAndRelease(inEvent) failed.");
+            batchesDone[k]++;
+        }
 
-                memcpy((void*)priceDeriv, mapPtr, width * height * 2 * sizeof(cl_float4));
+        status = clFlush(commandQueue);
+        CHECK_OPENCL_ERROR(status, "clFlush() failed.");
 
-                status = asyncUnmapBuffer(priceDerivBuf, mapPtr, &inUnEvent);
-                CHECK_ERROR(status, SDK_SUCCESS,
-                            "Failed to unmap device buffer(priceDerivBuf).");
+        // Fixed mode reads the sums once, epsilon mode after every batch
+        if(epsilon > 0.0f || b == batches - 1)
+        {
+            status = readAccumulators();
+            CHECK_ERROR(status, SDK_SUCCESS, "readAccumulators() failed.");
 
-                status = waitForEventAndRelease(&inUnEvent);
-                CHECK_OPENCL_ERROR(status, "WaitForEventAndRelease(inUnEvent) Failed");
-            }
-            else
+            float maxHalfWidth = 0.0f;
+            double maxPaths = 0.0;
+            converged = true;
+            for(int k = 0; k < steps; k++)
             {
-                // Enqueue the results to application pointer
-                status = clEnqueueReadBuffer(commandQueue,
-                                             priceBuf,
-                                             CL_TRUE,
-                                             0,
-                                             width * height * 2 * sizeof(cl_float4),
-                                             priceVals,
-                                             0,
-                                             NULL,
-                                             &events[0]);
-                CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(priceBuf) failed.");
-
-                // wait for the read buffer to finish execution
-                status = waitForEventAndRelease(&events[0]);
-                CHECK_OPENCL_ERROR(status, "clWaitForEventsAndRelease(events[0]) failed.");
-
-                // Enqueue the results to application pointer
-                status = clEnqueueReadBuffer(commandQueue,
-                                             priceDerivBuf,
-                                             CL_TRUE,
-                                             0,
-                                             width * height * 2 * sizeof(cl_float4),
-                                             priceDeriv,
-                                             0,
-                                             NULL,
-                                             &events[0]);
-                CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(priceDerivBuf) failed.");
-
-                // wait for the read buffer to finish execution
-                status = waitForEventAndRelease(&events[0]);
-                CHECK_OPENCL_ERROR(status, "clWaitForEventsAndRelease(events[0]) failed.");
+                double moments[MOMENTS];
+                for(int m = 0; m < MOMENTS; m++)
+                {
+                    moments[m] = (double)acc[(k * MOMENTS + m) * 2]
+                                 - (double)acc[(k * MOMENTS + m) * 2 + 1];
+                }
+
+                double n = (double)batchesDone[k] * pairsPerBatch;
+                estimate(k, moments, n, &price[k], &vega[k], &halfWidth[k]);
 
+                maxHalfWidth = std::max(maxHalfWidth, halfWidth[k]);
+                maxPaths = std::max(maxPaths, 2.0 * n);
+                if(halfWidth[k] >= epsilon)
+                {
+                    converged = false;
+                }
             }
-            // Replace Following "for" loop with reduction kernel
 
-            for(size_t i = 0; i < sizeAfterReduction; i++)
+            if(epsilon > 0.0f && !sampleArgs->quiet)
             {
-                price[k] += priceVals[i];
-                vega[k] += priceDeriv[i];
+                std::cout << "Batch " << b + 1 << " : " << (cl_ulong)maxPaths
+                          << " paths, max CI half-width " << maxHalfWidth
+                          << std::endl;
             }
-
-            price[k] /= (noOfTraj * noOfTraj);
-            vega[k] /= (noOfTraj * noOfTraj);
-
-            price[k] = exp(-interest * maturity) * price[k];
-            vega[k] = exp(-interest * maturity) * vega[k];
         }
     }
 
@@ -1181,7 +692,7 @@ MonteCarloAsian::initialize()
     // Call base class Initialize to get default configuration
     CHECK_ERROR(sampleArgs->initialize(), SDK_SUCCESS,
                 "OpenCL resource initialization failed");
-    const int optionsCount = 7;
+    const int optionsCount = 12;
     Option *optionList = new Option[optionsCount];
     CHECK_ALLOCATION(optionList, " Allocate memory failed (optionList)\n");
 
@@ -1229,6 +740,41 @@ MonteCarloAsian::initialize()
     optionList[6]._type = CA_NO_ARGUMENT;
     optionList[6]._value = &useVectorKernel;
 
+    optionList[7]._sVersion = "";
+    optionList[7]._lVersion = "antithetic";
+    optionList[7]._description =
+        "Second path of every pair is the antithetic of the first one";
+    optionList[7]._type = CA_NO_ARGUMENT;
+    optionList[7]._value = &antithetic;
+
+    optionList[8]._sVersion = "";
+    optionList[8]._lVersion = "controlVariate";
+    optionList[8]._description =
+        "Use the geometric average option as control variate";
+    optionList[8]._type = CA_NO_ARGUMENT;
+    optionList[8]._value = &controlVariate;
+
+    optionList[9]._sVersion = "";
+    optionList[9]._lVersion = "sobol";
+    optionList[9]._description =
+        "Quasi-random paths from a shifted Sobol sequence";
+    optionList[9]._type = CA_NO_ARGUMENT;
+    optionList[9]._value = &useSobol;
+
+    optionList[10]._sVersion = "";
+    optionList[10]._lVersion = "epsilon";
+    optionList[10]._description =
+        "Run batches until the 95% confidence half-width of every price is below epsilon";
+    optionList[10]._type = CA_ARG_FLOAT;
+    optionList[10]._value = &epsilon;
+
+    optionList[11]._sVersion = "";
+    optionList[11]._lVersion = "batches";
+    optionList[11]._description =
+        "Batches of 1M paths per option (Default 1, maximum with --epsilon 256)";
+    optionList[11]._type = CA_ARG_INT;
+    optionList[11]._value = &batches;
+
     for(cl_int i = 0; i < optionsCount; ++i)
     {
         sampleArgs->AddOption(&optionList[i]);
@@ -1301,7 +847,7 @@ MonteCarloAsian::initialize()
 
     disableAsync_option->_sVersion = "";
     disableAsync_option->_lVersion = "dAsync";
-    disableAsync_option->_description = "Disables Asynchronous.";
+    disableAsync_option->_description = "Disables Asynchronous. (Unused, batches are accumulated on the device)";
     disableAsync_option->_type = CA_NO_ARGUMENT;
     disableAsync_option->_value = &disableAsync;
 
@@ -1312,6 +858,7 @@ MonteCarloAsian::initialize()
     return SDK_SUCCESS;
 }
 
+
 int MonteCarloAsian::setup()
 {
     if(iterations < 1)
@@ -1382,373 +929,239 @@ int MonteCarloAsian::run()
     {
         printArray<cl_float>("price", price, steps, 1);
         printArray<cl_float>("vega", vega, steps, 1);
+        printArray<cl_float>("price CI half-width", halfWidth, steps, 1);
     }
 
     return SDK_SUCCESS;
 }
 
+
 void
 MonteCarloAsian::printStats()
 {
     if(sampleArgs->timing)
     {
-        std::string strArray[4] =
+        std::string strArray[7] =
         {
             "Steps",
             "Setup Time(sec)",
             "Avg. Kernel Time (sec)",
-            "Samples used /sec"
+            "Samples used /sec",
+            "Max paths per option",
+            "Max batches",
+            "Max CI half-width"
         };
-        std::string stats[4];
+        std::string stats[7];
+
+        double totalPaths = 0.0;
+        int maxBatches = 0;
+        float maxHalfWidth = 0.0f;
+        for(int k = 0; k < steps; k++)
+        {
+            totalPaths += 2.0 * batchesDone[k] * pairsPerBatch;
+            maxBatches = std::max(maxBatches, (int)batchesDone[k]);
+            maxHalfWidth = std::max(maxHalfWidth, halfWidth[k]);
+        }
 
         double avgKernelTime = (kernelTime / iterations);
         stats[0] = toString(steps, std::dec);
         stats[1] = toString(setupTime, std::dec);
         stats[2] = toString(avgKernelTime, std::dec);
-        stats[3] = toString((noOfTraj * (noOfSum - 1) * steps) /
+        stats[3] = toString((totalPaths * (noOfSum - 1)) /
                             avgKernelTime, std::dec);
+        stats[4] = toString((cl_ulong)maxBatches * pairsPerBatch * 2, std::dec);
+        stats[5] = toString(maxBatches, std::dec);
+        stats[6] = toString(maxHalfWidth, std::dec);
 
-        printStatistics(strArray, stats, 4);
+        printStatistics(strArray, stats, 7);
     }
 }
 
 void
-MonteCarloAsian::lshift128(unsigned int* input,
-                           unsigned int shift,
-                           unsigned int * output)
-{
-    unsigned int invshift = 32u - shift;
-
-    output[0] = input[0] << shift;
-    output[1] = (input[1] << shift) | (input[0] >> invshift);
-    output[2] = (input[2] << shift) | (input[1] >> invshift);
-    output[3] = (input[3] << shift) | (input[2] >> invshift);
-}
-
-void
-MonteCarloAsian::rshift128(unsigned int* input,
-                           unsigned int shift,
-                           unsigned int* output)
-{
-    unsigned int invshift = 32u - shift;
-    output[3]= input[3] >> shift;
-    output[2] = (input[2] >> shift) | (input[0] >> invshift);
-    output[1] = (input[1] >> shift) | (input[1] >> invshift);
-    output[0] = (input[0] >> shift) | (input[2] >> invshift);
-}
-
-void
-MonteCarloAsian::generateRand(unsigned int* seed,
+MonteCarloAsian::generateRand(cl_uint pair,
+                              cl_uint step,
                               float *gaussianRand1,
-                              float *gaussianRand2,
-                              unsigned int* nextRand)
+                              float *gaussianRand2)
 {
-
-    unsigned int mulFactor = 4;
-    unsigned int temp[8][4];
-    unsigned int state1[4] = {seed[0], seed[1], seed[2], seed[3]};
-    unsigned int state2[4] = {0u, 0u, 0u, 0u};
-    unsigned int state3[4] = {0u, 0u, 0u, 0u};
-    unsigned int state4[4] = {0u, 0u, 0u, 0u};
-    unsigned int state5[4] = {0u, 0u, 0u, 0u};
-    unsigned int stateMask = 1812433253u;
-    unsigned int thirty = 30u;
-    unsigned int mask4[4] = {stateMask, stateMask, stateMask, stateMask};
-    unsigned int thirty4[4] = {thirty, thirty, thirty, thirty};
-    unsigned int one4[4] = {1u, 1u, 1u, 1u};
-    unsigned int two4[4] = {2u, 2u, 2u, 2u};
-    unsigned int three4[4] = {3u, 3u, 3u, 3u};
-    unsigned int four4[4] = {4u, 4u, 4u, 4u};
-
-    unsigned int r1[4] = {0u, 0u, 0u, 0u};
-    unsigned int r2[4] = {0u, 0u, 0u, 0u};
-
-    unsigned int a[4] = {0u, 0u, 0u, 0u};
-    unsigned int b[4] = {0u, 0u, 0u, 0u};
-
-    unsigned int e[4] = {0u, 0u, 0u, 0u};
-    unsigned int f[4] = {0u, 0u, 0u, 0u};
-    unsigned int thirteen  = 13u;
-    unsigned int fifteen = 15u;
-    unsigned int shift = 8u * 3u;
-
-    unsigned int mask11 = 0xfdff37ffu;
-    unsigned int mask12 = 0xef7f3f7du;
-    unsigned int mask13 = 0xff777b7du;
-    unsigned int mask14 = 0x7ff7fb2fu;
-    const float one = 1.0f;
-    const float intMax = 4294967296.0f;
-    const float PI = 3.14159265358979f;
-    const float two = 2.0f;
-
-    float r[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    float phi[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-
-    float temp1[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    float temp2[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    //Initializing states.
-    for(int c = 0; c < 4; ++c)
+    // Same generators as the kernel : identical random numbers
+    if(useSobol)
     {
-        state2[c] = mask4[c] * (state1[c] ^ (state1[c] >> thirty4[c])) + one4[c];
-        state3[c] = mask4[c] * (state2[c] ^ (state2[c] >> thirty4[c])) + two4[c];
-        state4[c] = mask4[c] * (state3[c] ^ (state3[c] >> thirty4[c])) + three4[c];
-        state5[c] = mask4[c] * (state4[c] ^ (state4[c] >> thirty4[c])) + four4[c];
-    }
-    unsigned int i = 0;
-    for(i = 0; i < mulFactor; ++i)
-    {
-        switch(i)
+        cl_uint point = antithetic ? pair : 2u * pair;
+        for(int p = 0; p < 2; p++)
         {
-        case 0:
-            for(int c = 0; c < 4; ++c)
-            {
-                r1[c] = state4[c];
-                r2[c] = state5[c];
-                a[c] = state1[c];
-                b[c] = state3[c];
-            }
-            break;
-        case 1:
-            for(int c = 0; c < 4; ++c)
+            const cl_uint *v = sobolTable + (step - 1) * SOBOL_TABLE_WIDTH;
+            cl_uint gray = (point + p) ^ ((point + p) >> 1);
+            cl_uint result = v[N_DIRECTIONS];
+            for(cl_uint bit = 0; gray != 0u; ++bit, gray >>= 1)
             {
-                r1[c] = r2[c];
-                r2[c] = temp[0][c];
-                a[c] = state2[c];
-                b[c] = state4[c];
+                if(gray & 1u)
+                {
+                    result ^= v[bit];
+                }
             }
-            break;
-        case 2:
-            for(int c = 0; c < 4; ++c)
+
+            float z = crngInverseNormal(crngUniform(result));
+            if(p == 0)
             {
-                r1[c] = r2[c];
-                r2[c] = temp[1][c];
-                a[c] = state3[c];
-                b[c] = state5[c];
+                *gaussianRand1 = z;
             }
-            break;
-        case 3:
-            for(int c = 0; c < 4; ++c)
+            else
             {
-                r1[c] = r2[c];
-                r2[c] = temp[2][c];
-                a[c] = state4[c];
-                b[c] = state1[c];
+                *gaussianRand2 = z;
             }
-            break;
-        default:
-            break;
-
         }
-        lshift128(a, shift, e);
-        rshift128(r1, shift, f);
-
-        temp[i][0] = a[0] ^ e[0] ^ ((b[0] >> thirteen) & mask11) ^ f[0] ^
-                     (r2[0] << fifteen);
-        temp[i][1] = a[1] ^ e[1] ^ ((b[1] >> thirteen) & mask12) ^ f[1] ^
-                     (r2[1] << fifteen);
-        temp[i][2] = a[2] ^ e[2] ^ ((b[2] >> thirteen) & mask13) ^ f[2] ^
-                     (r2[2] << fifteen);
-        temp[i][3] = a[3] ^ e[3] ^ ((b[3] >> thirteen) & mask14) ^ f[3] ^
-                     (r2[3] << fifteen);
-
     }
-
-    for(int c = 0; c < 4; ++c)
+    else
     {
-        temp1[c] = temp[0][c] * one / intMax;
-        temp2[c] = temp[1][c] * one / intMax;
+        CRNGPair key = {{pair, seed}};
+        CRNGBlock r = crngStreamBlock(CRNG_PHILOX, key, 0u, step);
+        CRNGFloat2 z = crngBoxMuller(r.v[0], r.v[1]);
+        *gaussianRand1 = z.v[0];
+        *gaussianRand2 = z.v[1];
     }
 
-    for(int c = 0; c < 4; ++c)
+    if(antithetic)
     {
-        // Applying Box Mullar Transformations.
-        r[c] = sqrt((-two) * log(temp1[c]));
-        phi[c]  = two * PI * temp2[c];
-        gaussianRand1[c] = r[c] * cos(phi[c]);
-        gaussianRand2[c] = r[c] * sin(phi[c]);
-
-        nextRand[c] = temp[2][c];
+        *gaussianRand2 = -*gaussianRand1;
     }
 }
 
 void
-MonteCarloAsian::calOutputs(float strikePrice,
-                            float* meanDeriv1,
-                            float*  meanDeriv2,
-                            float* meanPrice1,
-                            float* meanPrice2,
-                            float* pathDeriv1,
-                            float* pathDeriv2,
-                            float* priceVec1,
-                            float* priceVec2)
+MonteCarloAsian::simulatePair(int k, cl_uint pair, double *moments)
 {
-    float temp1[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    float temp2[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    float temp3[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    float temp4[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-
-    float tempDiff1[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    float tempDiff2[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float timeStep = maturity / (noOfSum - 1);
+    float c1 = (interest - 0.5f * sigma[k] * sigma[k]) * timeStep;
+    float c2 = sigma[k] * sqrt(timeStep);
+    float c3 = (interest + 0.5f * sigma[k] * sigma[k]);
+
+    float temp1 = 0.0f;
+    float temp2 = 0.0f;
+    float trajPrice1 = initPrice;
+    float trajPrice2 = initPrice;
+    float sumPrice1 = initPrice;
+    float sumPrice2 = initPrice;
+    float sumLog1 = 0.0f;
+    float sumLog2 = 0.0f;
+    float sumDeriv1 = 0.0f;
+    float sumDeriv2 = 0.0f;
+
+    //Run the Monte Carlo simulation a total of Num_Sum - 1 times
+    for(int i = 1; i < noOfSum; i++)
+    {
+        float gaussian1 = 0.0f;
+        float gaussian2 = 0.0f;
+        generateRand(pair, i, &gaussian1, &gaussian2);
+
+        //Calculate the trajectory price and sum price for all trajectories
+        temp1 += c1 + c2 * gaussian1;
+        temp2 += c1 + c2 * gaussian2;
+        trajPrice1 = trajPrice1 * exp(c1 + c2 * gaussian1);
+        trajPrice2 = trajPrice2 * exp(c1 + c2 * gaussian2);
+
+        sumPrice1 = sumPrice1 + trajPrice1;
+        sumPrice2 = sumPrice2 + trajPrice2;
+
+        sumLog1 = sumLog1 + temp1;
+        sumLog2 = sumLog2 + temp2;
+
+        float temp = c3 * timeStep * i;
+
+        // Calculate the derivative price for all trajectories
+        sumDeriv1 = sumDeriv1 + trajPrice1 * (temp1 - temp) / sigma[k];
+        sumDeriv2 = sumDeriv2 + trajPrice2 * (temp2 - temp) / sigma[k];
+    }
+
+    // Payoffs of the average price and of the geometric average
+    float price1 = std::max(sumPrice1 / noOfSum - strikePrice, 0.0f);
+    float price2 = std::max(sumPrice2 / noOfSum - strikePrice, 0.0f);
+    float control1 = std::max(initPrice * exp(sumLog1 / noOfSum) - strikePrice, 0.0f);
+    float control2 = std::max(initPrice * exp(sumLog2 / noOfSum) - strikePrice, 0.0f);
+    float deriv1 = price1 > 0.0f ? sumDeriv1 / noOfSum : 0.0f;
+    float deriv2 = price2 > 0.0f ? sumDeriv2 / noOfSum : 0.0f;
+
+    double y = 0.5 * (price1 + price2);
+    double c = 0.5 * (control1 + control2);
+    moments[MOMENT_PRICE] += y;
+    moments[MOMENT_PRICE2] += y * y;
+    moments[MOMENT_CONTROL] += c;
+    moments[MOMENT_CONTROL2] += c * c;
+    moments[MOMENT_CROSS] += y * c;
+    moments[MOMENT_VEGA] += 0.5 * (deriv1 + deriv2);
+}
 
-    for(int c = 0; c < 4; ++c)
-    {
-        tempDiff1[c] = meanPrice1[c] - strikePrice;
-        tempDiff2[c] = meanPrice2[c] - strikePrice;
-    }
-    if(tempDiff1[0] > 0.0f)
-    {
-        temp1[0] = 1.0f;
-        temp3[0] = tempDiff1[0];
-    }
-    if(tempDiff1[1] > 0.0f)
-    {
-        temp1[1] = 1.0f;
-        temp3[1] = tempDiff1[1];
-    }
-    if(tempDiff1[2] > 0.0f)
-    {
-        temp1[2] = 1.0f;
-        temp3[2] = tempDiff1[2];
-    }
-    if(tempDiff1[3] > 0.0f)
-    {
-        temp1[3] = 1.0f;
-        temp3[3] = tempDiff1[3];
-    }
+double
+MonteCarloAsian::geometricPrice(int k)
+{
+    /*
+     * The log of the geometric average of the noOfSum prices is normal,
+     * the price follows from the Black-Scholes formula for that log-normal.
+     */
+    double n = noOfSum;
+    double timeStep = maturity / (noOfSum - 1);
+    double s = sigma[k];
 
-    if(tempDiff2[0] > 0.0f)
-    {
-        temp2[0] = 1.0f;
-        temp4[0] = tempDiff2[0];
-    }
-    if(tempDiff2[1] > 0.0f)
-    {
-        temp2[1] = 1.0f;
-        temp4[1] = tempDiff2[1];
-    }
-    if(tempDiff2[2] > 0.0f)
-    {
-        temp2[2] = 1.0f;
-        temp4[2] = tempDiff2[2];
-    }
-    if(tempDiff2[3] > 0.0f)
-    {
-        temp2[3] = 1.0f;
-        temp4[3] = tempDiff2[3];
-    }
+    double mu = log((double)initPrice)
+                + (interest - 0.5 * s * s) * timeStep * (n - 1.0) / 2.0;
+    double var = s * s * timeStep * (n - 1.0) * (2.0 * n - 1.0) / (6.0 * n);
+    double sd = sqrt(var);
 
-    for(int c = 0; c < 4; ++c)
-    {
-        pathDeriv1[c] = meanDeriv1[c] * temp1[c];
-        pathDeriv2[c] = meanDeriv2[c] * temp2[c];
-        priceVec1[c] = temp3[c];
-        priceVec2[c] = temp4[c];
-    }
+    double d1 = (mu - log((double)strikePrice) + var) / sd;
+    return exp(mu + 0.5 * var) * cnd(d1) - strikePrice * cnd(d1 - sd);
 }
 
-void MonteCarloAsian::cpuReferenceImpl()
+void
+MonteCarloAsian::estimate(int k,
+                          const double *moments,
+                          double n,
+                          float *optionPrice,
+                          float *optionVega,
+                          float *optionHalfWidth)
 {
-    float timeStep = maturity / (noOfSum - 1);
-    // Initialize random number generator
-    srand(1);
+    double discount = exp(-interest * maturity);
 
-    for(int k = 0; k < steps; k++)
+    double meanPrice = moments[MOMENT_PRICE] / n;
+    double varPrice = (moments[MOMENT_PRICE2] / n - meanPrice * meanPrice)
+                      * n / (n - 1.0);
+
+    if(controlVariate)
     {
-        float c1 = (interest - 0.5f * sigma[k] * sigma[k]) * timeStep;
-        float c2 = sigma[k] * sqrt(timeStep);
-        float c3 = (interest + 0.5f * sigma[k] * sigma[k]);
+        double meanControl = moments[MOMENT_CONTROL] / n;
+        double varControl = (moments[MOMENT_CONTROL2] / n - meanControl * meanControl)
+                            * n / (n - 1.0);
+        double cov = (moments[MOMENT_CROSS] / n - meanPrice * meanControl)
+                     * n / (n - 1.0);
 
-        for(int j = 0; j < (width * height); j++)
+        // Optimal coefficient estimated from the same samples
+        if(varControl > 0.0)
         {
-            unsigned int nextRand[4] = {0u, 0u, 0u, 0u};
-            for(int c = 0; c < 4; ++c)
-            {
-                nextRand[c] = (cl_uint)rand();
-            }
-
-            float trajPrice1[4] = {initPrice, initPrice, initPrice, initPrice};
-            float sumPrice1[4] = {initPrice, initPrice, initPrice, initPrice};
-            float sumDeriv1[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-            float meanPrice1[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-            float meanDeriv1[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-            float price1[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-            float pathDeriv1[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-
-            float trajPrice2[4] = {initPrice, initPrice, initPrice, initPrice};
-            float sumPrice2[4] = {initPrice, initPrice, initPrice, initPrice};
-            float sumDeriv2[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-            float meanPrice2[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-            float meanDeriv2[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-            float price2[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-            float pathDeriv2[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-
-            //Run the Monte Carlo simulation a total of Num_Sum - 1 times
-            for(int i = 1; i < noOfSum; i++)
-            {
-                unsigned int tempRand[4] =  {0u, 0u, 0u, 0u};
-                for(int c = 0; c < 4; ++c)
-                {
-                    tempRand[c] = nextRand[c];
-                }
-
-                float gaussian1[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-                float gaussian2[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-                generateRand(tempRand, gaussian1, gaussian2, nextRand);
-
-                //Calculate the trajectory price and sum price for all trajectories
-                for(int c = 0; c < 4; ++c)
-                {
-                    trajPrice1[c] = trajPrice1[c] * exp(c1 + c2 * gaussian1[c]);
-                    trajPrice2[c] = trajPrice2[c] * exp(c1 + c2 * gaussian2[c]);
-
-                    sumPrice1[c] = sumPrice1[c] + trajPrice1[c];
-                    sumPrice2[c] = sumPrice2[c] + trajPrice2[c];
-
-                    float temp = c3 * timeStep * i;
-
-                    // Calculate the derivative price for all trajectories
-                    sumDeriv1[c] = sumDeriv1[c] + trajPrice1[c]
-                                   * ((log(trajPrice1[c] / initPrice) - temp) / sigma[k]);
-
-                    sumDeriv2[c] = sumDeriv2[c] + trajPrice2[c]
-                                   * ((log(trajPrice2[c] / initPrice) - temp) / sigma[k]);
-                }
-
-            }
+            double beta = cov / varControl;
+            meanPrice -= beta * (meanControl - geometricPrice(k));
+            varPrice -= cov * cov / varControl;
+        }
+    }
 
-            //Calculate the average price and average derivative of each simulated path
-            for(int c = 0; c < 4; ++c)
-            {
-                meanPrice1[c] = sumPrice1[c] / noOfSum;
-                meanPrice2[c] = sumPrice2[c] / noOfSum;
-                meanDeriv1[c] = sumDeriv1[c] / noOfSum;
-                meanDeriv2[c] = sumDeriv2[c] / noOfSum;
-            }
+    varPrice = std::max(varPrice, 0.0);
 
-            calOutputs(strikePrice, meanDeriv1, meanDeriv2, meanPrice1, meanPrice2,
-                       pathDeriv1, pathDeriv2, price1, price2);
+    *optionPrice = (float)(discount * meanPrice);
+    *optionVega = (float)(discount * moments[MOMENT_VEGA] / n);
+    *optionHalfWidth = (float)(1.96 * discount * sqrt(varPrice / n));
+}
 
-            for(int c = 0; c < 4; ++c)
-            {
-                priceVals[j * 8 + c] = price1[c];
-                priceVals[j * 8 + 1 * 4 + c] = price2[c];
-                priceDeriv[j * 8 + c] = pathDeriv1[c];
-                priceDeriv[j * 8 + 1 * 4 + c] = pathDeriv2[c];
-            }
-        }
+void MonteCarloAsian::cpuReferenceImpl()
+{
+    // Same batches as the device run, sums in double
+    for(int k = 0; k < steps; k++)
+    {
+        double moments[MOMENTS] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+        cl_uint pairs = (cl_uint)batchesDone[k] * pairsPerBatch;
 
-        // Replace Following "for" loop with reduction kernel
-        for(int i = 0; i < noOfTraj * noOfTraj; i++)
+        for(cl_uint j = 0; j < pairs; j++)
         {
-            refPrice[k] += priceVals[i];
-            refVega[k] += priceDeriv[i];
+            simulatePair(k, j, moments);
         }
 
-        refPrice[k] /= (noOfTraj * noOfTraj);
-        refVega[k] /= (noOfTraj * noOfTraj);
-
-        refPrice[k] = exp(-interest * maturity) * refPrice[k];
-        refVega[k] = exp(-interest * maturity) * refVega[k];
+        float refHalfWidth;
+        estimate(k, moments, (double)pairs, &refPrice[k], &refVega[k], &refHalfWidth);
     }
 }
 
@@ -1756,20 +1169,52 @@ int MonteCarloAsian::verifyResults()
 {
     if(sampleArgs->verify)
     {
+        /*
+         * The host replays every path serially, so a run of several batches
+         * (--epsilon, --batches) is verified on a subset : the device runs
+         * the first batch of every option again and only that one is
+         * replayed. The counters of the full run are kept for printStats().
+         */
+        std::vector<cl_int> runBatchesDone(batchesDone, batchesDone + steps);
+        std::vector<cl_float> runHalfWidth(halfWidth, halfWidth + steps);
+        bool subset = false;
+        for(int k = 0; k < steps; k++)
+        {
+            subset = subset || batchesDone[k] > 1;
+        }
+        if(subset)
+        {
+            float runEpsilon = epsilon;
+            int runBatches = batches;
+            epsilon = 0.0f;
+            batches = 1;
+            int status = runCLKernels();
+            epsilon = runEpsilon;
+            batches = runBatches;
+            CHECK_ERROR(status, SDK_SUCCESS, "runCLKernels() failed.");
+            std::cout << "Verifying the first batch of every option" << std::endl;
+        }
+
         /* reference implementation
          * it overwrites the input array with the output
          */
         cpuReferenceImpl();
 
+        std::copy(runBatchesDone.begin(), runBatchesDone.end(), batchesDone);
+        std::copy(runHalfWidth.begin(), runHalfWidth.end(), halfWidth);
+
         // compare the results and see if they match
         for(int i = 0; i < steps; ++i)
         {
-            if(fabs(price[i] - refPrice[i]) > 0.2f)
+            float tolerance = 1e-3f * std::max(1.0f, (float)fabs(refPrice[i]));
+            if(fabs(price[i] - refPrice[i]) > tolerance)
             {
                 std::cout << "Failed\n";
                 return SDK_FAILURE;
             }
-            if(fabs(vega[i] - refVega[i]) > 0.2f)
+
+            tolerance = 1e-3f * std::max(1.0f, (float)fabs(refVega[i]));
+            if(fabs(vega[i] - refVega[i]) > tolerance)
             {
                 std::cout << "Failed\n" << std::endl;
                 return SDK_FAILURE;
@@ -1786,30 +1231,21 @@ int MonteCarloAsian::cleanup()
     // Releases OpenCL resources (Context, Memory etc.)
     cl_int status;
 
-    status = clReleaseMemObject(priceBuf);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject(priceBuf) failed.");
-
-    status = clReleaseMemObject(priceDerivBuf);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject(priceDerivBuf) failed.");
-
-    status = clReleaseMemObject(randBuf);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject(randBuf) failed.");
+    status = clReleaseMemObject(partialBuf);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject(partialBuf) failed.");
 
-    if(!disableAsync)
-    {
-        status = clReleaseMemObject(priceBufAsync);
-        CHECK_OPENCL_ERROR(status, "clReleaseMemObject(priceBufAsync) failed.");
-
-        status = clReleaseMemObject(priceDerivBufAsync);
-        CHECK_OPENCL_ERROR(status, "clReleaseMemObject(priceDerivBufAsync) failed.");
+    status = clReleaseMemObject(accBuf);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject(accBuf) failed.");
 
-        status = clReleaseMemObject(randBufAsync);
-        CHECK_OPENCL_ERROR(status, "clReleaseMemObject(randBufAsync) failed.");
-    }
+    status = clReleaseMemObject(sobolBuf);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject(sobolBuf) failed.");
 
     status = clReleaseKernel(kernel);
     CHECK_OPENCL_ERROR(status, "clReleaseKernel(kernel) failed.");
 
+    status = clReleaseKernel(accumulateKernel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel(accumulateKernel) failed.");
+
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram(program) failed.");
 
@@ -1823,16 +1259,12 @@ int MonteCarloAsian::cleanup()
     FREE(sigma);
     FREE(price);
     FREE(vega);
+    FREE(halfWidth);
+    FREE(batchesDone);
     FREE(refPrice);
     FREE(refVega);
-    FREE(priceVals);
-    FREE(priceDeriv);
-
-    if(!disableAsync && disableMapping)
-    {
-        FREE(priceValsAsync);
-        FREE(priceDerivAsync);
-    }
+    FREE(acc);
+    FREE(sobolTable);
     FREE(devices);
     return SDK_SUCCESS;
 }
@@ -1935,4 +1367,4 @@ main(int argc, char * argv[])
     }
 
     return SDK_SUCCESS;
-}
+}
\ No newline at end of file
@@ -21,6 +21,25 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #define GROUP_SIZE 64
 #define VECTOR_SIZE 4
 
+/* Keep in sync with MonteCarloAsian_Kernels.cl */
+#define SAMPLING_SOBOL          1
+#define SAMPLING_ANTITHETIC     2
+
+#define N_DIRECTIONS            32
+#define SOBOL_TABLE_WIDTH       (N_DIRECTIONS + 1)
+#define SOBOL_DIMENSIONS        11      /* Time steps the Sobol paths support */
+
+#define MOMENT_PRICE            0
+#define MOMENT_PRICE2           1
+#define MOMENT_CONTROL          2
+#define MOMENT_CONTROL2         3
+#define MOMENT_CROSS            4
+#define MOMENT_VEGA             5
+#define MOMENTS                 6
+
+#define ACCUMULATE_GROUP_SIZE   256
+#define MAX_BATCHES             256
+
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.2"
 
 #include <stdio.h>
@@ -28,6 +47,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <assert.h>
 #include <string.h>
 #include "CLUtil.hpp"
+#include "CounterRNG.h"
 
 using namespace appsdk;
 
@@ -52,6 +72,12 @@ struct MonteCarloAttrib
 /**
  * MonteCarloAsian
  * Class implements OpenCL  Monte Carlo Simution sample for Asian Option pricing
+ *
+ * Paths are simulated in batches of pairs. The device keeps running sums of
+ * the moments of every option (see MOMENT_*), so memory does not depend on
+ * the number of paths. With --epsilon the batches continue until the 95%
+ * confidence interval of every price is narrower than epsilon, printing the
+ * estimates after every batch.
  */
 
 class MonteCarloAsian
@@ -71,25 +97,26 @@ class MonteCarloAsian
         cl_float *sigma;                    /**< Array of sigma values */
         cl_float *price;                    /**< Array of price values */
         cl_float *vega;                     /**< Array of vega values */
+        cl_float *halfWidth;                /**< 95% confidence half-width of the prices */
+        cl_int *batchesDone;                /**< Batches accumulated per option */
 
         cl_float *refPrice;                 /**< Array of reference price values */
         cl_float *refVega;                  /**< Array of reference vega values */
 
-        cl_uint *randNum;                   /**< Array of random numbers */
-
-        cl_float *priceVals;                /**< Array of price values for given samples */
-        cl_float *priceDeriv;               /**< Array of price derivative values for given samples */
+        cl_float *acc;                      /**< Running sums read back from the device */
+        cl_uint *sobolTable;                /**< Direction numbers and shift per time step */
 
         cl_context context;                 /**< CL context */
         cl_device_id *devices;              /**< CL device list */
 
-        cl_mem priceBuf;                    /**< CL memory buffer for sigma */
-        cl_mem priceDerivBuf;               /**< CL memory buffer for price */
-        cl_mem randBuf;                     /**< CL memroy buffer for random number */
+        cl_mem partialBuf;                  /**< CL memory buffer for the group sums of a batch */
+        cl_mem accBuf;                      /**< CL memory buffer for the running sums */
+        cl_mem sobolBuf;                    /**< CL memory buffer for the Sobol table */
 
         cl_command_queue commandQueue;      /**< CL command queue */
         cl_program program;                 /**< CL program  */
         cl_kernel kernel;                   /**< CL kernel */
+        cl_kernel accumulateKernel;         /**< CL kernel adding a batch to the running sums */
 
         cl_int width;
         cl_int height;
@@ -97,6 +124,7 @@ class MonteCarloAsian
         //size_t kernelWorkGroupSize;         /**< Group size returned by kernel */
         size_t blockSizeX;                  /**< Group-size in x-direction */
         size_t blockSizeY;                  /**< Group-size in y-direction */
+        size_t accumulateGroupSize;         /**< Group-size of the accumulate kernel */
 
         int iterations;                     /**< Number of iterations for kernel execution */
 
@@ -105,14 +133,13 @@ class MonteCarloAsian
         bool disableMapping;
         bool disableAsync;
 
-        // Required only when anync enabled
-        cl_mem priceBufAsync;                    /**< CL memory buffer for sigma */
-        cl_mem priceDerivBufAsync;               /**< CL memory buffer for price */
-        cl_mem randBufAsync;                     /**< CL memory buffer for random number */
+        bool antithetic;                    /**< Second path of a pair is antithetic */
+        bool controlVariate;                /**< Geometric average payoff as control variate */
+        bool useSobol;                      /**< Quasi-random paths */
+        cl_float epsilon;                   /**< Target confidence half-width, 0 : fixed batches */
+        cl_int batches;                     /**< Batches per option (maximum with epsilon) */
+        cl_uint seed;                       /**< Seed of the generator */
 
-        // Required only when anync and mapping enabled
-        cl_float *priceValsAsync;                /**< Array of price values for given samples */
-        cl_float *priceDerivAsync;               /**< Array of price derivative values for given samples */
         SDKDeviceInfo deviceInfo; /**< SDKDeviceInfo object instance */
         KernelWorkGroupInfo kernelInfo; /**< KernelWorkGroupInfo Object instance */
         SDKTimer *sampleTimer;      /**< SDKTimer object */
@@ -122,12 +149,13 @@ class MonteCarloAsian
         int vectorWidth;
 
         // Declare attribute structure
-        MonteCarloAttrib<cl_float4> attributes;
-        MonteCarloAttrib<cl_float> attributesScalar;
+        MonteCarloAttrib<cl_float> attributes;
 
         // global, local sworkgroup size
         size_t globalThreads[2];
         size_t localThreads[2];
+        size_t numGroups;                   /**< Groups of the calPriceVega kernel */
+        cl_uint pairsPerBatch;              /**< Pairs of paths per option and batch */
 
     public:
 
@@ -155,15 +183,17 @@ class MonteCarloAsian
             kernelTime = 0;
             blockSizeX = GROUP_SIZE;
             blockSizeY = 1;
+            accumulateGroupSize = ACCUMULATE_GROUP_SIZE;
 
             sigma = NULL;
             price = NULL;
             vega = NULL;
+            halfWidth = NULL;
+            batchesDone = NULL;
             refPrice = NULL;
             refVega = NULL;
-            randNum = NULL;
-            priceVals = NULL;
-            priceDeriv = NULL;
+            acc = NULL;
+            sobolTable = NULL;
             devices = NULL;
             iterations = 1;
             dUseInPersistent = false;
@@ -171,8 +201,14 @@ class MonteCarloAsian
             disableMapping = false;
             disableAsync = false;
 
-            priceValsAsync = NULL;
-            priceDerivAsync = NULL;
+            antithetic = false;
+            controlVariate = false;
+            useSobol = false;
+            epsilon = 0.0f;
+            batches = 0;
+            seed = 1;
+            numGroups = 0;
+            pairsPerBatch = 0;
         }
 
         /**
@@ -183,21 +219,12 @@ class MonteCarloAsian
             FREE(sigma);
             FREE(price);
             FREE(vega);
+            FREE(halfWidth);
+            FREE(batchesDone);
             FREE(refPrice);
             FREE(refVega);
-
-            if(randNum)
-            {
-#ifdef _WIN32
-                ALIGNED_FREE(randNum);
-#else
-                FREE(randNum);
-#endif
-                randNum = NULL;
-            }
-
-            FREE(priceVals);
-            FREE(priceDeriv);
+            FREE(acc);
+            FREE(sobolTable);
             FREE(devices);
         }
 
@@ -275,42 +302,39 @@ class MonteCarloAsian
     private:
 
         /**
-         * @brief Left shift
-         * @param input input to be shifted
-         * @param shift shifting count
-         * @param output result after shifting input
+         * @brief Fills the Sobol table : direction numbers of the Joe-Kuo
+         *        primitives (as in the QuasiRandomSequence sample) and a
+         *        random digital shift for every time step
          */
-        void lshift128(unsigned int* input, unsigned int shift, unsigned int* output);
+        void generateSobolTable();
 
         /**
-         * @brief Right shift
-         * @param input input to be shifted
-         * @param shift shifting count
-         * @param output result after shifting input
+         * @brief Gaussian random numbers of one time step for both paths of
+         *        a pair, same as generateRand of the kernel
          */
-        void rshift128(unsigned int* input, unsigned int shift, unsigned int* output);
+        void generateRand(cl_uint pair,
+                          cl_uint step,
+                          float *gaussianRand1,
+                          float *gaussianRand2);
 
+        /**
+         * @brief   Simulates both paths of a pair of option k and adds the
+         *          sample to the moments, same as simulatePair of the kernel
+         */
+        void simulatePair(int k, cl_uint pair, double *moments);
 
         /**
-         * @brief Generates gaussian random numbers by using
-         *        Mersenenne Twister algo and box muller transformation
-         * @param seedArray  seed
-         * @param gaussianRand1 gaussian random number generated
-         * @param gaussianRand2 gaussian random number generated
-         * @param nextRand  generated seed for next usage
+         * @brief   Undiscounted price of the geometric average option k,
+         *          the mean of the control variate
          */
-        void generateRand(unsigned int* seed,
-                          float *gaussianRand1,
-                          float *gaussianRand2,
-                          unsigned int* nextRand);
+        double geometricPrice(int k);
 
         /**
-         * @brief   calculates the  price and vega for all trajectories
+         * @brief   Price, vega and confidence half-width of option k from
+         *          the sums of n samples
          */
-        void calOutputs(float strikePrice, float* meanDeriv1,
-                        float*  meanDeriv2, float* meanPrice1,
-                        float* meanPrice2, float* pathDeriv1,
-                        float* pathDeriv2, float* priceVec1, float* priceVec2);
+        void estimate(int k, const double *moments, double n,
+                      float *optionPrice, float *optionVega, float *optionHalfWidth);
 
         /**
          * @brief   Reference implementation for Monte Carlo simuation for
@@ -319,19 +343,15 @@ class MonteCarloAsian
         void cpuReferenceImpl();
 
         /**
-         * @brief Accepts rand, price & priceDeriv cl_mem objects and sets it to kernel object
-         */
-        int setKernelArgs(int step, cl_mem *rand, cl_mem *price, cl_mem *priceDeriv);
-
-        /**
-         * @brief Run kernel with Asynchronous cpu & device buffer transfer with read/write
+         * @brief Sets the arguments of option k and of the batch starting at
+         *        firstPair to the kernels
          */
-        int runAsyncWithMappingDisabled();
+        int setKernelArgs(int k, cl_uint firstPair);
 
         /**
-         * @brief Run kernel with Asynchronous cpu & device buffer transfer with mapping and un-mapping
+         * @brief Copies the running sums of all options to acc
          */
-        int runAsyncWithMappingEnabled();
+        int readAccumulators();
 
         /**
         * @fn asyncMapBuffer
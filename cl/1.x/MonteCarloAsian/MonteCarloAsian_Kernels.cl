@@ -19,631 +19,321 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 * documentation for this sample.
 *
 * One invocation of calPriceVega kernel, i.e one work thread caluculates the
-* price value and path derivative from given initial price, strike price, 
-* interest rate and maturity 
+* price value and path derivative of pathsPerItem pairs of paths from given
+* initial price, strike price, interest rate and maturity. Nothing is stored
+* per path: every group reduces the moments of its samples (see MOMENT_*)
+* and the accumulate kernel folds the group sums into running totals of the
+* option, so memory does not grow with the number of paths and the totals
+* can be read back after every batch.
+*
+* A sample is the mean of the two paths of a pair. The second path is an
+* independent path, or the antithetic path (same normals negated) when
+* SAMPLING_ANTITHETIC is set. The normals come from the Philox generator of
+* CounterRNG.h or, with SAMPLING_SOBOL, from a digitally shifted Sobol
+* sequence (one dimension per time step) through the inverse normal CDF.
+*
+* Besides the arithmetic average payoff the kernel accumulates the payoff of
+* the geometric average, which has a closed form and serves the host as
+* control variate.
 */
-typedef struct _MonteCalroAttribVector
-{
-    float4 strikePrice;
-    float4 c1;
-    float4 c2;
-    float4 c3;
-    float4 initPrice;
-    float4 sigma;
-    float4 timeStep;
-}MonteCarloAttribVector;
-
-constant uint mulFactor = 4;
-constant uint stateMask = 1812433253u;
-constant uint thirty = 30u;
-constant uint thirteen  = 13u;
-constant uint fifteen = 15u;
-constant uint threeBytes = 8u * 3u;
-constant uint mask[4] = {0xfdff37ffu, 0xef7f3f7du, 0xff777b7du, 0x7ff7fb2fu};
-
-constant float one = 1.0f;
-constant float intMax = 4294967296.0f;
-constant float PI = 3.14159265358979f;
-constant float two = 2.0f;
+#define _OCL_CODE_
+#include "CounterRNG.h"
 
-/**
-* @brief Left shift
-* @param input input to be shifted
-* @param output result after shifting input
-*/
-void 
-    lshift128(uint4 input, uint4* output)
-{
-    unsigned int invshift = 32u - threeBytes;
+#define SAMPLING_SOBOL          1
+#define SAMPLING_ANTITHETIC     2
 
-    uint4 temp;
-    temp.x = input.x << threeBytes;
-    temp.y = (input.y << threeBytes) | (input.x >> invshift);
-    temp.z = (input.z << threeBytes) | (input.y >> invshift);
-    temp.w = (input.w << threeBytes) | (input.z >> invshift);
+#define N_DIRECTIONS            32
+#define SOBOL_TABLE_WIDTH       (N_DIRECTIONS + 1)
 
-    *output = temp;
-}
+#define MOMENT_PRICE            0
+#define MOMENT_PRICE2           1
+#define MOMENT_CONTROL          2
+#define MOMENT_CONTROL2         3
+#define MOMENT_CROSS            4
+#define MOMENT_VEGA             5
+#define MOMENTS                 6
 
-/**
-* @brief Right shift
-* @param input input to be shifted
-* @param output result after shifting input
-*/
-void 
-    rshift128(uint4 input, uint4* output)
+typedef struct _MonteCalroAttribScalar
 {
-    unsigned int invshift = 32u - threeBytes;
-
-    uint4 temp;
-
-    temp.w = input.w >> threeBytes;
-    temp.z = (input.z >> threeBytes) | (input.w << invshift);
-    temp.y = (input.y >> threeBytes) | (input.z << invshift);
-    temp.x = (input.x >> threeBytes) | (input.y << invshift);
-
-    *output = temp;
-}
+    float strikePrice;
+    float c1;
+    float c2;
+    float c3;
+    float initPrice;
+    float sigma;
+    float timeStep;
+}MonteCarloAttribScalar;
 
 /**
-* @brief Generates gaussian random numbers by using 
-*        Mersenenne Twister algo and box muller transformation
-* @param seed  initial seed value
-* @param gaussianRand1 gaussian random number generatred
-* @param gaussianRand2 gaussian random number generarted 
-* @param nextRand  generated seed for next usage
+* @brief Point 'index' of Sobol dimension 'dim' in Gray code order, shifted
+*        by the random word stored after the direction numbers
 */
-void 
-    generateRand_Vector(uint4 seed,
-    float4 *gaussianRand1,
-    float4 *gaussianRand2,
-    uint4 *nextRand)
+uint 
+    sobolPoint(__global const uint *sobolTable, uint index, uint dim)
 {
-    uint4 temp[4];
-
-    uint4 state1 = seed;
-    uint4 state2 = (uint4)(0); 
-    uint4 state3 = (uint4)(0); 
-    uint4 state4 = (uint4)(0); 
-    uint4 state5 = (uint4)(0);
-
-    uint4 mask4 = (uint4)(stateMask);
-    uint4 thirty4 = (uint4)(thirty); 
-    uint4 one4 = (uint4)(1u);
-    uint4 two4 = (uint4)(2u);
-    uint4 three4 = (uint4)(3u);
-    uint4 four4 = (uint4)(4u);
-
-    uint4 r1 = (uint4)(0);
-    uint4 r2 = (uint4)(0);
-
-    uint4 a = (uint4)(0);
-    uint4 b = (uint4)(0); 
-
-    uint4 e = (uint4)(0); 
-    uint4 f = (uint4)(0); 
-
-    float4 r; 
-    float4 phi;
-
-    float4 temp1;
-    float4 temp2;
-
-    //Initializing states.
-    state2 = mask4 * (state1 ^ (state1 >> thirty4)) + one4;
-    state3 = mask4 * (state2 ^ (state2 >> thirty4)) + two4;
-    state4 = mask4 * (state3 ^ (state3 >> thirty4)) + three4;
-    state5 = mask4 * (state4 ^ (state4 >> thirty4)) + four4;
-
-    uint i = 0;
-    #pragma unroll 4
-    for(i = 0; i < mulFactor; ++i)
+    __global const uint *v = sobolTable + dim * SOBOL_TABLE_WIDTH;
+    uint gray = index ^ (index >> 1);
+    uint result = v[N_DIRECTIONS];
+    for(uint bit = 0; gray != 0u; ++bit, gray >>= 1)
     {
-        switch(i)
+        if(gray & 1u)
         {
-        case 0:
-            r1 = state4;
-            r2 = state5;
-            a = state1;
-            b = state3;
-            break;
-        case 1:
-            r1 = r2;
-            r2 = temp[0];
-            a = state2;
-            b = state4;
-            break;
-        case 2:
-            r1 = r2;
-            r2 = temp[1];
-            a = state3;
-            b = state5;
-            break;
-        case 3:
-            r1 = r2;
-            r2 = temp[2];
-            a = state4;
-            b = state1;
-            break;
-        default:
-            break;            
-
+            result ^= v[bit];
         }
-
-        lshift128(a, &e);
-        rshift128(r1, &f);
-
-        temp[i].x = a.x ^ e.x ^ ((b.x >> thirteen) & mask[0]) ^ f.x ^ (r2.x << fifteen);
-        temp[i].y = a.y ^ e.y ^ ((b.y >> thirteen) & mask[1]) ^ f.y ^ (r2.y << fifteen);
-        temp[i].z = a.z ^ e.z ^ ((b.z >> thirteen) & mask[2]) ^ f.z ^ (r2.z << fifteen);
-        temp[i].w = a.w ^ e.w ^ ((b.w >> thirteen) & mask[3]) ^ f.w ^ (r2.w << fifteen);
-    }        
-
-    temp1 = convert_float4(temp[0]) * one / intMax;
-    temp2 = convert_float4(temp[1]) * one / intMax;
-
-    // Applying Box Mullar Transformations.
-    r = sqrt((-two) * log(temp1));
-    phi  = two * PI * temp2;
-    *gaussianRand1 = r * cos(phi);
-    *gaussianRand2 = r * sin(phi);
-    *nextRand = temp[2];
-
+    }
+    return result;
 }
 
 /**
-* @brief   calculates the  price and vega for all trajectories
-* @param strikePrice	Strike price
-* @param meanDeriv1		Average Derive price (from gaussianRand1)
-* @param meanDeriv2		Average Derive price (from gaussianRand2)
-* @param meanPrice1		Average price (from gaussianRand1)
-* @param meanPrice2		Average price (from gaussianRand2)
-* @param pathDeriv1		path derive price (for gaussianRand1)
-* @param pathDeriv2		path derive price (for gaussianRand2)
-* @param price1			price (for gaussianRand1)
-* @param price2			price (for gaussianRand2)
+* @brief Gaussian random numbers of one time step for both paths of a pair
+* @param pair   index of the pair of paths
+* @param step   time step of the paths (1 .. noOfSum - 1)
+* @param seed   seed of the run
+* @param sampling  SAMPLING_* flags
+* @param gaussianRand1 gaussian random number of the first path
+* @param gaussianRand2 gaussian random number of the second path
 */
 void 
-    calOutputs_Vector(float4 strikePrice,
-    float4 meanDeriv1,
-    float4 meanDeriv2, 
-    float4 meanPrice1,
-    float4 meanPrice2,
-    float4 *pathDeriv1,
-    float4 *pathDeriv2, 
-    float4 *priceVec1,
-    float4 *priceVec2)
+    generateRand(uint pair,
+    uint step,
+    uint seed,
+    int sampling,
+    __global const uint *sobolTable,
+    float *gaussianRand1,
+    float *gaussianRand2)
 {
-    float4 temp1 = (float4)0.0f;
-    float4 temp2 = (float4)0.0f;
-    float4 temp3 = (float4)0.0f;
-    float4 temp4 = (float4)0.0f;
-
-    float4 tempDiff1 = meanPrice1 - strikePrice;
-    float4 tempDiff2 = meanPrice2 - strikePrice;
-    if(tempDiff1.x > 0.0f)
-    {
-        temp1.x = 1.0f;
-        temp3.x = tempDiff1.x;
-    }
-    if(tempDiff1.y > 0.0f)
-    {
-        temp1.y = 1.0f;
-        temp3.y = tempDiff1.y ;
-    }
-    if(tempDiff1.z > 0.0f)
+    if(sampling & SAMPLING_SOBOL)
     {
-        temp1.z = 1.0f;
-        temp3.z = tempDiff1.z;
+        uint point = (sampling & SAMPLING_ANTITHETIC) ? pair : 2u * pair;
+        *gaussianRand1 = crngInverseNormal(crngUniform(sobolPoint(sobolTable, point, step - 1)));
+        *gaussianRand2 = crngInverseNormal(crngUniform(sobolPoint(sobolTable, point + 1u, step - 1)));
     }
-    if(tempDiff1.w > 0.0f)
+    else
     {
-        temp1.w = 1.0f;
-        temp3.w = tempDiff1.w;
+        // The pair is the key and the step is the counter
+        CRNGPair key;
+        key.v[0] = pair;
+        key.v[1] = seed;
+
+        CRNGBlock r = crngStreamBlock(CRNG_PHILOX, key, 0u, (ulong)step);
+        CRNGFloat2 z = crngBoxMuller(r.v[0], r.v[1]);
+        *gaussianRand1 = z.v[0];
+        *gaussianRand2 = z.v[1];
     }
 
-    if(tempDiff2.x > 0.0f)
-    {
-        temp2.x = 1.0f;
-        temp4.x = tempDiff2.x;
-    }
-    if(tempDiff2.y > 0.0f)
-    {
-        temp2.y = 1.0f;
-        temp4.y = tempDiff2.y;
-    }
-    if(tempDiff2.z > 0.0f)
+    if(sampling & SAMPLING_ANTITHETIC)
     {
-        temp2.z = 1.0f;
-        temp4.z = tempDiff2.z;
+        *gaussianRand2 = -*gaussianRand1;
     }
-    if(tempDiff2.w > 0.0f)
-    {
-        temp2.w = 1.0f;
-        temp4.w = tempDiff2.w;
-    }
-
-    *pathDeriv1 = meanDeriv1 * temp1; 
-    *pathDeriv2 = meanDeriv2 * temp2; 
-    *priceVec1 = temp3; 
-    *priceVec2 = temp4;	
 }
 
 
 /**
-* @brief   Calculates the  price and vega for all trajectories for given random numbers(For Vector Kernel)
-* @param   attrib  structure of inputs for simulation
-* @param   priceSamples    array of calculated price samples
-* @param   pathDeriv   array calculated path derivatives 
-* @param   sData1   array used for blockwise reduction
+* @brief   Simulates both paths of a pair and adds the sample to the moments
+* @param   attrib       structure of inputs for simulation
+* @param   noOfSum      Number of averaging points
+* @param   pair         index of the pair of paths
+* @param   moments      MOMENTS running sums of the work-item
 */
-__kernel 
-    void
-    calPriceVega_Vector(MonteCarloAttribVector attrib,
+void 
+    simulatePair(MonteCarloAttribScalar attrib,
     int noOfSum,
-    __global uint4 *randArray,
-    __global float4 *priceSamples,
-    __global float4 *pathDeriv,
-    __local float8 *sData1)
+    uint pair,
+    uint seed,
+    int sampling,
+    __global const uint *sobolTable,
+    float *moments)
 {
-    float4 strikePrice = attrib.strikePrice;
-    float4 c1 = attrib.c1;
-    float4 c2 = attrib.c2;
-    float4 c3 = attrib.c3;
-    float4 initPrice = attrib.initPrice;
-    float4 sigma = attrib.sigma;
-    float4 timeStep = attrib.timeStep;
-
-    int2 localIdx;
-    int2 groupIdx;
-    int2 groupDim;
-    localIdx.x = (int)get_local_id(0);
-    localIdx.y = (int)get_local_id(1);
-    groupIdx.x = (int)get_group_id(0);
-    groupIdx.y = (int)get_group_id(1);
-    groupDim.x = (int)get_local_size(0);
-    groupDim.y = (int)get_local_size(1);
-
-    int xDim = (int)get_global_size(0);
-    int yDim = (int)get_global_size(1);
-    int xPos = (int)get_global_id(0);
-    int yPos = (int)get_global_id(1);
-    int gidx=yPos * xDim + xPos;
-    int bidx=groupIdx.y*xDim/groupDim.x+groupIdx.x;
-    int lidx=localIdx.y*groupDim.x + localIdx.x;
-    
-    float4 temp = (float4)0.0f;
-    float4 temp1 = (float4)0.0f;
-    float4 temp2 = (float4)0.0f;
-
-    float4 price1 = (float4)0.0f;
-    float4 price2 = (float4)0.0f;
-    float4 pathDeriv1 = (float4)0.0f;
-    float4 pathDeriv2 = (float4)0.0f;
-
-    float4 trajPrice1 = initPrice;
-    float4 trajPrice2 = initPrice;
-
-    float4 sumPrice1 = initPrice;
-    float4 sumPrice2 = initPrice;
-
-    float4 meanPrice1 = temp;
-    float4 meanPrice2 = temp;
+    float temp1 = 0.0f;
+    float temp2 = 0.0f;
 
-    float4 sumDeriv1 = temp;
-    float4 sumDeriv2 = temp;
+    float trajPrice1 = attrib.initPrice;
+    float trajPrice2 = attrib.initPrice;
 
-    float4 meanDeriv1 = temp;
-    float4 meanDeriv2 = temp;
+    float sumPrice1 = attrib.initPrice;
+    float sumPrice2 = attrib.initPrice;
 
-    float4 finalRandf1 = temp;
-    float4 finalRandf2 = temp;
+    float sumLog1 = 0.0f;
+    float sumLog2 = 0.0f;
 
-    uint4 nextRand = randArray[gidx];
+    float sumDeriv1 = 0.0f;
+    float sumDeriv2 = 0.0f;
 
     //Run the Monte Carlo simulation a total of Num_Sum - 1 times
     for(int i = 1; i < noOfSum; i++)
     {
-        uint4 tempRand = nextRand;
-        generateRand_Vector(tempRand, &finalRandf1, &finalRandf2, &nextRand);
+        float finalRandf1;
+        float finalRandf2;
+        generateRand(pair, i, seed, sampling, sobolTable, &finalRandf1, &finalRandf2);
 
         //Calculate the trajectory price and sum price for all trajectories
-
-        temp1 += c1 + c2 * finalRandf1;
-        temp2 += c1 + c2 * finalRandf2;
-        trajPrice1 = trajPrice1 * exp(c1 + c2 * finalRandf1);
-        trajPrice2 = trajPrice2 * exp(c1 + c2 * finalRandf2);
+        temp1 += attrib.c1 + attrib.c2 * finalRandf1;
+        temp2 += attrib.c1 + attrib.c2 * finalRandf2;
+        trajPrice1 = trajPrice1 * exp(attrib.c1 + attrib.c2 * finalRandf1);
+        trajPrice2 = trajPrice2 * exp(attrib.c1 + attrib.c2 * finalRandf2);
 
         sumPrice1 = sumPrice1 + trajPrice1;
         sumPrice2 = sumPrice2 + trajPrice2;
 
-        temp = c3 * timeStep * i;
+        // log(trajPrice / initPrice) for the geometric average
+        sumLog1 = sumLog1 + temp1;
+        sumLog2 = sumLog2 + temp2;
+
+        float temp = attrib.c3 * attrib.timeStep * i;
 
         // Calculate the derivative price for all trajectories
         sumDeriv1 = sumDeriv1 + trajPrice1 
-            * (temp1 - temp) / sigma;
+            * (temp1 - temp) / attrib.sigma;
 
         sumDeriv2 = sumDeriv2 + trajPrice2 
-            * (temp2 - temp) / sigma;
-    }
-
-    //Calculate the average price and average derivative of each simulated path
-    meanPrice1 = sumPrice1 / noOfSum;
-    meanPrice2 = sumPrice2 / noOfSum;
-    meanDeriv1 = sumDeriv1 / noOfSum;
-    meanDeriv2 = sumDeriv2 / noOfSum;
-
-    calOutputs_Vector(strikePrice, meanDeriv1, meanDeriv2, meanPrice1,
-        meanPrice2, &pathDeriv1, &pathDeriv2, &price1, &price2);
-
-     //Do the reduction blockwise and store the result in sData1[0]
-     sData1[lidx]=(float8)(price1+price2,pathDeriv1+pathDeriv2);
-     barrier(CLK_LOCAL_MEM_FENCE);
-
-    for(unsigned int s = (groupDim.x*groupDim.y)>> 1; s > 0; s >>= 1) 
-    {
-        if(lidx < s) 
-        {
-            sData1[lidx] += sData1[lidx + s];
-        }
-          barrier(CLK_LOCAL_MEM_FENCE);	
+            * (temp2 - temp) / attrib.sigma;
     }
 
-    // Write the reduction result of  this block to global memory
-    if ((localIdx.y==0) && (localIdx.x==0) ){
-    priceSamples[bidx] = sData1[0].lo;
-    pathDeriv[bidx] = sData1[0].hi;
-    
-    }
+    // Payoffs of the average price and of the geometric average
+    float price1 = fmax(sumPrice1 / noOfSum - attrib.strikePrice, 0.0f);
+    float price2 = fmax(sumPrice2 / noOfSum - attrib.strikePrice, 0.0f);
+    float control1 = fmax(attrib.initPrice * exp(sumLog1 / noOfSum) - attrib.strikePrice, 0.0f);
+    float control2 = fmax(attrib.initPrice * exp(sumLog2 / noOfSum) - attrib.strikePrice, 0.0f);
+    float deriv1 = price1 > 0.0f ? sumDeriv1 / noOfSum : 0.0f;
+    float deriv2 = price2 > 0.0f ? sumDeriv2 / noOfSum : 0.0f;
+
+    float y = 0.5f * (price1 + price2);
+    float c = 0.5f * (control1 + control2);
+    moments[MOMENT_PRICE] += y;
+    moments[MOMENT_PRICE2] += y * y;
+    moments[MOMENT_CONTROL] += c;
+    moments[MOMENT_CONTROL2] += c * c;
+    moments[MOMENT_CROSS] += y * c;
+    moments[MOMENT_VEGA] += 0.5f * (deriv1 + deriv2);
 }
 
-typedef struct _MonteCalroAttribScalar
-{
-    float strikePrice;
-    float c1;
-    float c2;
-    float c3;
-    float initPrice;
-    float sigma;
-    float timeStep;
-}MonteCarloAttribScalar;
-
 /**
-* @brief Generates gaussian random numbers by using Mersenenne
-*        Twister algo and box muller transformation(For Scalar Kernel)
-* @param randPrice		local memory used for price randon num generation
-* @param randVega		local memory used for vega randon num generation
-* @param seed			Initial seed value for random number generation
-* @param gaussianRand1	gaussian random number generatred
-* @param gaussianRand2	gaussian random number generarted 
-* @param nextRand		generated seed for next usage
-* @param lidx			local thread index
+* @brief   Calculates the moments of pathsPerItem pairs per work-item and
+*          reduces them per group
+* @param   attrib       structure of inputs for simulation
+* @param   noOfSum      Number of averaging points
+* @param   firstPair    index of the first pair of this batch
+* @param   pathsPerItem pairs of paths per work-item
+* @param   seed         seed of the run
+* @param   sampling     SAMPLING_* flags
+* @param   sobolTable   direction numbers and shift of every dimension
+* @param   partial      MOMENTS sums per group
+* @param   sData        array used for blockwise reduction
 */
-void 
-    generateRand_Scalar(
-    __local uint* randPrice,
-    __local uint* randVega,
-    uint seed,
-    float *gaussianRand1,
-    float *gaussianRand2,
-    uint *nextRand,
-    uint lidx)
+__kernel 
+    void 
+    calPriceVega(MonteCarloAttribScalar attrib,
+        int noOfSum,
+        uint firstPair,
+        int pathsPerItem,
+        uint seed,
+        int sampling,
+        __global const uint *sobolTable,
+        __global float *partial,
+        __local float *sData)
 {
-    uint r2 = 0;
-    uint b = 0; 
-
-    uint state[4]; 
-    uint temp[4];
-
-    //Initializing states.
-    state[0] = stateMask * (seed	 ^ (seed	 >> thirty)) + 1u;
-    state[1] = stateMask * (state[0] ^ (state[0] >> thirty)) + 2u;
-    state[2] = stateMask * (state[1] ^ (state[1] >> thirty)) + 3u;
-    state[3] = stateMask * (state[2] ^ (state[2] >> thirty)) + 4u;
+    int xDim = (int)get_global_size(0);
+    int gidx = (int)get_global_id(1) * xDim + (int)get_global_id(0);
+    int groupSize = (int)(get_local_size(0) * get_local_size(1));
+    int bidx = (int)(get_group_id(1) * get_num_groups(0) + get_group_id(0));
+    int lidx = (int)(get_local_id(1) * get_local_size(0) + get_local_id(0));
 
-    #pragma unroll 4
-    for(uint i = 0; i < mulFactor; ++i)
+    float moments[MOMENTS];
+    for(int m = 0; m < MOMENTS; ++m)
     {
-        barrier(CLK_LOCAL_MEM_FENCE);
-
-        randPrice[lidx] = ((i==0) ? state[2] : r2);
-        r2 = ((i==0) ? state[3] : temp[i-1]);
-        randVega[lidx] = ((i==0) ? seed : state[i-1]);
-        b = ((i==3) ? seed : state[i+1]);
-
-        barrier(CLK_LOCAL_MEM_FENCE);	
-
-        // lshift128
-        uint e = randVega[lidx] << threeBytes;
-        if (lidx % 4) {
-            e |= (randVega[lidx-1] >> (32u - threeBytes));
-        }
-
-        // rshift128
-        uint f = randPrice[lidx] >> threeBytes;
-        if ((lidx+1) % 4) {
-            f |= (randPrice[lidx+1] << (32u - threeBytes));
-        }
+        moments[m] = 0.0f;
+    }
 
-        temp[i] = randVega[lidx] ^ e ^ ((b >> thirteen) & mask[lidx%4]) ^ f ^ (r2 << fifteen);
-    }        
+    for(int v = 0; v < pathsPerItem; ++v)
+    {
+        simulatePair(attrib, noOfSum, firstPair + (uint)(gidx * pathsPerItem + v),
+                     seed, sampling, sobolTable, moments);
+    }
 
-    // Applying Box Mullar Transformations.
-    float r = sqrt((-two) * log(temp[0] * one / intMax));
-    float phi  = two * PI * temp[1] * one / intMax;
-    *gaussianRand1 = r * cos(phi);
-    *gaussianRand2 = r * sin(phi);
-    *nextRand = temp[2];
-}
+    // Do the reduction blockwise, moment m of work-item i in sData[m * groupSize + i]
+    for(int m = 0; m < MOMENTS; ++m)
+    {
+        sData[m * groupSize + lidx] = moments[m];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-/**
-* @brief   calculates the  price and vega for all trajectories(For Scalar Kernel)
-* @param strikePrice	Strike price
-* @param meanDeriv1		Average Derive price (from gaussianRand1)
-* @param meanDeriv2		Average Derive price (from gaussianRand2)
-* @param meanPrice1		Average price (from gaussianRand1)
-* @param meanPrice2		Average price (from gaussianRand2)
-* @param pathDeriv1		path derive price (for gaussianRand1)
-* @param pathDeriv2		path derive price (for gaussianRand2)
-* @param price1			price (for gaussianRand1)
-* @param price2			price (for gaussianRand2)
-*/
-void 
-    calOutputs_Scalar(float strikePrice,
-    float meanDeriv1,
-    float meanDeriv2, 
-    float meanPrice1,
-    float meanPrice2,
-    float *pathDeriv1,
-    float *pathDeriv2, 
-    float *price1,
-    float *price2)
-{
-    *price1 = 0.0f;
-    *price2 = 0.0f;
-    *pathDeriv1 = 0.0f;
-    *pathDeriv2 = 0.0f;
-    float tempDiff1 = meanPrice1 - strikePrice;
-    float tempDiff2 = meanPrice2 - strikePrice;
-    if(tempDiff1 > 0.0f)
+    for(int s = groupSize >> 1; s > 0; s >>= 1) 
     {
-        *pathDeriv1 = meanDeriv1;
-        *price1 = tempDiff1;
+        if(lidx < s) 
+        {
+            for(int m = 0; m < MOMENTS; ++m)
+            {
+                sData[m * groupSize + lidx] += sData[m * groupSize + lidx + s];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);	
     }
-    if(tempDiff2 > 0.0f)
+
+    // Write the reduction result of this block to global memory
+    if(lidx < MOMENTS)
     {
-        *pathDeriv2 = meanDeriv2;
-        *price2 = tempDiff2;
+        partial[bidx * MOMENTS + lidx] = sData[lidx * groupSize];
     }
 }
 
-
 /**
-* @brief   Calculates the  price and vega for all trajectories for given random numbers(For Scalar Kernel)
-* @param   attrib		structure of inputs for simulation
-* @param   noOfSum		Number of Monte Carlo simulation
-* @param   priceSamples array of calculated price samples
-* @param   pathDeriv    array calculated path derivatives 
-* @param   sData1		array used for blockwise reduction
-* @param   randPrice	local memory used for price randon num generation
-* @param   randVega		local memory used for vega randon num generation
+* @brief   Adds the group sums of one batch to the running totals of an
+*          option. A single group runs this kernel, the totals carry a
+*          Kahan compensation term: total = acc[2m] - acc[2m + 1]
+* @param   partial      MOMENTS sums per group of calPriceVega
+* @param   numPartials  number of groups of calPriceVega
+* @param   option       option whose totals are updated
+* @param   acc          2 * MOMENTS floats per option
+* @param   sData        array used for blockwise reduction
 */
 __kernel 
     void 
-    calPriceVega_Scalar(MonteCarloAttribScalar attrib,
-        int noOfSum,
-        __global uint *randArray,
-        __global float *priceSamples,
-        __global float *pathDeriv,
-        __local float2 *sData1,
-        __local uint *randPrice,
-        __local uint *randVega)
+    accumulate(__global const float *partial,
+        int numPartials,
+        int option,
+        __global float *acc,
+        __local float *sData)
 {
-    float strikePrice = attrib.strikePrice;
-    float c1 = attrib.c1;
-    float c2 = attrib.c2;
-    float c3 = attrib.c3;
-    float initPrice = attrib.initPrice;
-    float sigma = attrib.sigma;
-    float timeStep = attrib.timeStep;
-
-    int2 localIdx;
-    int2 groupIdx;
-    int2 groupDim;
-    localIdx.x = (int)get_local_id(0);
-    localIdx.y = (int)get_local_id(1);
-    groupIdx.x = (int)get_group_id(0);
-    groupIdx.y = (int)get_group_id(1);
-    groupDim.x = (int)get_local_size(0);
-    groupDim.y = (int)get_local_size(1);
-
-    int xDim = (int)get_global_size(0);
-    int yDim = (int)get_global_size(1);
-    int xPos = (int)get_global_id(0);
-    int yPos = (int)get_global_id(1);
-    int gidx=yPos * xDim + xPos;
-    int bidx=groupIdx.y*xDim/groupDim.x+groupIdx.x;
-    int lidx=localIdx.y*groupDim.x + localIdx.x;
-
-    float temp  = 0.0f;
-    float temp1 = 0.0f;
-    float temp2 = 0.0f;
-
-    float price1 = 0.0f;
-    float price2 = 0.0f;
-    float pathDeriv1 = 0.0f;
-    float pathDeriv2 = 0.0f;
-
-    float trajPrice1 = initPrice;
-    float trajPrice2 = initPrice;
-
-    float sumPrice1 = initPrice;
-    float sumPrice2 = initPrice;
+    int lidx = (int)get_local_id(0);
+    int groupSize = (int)get_local_size(0);
 
-    float meanPrice1 = 0.0f;
-    float meanPrice2 = 0.0f;
-
-    float sumDeriv1 = 0.0f;
-    float sumDeriv2 = 0.0f;
-
-    float meanDeriv1 = 0.0f;
-    float meanDeriv2 = 0.0f;
-
-    float finalRandf1 = 0.0f;
-    float finalRandf2 = 0.0f;
-
-    uint nextRand = randArray[gidx];
-
-    //Run the Monte Carlo simulation a total of Num_Sum - 1 times
-    for(int i = 1; i < noOfSum; i++)
+    float moments[MOMENTS];
+    for(int m = 0; m < MOMENTS; ++m)
     {
-        uint tempRand = nextRand;
-        generateRand_Scalar(randPrice, randVega, tempRand, &finalRandf1, &finalRandf2, &nextRand, lidx);
-
-        //Calculate the trajectory price and sum price for all trajectories
-        temp1 += c1 + c2 * finalRandf1;
-        temp2 += c1 + c2 * finalRandf2;
-        trajPrice1 = trajPrice1 * exp(c1 + c2 * finalRandf1);
-        trajPrice2 = trajPrice2 * exp(c1 + c2 * finalRandf2);
-
-        sumPrice1 = sumPrice1 + trajPrice1;
-        sumPrice2 = sumPrice2 + trajPrice2;
-
-        temp = c3 * timeStep * i;
-
-        // Calculate the derivative price for all trajectories
-        sumDeriv1 = sumDeriv1 + trajPrice1 
-            * (temp1 - temp) / sigma;
-
-        sumDeriv2 = sumDeriv2 + trajPrice2 
-            * (temp2 - temp) / sigma;
+        moments[m] = 0.0f;
+    }
+    for(int i = lidx; i < numPartials; i += groupSize)
+    {
+        for(int m = 0; m < MOMENTS; ++m)
+        {
+            moments[m] += partial[i * MOMENTS + m];
+        }
     }
 
-    // Calculate the average price and average derivative of each simulated path
-    meanPrice1 = sumPrice1 / noOfSum;
-    meanPrice2 = sumPrice2 / noOfSum;
-    meanDeriv1 = sumDeriv1 / noOfSum;
-    meanDeriv2 = sumDeriv2 / noOfSum;
-
-    calOutputs_Scalar(strikePrice, meanDeriv1, meanDeriv2, meanPrice1,
-                     meanPrice2, &pathDeriv1, &pathDeriv2, &price1, &price2);
-
-    // Do the reduction blockwise and store the result in sData1[0-7]
-    sData1[lidx] = (float2)(price1+price2, pathDeriv1+pathDeriv2);
+    for(int m = 0; m < MOMENTS; ++m)
+    {
+        sData[m * groupSize + lidx] = moments[m];
+    }
     barrier(CLK_LOCAL_MEM_FENCE);
 
-    for(unsigned int s = (groupDim.x*groupDim.y)>> 1; s >= 4; s >>= 1) 
+    for(int s = groupSize >> 1; s > 0; s >>= 1) 
     {
         if(lidx < s) 
         {
-            sData1[lidx] += sData1[lidx + s];
+            for(int m = 0; m < MOMENTS; ++m)
+            {
+                sData[m * groupSize + lidx] += sData[m * groupSize + lidx + s];
+            }
         }
         barrier(CLK_LOCAL_MEM_FENCE);	
     }
 
-    // Write the reduction result of  this block to global memory
-    if (lidx < 4){
-        priceSamples[bidx*4+lidx] = sData1[lidx].lo;
-        pathDeriv[bidx*4+lidx] = sData1[lidx].hi;
+    if(lidx < MOMENTS)
+    {
+        __global float *total = acc + (option * MOMENTS + lidx) * 2;
+        float y = sData[lidx * groupSize] - total[1];
+        float t = total[0] + y;
+        total[1] = (t - total[0]) - y;
+        total[0] = t;
     }
-}
\ No newline at end of file
+}
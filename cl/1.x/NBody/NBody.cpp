@@ -26,10 +26,11 @@ void* me;           /**< Pointing to NBody class */
 
 
 float
-NBody::random(float randMax, float randMin)
+NBody::random(float randMax, float randMin, cl_uint index)
 {
-    float result;
-    result =(float)rand() / (float)RAND_MAX;
+    CRNGPair seed = {{NBODY_SEED, 0u}};
+    CRNGBlock r = crngStreamBlock(CRNG_PHILOX, seed, 0u, index / 4);
+    float result = crngUniform(r.v[index % 4]);
 
     return ((1.0f - result) * randMin + result *randMax);
 }
@@ -55,11 +56,11 @@ NBody::setupNBody()
         // First 3 values are position in x,y and z direction
         for(int j = 0; j < 3; ++j)
         {
-            initPos[index + j] = random(3, 50);
+            initPos[index + j] = random(3, 50, index + j);
         }
 
         // Mass value
-        initPos[index + 3] = random(1, 1000);
+        initPos[index + 3] = random(1, 1000, index + 3);
     }
     return SDK_SUCCESS;
 }
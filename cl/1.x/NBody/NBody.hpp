@@ -23,11 +23,13 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <assert.h>
 #include <string.h>
 #include "CLUtil.hpp"
+#include "CounterRNG.h"
 
 #define GROUP_SIZE 64
 
 //For FLOPS calculation
 #define KERNEL_FLOPS 20
+#define NBODY_SEED 1       /**< Seed of the initial particle positions */
 
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.2"
 
@@ -74,7 +76,11 @@ class NBody
 
     private:
 
-        float random(float randMax, float randMin);
+        /**
+        * Value 'index' of a counter-based uniform stream scaled to [randMin, randMax]
+        * Stateless, so the initial state is identical on every host and run
+        */
+        float random(float randMax, float randMin, cl_uint index);
 
     public:
 
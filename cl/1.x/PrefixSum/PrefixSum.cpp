@@ -83,6 +83,13 @@ PrefixSum::setupCL(void)
     }
 
     // Get platform
+#ifdef BATCH_RUNNER
+    // Context of the batch, created by the first sample that needs it
+    cl_platform_id platform = NULL;
+    int retValue = CLRuntime::getInstance().getContext(sampleArgs, dType,
+                   platform, context);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::getContext() failed");
+#else
     cl_platform_id platform = NULL;
     int retValue = getPlatform(platform, sampleArgs->platformId,
                                sampleArgs->isPlatformEnabled());
@@ -107,6 +114,7 @@ PrefixSum::setupCL(void)
                   NULL,
                   &status);
     CHECK_OPENCL_ERROR(status, "clCreateContextFromType failed.");
+#endif
 
     status = getDevices(context, &devices, sampleArgs->deviceId,
                         sampleArgs->isDeviceIdEnabled());
@@ -117,13 +125,19 @@ PrefixSum::setupCL(void)
     CHECK_ERROR(status, SDK_SUCCESS, "SDKDeviceInfo::setDeviceInfo() failed");
 
     // Create command queue
+#ifdef BATCH_RUNNER
+    status = CLRuntime::getInstance().getCommandQueue(context,
+             devices[sampleArgs->deviceId], 0, commandQueue);
+    CHECK_ERROR(status, SDK_SUCCESS, "CLRuntime::getCommandQueue() failed");
+#else
     commandQueue = clCreateCommandQueue(context,
                                         devices[sampleArgs->deviceId],
                                         0,
                                         &status);
     CHECK_OPENCL_ERROR(status, "clCreateCommandQueue failed.");
+#endif
 
-    inputBuffer = clCreateBuffer(
+    inputBuffer = CREATE_BUFFER(
                       context,
                       CL_MEM_READ_ONLY,
                       sizeof(cl_float) * length,
@@ -131,7 +145,7 @@ PrefixSum::setupCL(void)
                       &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (inputBuffer)");
 
-    outputBuffer = clCreateBuffer(
+    outputBuffer = CREATE_BUFFER(
                        context,
                        CL_MEM_WRITE_ONLY,
                        sizeof(cl_float) * length,
@@ -156,7 +170,11 @@ PrefixSum::setupCL(void)
         buildData.flagsFileName = std::string(sampleArgs->flags.c_str());
     }
 
+#ifdef BATCH_RUNNER
+    retValue = CLRuntime::getInstance().getProgram(context, buildData, program);
+#else
     retValue = buildOpenCLProgram(program, context, buildData);
+#endif
     CHECK_ERROR(retValue, SDK_SUCCESS, "buildOpenCLProgram() failed");
 
     // get a kernel object handle for a kernel with the given name
@@ -324,7 +342,7 @@ PrefixSum::runCLKernels(void)
     }
 
     cl_event writeEvt;
-    status = clEnqueueWriteBuffer(
+    status = WRITE_BUFFER(
                  commandQueue,
                  inputBuffer,
                  CL_FALSE,
@@ -551,10 +569,10 @@ int PrefixSum::cleanup()
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.(program)");
 
-    status = clReleaseMemObject(inputBuffer);
+    status = RELEASE_BUFFER(inputBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(inputBuffer)");
 
-    status = clReleaseMemObject(outputBuffer);
+    status = RELEASE_BUFFER(outputBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(outputBuffer)");
 
     status = clReleaseCommandQueue(commandQueue);
@@ -607,8 +625,13 @@ PrefixSum::unmapBuffer(cl_mem deviceBuffer, void* hostPointer)
     return SDK_SUCCESS;
 }
 
+#ifdef BATCH_RUNNER
+static int
+runPrefixSum(int argc, char * argv[])
+#else
 int
 main(int argc, char * argv[])
+#endif
 {
 
     PrefixSum clPrefixSum;
@@ -656,3 +679,7 @@ main(int argc, char * argv[])
     clPrefixSum.printStats();
     return SDK_SUCCESS;
 }
+
+#ifdef BATCH_RUNNER
+REGISTER_SAMPLE("PrefixSum", runPrefixSum);
+#endif
@@ -18,15 +18,64 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <malloc.h>
 
 
+/*
+ * splitmix64 : random words of the scrambling, one stream per seed
+ */
+static cl_ulong
+splitMix(cl_ulong &state)
+{
+    cl_ulong z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* Reverses the bits of a 32-bit word, same as the kernel */
+static cl_uint
+reverseBits(cl_uint x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+/* Hash based Owen scrambling, same as the kernel */
+static cl_uint
+owenScramble(cl_uint x, cl_uint seed)
+{
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverseBits(x);
+}
+
 /* Generate direction numbers
-   v[j][32] : j dimensions each having 32 direction numbers
+   v[j][33] : j dimensions each having 32 direction numbers and the
+   scrambling word
 */
-void
+int
 QuasiRandomSequence::generateDirectionNumbers(cl_uint nDimensions,
         cl_uint* directionNumbers)
 {
     cl_uint *v = directionNumbers;
 
+    // Decode the primitives of all dimensions at once
+    struct primitive *primitives = (struct primitive*)malloc(nDimensions *
+                                   sizeof(struct primitive));
+    CHECK_ALLOCATION(primitives, "Failed to allocate host memory. (primitives)");
+
+    if(getSobolPrimitives(0, nDimensions, primitives) != nDimensions)
+    {
+        std::cout << "Not enough primitive polynomials!\n";
+        free(primitives);
+        return SDK_FAILURE;
+    }
+
     for (int dim = 0 ; dim < (int)(nDimensions); dim++)
     {
         // First dimension is a special case
@@ -35,17 +84,17 @@ QuasiRandomSequence::generateDirectionNumbers(cl_uint nDimensions,
             for (int i = 0 ; i < N_DIRECTIONS ; i++)
             {
                 // All m's are 1
-                v[i] = 1 << (31 - i);
+                v[i] = 1u << (31 - i);
             }
         }
         else
         {
-            int d = sobolPrimitives[dim].degree;
+            int d = primitives[dim].degree;
             /* The first direction numbers (up to the degree of the polynomial)
              are simply   v[i] = m[i] / 2^i  (stored in Q0.32 format) */
             for (int i = 0 ; i < d ; i++)
             {
-                v[i] = sobolPrimitives[dim].m[i] << (31 - i);
+                v[i] = primitives[dim].m[i] << (31 - i);
             }
 
             for (int i = d ; i < N_DIRECTIONS ; i++)
@@ -61,11 +110,73 @@ QuasiRandomSequence::generateDirectionNumbers(cl_uint nDimensions,
                  the LSB) and then mask with 1.*/
                 for (int j = 1 ; j < d ; j++)
                 {
-                    v[i] ^= (((sobolPrimitives[dim].a >> (d - 1 - j)) & 1) * v[i - j]);
+                    v[i] ^= (((primitives[dim].a >> (d - 1 - j)) & 1) * v[i - j]);
                 }
             }
         }
-        v += N_DIRECTIONS;
+
+        // No scrambling : zero digital shift
+        v[N_DIRECTIONS] = 0;
+        v += TABLE_WIDTH;
+    }
+
+    free(primitives);
+
+    if(scramble != SCRAMBLE_NONE)
+    {
+        scrambleDirectionNumbers(nDimensions, directionNumbers);
+    }
+
+    return SDK_SUCCESS;
+}
+
+void
+QuasiRandomSequence::scrambleDirectionNumbers(cl_uint nDimensions,
+        cl_uint* directionNumbers)
+{
+    for (int dim = 0 ; dim < (int)(nDimensions); dim++)
+    {
+        cl_uint *v = directionNumbers + dim * TABLE_WIDTH;
+        cl_ulong state = ((cl_ulong)seed << 32) ^ (cl_ulong)dim;
+
+        if(scramble == SCRAMBLE_OWEN)
+        {
+            // The kernel hashes the points with this seed
+            v[N_DIRECTIONS] = (cl_uint)splitMix(state);
+            continue;
+        }
+
+        /*
+         * Linear matrix scrambling : digit r (bit 31 - r) of every direction
+         * number becomes the parity of its digits 0..r selected by row r of
+         * a random lower triangular matrix with unit diagonal. The sequence
+         * stays a (t, s) sequence, the random digital shift makes every
+         * point uniformly distributed.
+         */
+        cl_uint rows[N_DIRECTIONS];
+        for (int r = 0 ; r < N_DIRECTIONS ; r++)
+        {
+            cl_uint lower = 0xffffffffu << (31 - r);
+            rows[r] = ((cl_uint)splitMix(state) | (1u << (31 - r))) & lower;
+        }
+
+        for (int i = 0 ; i < N_DIRECTIONS ; i++)
+        {
+            cl_uint scrambled = 0;
+            for (int r = 0 ; r < N_DIRECTIONS ; r++)
+            {
+                cl_uint bits = v[i] & rows[r];
+                bits ^= bits >> 16;
+                bits ^= bits >> 8;
+                bits ^= bits >> 4;
+                bits ^= bits >> 2;
+                bits ^= bits >> 1;
+                scrambled |= (bits & 1) << (31 - r);
+            }
+            v[i] = scrambled;
+        }
+
+        v[N_DIRECTIONS] = (cl_uint)splitMix(state);
     }
 }
 
@@ -82,7 +193,14 @@ QuasiRandomSequence::setupQuasiRandomSequence()
     // Check for dimensions
     if(nDimensions > MAX_DIMENSIONS)
     {
-        std::cout << "Max allowed dimension is 10200!\n";
+        std::cout << "Max allowed dimension is " << MAX_DIMENSIONS << "!\n";
+        return SDK_FAILURE;
+    }
+
+    // Every index of the sequence has to fit in 32 bits
+    if((cl_ulong)firstIndex + nVectors > 0xffffffffull)
+    {
+        std::cout << "Offset + number of vectors exceeds 2^32 - 1!\n";
         return SDK_FAILURE;
     }
 
@@ -93,19 +211,23 @@ QuasiRandomSequence::setupQuasiRandomSequence()
      * there is no need of device->host transfer. Hence map call will be faster
      */
     int status = mapBuffer( inputBuffer, input,
-                            (nDimensions * N_DIRECTIONS * sizeof(cl_uint)),
+                            (nDimensions * TABLE_WIDTH * sizeof(cl_uint)),
                             CL_MAP_WRITE_INVALIDATE_REGION );
     CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(inputBuffer)");
 
     // initialize sobol direction numbers
-    generateDirectionNumbers(nDimensions, input);
+    if(generateDirectionNumbers(nDimensions, input) != SDK_SUCCESS)
+    {
+        unmapBuffer(inputBuffer, input);
+        return SDK_FAILURE;
+    }
 
     if(!sampleArgs->quiet)
     {
         printArray<cl_uint>(
             "Input",
             input,
-            N_DIRECTIONS,
+            TABLE_WIDTH,
             nDimensions);
     }
 
@@ -292,10 +414,34 @@ QuasiRandomSequence::setupCL(void)
     nVectors = (nVectors / vectorWidth)? ((nVectors / vectorWidth) * vectorWidth):
                vectorWidth;
 
+    // A work-item writes whole vectors of points
+    pointsPerItem = (pointsPerItem / vectorWidth)? ((pointsPerItem / vectorWidth) *
+                    vectorWidth): vectorWidth;
+
+    // Check the scrambling
+    if(scrambleName.compare("none") == 0)
+    {
+        scramble = SCRAMBLE_NONE;
+    }
+    else if(scrambleName.compare("lms") == 0)
+    {
+        scramble = SCRAMBLE_LMS;
+    }
+    else if(scrambleName.compare("owen") == 0)
+    {
+        scramble = SCRAMBLE_OWEN;
+    }
+    else
+    {
+        std::cout << "Unknown scrambling " << scrambleName
+                  << " (none, lms or owen)" << std::endl;
+        return SDK_FAILURE;
+    }
+
     inputBuffer = clCreateBuffer(
                       context,
                       CL_MEM_READ_ONLY,
-                      sizeof(cl_uint) * nDimensions * N_DIRECTIONS,
+                      sizeof(cl_uint) * nDimensions * TABLE_WIDTH,
                       0,
                       &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (inputBuffer)");
@@ -337,19 +483,6 @@ QuasiRandomSequence::setupCL(void)
              devices[sampleArgs->deviceId]);
     CHECK_ERROR(status, SDK_SUCCESS, "KernelInfo.setKernelWorkGroupInfo() failed");
 
-    if((nVectors/vectorWidth) > kernelInfo.kernelWorkGroupSize)
-    {
-        if(!sampleArgs->quiet)
-        {
-            std::cout << "Out of Resources!" << std::endl;
-            std::cout << "Group Size specified: " << (nVectors/vectorWidth) << std::endl;
-            std::cout << "Max Group Size supported on the kernel : "
-                      << kernelInfo.kernelWorkGroupSize<<std::endl;
-            std::cout << "Falling back to "
-                      << kernelInfo.kernelWorkGroupSize << std::endl;
-        }
-        nVectors = (cl_uint)kernelInfo.kernelWorkGroupSize * vectorWidth;
-    }
     return SDK_SUCCESS;
 }
 
@@ -360,18 +493,24 @@ QuasiRandomSequence::runCLKernels(void)
 {
     cl_int   status;
 
-    // set total threads and block size
-    size_t globalThreads[1]= {nDimensions * (nVectors / vectorWidth)};
-    size_t localThreads[1] = {(nVectors / vectorWidth)};
-
-    if(localThreads[0] > deviceInfo.maxWorkItemSizes[0] ||
-            localThreads[0] > deviceInfo.maxWorkGroupSize)
+    /*
+     * Each work-item generates pointsPerItem consecutive vectors of one
+     * dimension, the second dimension of the NDRange is the dimension of
+     * the sequence. Any number of vectors fits, the group size is not tied
+     * to nVectors anymore.
+     */
+    size_t items = (nVectors + pointsPerItem - 1) / pointsPerItem;
+    size_t localX = GROUP_SIZE;
+    localX = std::min(localX, kernelInfo.kernelWorkGroupSize);
+    localX = std::min(localX, deviceInfo.maxWorkItemSizes[0]);
+    if(items < localX)
     {
-        std::cout << "Unsupported: Device does not support"
-                  << "requested number of work items." << std::endl;
-        return SDK_FAILURE;
+        localX = items;
     }
 
+    size_t globalThreads[2] = {((items + localX - 1) / localX) * localX, nDimensions};
+    size_t localThreads[2] = {localX, 1};
+
     // Set appropriate arguments to the kernel
 
     // 1st argument to the kernel - outputBuffer
@@ -390,17 +529,50 @@ QuasiRandomSequence::runCLKernels(void)
                  (void *)&inputBuffer);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (inputBuffer)");
 
-    // 3rd argument to the kernel - localBuffer(shared memory)
+    // 3rd argument to the kernel - index of the first vector
     status = clSetKernelArg(
                  kernel,
                  2,
-                 32 * sizeof(cl_uint),
+                 sizeof(cl_uint),
+                 (void *)&firstIndex);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (firstIndex)");
+
+    // 4th argument to the kernel - number of vectors
+    status = clSetKernelArg(
+                 kernel,
+                 3,
+                 sizeof(cl_uint),
+                 (void *)&nVectors);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (nVectors)");
+
+    // 5th argument to the kernel - vectors per work-item
+    status = clSetKernelArg(
+                 kernel,
+                 4,
+                 sizeof(cl_uint),
+                 (void *)&pointsPerItem);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (pointsPerItem)");
+
+    // 6th argument to the kernel - Owen scrambling flag
+    cl_int owen = (scramble == SCRAMBLE_OWEN)? 1: 0;
+    status = clSetKernelArg(
+                 kernel,
+                 5,
+                 sizeof(cl_int),
+                 (void *)&owen);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (owen)");
+
+    // 7th argument to the kernel - localBuffer(shared memory)
+    status = clSetKernelArg(
+                 kernel,
+                 6,
+                 TABLE_WIDTH * sizeof(cl_uint),
                  NULL);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (localBuffer)");
 
     availableLocalMemory = deviceInfo.localMemSize - kernelInfo.localMemoryUsed;
 
-    neededLocalMemory = 32 * sizeof(cl_uint);
+    neededLocalMemory = TABLE_WIDTH * sizeof(cl_uint);
 
     if(neededLocalMemory > availableLocalMemory)
     {
@@ -413,7 +585,7 @@ QuasiRandomSequence::runCLKernels(void)
     status = clEnqueueNDRangeKernel(
                  commandQueue,
                  kernel,
-                 1,                              // work_dim
+                 2,                              // work_dim
                  NULL,                           // global_work_offset
                  globalThreads,                  // global_work_size
                  localThreads,                   // local_work_size
@@ -491,6 +663,39 @@ QuasiRandomSequence::initialize()
 
     delete vs;
 
+    Option* sequence_option = new Option;
+    CHECK_ALLOCATION(sequence_option, "Memory Allocation error.\n");
+
+    sequence_option->_sVersion = "";
+    sequence_option->_lVersion = "offset";
+    sequence_option->_description = "Index of the first vector of the sequence";
+    sequence_option->_type = CA_ARG_INT;
+    sequence_option->_value = &firstIndex;
+    sampleArgs->AddOption(sequence_option);
+
+    sequence_option->_sVersion = "";
+    sequence_option->_lVersion = "pointsPerItem";
+    sequence_option->_description = "Number of vectors generated by a work-item";
+    sequence_option->_type = CA_ARG_INT;
+    sequence_option->_value = &pointsPerItem;
+    sampleArgs->AddOption(sequence_option);
+
+    sequence_option->_sVersion = "";
+    sequence_option->_lVersion = "scramble";
+    sequence_option->_description = "Scrambling : none, lms (matrix + shift) or owen";
+    sequence_option->_type = CA_ARG_STRING;
+    sequence_option->_value = &scrambleName;
+    sampleArgs->AddOption(sequence_option);
+
+    sequence_option->_sVersion = "";
+    sequence_option->_lVersion = "seed";
+    sequence_option->_description = "Seed of the scrambling";
+    sequence_option->_type = CA_ARG_INT;
+    sequence_option->_value = &seed;
+    sampleArgs->AddOption(sequence_option);
+
+    delete sequence_option;
+
     return SDK_SUCCESS;
 }
 
@@ -570,24 +775,30 @@ QuasiRandomSequence::quasiRandomSequenceCPUReference()
 
     for(int j=0; j < (int)nDimensions; j++)
     {
+        cl_uint *v = input + j * TABLE_WIDTH;
         for(int i=0; i < (int)nVectors; i++)
         {
-            unsigned int temp = 0;
-            for(int k=0; k < 32; k++)
+            // Gray code ordering, same as the kernel
+            cl_uint index = firstIndex + i;
+            cl_uint gray = index ^ (index >> 1);
+            cl_uint temp = 0;
+            for(int k=0; k < N_DIRECTIONS; k++)
             {
-                int mask = (int)(pow(2, (double)k));
-                temp ^= ((i & mask) >> k) * input[j * 32 + k];
+                temp ^= ((gray >> k) & 1) * v[k];
             }
 
-            if(i==0 && j==0)
+            if(scramble == SCRAMBLE_OWEN)
             {
-                verificationOutput[j * nVectors + i] = 0;
+                temp = owenScramble(temp, v[N_DIRECTIONS]);
             }
             else
             {
-                verificationOutput[j * nVectors + i] =
-                    (cl_float)(temp / pow(2, (double)32));
+                temp ^= v[N_DIRECTIONS];
             }
+
+            // 24 bits of the point are exact in a float
+            verificationOutput[j * nVectors + i] =
+                (cl_float)(temp >> 8) * (1.0f / 16777216.0f);
         }
     }
 }
@@ -604,7 +815,7 @@ QuasiRandomSequence::verifyResults()
          * device->host transfer happens if device exists in different address-space
          */
         int status = mapBuffer( inputBuffer, input,
-                                (nDimensions * N_DIRECTIONS * sizeof(cl_uint)),
+                                (nDimensions * TABLE_WIDTH * sizeof(cl_uint)),
                                 CL_MAP_READ );
         CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(inputBuffer)");
 
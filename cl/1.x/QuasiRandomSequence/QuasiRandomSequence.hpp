@@ -129,9 +129,17 @@ using namespace appsdk;
 
 #define N_DIRECTIONS 32       ///< Number of direction numbers
 
-#define MAX_DIMENSIONS 10200  ///< Maximum number of dimensions
+#define TABLE_WIDTH (N_DIRECTIONS + 1)  ///< Direction numbers and scrambling word per dimension
+
+#define MAX_DIMENSIONS 65536  ///< Maximum number of dimensions
+
+#define POINTS_PER_ITEM 8     ///< Default points generated by a work-item
 
 #define GROUP_SIZE 256        ///< Number of workgroups 
+
+#define SCRAMBLE_NONE 0       ///< Plain Sobol sequence
+#define SCRAMBLE_LMS  1       ///< Linear matrix scrambling and digital shift
+#define SCRAMBLE_OWEN 2       ///< Hash based nested uniform scrambling
 /**
 * CL specific parameters used by SDK
 */
@@ -147,8 +155,13 @@ class QuasiRandomSequence
         neededLocalMemory;      /**< Local memory need by application which set from host */
 
         cl_uint
-        nVectors;      /**< Number of vectors(should be multiple of 32) */
+        nVectors;      /**< Number of vectors */
         cl_uint           nDimensions;      /**< Number of dimensions */
+        cl_uint            firstIndex;      /**< Index of the first vector (skip-ahead) */
+        cl_uint         pointsPerItem;      /**< Vectors generated by a work-item */
+        std::string      scrambleName;      /**< none, lms or owen */
+        cl_int               scramble;      /**< SCRAMBLE_* */
+        cl_uint                  seed;      /**< Seed of the scrambling */
         cl_uint
         *input;      /**< Input direction numbers to the device */
         cl_float              *output;      /**< Output Array of points from device */
@@ -192,6 +205,11 @@ class QuasiRandomSequence
             verificationOutput = NULL;
             nDimensions = 128;
             nVectors = GROUP_SIZE;
+            firstIndex = 0;
+            pointsPerItem = POINTS_PER_ITEM;
+            scrambleName = "none";
+            scramble = SCRAMBLE_NONE;
+            seed = 1;
             iterations = 1;
             vectorWidth = 0;            // Will be queried later for the device
         }
@@ -199,9 +217,20 @@ class QuasiRandomSequence
         /**
         * Generate Direction numbers (input to device)
         * @param n_dimensions number of dimensions
+        * @param directionNumbers array of direction numbers, TABLE_WIDTH
+        *        words per dimension
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int generateDirectionNumbers(cl_uint n_dimensions,
+                                     cl_uint* directionNumbers);
+
+        /**
+        * Scramble the direction numbers of every dimension : random lower
+        * triangular matrix and digital shift (lms) or seed (owen)
+        * @param n_dimensions number of dimensions
         * @param directionNumbers array of direction numbers
         */
-        void generateDirectionNumbers(cl_uint n_dimensions,
+        void scrambleDirectionNumbers(cl_uint n_dimensions,
                                       cl_uint* directionNumbers);
 
         /**
@@ -20,93 +20,158 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
  *
  * Quasi Random Sequence
  * Output size : n_dimensions * n_vectors
- * Input size: n_dimensions * n_directions 
- * shared buffer size : n_directions
- * Number of blocks : n_dimensions
+ * Input size: n_dimensions * (n_directions + 1)
+ * shared buffer size : n_directions + 1
+ * NDRange : (blocks of a dimension, n_dimensions)
  * First, all the direction numbers for a dimension are cached into
- * shared memory. Then each thread writes a single vector value by
- * using all the direction numbers from the shared memory.
+ * shared memory. Then each thread generates a block of consecutive points
+ * of the Gray code ordered sequence : the first point is computed from the
+ * bits of its index (skip-ahead, independent of the index), every further
+ * point costs a single XOR with the direction number of the lowest set bit
+ * of the next index.
  *
+ * The word after the direction numbers of a dimension is the digital shift
+ * of the linear matrix scrambled sequence (0 without scrambling), or the
+ * seed of the Owen scrambling.
  */
 
 
-#define N_DIRECTIONS_IN (32/4)
+#define N_DIRECTIONS 32
+#define TABLE_WIDTH (N_DIRECTIONS + 1)
 
-__kernel void QuasiRandomSequence_Vector(__global  float4* output,
-                                  __global  uint4* input,
-					    		  __local uint4* shared)
+/**
+ * Reverses the bits of a 32-bit word
+ */
+uint reverseBits(uint x)
 {
-	uint global_id = get_global_id(0);
-	uint local_id = get_local_id(0);
-	uint group_id = get_group_id(0);
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+/**
+ * Nested uniform (Owen) scrambling with a hash : a Laine-Karras permutation
+ * of the reversed bits only lets higher digits change lower ones
+ */
+uint owenScramble(uint x, uint seed)
+{
+	x = reverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits(x);
+}
+
+/**
+ * Point 'index' of the Gray code ordered sequence
+ */
+uint skipAhead(__local uint* v, uint index)
+{
+	uint gray = index ^ (index >> 1);
+	uint temp = 0;
+	for(int k = 0; gray != 0; k++, gray >>= 1)
+	{
+		temp ^= (gray & 1) * v[k];
+	}
+	return temp;
+}
+
+/**
+ * Scrambles a point and converts it to a float in [0, 1)
+ */
+float toUnit(__local uint* v, uint temp, int owen)
+{
+	temp = owen ? owenScramble(temp, v[N_DIRECTIONS]) : (temp ^ v[N_DIRECTIONS]);
+	return convert_float(temp >> 8) * (1.0f / 16777216.0f);
+}
 
-	uint factor = local_id*4;
-	uint4 vlid = (uint4)(factor, factor + 1, factor + 2, factor + 3);
-	float divisor = (float)pow((float)2, (float)32);
+/**
+ * Gray code step : point index + 1 from point index
+ */
+uint nextPoint(__local uint* v, uint temp, uint index)
+{
+	uint next = index + 1;
+	return temp ^ v[31 - clz(next & (~next + 1))];
+}
 
-	for(int i=local_id; i<N_DIRECTIONS_IN; i+=get_local_size(0))
+__kernel void QuasiRandomSequence_Vector(__global  float* output,
+                                  __global  uint* input,
+                                  uint firstIndex,
+                                  uint nVectors,
+                                  uint pointsPerItem,
+                                  int owen,
+					    		  __local uint* shared)
+{
+	uint dim = get_global_id(1);
+	uint local_id = get_local_id(0);
+
+	for(int i=local_id; i<TABLE_WIDTH; i+=get_local_size(0))
 	{
-		shared[i] = input[group_id * N_DIRECTIONS_IN + i];
+		shared[i] = input[dim * TABLE_WIDTH + i];
 	}
 	barrier(CLK_LOCAL_MEM_FENCE);
-	
-	__local uint *shared_scalar = (__local uint*)shared;
-
-	/*
-	 * Assuming vlid(lastBit) can go max upto (1024*4)
-	 * After 12th iteration lastBit will be zero
-	 * So looping upto 12 iterations is enough, instead of 32
-	 */
-	uint4 temp = 0, lastBit = vlid;
-	for(int k=0; k < 12; k++)
+
+	// pointsPerItem and nVectors are multiples of 4
+	uint first = get_global_id(0) * pointsPerItem;
+	if(first >= nVectors)
 	{
-		/*
-         * (lastBit & 1) gives the LSB in lastBit
-         * The loop iterates over all the bits and extracts each bit at a time
-         */
-        temp ^= (lastBit & 1) * shared_scalar[k];
-		lastBit >>= 1;
+		return;
 	}
+	uint last = min(first + pointsPerItem, nVectors);
 
-	output[global_id] = convert_float4(temp) / divisor;
+	uint index = firstIndex + first;
+	uint temp = skipAhead(shared, index);
+	for(uint i = first; i < last; i += 4, index += 4)
+	{
+		float4 result;
+		result.x = toUnit(shared, temp, owen);
+		temp = nextPoint(shared, temp, index);
+		result.y = toUnit(shared, temp, owen);
+		temp = nextPoint(shared, temp, index + 1);
+		result.z = toUnit(shared, temp, owen);
+		temp = nextPoint(shared, temp, index + 2);
+		result.w = toUnit(shared, temp, owen);
+		temp = nextPoint(shared, temp, index + 3);
+
+		vstore4(result, 0, output + dim * nVectors + i);
+	}
 }
 
 
 
-#define N_DIRECTIONS_IN_SCALAR 32
-
 __kernel void QuasiRandomSequence_Scalar(__global  float* output,
                                   __global  uint* input,
+                                  uint firstIndex,
+                                  uint nVectors,
+                                  uint pointsPerItem,
+                                  int owen,
 					    		  __local uint* shared)
 {
-	uint global_id = get_global_id(0);
+	uint dim = get_global_id(1);
 	uint local_id = get_local_id(0);
-	uint group_id = get_group_id(0);
-
-	float divisor = (float)pow((float)2, (float)32);
 
-	for(int i=local_id; i<N_DIRECTIONS_IN_SCALAR; i+=get_local_size(0))
+	for(int i=local_id; i<TABLE_WIDTH; i+=get_local_size(0))
 	{
-		shared[i] = input[group_id * N_DIRECTIONS_IN_SCALAR + i];
+		shared[i] = input[dim * TABLE_WIDTH + i];
 	}
 	barrier(CLK_LOCAL_MEM_FENCE);
-	
-	/*
-	 * Assuming local_id(lastBit) can go max upto 1024
-	 * After 10th iteration lastBit will be zero
-	 * So looping upto 10 iterations is enough, instead of 32
-	 */
-    uint temp = 0, lastBit = local_id;
-	for(int k=0; k < 10; k++)
+
+	uint first = get_global_id(0) * pointsPerItem;
+	if(first >= nVectors)
 	{
-		/*
-         * (lastBit & 1) gives the LSB in lastBit
-         * The loop iterates over all the bits and extracts each bit at a time
-         */
-        temp ^= (lastBit & 1) * shared[k];
-		lastBit >>= 1;
+		return;
 	}
+	uint last = min(first + pointsPerItem, nVectors);
 
-	output[global_id] = convert_float(temp) / divisor;
+	uint index = firstIndex + first;
+	uint temp = skipAhead(shared, index);
+	for(uint i = first; i < last; i++, index++)
+	{
+		output[dim * nVectors + i] = toUnit(shared, temp, owen);
+		temp = nextPoint(shared, temp, index);
+	}
 }
-
@@ -17,7 +17,13 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #ifndef SOBOL_PRIMITIVES_H
 #define SOBOL_PRIMITIVES_H
 
-#define max_m 17
+#define max_m 32
+
+/* Dimensions of the compiled-in Joe-Kuo table */
+#define SOBOL_TABLE_DIMENSIONS 10200
+
+/* Dimensions between two entries of the table index */
+#define SOBOL_INDEX_STRIDE 64
 
 /**
  * Each primitive is stored as a struct where
@@ -34,6 +40,14 @@ struct primitive
     unsigned int m[max_m];
 };
 
-extern const struct primitive sobolPrimitives[];
+/**
+ * Decodes the primitives of dimensions first .. first + count - 1.
+ * The first SOBOL_TABLE_DIMENSIONS come from the packed Joe-Kuo table,
+ * later ones from a search of the next primitive polynomials.
+ * @return number of primitives written, less than count only when the
+ *         polynomials of degree < max_m are exhausted
+ */
+unsigned int getSobolPrimitives(unsigned int first, unsigned int count,
+                                struct primitive* p);
 
 #endif
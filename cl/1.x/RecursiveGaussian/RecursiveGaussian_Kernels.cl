@@ -15,125 +15,324 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 ********************************************************************/
 
 /*
- * Transpose Kernel 
- * input image is transposed by reading the data into a block
- * and writing it to output image
+ * Image element type, selected at build time with -D RG_FORMAT=<n>.
+ * Every format is filtered as four float channels; the intermediate
+ * image between the column and the row pass is always float4.
  */
-__kernel 
-void transpose_kernel(__global uchar4 *output,
-                      __global uchar4  *input,
-                      __local  uchar4 *block,
-                      const    uint    width,
-                      const    uint    height,
-                      const    uint blockSize)
+#define RG_UCHAR 0
+#define RG_FLOAT 1
+#define RG_HALF  2
+
+#ifndef RG_FORMAT
+#define RG_FORMAT RG_UCHAR
+#endif
+
+#if RG_FORMAT == RG_HALF
+typedef half pixel_t;
+#define LOAD_PIXEL(p, i)      vload_half4((i), (p))
+#define STORE_PIXEL(p, i, v)  vstore_half4((v), (i), (p))
+#elif RG_FORMAT == RG_FLOAT
+typedef float4 pixel_t;
+#define LOAD_PIXEL(p, i)      ((p)[i])
+#define STORE_PIXEL(p, i, v)  ((p)[i] = (v))
+#else
+typedef uchar4 pixel_t;
+#define LOAD_PIXEL(p, i)      convert_float4((p)[i])
+#define STORE_PIXEL(p, i, v)  ((p)[i] = convert_uchar4_sat(v))
+#endif
+
+/**
+* Symmetric recursive filter as the sum of two second-order sections
+*   causal     : y+[i] = n[k][0] x[i] + n[k][1] x[i-1]
+*                        - d[k][0] y+[i-1] - d[k][1] y+[i-2]
+*   anticausal : y-[i] = m[k][0] s[i] + m[k][1] s[i+1] + m[k][2] s[i+2]
+*                        - d[k][0] y-[i+1] - d[k][1] y-[i+2]
+* s is the input (Deriche, output = y+ + y-) or the causal output
+* (Young-van Vliet cascade, output = y-). coefp/coefn are the steady
+* state gains of each section, used to prime the passes at the border.
+*/
+typedef struct _IIRParms
 {
-	uint globalIdx = get_global_id(0);
-	uint globalIdy = get_global_id(1);
-	
-	uint localIdx = get_local_id(0);
-	uint localIdy = get_local_id(1);
-	
-    /* copy from input to local memory */
-	block[localIdy * blockSize + localIdx] = input[globalIdy*width + globalIdx];
-
-    /* wait until the whole block is filled */
-	barrier(CLK_LOCAL_MEM_FENCE);
-
-    /* calculate the corresponding raster indices of source and target */
-	uint sourceIndex = localIdy * blockSize + localIdx;
-	uint targetIndex = globalIdy + globalIdx * height; 
-	
-	output[targetIndex] = block[sourceIndex];
-}
-
+    float n[2][2];
+    float m[2][3];
+    float d[2][2];
+    float coefp[2];
+    float coefn[2];
+    int cascade;
+} IIRParms;
 
 
-
-/*  Recursive Gaussian filter
+/*  Recursive Gaussian filter : column pass
  *  parameters:	
- *      input - pointer to input data 
- *      output - pointer to output data 
+ *      input - pointer to a batch of images
+ *      output - pointer to float4 intermediate images
  *      width  - image width
- *      iheight  - image height
- *      a0-a3, b1, b2, coefp, coefn - gaussian parameters
+ *      height  - image height
+ *      p - filter coefficients
+ *  One work-item filters one column; get_global_id(1) selects the image.
  */
-__kernel void RecursiveGaussian_kernel(__global const uchar4* input, __global uchar4* output, 
+__kernel void RecursiveGaussian_kernel(__global const pixel_t* input, __global float4* output, 
 				       const int width, const int height, 
-				       const float a0, const float a1, 
-				       const float a2, const float a3, 
-				       const float b1, const float b2, 
-				       const float coefp, const float coefn)
+				       const IIRParms p)
 {
     // compute x : current column ( kernel executes on 1 column )
-    unsigned int x = get_global_id(0);
+    int x = get_global_id(0);
+    int base = get_global_id(1) * width * height + x;
 
     if (x >= width) 
 	return;
 
-    // start forward filter pass
-    float4 xp = (float4)0.0f;  // previous input
-    float4 yp = (float4)0.0f;  // previous output
-    float4 yb = (float4)0.0f;  // previous output by 2
+    // start forward filter pass, primed with the replicated top row
+    float4 xp = LOAD_PIXEL(input, base);    // previous input
+    float4 ya = p.coefp[0] * xp;            // section 0 : previous output
+    float4 yab = ya;                        // section 0 : previous output by 2
+    float4 yb = p.coefp[1] * xp;            // section 1 : previous output
+    float4 ybb = yb;                        // section 1 : previous output by 2
 
     for (int y = 0; y < height; y++) 
     {
-	  int pos = x + y * width;
-        float4 xc = (float4)(input[pos].x, input[pos].y, input[pos].z, input[pos].w);
-        float4 yc = (a0 * xc) + (a1 * xp) - (b1 * yp) - (b2 * yb);
-	  output[pos] = (uchar4)(yc.x, yc.y, yc.z, yc.w);
-        xp = xc; 
-        yb = yp; 
-        yp = yc; 
-
+        int pos = base + y * width;
+        float4 xc = LOAD_PIXEL(input, pos);
+        float4 yc0 = (p.n[0][0] * xc) + (p.n[0][1] * xp) - (p.d[0][0] * ya) - (p.d[0][1] * yab);
+        float4 yc1 = (p.n[1][0] * xc) + (p.n[1][1] * xp) - (p.d[1][0] * yb) - (p.d[1][1] * ybb);
+        output[pos] = yc0 + yc1;
+        xp = xc;
+        yab = ya;
+        ya = yc0;
+        ybb = yb;
+        yb = yc1;
     }
 
-     barrier(CLK_GLOBAL_MEM_FENCE);
-
-
     // start reverse filter pass: ensures response is symmetrical
-    float4 xn = (float4)(0.0f);
-    float4 xa = (float4)(0.0f);
-    float4 yn = (float4)(0.0f);
-    float4 ya = (float4)(0.0f);
-
+    int last = base + (height - 1) * width;
+    float4 sn = p.cascade ? output[last] : LOAD_PIXEL(input, last);   // next input
+    float4 sa = sn;                                                  // next input by 2
+    ya = p.coefn[0] * sn;
+    yab = ya;
+    yb = p.coefn[1] * sn;
+    ybb = yb;
 
     for (int y = height - 1; y > -1; y--) 
     {
-        int pos = x + y * width;
-        float4 xc =  (float4)(input[pos].x, input[pos].y, input[pos].z, input[pos].w);
-        float4 yc = (a2 * xn) + (a3 * xa) - (b1 * yn) - (b2 * ya);
-        xa = xn; 
-        xn = xc; 
-        ya = yn; 
-        yn = yc;
-	  float4 temp = (float4)(output[pos].x, output[pos].y, output[pos].z, output[pos].w) + yc;
-	  output[pos] = (uchar4)(temp.x, temp.y, temp.z, temp.w);
+        int pos = base + y * width;
+        float4 fwd = output[pos];
+        float4 sc = p.cascade ? fwd : LOAD_PIXEL(input, pos);
+        float4 yc0 = (p.m[0][0] * sc) + (p.m[0][1] * sn) + (p.m[0][2] * sa)
+                   - (p.d[0][0] * ya) - (p.d[0][1] * yab);
+        float4 yc1 = (p.m[1][0] * sc) + (p.m[1][1] * sn) + (p.m[1][2] * sa)
+                   - (p.d[1][0] * yb) - (p.d[1][1] * ybb);
+        output[pos] = p.cascade ? yc0 + yc1 : fwd + yc0 + yc1;
+        sa = sn;
+        sn = sc;
+        yab = ya;
+        ya = yc0;
+        ybb = yb;
+        yb = yc1;
+    }
+}
+
+
+/*
+ * Causal recursion over line[first, first + count).
+ * yh holds y[i-1], y[i-2] of section 0 then of section 1, on entry and exit.
+ */
+void causalSegment(__local const float4* line, __local float4* result,
+                   const int first, const int count,
+                   float4* yh, const IIRParms* p, const int store)
+{
+    float4 xp = line[max(first - 1, 0)];
 
+    for (int i = first; i < first + count; i++)
+    {
+        float4 xc = line[i];
+        float4 yc0 = (p->n[0][0] * xc) + (p->n[0][1] * xp) - (p->d[0][0] * yh[0]) - (p->d[0][1] * yh[1]);
+        float4 yc1 = (p->n[1][0] * xc) + (p->n[1][1] * xp) - (p->d[1][0] * yh[2]) - (p->d[1][1] * yh[3]);
+        xp = xc;
+        yh[1] = yh[0];
+        yh[0] = yc0;
+        yh[3] = yh[2];
+        yh[2] = yc1;
+        if (store)
+            result[i] = yc0 + yc1;
     }
 }
 
 
+/*
+ * Anticausal recursion over line[last - count + 1, last], walking backwards.
+ * yh holds y[i+1], y[i+2] of both sections on entry and exit. With
+ * accumulate set the result is added to what is already stored
+ * (Deriche parallel form).
+ */
+void anticausalSegment(__local const float4* line, __local float4* result,
+                       const int last, const int count, const int width,
+                       float4* yh, const IIRParms* p,
+                       const int store, const int accumulate)
+{
+    float4 sn = line[min(last + 1, width - 1)];
+    float4 sa = line[min(last + 2, width - 1)];
 
+    for (int i = last; i > last - count; i--)
+    {
+        float4 sc = line[i];
+        float4 yc0 = (p->m[0][0] * sc) + (p->m[0][1] * sn) + (p->m[0][2] * sa)
+                   - (p->d[0][0] * yh[0]) - (p->d[0][1] * yh[1]);
+        float4 yc1 = (p->m[1][0] * sc) + (p->m[1][1] * sn) + (p->m[1][2] * sa)
+                   - (p->d[1][0] * yh[2]) - (p->d[1][1] * yh[3]);
+        sa = sn;
+        sn = sc;
+        yh[1] = yh[0];
+        yh[0] = yc0;
+        yh[3] = yh[2];
+        yh[2] = yc1;
+        if (store)
+            result[i] = accumulate ? result[i] + yc0 + yc1 : yc0 + yc1;
+    }
+}
 
 
+/*
+ * Serial carry across the segments of one line (run by a single work-item).
+ * On entry state holds the zero-state end values of every segment, on exit
+ * the true incoming state of every segment: e(i) = p(i-1) + M * e(i-1),
+ * where M is the 2x2 transition of each section over one segment.
+ */
+void carrySegments(__local float4* state, __local const float* carry,
+                   const int segments, const float4 border0, const float4 border1,
+                   const int reverse)
+{
+    float4 e0 = border0;
+    float4 e1 = border0;
+    float4 e2 = border1;
+    float4 e3 = border1;
 
-	 
+    for (int j = 0; j < segments; j++)
+    {
+        int i = reverse ? segments - 1 - j : j;
+        __local float4* s = state + 4 * i;
+        float4 n0 = s[0] + (carry[0] * e0) + (carry[1] * e1);
+        float4 n1 = s[1] + (carry[2] * e0) + (carry[3] * e1);
+        float4 n2 = s[2] + (carry[4] * e2) + (carry[5] * e3);
+        float4 n3 = s[3] + (carry[6] * e2) + (carry[7] * e3);
+        s[0] = e0;
+        s[1] = e1;
+        s[2] = e2;
+        s[3] = e3;
+        e0 = n0;
+        e1 = n1;
+        e2 = n2;
+        e3 = n3;
+    }
+}
 
 
+/*  Recursive Gaussian filter : row pass
+ *  parameters:	
+ *      input - float4 intermediate images from the column pass
+ *      output - pointer to the filtered batch of images
+ *      line, lineOut - local copies of one row (width elements each)
+ *      state - local segment states (4 * local size elements)
+ *      width  - image width
+ *      p - filter coefficients
+ *  One work-group filters one row in place, so no transpose is needed.
+ *  The row is cut into one segment per work-item; each segment is
+ *  filtered from a zero state, the end states are carried across the
+ *  segments serially, and each segment is then filtered again from its
+ *  true incoming state.
+ */
+__kernel void RecursiveGaussian_rows(__global const float4* input, __global pixel_t* output,
+                                     __local float4* line, __local float4* lineOut,
+                                     __local float4* state,
+                                     const int width,
+                                     const IIRParms p)
+{
+    __local float carry[8];
 
+    int lid = get_local_id(0);
+    int segments = get_local_size(0);
+    int count = width / segments;
+    int first = lid * count;
+    int last = first + count - 1;
+    int row = get_global_id(1) * width;
 
+    // stage the row in local memory with coalesced reads
+    for (int i = lid; i < width; i += segments)
+    {
+        line[i] = input[row + i];
+    }
 
+    // response of each section to a unit state after one segment
+    if (lid < 4)
+    {
+        int k = lid >> 1;
+        float h0 = (lid & 1) ? 0.0f : 1.0f;
+        float h1 = (lid & 1) ? 1.0f : 0.0f;
+        for (int i = 0; i < count; i++)
+        {
+            float yc = -(p.d[k][0] * h0) - (p.d[k][1] * h1);
+            h1 = h0;
+            h0 = yc;
+        }
+        carry[4 * k + (lid & 1)] = h0;
+        carry[4 * k + 2 + (lid & 1)] = h1;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-	
+    // forward pass
+    float4 yh[4] = {(float4)0.0f, (float4)0.0f, (float4)0.0f, (float4)0.0f};
+    causalSegment(line, lineOut, first, count, yh, &p, 0);
+    for (int k = 0; k < 4; k++)
+    {
+        state[4 * lid + k] = yh[k];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-	
+    if (lid == 0)
+    {
+        carrySegments(state, carry, segments,
+                      p.coefp[0] * line[0], p.coefp[1] * line[0], 0);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
+    for (int k = 0; k < 4; k++)
+    {
+        yh[k] = state[4 * lid + k];
+    }
+    causalSegment(line, lineOut, first, count, yh, &p, 1);
+    barrier(CLK_LOCAL_MEM_FENCE);
 
+    // reverse pass: reads the input (Deriche) or the forward result (cascade)
+    __local float4* source = p.cascade ? lineOut : line;
+    __local float4* result = p.cascade ? line : lineOut;
 
+    for (int k = 0; k < 4; k++)
+    {
+        yh[k] = (float4)0.0f;
+    }
+    anticausalSegment(source, result, last, count, width, yh, &p, 0, 0);
+    for (int k = 0; k < 4; k++)
+    {
+        state[4 * lid + k] = yh[k];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-	
+    if (lid == 0)
+    {
+        carrySegments(state, carry, segments,
+                      p.coefn[0] * source[width - 1], p.coefn[1] * source[width - 1], 1);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-	
+    for (int k = 0; k < 4; k++)
+    {
+        yh[k] = state[4 * lid + k];
+    }
+    anticausalSegment(source, result, last, count, width, yh, &p, 1, !p.cascade);
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-	
-	
\ No newline at end of file
+    // write the row back with coalesced stores
+    for (int i = lid; i < width; i += segments)
+    {
+        STORE_PIXEL(output, row + i, result[i]);
+    }
+}
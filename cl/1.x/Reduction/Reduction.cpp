@@ -71,6 +71,13 @@ Reduction::setupCL()
         }
     }
 
+#ifdef BATCH_RUNNER
+    // Context of the batch, created by the first sample that needs it
+    cl_platform_id platform = NULL;
+    int retValue = CLRuntime::getInstance().getContext(sampleArgs, dType,
+                   platform, context);
+    CHECK_ERROR(retValue, SDK_SUCCESS, "CLRuntime::getContext() failed");
+#else
     /*
      * Have a look at the available platforms and pick either
      * the AMD one if available or a reasonable default.
@@ -98,6 +105,7 @@ Reduction::setupCL()
                                       NULL,
                                       &status);
     CHECK_OPENCL_ERROR(status, "clCreateContextFromType failed.");
+#endif
 
     // getting device on which to run the sample
     status = getDevices(context, &devices, sampleArgs->deviceId,
@@ -106,11 +114,17 @@ Reduction::setupCL()
 
     // Create command queue
 
+#ifdef BATCH_RUNNER
+    status = CLRuntime::getInstance().getCommandQueue(context,
+             devices[sampleArgs->deviceId], 0, commandQueue);
+    CHECK_ERROR(status, SDK_SUCCESS, "CLRuntime::getCommandQueue() failed");
+#else
     commandQueue = clCreateCommandQueue(context,
                                         devices[sampleArgs->deviceId],
                                         0,
                                         &status);
     CHECK_OPENCL_ERROR(status, "clCreateCommandQueue failed.");
+#endif
 
     //Set device info of given cl_device_id
     retValue = deviceInfo.setDeviceInfo(devices[sampleArgs->deviceId]);
@@ -124,11 +138,11 @@ Reduction::setupCL()
     }
 
     // Create memory objects for input array
-    inputBuffer = clCreateBuffer(context,
-                                 inMemFlags,
-                                 length * sizeof(cl_uint4),
-                                 NULL,
-                                 &status);
+    inputBuffer = CREATE_BUFFER(context,
+                                inMemFlags,
+                                length * sizeof(cl_uint4),
+                                NULL,
+                                &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (inputBuffer)");
 
     // create a CL program using the kernel source
@@ -147,7 +161,11 @@ Reduction::setupCL()
         buildData.flagsFileName = std::string(sampleArgs->flags.c_str());
     }
 
+#ifdef BATCH_RUNNER
+    retValue = CLRuntime::getInstance().getProgram(context, buildData, program);
+#else
     retValue = buildOpenCLProgram(program, context, buildData);
+#endif
     CHECK_ERROR(retValue, SDK_SUCCESS, "buildOpenCLProgram() failed");
 
     // get a kernel object handle for a kernel with the given name
@@ -433,7 +451,7 @@ int Reduction::run()
     memset(outputPtr, 0, numBlocks * VECTOR_SIZE * sizeof(cl_uint));
 
     // Create memory objects for temporary output array
-    outputBuffer = clCreateBuffer(
+    outputBuffer = CREATE_BUFFER(
                        context,
                        CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
                        numBlocks * sizeof(cl_uint4),
@@ -536,10 +554,10 @@ Reduction::cleanup()
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.(program)");
 
-    status = clReleaseMemObject(inputBuffer);
+    status = RELEASE_BUFFER(inputBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(inputBuffer)");
 
-    status = clReleaseMemObject(outputBuffer);
+    status = RELEASE_BUFFER(outputBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(outputBuffer)");
 
     status = clReleaseCommandQueue(commandQueue);
@@ -564,8 +582,13 @@ Reduction::~Reduction()
     FREE(devices);
 }
 
+#ifdef BATCH_RUNNER
+static int
+runReduction(int argc, char * argv[])
+#else
 int
 main(int argc, char * argv[])
+#endif
 {
     Reduction clReduction;
 
@@ -607,3 +630,7 @@ main(int argc, char * argv[])
     clReduction.printStats();
     return SDK_SUCCESS;
 }
+
+#ifdef BATCH_RUNNER
+REGISTER_SAMPLE("Reduction", runReduction);
+#endif
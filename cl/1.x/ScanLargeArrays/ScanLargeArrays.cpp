@@ -337,47 +337,53 @@ ScanLargeArrays::bScan(cl_uint len,
 
     }
 
-    // Set appropriate arguments to the kernel
+    // Declare the kernel run, arguments are captured by the graph
+    int task = graph.addKernel("bScan " + toString(len, std::dec), bScanKernel,
+                               1, globalThreads, localThreads);
+    if(task < 0)
+    {
+        return SDK_FAILURE;
+    }
 
     // 1st argument to the kernel - outputBuffer
-    status = clSetKernelArg(
-                 bScanKernel,
+    status = graph.setArg(
+                 task,
                  0,
                  sizeof(cl_mem),
                  (void *)outputBuffer);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(outputBuffer)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(outputBuffer)");
 
     // 2nd argument to the kernel - inputBuffer
-    status = clSetKernelArg(
-                 bScanKernel,
+    status = graph.setArg(
+                 task,
                  1,
                  sizeof(cl_mem),
                  (void *)inputBuffer);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(inputBuffer)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(inputBuffer)");
 
     // 3rd argument to the kernel - local memory
-    status = clSetKernelArg(
-                 bScanKernel,
+    status = graph.setArg(
+                 task,
                  2,
                  blockSize * sizeof(cl_float),
                  NULL);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(local memory)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(local memory)");
 
     // 4th argument to the kernel - block_size
-    status = clSetKernelArg(
-                 bScanKernel,
+    status = graph.setArg(
+                 task,
                  3,
                  sizeof(cl_int),
                  &blockSize);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(blockSize)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(blockSize)");
 
     // 5th argument to the kernel - SumBuffer
-    status = clSetKernelArg(
-                 bScanKernel,
+    status = graph.setArg(
+                 task,
                  4,
                  sizeof(cl_mem),
                  blockSumBuffer);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(blockSumBuffer)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(blockSumBuffer)");
 
     if(kernelInfoBScan.localMemoryUsed > deviceInfo.localMemSize)
     {
@@ -386,21 +392,13 @@ ScanLargeArrays::bScan(cl_uint len,
         return SDK_FAILURE;
     }
 
-    // Enqueue a kernel run call
-    status = clEnqueueNDRangeKernel(
-                 commandQueue,
-                 bScanKernel,
-                 1,
-                 NULL,
-                 globalThreads,
-                 localThreads,
-                 0,
-                 NULL,
-                 NULL);
-    CHECK_OPENCL_ERROR(status,"clEnqueueNDRangeKernel failed.");
-
-    status = clFinish(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFinish failed.(commandQueue)");
+    // Waits for the previous pass of the scan
+    if(lastTask >= 0)
+    {
+        status = graph.dependsOn(task, lastTask);
+        CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::dependsOn failed.");
+    }
+    lastTask = task;
 
     return SDK_SUCCESS;
 }
@@ -429,55 +427,53 @@ ScanLargeArrays::pScan(cl_uint len,
                   "requested number of work items." << std::endl;
         return SDK_FAILURE;
     }
-    // Set appropriate arguments to the kernel
+    // Declare the kernel run, arguments are captured by the graph
+    int task = graph.addKernel("pScan " + toString(len, std::dec), pScanKernel,
+                               1, globalThreads, localThreads);
+    if(task < 0)
+    {
+        return SDK_FAILURE;
+    }
 
     // 1st argument to the kernel - outputBuffer
-    status = clSetKernelArg(
-                 pScanKernel,
+    status = graph.setArg(
+                 task,
                  0,
                  sizeof(cl_mem),
                  (void *)outputBuffer);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(outputBuffer)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(outputBuffer)");
 
     // 2nd argument to the kernel - inputBuffer
-    status = clSetKernelArg(
-                 pScanKernel,
+    status = graph.setArg(
+                 task,
                  1,
                  sizeof(cl_mem),
                  (void *)inputBuffer);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(inputBuffer)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(inputBuffer)");
 
     // 3rd argument to the kernel - local memory
-    status = clSetKernelArg(
-                 pScanKernel,
+    status = graph.setArg(
+                 task,
                  2,
                  (len+1) * sizeof(cl_float),
                  NULL);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(local memory)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(local memory)");
 
     // 4th argument to the kernel - block_size
-    status = clSetKernelArg(
-                 pScanKernel,
+    status = graph.setArg(
+                 task,
                  3,
                  sizeof(cl_int),
                  &len);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(blockSize)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(blockSize)");
 
-    // Enqueue a kernel run call
-    status = clEnqueueNDRangeKernel(
-                 commandQueue,
-                 pScanKernel,
-                 1,
-                 NULL,
-                 globalThreads,
-                 localThreads,
-                 0,
-                 NULL,
-                 NULL);
-    CHECK_OPENCL_ERROR(status,"clEnqueueNDRangeKernel failed.");
-
-    status = clFinish(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFinish failed.(commandQueue)");
+    // Waits for the previous pass of the scan
+    if(lastTask >= 0)
+    {
+        status = graph.dependsOn(task, lastTask);
+        CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::dependsOn failed.");
+    }
+    lastTask = task;
 
     return SDK_SUCCESS;
 }
@@ -501,21 +497,29 @@ ScanLargeArrays::bAddition(cl_uint len,
         return SDK_FAILURE;
     }
 
+    // Declare the kernel run, arguments are captured by the graph
+    int task = graph.addKernel("bAddition " + toString(len, std::dec),
+                               bAddKernel, 1, globalThreads, localThreads);
+    if(task < 0)
+    {
+        return SDK_FAILURE;
+    }
+
     // 1st argument to the kernel - inputBuffer
-    status = clSetKernelArg(
-                 bAddKernel,
+    status = graph.setArg(
+                 task,
                  0,
                  sizeof(cl_mem),
                  (void*)inputBuffer);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(outputBuffer)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(outputBuffer)");
 
     // 2nd argument to the kernel - outputBuffer
-    status = clSetKernelArg(
-                 bAddKernel,
+    status = graph.setArg(
+                 task,
                  1,
                  sizeof(cl_mem),
                  (void *)outputBuffer);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed.(inputBuffer)");
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::setArg failed.(inputBuffer)");
 
     if(kernelInfoBAdd.localMemoryUsed > deviceInfo.localMemSize)
     {
@@ -524,29 +528,28 @@ ScanLargeArrays::bAddition(cl_uint len,
         return SDK_FAILURE;
     }
 
-    // Enqueue a kernel run call
-    status = clEnqueueNDRangeKernel(
-                 commandQueue,
-                 bAddKernel,
-                 1,
-                 NULL,
-                 globalThreads,
-                 localThreads,
-                 0,
-                 NULL,
-                 NULL);
-    CHECK_OPENCL_ERROR(status,"clEnqueueNDRangeKernel failed.");
-
-    status = clFinish(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFinish failed.(commandQueue)");
+    // Waits for the previous pass of the scan
+    if(lastTask >= 0)
+    {
+        status = graph.dependsOn(task, lastTask);
+        CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::dependsOn failed.");
+    }
+    lastTask = task;
 
     return SDK_SUCCESS;
 }
 
 
 int
-ScanLargeArrays::runCLKernels(void)
+ScanLargeArrays::setupTaskGraph()
 {
+    int status = graph.create(context, devices[sampleArgs->deviceId],
+                              numQueues);
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::create() failed");
+
+    // The input was unmapped on commandQueue, the graph has its own queues
+    status = clFinish(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed.(commandQueue)");
 
     // Do block-wise sum
     if(bScan(length, &inputBuffer, &outputBuffer[0], &blockSumBuffer[0]))
@@ -592,6 +595,16 @@ ScanLargeArrays::runCLKernels(void)
     return SDK_SUCCESS;
 }
 
+int
+ScanLargeArrays::runCLKernels(void)
+{
+    // All passes are enqueued at once, nothing waits between them
+    int status = graph.execute();
+    CHECK_ERROR(status, SDK_SUCCESS, "TaskGraph::execute() failed");
+
+    return SDK_SUCCESS;
+}
+
 /*
 * Naive implementation of Scan
 */
@@ -640,6 +653,32 @@ int ScanLargeArrays::initialize()
     sampleArgs->AddOption(iteration_option);
     delete iteration_option;
 
+    Option* queues_option = new Option;
+    CHECK_ALLOCATION(queues_option,"Memory Allocation error.(queues_option)");
+
+    queues_option->_sVersion = "";
+    queues_option->_lVersion = "queues";
+    queues_option->_description =
+        "Number of queues of the task graph, the last one runs the transfers";
+    queues_option->_type = CA_ARG_INT;
+    queues_option->_value = &numQueues;
+
+    sampleArgs->AddOption(queues_option);
+    delete queues_option;
+
+    Option* trace_option = new Option;
+    CHECK_ALLOCATION(trace_option,"Memory Allocation error.(trace_option)");
+
+    trace_option->_sVersion = "";
+    trace_option->_lVersion = "trace";
+    trace_option->_description =
+        "Write the timeline of the task graph to this Chrome trace file";
+    trace_option->_type = CA_ARG_STRING;
+    trace_option->_value = &traceFile;
+
+    sampleArgs->AddOption(trace_option);
+    delete trace_option;
+
     return SDK_SUCCESS;
 }
 
@@ -676,6 +715,11 @@ int ScanLargeArrays::setup()
         return SDK_FAILURE;
     }
 
+    if(setupTaskGraph() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
     sampleTimer->stopTimer(timer);
     // Compute setup time
     setupTime = (double)(sampleTimer->readTimer(timer));
@@ -695,6 +739,12 @@ int ScanLargeArrays::run()
         }
     }
 
+    if(graph.wait() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+    graph.resetStats();
+
     std::cout << "Executing kernel for " <<
               iterations << " iterations" << std::endl;
     std::cout << "-------------------------------------------" <<
@@ -714,10 +764,25 @@ int ScanLargeArrays::run()
         }
     }
 
+    // Iterations follow each other on the device, the host waits once
+    if(graph.wait() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
     sampleTimer->stopTimer(timer);
     // Compute kernel time
     kernelTime = (double)(sampleTimer->readTimer(timer));
 
+    if(!traceFile.empty())
+    {
+        if(graph.writeTrace(traceFile) != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+        std::cout << "Task graph trace written to " << traceFile << std::endl;
+    }
+
     return SDK_SUCCESS;
 }
 
@@ -800,6 +865,7 @@ void ScanLargeArrays::printStats()
         stats[3]  = toString((length / avgTime), std::dec);
 
         printStatistics(strArray, stats, 4);
+        graph.printStats();
     }
 }
 
@@ -809,6 +875,11 @@ ScanLargeArrays::cleanup()
     // Releases OpenCL resources (Context, Memory etc.)
     cl_int status;
 
+    if(graph.release() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
     status = clReleaseKernel(pScanKernel);
     CHECK_OPENCL_ERROR(status,"clReleaseProgram failed.(pScanKernel))");
 
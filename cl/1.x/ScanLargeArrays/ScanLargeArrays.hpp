@@ -23,6 +23,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <assert.h>
 #include <string.h>
 #include "CLUtil.hpp"
+#include "TaskGraph.hpp"
 
 
 #ifndef max
@@ -73,6 +74,10 @@ class ScanLargeArrays
         SDKDeviceInfo deviceInfo;/**< Structure to store device information*/
         KernelWorkGroupInfo kernelInfoBScan, kernelInfoBAdd,
                             kernelInfoPScan;/**< Structure to store kernel related info */
+        TaskGraph           graph;                  /**< Scan passes and their dependencies */
+        int                 lastTask;               /**< Task the next pass depends on */
+        int                 numQueues;              /**< Queues of the task graph */
+        std::string         traceFile;              /**< Chrome trace of the graph */
 
         SDKTimer *sampleTimer;      /**< SDKTimer object */
 
@@ -99,6 +104,8 @@ class ScanLargeArrays
             kernelTime = 0;
             setupTime = 0;
             iterations = 1;
+            lastTask = -1;
+            numQueues = 1;
         }
 
         /**
@@ -123,15 +130,20 @@ class ScanLargeArrays
         int setupCL();
 
         /**
-        * Set values for kernels' arguments, enqueue calls to the kernels
-        * on to the command queue, wait till end of kernel execution.
-        * Get kernel start and end time if timing is enabled
+        * Declares every pass of the scan in the task graph, each one
+        * depending on the previous
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int setupTaskGraph();
+
+        /**
+        * Enqueues one scan of the whole array without waiting for it
         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
         */
         int runCLKernels();
 
         /**
-        * Enqueue bScan Kernel
+        * Adds a bScan Kernel task
         * Scans the inputBuffer block-wise and stores scanned elements in outputBuffer
         * and sum of blocks in blockSumBuffer
         * @param len size of input buffer
@@ -146,7 +158,7 @@ class ScanLargeArrays
                   cl_mem *blockSumBuffer);
 
         /**
-        * Enqueue pScan Kernel
+        * Adds a pScan Kernel task
         * Basic prefix sum
         * @param len size of input buffer
         * @param inputBuffer input buffer
@@ -158,7 +170,7 @@ class ScanLargeArrays
                   cl_mem *outputBuffer);
 
         /**
-        * Enqueue bAddition Kernel
+        * Adds a bAddition Kernel task
         * Elements of inputBuffer are added block-wise to outputBuffer
         * @param len size of output buffer
         * @param inputBuffer input buffer
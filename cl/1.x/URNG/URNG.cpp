@@ -18,17 +18,6 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "URNG.hpp"
 #include <cmath>
 
-#define IA 16807                // a
-#define IM 2147483647           // m
-#define AM (1.0 / IM)           // 1 / m - To calculate floating point result
-#define IQ 127773
-#define IR 2836
-#define NTAB 1
-#define NDIV (1 + (IM - 1) / NTAB)
-#define EPS 1.2e-7
-#define RMAX (1.0 - EPS)
-
-
 
 int
 URNG::readInputImage(std::string inputImageName)
@@ -101,7 +90,7 @@ URNG::genBinaryImage()
 {
     bifData binaryData;
     binaryData.kernelName = std::string("URNG_Kernels.cl");
-    binaryData.flagsStr = std::string("");
+    binaryData.flagsStr = std::string("-I.");
     if(sampleArgs->isComplierFlagsSpecified())
     {
         binaryData.flagsFileName = std::string(sampleArgs->flags.c_str());
@@ -209,12 +198,20 @@ URNG::setupCL()
                                        &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (outputImageBuffer)");
 
+    // Create memory object for the bulk fill
+    fillBuffer = clCreateBuffer(context,
+                                CL_MEM_WRITE_ONLY,
+                                fillBytes,
+                                NULL,
+                                &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (fillBuffer)");
+
     // create a CL program using the kernel source
     buildProgramData buildData;
     buildData.kernelName = std::string("URNG_Kernels.cl");
     buildData.devices = devices;
     buildData.deviceId = sampleArgs->deviceId;
-    buildData.flagsStr = std::string("");
+    buildData.flagsStr = std::string("-I.");
     if(sampleArgs->isLoadBinaryEnabled())
     {
         buildData.binaryName = std::string(sampleArgs->loadBinary.c_str());
@@ -259,6 +256,22 @@ URNG::setupCL()
             blockSizeY = 1;
         }
     }
+
+    // get a kernel object handle for the bulk fill of the selected distribution
+    const char* fillKernelNames[] = {"fill_bits", "fill_uniform", "fill_normal", "fill_sobol"};
+    fillKernel = clCreateKernel(program, fillKernelNames[distribution], &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed. (fillKernel)");
+
+    status =  kernelInfo.setKernelWorkGroupInfo(fillKernel,
+              devices[sampleArgs->deviceId]);
+    CHECK_ERROR(status, SDK_SUCCESS, "setKernelWorkGroupInfo() failed");
+
+    if(GROUP_SIZE > kernelInfo.kernelWorkGroupSize)
+    {
+        std::cout << "Max Group Size supported on the fill kernel : "
+                  << kernelInfo.kernelWorkGroupSize << std::endl;
+        return SDK_FAILURE;
+    }
     return SDK_SUCCESS;
 }
 
@@ -301,6 +314,13 @@ URNG::runCLKernels()
     status = clSetKernelArg(kernel, 2, sizeof(factor), &factor);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (factor)");
 
+    // generator key
+    status = clSetKernelArg(kernel, 3, sizeof(cl_uint2), &seedPair);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (seed)");
+
+    status = clSetKernelArg(kernel, 4, sizeof(cl_uint), &generator);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (generator)");
+
     // Enqueue a kernel run call.
     size_t globalThreads[] = {width, height};
     size_t localThreads[] = {blockSizeX, blockSizeY};
@@ -347,6 +367,114 @@ URNG::runCLKernels()
     return SDK_SUCCESS;
 }
 
+int
+URNG::runFillKernel()
+{
+    cl_int status;
+
+    status = clSetKernelArg(fillKernel, 0, sizeof(cl_mem), &fillBuffer);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (fillBuffer)");
+
+    if(distribution == DIST_SOBOL)
+    {
+        cl_uint firstPoint = (cl_uint)skip;
+        cl_uint dims = SOBOL_DIMS;
+        status = clSetKernelArg(fillKernel, 1, sizeof(cl_uint), &firstPoint);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (firstPoint)");
+
+        status = clSetKernelArg(fillKernel, 2, sizeof(cl_uint), &dims);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (dims)");
+    }
+    else
+    {
+        cl_uint stream = 1;
+        cl_ulong firstBlock = (cl_ulong)skip;
+        status = clSetKernelArg(fillKernel, 1, sizeof(cl_uint2), &seedPair);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (seed)");
+
+        status = clSetKernelArg(fillKernel, 2, sizeof(cl_uint), &stream);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (stream)");
+
+        status = clSetKernelArg(fillKernel, 3, sizeof(cl_ulong), &firstBlock);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (firstBlock)");
+
+        status = clSetKernelArg(fillKernel, 4, sizeof(cl_uint), &generator);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed. (generator)");
+    }
+
+    size_t globalThreads = numBlocks;
+    size_t localThreads = GROUP_SIZE;
+
+    cl_event ndrEvt;
+    status = clEnqueueNDRangeKernel(
+                 commandQueue,
+                 fillKernel,
+                 1,
+                 NULL,
+                 &globalThreads,
+                 &localThreads,
+                 0,
+                 NULL,
+                 &ndrEvt);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed. (fillKernel)");
+
+    status = clFlush(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFlush failed.");
+
+    status = waitForEventAndRelease(&ndrEvt);
+    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
+
+    return SDK_SUCCESS;
+}
+
+int
+URNG::runFill()
+{
+    cl_int status;
+
+    // Warm up
+    if(runFillKernel() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
+    int timer = sampleTimer->createTimer();
+    sampleTimer->resetTimer(timer);
+    sampleTimer->startTimer(timer);
+
+    for(int i = 0; i < iterations; i++)
+    {
+        if(runFillKernel() != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+    }
+
+    sampleTimer->stopTimer(timer);
+    fillTime = (double)(sampleTimer->readTimer(timer)) / iterations;
+
+    cl_event readEvt;
+    status = clEnqueueReadBuffer(
+                 commandQueue,
+                 fillBuffer,
+                 CL_FALSE,
+                 0,
+                 fillBytes,
+                 fillOutput,
+                 0,
+                 NULL,
+                 &readEvt);
+    CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed. (fillBuffer)");
+
+    status = clFlush(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFlush failed.");
+
+    status = waitForEventAndRelease(&readEvt);
+    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(readEvt) Failed");
+
+    return SDK_SUCCESS;
+}
+
 int
 URNG::initialize()
 {
@@ -383,6 +511,73 @@ URNG::initialize()
 
     delete factor_option;
 
+    Option* numbers_option = new Option;
+    CHECK_ALLOCATION(numbers_option, "Memory Allocation error.\n");
+
+    numbers_option->_sVersion = "n";
+    numbers_option->_lVersion = "numbers";
+    numbers_option->_description = "Random numbers generated by the bulk fill";
+    numbers_option->_type = CA_ARG_INT;
+    numbers_option->_value = &numbers;
+
+    sampleArgs->AddOption(numbers_option);
+
+    delete numbers_option;
+
+    Option* distribution_option = new Option;
+    CHECK_ALLOCATION(distribution_option, "Memory Allocation error.\n");
+
+    distribution_option->_sVersion = "D";
+    distribution_option->_lVersion = "distribution";
+    distribution_option->_description =
+        "Bulk fill distribution : bits, uniform, normal or sobol";
+    distribution_option->_type = CA_ARG_STRING;
+    distribution_option->_value = &distributionName;
+
+    sampleArgs->AddOption(distribution_option);
+
+    delete distribution_option;
+
+    Option* generator_option = new Option;
+    CHECK_ALLOCATION(generator_option, "Memory Allocation error.\n");
+
+    generator_option->_sVersion = "g";
+    generator_option->_lVersion = "generator";
+    generator_option->_description = "Counter-based generator : philox or threefry";
+    generator_option->_type = CA_ARG_STRING;
+    generator_option->_value = &generatorName;
+
+    sampleArgs->AddOption(generator_option);
+
+    delete generator_option;
+
+    Option* seed_option = new Option;
+    CHECK_ALLOCATION(seed_option, "Memory Allocation error.\n");
+
+    seed_option->_sVersion = "s";
+    seed_option->_lVersion = "seed";
+    seed_option->_description = "Seed of the random streams";
+    seed_option->_type = CA_ARG_INT;
+    seed_option->_value = &seed;
+
+    sampleArgs->AddOption(seed_option);
+
+    delete seed_option;
+
+    Option* skip_option = new Option;
+    CHECK_ALLOCATION(skip_option, "Memory Allocation error.\n");
+
+    skip_option->_sVersion = "k";
+    skip_option->_lVersion = "skip";
+    skip_option->_description =
+        "Skip-ahead of the bulk fill (blocks of 4 numbers, or Sobol points)";
+    skip_option->_type = CA_ARG_INT;
+    skip_option->_value = &skip;
+
+    sampleArgs->AddOption(skip_option);
+
+    delete skip_option;
+
     return SDK_SUCCESS;
 }
 
@@ -394,6 +589,64 @@ URNG::setup()
     status = readInputImage(INPUT_IMAGE);
     CHECK_ERROR(status, SDK_SUCCESS, "Read Input Image Failed");
 
+    if(distributionName == "bits")
+    {
+        distribution = DIST_BITS;
+    }
+    else if(distributionName == "uniform")
+    {
+        distribution = DIST_UNIFORM;
+    }
+    else if(distributionName == "normal")
+    {
+        distribution = DIST_NORMAL;
+    }
+    else if(distributionName == "sobol")
+    {
+        distribution = DIST_SOBOL;
+    }
+    else
+    {
+        std::cout << "Unknown distribution : " << distributionName << std::endl;
+        return SDK_FAILURE;
+    }
+
+    if(generatorName == "philox")
+    {
+        generator = CRNG_PHILOX;
+    }
+    else if(generatorName == "threefry")
+    {
+        generator = CRNG_THREEFRY;
+    }
+    else
+    {
+        std::cout << "Unknown generator : " << generatorName << std::endl;
+        return SDK_FAILURE;
+    }
+
+    if(numbers <= 0 || skip < 0)
+    {
+        std::cout << "numbers should be positive and skip non-negative" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    seedPair.s[0] = (cl_uint)seed;
+    seedPair.s[1] = 0;
+
+    // One work-item writes one block of 4 numbers, or one Sobol point
+    size_t perItem = (distribution == DIST_SOBOL) ? SOBOL_DIMS : 4;
+    numBlocks = (numbers + perItem - 1) / perItem;
+    numBlocks = ((numBlocks + GROUP_SIZE - 1) / GROUP_SIZE) * GROUP_SIZE;
+    fillBytes = numBlocks * perItem * sizeof(cl_uint);
+    numbers = (int)(numBlocks * perItem);
+
+    fillOutput = (cl_uint*)malloc(fillBytes);
+    CHECK_ALLOCATION(fillOutput, "Failed to allocate host memory. (fillOutput)");
+
+    fillReference = (cl_uint*)malloc(fillBytes);
+    CHECK_ALLOCATION(fillReference, "Failed to allocate host memory. (fillReference)");
+
     // create and initialize timers
     int timer = sampleTimer->createTimer();
     sampleTimer->resetTimer(timer);
@@ -456,6 +709,23 @@ URNG::run()
     status = writeOutputImage(OUTPUT_IMAGE);
     CHECK_ERROR(status , SDK_SUCCESS, "Write Output Image");
 
+    // Bulk fill benchmark
+    if(runFill() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
+    sampleTimer->resetTimer(timer);
+    sampleTimer->startTimer(timer);
+
+    for(int i = 0; i < iterations; i++)
+    {
+        fillCPUReference();
+    }
+
+    sampleTimer->stopTimer(timer);
+    hostFillTime = (double)(sampleTimer->readTimer(timer)) / iterations;
+
     return SDK_SUCCESS;
 }
 
@@ -473,6 +743,9 @@ URNG::cleanup()
     status = clReleaseKernel(kernel);
     CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.");
 
+    status = clReleaseKernel(fillKernel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed. (fillKernel)");
+
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.");
 
@@ -482,6 +755,9 @@ URNG::cleanup()
     status = clReleaseMemObject(outputImageBuffer);
     CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
 
+    status = clReleaseMemObject(fillBuffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed. (fillBuffer)");
+
     status = clReleaseCommandQueue(commandQueue);
     CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.");
 
@@ -492,6 +768,8 @@ URNG::cleanup()
     FREE(inputImageData);
     FREE(outputImageData);
     FREE(verificationOutput);
+    FREE(fillOutput);
+    FREE(fillReference);
     FREE(devices);
     return SDK_SUCCESS;
 }
@@ -501,6 +779,46 @@ URNG::cleanup()
 void
 URNG::URNGCPUReference()
 {
+    CRNGPair key = {{seedPair.s[0], seedPair.s[1]}};
+
+    for(cl_uint pos = 0; pos < width * height; pos++)
+    {
+        CRNGBlock r = crngStreamBlock(generator, key, 0u, pos);
+        float dev = (crngUniform(r.v[0]) - 0.5f) * (float)factor;
+
+        for(int c = 0; c < 4; c++)
+        {
+            // convert_uchar4_sat : clamp, then round towards zero
+            float value = (float)inputImageData[pos].s[c] + dev;
+            value = (value < 0.0f) ? 0.0f : ((value > 255.0f) ? 255.0f : value);
+            verificationOutput[pos].s[c] = (cl_uchar)value;
+        }
+    }
+}
+
+void
+URNG::fillCPUReference()
+{
+    CRNGPair key = {{seedPair.s[0], seedPair.s[1]}};
+    const cl_uint stream = 1;
+
+    switch(distribution)
+    {
+    case DIST_BITS:
+        crngFillBits(generator, key, stream, (crng_ulong)skip, numBlocks, fillReference);
+        break;
+    case DIST_UNIFORM:
+        crngFillUniform(generator, key, stream, (crng_ulong)skip, numBlocks,
+                        (float*)fillReference);
+        break;
+    case DIST_NORMAL:
+        crngFillNormal(generator, key, stream, (crng_ulong)skip, numBlocks,
+                       (float*)fillReference);
+        break;
+    default:
+        crngFillSobol((unsigned int)skip, numBlocks, SOBOL_DIMS, (float*)fillReference);
+        break;
+    }
 }
 
 
@@ -509,23 +827,27 @@ URNG::verifyResults()
 {
     if(sampleArgs->verify)
     {
-        float mean = 0;
-        for(int i = 0; i < (int)(width * height); i++)
+        URNGCPUReference();
+
+        // Host and device use the same generator : outputs match bit for bit
+        if(memcmp(outputImageData, verificationOutput, width * height * pixelSize) != 0)
         {
-            mean += outputImageData[i].s[0] - inputImageData[i].s[0];
+            std::cout << "Failed! (noise image)\n" << std::endl;
+            return SDK_FAILURE;
         }
-        mean /= (width * height * factor);
 
-        if(fabs(mean) < 1.0)
+        if(memcmp(fillOutput, fillReference, fillBytes) != 0)
         {
-            std::cout << "Passed! \n" << std::endl;
-            return SDK_SUCCESS;
+            std::cout << "Failed! (bulk fill)\n" << std::endl;
+            return SDK_FAILURE;
         }
-        else
+
+        if(!sampleArgs->quiet)
         {
-            std::cout << "Failed! \n" << std::endl;
-            return SDK_FAILURE;
+            printArray<cl_uint>("Bulk fill (raw bits)", fillOutput, 8, 1);
         }
+
+        std::cout << "Passed! \n" << std::endl;
     }
     return SDK_SUCCESS;
 }
@@ -533,14 +855,18 @@ URNG::verifyResults()
 void
 URNG::printStats()
 {
-    std::string strArray[4] =
+    std::string strArray[8] =
     {
         "Width",
         "Height",
         "Time(sec)",
-        "[Transfer+kernel]Time(sec)"
+        "[Transfer+kernel]Time(sec)",
+        "Generator",
+        "Numbers",
+        "Fill GB/s",
+        "Host SIMD GB/s"
     };
-    std::string stats[4];
+    std::string stats[8];
 
     sampleTimer->totalTime = setupTime + kernelTime;
 
@@ -548,10 +874,15 @@ URNG::printStats()
     stats[1] = toString(height, std::dec);
     stats[2] = toString(sampleTimer->totalTime, std::dec);
     stats[3] = toString(kernelTime, std::dec);
+    stats[4] = (distribution == DIST_SOBOL) ? std::string("sobol") :
+               generatorName + " " + distributionName;
+    stats[5] = toString(numbers, std::dec);
+    stats[6] = toString(fillBytes / fillTime / 1e9, std::dec);
+    stats[7] = toString(fillBytes / hostFillTime / 1e9, std::dec);
 
     if(sampleArgs->timing)
     {
-        printStatistics(strArray, stats, 4);
+        printStatistics(strArray, stats, 8);
     }
 }
 
@@ -23,6 +23,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <string.h>
 #include "CLUtil.hpp"
 #include "SDKBitMap.hpp"
+#include "CounterRNG.h"
 
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.2"
 
@@ -31,6 +32,14 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #define GROUP_SIZE 64
 #define FACTOR 25
+#define FILL_NUMBERS (1 << 24)
+#define SOBOL_DIMS CRNG_SOBOL_DIMENSIONS
+
+/* Distributions of the bulk fill benchmark */
+#define DIST_BITS 0
+#define DIST_UNIFORM 1
+#define DIST_NORMAL 2
+#define DIST_SOBOL 3
 
 using namespace appsdk;
 
@@ -54,6 +63,22 @@ class URNG
         cl_command_queue commandQueue;      /**< CL command queue */
         cl_program program;                 /**< CL program  */
         cl_kernel kernel;                   /**< CL kernel */
+        cl_kernel fillKernel;               /**< CL kernel for the bulk fill */
+        cl_mem fillBuffer;                  /**< CL memory buffer for the bulk fill */
+        cl_uint* fillOutput;                /**< Bulk fill output read back from device */
+        cl_uint* fillReference;             /**< Bulk fill output of the host SIMD path */
+        int numbers;                        /**< Numbers generated by the bulk fill */
+        size_t numBlocks;                   /**< Work-items of the bulk fill */
+        size_t fillBytes;                   /**< Size of the bulk fill output */
+        std::string distributionName;       /**< bits, uniform, normal or sobol */
+        std::string generatorName;          /**< philox or threefry */
+        int distribution;                   /**< DIST_* value of distributionName */
+        int generator;                      /**< CRNG_PHILOX or CRNG_THREEFRY */
+        int seed;                           /**< Seed of all streams */
+        int skip;                           /**< Blocks skipped ahead by the bulk fill */
+        cl_uint2 seedPair;                  /**< 64-bit key passed to the kernels */
+        cl_double fillTime;                 /**< Time of one bulk fill kernel */
+        cl_double hostFillTime;             /**< Time of one host SIMD bulk fill */
         SDKBitMap inputBitmap;   /**< Bitmap class object */
         uchar4* pixelData;       /**< Pointer to image data */
         cl_uint pixelSize;                  /**< Size of a pixel in BMP format> */
@@ -106,6 +131,17 @@ class URNG
             blockSizeY = 1;
             iterations = 1;
             factor = FACTOR;
+            fillOutput = NULL;
+            fillReference = NULL;
+            numbers = FILL_NUMBERS;
+            distributionName = "uniform";
+            generatorName = "philox";
+            distribution = DIST_UNIFORM;
+            generator = CRNG_PHILOX;
+            seed = 1;
+            skip = 0;
+            fillTime = 0;
+            hostFillTime = 0;
         }
 
         ~URNG()
@@ -142,8 +178,25 @@ class URNG
         int runCLKernels();
 
         /**
-        * Reference CPU implementation of Binomial Option
-        * for performance comparison
+        * Run the bulk fill kernel once
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int runFillKernel();
+
+        /**
+        * Time the bulk fill kernel and read its output back
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int runFill();
+
+        /**
+        * Host SIMD bulk fill of the same numbers into fillReference
+        */
+        void fillCPUReference();
+
+        /**
+        * Reference CPU implementation of the noise filter
+        * computing the bitwise expected output image
         */
         void URNGCPUReference();
 
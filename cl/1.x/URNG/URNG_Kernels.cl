@@ -15,75 +15,88 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 ********************************************************************/
 
 
-#define IA 16807    			// a
-#define IM 2147483647 			// m
-#define AM (1.0f/IM) 			// 1/m - To calculate floating point result
-#define IQ 127773 
-#define IR 2836
-#define NTAB 16
-#define NDIV (1 + (IM - 1)/ NTAB)
-#define EPS 1.2e-7
-#define RMAX (1.0f - EPS)
-#define GROUP_SIZE 64
-
-
-
-/* Generate uniform random deviation */
-/* Park-Miller with Bays-Durham shuffle and added safeguards
-   Returns a uniform random deviate between (-FACTOR/2, FACTOR/2)
-   input seed should be negative */ 
-float ran1(int idum, __local int *iv)
+#define _OCL_CODE_
+#include "CounterRNG.h"
+
+/*
+ * All kernels draw from the counter-based generators in CounterRNG.h.
+ * A value only depends on (generator, seed, stream, index), so every
+ * work-item computes its own numbers without any state or shuffle table
+ * and the host reproduces them bit for bit.
+ */
+
+__kernel void noise_uniform(__global uchar4* inputImage, __global uchar4* outputImage, int factor,
+                            uint2 seed, uint generator)
 {
-    int j;
-    int k;
-    int iy = 0;
-    int tid = get_local_id(0) + get_local_id(1) * get_local_size(0);
+    int pos = get_global_id(0) + get_global_id(1) * get_global_size(0);
 
-    for(j = NTAB; j >=0; j--)			//Load the shuffle
-    {
-        k = idum / IQ;
-        idum = IA * (idum - k * IQ) - IR * k;
-
-        if(idum < 0)
-            idum += IM;
-
-        if(j < NTAB)
-            iv[NTAB* tid + j] = idum;
-    }
-    iy = iv[NTAB* tid];
+    float4 temp = convert_float4(inputImage[pos]);
 
-    k = idum / IQ;
-    idum = IA * (idum - k * IQ) - IR * k;
+    CRNGPair key;
+    key.v[0] = seed.x;
+    key.v[1] = seed.y;
 
-    if(idum < 0)
-        idum += IM;
+    /* One block per pixel of stream 0 : uniform deviation in (-factor/2, factor/2) */
+    CRNGBlock r = crngStreamBlock(generator, key, 0u, (ulong)pos);
+    float dev = (crngUniform(r.v[0]) - 0.5f) * (float)factor;
 
-    j = iy / NDIV;
-    iy = iv[NTAB * tid + j];
-    return (AM * iy);	//AM *iy will be between 0.0 and 1.0
+    /* Saturate(clamp) the values */
+    outputImage[pos] = convert_uchar4_sat(temp + (float4)(dev));
 }
 
+/*
+ * Bulk fill kernels : work-item i writes block (firstBlock + i) of 'stream',
+ * i.e. four consecutive numbers. firstBlock is the skip-ahead offset.
+ */
+__kernel void fill_bits(__global uint4* output, uint2 seed, uint stream, ulong firstBlock,
+                        uint generator)
+{
+    size_t gid = get_global_id(0);
+
+    CRNGPair key;
+    key.v[0] = seed.x;
+    key.v[1] = seed.y;
 
+    CRNGBlock r = crngStreamBlock(generator, key, stream, firstBlock + gid);
+    output[gid] = (uint4)(r.v[0], r.v[1], r.v[2], r.v[3]);
+}
 
-__kernel void noise_uniform(__global uchar4* inputImage, __global uchar4* outputImage, int factor)
+__kernel void fill_uniform(__global float4* output, uint2 seed, uint stream, ulong firstBlock,
+                           uint generator)
 {
-	int pos = get_global_id(0) + get_global_id(1) * get_global_size(0);
+    size_t gid = get_global_id(0);
 
-	float4 temp = convert_float4(inputImage[pos]);
+    CRNGPair key;
+    key.v[0] = seed.x;
+    key.v[1] = seed.y;
 
-	/* compute average value of a pixel from its compoments */
-	float avg = (temp.x + temp.y + temp.z + temp.y) / 4;
+    CRNGBlock r = crngStreamBlock(generator, key, stream, firstBlock + gid);
+    output[gid] = (float4)(crngUniform(r.v[0]), crngUniform(r.v[1]),
+                           crngUniform(r.v[2]), crngUniform(r.v[3]));
+}
 
-	/* Each thread has NTAB private values */
-	/* Local memory is used as indexed arrays use global memory instead of registers */
-	__local int iv[NTAB * GROUP_SIZE];  
+__kernel void fill_normal(__global float4* output, uint2 seed, uint stream, ulong firstBlock,
+                          uint generator)
+{
+    size_t gid = get_global_id(0);
 
-	/* Calculate deviation from the avg value of a pixel */
-	float dev = ran1(-avg, iv);
-	dev = (dev - 0.55f) * factor;
+    CRNGPair key;
+    key.v[0] = seed.x;
+    key.v[1] = seed.y;
 
-	/* Saturate(clamp) the values */
-	outputImage[pos] = convert_uchar4_sat(temp + (float4)(dev));
+    CRNGBlock r = crngStreamBlock(generator, key, stream, firstBlock + gid);
+    CRNGFloat2 z0 = crngBoxMuller(r.v[0], r.v[1]);
+    CRNGFloat2 z1 = crngBoxMuller(r.v[2], r.v[3]);
+    output[gid] = (float4)(z0.v[0], z0.v[1], z1.v[0], z1.v[1]);
+}
 
-	
+/* Sobol points : work-item i writes all 'dims' coordinates of point (firstPoint + i) */
+__kernel void fill_sobol(__global float* output, uint firstPoint, uint dims)
+{
+    uint gid = get_global_id(0);
+
+    for(uint d = 0; d < dims; ++d)
+    {
+        output[gid * dims + d] = crngUniform(crngSobol(firstPoint + gid, d));
+    }
 }
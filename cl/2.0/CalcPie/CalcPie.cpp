@@ -16,23 +16,80 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 
 #include "CalcPie.hpp"
+#include <iomanip>
+
+static const char* reductionNames[PIE_REDUCTIONS] =
+{
+    "atomics", "group", "tree"
+};
 
 int CalcPie::setupCalcPie()
 {
-    // allocate and init memory used by host
-    cl_uint sizeBytes = length * sizeof(cl_float);
+    cl_int status;
+
+    // --samples takes an integer or a float such as 1e12
+    if(!samplesStr.empty())
+    {
+        char *end = NULL;
+        double value = strtod(samplesStr.c_str(), &end);
+        if(end == samplesStr.c_str() || *end != '\0' || value < 1 || value > 1e18)
+        {
+            std::cout << "Invalid number of samples : " << samplesStr << std::endl;
+            return SDK_FAILURE;
+        }
+        samples = (cl_ulong)(value + 0.5);
+    }
 
-    randomX = (cl_float *) malloc(sizeBytes);
-    CHECK_ALLOCATION(randomX, "Failed to allocate host memory. (input)");
+    if(chunkSamples < 1 || chunkSamples >= PIE_MAX_CHUNK || perItem < 1)
+    {
+        std::cout << "Chunk should be in [1, " << PIE_MAX_CHUNK
+                  << ") and samples per work-item at least 1" << std::endl;
+        return SDK_FAILURE;
+    }
 
-    randomY = (cl_float *) malloc(sizeBytes);
-    CHECK_ALLOCATION(randomY, "Failed to allocate host memory. (input)");
+    if(reductionName != "all")
+    {
+        bool found = false;
+        for(int r = 0; r < PIE_REDUCTIONS; r++)
+        {
+            enabled[r] = (reductionName == reductionNames[r]);
+            found = found || enabled[r];
+        }
+        if(!found)
+        {
+            std::cout << "Unknown reduction : " << reductionName
+                      << " (expected atomics, group, tree or all)" << std::endl;
+            return SDK_FAILURE;
+        }
+    }
 
-    // random initialisation of input
-    for (cl_uint i=0;i<length;i++) {
-		randomX[i] = (float)rand()/(float)RAND_MAX;
-		randomY[i] = (float)rand()/(float)RAND_MAX;
+    // Every chunk keeps its own 32-bit count, the host adds them in 64 bits
+    cl_ulong chunks = (samples + chunkSamples - 1) / chunkSamples;
+    if(chunks > PIE_MAX_CHUNK)
+    {
+        std::cout << "Too many chunks, increase --chunk" << std::endl;
+        return SDK_FAILURE;
     }
+    numChunks = (cl_uint)chunks;
+
+    size_t items = (chunkSamples + perItem - 1) / perItem;
+    maxGroups = (items + groupSize - 1) / groupSize;
+
+    countsBuffer = clCreateBuffer(
+                      context,
+                      CL_MEM_READ_WRITE,
+                      sizeof(cl_uint) * numChunks,
+                      NULL,
+                      &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (countsBuffer)");
+
+    partialsBuffer = clCreateBuffer(
+                      context,
+                      CL_MEM_READ_WRITE,
+                      sizeof(cl_uint) * maxGroups,
+                      NULL,
+                      &status);
+    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (partialsBuffer)");
 
     return SDK_SUCCESS;
 }
@@ -144,110 +201,168 @@ CalcPie::setupCL(void)
     retValue = buildOpenCLProgram(program, context, buildData);
     CHECK_ERROR(retValue, SDK_SUCCESS, "buildOpenCLProgram() failed");
 
-    // get a kernel object handle for a kernel with the given name
-    calc_pie_kernel = clCreateKernel(program, "calc_pie_kernel", &status);
-    CHECK_OPENCL_ERROR(status, "clCreateKernel::calc_pie_kernel failed.");
+    // get a kernel object handle for every reduction
+    const char* kernelNames[PIE_REDUCTIONS] =
+    {
+        "pie_global_atomics", "pie_group_atomic", "pie_tree_partials"
+    };
 
-    /* get default work group size */
-    status =  kernelInfo.setKernelWorkGroupInfo(calc_pie_kernel,
-              devices[sampleArgs->deviceId]);
-    CHECK_ERROR(status, SDK_SUCCESS, "setKErnelWorkGroupInfo() failed");
+    for(int r = 0; r < PIE_REDUCTIONS; r++)
+    {
+        reductionKernel[r] = clCreateKernel(program, kernelNames[r], &status);
+        CHECK_OPENCL_ERROR(status, "clCreateKernel failed.(reductionKernel)");
+    }
 
-    randomXBuffer = clCreateBuffer(
-                      context,
-                      CL_MEM_READ_ONLY,
-                      sizeof(cl_float) * length,
-                      NULL,
-                      &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (randomBuffer)");
+    treeFinalKernel = clCreateKernel(program, "pie_tree_final", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel::pie_tree_final failed.");
 
-    randomYBuffer = clCreateBuffer(
-                      context,
-                      CL_MEM_READ_ONLY,
-                      sizeof(cl_float) * length,
-                      NULL,
-                      &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (randomBuffer)");
+    /* one work-group size that suits every kernel */
+    groupSize = PIE_GROUP_SIZE;
+    for(int r = 0; r <= PIE_REDUCTIONS; r++)
+    {
+        status =  kernelInfo.setKernelWorkGroupInfo(
+                      r < PIE_REDUCTIONS ? reductionKernel[r] : treeFinalKernel,
+                      devices[sampleArgs->deviceId]);
+        CHECK_ERROR(status, SDK_SUCCESS, "setKErnelWorkGroupInfo() failed");
 
-    insideBuffer = clCreateBuffer(
-                      context,
-                      CL_MEM_READ_WRITE,
-                      sizeof(cl_int),
-                      NULL,
-                      &status);
-    CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (insideBuffer)");
+        if(kernelInfo.kernelWorkGroupSize < groupSize)
+        {
+            groupSize = kernelInfo.kernelWorkGroupSize;
+        }
+    }
 
     return SDK_SUCCESS;
 }
 
 int
-CalcPie::runCalcPieKernel()
+CalcPie::runCalcPieKernel(int reduction, cl_uint chunk, cl_uint count)
 {
-    size_t dataSize      = length;
-    size_t localThreads  = kernelInfo.kernelWorkGroupSize;
-    size_t globalThreads = dataSize;
-    cl_event writeEvt;
-
-    // Set appropriate arguments to the kernel
-    // 1st argument to the kernel - randomBuffer
-    int status = clSetKernelArg(
-				calc_pie_kernel,
-				0,
-				sizeof(cl_mem),
-				(void *)&randomXBuffer);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(randomBuffer)");
-
-    status = clSetKernelArg(
-				calc_pie_kernel,
-				1,
-				sizeof(cl_mem),
-				(void *)&randomYBuffer);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(randomBuffer)");
-
-    // 2nd argument to the kernel - output buffer which holds "inside" hit count
-    status = clSetKernelArg(
-			    calc_pie_kernel,
-			    2,
-			    sizeof(cl_mem),
-			    (void *)&insideBuffer);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(inside_count)");
-    
-    inside = 0;
-    status = clEnqueueWriteBuffer(
+    cl_ulong chunkBase    = (cl_ulong)chunk * chunkSamples;
+    size_t localThreads   = groupSize;
+    size_t items          = (count + perItem - 1) / perItem;
+    size_t globalThreads  = ((items + groupSize - 1) / groupSize) * groupSize;
+    cl_ulong seed64       = seed;
+    cl_kernel kernel      = reductionKernel[reduction];
+
+    // Samples are drawn from their counters, no input buffer
+    int status = clSetKernelArg(kernel, 0, sizeof(cl_ulong), (void *)&seed64);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(seed)");
+
+    status = clSetKernelArg(kernel, 1, sizeof(cl_ulong), (void *)&chunkBase);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(chunkBase)");
+
+    status = clSetKernelArg(kernel, 2, sizeof(cl_uint), (void *)&count);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(chunkSamples)");
+
+    status = clSetKernelArg(kernel, 3, sizeof(cl_uint), (void *)&perItem);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(perItem)");
+
+    if(reduction == PIE_TREE)
+    {
+        status = clSetKernelArg(kernel, 4, sizeof(cl_mem), (void *)&partialsBuffer);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(partialsBuffer)");
+    }
+    else
+    {
+        status = clSetKernelArg(kernel, 4, sizeof(cl_mem), (void *)&countsBuffer);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(countsBuffer)");
+
+        status = clSetKernelArg(kernel, 5, sizeof(cl_uint), (void *)&chunk);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(chunk)");
+    }
+
+    status = clEnqueueNDRangeKernel(
                  commandQueue,
-                 insideBuffer,
-                 CL_FALSE,
-                 0,
-                 sizeof(cl_int),
-                 &inside,
+                 kernel,
+                 1,
+                 NULL,
+                 &globalThreads,
+                 &localThreads,
                  0,
                  NULL,
-                 &writeEvt);
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+
+    if(reduction != PIE_TREE)
+    {
+        return SDK_SUCCESS;
+    }
 
-    status = waitForEventAndRelease(&writeEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(writeEvt) Failed");
+    // Second pass: a single work-group sums the partials of the first
+    cl_uint numPartials = (cl_uint)(globalThreads / localThreads);
 
-    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed.(randomBuffer)");
+    status = clSetKernelArg(treeFinalKernel, 0, sizeof(cl_mem), (void *)&partialsBuffer);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(partialsBuffer)");
+
+    status = clSetKernelArg(treeFinalKernel, 1, sizeof(cl_uint), (void *)&numPartials);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(numPartials)");
+
+    status = clSetKernelArg(treeFinalKernel, 2, sizeof(cl_mem), (void *)&countsBuffer);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(countsBuffer)");
+
+    status = clSetKernelArg(treeFinalKernel, 3, sizeof(cl_uint), (void *)&chunk);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(chunk)");
 
-    // Enqueue a kernel run call
-    cl_event ndrEvt;
     status = clEnqueueNDRangeKernel(
                  commandQueue,
-                 calc_pie_kernel,
+                 treeFinalKernel,
                  1,
                  NULL,
-                 &globalThreads,
+                 &localThreads,
                  &localThreads,
                  0,
                  NULL,
-                 &ndrEvt);
-    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+                 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.(pie_tree_final)");
+
+    return SDK_SUCCESS;
+}
+
+int
+CalcPie::runReduction(int reduction, cl_ulong count)
+{
+    cl_uint zero = 0;
+    cl_uint chunks = (cl_uint)((count + chunkSamples - 1) / chunkSamples);
+
+    int status = clEnqueueFillBuffer(
+                     commandQueue,
+                     countsBuffer,
+                     &zero,
+                     sizeof(cl_uint),
+                     0,
+                     sizeof(cl_uint) * chunks,
+                     0,
+                     NULL,
+                     NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueFillBuffer failed.(countsBuffer)");
+
+    // All chunks are queued at once, the in-order queue runs them back to back
+    for(cl_uint c = 0; c < chunks; c++)
+    {
+        cl_ulong left = count - (cl_ulong)c * chunkSamples;
+        cl_uint n = left < chunkSamples ? (cl_uint)left : chunkSamples;
+        if(runCalcPieKernel(reduction, c, n) != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+    }
 
     status = clFlush(commandQueue);
     CHECK_OPENCL_ERROR(status, "clFlush failed.(commandQueue)");
 
-    status = waitForEventAndRelease(&ndrEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
+    cl_uint *counts;
+    status = mapBuffer(countsBuffer, counts, sizeof(cl_uint) * chunks, CL_MAP_READ);
+    CHECK_ERROR(status, SDK_SUCCESS, "Failed to map device buffer.(countsBuffer)");
+
+    inside[reduction] = 0;
+    for(cl_uint c = 0; c < chunks; c++)
+    {
+        inside[reduction] += counts[c];
+    }
+    firstChunk[reduction] = counts[0];
+
+    status = unmapBuffer(countsBuffer, counts);
+    CHECK_ERROR(status, SDK_SUCCESS, "Failed to unmap device buffer.(countsBuffer)");
 
     return SDK_SUCCESS;
 }
@@ -255,30 +370,34 @@ CalcPie::runCalcPieKernel()
 int
 CalcPie::runCLKernels(void)
 {
-    cl_int status;
+    // Every reduction counts the same samples
+    for(int r = 0; r < PIE_REDUCTIONS; r++)
+    {
+        if(!enabled[r])
+        {
+            continue;
+        }
 
-    status =  kernelInfo.setKernelWorkGroupInfo(calc_pie_kernel,
-              devices[sampleArgs->deviceId]);
-    CHECK_ERROR(status, SDK_SUCCESS, "setKErnelWorkGroupInfo() failed");
+        int timer = sampleTimer->createTimer();
+        sampleTimer->resetTimer(timer);
+        sampleTimer->startTimer(timer);
+
+        if(runReduction(r, samples) != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
 
-    //run the work-group level scan kernel
-    status = runCalcPieKernel();
+        sampleTimer->stopTimer(timer);
+        reductionTime[r] += (double)(sampleTimer->readTimer(timer));
+    }
 
     return SDK_SUCCESS;
 }
 
-void
-CalcPie::calcPieCPUReference(cl_float *pie)
+cl_uint
+CalcPie::calcPieCPUReference(cl_ulong first, cl_uint count)
 {
-    int insidecnt = 0;
-	for (cl_uint i = 0; i < length; i++)
-	{
-		float r = sqrt((randomX[i] * randomX[i]) + (randomY[i] * randomY[i]));
-		if (r <= 1)
-			insidecnt++;
-	}
-
-	*pie = (cl_float)(insidecnt * 4) / length;
+    return pieCount((cl_ulong)seed, first, count);
 }
 
 int CalcPie::initialize()
@@ -289,16 +408,37 @@ int CalcPie::initialize()
         return SDK_FAILURE;
     }
 
-    Option* array_length = new Option;
-    CHECK_ALLOCATION(array_length, "Memory allocation error. (array_length)");
-
-    array_length->_sVersion = "x";
-    array_length->_lVersion = "length";
-    array_length->_description = "Length of the input array";
-    array_length->_type = CA_ARG_INT;
-    array_length->_value = &length;
-    sampleArgs->AddOption(array_length);
-    delete array_length;
+    Option* sample_option = new Option;
+    CHECK_ALLOCATION(sample_option, "Memory allocation error. (sample_option)");
+
+    sample_option->_sVersion = "x";
+    sample_option->_lVersion = "samples";
+    sample_option->_description = "Number of samples, e.g. 1e12 (Default value 2^28)";
+    sample_option->_type = CA_ARG_STRING;
+    sample_option->_value = &samplesStr;
+    sampleArgs->AddOption(sample_option);
+
+    sample_option->_sVersion = "";
+    sample_option->_lVersion = "chunk";
+    sample_option->_description = "Samples of one kernel launch, below 2^31 (Default value 2^26)";
+    sample_option->_type = CA_ARG_INT;
+    sample_option->_value = &chunkSamples;
+    sampleArgs->AddOption(sample_option);
+
+    sample_option->_sVersion = "";
+    sample_option->_lVersion = "perItem";
+    sample_option->_description = "Samples a work-item draws (Default value 256)";
+    sample_option->_type = CA_ARG_INT;
+    sample_option->_value = &perItem;
+    sampleArgs->AddOption(sample_option);
+
+    sample_option->_sVersion = "";
+    sample_option->_lVersion = "reduction";
+    sample_option->_description = "Reduction of the hits [atomics|group|tree|all]";
+    sample_option->_type = CA_ARG_STRING;
+    sample_option->_value = &reductionName;
+    sampleArgs->AddOption(sample_option);
+    delete sample_option;
 
     Option* num_iterations = new Option;
     CHECK_ALLOCATION(num_iterations, "Memory allocation error. (num_iterations)");
@@ -336,63 +476,22 @@ int CalcPie::setup()
         return SDK_FAILURE;
     }
 
-    // Move data host to device
-    cl_event writeEvtX;
-	cl_event writeEvtY;
-    
-    status = clEnqueueWriteBuffer(
-                 commandQueue,
-                 randomXBuffer,
-                 CL_FALSE,
-                 0,
-                 sizeof(cl_float) * length,
-                 randomX,
-                 0,
-                 NULL,
-                 &writeEvtX);
-
-    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed.(randomBuffer)");
-
-	status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.(commandQueue)");
-
-    status = waitForEventAndRelease(&writeEvtX);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(writeEvtX) Failed");
-
-    status = clEnqueueWriteBuffer(
-                 commandQueue,
-                 randomYBuffer,
-                 CL_FALSE,
-                 0,
-                 sizeof(cl_float) * length,
-                 randomY,
-                 0,
-                 NULL,
-                 &writeEvtY);
-
-    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed.(randomBuffer)");
-
-
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush failed.(commandQueue)");
-
-    status = waitForEventAndRelease(&writeEvtY);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(writeEvtY) Failed");
-
     return SDK_SUCCESS;
 }
 
 
 int CalcPie::run()
 {
-    int status = 0;
+    //warm up run, one chunk of every reduction
+    cl_ulong warmup = samples < chunkSamples ? samples : chunkSamples;
+    for(int r = 0; r < PIE_REDUCTIONS; r++)
+    {
+        if(enabled[r] && runReduction(r, warmup) != SDK_SUCCESS)
+        {
+            return SDK_FAILURE;
+        }
+    }
 
-    //warm up run
-    if(runCLKernels() != SDK_SUCCESS)
-      {
-	return SDK_FAILURE;
-      }
-    
     std::cout << "Executing kernel for " << iterations
               << " iterations" << std::endl;
     std::cout << "-------------------------------------------" << std::endl;
@@ -419,36 +518,38 @@ int CalcPie::run()
 int CalcPie::verifyResults()
 {
   int status = SDK_SUCCESS;
-  
+
   if(sampleArgs->verify)
   {
-      // Read the device output buffer
-      cl_float pieValue, gpuPie;
-      cl_int *gpuInsideCount;
-      int status = mapBuffer(insideBuffer,
-                             gpuInsideCount,
-                             sizeof(cl_int),
-                             CL_MAP_READ);
-      CHECK_ERROR(status, SDK_SUCCESS,
-                  "Failed to map device buffer.(resultBuf)");
-      gpuPie = (cl_float)(*gpuInsideCount * 4)/length;
-
-	  status = unmapBuffer(insideBuffer, gpuInsideCount);
-	  CHECK_ERROR(status, SDK_SUCCESS,
-                  "Failed to unmap device buffer.(resultBuf)");
-
-      // reference implementation
-      calcPieCPUReference(&pieValue);
-
-      if(!sampleArgs->quiet)
+      // reference implementation replays the first chunk
+      cl_ulong firstCount = samples < chunkSamples ? samples : chunkSamples;
+      cl_uint cpuInside = calcPieCPUReference(0, (cl_uint)firstCount);
+
+      // every reduction has to match it and count the same total
+      cl_ulong total = 0;
+      bool passed = true;
+      for(int r = 0; r < PIE_REDUCTIONS; r++)
       {
-		std::cout << "GPUInsideCount: " << *gpuInsideCount;
-        std::cout << " CPUValue :"  << pieValue << " GPUValue: " << gpuPie << std::endl;
+          if(!enabled[r])
+          {
+              continue;
+          }
+
+          if(!sampleArgs->quiet)
+          {
+              std::cout << reductionNames[r] << " InsideCount: " << inside[r]
+                        << " FirstChunk CPU: " << cpuInside
+                        << " GPU: " << firstChunk[r] << std::endl;
+          }
+
+          if(firstChunk[r] != cpuInside || (total && inside[r] != total))
+          {
+              passed = false;
+          }
+          total = inside[r];
       }
 
-      // compare the results and see if they match
-      float epsilon = 1e-2f;
-      if(::fabs(gpuPie - pieValue) <=  epsilon)
+      if(passed)
       {
 		std::cout << "Passed!\n" << std::endl;
 		status = SDK_SUCCESS;
@@ -458,7 +559,7 @@ int CalcPie::verifyResults()
 		std::cout << "Failed\n" << std::endl;
         status = SDK_FAILURE;
 	  }
-      
+
   }
 
   return status;
@@ -471,19 +572,54 @@ void CalcPie::printStats()
         std::string strArray[4] =
         {
             "Samples",
+            "Chunks",
             "Setup Time(sec)",
-            "Avg. kernel time (sec)",
-            "Samples/sec"
+            "Avg. kernel time (sec)"
         };
         std::string stats[4];
         double avgKernelTime = kernelTime / iterations;
 
-        stats[0] = toString(length, std::dec);
-        stats[1] = toString(setupTime, std::dec);
-        stats[2] = toString(avgKernelTime, std::dec);
-        stats[3] = toString((length/avgKernelTime), std::dec);
+        stats[0] = toString(samples, std::dec);
+        stats[1] = toString(numChunks, std::dec);
+        stats[2] = toString(setupTime, std::dec);
+        stats[3] = toString(avgKernelTime, std::dec);
 
         printStatistics(strArray, stats, 4);
+
+        /*
+         * The estimate is binomial: its standard deviation is
+         * 4 * sqrt(p (1 - p) / samples) with p the fraction inside,
+         * the error should stay within 3 of them 99.7% of the time
+         */
+        std::cout << std::endl
+                  << std::setw(10) << std::left << "Reduction" << std::right
+                  << std::setw(14) << "Time(sec)"
+                  << std::setw(14) << "Samples/sec"
+                  << std::setw(16) << "Pi"
+                  << std::setw(14) << "Error"
+                  << std::setw(14) << "3-sigma bound" << std::endl;
+
+        for(int r = 0; r < PIE_REDUCTIONS; r++)
+        {
+            if(!enabled[r])
+            {
+                continue;
+            }
+
+            double time = reductionTime[r] / iterations;
+            double p = (double)inside[r] / samples;
+            double pie = 4 * p;
+            double bound = 3 * 4 * sqrt(p * (1 - p) / samples);
+
+            std::cout << std::setw(10) << std::left << reductionNames[r] << std::right
+                      << std::setw(14) << time
+                      << std::setw(14) << samples / time
+                      << std::setw(16) << std::setprecision(12) << pie
+                      << std::setprecision(6)
+                      << std::setw(14) << fabs(pie - PIE_PI)
+                      << std::setw(14) << bound
+                      << (fabs(pie - PIE_PI) <= bound ? "" : "  (outside)") << std::endl;
+        }
     }
 }
 
@@ -492,20 +628,23 @@ int CalcPie::cleanup()
     // Releases OpenCL resources (Context, Memory etc.)
     cl_int status = 0;
 
-    status = clReleaseKernel(calc_pie_kernel);
-    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(calc_pie_kernel)");
+    for(int r = 0; r < PIE_REDUCTIONS; r++)
+    {
+        status = clReleaseKernel(reductionKernel[r]);
+        CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(reductionKernel)");
+    }
+
+    status = clReleaseKernel(treeFinalKernel);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(treeFinalKernel)");
 
 	status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.(program)");
 
-    status = clReleaseMemObject(randomXBuffer);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(randomBuffer)");
+    status = clReleaseMemObject(countsBuffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(countsBuffer)");
 
-    status = clReleaseMemObject(randomYBuffer);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(randomBuffer)");
-	
-	status = clReleaseMemObject(insideBuffer);
-    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(insideBuffer)");
+	status = clReleaseMemObject(partialsBuffer);
+    CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(partialsBuffer)");
 
     status = clReleaseCommandQueue(commandQueue);
     CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.(commandQueue)");
@@ -513,10 +652,6 @@ int CalcPie::cleanup()
     status = clReleaseContext(context);
     CHECK_OPENCL_ERROR(status, "clReleaseContext failed.(context)");
 
-	// release program resources
-    FREE(randomX);
-    FREE(randomY);
-
     return SDK_SUCCESS;
 }
 
@@ -23,16 +23,35 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <string>
 #include "CLUtil.hpp"
+#include "PieSampler.h"
 
 using namespace appsdk;
 
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.2"
 #define OCL_COMPILER_FLAGS  "CalcPie_OclFlags.txt"
 
+#define DEFAULT_SAMPLES     (1 << 28)
+#define DEFAULT_CHUNK       (1 << 26)
+#define PIE_PI              3.14159265358979323846
+
+/**
+ * Ways the kernels reduce the hits of a chunk into its 32-bit count
+ */
+enum PieReduction
+{
+    PIE_GLOBAL_ATOMICS,     /**< One global atomic per work-item */
+    PIE_GROUP_ATOMIC,       /**< Work-group reduce, one global atomic per work-group */
+    PIE_TREE,               /**< Partial per work-group, then a second pass, no atomics */
+    PIE_REDUCTIONS
+};
+
 /**
  * CalcPie
- * Class implements OpenCL Prefix Sum sample
+ * Class implements OpenCL Monte Carlo pi sample. Samples are generated on
+ * the device from their counters and counted in chunks, once per
+ * reduction strategy; the host adds the chunk counts in 64 bits.
  */
 
 class CalcPie
@@ -41,26 +60,32 @@ class CalcPie
         seed;      /**< Seed value for random number generation */
         cl_double           setupTime;      /**< Time for setting up OpenCL */
         cl_double          kernelTime;      /**< Time for kernel execution */
-        cl_uint                 length;     /**< length of the input array */
-        cl_float               *randomX;      /**< Input array */
-        cl_float               *randomY;      /**< Input array */
+        std::string         samplesStr;     /**< --samples as given, e.g. 1e12 */
+        cl_ulong            samples;        /**< Samples of a run */
+        cl_uint             chunkSamples;   /**< Samples of one launch */
+        cl_uint             perItem;        /**< Samples a work-item draws */
+        cl_uint             numChunks;      /**< Launches of a run */
+        std::string         reductionName;  /**< atomics, group, tree or all */
+        bool                enabled[PIE_REDUCTIONS];    /**< Reductions to run */
+        cl_ulong            inside[PIE_REDUCTIONS];     /**< Hits of the last run */
+        cl_uint             firstChunk[PIE_REDUCTIONS]; /**< Hits of chunk 0, checked on the host */
+        cl_double           reductionTime[PIE_REDUCTIONS];  /**< Seconds of all iterations */
+        size_t              groupSize;      /**< Work-group size of all kernels */
+        size_t              maxGroups;      /**< Work-groups of the largest chunk */
         cl_context            context;      /**< CL context */
         cl_device_id         *devices;      /**< CL device list */
-        cl_mem            randomXBuffer;      /**< CL memory buffer */
-        cl_mem            randomYBuffer;      /**< CL memory buffer */
-        cl_mem           insideBuffer;      /**< CL memory output Buffer */
-        cl_int		inside;
+        cl_mem           countsBuffer;      /**< Hits of every chunk */
+        cl_mem           partialsBuffer;    /**< Hits of every work-group, tree pass 1 */
         cl_command_queue commandQueue;      /**< CL command queue */
         cl_program            program;      /**< CL program  */
-        cl_kernel        calc_pie_kernel;      /**< CL kernel */
+        cl_kernel        reductionKernel[PIE_REDUCTIONS];   /**< Counting kernel of every reduction */
+        cl_kernel        treeFinalKernel;   /**< Second pass of PIE_TREE */
         int
         iterations;      /**< Number of iterations for kernel execution */
         SDKDeviceInfo deviceInfo;/**< Structure to store device information*/
         KernelWorkGroupInfo kernelInfo;/**< Structure to store kernel related info */
 
         SDKTimer *sampleTimer;      /**< SDKTimer object */
-
-cl_uint         stages;
     public:
 
         CLCommandArgs   *sampleArgs;   /**< CLCommand argument class */
@@ -76,10 +101,23 @@ cl_uint         stages;
             : seed(123),
               setupTime(0),
               kernelTime(0),
-              length(1024),
+              samples(DEFAULT_SAMPLES),
+              chunkSamples(DEFAULT_CHUNK),
+              perItem(PIE_SAMPLES_PER_ITEM),
+              numChunks(0),
+              reductionName("all"),
+              groupSize(PIE_GROUP_SIZE),
+              maxGroups(0),
               devices(NULL),
               iterations(1)
         {
+            for(int r = 0; r < PIE_REDUCTIONS; r++)
+            {
+                enabled[r] = true;
+                inside[r] = 0;
+                firstChunk[r] = 0;
+                reductionTime[r] = 0;
+            }
             sampleArgs =  new CLCommandArgs();
             sampleTimer = new SDKTimer();
             sampleArgs->sampleVerStr = SAMPLE_VERSION;
@@ -100,7 +138,7 @@ cl_uint         stages;
         /**
         *******************************************************************************
         * @fn setupCalcPie
-        * @brief Allocate and initialize host memory array with random values
+        * @brief Parse the sample count and reductions, split the run into chunks
         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
         *******************************************************************************
         */
@@ -130,14 +168,14 @@ cl_uint         stages;
         /**
         *******************************************************************************
         * @fn calcPieCPUReference
-        * @brief Reference CPU implementation of Prefix Sum.
+        * @brief Reference CPU implementation, replays the samples of one chunk.
         *
-        * @param output the array that stores the prefix sum
-        * @param input the input array
-        * @param length length of the input array
+        * @param first counter of the chunk's first sample
+        * @param count samples of the chunk
+        * @return samples inside the quarter circle
         *******************************************************************************
         */
-        void calcPieCPUReference(cl_float * output);
+        cl_uint calcPieCPUReference(cl_ulong first, cl_uint count);
 
         /**
         *******************************************************************************
@@ -237,15 +275,29 @@ cl_uint         stages;
 
         /**
         *******************************************************************************
-        * @fn runGroupKernel
-        * @brief Run group prefixsum CL kernel. The kernel make prefix sum on individual work groups.
+        * @fn runCalcPieKernel
+        * @brief Count the hits of one chunk into countsBuffer[chunk] with the
+        *        kernels of 'reduction'.
         *
-        * @param[in] offset : Distance between two consecutive index.
+        * @param[in] reduction : PieReduction to use
+        * @param[in] chunk : Index of the chunk
+        * @param[in] count : Samples of the chunk
+        *
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        *******************************************************************************
+        */
+        int runCalcPieKernel(int reduction, cl_uint chunk, cl_uint count);
+
+        /**
+        *******************************************************************************
+        * @fn runReduction
+        * @brief Count the first 'count' samples in chunks with 'reduction' and
+        *        add the chunk counts into inside[reduction].
         *
         * @return SDK_SUCCESS on success and SDK_FAILURE on failure
         *******************************************************************************
         */
-        int runCalcPieKernel();
+        int runReduction(int reduction, cl_ulong count);
 
 };
 #endif
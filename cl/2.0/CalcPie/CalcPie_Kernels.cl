@@ -14,17 +14,70 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************************************/
 
+#define CALC_PIE_OPENCL_DEVICE
+#include "PieSampler.h"
+
 /****
-*  Given a random point calculates if the point is within the unit-radius
-*  circle
+*  Samples of this work-item within the chunk starting at sample
+*  'chunkBase': 'perItem' consecutive counters, fewer at the chunk's end
 ****/
-kernel void calc_pie_kernel(global float *rX, global float *rY, global int *inside)
+static uint countItem(ulong seed, ulong chunkBase, uint chunkSamples, uint perItem)
 {
-  int i = get_global_id(0);
-	 
-  float r = sqrt((rX[i]*rX[i])+(rY[i]*rY[i]));
-  if (r <= 1) 
-	atomic_fetch_add_explicit ((atomic_int *)inside, 1, memory_order_seq_cst, memory_scope_device);
+  ulong first = (ulong)get_global_id(0) * perItem;
+  if (first >= chunkSamples)
+    return 0;
+
+  uint count = (uint)min((ulong)perItem, chunkSamples - first);
+  return pieCount(seed, chunkBase + first, count);
 }
 
+/****
+*  Global atomics: every work-item adds its hits to the chunk's counter
+****/
+kernel void pie_global_atomics(ulong seed, ulong chunkBase, uint chunkSamples, uint perItem,
+                               global atomic_uint *counts, uint chunk)
+{
+  uint inside = countItem(seed, chunkBase, chunkSamples, perItem);
+  if (inside)
+	atomic_fetch_add_explicit(&counts[chunk], inside, memory_order_relaxed, memory_scope_device);
+}
+
+/****
+*  Work-group reduce, then one atomic per work-group
+****/
+kernel void pie_group_atomic(ulong seed, ulong chunkBase, uint chunkSamples, uint perItem,
+                             global atomic_uint *counts, uint chunk)
+{
+  uint inside = countItem(seed, chunkBase, chunkSamples, perItem);
+  inside = work_group_reduce_add(inside);
+  if (get_local_id(0) == 0)
+	atomic_fetch_add_explicit(&counts[chunk], inside, memory_order_relaxed, memory_scope_device);
+}
 
+/****
+*  Two-pass tree, first pass: one partial count per work-group
+****/
+kernel void pie_tree_partials(ulong seed, ulong chunkBase, uint chunkSamples, uint perItem,
+                              global uint *partials)
+{
+  uint inside = countItem(seed, chunkBase, chunkSamples, perItem);
+  inside = work_group_reduce_add(inside);
+  if (get_local_id(0) == 0)
+	partials[get_group_id(0)] = inside;
+}
+
+/****
+*  Two-pass tree, second pass: a single work-group sums the partials
+*  into the chunk's count, no atomics anywhere
+****/
+kernel void pie_tree_final(global const uint *partials, uint numPartials,
+                           global uint *counts, uint chunk)
+{
+  uint sum = 0;
+  for (uint i = get_local_id(0); i < numPartials; i += get_local_size(0))
+	sum += partials[i];
+
+  sum = work_group_reduce_add(sum);
+  if (get_local_id(0) == 0)
+	counts[chunk] = sum;
+}
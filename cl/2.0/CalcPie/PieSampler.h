@@ -0,0 +1,79 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef _PIE_SAMPLER_H_
+#define _PIE_SAMPLER_H_
+
+/*
+ * Sample generator shared by the host and the CalcPie kernels.
+ *
+ * Sample n of a run is a pure function of (seed, n): splitmix64 of the
+ * counter gives 64 random bits, 31 of them make x and 31 others make y.
+ * Nothing is stored, so any work-item can start at any sample and the
+ * host can replay every chunk exactly. The point is inside when
+ * x^2 + y^2 < 2^62, which is exact in 64-bit integers; the lattice of
+ * 2^62 points biases pi by less than 1e-9.
+ */
+
+#ifndef CALC_PIE_OPENCL_DEVICE
+#include <CL/cl.h>
+typedef cl_uint  pie_uint;
+typedef cl_ulong pie_ulong;
+#define PIE_U64(x)      x##ULL
+#else
+typedef uint     pie_uint;
+typedef ulong    pie_ulong;
+#define PIE_U64(x)      x##UL
+#endif
+
+#define PIE_GROUP_SIZE          256             // Work-items of a work-group, clamped to the kernels
+#define PIE_SAMPLES_PER_ITEM    256             // Default samples a work-item draws per launch
+#define PIE_MAX_CHUNK           (1u << 31)      // Samples of one launch stay below it, keeps the 32-bit counts exact
+
+/*
+ * Random bits of sample 'n', splitmix64 of the counter
+ */
+static inline pie_ulong pieBits(pie_ulong seed, pie_ulong n)
+{
+	pie_ulong z = seed + (n + 1) * PIE_U64(0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * PIE_U64(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * PIE_U64(0x94D049BB133111EB);
+	return z ^ (z >> 31);
+}
+
+/*
+ * 1 when sample 'n' falls inside the quarter circle
+ */
+static inline pie_uint pieInside(pie_ulong seed, pie_ulong n)
+{
+	pie_ulong bits = pieBits(seed, n);
+	pie_ulong x = bits >> 33;
+	pie_ulong y = (bits >> 2) & PIE_U64(0x7FFFFFFF);
+	return (x * x + y * y) < (PIE_U64(1) << 62) ? 1 : 0;
+}
+
+/*
+ * Samples inside among [first, first + count)
+ */
+static inline pie_uint pieCount(pie_ulong seed, pie_ulong first, pie_uint count)
+{
+	pie_uint inside = 0;
+	for (pie_uint i = 0; i < count; i++)
+		inside += pieInside(seed, first + i);
+	return inside;
+}
+
+#endif
@@ -25,6 +25,13 @@ int FineGrainSVMCAS::setupFineGrainSVMCAS()
     list = (int *) clSVMAlloc(context, CL_MEM_SVM_FINE_GRAIN_BUFFER | CL_MEM_SVM_ATOMICS, (2*length)*sizeof(int), 4);
     CHECK_ALLOCATION(list, "Failed to allocate SVM memory. (list)");
 
+    if(lockFree)
+    {
+        lockFreeStats = (cl_uint *) clSVMAlloc(context, CL_MEM_SVM_FINE_GRAIN_BUFFER,
+                                               4*length*sizeof(cl_uint), 0);
+        CHECK_ALLOCATION(lockFreeStats, "Failed to allocate SVM memory. (lockFreeStats)");
+    }
+
     return SDK_SUCCESS;
 }
 
@@ -112,6 +119,25 @@ FineGrainSVMCAS::setupCL(void)
 		OPENCL_EXPECTED_ERROR("Unsupported device! Device does not support SVM Atomics");
 	}
 
+    /*
+     * The lock-free structures are fine-grain SVM allocations updated by host
+     * threads and work-items at the same time
+     */
+    if(lockFree)
+    {
+        cl_device_svm_capabilities svmCaps = 0;
+        status = clGetDeviceInfo(devices[sampleArgs->deviceId],
+                                 CL_DEVICE_SVM_CAPABILITIES,
+                                 sizeof(svmCaps), &svmCaps, NULL);
+        CHECK_OPENCL_ERROR(status, "clGetDeviceInfo(CL_DEVICE_SVM_CAPABILITIES) failed.");
+
+        if(!(svmCaps & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) ||
+                !(svmCaps & CL_DEVICE_SVM_ATOMICS))
+        {
+            OPENCL_EXPECTED_ERROR("Unsupported device! --lockfree requires fine-grain SVM buffers with SVM atomics");
+        }
+    }
+
     // Create command queue
     cl_queue_properties prop[] = {0};
     commandQueue = clCreateCommandQueueWithProperties(context,
@@ -160,6 +186,27 @@ FineGrainSVMCAS::setupCL(void)
               devices[sampleArgs->deviceId]);
     CHECK_ERROR(status, SDK_SUCCESS, "setKErnelWorkGroupInfo() failed");
 
+    if(lockFree)
+    {
+        const char* names[LOCK_FREE_STRUCTURES] =
+        {
+            "queueContention",
+            "stackContention",
+            "hashMapContention"
+        };
+        for(int i = 0; i < LOCK_FREE_STRUCTURES; i++)
+        {
+            // stackContention is not built without 64-bit atomics
+            lockFreeKernels[i] = clCreateKernel(program, names[i], &status);
+            if(status != CL_SUCCESS)
+            {
+                lockFreeKernels[i] = NULL;
+            }
+        }
+        CHECK_ALLOCATION(lockFreeKernels[LOCK_FREE_QUEUE],
+                         "clCreateKernel::queueContention failed.");
+    }
+
     return SDK_SUCCESS;
 }
 
@@ -280,6 +327,231 @@ FineGrainSVMCAS::runFineGrainSVMCASUnLinkKernel()
     return SDK_SUCCESS;
 }
 
+/**
+* Host side of the contention kernels
+*/
+static void*
+lockFreeWorker(void* data)
+{
+    LockFreeWorker* work = (LockFreeWorker*)data;
+    cl_uint stats[4] = {0, 0, 0, 0};
+    cl_uint value;
+
+    for(cl_uint j = 0; j < work->ops; j++)
+    {
+        // Host values have the high bit set, device values do not
+        cl_uint v = 0x80000000u | (work->first + j);
+        cl_uint key = (work->first + j) % work->keys + 1;
+
+        switch(work->structure)
+        {
+        case LOCK_FREE_QUEUE:
+            if(svmQueueEnqueue((SVMQueue*)work->target, v))
+            {
+                stats[0]++;
+                stats[1] += v;
+            }
+            if(svmQueueDequeue((SVMQueue*)work->target, &value))
+            {
+                stats[2]++;
+                stats[3] += value;
+            }
+            break;
+        case LOCK_FREE_STACK:
+            if(svmStackPush((SVMStack*)work->target, v))
+            {
+                stats[0]++;
+                stats[1] += v;
+            }
+            if(svmStackPop((SVMStack*)work->target, &value))
+            {
+                stats[2]++;
+                stats[3] += value;
+            }
+            break;
+        default:
+            if(svmHashMapInsert((SVMHashMap*)work->target, key, 2 * key))
+            {
+                stats[0]++;
+                if(!svmHashMapLookup((SVMHashMap*)work->target, key, &value) ||
+                        value != 2 * key)
+                {
+                    stats[1]++;
+                }
+            }
+            break;
+        }
+    }
+
+    memcpy(work->stats, stats, sizeof(stats));
+    return NULL;
+}
+
+int
+FineGrainSVMCAS::runLockFreeBenchmark()
+{
+    const char* names[LOCK_FREE_STRUCTURES] = {"queue", "stack", "hash map"};
+    cl_uint ops = (cl_uint)lockFreeOps;
+    cl_uint workItems = (cl_uint)length;
+    cl_uint rounds = (workItems + hostThreads) * ops;
+
+    // Small enough for the queue and stack to fill up and run empty
+    cl_uint capacity = workItems / 4 > 64 ? workItems / 4 : 64;
+    // Every key is inserted twice, the map is never more than half full
+    cl_uint keys = rounds / 2 > 0 ? rounds / 2 : 1;
+
+    SVMQueue* queue = svmQueueCreate(context, capacity);
+    CHECK_ALLOCATION(queue, "Failed to allocate SVM memory. (queue)");
+    SVMStack* stack = svmStackCreate(context, capacity);
+    CHECK_ALLOCATION(stack, "Failed to allocate SVM memory. (stack)");
+    SVMHashMap* map = svmHashMapCreate(context, 2 * keys);
+    CHECK_ALLOCATION(map, "Failed to allocate SVM memory. (map)");
+    void* targets[LOCK_FREE_STRUCTURES] = {queue, stack, map};
+
+    LockFreeWorker* work = new LockFreeWorker[hostThreads];
+    SDKThread* threads = new SDKThread[hostThreads];
+
+    int timer = sampleTimer->createTimer();
+    lockFreePass = 1;
+
+    for(int s = 0; s < LOCK_FREE_STRUCTURES; s++)
+    {
+        cl_kernel kernel = lockFreeKernels[s];
+        if(kernel == NULL)
+        {
+            std::cout << "Skipping the lock-free " << names[s]
+                      << ", device has no 64-bit atomics" << std::endl;
+            continue;
+        }
+
+        cl_uint arg = 0;
+        int status = clSetKernelArgSVMPointer(kernel, arg++, targets[s]);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer failed.(target)");
+        status = clSetKernelArg(kernel, arg++, sizeof(cl_uint), &ops);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(ops)");
+        if(s == LOCK_FREE_HASH_MAP)
+        {
+            status = clSetKernelArg(kernel, arg++, sizeof(cl_uint), &keys);
+            CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(keys)");
+        }
+        status = clSetKernelArgSVMPointer(kernel, arg++, lockFreeStats);
+        CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer failed.(lockFreeStats)");
+
+        for(int t = 0; t < hostThreads; t++)
+        {
+            work[t].structure = (LockFreeStructure)s;
+            work[t].target = targets[s];
+            work[t].ops = ops;
+            work[t].first = (workItems + t) * ops;
+            work[t].keys = keys;
+        }
+
+        size_t globalThreads = workItems;
+
+        sampleTimer->resetTimer(timer);
+        sampleTimer->startTimer(timer);
+
+        cl_event ndrEvt;
+        status = clEnqueueNDRangeKernel(
+                     commandQueue,
+                     kernel,
+                     1,
+                     NULL,
+                     &globalThreads,
+                     NULL,
+                     0,
+                     NULL,
+                     &ndrEvt);
+        CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+
+        status = clFlush(commandQueue);
+        CHECK_OPENCL_ERROR(status, "clFlush failed.(commandQueue)");
+
+        // The host threads run while the kernel does
+        for(int t = 0; t < hostThreads; t++)
+        {
+            threads[t].create(lockFreeWorker, &work[t]);
+        }
+        for(int t = 0; t < hostThreads; t++)
+        {
+            threads[t].join();
+        }
+
+        status = waitForEventAndRelease(&ndrEvt);
+        CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
+
+        sampleTimer->stopTimer(timer);
+        lockFreeTime[s] = sampleTimer->readTimer(timer);
+
+        cl_uint total[4] = {0, 0, 0, 0};
+        for(cl_uint i = 0; i < workItems; i++)
+        {
+            for(int c = 0; c < 4; c++)
+            {
+                total[c] += lockFreeStats[4 * i + c];
+            }
+        }
+        for(int t = 0; t < hostThreads; t++)
+        {
+            for(int c = 0; c < 4; c++)
+            {
+                total[c] += work[t].stats[c];
+            }
+        }
+
+        bool pass = true;
+        cl_uint value;
+        if(s == LOCK_FREE_HASH_MAP)
+        {
+            // An insertion and a lookup per round
+            lockFreeDone[s] = 2.0 * total[0];
+
+            // Every key once, with its value
+            pass = total[0] == rounds && total[1] == 0 &&
+                   svmHashMapSize(map) == keys;
+            for(cl_uint key = 1; pass && key <= keys; key++)
+            {
+                pass = svmHashMapLookup(map, key, &value) && value == 2 * key;
+            }
+        }
+        else
+        {
+            lockFreeDone[s] = (cl_double)total[0] + total[2];
+
+            // What was put and not taken is still in the structure, the
+            // sums wrap around the same way
+            while(s == LOCK_FREE_QUEUE ? svmQueueDequeue(queue, &value) :
+                    svmStackPop(stack, &value))
+            {
+                total[2]++;
+                total[3] += value;
+            }
+            pass = total[0] == total[2] && total[1] == total[3];
+        }
+
+        if(!sampleArgs->quiet)
+        {
+            std::cout << "Lock-free " << names[s] << " : " << total[0]
+                      << (s == LOCK_FREE_HASH_MAP ? " inserted, " : " put, ")
+                      << (s == LOCK_FREE_HASH_MAP ? total[1] : total[2])
+                      << (s == LOCK_FREE_HASH_MAP ? " lookups missed" : " taken")
+                      << (pass ? ", passed" : ", failed") << std::endl;
+        }
+        if(!pass)
+        {
+            lockFreePass = 0;
+        }
+    }
+
+    delete[] threads;
+    delete[] work;
+    svmLockFreeRelease(context, queue);
+    svmLockFreeRelease(context, stack);
+    svmLockFreeRelease(context, map);
+
+    return SDK_SUCCESS;
+}
+
 int
 FineGrainSVMCAS::runCLKernels(void)
 {
@@ -332,6 +604,33 @@ int FineGrainSVMCAS::initialize()
     sampleArgs->AddOption(num_iterations);
     delete num_iterations;
 
+    Option* lock_free = new Option;
+    CHECK_ALLOCATION(lock_free, "Memory allocation error. (lock_free)");
+
+    lock_free->_sVersion = "";
+    lock_free->_lVersion = "lockfree";
+    lock_free->_description =
+        "Run the lock-free queue, stack and hash map with host threads and kernels together";
+    lock_free->_type = CA_NO_ARGUMENT;
+    lock_free->_value = &lockFree;
+    sampleArgs->AddOption(lock_free);
+
+    lock_free->_sVersion = "";
+    lock_free->_lVersion = "host-threads";
+    lock_free->_description = "Host threads of the lock-free benchmark (default 2)";
+    lock_free->_type = CA_ARG_INT;
+    lock_free->_value = &hostThreads;
+    sampleArgs->AddOption(lock_free);
+
+    lock_free->_sVersion = "";
+    lock_free->_lVersion = "ops";
+    lock_free->_description =
+        "Rounds per work-item and host thread of the lock-free benchmark (default 16)";
+    lock_free->_type = CA_ARG_INT;
+    lock_free->_value = &lockFreeOps;
+    sampleArgs->AddOption(lock_free);
+    delete lock_free;
+
     return SDK_SUCCESS;
 }
 
@@ -339,6 +638,12 @@ int FineGrainSVMCAS::setup()
 {
 	int retStatus;
 
+    if(hostThreads < 0 || lockFreeOps < 1)
+    {
+        std::cout << "--host-threads must be >= 0 and --ops >= 1" << std::endl;
+        return SDK_FAILURE;
+    }
+
     int timer = sampleTimer->createTimer();
     sampleTimer->resetTimer(timer);
     sampleTimer->startTimer(timer);
@@ -391,6 +696,11 @@ int FineGrainSVMCAS::run()
     sampleTimer->stopTimer(timer);
     kernelTime = (double)(sampleTimer->readTimer(timer));
 
+    if(lockFree && runLockFreeBenchmark() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
     return SDK_SUCCESS;
 }
 
@@ -399,7 +709,7 @@ int FineGrainSVMCAS::verifyResults()
   int status = SDK_SUCCESS;
   if(sampleArgs->verify)
     {
-	if (push_pass && pop_pass)
+	if (push_pass && pop_pass && lockFreePass)
 		std::cout << "Passed! \n ";
 	else
 		std::cout << "Failed! \n ";
@@ -427,6 +737,30 @@ void FineGrainSVMCAS::printStats()
         stats[3] = toString((length/avgKernelTime), std::dec);
 
         printStatistics(strArray, stats, 4);
+
+        if(lockFree)
+        {
+            const char* names[LOCK_FREE_STRUCTURES] = {"Queue", "Stack", "Hash map"};
+            std::string lockFreeArray[4] =
+            {
+                "Lock-free structure",
+                "Host threads",
+                "Time(sec)",
+                "MOps/sec"
+            };
+            for(int s = 0; s < LOCK_FREE_STRUCTURES; s++)
+            {
+                if(lockFreeKernels[s] == NULL)
+                {
+                    continue;
+                }
+                stats[0] = names[s];
+                stats[1] = toString(hostThreads, std::dec);
+                stats[2] = toString(lockFreeTime[s], std::dec);
+                stats[3] = toString(lockFreeDone[s] / lockFreeTime[s] / 1e6, std::dec);
+                printStatistics(lockFreeArray, stats, 4);
+            }
+        }
     }
 }
 
@@ -441,6 +775,20 @@ int FineGrainSVMCAS::cleanup()
     status = clReleaseKernel(fine_grain_cas_unlink_kernel);
     CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(program)");
 
+    for(int i = 0; i < LOCK_FREE_STRUCTURES; i++)
+    {
+        if(lockFreeKernels[i] != NULL)
+        {
+            status = clReleaseKernel(lockFreeKernels[i]);
+            CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(lockFreeKernels)");
+        }
+    }
+
+    if(lockFreeStats != NULL)
+    {
+        clSVMFree(context, lockFreeStats);
+    }
+
     status = clReleaseCommandQueue(commandQueue);
     CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.(commandQueue)");
 
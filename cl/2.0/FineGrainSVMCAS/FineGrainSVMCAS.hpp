@@ -25,12 +25,39 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <string.h>
 #include <atomic>
 #include "CLUtil.hpp"
+#include "SDKThread.hpp"
+#include "SVMLockFree.hpp"
 
 using namespace appsdk;
 
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.1"
 #define OCL_COMPILER_FLAGS  "FineGrainSVMCAS_OclFlags.txt"
 
+/**
+ * Structures of the lock-free contention benchmark (--lockfree)
+ */
+enum LockFreeStructure
+{
+    LOCK_FREE_QUEUE,
+    LOCK_FREE_STACK,
+    LOCK_FREE_HASH_MAP,
+    LOCK_FREE_STRUCTURES
+};
+
+/**
+ * Work of one host thread of the contention benchmark, same rounds and
+ * counters as the contention kernels
+ */
+struct LockFreeWorker
+{
+    LockFreeStructure structure;
+    void*             target;      /**< SVMQueue, SVMStack or SVMHashMap */
+    cl_uint           ops;         /**< Rounds */
+    cl_uint           first;       /**< First value or key index */
+    cl_uint           keys;        /**< Distinct keys of the hash map */
+    cl_uint           stats[4];    /**< Same layout as the kernels' stats */
+};
+
 /**
  * FineGrainSVMCAS
  * Class implements OpenCL Prefix Sum sample
@@ -52,6 +79,14 @@ class FineGrainSVMCAS
         cl_kernel        fine_grain_cas_unlink_kernel;      /**< CL kernel */
 	cl_int		 pop_pass;
 	cl_int		 push_pass;
+        bool                 lockFree;      /**< Run the contention benchmark */
+        int               hostThreads;      /**< Host threads of the benchmark */
+        int                lockFreeOps;      /**< Rounds per work-item and thread */
+        cl_kernel        lockFreeKernels[LOCK_FREE_STRUCTURES]; /**< Contention kernels, NULL if not built */
+        cl_uint         *lockFreeStats;      /**< 4 counters per work-item, fine-grain SVM */
+        cl_int           lockFreePass;      /**< Every structure verified */
+        cl_double        lockFreeTime[LOCK_FREE_STRUCTURES];  /**< Seconds per structure */
+        cl_double        lockFreeDone[LOCK_FREE_STRUCTURES];  /**< Successful operations */
         int
         iterations;      /**< Number of iterations for kernel execution */
         SDKDeviceInfo deviceInfo;/**< Structure to store device information*/
@@ -79,12 +114,23 @@ cl_uint         stages;
               devices(NULL),
 	      pop_pass(0),
 	      push_pass(0),
+              lockFree(false),
+              hostThreads(2),
+              lockFreeOps(16),
+              lockFreeStats(NULL),
+              lockFreePass(1),
               iterations(1)
         {
             sampleArgs =  new CLCommandArgs();
             sampleTimer = new SDKTimer();
             sampleArgs->sampleVerStr = SAMPLE_VERSION;
             sampleArgs->flags        = OCL_COMPILER_FLAGS;
+            for(int i = 0; i < LOCK_FREE_STRUCTURES; i++)
+            {
+                lockFreeKernels[i] = NULL;
+                lockFreeTime[i] = 0;
+                lockFreeDone[i] = 0;
+            }
         }
 
         /**
@@ -220,5 +266,16 @@ cl_uint         stages;
         int runFineGrainSVMCASLinkKernel();
         int runFineGrainSVMCASUnLinkKernel();
 
+        /**
+        *******************************************************************************
+        * @fn runLockFreeBenchmark
+        * @brief Runs each SVMLockFree structure's contention kernel while host
+        *        threads use the same structure, then checks that no value was
+        *        lost or duplicated and that every key has its value.
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        *******************************************************************************
+        */
+        int runLockFreeBenchmark();
+
 };
 #endif
@@ -14,6 +14,8 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************************************/
 
+#include "SVMLockFree.cl"
+
 /****
 *  These kernels insert and removes global ids into this list parallely
 ****/
@@ -43,3 +45,87 @@ kernel void unlinkKernel(global int *list) {
 		} while (!atomic_compare_exchange_strong ((atomic_int *)&list[0], &head, next ));
 	}
 }
+
+/****
+*  Contention kernels for the SVMLockFree structures, run while host threads
+*  use the same structure. Every work-item does 'ops' rounds and never waits
+*  for a full or empty structure, it counts what succeeded:
+*  stats[4 * gid] = values put, stats[4 * gid + 1] = their sum,
+*  stats[4 * gid + 2] = values taken, stats[4 * gid + 3] = their sum.
+*  Device values are gid * ops + j + 1, below the host's 0x80000000.
+****/
+
+kernel void queueContention(global SVMQueue *queue, uint ops, global uint *stats)
+{
+	uint gid = get_global_id(0);
+	uint put = 0, putSum = 0, taken = 0, takenSum = 0;
+	uint value;
+
+	for (uint j = 0; j < ops; j++) {
+		uint v = gid * ops + j + 1;
+		if (svmQueueEnqueue(queue, v)) {
+			put++;
+			putSum += v;
+		}
+		if (svmQueueDequeue(queue, &value)) {
+			taken++;
+			takenSum += value;
+		}
+	}
+	stats[4 * gid] = put;
+	stats[4 * gid + 1] = putSum;
+	stats[4 * gid + 2] = taken;
+	stats[4 * gid + 3] = takenSum;
+}
+
+#ifdef SVM_LOCK_FREE_STACK
+kernel void stackContention(global SVMStack *stack, uint ops, global uint *stats)
+{
+	uint gid = get_global_id(0);
+	uint put = 0, putSum = 0, taken = 0, takenSum = 0;
+	uint value;
+
+	for (uint j = 0; j < ops; j++) {
+		uint v = gid * ops + j + 1;
+		if (svmStackPush(stack, v)) {
+			put++;
+			putSum += v;
+		}
+		if (svmStackPop(stack, &value)) {
+			taken++;
+			takenSum += value;
+		}
+	}
+	stats[4 * gid] = put;
+	stats[4 * gid + 1] = putSum;
+	stats[4 * gid + 2] = taken;
+	stats[4 * gid + 3] = takenSum;
+}
+#endif
+
+/****
+*  Keys wrap around 'keys' so host threads and work-items insert the same
+*  keys, always with value 2 * key. Each work-item looks its key up right
+*  after inserting it: stats[4 * gid] = keys inserted,
+*  stats[4 * gid + 1] = lookups that missed or saw another value.
+****/
+
+kernel void hashMapContention(global SVMHashMap *map, uint ops, uint keys, global uint *stats)
+{
+	uint gid = get_global_id(0);
+	uint inserted = 0, missed = 0;
+	uint value;
+
+	for (uint j = 0; j < ops; j++) {
+		uint key = (gid * ops + j) % keys + 1;
+		if (svmHashMapInsert(map, key, 2 * key)) {
+			inserted++;
+			if (!svmHashMapLookup(map, key, &value) || value != 2 * key)
+				missed++;
+		}
+	}
+	stats[4 * gid] = inserted;
+	stats[4 * gid + 1] = missed;
+	stats[4 * gid + 2] = 0;
+	stats[4 * gid + 3] = 0;
+}
@@ -0,0 +1,209 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+/****
+*  Device side of the lock-free SVM structures described in SVMLockFree.h,
+*  the same algorithms and memory orders as SVMLockFree.cpp on the host.
+*  Every atomic is at memory_scope_all_svm_devices so host threads see the
+*  kernel's updates while it runs, and the other way round.
+*  The stack needs 64-bit atomics for its tagged tops, SVM_LOCK_FREE_STACK
+*  is only defined when the device has them.
+****/
+
+#include "SVMLockFree.h"
+
+#if defined(cl_khr_int64_base_atomics) && defined(cl_khr_int64_extended_atomics)
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+#pragma OPENCL EXTENSION cl_khr_int64_extended_atomics : enable
+#define SVM_LOCK_FREE_STACK
+#endif
+
+#define SVM_ATOMIC_UINT(p)  ((volatile global atomic_uint *)(p))
+#define SVM_ATOMIC_ULONG(p) ((volatile global atomic_ulong *)(p))
+
+uint svmLoad(global uint *p, memory_order order)
+{
+	return atomic_load_explicit(SVM_ATOMIC_UINT(p), order, memory_scope_all_svm_devices);
+}
+
+void svmStore(global uint *p, uint value, memory_order order)
+{
+	atomic_store_explicit(SVM_ATOMIC_UINT(p), value, order, memory_scope_all_svm_devices);
+}
+
+bool svmQueueEnqueue(global SVMQueue *queue, uint value)
+{
+	global SVMQueueCell *cells = (global SVMQueueCell *)(queue + 1);
+	global SVMQueueCell *cell;
+	uint pos = svmLoad(&queue->enqueuePos, memory_order_relaxed);
+
+	for (;;) {
+		cell = &cells[pos & queue->mask];
+		uint sequence = svmLoad(&cell->sequence, memory_order_acquire);
+		int lap = (int)(sequence - pos);
+		if (lap == 0) {
+			if (atomic_compare_exchange_weak_explicit(SVM_ATOMIC_UINT(&queue->enqueuePos),
+					&pos, pos + 1, memory_order_relaxed, memory_order_relaxed,
+					memory_scope_all_svm_devices))
+				break;
+		} else if (lap < 0) {
+			return false;
+		} else {
+			pos = svmLoad(&queue->enqueuePos, memory_order_relaxed);
+		}
+	}
+
+	cell->value = value;
+	svmStore(&cell->sequence, pos + 1, memory_order_release);
+	return true;
+}
+
+bool svmQueueDequeue(global SVMQueue *queue, uint *value)
+{
+	global SVMQueueCell *cells = (global SVMQueueCell *)(queue + 1);
+	global SVMQueueCell *cell;
+	uint pos = svmLoad(&queue->dequeuePos, memory_order_relaxed);
+
+	for (;;) {
+		cell = &cells[pos & queue->mask];
+		uint sequence = svmLoad(&cell->sequence, memory_order_acquire);
+		int lap = (int)(sequence - (pos + 1));
+		if (lap == 0) {
+			if (atomic_compare_exchange_weak_explicit(SVM_ATOMIC_UINT(&queue->dequeuePos),
+					&pos, pos + 1, memory_order_relaxed, memory_order_relaxed,
+					memory_scope_all_svm_devices))
+				break;
+		} else if (lap < 0) {
+			return false;
+		} else {
+			pos = svmLoad(&queue->dequeuePos, memory_order_relaxed);
+		}
+	}
+
+	*value = cell->value;
+	svmStore(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+	return true;
+}
+
+#ifdef SVM_LOCK_FREE_STACK
+
+/* Pops a node from the list starting at 'top', SVM_STACK_NIL when empty */
+uint svmPopNode(global SVMStack *stack, global ulong *top)
+{
+	global SVMStackNode *nodes = (global SVMStackNode *)(stack + 1);
+	ulong old = atomic_load_explicit(SVM_ATOMIC_ULONG(top), memory_order_acquire,
+					 memory_scope_all_svm_devices);
+
+	for (;;) {
+		uint index = (uint)old;
+		if (index == SVM_STACK_NIL)
+			return SVM_STACK_NIL;
+		/* stale if the node was popped meanwhile, the tag then fails the exchange */
+		uint next = svmLoad(&nodes[index].next, memory_order_relaxed);
+		ulong word = (((old >> 32) + 1) << 32) | next;
+		if (atomic_compare_exchange_weak_explicit(SVM_ATOMIC_ULONG(top), &old, word,
+				memory_order_acquire, memory_order_acquire,
+				memory_scope_all_svm_devices))
+			return index;
+	}
+}
+
+/* Pushes node 'index' on the list starting at 'top' */
+void svmPushNode(global SVMStack *stack, global ulong *top, uint index)
+{
+	global SVMStackNode *nodes = (global SVMStackNode *)(stack + 1);
+	ulong old = atomic_load_explicit(SVM_ATOMIC_ULONG(top), memory_order_relaxed,
+					 memory_scope_all_svm_devices);
+
+	for (;;) {
+		svmStore(&nodes[index].next, (uint)old, memory_order_relaxed);
+		ulong word = (((old >> 32) + 1) << 32) | index;
+		if (atomic_compare_exchange_weak_explicit(SVM_ATOMIC_ULONG(top), &old, word,
+				memory_order_release, memory_order_relaxed,
+				memory_scope_all_svm_devices))
+			return;
+	}
+}
+
+bool svmStackPush(global SVMStack *stack, uint value)
+{
+	uint index = svmPopNode(stack, &stack->freeTop);
+	if (index == SVM_STACK_NIL)
+		return false;
+	((global SVMStackNode *)(stack + 1))[index].value = value;
+	svmPushNode(stack, &stack->top, index);
+	return true;
+}
+
+bool svmStackPop(global SVMStack *stack, uint *value)
+{
+	uint index = svmPopNode(stack, &stack->top);
+	if (index == SVM_STACK_NIL)
+		return false;
+	*value = ((global SVMStackNode *)(stack + 1))[index].value;
+	svmPushNode(stack, &stack->freeTop, index);
+	return true;
+}
+
+#endif
+
+bool svmHashMapInsert(global SVMHashMap *map, uint key, uint value)
+{
+	if (key == SVM_HASH_EMPTY_KEY || value == SVM_HASH_NO_VALUE)
+		return false;
+
+	global SVMHashEntry *entries = (global SVMHashEntry *)(map + 1);
+	uint slot = svmHashSlot(key, map->mask);
+	for (uint probe = 0; probe <= map->mask; probe++) {
+		uint found = svmLoad(&entries[slot].key, memory_order_relaxed);
+		if (found == SVM_HASH_EMPTY_KEY) {
+			/* claim the slot, or learn which key did */
+			if (atomic_compare_exchange_strong_explicit(SVM_ATOMIC_UINT(&entries[slot].key),
+					&found, key, memory_order_relaxed, memory_order_relaxed,
+					memory_scope_all_svm_devices))
+				found = key;
+		}
+		if (found == key) {
+			svmStore(&entries[slot].value, value, memory_order_release);
+			return true;
+		}
+		slot = (slot + 1) & map->mask;
+	}
+	return false;
+}
+
+bool svmHashMapLookup(global SVMHashMap *map, uint key, uint *value)
+{
+	if (key == SVM_HASH_EMPTY_KEY)
+		return false;
+
+	global SVMHashEntry *entries = (global SVMHashEntry *)(map + 1);
+	uint slot = svmHashSlot(key, map->mask);
+	for (uint probe = 0; probe <= map->mask; probe++) {
+		uint found = svmLoad(&entries[slot].key, memory_order_relaxed);
+		if (found == key) {
+			uint v = svmLoad(&entries[slot].value, memory_order_acquire);
+			if (v == SVM_HASH_NO_VALUE)
+				return false;
+			*value = v;
+			return true;
+		}
+		if (found == SVM_HASH_EMPTY_KEY)
+			return false;
+		slot = (slot + 1) & map->mask;
+	}
+	return false;
+}
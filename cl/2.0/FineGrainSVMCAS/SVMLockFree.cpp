@@ -0,0 +1,412 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "SVMLockFree.hpp"
+#include <atomic>
+
+/**
+* The structures are plain integers in SVM, accessed through std::atomic as
+* the kernels do through atomic_uint / atomic_ulong
+*/
+static inline std::atomic<svm_uint>&
+atomicOf(svm_uint& word)
+{
+    return *reinterpret_cast<std::atomic<svm_uint>*>(&word);
+}
+
+static inline std::atomic<svm_ulong>&
+atomicOf(svm_ulong& word)
+{
+    return *reinterpret_cast<std::atomic<svm_ulong>*>(&word);
+}
+
+static inline const std::atomic<svm_uint>&
+atomicOf(const svm_uint& word)
+{
+    return *reinterpret_cast<const std::atomic<svm_uint>*>(&word);
+}
+
+static cl_uint
+roundUpPow2(cl_uint n)
+{
+    cl_uint pow2 = 1;
+    while(pow2 < n)
+    {
+        pow2 <<= 1;
+    }
+    return pow2;
+}
+
+static void*
+allocate(cl_context context, size_t size)
+{
+    return clSVMAlloc(context, CL_MEM_SVM_FINE_GRAIN_BUFFER | CL_MEM_SVM_ATOMICS,
+                      size, SVM_LINE_UINTS * sizeof(svm_uint));
+}
+
+static inline SVMQueueCell*
+queueCells(SVMQueue* queue)
+{
+    return reinterpret_cast<SVMQueueCell*>(queue + 1);
+}
+
+static inline SVMStackNode*
+stackNodes(SVMStack* stack)
+{
+    return reinterpret_cast<SVMStackNode*>(stack + 1);
+}
+
+static inline SVMHashEntry*
+hashEntries(SVMHashMap* map)
+{
+    return reinterpret_cast<SVMHashEntry*>(map + 1);
+}
+
+static inline const SVMHashEntry*
+hashEntries(const SVMHashMap* map)
+{
+    return reinterpret_cast<const SVMHashEntry*>(map + 1);
+}
+
+SVMQueue*
+svmQueueCreate(cl_context context, cl_uint capacity)
+{
+    capacity = roundUpPow2(capacity);
+    SVMQueue* queue = (SVMQueue*)allocate(context, sizeof(SVMQueue) +
+                                          capacity * sizeof(SVMQueueCell));
+    if(queue != NULL)
+    {
+        queue->mask = capacity - 1;
+        svmQueueReset(queue);
+    }
+    return queue;
+}
+
+void
+svmQueueReset(SVMQueue* queue)
+{
+    SVMQueueCell* cells = queueCells(queue);
+    for(cl_uint i = 0; i <= queue->mask; i++)
+    {
+        cells[i].sequence = i;
+        cells[i].value = 0;
+    }
+    queue->enqueuePos = 0;
+    queue->dequeuePos = 0;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+bool
+svmQueueEnqueue(SVMQueue* queue, cl_uint value)
+{
+    SVMQueueCell* cells = queueCells(queue);
+    SVMQueueCell* cell;
+    cl_uint pos = atomicOf(queue->enqueuePos).load(std::memory_order_relaxed);
+
+    for(;;)
+    {
+        cell = &cells[pos & queue->mask];
+        cl_uint sequence = atomicOf(cell->sequence).load(std::memory_order_acquire);
+        cl_int lap = (cl_int)(sequence - pos);
+        if(lap == 0)
+        {
+            // The cell is free for this position, claim the position
+            if(atomicOf(queue->enqueuePos).compare_exchange_weak(pos, pos + 1,
+                    std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if(lap < 0)
+        {
+            // Still holds the value of the previous lap
+            return false;
+        }
+        else
+        {
+            pos = atomicOf(queue->enqueuePos).load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->value = value;
+    atomicOf(cell->sequence).store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool
+svmQueueDequeue(SVMQueue* queue, cl_uint* value)
+{
+    SVMQueueCell* cells = queueCells(queue);
+    SVMQueueCell* cell;
+    cl_uint pos = atomicOf(queue->dequeuePos).load(std::memory_order_relaxed);
+
+    for(;;)
+    {
+        cell = &cells[pos & queue->mask];
+        cl_uint sequence = atomicOf(cell->sequence).load(std::memory_order_acquire);
+        cl_int lap = (cl_int)(sequence - (pos + 1));
+        if(lap == 0)
+        {
+            if(atomicOf(queue->dequeuePos).compare_exchange_weak(pos, pos + 1,
+                    std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if(lap < 0)
+        {
+            // Not filled yet
+            return false;
+        }
+        else
+        {
+            pos = atomicOf(queue->dequeuePos).load(std::memory_order_relaxed);
+        }
+    }
+
+    *value = cell->value;
+    // Free for the next lap
+    atomicOf(cell->sequence).store(pos + queue->mask + 1,
+                                   std::memory_order_release);
+    return true;
+}
+
+static inline svm_ulong
+stackWord(svm_ulong tag, cl_uint index)
+{
+    return (tag << 32) | index;
+}
+
+/**
+* Pops a node from the list starting at 'top'
+* @return its index, SVM_STACK_NIL for an empty list
+*/
+static cl_uint
+popNode(SVMStack* stack, svm_ulong& top)
+{
+    SVMStackNode* nodes = stackNodes(stack);
+    svm_ulong old = atomicOf(top).load(std::memory_order_acquire);
+
+    for(;;)
+    {
+        cl_uint index = (cl_uint)old;
+        if(index == SVM_STACK_NIL)
+        {
+            return SVM_STACK_NIL;
+        }
+        // May be stale if the node was popped meanwhile, the tag of 'old'
+        // then makes the exchange fail
+        cl_uint next = atomicOf(nodes[index].next).load(std::memory_order_relaxed);
+        if(atomicOf(top).compare_exchange_weak(old, stackWord((old >> 32) + 1,
+                                               next),
+                                               std::memory_order_acquire,
+                                               std::memory_order_acquire))
+        {
+            return index;
+        }
+    }
+}
+
+/**
+* Pushes node 'index' on the list starting at 'top'
+*/
+static void
+pushNode(SVMStack* stack, svm_ulong& top, cl_uint index)
+{
+    SVMStackNode* nodes = stackNodes(stack);
+    svm_ulong old = atomicOf(top).load(std::memory_order_relaxed);
+
+    for(;;)
+    {
+        atomicOf(nodes[index].next).store((cl_uint)old, std::memory_order_relaxed);
+        if(atomicOf(top).compare_exchange_weak(old, stackWord((old >> 32) + 1,
+                                               index),
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+}
+
+SVMStack*
+svmStackCreate(cl_context context, cl_uint capacity)
+{
+    SVMStack* stack = (SVMStack*)allocate(context, sizeof(SVMStack) +
+                                          capacity * sizeof(SVMStackNode));
+    if(stack != NULL)
+    {
+        stack->capacity = capacity;
+        svmStackReset(stack);
+    }
+    return stack;
+}
+
+void
+svmStackReset(SVMStack* stack)
+{
+    SVMStackNode* nodes = stackNodes(stack);
+    for(cl_uint i = 0; i < stack->capacity; i++)
+    {
+        nodes[i].next = i + 1 < stack->capacity ? i + 1 : SVM_STACK_NIL;
+        nodes[i].value = 0;
+    }
+    stack->top = stackWord(0, SVM_STACK_NIL);
+    stack->freeTop = stackWord(0, stack->capacity ? 0 : SVM_STACK_NIL);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+bool
+svmStackPush(SVMStack* stack, cl_uint value)
+{
+    cl_uint index = popNode(stack, stack->freeTop);
+    if(index == SVM_STACK_NIL)
+    {
+        return false;
+    }
+    stackNodes(stack)[index].value = value;
+    pushNode(stack, stack->top, index);
+    return true;
+}
+
+bool
+svmStackPop(SVMStack* stack, cl_uint* value)
+{
+    cl_uint index = popNode(stack, stack->top);
+    if(index == SVM_STACK_NIL)
+    {
+        return false;
+    }
+    *value = stackNodes(stack)[index].value;
+    pushNode(stack, stack->freeTop, index);
+    return true;
+}
+
+SVMHashMap*
+svmHashMapCreate(cl_context context, cl_uint slots)
+{
+    slots = roundUpPow2(slots);
+    SVMHashMap* map = (SVMHashMap*)allocate(context, sizeof(SVMHashMap) +
+                                            slots * sizeof(SVMHashEntry));
+    if(map != NULL)
+    {
+        map->mask = slots - 1;
+        svmHashMapReset(map);
+    }
+    return map;
+}
+
+void
+svmHashMapReset(SVMHashMap* map)
+{
+    SVMHashEntry* entries = hashEntries(map);
+    for(cl_uint i = 0; i <= map->mask; i++)
+    {
+        entries[i].key = SVM_HASH_EMPTY_KEY;
+        entries[i].value = SVM_HASH_NO_VALUE;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+bool
+svmHashMapInsert(SVMHashMap* map, cl_uint key, cl_uint value)
+{
+    if(key == SVM_HASH_EMPTY_KEY || value == SVM_HASH_NO_VALUE)
+    {
+        return false;
+    }
+
+    SVMHashEntry* entries = hashEntries(map);
+    cl_uint slot = svmHashSlot(key, map->mask);
+    for(cl_uint probe = 0; probe <= map->mask; probe++)
+    {
+        cl_uint found = atomicOf(entries[slot].key).load(std::memory_order_relaxed);
+        if(found == SVM_HASH_EMPTY_KEY)
+        {
+            // Claim the slot, or learn which key did
+            if(atomicOf(entries[slot].key).compare_exchange_strong(found, key,
+                    std::memory_order_relaxed))
+            {
+                found = key;
+            }
+        }
+        if(found == key)
+        {
+            atomicOf(entries[slot].value).store(value, std::memory_order_release);
+            return true;
+        }
+        slot = (slot + 1) & map->mask;
+    }
+    return false;
+}
+
+bool
+svmHashMapLookup(const SVMHashMap* map, cl_uint key, cl_uint* value)
+{
+    if(key == SVM_HASH_EMPTY_KEY)
+    {
+        return false;
+    }
+
+    const SVMHashEntry* entries = hashEntries(map);
+    cl_uint slot = svmHashSlot(key, map->mask);
+    for(cl_uint probe = 0; probe <= map->mask; probe++)
+    {
+        cl_uint found = atomicOf(entries[slot].key).load(std::memory_order_relaxed);
+        if(found == key)
+        {
+            cl_uint v = atomicOf(entries[slot].value).load(std::memory_order_acquire);
+            if(v == SVM_HASH_NO_VALUE)
+            {
+                return false;
+            }
+            *value = v;
+            return true;
+        }
+        if(found == SVM_HASH_EMPTY_KEY)
+        {
+            // Keys are never removed, the probe sequence ends here
+            return false;
+        }
+        slot = (slot + 1) & map->mask;
+    }
+    return false;
+}
+
+cl_uint
+svmHashMapSize(const SVMHashMap* map)
+{
+    const SVMHashEntry* entries = hashEntries(map);
+    cl_uint size = 0;
+    for(cl_uint i = 0; i <= map->mask; i++)
+    {
+        if(atomicOf(entries[i].key).load(std::memory_order_relaxed) !=
+                SVM_HASH_EMPTY_KEY)
+        {
+            size++;
+        }
+    }
+    return size;
+}
+
+void
+svmLockFreeRelease(cl_context context, void* structure)
+{
+    if(structure != NULL)
+    {
+        clSVMFree(context, structure);
+    }
+}
@@ -0,0 +1,118 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef SVM_LOCK_FREE_LAYOUT_H_
+#define SVM_LOCK_FREE_LAYOUT_H_
+
+/**
+ * Layout of the lock-free structures shared by host threads and kernels
+ * through fine-grain SVM with atomics. Included by SVMLockFree.hpp on the
+ * host and by SVMLockFree.cl on the device, so both sides agree on every
+ * offset. A structure is a header followed by its array in the same
+ * allocation, no pointer is stored in SVM.
+ *
+ *   SVMQueue   : bounded multi-producer multi-consumer ring. Every cell has
+ *                a sequence number telling the lap it is ready for, so a
+ *                producer and a consumer never touch the same cell at once.
+ *   SVMStack   : Treiber stack over a node pool. The top of the stack and
+ *                of its free list are 64-bit words, node index in the low
+ *                half and a tag incremented by every change in the high
+ *                half, so a node popped and pushed back (ABA) makes the
+ *                compare-exchange of a stale top fail.
+ *   SVMHashMap : open addressing with linear probing. A slot is claimed by
+ *                a compare-exchange of its key, its value is published
+ *                after. Keys are never removed.
+ *
+ * The counters of the header are one per cache line, producers and
+ * consumers do not share a line.
+ */
+
+#ifdef __OPENCL_VERSION__
+typedef uint  svm_uint;
+typedef ulong svm_ulong;
+#else
+typedef cl_uint  svm_uint;
+typedef cl_ulong svm_ulong;
+#endif
+
+#define SVM_LINE_UINTS      16          /**< 64-byte cache line */
+
+#define SVM_STACK_NIL       0xFFFFFFFFu /**< No node */
+#define SVM_HASH_EMPTY_KEY  0u          /**< Key of a free slot, not insertable */
+#define SVM_HASH_NO_VALUE   0xFFFFFFFFu /**< Value not published yet */
+
+/**
+* First slot of a key in a table of mask + 1 slots, murmur3 finalizer
+*/
+static inline svm_uint
+svmHashSlot(svm_uint key, svm_uint mask)
+{
+    key ^= key >> 16;
+    key *= 0x85ebca6bu;
+    key ^= key >> 13;
+    key *= 0xc2b2ae35u;
+    key ^= key >> 16;
+    return key & mask;
+}
+
+typedef struct
+{
+    svm_uint sequence;                  /**< Position the cell is ready for */
+    svm_uint value;
+} SVMQueueCell;
+
+typedef struct
+{
+    svm_uint enqueuePos;                /**< Next position to fill */
+    svm_uint pad0[SVM_LINE_UINTS - 1];
+    svm_uint dequeuePos;                /**< Next position to empty */
+    svm_uint pad1[SVM_LINE_UINTS - 1];
+    svm_uint mask;                      /**< Capacity - 1, capacity a power of 2 */
+    svm_uint pad2[SVM_LINE_UINTS - 1];
+    /* SVMQueueCell cells[mask + 1] */
+} SVMQueue;
+
+typedef struct
+{
+    svm_uint next;                      /**< Node below, SVM_STACK_NIL at the bottom */
+    svm_uint value;
+} SVMStackNode;
+
+typedef struct
+{
+    svm_ulong top;                      /**< Tag << 32 | index of the top node */
+    svm_ulong pad0[SVM_LINE_UINTS / 2 - 1];
+    svm_ulong freeTop;                  /**< Same for the unused nodes */
+    svm_ulong pad1[SVM_LINE_UINTS / 2 - 1];
+    svm_uint capacity;                  /**< Nodes of the pool */
+    svm_uint pad2[SVM_LINE_UINTS - 1];
+    /* SVMStackNode nodes[capacity] */
+} SVMStack;
+
+typedef struct
+{
+    svm_uint key;
+    svm_uint value;
+} SVMHashEntry;
+
+typedef struct
+{
+    svm_uint mask;                      /**< Slots - 1, slots a power of 2 */
+    svm_uint pad0[SVM_LINE_UINTS - 1];
+    /* SVMHashEntry entries[mask + 1] */
+} SVMHashMap;
+
+#endif  // SVM_LOCK_FREE_LAYOUT_H_
@@ -0,0 +1,115 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef SVM_LOCK_FREE_H_
+#define SVM_LOCK_FREE_H_
+
+/**
+ * Host side of the lock-free SVM structures described in SVMLockFree.h.
+ * Every function can run concurrently with other host threads and with
+ * kernels using the device side in SVMLockFree.cl on the same structure :
+ * the structures live in fine-grain SVM allocated with CL_MEM_SVM_ATOMICS,
+ * and both sides use the same acquire / release orders, the device at
+ * memory_scope_all_svm_devices.
+ */
+
+#include <CL/cl.h>
+#include "SVMLockFree.h"
+
+/**
+* Allocates and initializes a queue of 'capacity' values, rounded up to a
+* power of 2
+* @return NULL on failure
+*/
+SVMQueue* svmQueueCreate(cl_context context, cl_uint capacity);
+
+/**
+* Empties a queue, no other thread or kernel may use it meanwhile
+*/
+void svmQueueReset(SVMQueue* queue);
+
+/**
+* Appends a value
+* @return false when the queue is full
+*/
+bool svmQueueEnqueue(SVMQueue* queue, cl_uint value);
+
+/**
+* Removes the oldest value
+* @return false when the queue is empty
+*/
+bool svmQueueDequeue(SVMQueue* queue, cl_uint* value);
+
+/**
+* Allocates and initializes a stack of at most 'capacity' values
+* @return NULL on failure
+*/
+SVMStack* svmStackCreate(cl_context context, cl_uint capacity);
+
+/**
+* Empties a stack, no other thread or kernel may use it meanwhile
+*/
+void svmStackReset(SVMStack* stack);
+
+/**
+* Pushes a value
+* @return false when every node is in use
+*/
+bool svmStackPush(SVMStack* stack, cl_uint value);
+
+/**
+* Pops the last pushed value
+* @return false when the stack is empty
+*/
+bool svmStackPop(SVMStack* stack, cl_uint* value);
+
+/**
+* Allocates and initializes a hash map of 'slots' entries, rounded up to a
+* power of 2
+* @return NULL on failure
+*/
+SVMHashMap* svmHashMapCreate(cl_context context, cl_uint slots);
+
+/**
+* Removes every key, no other thread or kernel may use the map meanwhile
+*/
+void svmHashMapReset(SVMHashMap* map);
+
+/**
+* Inserts a key or replaces its value. SVM_HASH_EMPTY_KEY and
+* SVM_HASH_NO_VALUE are reserved.
+* @return false when the map is full or the key or value is reserved
+*/
+bool svmHashMapInsert(SVMHashMap* map, cl_uint key, cl_uint value);
+
+/**
+* Value of a key. A key whose insertion has not published its value yet is
+* not found.
+* @return false when the key is not in the map
+*/
+bool svmHashMapLookup(const SVMHashMap* map, cl_uint key, cl_uint* value);
+
+/**
+* Number of keys, not synchronized with concurrent insertions
+*/
+cl_uint svmHashMapSize(const SVMHashMap* map);
+
+/**
+* Frees a queue, stack or hash map
+*/
+void svmLockFreeRelease(cl_context context, void* structure);
+
+#endif  // SVM_LOCK_FREE_H_
@@ -66,8 +66,128 @@ void* clExecutionThread(void *data1)
 	return NULL;
 }
 
+/**
+ * Work of one host thread in the wavefront reference. Thread k computes
+ * time steps k, k + threads, ... and starts row (or plane) o of step s
+ * only after step s-1 has finished row o+1, so two field buffers are
+ * enough for any number of steps in flight.
+ */
+struct WavefrontData
+{
+	cl_float*                    field[2];
+	const cl_float*              cond;
+	const unsigned int*          control;
+	cl_uint                      sizex;
+	cl_uint                      sizey;
+	cl_uint                      sizez;
+	int                          steps;
+	int                          threads;
+	int                          thread;
+	std::atomic<long long>*      progress;  /* step*(outer+1) + finished rows, per thread */
+};
+
+static int numCPUCores()
+{
+	int cores = (int)std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+static void pdeRowCPU(const WavefrontData* d, int o, const cl_float* prevField, cl_float* nextField)
+{
+	int exSizeX = d->sizex + PAD_SIZE;
+	int exSizeY = d->sizey + PAD_SIZE;
+
+	if(d->sizez > 1)
+	{
+		//plane z = o + 1 of a 3-D grid
+		int plane = exSizeX*exSizeY;
+		for(int y = 1; y <= (int)d->sizey; ++y)
+		{
+			int rowOffset = ((o + 1)*exSizeY + y)*exSizeX;
+			for(int x = 1; x <= (int)d->sizex; ++x)
+			{
+				int c = rowOffset + x;
+
+				float laplacian = prevField[c - exSizeX] + prevField[c - 1] +
+								prevField[c + exSizeX] + prevField[c + 1];
+				laplacian = laplacian + prevField[c - plane] + prevField[c + plane];
+				laplacian = laplacian - (float)6.0*prevField[c];
+
+				if (d->control[c] == GPU_UPDATE)
+					nextField[c] = d->cond[c]*laplacian + prevField[c];
+				else
+					nextField[c] = prevField[c];
+			}
+		}
+		return;
+	}
+
+	//row y = o + 1 of a 2-D grid
+	int rowOffset = (o + 1)*exSizeX;
+	for(int x = 1; x <= (int)d->sizex; ++x)
+	{
+		int c = rowOffset + x;
+
+		//heat equation
+		float laplacian = prevField[c - exSizeX] + prevField[c - 1] +
+						prevField[c + exSizeX] + prevField[c + 1];
+
+		laplacian = laplacian - (float)4.0*prevField[c];
+
+		if (d->control[c] == GPU_UPDATE)
+			nextField[c] = d->cond[c]*laplacian + prevField[c];
+		else
+			nextField[c] = prevField[c];
+	}
+}
+
+void* wavefrontThread(void* data)
+{
+	const WavefrontData* d = (const WavefrontData*)data;
+	long long outer = d->sizez > 1 ? d->sizez : d->sizey;
+
+	for(int s = d->thread; s < d->steps; s += d->threads)
+	{
+		const cl_float* prevField = d->field[s%2];
+		cl_float*       nextField = d->field[(s + 1)%2];
+		std::atomic<long long>& previous = d->progress[(s + d->threads - 1)%d->threads];
+
+		for(long long o = 0; o < outer; ++o)
+		{
+			if(s > 0)
+			{
+				long long needed = (s - 1)*(outer + 1) + (o + 2 < outer ? o + 2 : outer);
+				while(previous.load(std::memory_order_acquire) < needed)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			pdeRowCPU(d, (int)o, prevField, nextField);
+			d->progress[d->thread].store(s*(outer + 1) + o + 1, std::memory_order_release);
+		}
+	}
+	return NULL;
+}
+
 int HeatPDE::setupHeatPDE()
 {
+	if(sizex < 16 || sizey < 16 || sizez < 1 || (sizez > 1 && sizez < 4))
+	{
+		std::cout << "Error: grid must be at least 16 x 16 (x 4 in 3-D)" << std::endl;
+		return SDK_FAILURE;
+	}
+
+	exSizeX       = sizex + PAD_SIZE;
+	exSizeY       = sizey + PAD_SIZE;
+	exSizeZ       = sizez > 1 ? sizez + PAD_SIZE : 1;
+	condFieldSize = exSizeX*exSizeY*exSizeZ;
+
+	if(cpuThreads <= 0)
+	{
+		cpuThreads = numCPUCores();
+	}
+
 	/* define conductivity field */
 	pCondField = (cl_float *)malloc(condFieldSize*sizeof(cl_float));
 	CHECK_ALLOCATION(pCondField,"memory allocation failure.(pCondField)");
@@ -77,18 +197,10 @@ int HeatPDE::setupHeatPDE()
 	for(unsigned int i = 0; i < condFieldSize; ++i)
 	pCondField[i] = cond;
 
-	pHeatImage = (cl_uint *)malloc(condFieldSize*sizeof(cl_uint));
-	CHECK_ALLOCATION(pCondField,"memory allocation failure.(pHeatImage)");
+	/* the image shows the 2-D field only */
+	pHeatImage = (cl_uint *)calloc(exSizeX*exSizeY, sizeof(cl_uint));
+	CHECK_ALLOCATION(pHeatImage,"memory allocation failure.(pHeatImage)");
 
-	for(unsigned int y = 0; y < sizey +PAD_SIZE; ++y)
-	{
-		unsigned int offset = y*(sizex +PAD_SIZE);
-		pHeatImage[offset]  = 0;
-		for(unsigned int x = 1; x < sizex + PAD_SIZE; ++x)
-		{
-			pHeatImage[offset + x] = 0;
-		}
-	}
 	return SDK_SUCCESS;
 }
 
@@ -109,6 +221,16 @@ int HeatPDE::setupBurnersAndSensors()
 	cl_uint distX = sizex/(burnerCountX);
 	cl_uint distY = sizey/(burnerCountY);
 
+	//keep burners apart on small grids
+	if(burnerSizeX > (cl_int)distX/4)
+	{
+		burnerSizeX = distX/4 > 0 ? distX/4 : 1;
+	}
+	if(burnerSizeY > (cl_int)distY/4)
+	{
+		burnerSizeY = distY/4 > 0 ? distY/4 : 1;
+	}
+
 	for(cl_uint count = 0; count < burnerCountX; ++count)
 	{
 		pBurnerPosX[count] = count*distX + distX/2;
@@ -119,6 +241,11 @@ int HeatPDE::setupBurnersAndSensors()
 		pBurnerPosY[count] = count*distY + distY/2;
 	}
 
+	for(cl_uint count = 0; count < burnerCountX*burnerCountY; ++count)
+	{
+		pBurnerState[count] = BURNER_ON;
+	}
+
 	for(cl_uint count = 0; count < sensorCountX; ++count)
 	{
 		pSensorPosX[count] = pBurnerPosX[count] + distX/2;
@@ -269,12 +396,53 @@ int HeatPDE::setupCL(void)
 			&status);
 	CHECK_OPENCL_ERROR(status, "clCreateCommandQueue failed.");
 
+	/* tile of a work-group and time steps per launch, the tile and its
+	   halo of timeBlock cells are kept in local memory twice plus the
+	   conductivity */
+	if(sizez > 1)
+	{
+		tileX = TILE_X_3D;
+		tileY = TILE_Y_3D;
+		tileZ = TILE_Z_3D;
+	}
+	else
+	{
+		tileX = TILE_X_2D;
+		tileY = TILE_Y_2D;
+		tileZ = 1;
+	}
+
+	if(timeBlock == 0)
+	{
+		timeBlock = sizez > 1 ? TIME_BLOCK_3D : TIME_BLOCK_2D;
+	}
+
+	while(timeBlock > 1)
+	{
+		cl_ulong localX = tileX + 2*timeBlock;
+		cl_ulong localY = tileY + 2*timeBlock;
+		cl_ulong localZ = sizez > 1 ? tileZ + 2*timeBlock : 1;
+		if(3*localX*localY*localZ*sizeof(cl_float) <= deviceInfo.localMemSize)
+		{
+			break;
+		}
+		timeBlock--;
+	}
+
 	// create a CL program using the kernel source
 	buildProgramData buildData;
 	buildData.kernelName = std::string("HeatPDE_Kernels.cl");
 	buildData.devices    = devices;
 	buildData.deviceId   = sampleArgs->deviceId;
-	buildData.flagsStr   = std::string("-I. -cl-std=CL2.0");
+	buildData.flagsStr   = std::string("-I. -cl-std=CL2.0")
+						+ " -D TILE_X=" + toString(tileX, std::dec)
+						+ " -D TILE_Y=" + toString(tileY, std::dec)
+						+ " -D TILE_Z=" + toString(tileZ, std::dec)
+						+ " -D TB=" + toString(timeBlock, std::dec);
+	if(sizez > 1)
+	{
+		buildData.flagsStr += " -D HEAT_3D";
+	}
   
 	if(sampleArgs->isLoadBinaryEnabled())
 	{
@@ -296,6 +464,18 @@ int HeatPDE::setupCL(void)
 	tempToRgbKernel = clCreateKernel(program, "tempToRgbKernel", &status);
 	CHECK_OPENCL_ERROR(status, "clCreateKernel::tempToRgbKernel failed.");
 
+	sensorKernel = clCreateKernel(program, "sensorKernel", &status);
+	CHECK_OPENCL_ERROR(status, "clCreateKernel::sensorKernel failed.");
+
+	status = kernelInfo.setKernelWorkGroupInfo(pdeKernel,
+				devices[sampleArgs->deviceId]);
+	CHECK_ERROR(status, SDK_SUCCESS, "KernelWorkGroupInfo::setKernelWorkGroupInfo() failed");
+
+	if(kernelInfo.kernelWorkGroupSize < tileX*tileY*tileZ)
+	{
+		OPENCL_EXPECTED_ERROR("Unsupported device! Work-group of the pdeKernel tile is too large");
+	}
+
 	/* conductivity field */
 	clCondField = clCreateBuffer(context,
 					CL_MEM_READ_ONLY,
@@ -317,7 +497,7 @@ int HeatPDE::setupCL(void)
 
 	clHeatImage = clCreateBuffer(context,
 					CL_MEM_READ_WRITE,
-					sizeof(cl_uint)*condFieldSize,
+					sizeof(cl_uint)*exSizeX*exSizeY,
 					NULL,
 					&status);
 	CHECK_OPENCL_ERROR(status,"clCreateBuffer Failed.(clHeatImage)");
@@ -346,6 +526,41 @@ int HeatPDE::setupCL(void)
 		return SDK_FAILURE;
 	}
 
+	/* sensor cells and their sampled values */
+	cl_uint sensorCount = sensorCountX*sensorCountY;
+
+	pSensorIndex = (cl_uint*)clSVMAlloc(context,
+				CL_MEM_READ_ONLY|CL_MEM_SVM_FINE_GRAIN_BUFFER,
+				sizeof(cl_uint)*sensorCount,
+				0);
+
+	if(NULL == pSensorIndex)
+	{
+		std::cout << "SVM Buffer allocation failed.(pSensorIndex)" << std::endl;
+		return SDK_FAILURE;
+	}
+
+	pSensorValue = (cl_float*)clSVMAlloc(context,
+				CL_MEM_READ_WRITE|CL_MEM_SVM_FINE_GRAIN_BUFFER,
+				sizeof(cl_float)*sensorCount,
+				0);
+
+	if(NULL == pSensorValue)
+	{
+		std::cout << "SVM Buffer allocation failed.(pSensorValue)" << std::endl;
+		return SDK_FAILURE;
+	}
+
+	//in 3-D the sensors sit in the middle plane
+	cl_uint sensorZ = sizez > 1 ? sizez/2 + 1 : 0;
+	for(cl_uint i = 0; i < sensorCount; ++i)
+	{
+		cl_uint sensorY = i/sensorCountX;
+		cl_uint sensorX = i - sensorY*sensorCountX;
+		pSensorIndex[i] = cellIndex(pSensorPosX[sensorX], pSensorPosY[sensorY], sensorZ);
+		pSensorValue[i] = 0.0f;
+	}
+
 	return SDK_SUCCESS;
 }
 
@@ -360,18 +575,12 @@ int HeatPDE::setupInitialConditions(void)
 	memset(pSVMControlBuf, GPU_UPDATE, sizeof(unsigned int)*condFieldSize);
 	pControlField = pSVMControlBuf;
 
+	memset(pPingHeatField, 0, sizeof(cl_float)*condFieldSize);
+	memset(pPongHeatField, 0, sizeof(cl_float)*condFieldSize);
 
-	for(cl_uint y = 0; y < sizey+PAD_SIZE; ++y)
-	{
-		cl_uint row_offest = y*(sizex+PAD_SIZE);
-		for(cl_uint x = 0; x < sizex+PAD_SIZE; ++x)
-		{
-		pPingHeatField[row_offest + x] = 0.0;
-		pPongHeatField[row_offest + x] = 0.0;
-		}
-	}
-
-	//burners
+	//burners, in 3-D they run through all planes
+	cl_uint zBegin = sizez > 1 ? 1 : 0;
+	cl_uint zEnd   = sizez > 1 ? sizez : 0;
  
 	for(cl_uint countY = 0; countY < burnerCountY; ++countY)
 	{
@@ -380,14 +589,17 @@ int HeatPDE::setupInitialConditions(void)
   		{
   		cl_uint posX = pBurnerPosX[countX];
 	  
-  			for(cl_int y = -burnerSizeY; y < burnerSizeY; ++y)
+			for(cl_uint z = zBegin; z <= zEnd; ++z)
 			{
-				cl_uint offset = (posY+y)*(sizex+PAD_SIZE);
-				for(cl_int x = -burnerSizeX; x < burnerSizeX; ++x)
+  				for(cl_int y = -burnerSizeY; y < burnerSizeY; ++y)
 				{
-				pPingHeatField[offset + posX +x] = BURNER_HEAT;
-				pPongHeatField[offset + posX +x] = BURNER_HEAT;
-				pControlField[offset + posX +x] = CPU_UPDATE;
+					cl_uint offset = cellIndex(posX, posY + y, z);
+					for(cl_int x = -burnerSizeX; x < burnerSizeX; ++x)
+					{
+					pPingHeatField[offset +x] = BURNER_HEAT;
+					pPongHeatField[offset +x] = BURNER_HEAT;
+					pControlField[offset +x] = CPU_UPDATE;
+					}
 				}
 			}
 		}
@@ -401,7 +613,7 @@ int HeatPDE::feedbackAndControl(void)
 	int status           = SDK_SUCCESS;
 	cl_uchar burnerState = CPU_UPDATE;
 
-	//get the sensor data as feedback 
+	//get the sensor data as feedback, sampled on the device by sensorKernel
 	for(cl_uint i = 0; i < sensorCountX*sensorCountY; ++i)
 	{
 		//check if the sensor is present
@@ -411,12 +623,7 @@ int HeatPDE::feedbackAndControl(void)
 		cl_uint sensorY    = i/sensorCountX;
 		cl_uint sensorX    = i - sensorY*sensorCountX;
 
-		cl_uint sensorPosX = pSensorPosX[sensorX];
-		cl_uint sensorPosY = pSensorPosY[sensorY];
-
-		cl_uint sensorPos  = sensorPosY*(sizex+PAD_SIZE) + sensorPosX;
-
-		pSensorData[i]     = pPingHeatField[sensorPos];
+		pSensorData[i]     = pSensorValue[i];
 
 		//switch burners on or off based on feedback. 
 			if(pSensorData[i] < pSensorMin[i])
@@ -447,6 +654,9 @@ int HeatPDE::feedbackAndControl(void)
 	}
 
 	//make the burners on
+	cl_uint zBegin = sizez > 1 ? 1 : 0;
+	cl_uint zEnd   = sizez > 1 ? sizez : 0;
+
 	for(cl_uint countY = 0; countY < burnerCountY; ++countY)
 	{
 		cl_uint posY         = pBurnerPosY[countY];
@@ -456,21 +666,24 @@ int HeatPDE::feedbackAndControl(void)
   		cl_uint  posX         = pBurnerPosX[countX];
 		cl_uchar burnerState  = pBurnerState[countOffset +countX];
 
-  			for(cl_int y = -burnerSizeY; y < burnerSizeY; ++y)
+			for(cl_uint z = zBegin; z <= zEnd; ++z)
 			{
-				cl_uint offset = (posY+y)*(sizex+PAD_SIZE);
-				for(cl_int x = -burnerSizeX; x < burnerSizeX; ++x)
+  				for(cl_int y = -burnerSizeY; y < burnerSizeY; ++y)
 				{
-					if(burnerState == BURNER_ON)
+					cl_uint offset = cellIndex(posX, posY + y, z);
+					for(cl_int x = -burnerSizeX; x < burnerSizeX; ++x)
 					{
-					  std::atomic_store((std::atomic<int>*)&pControlField[offset + posX +x], CPU_UPDATE);
-					  pPingHeatField[offset + posX +x] = BURNER_HEAT;
-					  pPongHeatField[offset + posX +x] = BURNER_HEAT;
+						if(burnerState == BURNER_ON)
+						{
+						  std::atomic_store((std::atomic<int>*)&pControlField[offset +x], CPU_UPDATE);
+						  pPingHeatField[offset +x] = BURNER_HEAT;
+						  pPongHeatField[offset +x] = BURNER_HEAT;
+						}
+						else
+						{
+						  std::atomic_store((std::atomic<int>*)&pControlField[offset +x], GPU_UPDATE);
+						}					
 					}
-					else
-					{
-					  std::atomic_store((std::atomic<int>*)&pControlField[offset + posX +x], GPU_UPDATE);
-					}					
 				}
 			}
 		}
@@ -498,7 +711,11 @@ int HeatPDE::runCLKernels(void)
 	cl_int    status;
 	cl_float* pTempBuf;
 
-	size_t    globalThreads[] = {sizex,sizey};
+	/* one work-item per cell, the tiles load their halo themselves */
+	size_t    localThreads[]  = {tileX, tileY, tileZ};
+	size_t    globalThreads[] = {((sizex + tileX - 1)/tileX)*tileX,
+								 ((sizey + tileY - 1)/tileY)*tileY,
+								 sizez > 1 ? ((sizez + tileZ - 1)/tileZ)*tileZ : 1};
 
 	/* Set kernel arguments */
 	status = clSetKernelArg(pdeKernel,
@@ -511,53 +728,106 @@ int HeatPDE::runCLKernels(void)
 				1,
 				sizeof(cl_int),
 				(void *)(&sizey));
-	CHECK_OPENCL_ERROR(status, "clSetKernelArg(sizex) failed.");
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg(sizey) failed.");
 
 	status = clSetKernelArg(pdeKernel,
 				2,
+				sizeof(cl_int),
+				(void *)(&sizez));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg(sizez) failed.");
+
+	status = clSetKernelArg(pdeKernel,
+				3,
 				sizeof(cl_mem),
 				(void *)(&clCondField));
 	CHECK_OPENCL_ERROR(status, "clSetKernelArg(clCondField) failed.");
 
-	for(cl_uint i = 0; i < pde_iter; ++i)
-	{
 	status = clSetKernelArgSVMPointer(pdeKernel,
-						3,
-						(void *)(pPingHeatField));
-	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(pPingHeatField) failed.");
+					6,
+					(unsigned int *)(pSVMControlBuf));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(pSVMControlBuf) failed.");
+
+	/* timeBlock steps per launch, the last launch takes the remainder */
+	launches = 0;
+	for(cl_uint i = 0; i < pde_iter; i += timeBlock)
+	{
+	cl_int steps = (cl_int)(pde_iter - i < timeBlock ? pde_iter - i : timeBlock);
 
 	status = clSetKernelArgSVMPointer(pdeKernel,
 						4,
-						(void *)(pPongHeatField));
+						(void *)(pPingHeatField));
 	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(pPingHeatField) failed.");
-	
+
 	status = clSetKernelArgSVMPointer(pdeKernel,
 						5,
-						(unsigned int *)(pSVMControlBuf));
-	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(pSVMControlBuf) failed.");
+						(void *)(pPongHeatField));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(pPongHeatField) failed.");
+
+	status = clSetKernelArg(pdeKernel,
+				7,
+				sizeof(cl_int),
+				(void *)(&steps));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg(steps) failed.");
 
-	cl_event ndrEvt;
 	status = clEnqueueNDRangeKernel(commandQueue,
 					pdeKernel,
-					2,
+					3,
 					NULL,
 					globalThreads,
+					localThreads,
+					0,
+					NULL,
+					NULL);
+	CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+	launches++;
+	
+	pTempBuf       = pPingHeatField;
+	pPingHeatField = pPongHeatField;
+	pPongHeatField = pTempBuf;
+	}
+
+	/* sample the sensors, the feedback thread reads only these values */
+	cl_uint sensorCount = sensorCountX*sensorCountY;
+
+	status = clSetKernelArgSVMPointer(sensorKernel,
+					0,
+					(void *)(pPingHeatField));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(pPingHeatField) failed.");
+
+	status = clSetKernelArgSVMPointer(sensorKernel,
+					1,
+					(void *)(pSensorIndex));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(pSensorIndex) failed.");
+
+	status = clSetKernelArgSVMPointer(sensorKernel,
+					2,
+					(void *)(pSensorValue));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(pSensorValue) failed.");
+
+	status = clSetKernelArg(sensorKernel,
+				3,
+				sizeof(cl_uint),
+				(void *)(&sensorCount));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg(sensorCount) failed.");
+
+	size_t sensorThreads = sensorCount;
+	cl_event ndrEvt;
+	status = clEnqueueNDRangeKernel(commandQueue,
+					sensorKernel,
+					1,
+					NULL,
+					&sensorThreads,
 					NULL,
 					0,
 					NULL,
 					&ndrEvt);
 	CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
-	
+
 	status = clFlush(commandQueue);
 	CHECK_OPENCL_ERROR(status, "clFlush failed.(commandQueue)");
 	
 	status = waitForEventAndRelease(&ndrEvt);
 	CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
-	
-	pTempBuf       = pPingHeatField;
-	pPingHeatField = pPongHeatField;
-	pPongHeatField = pTempBuf;
-	}
 
 	if(isGUI)
 	{
@@ -606,7 +876,7 @@ int HeatPDE::runCLKernels(void)
 					clHeatImage,
 					CL_TRUE,
 					0,
-					sizeof(cl_uint)*condFieldSize,
+					sizeof(cl_uint)*exSizeX*exSizeY,
 					(void *)pHeatImage,
 					0,
 					NULL,
@@ -620,33 +890,35 @@ int HeatPDE::runCLKernels(void)
 int HeatPDE::cpuReference()
 {  
 	unsigned int svmBufSize = 2*condFieldSize;
-	cl_float* pTempBuf;
 
 	int timer = sampleTimer->createTimer();
 	
 	pHeatfield = (cl_float *)malloc(sizeof(cl_float)*svmBufSize);
+	CHECK_ALLOCATION(pHeatfield, "memory allocation failure.(pHeatfield)");
+
+	unsigned int* pControlField_CPU = (unsigned int *)malloc(sizeof(unsigned int)*condFieldSize);
+	CHECK_ALLOCATION(pControlField_CPU, "memory allocation failure.(pControlField_CPU)");
+
+	int threads = cpuThreads < (int)pde_iter ? cpuThreads : (int)pde_iter;
+	if(threads < 1)
+	{
+		threads = 1;
+	}
+	std::atomic<long long>* progress = new std::atomic<long long>[threads];
+	WavefrontData* work = new WavefrontData[threads];
+	SDKThread* workers = new SDKThread[threads - 1];
 		  
 	for(int iter_CPU = 0 ; iter_CPU < (iterations) ; iter_CPU++)
 	{
- 
-		float * pCondField_cpu = (float *) pCondField ;
-
 		float *pPingHeatField_CPU = (cl_float *)(pHeatfield);
 		float * pPongHeatField_CPU =  pPingHeatField_CPU + condFieldSize;
 
-		memset(pSVMControlBuf, GPU_UPDATE, sizeof(unsigned int)*condFieldSize);
-		pControlField = pSVMControlBuf;
-
-		for(cl_uint y = 0; y < sizey +PAD_SIZE; ++y)
-		{
-			cl_uint row_offest = y*(sizex+PAD_SIZE);
-			for(cl_uint x = 0; x < sizex+PAD_SIZE; ++x)
-			{
-			pPingHeatField_CPU[row_offest + x] = 0.0;
-			pPongHeatField_CPU[row_offest + x] = 0.0;
-			}
-		}
+		memset(pControlField_CPU, GPU_UPDATE, sizeof(unsigned int)*condFieldSize);
+		memset(pPingHeatField_CPU, 0, sizeof(cl_float)*condFieldSize);
+		memset(pPongHeatField_CPU, 0, sizeof(cl_float)*condFieldSize);
 
+		cl_uint zBegin = sizez > 1 ? 1 : 0;
+		cl_uint zEnd   = sizez > 1 ? sizez : 0;
 
 		for(cl_uint countY = 0; countY < burnerCountY; ++countY)
 		{
@@ -655,73 +927,66 @@ int HeatPDE::cpuReference()
   			{
   			cl_uint posX = pBurnerPosX[countX];
 	  
-  				for(cl_int y = -burnerSizeY; y < burnerSizeY; ++y)
+				for(cl_uint z = zBegin; z <= zEnd; ++z)
 				{
-					cl_uint offset = (posY+y)*(sizex+PAD_SIZE);
-					for(cl_int x = -burnerSizeX; x < burnerSizeX; ++x)
+  					for(cl_int y = -burnerSizeY; y < burnerSizeY; ++y)
 					{
-					pPingHeatField_CPU[offset + posX +x] = BURNER_HEAT;
-					pPongHeatField_CPU[offset + posX +x] = BURNER_HEAT;
-					pControlField[offset + posX +x] = CPU_UPDATE;
+						cl_uint offset = cellIndex(posX, posY + y, z);
+						for(cl_int x = -burnerSizeX; x < burnerSizeX; ++x)
+						{
+						pPingHeatField_CPU[offset +x] = BURNER_HEAT;
+						pPongHeatField_CPU[offset +x] = BURNER_HEAT;
+						pControlField_CPU[offset +x] = CPU_UPDATE;
+						}
 					}
 				}
 			}
 		}
 
+		for(int t = 0; t < threads; ++t)
+		{
+			progress[t].store(-1);
+			work[t].field[0] = pPingHeatField_CPU;
+			work[t].field[1] = pPongHeatField_CPU;
+			work[t].cond     = pCondField;
+			work[t].control  = pControlField_CPU;
+			work[t].sizex    = sizex;
+			work[t].sizey    = sizey;
+			work[t].sizez    = sizez;
+			work[t].steps    = (int)pde_iter;
+			work[t].threads  = threads;
+			work[t].thread   = t;
+			work[t].progress = progress;
+		}
+
 		sampleTimer->resetTimer(timer);
 		sampleTimer->startTimer(timer);
 
-		for(int pdeIter= 0 ; pdeIter < ((int)pde_iter);pdeIter++)
+		// the calling thread takes the last share
+		for(int t = 0; t < threads - 1; ++t)
 		{
-			//No support for OpenMP 3.0 and higher in MSVC yet. Hence the below check
-#if defined(_MSC_VER) 
-			#pragma omp parallel for 
-#else
-			#pragma omp parallel for collapse(2)
-#endif
-			for(int row_x=0 ; row_x < (int)(sizex) ;row_x++)
-			{
-				for(int row_y=0 ; row_y < (int)(sizey) ;row_y++)
-				{
-					int x     = row_x + 1;
-					int y     = row_y + 1;
-					int sizeX = sizex;
-					int sizeY = sizey;
-  
-					int exSizeX = sizex + PAD_SIZE;
-					int exSizeY = sizey + PAD_SIZE;
-
-					int c = y*exSizeX + x;
-					int t = (y-1)*exSizeX + x;
-					int l = c -1;
-					int b = (y+1)*exSizeX + x;
-					int r = c +1;
-
-				  
-					float *prevField     = (float *)pPingHeatField_CPU;
-					float *nextField     = (float *)pPongHeatField_CPU;
-					
-					//heat equation
-					float laplacian = prevField[t] + prevField[l] +  
-									prevField[b] + prevField[r];  
-
-					laplacian = laplacian - (float)4.0*prevField[c];
-
-					if (pControlField[c] == GPU_UPDATE)
-						nextField[c] = pCondField_cpu[c]*laplacian + prevField[c]; 
-					else
-						nextField[c] = prevField[c]; 						
-				}
-			}
-		
-			pTempBuf			 = pPingHeatField_CPU;
-			pPingHeatField_CPU = pPongHeatField_CPU;
-			pPongHeatField_CPU = pTempBuf;
+			workers[t].create(::wavefrontThread, (void *)(work + t));
+		}
+		wavefrontThread(work + threads - 1);
+		for(int t = 0; t < threads - 1; ++t)
+		{
+			workers[t].join();
 		}
 
 		sampleTimer->stopTimer(timer);
 		cpuRunTime += (cl_double)sampleTimer->readTimer(timer);
 	}
+
+	// keep the final field at the start of pHeatfield
+	if(pde_iter%2)
+	{
+		memcpy(pHeatfield, pHeatfield + condFieldSize, sizeof(cl_float)*condFieldSize);
+	}
+
+	delete []workers;
+	delete []work;
+	delete []progress;
+	free(pControlField_CPU);
    
 	return SDK_SUCCESS;
 }
@@ -754,6 +1019,54 @@ int HeatPDE::initialize()
   
 	sampleArgs->AddOption(new_option);
 
+	new_option->_sVersion = "x";
+	new_option->_lVersion = "sizex";
+	new_option->_description = "Grid size in x";
+	new_option->_type = CA_ARG_INT;
+	new_option->_value = &sizex;
+
+	sampleArgs->AddOption(new_option);
+
+	new_option->_sVersion = "y";
+	new_option->_lVersion = "sizey";
+	new_option->_description = "Grid size in y";
+	new_option->_type = CA_ARG_INT;
+	new_option->_value = &sizey;
+
+	sampleArgs->AddOption(new_option);
+
+	new_option->_sVersion = "z";
+	new_option->_lVersion = "sizez";
+	new_option->_description = "Grid size in z (1 = 2-D grid)";
+	new_option->_type = CA_ARG_INT;
+	new_option->_value = &sizez;
+
+	sampleArgs->AddOption(new_option);
+
+	new_option->_sVersion = "s";
+	new_option->_lVersion = "steps";
+	new_option->_description = "Time steps per run";
+	new_option->_type = CA_ARG_INT;
+	new_option->_value = &pde_iter;
+
+	sampleArgs->AddOption(new_option);
+
+	new_option->_sVersion = "tb";
+	new_option->_lVersion = "timeBlock";
+	new_option->_description = "Time steps per kernel launch (default 4 in 2-D, 2 in 3-D)";
+	new_option->_type = CA_ARG_INT;
+	new_option->_value = &timeBlock;
+
+	sampleArgs->AddOption(new_option);
+
+	new_option->_sVersion = "c";
+	new_option->_lVersion = "cpuThreads";
+	new_option->_description = "Threads of the wavefront host reference (default: all cores)";
+	new_option->_type = CA_ARG_INT;
+	new_option->_value = &cpuThreads;
+
+	sampleArgs->AddOption(new_option);
+
 	delete new_option;
   
 	return SDK_SUCCESS;
@@ -773,6 +1086,12 @@ int HeatPDE::setup()
 
 	if(sampleArgs->verify)
 		isGUI = false;
+
+	if(isGUI && sizez > 1)
+	{
+		std::cout << "GUI shows 2-D grids only, running without it" << std::endl;
+		isGUI = false;
+	}
   
 	int timer = sampleTimer->createTimer();
 	sampleTimer->resetTimer(timer);
@@ -843,7 +1162,7 @@ int HeatPDE::compare()
 {
   float        diff;
   unsigned int count = 0;
-  float* pGpuHeatField = (float *)pSVMBuf;
+  float* pGpuHeatField = pPingHeatField;
 
   for(unsigned int i = 0; i < condFieldSize; ++i)
     {
@@ -851,7 +1170,8 @@ int HeatPDE::compare()
       if (diff < 0) 
 	diff = -diff;
 
-      if(diff > EPSILON)
+      float ref = pHeatfield[i] < 0 ? -pHeatfield[i] : pHeatfield[i];
+      if(diff > EPSILON*(ref > 1.0f ? ref : 1.0f))
 	{
 	  std::cout << "[" << i << "]:" << EPSILON*BURNER_HEAT << ":";
 	  std::cout << pHeatfield[i] << ":";
@@ -908,6 +1228,12 @@ int HeatPDE::cleanup()
 
 	if(pSVMBuf)
 		clSVMFree(context,pSVMBuf);
+	if(pSVMControlBuf)
+		clSVMFree(context,pSVMControlBuf);
+	if(pSensorIndex)
+		clSVMFree(context,pSensorIndex);
+	if(pSensorValue)
+		clSVMFree(context,pSensorValue);
 	
 
 	status = clReleaseKernel(pdeKernel);
@@ -917,6 +1243,9 @@ int HeatPDE::cleanup()
 	status = clReleaseKernel(tempToRgbKernel);
 	CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(tempToRgbKernel)");
 
+	status = clReleaseKernel(sensorKernel);
+	CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(sensorKernel)");
+
 	status = clReleaseProgram(program);
 	CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.(program)");
 
@@ -949,25 +1278,43 @@ void HeatPDE::printStats()
 {
     if(sampleArgs->timing)
     {
-        std::string strArray[5] =
+        std::string strArray[11] =
         {
             "Size X",
             "Size Y",
+            "Size Z",
+            "Steps",
+            "Time block",
             "Setup Time(sec)",
             "Avg. kernel time (sec)",
-            "Avg. CPU Execution Time (sec)",
+            "GPU cell updates/sec",
         };
-        std::string stats[5];
+        std::string stats[11];
         double avgKernelTime = kernelTime / iterations;
 	double avgCputime    = cpuRunTime/iterations;
+	double cellUpdates   = (double)sizex*sizey*sizez*pde_iter;
 
         stats[0] = toString(sizex, std::dec);
         stats[1] = toString(sizey, std::dec);
-        stats[2] = toString(setupTime, std::dec);
-        stats[3] = toString(avgKernelTime, std::dec);
-	stats[4] = toString(avgCputime, std::dec);
+        stats[2] = toString(sizez, std::dec);
+        stats[3] = toString(pde_iter, std::dec);
+        stats[4] = toString(timeBlock, std::dec);
+        stats[5] = toString(setupTime, std::dec);
+        stats[6] = toString(avgKernelTime, std::dec);
+        stats[7] = toString(cellUpdates/avgKernelTime, std::dec);
+	int count = 8;
+
+	if(sampleArgs->verify && cpuRunTime > 0)
+	{
+		strArray[count] = "Avg. CPU Execution Time (sec)";
+		stats[count++]  = toString(avgCputime, std::dec);
+		strArray[count] = "CPU Threads";
+		stats[count++]  = toString(cpuThreads, std::dec);
+		strArray[count] = "CPU cell updates/sec";
+		stats[count++]  = toString(cellUpdates/avgCputime, std::dec);
+	}
 		
-        printStatistics(strArray, stats, 5);
+        printStatistics(strArray, stats, count);
     }
 }
 
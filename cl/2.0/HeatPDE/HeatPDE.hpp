@@ -47,6 +47,7 @@ using namespace std;
 
 #define SIZEX                512
 #define SIZEY                256
+#define SIZEZ                1                  /* 1 = 2-D grid */
 #define CONDUCTIVITY         0.2
 #define DS                   0.005f
 #define DT                   0.01f 
@@ -78,6 +79,15 @@ using namespace std;
 
 #define PAD_SIZE			 2
 
+/* temporal blocking: work-group tile and time steps per launch */
+#define TILE_X_2D            32
+#define TILE_Y_2D            8
+#define TILE_X_3D            16
+#define TILE_Y_3D            4
+#define TILE_Z_3D            4
+#define TIME_BLOCK_2D        4
+#define TIME_BLOCK_3D        2
+
 #define GUI_WINDOW_WIDTH     1024
 #define GUI_WINDOW_HEIGHT    512
 #define GUI_WINDOW_POS_X     100
@@ -114,6 +124,7 @@ private:
   cl_program            program;      
   cl_kernel             pdeKernel;
   cl_kernel             tempToRgbKernel;
+  cl_kernel             sensorKernel;
 
   SDKDeviceInfo         deviceInfo;
   KernelWorkGroupInfo   kernelInfo;
@@ -135,6 +146,10 @@ private:
   unsigned int*	        pSVMControlBuf;
   unsigned int*			pControlField;
 
+  /* sensor cells and the values sampled there by the device (SVM) */
+  cl_uint*              pSensorIndex;
+  cl_float*             pSensorValue;
+
   /* conductivity field */
   cl_float*             pCondField;
   cl_mem                clCondField;
@@ -145,12 +160,26 @@ private:
   /* simulation constants */
   cl_uint               sizex;
   cl_uint               sizey;
+  cl_uint               sizez;
+  cl_uint               exSizeX;            /* padded sizes */
+  cl_uint               exSizeY;
+  cl_uint               exSizeZ;
   cl_float              ds;
   cl_float              dt;
   cl_uint               pde_iter;
 
   cl_uint               condFieldSize;
 
+  /* temporal blocking */
+  cl_uint               timeBlock;          /* time steps per launch, 0 = default */
+  cl_uint               tileX;
+  cl_uint               tileY;
+  cl_uint               tileZ;
+  cl_uint               launches;           /* kernel launches per run */
+
+  /* host reference */
+  int                   cpuThreads;         /* 0 = all cores */
+
 public:
   CLCommandArgs*        sampleArgs;   
   cl_uint*              pHeatImage;
@@ -186,6 +215,7 @@ public:
 
     sizex                    = SIZEX;
     sizey                    = SIZEY;
+    sizez                    = SIZEZ;
     ds                       = DS;
     dt                       = DT;
     pde_iter                 = PDE_ITER ;  
@@ -200,6 +230,16 @@ public:
 
     condFieldSize            = (sizex +2)*(sizey +2);
 
+    timeBlock                = 0;
+    launches                 = 0;
+    cpuThreads               = 0;
+
+    pSVMBuf                  = NULL;
+    pSVMControlBuf           = NULL;
+    pSensorIndex             = NULL;
+    pSensorValue             = NULL;
+    pHeatfield               = NULL;
+
     isGUI                    = false;
   };
   
@@ -209,6 +249,21 @@ public:
   delete sampleTimer;
   };
 
+  cl_uint getSizeX() { return sizex; }
+  cl_uint getSizeY() { return sizey; }
+
+  /**
+   *************************************************************************
+   * @fn     cellIndex
+   * @brief  Index of a cell in the padded field (z = 0 on a 2-D grid).
+   * @return index
+   *************************************************************************
+   */
+  cl_uint cellIndex(cl_uint x, cl_uint y, cl_uint z)
+  {
+    return (z*exSizeY + y)*exSizeX + x;
+  }
+
   /**
    *************************************************************************
    * @fn     setupHeatPDE
@@ -291,6 +346,8 @@ public:
    * @fn     cpuReference
    * @brief  Executes an equivalent of OpenCL code on host device and 
    *         generates output used to compare with OpenCL code.
+   *         Time steps are pipelined over cpuThreads threads as a
+   *         wavefront, each thread trailing the previous step by two rows.
    *         
    * @return SDK_SUCCESS on success and SDK_FAILURE on failure
    *************************************************************************
@@ -113,19 +113,19 @@ static void displayGL()
 	float frx = 0.45f;
 	float fby = -0.45f;
     
-	float dx  = (frx-flx)/(float)(SIZEX + PAD_SIZE);
-	float dy  = (fty-fby)/(float)(SIZEY + PAD_SIZE);
+	float dx  = (frx-flx)/(float)(clHeatPDE.getSizeX() + PAD_SIZE);
+	float dy  = (fty-fby)/(float)(clHeatPDE.getSizeY() + PAD_SIZE);
 
 	//paint heat field.
 	float y1  = fty;
-	for(unsigned int y = 0; y < SIZEY + PAD_SIZE; ++y)
+	for(unsigned int y = 0; y < clHeatPDE.getSizeY() + PAD_SIZE; ++y)
 	{
-		unsigned int offset = y*(SIZEX+PAD_SIZE);
+		unsigned int offset = y*(clHeatPDE.getSizeX()+PAD_SIZE);
 
 		float y2 = y1 - dy;
 		float x1 = flx;
 
-		for(unsigned int x = 0; x < SIZEX + PAD_SIZE; ++x)
+		for(unsigned int x = 0; x < clHeatPDE.getSizeX() + PAD_SIZE; ++x)
 		{
 
 		float         x2  = x1 + dx;
@@ -29,46 +29,168 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define  GPU_UPDATE      0  
 #define  CPU_UPDATE      1  
 
+/* tile geometry, normally set by the host through build options */
+#ifndef TILE_X
+#define TILE_X          32
+#endif
+#ifndef TILE_Y
+#define TILE_Y          8
+#endif
+#ifndef TILE_Z
+#define TILE_Z          1
+#endif
+#ifndef TB
+#define TB              4               /* time steps per launch (halo width) */
+#endif
+
+#define LX              (TILE_X + 2*TB)
+#define LY              (TILE_Y + 2*TB)
+#ifdef HEAT_3D
+#define LZ              (TILE_Z + 2*TB)
+#else
+#define LZ              1
+#endif
+#define LSIZE           (LX*LY*LZ)
+#define GROUP_SIZE      (TILE_X*TILE_Y*TILE_Z)
+
 /***
- * laplacian:
+ * laplacian, temporally blocked:
+ * every work-group loads its tile plus a halo of TB cells into local
+ * memory and advances it by up to TB time steps before writing back. The
+ * valid part of the tile shrinks by one cell per step, so after TB steps
+ * exactly the centre is still correct. Cells that must not change
+ * (padding and burners under CPU control) get a zero coefficient.
  ***/
-__kernel void pdeKernel(unsigned int          sizex,
-			unsigned int          sizey,
-			__global float*       cField,
-			__global void*        ping,
-			__global void*        pong,
-			volatile __global atomic_int* controlField)
+__kernel __attribute__((reqd_work_group_size(TILE_X, TILE_Y, TILE_Z)))
+void pdeKernel(unsigned int          sizex,
+		unsigned int          sizey,
+		unsigned int          sizez,
+		__global float*       cField,
+		__global void*        ping,
+		__global void*        pong,
+		volatile __global atomic_int* controlField,
+		int                   steps)
 {
-  int x     = get_global_id(0) + 1;
-  int y     = get_global_id(1) + 1;
-  int sizeX = get_global_size(0);
-  int sizeY = get_global_size(1);
-  
-  int exSizeX = sizeX + 2;
-  int exSizeY = sizeY + 2;
-
-  int c = y*exSizeX + x;
-  int t = (y-1)*exSizeX + x;
-  int l = c -1;
-  int b = (y+1)*exSizeX + x;
-  int r = c +1;
+  __local float fieldA[LSIZE];
+  __local float fieldB[LSIZE];
+  __local float coef[LSIZE];
+
+  int exSizeX = sizex + 2;
+  int exSizeY = sizey + 2;
+#ifdef HEAT_3D
+  int exSizeZ = sizez + 2;
+  int z0      = get_group_id(2)*TILE_Z + 1 - TB;
+#else
+  int exSizeZ = 1;
+  int z0      = 0;
+#endif
+  int x0      = get_group_id(0)*TILE_X + 1 - TB;
+  int y0      = get_group_id(1)*TILE_Y + 1 - TB;
+
+  int lid     = (get_local_id(2)*TILE_Y + get_local_id(1))*TILE_X + get_local_id(0);
 
   float *prevField     = (float *)ping;
   float *nextField     = (float *)pong;
-  
-  //heat equation
-  float laplacian = prevField[t] + prevField[l] +  
-                    prevField[b] + prevField[r];  
 
-  laplacian = laplacian - (float)4.0*prevField[c];
+  //load the tile and the halo
+  for(int i = lid; i < LSIZE; i += GROUP_SIZE)
+  {
+    int x = x0 + i%LX;
+    int y = y0 + (i/LX)%LY;
+    int z = z0 + i/(LX*LY);
 
-  int val = atomic_load_explicit(&controlField[c], memory_order_seq_cst, memory_scope_all_svm_devices);
+    float value = 0.0f;
+    float k     = 0.0f;
+    if(x >= 0 && x < exSizeX && y >= 0 && y < exSizeY && z >= 0 && z < exSizeZ)
+    {
+      int c = (z*exSizeY + y)*exSizeX + x;
+      value = prevField[c];
 
-  if (val == GPU_UPDATE)
-	nextField[c] = cField[c]*laplacian + prevField[c];
-  else
-	nextField[c] = prevField[c]; 
-}           
+      bool interior = x >= 1 && x <= (int)sizex && y >= 1 && y <= (int)sizey;
+#ifdef HEAT_3D
+      interior = interior && z >= 1 && z <= (int)sizez;
+#endif
+      if(interior &&
+         atomic_load_explicit(&controlField[c], memory_order_seq_cst, memory_scope_all_svm_devices) == GPU_UPDATE)
+        k = cField[c];
+    }
+    fieldA[i] = value;
+    fieldB[i] = value;
+    coef[i]   = k;
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  __local float* prev = fieldA;
+  __local float* next = fieldB;
+
+  for(int s = 0; s < steps; ++s)
+  {
+    for(int i = lid; i < LSIZE; i += GROUP_SIZE)
+    {
+      int lx = i%LX;
+      int ly = (i/LX)%LY;
+      int lz = i/(LX*LY);
+      if(lx == 0 || lx == LX-1 || ly == 0 || ly == LY-1)
+        continue;
+#ifdef HEAT_3D
+      if(lz == 0 || lz == LZ-1)
+        continue;
+#endif
+
+      //heat equation
+      float laplacian = prev[i - LX] + prev[i - 1] +
+                        prev[i + LX] + prev[i + 1];
+#ifdef HEAT_3D
+      laplacian = laplacian + prev[i - LX*LY] + prev[i + LX*LY];
+      laplacian = laplacian - (float)6.0*prev[i];
+#else
+      laplacian = laplacian - (float)4.0*prev[i];
+#endif
+
+      if(coef[i] != 0.0f)
+        next[i] = coef[i]*laplacian + prev[i];
+      else
+        next[i] = prev[i];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    __local float* temp = prev;
+    prev = next;
+    next = temp;
+  }
+
+  //write back the centre of the tile
+  int x = get_global_id(0) + 1;
+  int y = get_global_id(1) + 1;
+#ifdef HEAT_3D
+  int z = get_global_id(2) + 1;
+  if(z > (int)sizez)
+    return;
+#else
+  int z = 0;
+#endif
+  if(x > (int)sizex || y > (int)sizey)
+    return;
+
+  int i = ((get_local_id(2) + (LZ > 1 ? TB : 0))*LY + get_local_id(1) + TB)*LX
+          + get_local_id(0) + TB;
+  nextField[(z*exSizeY + y)*exSizeX + x] = prev[i];
+}
+
+/***
+ * sensors: copies the field at the sensor cells, the host reads only these
+ ***/
+__kernel void sensorKernel(__global void*         heatField,
+			   __global unsigned int* sensorIndex,
+			   __global float*        sensorValue,
+			   unsigned int           count)
+{
+  unsigned int i = get_global_id(0);
+  float* field   = (float *)heatField;
+
+  if(i < count)
+    sensorValue[i] = field[sensorIndex[i]];
+}
 
 
 __kernel void tempToRgbKernel(unsigned int           sizex,
@@ -19,16 +19,18 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <cmath>
 
 int
-ImageBinarization::calculateThresholdValueOnHost()
+ImageBinarization::calculateThresholdValueOnHost(const cl_uint* bins, double* sigma)
 {
 	double prob[BIN_SIZE], omega[BIN_SIZE];   /* Prob of graylevels */
 	double mu[BIN_SIZE];                      /* Mean value for separation */
-	double max_sigma, sigma[BIN_SIZE];        /* Inter-class variance */
+	double max_sigma;
+	cl_uint pixels = width * height;
+	cl_uint count = 0;                        /* Pixels up to the current bin */
 
 	// Calculation of probability density
 	for (int i = 0; i < binSize; ++i)
 	{
-		prob[i] = (double)deviceBin[i] / (width * height);
+		prob[i] = (double)bins[i] / pixels;
 	}
 
 	// omega and mu generation
@@ -41,11 +43,13 @@ ImageBinarization::calculateThresholdValueOnHost()
 	}
 
 	// sigma maximization, sigma stands for inter-class variance and determines optimal threshold value
-	threshold = 0;
+	// empty classes are detected on the pixel counts, the sums of prob may not reach exactly 1
+	int threshold = 0;
 	max_sigma = 0.0;
 	for (int i = 0; i < binSize; ++i)
 	{
-		if (omega[i] != 0.0 && omega[i] != 1.0)
+		count += bins[i];
+		if (count != 0 && count != pixels)
 		{
 			sigma[i] = pow((mu[BIN_SIZE - 1]*omega[i] - mu[i]), 2) / (omega[i] * (1.0 - omega[i]));
 		}
@@ -59,7 +63,7 @@ ImageBinarization::calculateThresholdValueOnHost()
 		}
 	}
 
-	return SDK_SUCCESS;
+	return threshold;
 }
 
 int
@@ -82,8 +86,8 @@ ImageBinarization::readInputImage(std::string inputImageName)
 	globalWorkSizeHist = (width/nPixelsPerThread)*height;
 	subHistgCnt = (cl_int)(globalWorkSizeHist/localThreadsHistogram); 
 
-	// allocate memory for input image data (only Gray component) to host
-    inputImageDataGrayComponent = (cl_uchar*)malloc(width * height * sizeof(cl_uchar));
+	// allocate memory for input image data (only Gray component) of every page to host
+    inputImageDataGrayComponent = (cl_uchar*)malloc(width * height * pages * sizeof(cl_uchar));
     CHECK_ALLOCATION(inputImageDataGrayComponent,"Failed to allocate memory! (inputImageDataGrayComponent)");
 
     // get the pointer to pixel data
@@ -100,30 +104,46 @@ ImageBinarization::readInputImage(std::string inputImageName)
 		inputImageDataGrayComponent[i] = ( (  66 * R + 129 * G +  25 * B + 128) >> 8) +  16;
 	}
 
+	// further pages of the batch are lit unevenly like a scan, darker towards
+	// the bottom right corner and more so from page to page
+	for(int p = 1; p < pages; p++)
+	{
+		float falloff = 0.6f * p / pages;
+		cl_uchar* page = inputImageDataGrayComponent + p * width * height;
+		for(int y = 0; y < height; y++)
+		{
+			for(int x = 0; x < width; x++)
+			{
+				float light = 1.0f - falloff * (x + y) / (width + height);
+				page[y * width + x] = (cl_uchar)(inputImageDataGrayComponent[y * width + x] * light + 0.5f);
+			}
+		}
+	}
+
 	// Allocate host memory for histgram bins
-	hostBin = (cl_uint*)malloc(binSize * sizeof(cl_uint));
+	hostBin = (cl_uint*)malloc(binSize * pages * sizeof(cl_uint));
 	CHECK_ALLOCATION(hostBin, "Failed to allocate host memory. (hostBin)");
-	memset(hostBin, 0, binSize * sizeof(cl_uint));
+	memset(hostBin, 0, binSize * pages * sizeof(cl_uint));
 
 	// Allocate device memory for histogram bins
-	deviceBin = (cl_uint*)malloc(binSize * sizeof(cl_uint));
+	deviceBin = (cl_uint*)malloc(binSize * pages * sizeof(cl_uint));
 	CHECK_ALLOCATION(deviceBin, "Failed to allocate host memory. (deviceBin)");
-	memset(deviceBin, 0, binSize * sizeof(cl_uint));
+	memset(deviceBin, 0, binSize * pages * sizeof(cl_uint));
 
-	// Allocate intermittent device memory for sub-histogram bins
-	intermittentdeviceBinResult = (cl_uint*)malloc(binSize * subHistgCnt * sizeof(cl_uint));
-	CHECK_ALLOCATION(intermittentdeviceBinResult, "Failed to allocate host memory. (intermittentdeviceBinResult)");
-	memset(intermittentdeviceBinResult, 0, binSize * subHistgCnt * sizeof(cl_uint));
+	// Allocate host memory for the thresholds computed on the device
+	deviceThresholds = (cl_int*)malloc(pages * sizeof(cl_int));
+	CHECK_ALLOCATION(deviceThresholds, "Failed to allocate host memory. (deviceThresholds)");
+	memset(deviceThresholds, 0, pages * sizeof(cl_int));
 
 	// allocate memory for output image data (only Gray compnent) to host
-    outputImageDataGrayComponent = (cl_uchar*)malloc(width * height * sizeof(cl_uchar));
+    outputImageDataGrayComponent = (cl_uchar*)malloc(width * height * pages * sizeof(cl_uchar));
     CHECK_ALLOCATION(outputImageDataGrayComponent,"Failed to allocate memory! (outputImageDataGrayComponent)");
-	memset((void *)outputImageDataGrayComponent, 0, width * height);
+	memset((void *)outputImageDataGrayComponent, 0, width * height * pages);
 
     // allocate memory for verification of ImageBinarization Kernel to host
-    refOutputBinarizationData = (cl_uchar*)malloc(width * height * sizeof(cl_uchar));
+    refOutputBinarizationData = (cl_uchar*)malloc(width * height * pages * sizeof(cl_uchar));
     CHECK_ALLOCATION(refOutputBinarizationData,"refOutputBinarizationData heap allocation failed!");
-    memset((void *)refOutputBinarizationData, 0, width * height);
+    memset((void *)refOutputBinarizationData, 0, width * height * pages);
 
     return SDK_SUCCESS;
 
@@ -132,7 +152,7 @@ ImageBinarization::readInputImage(std::string inputImageName)
 int
 ImageBinarization::writeOutputImage(std::string outputImageName)
 {
-    // copy output image data back to original pixel data
+    // copy output image data of the first page back to original pixel data
 	memset(pixelData, 0xff, width * height * pixelSize);
 	for(int i = 0; i <  width*height; i++)
 	{	
@@ -248,12 +268,26 @@ ImageBinarization::setupCL()
                        &status);
     CHECK_OPENCL_ERROR(status,"clCreateCommandQueueWithProperties failed.");
 
+    // pages of a batch are stacked vertically in one image
+    size_t maxImageHeight = 0;
+    status = clGetDeviceInfo(devices[sampleArgs->deviceId],
+                             CL_DEVICE_IMAGE2D_MAX_HEIGHT,
+                             sizeof(size_t),
+                             &maxImageHeight,
+                             NULL);
+    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo(CL_DEVICE_IMAGE2D_MAX_HEIGHT) failed.");
+
+    if((size_t)height * pages > maxImageHeight)
+    {
+        OPENCL_EXPECTED_ERROR("Unsupported! Pages exceed CL_DEVICE_IMAGE2D_MAX_HEIGHT, use fewer pages");
+    }
+
     // Create and initialize image objects
     cl_image_desc imageDesc;
     memset(&imageDesc, '\0', sizeof(cl_image_desc));
     imageDesc.image_type = CL_MEM_OBJECT_IMAGE2D;
     imageDesc.image_width = width;
-    imageDesc.image_height = height;
+    imageDesc.image_height = height * pages;
 
     // Create 2D image, which will be used as input as well as output image
     image2D = clCreateImage(context,
@@ -267,18 +301,56 @@ ImageBinarization::setupCL()
 	// Initialize CL buffer for Histogram Kernel, it stores image data in 1D form
 	deviceImageData1D = clCreateBuffer(context,
 						CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-						sizeof(cl_uchar) * width * height,  
+						sizeof(cl_uchar) * width * height * pages,  
 						(void *)inputImageDataGrayComponent,
 						&status);
 	CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(deviceImageData1D).");
 
-	// Create CL Buffer for Histogram Kernel to store histogram bins
-	deviceBinResultBuffer = clCreateBuffer(context,
-							CL_MEM_WRITE_ONLY,
-							sizeof(cl_uint) * binSize * subHistgCnt,
+	if(method == METHOD_OTSU)
+	{
+		// Create CL Buffer for Histogram Kernel to store histogram bins
+		deviceBinResultBuffer = clCreateBuffer(context,
+								CL_MEM_READ_WRITE,
+								sizeof(cl_uint) * binSize * subHistgCnt * pages,
+								NULL,
+								&status);
+		CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(deviceBinResultBuffer).");
+
+		// Create CL Buffer for OtsuThreshold Kernel to store the final histograms
+		deviceHistogramBuffer = clCreateBuffer(context,
+								CL_MEM_WRITE_ONLY,
+								sizeof(cl_uint) * binSize * pages,
+								NULL,
+								&status);
+		CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(deviceHistogramBuffer).");
+
+		// Thresholds stay on the device between OtsuThreshold and ImageBinarization Kernels
+		deviceThresholdBuffer = clCreateBuffer(context,
+								CL_MEM_READ_WRITE,
+								sizeof(cl_int) * pages,
+								NULL,
+								&status);
+		CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(deviceThresholdBuffer).");
+	}
+	else
+	{
+		// Create CL Buffers for the integral images of every page
+		size_t integralSize = sizeof(cl_uint) * (width + 1) * (height + 1) * pages;
+
+		integralSumBuffer = clCreateBuffer(context,
+							CL_MEM_READ_WRITE,
+							integralSize,
+							NULL,
+							&status);
+		CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(integralSumBuffer).");
+
+		integralSqBuffer = clCreateBuffer(context,
+							CL_MEM_READ_WRITE,
+							integralSize,
 							NULL,
 							&status);
-	CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(deviceBinResultBuffer).");
+		CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(integralSqBuffer).");
+	}
 
     // create a CL program using the kernel source
     buildProgramData buildData;
@@ -308,8 +380,52 @@ ImageBinarization::setupCL()
     imageBinarizationKernel = clCreateKernel(program, "imageBinarization", &status);
     CHECK_OPENCL_ERROR(status,"clCreateKernel failed.(imageBinarizationKernel)");
 
+    // get a kernel object handle for a otsuThreshold kernel
+    otsuThresholdKernel = clCreateKernel(program, "otsuThreshold", &status);
+    CHECK_OPENCL_ERROR(status,"clCreateKernel failed.(otsuThresholdKernel)");
+
+    // get kernel object handles for the integral image and adaptive binarization kernels
+    integralRowsKernel = clCreateKernel(program, "integralRows", &status);
+    CHECK_OPENCL_ERROR(status,"clCreateKernel failed.(integralRowsKernel)");
+
+    integralColumnsKernel = clCreateKernel(program, "integralColumns", &status);
+    CHECK_OPENCL_ERROR(status,"clCreateKernel failed.(integralColumnsKernel)");
+
+    adaptiveBinarizationKernel = clCreateKernel(program, "adaptiveBinarization", &status);
+    CHECK_OPENCL_ERROR(status,"clCreateKernel failed.(adaptiveBinarizationKernel)");
+
+    // otsuThreshold needs one work-item per bin in a single work-group
+    size_t otsuWorkGroupSize = 0;
+    status = clGetKernelWorkGroupInfo(otsuThresholdKernel,
+                                      devices[sampleArgs->deviceId],
+                                      CL_KERNEL_WORK_GROUP_SIZE,
+                                      sizeof(size_t),
+                                      &otsuWorkGroupSize,
+                                      0);
+    CHECK_OPENCL_ERROR(status,"clGetKernelWorkGroupInfo  failed.");
+
+    if(method == METHOD_OTSU && otsuWorkGroupSize < (size_t)binSize)
+    {
+        OPENCL_EXPECTED_ERROR("Unsupported! otsuThreshold kernel needs a work-group of BIN_SIZE work-items");
+    }
+
+    // integral image kernels scan in chunks of any work-group size
+    size_t integralWorkGroupSize = 0;
+    status = clGetKernelWorkGroupInfo(integralRowsKernel,
+                                      devices[sampleArgs->deviceId],
+                                      CL_KERNEL_WORK_GROUP_SIZE,
+                                      sizeof(size_t),
+                                      &integralWorkGroupSize,
+                                      0);
+    CHECK_OPENCL_ERROR(status,"clGetKernelWorkGroupInfo  failed.");
+
+    if(localThreadsIntegral > integralWorkGroupSize)
+    {
+        localThreadsIntegral = integralWorkGroupSize;
+    }
+
 	// Check binarization local work group size against group size returned by kernel
-    status = clGetKernelWorkGroupInfo(imageBinarizationKernel,
+    status = clGetKernelWorkGroupInfo(method == METHOD_OTSU ? imageBinarizationKernel : adaptiveBinarizationKernel,
                                       devices[sampleArgs->deviceId],
                                       CL_KERNEL_WORK_GROUP_SIZE,
                                       sizeof(size_t),
@@ -342,6 +458,49 @@ ImageBinarization::setupCL()
 
 int
 ImageBinarization::runCLKernels()
+{
+    cl_int status;
+
+	// initialize image for the binarization kernels, every page of the batch
+    cl_event writeEvt;
+    origin[0] = 0; origin[1] = 0; origin[2] = 0;
+	region[0] = width; region[1] = height * pages; region[2] = 1;
+
+    status = clEnqueueWriteImage(
+                 commandQueue,
+                 image2D,
+                 CL_FALSE,
+                 origin,
+                 region,
+				 0,
+                 0,
+                 inputImageDataGrayComponent,
+                 0,
+                 NULL,
+                 &writeEvt);
+    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (deviceImageData1D)");
+
+    status = waitForEventAndRelease(&writeEvt);
+    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(writeEvt) Failed");
+
+	if (method == METHOD_OTSU)
+	{
+		status = runOtsuKernels();
+	}
+	else
+	{
+		status = runAdaptiveKernels();
+	}
+	CHECK_ERROR(status, SDK_SUCCESS, "Binarization kernels failed");
+
+	status = clFinish(commandQueue);
+    CHECK_OPENCL_ERROR(status,"clFinish failed.");
+
+    return SDK_SUCCESS;
+}
+
+int
+ImageBinarization::runOtsuKernels()
 {
     cl_int status;
 
@@ -377,71 +536,73 @@ ImageBinarization::runCLKernels()
                  sizeof(cl_int),
 				 &nPixelsPerThread);
     CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (nPixelsPerThread)");
-	
+
+	// one row of work-groups per page
+	size_t globalThreadsHist[] = {globalWorkSizeHist, (size_t)pages};
+	size_t localThreadsHist[] = {localThreadsHistogram, 1};
+
 	// Enqueue a imageHistogramKernel run call
 	status = clEnqueueNDRangeKernel(
                  commandQueue,
                  imageHistogramKernel,
-                 1,
+                 2,
                  NULL,
-				 &globalWorkSizeHist,
-				 &localThreadsHistogram,
+				 globalThreadsHist,
+				 localThreadsHist,
                  0,
                  NULL,
 				 NULL);
     CHECK_OPENCL_ERROR(status,"clEnqueueNDRangeKernel(imageHistogramKernel)failed.");
 
-	status = clEnqueueReadBuffer(
-					commandQueue,
-					deviceBinResultBuffer,
-					CL_TRUE,
-					0,
-					sizeof(cl_uint)*binSize*subHistgCnt,
-					intermittentdeviceBinResult,
-					0,
-					NULL,
-					NULL);
-	CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(intermittentdeviceBinResult) Failed");
-
-	// Clear deviceBin array
-	memset(deviceBin, 0, binSize * sizeof(cl_uint));
-
-	// Calculate final histogram bin
-	for (int i = 0; i < subHistgCnt; ++i)
-	{
-		for (int j = 0; j < binSize; ++j)
-		{
-			deviceBin[j] += intermittentdeviceBinResult[i * binSize + j];
-		}
-	}
+	// Set appropriate arguments to the otsuThreshold kernel
+	// block-histograms of every page
+    status = clSetKernelArg(
+                 otsuThresholdKernel,
+                 0,
+                 sizeof(cl_mem),
+                 (void *)&deviceBinResultBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (deviceBinResultBuffer)");
 
-	// Calculate threshold value usitng Otsu's Algorithm
-	if (calculateThresholdValueOnHost())
-	{
-		return SDK_FAILURE;
-	}
+	// number of block-histograms per page
+    status = clSetKernelArg(
+                 otsuThresholdKernel,
+                 1,
+                 sizeof(cl_int),
+                 &subHistgCnt);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (subHistgCnt)");
 
-	// initialize image for ImageBinarization Kernel
-    cl_event writeEvt;
-    origin[0] = 0; origin[1] = 0; origin[2] = 0;
-	region[0] = width; region[1] = height; region[2] = 1;
+	// final histogram of every page
+    status = clSetKernelArg(
+                 otsuThresholdKernel,
+                 2,
+                 sizeof(cl_mem),
+                 (void *)&deviceHistogramBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (deviceHistogramBuffer)");
 
-    status = clEnqueueWriteImage(
+	// threshold of every page
+    status = clSetKernelArg(
+                 otsuThresholdKernel,
+                 3,
+                 sizeof(cl_mem),
+                 (void *)&deviceThresholdBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (deviceThresholdBuffer)");
+
+	// one work-group of binSize work-items per page
+	size_t globalThreadsOtsu[] = {(size_t)binSize, (size_t)pages};
+	size_t localThreadsOtsu[] = {(size_t)binSize, 1};
+
+	// Enqueue a otsuThresholdKernel run call, the threshold never leaves the device
+	status = clEnqueueNDRangeKernel(
                  commandQueue,
-                 image2D,
-                 CL_FALSE,
-                 origin,
-                 region,
-				 0,
-                 0,
-                 inputImageDataGrayComponent,
+                 otsuThresholdKernel,
+                 2,
+                 NULL,
+				 globalThreadsOtsu,
+				 localThreadsOtsu,
                  0,
                  NULL,
-                 &writeEvt);
-    CHECK_OPENCL_ERROR(status, "clEnqueueWriteBuffer failed. (deviceImageData1D)");
-
-    status = waitForEventAndRelease(&writeEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(writeEvt) Failed");
+				 NULL);
+    CHECK_OPENCL_ERROR(status,"clEnqueueNDRangeKernel(otsuThresholdKernel)failed.");
 
 	// Set appropriate arguments to the imageBinarization kernel
     // buffer image
@@ -452,15 +613,23 @@ ImageBinarization::runCLKernels()
                  &image2D);
     CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (image2D)");
 
-	// dummy threshold
+	// thresholds written by otsuThreshold kernel
     status = clSetKernelArg(
                  imageBinarizationKernel,
                  1,
-                 sizeof(int),
-                 &threshold);
-    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (threshold)");
+                 sizeof(cl_mem),
+                 &deviceThresholdBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (deviceThresholdBuffer)");
 
-	size_t globalThreads2[] = {width, height};
+	// page height
+    status = clSetKernelArg(
+                 imageBinarizationKernel,
+                 2,
+                 sizeof(cl_int),
+                 &height);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (height)");
+
+	size_t globalThreads2[] = {(size_t)width, (size_t)height * pages};
 	size_t localThreads2[] = {blockSizeX, blockSizeY};
 
 	// Enqueue a imageBinarizationKernel run call
@@ -476,8 +645,190 @@ ImageBinarization::runCLKernels()
                  0);
     CHECK_OPENCL_ERROR(status,"clEnqueueNDRangeKernel(imageBinarizationKernel) failed.");
 
-	status = clFinish(commandQueue);
-    CHECK_OPENCL_ERROR(status,"clFinish failed.");
+    return SDK_SUCCESS;
+}
+
+int
+ImageBinarization::runAdaptiveKernels()
+{
+    cl_int status;
+
+	// Set appropriate arguments to the integralRows kernel
+    status = clSetKernelArg(
+                 integralRowsKernel,
+                 0,
+                 sizeof(cl_mem),
+                 (void *)&deviceImageData1D);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (deviceImageData1D)");
+
+    status = clSetKernelArg(
+                 integralRowsKernel,
+                 1,
+                 sizeof(cl_mem),
+                 (void *)&integralSumBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (integralSumBuffer)");
+
+    status = clSetKernelArg(
+                 integralRowsKernel,
+                 2,
+                 sizeof(cl_mem),
+                 (void *)&integralSqBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (integralSqBuffer)");
+
+    status = clSetKernelArg(
+                 integralRowsKernel,
+                 3,
+                 sizeof(cl_int),
+                 &width);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (width)");
+
+    status = clSetKernelArg(
+                 integralRowsKernel,
+                 4,
+                 sizeof(cl_int),
+                 &height);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (height)");
+
+	// one work-group per row of every page
+	size_t globalThreadsRows[] = {localThreadsIntegral, (size_t)height * pages};
+	size_t localThreadsRows[] = {localThreadsIntegral, 1};
+
+	status = clEnqueueNDRangeKernel(
+                 commandQueue,
+                 integralRowsKernel,
+                 2,
+                 NULL,
+				 globalThreadsRows,
+				 localThreadsRows,
+                 0,
+                 NULL,
+				 NULL);
+    CHECK_OPENCL_ERROR(status,"clEnqueueNDRangeKernel(integralRowsKernel)failed.");
+
+	// Set appropriate arguments to the integralColumns kernel
+    status = clSetKernelArg(
+                 integralColumnsKernel,
+                 0,
+                 sizeof(cl_mem),
+                 (void *)&integralSumBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (integralSumBuffer)");
+
+    status = clSetKernelArg(
+                 integralColumnsKernel,
+                 1,
+                 sizeof(cl_mem),
+                 (void *)&integralSqBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (integralSqBuffer)");
+
+    status = clSetKernelArg(
+                 integralColumnsKernel,
+                 2,
+                 sizeof(cl_int),
+                 &width);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (width)");
+
+    status = clSetKernelArg(
+                 integralColumnsKernel,
+                 3,
+                 sizeof(cl_int),
+                 &height);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (height)");
+
+	// one work-item per column of every page, including the zero column
+	size_t columns = ((width + 1 + localThreadsIntegral - 1) / localThreadsIntegral) * localThreadsIntegral;
+	size_t globalThreadsColumns[] = {columns, (size_t)pages};
+	size_t localThreadsColumns[] = {localThreadsIntegral, 1};
+
+	status = clEnqueueNDRangeKernel(
+                 commandQueue,
+                 integralColumnsKernel,
+                 2,
+                 NULL,
+				 globalThreadsColumns,
+				 localThreadsColumns,
+                 0,
+                 NULL,
+				 NULL);
+    CHECK_OPENCL_ERROR(status,"clEnqueueNDRangeKernel(integralColumnsKernel)failed.");
+
+	// Set appropriate arguments to the adaptiveBinarization kernel
+    status = clSetKernelArg(
+                 adaptiveBinarizationKernel,
+                 0,
+                 sizeof(cl_mem),
+                 &image2D);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (image2D)");
+
+    status = clSetKernelArg(
+                 adaptiveBinarizationKernel,
+                 1,
+                 sizeof(cl_mem),
+                 (void *)&integralSumBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (integralSumBuffer)");
+
+    status = clSetKernelArg(
+                 adaptiveBinarizationKernel,
+                 2,
+                 sizeof(cl_mem),
+                 (void *)&integralSqBuffer);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (integralSqBuffer)");
+
+    status = clSetKernelArg(
+                 adaptiveBinarizationKernel,
+                 3,
+                 sizeof(cl_int),
+                 &width);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (width)");
+
+    status = clSetKernelArg(
+                 adaptiveBinarizationKernel,
+                 4,
+                 sizeof(cl_int),
+                 &height);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (height)");
+
+    status = clSetKernelArg(
+                 adaptiveBinarizationKernel,
+                 5,
+                 sizeof(cl_int),
+                 &radius);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (radius)");
+
+    status = clSetKernelArg(
+                 adaptiveBinarizationKernel,
+                 6,
+                 sizeof(cl_float),
+                 &k);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (k)");
+
+    status = clSetKernelArg(
+                 adaptiveBinarizationKernel,
+                 7,
+                 sizeof(cl_float),
+                 &range);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (range)");
+
+    status = clSetKernelArg(
+                 adaptiveBinarizationKernel,
+                 8,
+                 sizeof(cl_int),
+                 &method);
+    CHECK_OPENCL_ERROR(status,"clSetKernelArg failed. (method)");
+
+	size_t globalThreads2[] = {(size_t)width, (size_t)height * pages};
+	size_t localThreads2[] = {blockSizeX, blockSizeY};
+
+    status = clEnqueueNDRangeKernel(
+                 commandQueue,
+                 adaptiveBinarizationKernel,
+                 2,
+                 NULL,
+                 globalThreads2,
+                 localThreads2,
+                 0,
+                 NULL,
+                 0);
+    CHECK_OPENCL_ERROR(status,"clEnqueueNDRangeKernel(adaptiveBinarizationKernel) failed.");
 
     return SDK_SUCCESS;
 }
@@ -512,6 +863,56 @@ ImageBinarization::initialize()
     sampleArgs->AddOption(global_work_size_hist);
     delete global_work_size_hist;
 
+	Option* method_option = new Option;
+    CHECK_ALLOCATION(method_option, "Memory Allocation error. (method_option)");
+    method_option->_sVersion = "m";
+    method_option->_lVersion = "method";
+	method_option->_description = "Thresholding method : otsu (global), sauvola or niblack (local)";
+    method_option->_type = CA_ARG_STRING;
+    method_option->_value = &methodName;
+    sampleArgs->AddOption(method_option);
+    delete method_option;
+
+	Option* pages_option = new Option;
+    CHECK_ALLOCATION(pages_option, "Memory Allocation error. (pages_option)");
+    pages_option->_sVersion = "pg";
+    pages_option->_lVersion = "pages";
+	pages_option->_description = "Number of pages binarized per run";
+    pages_option->_type = CA_ARG_INT;
+    pages_option->_value = &pages;
+    sampleArgs->AddOption(pages_option);
+    delete pages_option;
+
+	Option* radius_option = new Option;
+    CHECK_ALLOCATION(radius_option, "Memory Allocation error. (radius_option)");
+    radius_option->_sVersion = "r";
+    radius_option->_lVersion = "radius";
+	radius_option->_description = "Window radius of sauvola and niblack, 1 to 127";
+    radius_option->_type = CA_ARG_INT;
+    radius_option->_value = &radius;
+    sampleArgs->AddOption(radius_option);
+    delete radius_option;
+
+	Option* k_option = new Option;
+    CHECK_ALLOCATION(k_option, "Memory Allocation error. (k_option)");
+    k_option->_sVersion = "k";
+    k_option->_lVersion = "k";
+	k_option->_description = "Deviation weight of sauvola (default 0.34) and niblack (default -0.2)";
+    k_option->_type = CA_ARG_FLOAT;
+    k_option->_value = &k;
+    sampleArgs->AddOption(k_option);
+    delete k_option;
+
+	Option* range_option = new Option;
+    CHECK_ALLOCATION(range_option, "Memory Allocation error. (range_option)");
+    range_option->_sVersion = "R";
+    range_option->_lVersion = "range";
+	range_option->_description = "Dynamic range of the deviation in sauvola (default 128)";
+    range_option->_type = CA_ARG_FLOAT;
+    range_option->_value = &range;
+    sampleArgs->AddOption(range_option);
+    delete range_option;
+
     return SDK_SUCCESS;
 }
 
@@ -519,6 +920,50 @@ int
 ImageBinarization::setup()
 {
     int status = 0;
+
+	if (methodName == "otsu")
+	{
+		method = METHOD_OTSU;
+	}
+	else if (methodName == "sauvola")
+	{
+		method = METHOD_SAUVOLA;
+	}
+	else if (methodName == "niblack")
+	{
+		method = METHOD_NIBLACK;
+	}
+	else
+	{
+		std::cout << "Unknown method : " << methodName
+				  << " (expected otsu, sauvola or niblack)" << std::endl;
+		return SDK_FAILURE;
+	}
+
+	if (pages < 1)
+	{
+		std::cout << "Pages should be at least 1" << std::endl;
+		return SDK_FAILURE;
+	}
+
+	if (radius < 1 || radius > MAX_RADIUS)
+	{
+		std::cout << "Radius should be in 1 to " << MAX_RADIUS << std::endl;
+		return SDK_FAILURE;
+	}
+
+	if (range <= 0.0f)
+	{
+		std::cout << "Range should be positive" << std::endl;
+		return SDK_FAILURE;
+	}
+
+	// k defaults differ between the methods
+	if (k == FLT_MAX)
+	{
+		k = (method == METHOD_NIBLACK) ? NIBLACK_K : SAUVOLA_K;
+	}
+
     // Allocate host memory and read input image
     std::string filePath = getPath() + std::string(INPUT_IMAGE);
     status = readInputImage(filePath);
@@ -580,7 +1025,7 @@ ImageBinarization::run()
 
 	// Set origin and region for ReadImage call
     origin[0] = 0; origin[1] = 0; origin[2] = 0;
-	region[0] = width; region[1] = height; region[2] = 1;
+	region[0] = width; region[1] = height * pages; region[2] = 1;
 
     // Read output of 2D copy
     status = clEnqueueReadImage(commandQueue,
@@ -594,6 +1039,34 @@ ImageBinarization::run()
                                 0, 0, 0);
     CHECK_OPENCL_ERROR(status,"clEnqueueReadImage(outputImageDataGrayComponent) failed.");
 
+	if (method == METHOD_OTSU)
+	{
+		// histograms and thresholds are only read back for verification
+		status = clEnqueueReadBuffer(
+						commandQueue,
+						deviceHistogramBuffer,
+						CL_TRUE,
+						0,
+						sizeof(cl_uint) * binSize * pages,
+						deviceBin,
+						0,
+						NULL,
+						NULL);
+		CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(deviceBin) Failed");
+
+		status = clEnqueueReadBuffer(
+						commandQueue,
+						deviceThresholdBuffer,
+						CL_TRUE,
+						0,
+						sizeof(cl_int) * pages,
+						deviceThresholds,
+						0,
+						NULL,
+						NULL);
+		CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer(deviceThresholds) Failed");
+	}
+
     // Wait for the read buffer to finish execution
     status = clFinish(commandQueue);
     CHECK_OPENCL_ERROR(status,"clFinish failed.(commandQueue)");
@@ -623,6 +1096,30 @@ ImageBinarization::cleanup()
 		CHECK_OPENCL_ERROR(status,"clReleaseKernel failed.(imageBinarizationKernel)");
 	}
 
+	if (otsuThresholdKernel)
+	{
+		status = clReleaseKernel(otsuThresholdKernel);
+		CHECK_OPENCL_ERROR(status,"clReleaseKernel failed.(otsuThresholdKernel)");
+	}
+
+	if (integralRowsKernel)
+	{
+		status = clReleaseKernel(integralRowsKernel);
+		CHECK_OPENCL_ERROR(status,"clReleaseKernel failed.(integralRowsKernel)");
+	}
+
+	if (integralColumnsKernel)
+	{
+		status = clReleaseKernel(integralColumnsKernel);
+		CHECK_OPENCL_ERROR(status,"clReleaseKernel failed.(integralColumnsKernel)");
+	}
+
+	if (adaptiveBinarizationKernel)
+	{
+		status = clReleaseKernel(adaptiveBinarizationKernel);
+		CHECK_OPENCL_ERROR(status,"clReleaseKernel failed.(adaptiveBinarizationKernel)");
+	}
+
 	if (program)
 	{
 		status = clReleaseProgram(program);
@@ -647,6 +1144,30 @@ ImageBinarization::cleanup()
 		CHECK_OPENCL_ERROR(status,"clReleaseMemObject failed.(deviceBinResultBuffer)");
 	}
 
+	if (deviceHistogramBuffer)
+	{
+		status = clReleaseMemObject(deviceHistogramBuffer);
+		CHECK_OPENCL_ERROR(status,"clReleaseMemObject failed.(deviceHistogramBuffer)");
+	}
+
+	if (deviceThresholdBuffer)
+	{
+		status = clReleaseMemObject(deviceThresholdBuffer);
+		CHECK_OPENCL_ERROR(status,"clReleaseMemObject failed.(deviceThresholdBuffer)");
+	}
+
+	if (integralSumBuffer)
+	{
+		status = clReleaseMemObject(integralSumBuffer);
+		CHECK_OPENCL_ERROR(status,"clReleaseMemObject failed.(integralSumBuffer)");
+	}
+
+	if (integralSqBuffer)
+	{
+		status = clReleaseMemObject(integralSqBuffer);
+		CHECK_OPENCL_ERROR(status,"clReleaseMemObject failed.(integralSqBuffer)");
+	}
+
 	if (commandQueue)
 	{
 		status = clReleaseCommandQueue(commandQueue);
@@ -664,8 +1185,8 @@ ImageBinarization::cleanup()
 	FREE(outputImageDataGrayComponent);
 	FREE(refOutputBinarizationData);
 	FREE(hostBin);
-	FREE(intermittentdeviceBinResult);
 	FREE(deviceBin);
+	FREE(deviceThresholds);
     FREE(devices);
 
     return SDK_SUCCESS;
@@ -675,10 +1196,14 @@ void
 ImageBinarization::calculateHostBin()
 {
     int red;
-    for(int i = 0; i < width*height; i++)
+    memset(hostBin, 0, binSize * pages * sizeof(cl_uint));
+    for(int p = 0; p < pages; p++)
     {
-       red = inputImageDataGrayComponent[i];
-       hostBin[red]++;
+        for(int i = 0; i < width*height; i++)
+        {
+           red = inputImageDataGrayComponent[p * width * height + i];
+           hostBin[p * binSize + red]++;
+        }
     }
 }
 
@@ -687,24 +1212,120 @@ void
 ImageBinarization::ImageBinarizationCPUReference()
 {
 	int red;
-	for(int i = 0; i < width*height; i++)
+	for(int p = 0; p < pages; p++)
 	{
-		red = inputImageDataGrayComponent[i];
-		if(red < threshold)
-			red = 0;
-		else
-			red = 255;
+		// the threshold of every page as computed on the device, verified separately
+		int threshold = deviceThresholds[p];
+		for(int i = p * width * height; i < (p + 1) * width * height; i++)
+		{
+			red = inputImageDataGrayComponent[i];
+			if(red < threshold)
+				red = 0;
+			else
+				red = 255;
 
-		refOutputBinarizationData[i] = red;
+			refOutputBinarizationData[i] = red;
+		}
 	}
 }
 
 
+int
+ImageBinarization::adaptiveCPUReference()
+{
+	int mismatches = 0;
+	int stride = width + 1;
+	cl_ulong* sum = (cl_ulong*)malloc(stride * (height + 1) * sizeof(cl_ulong));
+	cl_ulong* sq = (cl_ulong*)malloc(stride * (height + 1) * sizeof(cl_ulong));
+	if (sum == NULL || sq == NULL)
+	{
+		FREE(sum);
+		FREE(sq);
+		error("Failed to allocate host memory. (integral images)");
+		return width * height * pages;
+	}
+
+	for(int p = 0; p < pages; p++)
+	{
+		const cl_uchar* input = inputImageDataGrayComponent + p * width * height;
+		const cl_uchar* output = outputImageDataGrayComponent + p * width * height;
+
+		// integral images in 64 bits, without the wrap-around the device relies on
+		memset(sum, 0, stride * (height + 1) * sizeof(cl_ulong));
+		memset(sq, 0, stride * (height + 1) * sizeof(cl_ulong));
+		for(int y = 0; y < height; y++)
+		{
+			for(int x = 0; x < width; x++)
+			{
+				cl_ulong v = input[y * width + x];
+				sum[(y + 1) * stride + x + 1] = v + sum[y * stride + x + 1] + sum[(y + 1) * stride + x] - sum[y * stride + x];
+				sq[(y + 1) * stride + x + 1] = v * v + sq[y * stride + x + 1] + sq[(y + 1) * stride + x] - sq[y * stride + x];
+			}
+		}
+
+		for(int y = 0; y < height; y++)
+		{
+			for(int x = 0; x < width; x++)
+			{
+				int x0 = (x < radius) ? 0 : x - radius;
+				int x1 = min(x + radius + 1, width);
+				int y0 = (y < radius) ? 0 : y - radius;
+				int y1 = min(y + radius + 1, height);
+				cl_ulong n = (cl_ulong)(x1 - x0) * (y1 - y0);
+
+				cl_ulong s = sum[y1 * stride + x1] - sum[y0 * stride + x1] - sum[y1 * stride + x0] + sum[y0 * stride + x0];
+				cl_ulong q = sq[y1 * stride + x1] - sq[y0 * stride + x1] - sq[y1 * stride + x0] + sq[y0 * stride + x0];
+				double mean = (double)s / n;
+				double deviation = sqrt((double)(n * q - s * s)) / n;
+
+				double threshold;
+				if (method == METHOD_SAUVOLA)
+				{
+					threshold = mean * (1.0 + k * (deviation / range - 1.0));
+				}
+				else
+				{
+					threshold = mean + k * deviation;
+				}
+
+				int value = input[y * width + x];
+				cl_uchar ref = (value < threshold) ? 0 : 255;
+
+				// the device thresholds in float, pixels right at the threshold may go either way
+				if (output[y * width + x] != ref && fabs(value - threshold) > 1e-2)
+				{
+					mismatches++;
+				}
+			}
+		}
+	}
+
+	FREE(sum);
+	FREE(sq);
+	return mismatches;
+}
+
+
 int
 ImageBinarization::verifyResults()
 {
     if(sampleArgs->verify)
     {
+		if (method != METHOD_OTSU)
+		{
+			std::cout << "Verifying AdaptiveBinarization Kernel result - ";
+			if (adaptiveCPUReference() == 0)
+			{
+				std::cout << "Passed!\n" << std::endl;
+			}
+			else
+			{
+				std::cout << "Failed\n" << std::endl;
+				return SDK_FAILURE;
+			}
+			return SDK_SUCCESS;
+		}
+
 		/**
 		* Reference implementation on host device
 		* calculates the histogram bin on host
@@ -713,7 +1334,7 @@ ImageBinarization::verifyResults()
 
 		// compare the results and see if they match
 		bool result = true;
-		for (int i = 0; i < binSize; ++i)
+		for (int i = 0; i < binSize * pages; ++i)
 		{
 			if (hostBin[i] != deviceBin[i])
 			{
@@ -728,12 +1349,34 @@ ImageBinarization::verifyResults()
 			return SDK_FAILURE;
 		}
 
+		// the device maximizes the variance in float, its threshold has to
+		// reach the host's maximum within 0.01%
+		for (int p = 0; p < pages; ++p)
+		{
+			double sigma[BIN_SIZE];
+			int threshold = calculateThresholdValueOnHost(hostBin + p * binSize, sigma);
+			int deviceThreshold = deviceThresholds[p];
+
+			if (deviceThreshold < 0 || deviceThreshold >= binSize ||
+				sigma[deviceThreshold] < sigma[threshold] * (1.0 - 1e-4))
+			{
+				result = false;
+				break;
+			}
+		}
+
+		if (!result)
+		{
+			std::cout << "Verifying OtsuThreshold Kernel result - Failed\n" << std::endl;
+			return SDK_FAILURE;
+		}
+
         std::cout << "Verifying ImageBinarization Kernel result - ";
 		// Calculate the reference output
 		ImageBinarizationCPUReference();
 
         // compare the results and see if they match
-        if(!memcmp(refOutputBinarizationData, outputImageDataGrayComponent, width * height))
+        if(!memcmp(refOutputBinarizationData, outputImageDataGrayComponent, width * height * pages))
         {
             std::cout << "Passed!\n" << std::endl;
         }
@@ -752,23 +1395,29 @@ ImageBinarization::printStats()
 {
     if(sampleArgs->timing)
     {
-        std::string strArray[4] =
+        std::string strArray[7] =
         {
             "Width",
             "Height",
+            "Method",
+            "Pages",
             "Time(sec)",
-            "kernelTime(sec)"
+            "kernelTime(sec)",
+            "Pages/sec"
         };
-        std::string stats[4];
+        std::string stats[7];
 
         sampleTimer->totalTime = setupTime + kernelTime;
 
         stats[0] = toString(width, std::dec);
         stats[1] = toString(height, std::dec);
-        stats[2] = toString(sampleTimer->totalTime, std::dec);
-        stats[3] = toString(kernelTime, std::dec);
+        stats[2] = methodName;
+        stats[3] = toString(pages, std::dec);
+        stats[4] = toString(sampleTimer->totalTime, std::dec);
+        stats[5] = toString(kernelTime, std::dec);
+        stats[6] = toString(pages / kernelTime, std::dec);
 
-        printStatistics(strArray, stats, 4);
+        printStatistics(strArray, stats, 7);
     }
 }
 
@@ -22,6 +22,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <float.h>
 #include "CLUtil.hpp"
 #include "SDKBitMap.hpp"
 
@@ -38,6 +39,22 @@ using namespace appsdk;
 #define PIXEL_PER_THREAD 8
 
 #define LOCAL_SIZE_HISTOGRAM 256
+#define LOCAL_SIZE_INTEGRAL 256
+
+#define MAX_RADIUS 127              /**< Largest window radius whose window sums fit in 32 bits */
+#define SAUVOLA_K 0.34f
+#define NIBLACK_K -0.2f
+#define SAUVOLA_RANGE 128.0f
+
+/**
+* Thresholding methods, the adaptive ones match ADAPTIVE_* in the kernels
+*/
+enum BinarizationMethod
+{
+    METHOD_SAUVOLA = 0,
+    METHOD_NIBLACK = 1,
+    METHOD_OTSU = 2
+};
 
 #ifndef min
 #define min(a, b)            (((a) < (b)) ? (a) : (b))
@@ -56,22 +73,29 @@ class ImageBinarization
 		cl_uchar* outputImageDataGrayComponent;/**< Output bitmap data on host, but stores only Y component */
 
 		cl_uchar* refOutputBinarizationData;/**< Reference Output data for Image Binarization Kernel on host */
-		cl_uint *hostBin;					/**< Host result for histogram bin */
-		cl_uint *intermittentdeviceBinResult;/**< Intermittent sub-histogram bins */
-		cl_uint *deviceBin;					/**< Device result for histogram bin */
+		cl_uint *hostBin;					/**< Host result for histogram bin, per page */
+		cl_uint *deviceBin;					/**< Device result for histogram bin, per page */
+		cl_int *deviceThresholds;			/**< Otsu's threshold of every page computed on the device */
         cl_context context;                 /**< CL context */
         cl_device_id *devices;              /**< CL device list */
 
         cl_mem image2D;						/**< CL image buffer for input as well as output Image*/
 		cl_mem deviceImageData1D;			/**< CL buffer for storing image data in one dimentional array */
 		cl_mem deviceBinResultBuffer;	    /**< CL buffer for storing histogram bins */
-		cl_int threshold;					/**< Threshold for Binarization */
+		cl_mem deviceHistogramBuffer;		/**< CL buffer for the final histogram of every page */
+		cl_mem deviceThresholdBuffer;		/**< CL buffer for Otsu's threshold of every page */
+		cl_mem integralSumBuffer;			/**< CL buffer for the integral images of luma */
+		cl_mem integralSqBuffer;			/**< CL buffer for the integral images of squared luma */
 
         cl_command_queue commandQueue;      /**< CL command queue */
         cl_program program;                 /**< CL program  */
 
 		cl_kernel imageHistogramKernel;     /**< CL ImageHistogram kernel */
 		cl_kernel imageBinarizationKernel;  /**< CL ImageBinarization kernel */
+		cl_kernel otsuThresholdKernel;		/**< CL OtsuThreshold kernel */
+		cl_kernel integralRowsKernel;		/**< CL IntegralRows kernel */
+		cl_kernel integralColumnsKernel;	/**< CL IntegralColumns kernel */
+		cl_kernel adaptiveBinarizationKernel;/**< CL AdaptiveBinarization kernel */
         
 
         SDKBitMap inputBitmap;				/**< Bitmap class object */
@@ -83,9 +107,16 @@ class ImageBinarization
 		cl_int  binSize;					/**< Size of Histogram Bins */
 		cl_int  nBanks;						/**< Number of Banks */
 		cl_int  subHistgCnt;				/**< Number of Histogram Counts */
+		cl_int  pages;						/**< Number of pages binarized per run */
+		std::string methodName;				/**< otsu, sauvola or niblack */
+		int     method;						/**< BinarizationMethod of methodName */
+		cl_int  radius;						/**< Window radius of the adaptive methods */
+		cl_float k;							/**< Deviation weight of the adaptive methods */
+		cl_float range;						/**< Dynamic range of the deviation (Sauvola's R) */
 
 		size_t globalWorkSizeHist;			/**< global work size for histogram kernel */
 		size_t localThreadsHistogram;		/**< local work size for histogram kernel */
+		size_t localThreadsIntegral;		/**< local work size for integral image kernels */
         size_t blockSizeX;                  /**< Work-group size in x-direction */
         size_t blockSizeY;                  /**< Work-group size in y-direction */
 		size_t binarizationkernelWorkGroupSize;
@@ -128,8 +159,8 @@ class ImageBinarization
             : inputImageDataGrayComponent(NULL),
 			  outputImageDataGrayComponent(NULL),
 			  hostBin(NULL),
-			  intermittentdeviceBinResult(NULL),
 			  deviceBin(NULL),
+			  deviceThresholds(NULL),
 			  refOutputBinarizationData(NULL),
 			  subHistgCnt(1)
         {
@@ -142,11 +173,17 @@ class ImageBinarization
             blockSizeY = 1;
 			localThreadsHistogram = LOCAL_SIZE_HISTOGRAM;
 			globalWorkSizeHist = localThreadsHistogram;
+			localThreadsIntegral = LOCAL_SIZE_INTEGRAL;
             iterations = 1;
 			binSize = BIN_SIZE;
 			nBanks = NBANKS;
 			nPixelsPerThread = PIXEL_PER_THREAD;
-			threshold = 0;
+			pages = 1;
+			methodName = "otsu";
+			method = METHOD_OTSU;
+			radius = 15;
+			k = FLT_MAX;
+			range = SAUVOLA_RANGE;
             imageFormat.image_channel_data_type = CL_UNSIGNED_INT8;
             imageFormat.image_channel_order = CL_R;
 
@@ -154,10 +191,18 @@ class ImageBinarization
             image2D						= NULL;
 			deviceImageData1D			= NULL;
 			deviceBinResultBuffer	    = NULL;
+			deviceHistogramBuffer		= NULL;
+			deviceThresholdBuffer		= NULL;
+			integralSumBuffer			= NULL;
+			integralSqBuffer			= NULL;
 			commandQueue		= NULL;
 			program					= NULL;
 			imageHistogramKernel		= NULL;
 			imageBinarizationKernel	= NULL;
+			otsuThresholdKernel		= NULL;
+			integralRowsKernel		= NULL;
+			integralColumnsKernel	= NULL;
+			adaptiveBinarizationKernel = NULL;
         }
 
         ~ImageBinarization()
@@ -186,12 +231,31 @@ class ImageBinarization
         */
         int runCLKernels();
 
+        /**
+        * Enqueue the histogram, Otsu's threshold and binarization kernels
+        * @return  SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int runOtsuKernels();
+
+        /**
+        * Enqueue the integral image and adaptive binarization kernels
+        * @return  SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int runAdaptiveKernels();
+
         /**
         * Reference CPU implementation of Binomial Option
         * for performance comparison
         */
         void ImageBinarizationCPUReference();
 
+        /**
+        * Reference CPU implementation of Sauvola's and Niblack's thresholds,
+        * compares them with the device output
+        * @return number of pixels that differ away from the threshold
+        */
+        int adaptiveCPUReference();
+
         /**
         * Override from SDKSample. Print sample stats.
         */
@@ -240,8 +304,11 @@ class ImageBinarization
 
 		/**
 		*  Calculate Threshold value using Otsu's algorithm on host
+		*  @param bins histogram of a page
+		*  @param sigma inter-class variance of every threshold
+		*  @return the threshold
 		*/
-		int calculateThresholdValueOnHost();
+		int calculateThresholdValueOnHost(const cl_uint* bins, double* sigma);
 };
 
 #endif // IMAGE_BINARIZATION_H_
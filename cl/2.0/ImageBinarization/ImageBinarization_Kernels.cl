@@ -16,10 +16,14 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #define NBINS 256
 #define NBANKS 16
 
+#define ADAPTIVE_SAUVOLA 0
+#define ADAPTIVE_NIBLACK 1
+
 /************************* Generate Histogram ************************/
 /*Kernel I*/
 /**
  *  @brief    Generate block-histogram bin whose bin size is 256
+ *            dimension 1 of the NDRange selects the page of a batch
  *  @param    inputImageData input buffer stores image data
  *  @param    sharedArray shared array for thread-histogram bins
  *  @param    binResult block-histogram array
@@ -38,6 +42,11 @@ void imageHistogram256(
     size_t groupId = get_group_id(0);
     size_t groupSize = get_local_size(0);
 	size_t globalSize = get_global_size(0);
+	size_t page = get_global_id(1);
+
+	// every page has its own pixels and block-histograms
+	inputImageData += page * globalSize * nPixelsPerThread;
+	binResult += page * get_num_groups(0) * NBINS;
 
 	// initialize shared array to zero
 	uint lmem_items = NBANKS * NBINS;
@@ -82,12 +91,69 @@ void imageHistogram256(
 }
 
 
+/************************* Otsu's Threshold ************************/
+/*Kernel II*/
+/**
+ *  @brief    Otsu's threshold of every page, one work-group of NBINS work-items per page
+ *  @param    binResult  block-histograms of all pages
+ *  @param    subHistgCnt  number of block-histograms per page
+ *  @param    histogram  final histogram of every page
+ *  @param    thresholds  Otsu's threshold of every page
+*/
+
+__kernel __attribute__((reqd_work_group_size(NBINS, 1, 1)))
+void otsuThreshold(
+		__global const uint* binResult,
+		int subHistgCnt,
+		__global uint* histogram,
+		__global int* thresholds)
+{
+	int bin = get_local_id(0);
+	int page = get_group_id(1);
+
+	// sum the block-histograms of the page
+	__global const uint* pageBins = binResult + (size_t)page * subHistgCnt * NBINS;
+	uint count = 0;
+	for(int i = 0; i < subHistgCnt; i++)
+	{
+		count += pageBins[i * NBINS + bin];
+	}
+	histogram[page * NBINS + bin] = count;
+
+	// pixels and intensity sum of the bins up to this one, exact in integers
+	uint omega = work_group_scan_inclusive_add(count);
+	ulong mu = work_group_scan_inclusive_add((ulong)count * bin);
+	uint total = work_group_reduce_add(count);
+	ulong muTotal = work_group_reduce_add((ulong)count * bin);
+
+	// inter-class variance if this bin is the last one of the background
+	float sigma = 0.0f;
+	if(omega != 0 && omega != total)
+	{
+		float w = (float)omega / total;
+		float d = (float)muTotal / total * w - (float)mu / total;
+		sigma = d * d / (w * (1.0f - w));
+	}
+
+	// the first bin of maximal variance is the threshold
+	float maxSigma = work_group_reduce_max(sigma);
+	int threshold = work_group_reduce_min(sigma == maxSigma ? bin : NBINS);
+
+	if(bin == 0)
+	{
+		thresholds[page] = threshold;
+	}
+}
+
+
 /************************* Image Binarization ************************/
 /*Kernel III*/
 /**
  *  @brief    Binarization of a graylevel Image
+ *            pages of a batch are stacked vertically in the image
  *  @param    image  a 2d image, used as input as well as output
- *  @param    threshold  a Otsu's threshold input value
+ *  @param    thresholds  Otsu's threshold of every page
+ *  @param    height  height of a page
 */
 
 __constant sampler_t imageSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP | CLK_FILTER_NEAREST; 
@@ -95,11 +161,15 @@ __constant sampler_t imageSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CL
 __kernel 
 void imageBinarization(
 		__read_write image2d_t image,
-		int threshold)                          
+		__global const int* thresholds,
+		int height)                          
 {
 	// Store each work-item's unique row and column
 	int2 coord = (int2)(get_global_id(0), get_global_id(1));
 
+	// Threshold of the pixel's page, computed on the device by otsuThreshold
+	int threshold = thresholds[coord.y / height];
+
 	// Read pixel from image
 	uint4 temp = read_imageui(image, imageSampler, coord);
 
@@ -110,3 +180,178 @@ void imageBinarization(
 	write_imageui(image, coord, temp);
 }
 
+
+/************************* Integral Images ************************/
+/*Kernel IV*/
+/**
+ *  @brief    Row pass of the integral images of luma and squared luma
+ *            one work-group per row of every page
+ *  @param    inputImageData  pages of the batch, one after the other
+ *  @param    integralSum  integral image of luma per page
+ *  @param    integralSq  integral image of squared luma per page
+ *  @param    width  width of a page
+ *  @param    height  height of a page
+ *
+ *  A page's integral images are (width + 1) x (height + 1), entry (x, y)
+ *  holding the sum over [0, x) x [0, y); the first row and column are 0.
+ *  Sums are kept in uint and wrap on large pages, window sums taken from
+ *  them are still exact (see adaptiveBinarization).
+*/
+
+__kernel 
+void integralRows(
+		__global const uchar* inputImageData,
+		__global uint* integralSum,
+		__global uint* integralSq,
+		int width,
+		int height)
+{
+	int ltd = get_local_id(0);
+	int groupSize = get_local_size(0);
+	int row = get_global_id(1);
+	int page = row / height;
+	int y = row - page * height;
+
+	__global const uchar* input = inputImageData + (size_t)row * width;
+	size_t base = ((size_t)page * (height + 1) + y + 1) * (width + 1);
+
+	if(ltd == 0)
+	{
+		integralSum[base] = 0;
+		integralSq[base] = 0;
+	}
+
+	// scan the row in chunks of the work-group size, carrying the chunk sums
+	uint carrySum = 0;
+	uint carrySq = 0;
+	for(int x0 = 0; x0 < width; x0 += groupSize)
+	{
+		int x = x0 + ltd;
+		uint value = (x < width) ? input[x] : 0;
+
+		uint sum = carrySum + work_group_scan_inclusive_add(value);
+		uint sq = carrySq + work_group_scan_inclusive_add(value * value);
+		if(x < width)
+		{
+			integralSum[base + x + 1] = sum;
+			integralSq[base + x + 1] = sq;
+		}
+
+		carrySum += work_group_reduce_add(value);
+		carrySq += work_group_reduce_add(value * value);
+	}
+}
+
+
+/*Kernel V*/
+/**
+ *  @brief    Column pass of the integral images, one work-item per column of every page
+ *  @param    integralSum  integral image of luma per page
+ *  @param    integralSq  integral image of squared luma per page
+ *  @param    width  width of a page
+ *  @param    height  height of a page
+*/
+
+__kernel 
+void integralColumns(
+		__global uint* integralSum,
+		__global uint* integralSq,
+		int width,
+		int height)
+{
+	int x = get_global_id(0);
+	int page = get_global_id(1);
+
+	if(x > width)
+	{
+		return;
+	}
+
+	size_t stride = width + 1;
+	size_t idx = (size_t)page * (height + 1) * stride + x;
+	integralSum[idx] = 0;
+	integralSq[idx] = 0;
+
+	// neighbouring work-items read neighbouring columns, accesses are coalesced
+	uint sum = 0;
+	uint sq = 0;
+	for(int y = 0; y < height; y++)
+	{
+		idx += stride;
+		sum += integralSum[idx];
+		sq += integralSq[idx];
+		integralSum[idx] = sum;
+		integralSq[idx] = sq;
+	}
+}
+
+
+/************************* Adaptive Binarization ************************/
+/*Kernel VI*/
+/**
+ *  @brief    Local thresholding (Sauvola or Niblack) of a graylevel Image
+ *            mean and deviation of a window come from the integral images in O(1)
+ *  @param    image  a 2d image with the pages stacked vertically, used as input as well as output
+ *  @param    integralSum  integral image of luma per page
+ *  @param    integralSq  integral image of squared luma per page
+ *  @param    width  width of a page
+ *  @param    height  height of a page
+ *  @param    radius  the window is (2 * radius + 1) pixels wide, clipped at the page borders
+ *  @param    k  weight of the deviation
+ *  @param    range  dynamic range of the deviation (Sauvola's R)
+ *  @param    method  ADAPTIVE_SAUVOLA or ADAPTIVE_NIBLACK
+*/
+
+__kernel 
+void adaptiveBinarization(
+		__read_write image2d_t image,
+		__global const uint* integralSum,
+		__global const uint* integralSq,
+		int width,
+		int height,
+		int radius,
+		float k,
+		float range,
+		int method)
+{
+	int2 coord = (int2)(get_global_id(0), get_global_id(1));
+	int page = coord.y / height;
+	int y = coord.y - page * height;
+
+	int x0 = max(coord.x - radius, 0);
+	int x1 = min(coord.x + radius + 1, width);
+	int y0 = max(y - radius, 0);
+	int y1 = min(y + radius + 1, height);
+
+	size_t stride = width + 1;
+	size_t base = (size_t)page * (height + 1) * stride;
+	size_t i00 = base + y0 * stride + x0;
+	size_t i01 = base + y0 * stride + x1;
+	size_t i10 = base + y1 * stride + x0;
+	size_t i11 = base + y1 * stride + x1;
+
+	// wrap-around of the uint sums cancels, the window sums are exact as
+	// long as they fit in 32 bits, which holds for radius <= 127
+	uint sum = integralSum[i11] - integralSum[i01] - integralSum[i10] + integralSum[i00];
+	uint sq = integralSq[i11] - integralSq[i01] - integralSq[i10] + integralSq[i00];
+	uint n = (x1 - x0) * (y1 - y0);
+
+	// n * n * variance, exact in 64 bits and never negative
+	ulong variance = (ulong)n * sq - (ulong)sum * sum;
+	float mean = (float)sum / n;
+	float deviation = sqrt((float)variance) / n;
+
+	float threshold;
+	if(method == ADAPTIVE_SAUVOLA)
+	{
+		threshold = mean * (1.0f + k * (deviation / range - 1.0f));
+	}
+	else
+	{
+		threshold = mean + k * deviation;
+	}
+
+	uint4 temp = read_imageui(image, imageSampler, coord);
+	temp.x = select(255, 0, (uint)((float)temp.x < threshold));
+	write_imageui(image, coord, temp);
+}
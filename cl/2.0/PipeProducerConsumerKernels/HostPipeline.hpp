@@ -0,0 +1,236 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef _HOST_PIPELINE_HPP_
+#define _HOST_PIPELINE_HPP_
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "SDKThread.hpp"
+#include "PipePipeline.h"
+
+using namespace appsdk;
+
+// Packets between two occupancy samples, one device work-group batch
+#define HOST_PIPELINE_SAMPLE_PACKETS    256
+
+/**
+ * SPSCRing
+ * Bounded ring buffer for one producer thread and one consumer thread.
+ * Each side owns its index and keeps a cached copy of the other one, the
+ * shared index is only reloaded when the cached copy says full or empty.
+ */
+template <typename T>
+class SPSCRing
+{
+public:
+	explicit SPSCRing(cl_uint capacity)
+	{
+		cl_uint slots = 1;
+		while (slots < capacity)
+			slots <<= 1;
+
+		mask = slots - 1;
+		buffer.resize(slots);
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+		headCache = 0;
+		tailCache = 0;
+	}
+
+	// Producer side, false when the ring is full
+	bool push(const T& value)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - headCache > mask)
+		{
+			headCache = head.load(std::memory_order_acquire);
+			if (t - headCache > mask)
+				return false;
+		}
+		buffer[t & mask] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, false when the ring is empty
+	bool pop(T& value)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tailCache)
+		{
+			tailCache = tail.load(std::memory_order_acquire);
+			if (h == tailCache)
+				return false;
+		}
+		value = buffer[h & mask];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Packets in the ring, exact for the producer, a snapshot for anyone else
+	cl_uint size() const
+	{
+		return (cl_uint)(tail.load(std::memory_order_acquire) -
+				 head.load(std::memory_order_acquire));
+	}
+
+	cl_uint capacity() const { return (cl_uint)(mask + 1); }
+
+private:
+	SPSCRing(const SPSCRing&);
+	SPSCRing& operator=(const SPSCRing&);
+
+	std::vector<T> buffer;
+	size_t mask;
+	char pad0[64];
+	std::atomic<size_t> head;           // Next slot to read, written by the consumer
+	size_t tailCache;                   // Consumer's copy of tail
+	char pad1[64];
+	std::atomic<size_t> tail;           // Next slot to write, written by the producer
+	size_t headCache;                   // Producer's copy of head
+	char pad2[64];
+};
+
+/**
+ * HostPipeline
+ * CPU counterpart of PipePipeline: one thread per stage, consecutive
+ * stages connected by SPSC rings. Every stage function is called once per
+ * packet; the first stage fills the packet, the others get what the stage
+ * before them produced. Stalls and ring occupancy are counted in the same
+ * PipeStageStats the device stages report.
+ */
+template <typename T>
+class HostPipeline
+{
+public:
+	typedef void (*StageFunction)(T& packet, void* user);
+
+	void addStage(StageFunction function, void* user)
+	{
+		Stage stage;
+		stage.function = function;
+		stage.user = user;
+		stages.push_back(stage);
+	}
+
+	int numStages() const { return (int)stages.size(); }
+
+	/**
+	 * Moves 'packets' through the stages, rings hold 'ringSize' packets
+	 * (rounded up to a power of 2). Returns once every stage is done.
+	 */
+	void run(cl_uint packets, cl_uint ringSize)
+	{
+		int stageCount = numStages();
+		std::vector<SPSCRing<T>*> rings;
+		for (int r = 0; r < stageCount - 1; r++)
+			rings.push_back(new SPSCRing<T>(ringSize));
+
+		stageStats.assign(stageCount, PipeStageStats());
+		std::vector<StageThread> work(stageCount);
+		SDKThread* threads = new SDKThread[stageCount];
+
+		for (int s = 0; s < stageCount; s++)
+		{
+			work[s].stage = &stages[s];
+			work[s].in = s > 0 ? rings[s - 1] : NULL;
+			work[s].out = s < stageCount - 1 ? rings[s] : NULL;
+			work[s].stats = &stageStats[s];
+			work[s].packets = packets;
+		}
+
+		for (int s = 0; s < stageCount; s++)
+			threads[s].create(stageThread, &work[s]);
+		for (int s = 0; s < stageCount; s++)
+			threads[s].join();
+
+		delete [] threads;
+		for (size_t r = 0; r < rings.size(); r++)
+			delete rings[r];
+	}
+
+	const PipeStageStats* stats() const { return &stageStats[0]; }
+
+private:
+	struct Stage
+	{
+		StageFunction function;
+		void* user;
+	};
+
+	struct StageThread
+	{
+		Stage* stage;
+		SPSCRing<T>* in;
+		SPSCRing<T>* out;
+		PipeStageStats* stats;
+		cl_uint packets;
+	};
+
+	static void* stageThread(void* data)
+	{
+		StageThread* work = (StageThread*)data;
+		PipeStageStats st;
+		memset(&st, 0, sizeof(st));
+
+		for (cl_uint i = 0; i < work->packets; i++)
+		{
+			T packet;
+
+			if (work->in != NULL)
+			{
+				while (!work->in->pop(packet))
+				{
+					st.readStalls++;
+					std::this_thread::yield();
+				}
+				st.packetsIn++;
+			}
+
+			work->stage->function(packet, work->stage->user);
+
+			if (work->out != NULL)
+			{
+				while (!work->out->push(packet))
+				{
+					st.writeStalls++;
+					std::this_thread::yield();
+				}
+				st.packetsOut++;
+
+				if ((i + 1) % HOST_PIPELINE_SAMPLE_PACKETS == 0)
+				{
+					cl_uint fill = work->out->size() * 100 / work->out->capacity();
+					st.occupancySum += fill;
+					st.occupancySamples++;
+					if (fill > st.occupancyMax)
+						st.occupancyMax = fill;
+				}
+			}
+		}
+
+		*work->stats = st;
+		return NULL;
+	}
+
+	std::vector<Stage> stages;
+	std::vector<PipeStageStats> stageStats;
+};
+
+#endif
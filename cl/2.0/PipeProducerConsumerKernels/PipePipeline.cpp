@@ -0,0 +1,434 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "PipePipeline.hpp"
+#include <iomanip>
+
+PipePipeline::PipePipeline()
+	: context(NULL), device(NULL), program(NULL), packetSize(0),
+	  stageStats(NULL), statsCapacity(0), fineGrainStats(false),
+	  statsMapped(false), runTime(0)
+{
+}
+
+PipePipeline::~PipePipeline()
+{
+	release();
+}
+
+int PipePipeline::create(cl_context context, cl_device_id device, cl_program program,
+			 cl_uint packetSize)
+{
+	this->context = context;
+	this->device = device;
+	this->program = program;
+	this->packetSize = packetSize;
+
+	// Without fine-grain buffers the host maps the stats block around its accesses
+	cl_device_svm_capabilities caps = 0;
+	cl_int status = clGetDeviceInfo(device, CL_DEVICE_SVM_CAPABILITIES, sizeof(caps),
+					&caps, NULL);
+	CHECK_OPENCL_ERROR(status, "clGetDeviceInfo failed.(CL_DEVICE_SVM_CAPABILITIES)");
+	fineGrainStats = (caps & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) != 0;
+
+	return SDK_SUCCESS;
+}
+
+int PipePipeline::addStage(const char* kernelName, size_t globalSize, size_t localSize)
+{
+	cl_int status;
+	Stage stage;
+
+	if (globalSize == 0 || localSize == 0 || globalSize % localSize)
+	{
+		std::cout << "Stage " << kernelName
+			  << ": global size must be a multiple of the work-group size" << std::endl;
+		return SDK_FAILURE;
+	}
+
+	stage.name = kernelName;
+	stage.globalSize = globalSize;
+	stage.localSize = localSize;
+	stage.time = 0;
+
+	stage.kernel = clCreateKernel(program, kernelName, &status);
+	CHECK_OPENCL_ERROR(status, "clCreateKernel failed.(stage)");
+
+	size_t maxGroupSize = 0;
+	status = clGetKernelWorkGroupInfo(stage.kernel, device, CL_KERNEL_WORK_GROUP_SIZE,
+					  sizeof(maxGroupSize), &maxGroupSize, NULL);
+	CHECK_OPENCL_ERROR(status, "clGetKernelWorkGroupInfo failed.");
+	if (localSize > maxGroupSize)
+	{
+		std::cout << "Stage " << kernelName << ": work-group size " << localSize
+			  << " exceeds the kernel's limit " << maxGroupSize << std::endl;
+		clReleaseKernel(stage.kernel);
+		return SDK_FAILURE;
+	}
+
+	// Profiling gives every stage its own start and end
+	cl_queue_properties prop[] = { CL_QUEUE_PROPERTIES, CL_QUEUE_PROFILING_ENABLE, 0 };
+	stage.queue = clCreateCommandQueueWithProperties(context, device, prop, &status);
+	CHECK_OPENCL_ERROR(status, "clCreateCommandQueueWithProperties failed.(stage)");
+
+	stages.push_back(stage);
+	if (stages.size() > 1)
+	{
+		pipes.push_back(NULL);
+		pipeSizes.push_back(0);
+		pipeAllocated.push_back(0);
+	}
+	return SDK_SUCCESS;
+}
+
+cl_uint PipePipeline::userArg(int stage) const
+{
+	// stats, stage and packets, plus a pipe on each connected side
+	cl_uint args = 3;
+	if (stage > 0)
+		args++;
+	if (stage < numStages() - 1)
+		args++;
+	return args;
+}
+
+int PipePipeline::ensurePipe(int pipe, cl_uint packets)
+{
+	if (pipes[pipe] != NULL && pipeAllocated[pipe] == packets)
+		return SDK_SUCCESS;
+
+	if (pipes[pipe] != NULL)
+	{
+		cl_int status = clReleaseMemObject(pipes[pipe]);
+		CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(pipe)");
+		pipes[pipe] = NULL;
+	}
+
+	cl_int status;
+	pipes[pipe] = clCreatePipe(context, CL_MEM_READ_WRITE, packetSize, packets, NULL,
+				   &status);
+	CHECK_OPENCL_ERROR(status, "clCreatePipe failed.");
+	pipeAllocated[pipe] = packets;
+
+	return SDK_SUCCESS;
+}
+
+int PipePipeline::mapStats(cl_map_flags flags)
+{
+	if (fineGrainStats || statsMapped)
+		return SDK_SUCCESS;
+
+	cl_int status = clEnqueueSVMMap(stages[0].queue, CL_TRUE, flags, stageStats,
+					statsCapacity * sizeof(PipeStageStats), 0, NULL, NULL);
+	CHECK_OPENCL_ERROR(status, "clEnqueueSVMMap failed.(stats)");
+	statsMapped = true;
+
+	return SDK_SUCCESS;
+}
+
+int PipePipeline::unmapStats()
+{
+	if (fineGrainStats || !statsMapped)
+		return SDK_SUCCESS;
+
+	cl_int status = clEnqueueSVMUnmap(stages[0].queue, stageStats, 0, NULL, NULL);
+	CHECK_OPENCL_ERROR(status, "clEnqueueSVMUnmap failed.(stats)");
+	status = clFinish(stages[0].queue);
+	CHECK_OPENCL_ERROR(status, "clFinish failed.(stats)");
+	statsMapped = false;
+
+	return SDK_SUCCESS;
+}
+
+int PipePipeline::run(cl_uint packets, bool concurrent)
+{
+	cl_int status;
+	int stageCount = numStages();
+
+	if (stageCount < 2)
+	{
+		std::cout << "A pipeline needs at least two stages" << std::endl;
+		return SDK_FAILURE;
+	}
+
+	for (int s = 0; s < stageCount; s++)
+	{
+		if (packets % stages[s].localSize)
+		{
+			std::cout << "Pipeline packets must be a multiple of the work-group size of "
+				  << stages[s].name << std::endl;
+			return SDK_FAILURE;
+		}
+	}
+
+	if (statsCapacity < (size_t)stageCount)
+	{
+		if (stageStats != NULL)
+		{
+			unmapStats();
+			clSVMFree(context, stageStats);
+		}
+
+		cl_svm_mem_flags flags = CL_MEM_READ_WRITE;
+		if (fineGrainStats)
+			flags |= CL_MEM_SVM_FINE_GRAIN_BUFFER;
+		stageStats = (PipeStageStats*)clSVMAlloc(context, flags,
+				stageCount * sizeof(PipeStageStats), sizeof(PipeStageStats));
+		CHECK_ALLOCATION(stageStats, "Failed to allocate SVM memory. (stageStats)");
+		statsCapacity = stageCount;
+	}
+
+	if (mapStats(CL_MAP_WRITE_INVALIDATE_REGION) != SDK_SUCCESS)
+		return SDK_FAILURE;
+	memset(stageStats, 0, stageCount * sizeof(PipeStageStats));
+	if (unmapStats() != SDK_SUCCESS)
+		return SDK_FAILURE;
+
+	// One stage after the other, a pipe has to hold everything its producer writes
+	for (int p = 0; p < stageCount - 1; p++)
+	{
+		cl_uint size = concurrent && pipeSizes[p] ? pipeSizes[p] : packets;
+		if (ensurePipe(p, size) != SDK_SUCCESS)
+			return SDK_FAILURE;
+	}
+
+	for (int s = 0; s < stageCount; s++)
+	{
+		cl_uint arg = 0;
+		cl_uint stage = (cl_uint)s;
+
+		if (s > 0)
+		{
+			status = clSetKernelArg(stages[s].kernel, arg++, sizeof(cl_mem), &pipes[s - 1]);
+			CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(input pipe)");
+		}
+		if (s < stageCount - 1)
+		{
+			status = clSetKernelArg(stages[s].kernel, arg++, sizeof(cl_mem), &pipes[s]);
+			CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(output pipe)");
+		}
+		status = clSetKernelArgSVMPointer(stages[s].kernel, arg++, stageStats);
+		CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer failed.(stats)");
+		status = clSetKernelArg(stages[s].kernel, arg++, sizeof(cl_uint), &stage);
+		CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(stage)");
+		status = clSetKernelArg(stages[s].kernel, arg++, sizeof(cl_uint), &packets);
+		CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(packets)");
+	}
+
+	std::vector<cl_event> events(stageCount, (cl_event)NULL);
+
+	if (concurrent)
+	{
+		/*
+		 * Consumers are enqueued first so they are waiting on their pipes
+		 * when the producers start. OpenCL does not promise that kernels on
+		 * different queues run at the same time: a stage spinning on a pipe
+		 * whose other end never starts gives up after PIPELINE_MAX_SPINS
+		 * and the run reports aborted().
+		 */
+		for (int s = stageCount - 1; s >= 0; s--)
+		{
+			status = clEnqueueNDRangeKernel(stages[s].queue, stages[s].kernel, 1, NULL,
+							&stages[s].globalSize, &stages[s].localSize,
+							0, NULL, &events[s]);
+			CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.(stage)");
+
+			status = clFlush(stages[s].queue);
+			CHECK_OPENCL_ERROR(status, "clFlush failed.(stage)");
+		}
+
+		for (int s = 0; s < stageCount; s++)
+		{
+			status = clWaitForEvents(1, &events[s]);
+			CHECK_OPENCL_ERROR(status, "clWaitForEvents failed.(stage)");
+		}
+	}
+	else
+	{
+		for (int s = 0; s < stageCount; s++)
+		{
+			status = clEnqueueNDRangeKernel(stages[s].queue, stages[s].kernel, 1, NULL,
+							&stages[s].globalSize, &stages[s].localSize,
+							0, NULL, &events[s]);
+			CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.(stage)");
+
+			status = clWaitForEvents(1, &events[s]);
+			CHECK_OPENCL_ERROR(status, "clWaitForEvents failed.(stage)");
+		}
+	}
+
+	cl_ulong first = 0, last = 0;
+	for (int s = 0; s < stageCount; s++)
+	{
+		cl_ulong start, end;
+		status = clGetEventProfilingInfo(events[s], CL_PROFILING_COMMAND_START,
+						 sizeof(start), &start, NULL);
+		CHECK_OPENCL_ERROR(status, "clGetEventProfilingInfo failed.(start)");
+		status = clGetEventProfilingInfo(events[s], CL_PROFILING_COMMAND_END,
+						 sizeof(end), &end, NULL);
+		CHECK_OPENCL_ERROR(status, "clGetEventProfilingInfo failed.(end)");
+
+		stages[s].time = (double)(end - start) * 1e-9;
+		if (s == 0 || start < first)
+			first = start;
+		if (s == 0 || end > last)
+			last = end;
+
+		status = clReleaseEvent(events[s]);
+		CHECK_OPENCL_ERROR(status, "clReleaseEvent failed.(stage)");
+	}
+	runTime = (double)(last - first) * 1e-9;
+
+	return mapStats(CL_MAP_READ);
+}
+
+int PipePipeline::calibrate(cl_uint packets)
+{
+	if (run(packets, false) != SDK_SUCCESS)
+		return SDK_FAILURE;
+
+	/*
+	 * Every resident work-group of the consumer holds one reservation, so
+	 * a pipe of two consumer launches worth of packets lets the producer
+	 * fill the next batches while the current ones are read. A producer
+	 * 'ratio' times faster than its consumer gets 'ratio' times that to
+	 * run ahead; more would only delay the point at which it stalls, since
+	 * no pipe size changes the rate of the slower stage.
+	 */
+	for (int p = 0; p < numStages() - 1; p++)
+	{
+		const Stage& producer = stages[p];
+		const Stage& consumer = stages[p + 1];
+
+		double producerRate = producer.time > 0 ? packets / producer.time : 0;
+		double consumerRate = consumer.time > 0 ? packets / consumer.time : 0;
+		double ratio = 1.0;
+		if (producerRate > consumerRate && consumerRate > 0)
+			ratio = producerRate / consumerRate;
+
+		size_t batch = producer.localSize > consumer.localSize ?
+			       producer.localSize : consumer.localSize;
+		double wanted = 2.0 * (double)consumer.globalSize * ratio;
+
+		cl_uint size = (cl_uint)(((size_t)wanted + batch - 1) / batch * batch);
+		if (size < 2 * batch)
+			size = (cl_uint)(2 * batch);
+		if (size > packets)
+			size = packets;
+		pipeSizes[p] = size;
+	}
+
+	return SDK_SUCCESS;
+}
+
+bool PipePipeline::aborted()
+{
+	if (stageStats == NULL)
+		return false;
+
+	for (int s = 0; s < numStages(); s++)
+	{
+		if (stageStats[s].aborted)
+			return true;
+	}
+	return false;
+}
+
+const PipeStageStats* PipePipeline::stats()
+{
+	return stageStats;
+}
+
+int PipePipeline::release()
+{
+	cl_int status;
+
+	if (stageStats != NULL)
+	{
+		unmapStats();
+		clSVMFree(context, stageStats);
+		stageStats = NULL;
+		statsCapacity = 0;
+	}
+
+	for (size_t p = 0; p < pipes.size(); p++)
+	{
+		if (pipes[p] != NULL)
+		{
+			status = clReleaseMemObject(pipes[p]);
+			CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(pipe)");
+		}
+	}
+	pipes.clear();
+	pipeSizes.clear();
+	pipeAllocated.clear();
+
+	for (size_t s = 0; s < stages.size(); s++)
+	{
+		status = clReleaseKernel(stages[s].kernel);
+		CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(stage)");
+		status = clReleaseCommandQueue(stages[s].queue);
+		CHECK_OPENCL_ERROR(status, "clReleaseCommandQueue failed.(stage)");
+	}
+	stages.clear();
+
+	return SDK_SUCCESS;
+}
+
+void printPipelineStats(const char* title, const std::vector<std::string>& names,
+			const PipeStageStats* stats, const double* times,
+			const cl_uint* pipeSizes)
+{
+	std::cout << std::endl << title << std::endl;
+	std::cout << std::setw(20) << std::left << "Stage" << std::right
+		  << std::setw(10) << "In"
+		  << std::setw(10) << "Out"
+		  << std::setw(13) << "ReadStalls"
+		  << std::setw(13) << "WriteStalls"
+		  << std::setw(10) << "AvgFill%"
+		  << std::setw(10) << "MaxFill%"
+		  << std::setw(10) << "Pipe"
+		  << std::setw(12) << "Time(sec)" << std::endl;
+
+	for (size_t s = 0; s < names.size(); s++)
+	{
+		const PipeStageStats& st = stats[s];
+		bool hasOutput = s + 1 < names.size();
+		double fill = st.occupancySamples ?
+			      (double)st.occupancySum / st.occupancySamples : 0.0;
+
+		std::cout << std::setw(20) << std::left << names[s] << std::right
+			  << std::setw(10) << st.packetsIn
+			  << std::setw(10) << st.packetsOut
+			  << std::setw(13) << st.readStalls
+			  << std::setw(13) << st.writeStalls
+			  << std::fixed << std::setprecision(1)
+			  << std::setw(10) << (hasOutput ? fill : 0.0)
+			  << std::setw(10) << st.occupancyMax;
+		if (hasOutput && pipeSizes != NULL)
+			std::cout << std::setw(10) << pipeSizes[s];
+		else
+			std::cout << std::setw(10) << "-";
+		if (times != NULL)
+			std::cout << std::setprecision(6) << std::setw(12) << times[s];
+		else
+			std::cout << std::setw(12) << "-";
+		if (st.aborted)
+			std::cout << "  (" << st.aborted << " work-groups aborted)";
+		std::cout << std::endl;
+		std::cout.unsetf(std::ios::fixed);
+	}
+}
@@ -0,0 +1,54 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef _PIPE_PIPELINE_H_
+#define _PIPE_PIPELINE_H_
+
+/*
+ * Layout shared by the host and the stage kernels of a pipe pipeline.
+ *
+ * Every stage owns one PipeStageStats in the SVM stats block, indexed by
+ * its position in the chain. Stage kernels add their work-group totals to
+ * it when they finish; the host pipeline updates the same fields from its
+ * stage threads, so both report through one structure.
+ */
+
+#ifndef PIPE_PIPELINE_OPENCL_DEVICE
+#include <CL/cl.h>
+typedef cl_uint pipe_uint;
+#else
+typedef uint    pipe_uint;
+#endif
+
+// Failed reservations in a row after which a stage work-group gives up
+#define PIPELINE_MAX_SPINS      (1 << 20)
+
+#define PIPELINE_LINE_UINTS     16      // 64-byte cache line
+
+typedef struct
+{
+	pipe_uint packetsIn;                // Packets read from the input pipe
+	pipe_uint packetsOut;               // Packets written to the output pipe
+	pipe_uint readStalls;               // Failed read reservations, input pipe empty
+	pipe_uint writeStalls;              // Failed write reservations, output pipe full
+	pipe_uint occupancySum;             // Output pipe fill in percent, summed over the samples
+	pipe_uint occupancySamples;         // Samples taken, one per batch written
+	pipe_uint occupancyMax;             // Highest output pipe fill in percent
+	pipe_uint aborted;                  // Work-groups which gave up after PIPELINE_MAX_SPINS
+	pipe_uint pad[PIPELINE_LINE_UINTS - 8];
+} PipeStageStats;
+
+#endif
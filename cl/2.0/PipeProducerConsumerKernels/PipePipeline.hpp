@@ -0,0 +1,142 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef _PIPE_PIPELINE_HPP_
+#define _PIPE_PIPELINE_HPP_
+
+#include <string>
+#include <vector>
+#include "CLUtil.hpp"
+#include "PipePipeline.h"
+
+using namespace appsdk;
+
+/**
+ * PipePipeline
+ * Chain of kernels connected by OpenCL 2.0 pipes: stage i writes the pipe
+ * stage i + 1 reads from. Each stage has its own command queue so the
+ * stages can run at the same time, data flowing through the pipes while
+ * they do.
+ *
+ * A stage kernel takes the pipeline's arguments first and its own after
+ * them, starting at userArg(stage):
+ *     first stage:  (write_only pipe out, stats, uint stage, uint packets, ...)
+ *     middle stage: (read_only pipe in, write_only pipe out, stats, uint stage, uint packets, ...)
+ *     last stage:   (read_only pipe in, stats, uint stage, uint packets, ...)
+ * 'stats' points to the PipeStageStats array in SVM, 'packets' is the
+ * number of packets every stage moves. Stages reserve whole work-groups
+ * of packets, so 'packets' must be a multiple of every work-group size.
+ */
+class PipePipeline
+{
+public:
+	PipePipeline();
+	~PipePipeline();
+
+	/**
+	 * Stages are created from 'program' and run on 'device', every pipe
+	 * carries packets of 'packetSize' bytes.
+	 * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+	 */
+	int create(cl_context context, cl_device_id device, cl_program program,
+		   cl_uint packetSize);
+
+	/**
+	 * Appends a stage running kernel 'kernelName' over 'globalSize'
+	 * work-items in work-groups of 'localSize'.
+	 * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+	 */
+	int addStage(const char* kernelName, size_t globalSize, size_t localSize);
+
+	int numStages() const { return (int)stages.size(); }
+	cl_kernel stageKernel(int stage) const { return stages[stage].kernel; }
+	cl_uint userArg(int stage) const;
+	const std::string& stageName(int stage) const { return stages[stage].name; }
+
+	/**
+	 * Runs the stages one after the other through pipes holding all
+	 * 'packets', then sizes every pipe from the rates of the two stages
+	 * it connects. Later concurrent runs use these sizes.
+	 * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+	 */
+	int calibrate(cl_uint packets);
+
+	/**
+	 * Moves 'packets' through the chain. Concurrent runs launch all stages
+	 * at once on their queues; otherwise every stage waits for the one
+	 * before it and the pipes are grown to hold the whole stream.
+	 * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+	 */
+	int run(cl_uint packets, bool concurrent);
+
+	/**
+	 * True when a work-group of the last run gave up waiting on a pipe,
+	 * its results are then incomplete.
+	 */
+	bool aborted();
+
+	const PipeStageStats* stats();
+	double stageTime(int stage) const { return stages[stage].time; }
+	double totalTime() const { return runTime; }
+	// Packets 'pipe' held in the last run; setPipeSize() sizes it for concurrent runs
+	cl_uint pipeSize(int pipe) const { return pipeAllocated[pipe]; }
+	void setPipeSize(int pipe, cl_uint packets) { pipeSizes[pipe] = packets; }
+
+	/**
+	 * Releases kernels, queues, pipes and the stats block.
+	 */
+	int release();
+
+private:
+	struct Stage
+	{
+		std::string name;
+		cl_kernel kernel;
+		cl_command_queue queue;
+		size_t globalSize;
+		size_t localSize;
+		double time;                    // Seconds of the last run
+	};
+
+	int ensurePipe(int pipe, cl_uint packets);
+	int mapStats(cl_map_flags flags);
+	int unmapStats();
+
+	cl_context context;
+	cl_device_id device;
+	cl_program program;
+	cl_uint packetSize;
+
+	std::vector<Stage> stages;
+	std::vector<cl_mem> pipes;          // pipes[i] connects stage i and stage i + 1
+	std::vector<cl_uint> pipeSizes;     // Packets of pipes[i] in concurrent runs
+	std::vector<cl_uint> pipeAllocated; // Packets pipes[i] was created with
+
+	PipeStageStats* stageStats;         // SVM, one per stage
+	size_t statsCapacity;
+	bool fineGrainStats;
+	bool statsMapped;
+	double runTime;                     // Seconds from the first stage start to the last stage end
+};
+
+/**
+ * Prints one row of 'stats' per stage. 'times' and 'pipeSizes' may be NULL.
+ */
+void printPipelineStats(const char* title, const std::vector<std::string>& names,
+			const PipeStageStats* stats, const double* times,
+			const cl_uint* pipeSizes);
+
+#endif
@@ -16,19 +16,123 @@ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVE
 
 #include "PipeProducerConsumerKernels.hpp"
 #include <cmath>
+#include <algorithm>
+#include <iomanip>
+
+// Quantiles the sketch is checked and reported at
+static const cl_float sketchQuantiles[SKETCH_QUANTILES] =
+{
+	0.001f, 0.01f, 0.1f, 0.25f, 0.5f, 0.75f, 0.9f, 0.99f, 0.999f
+};
+
+/*
+ * Adds both components of [rn] to [hist], searching the bins the same way
+ * the consumer kernel compares against them.
+ */
+static void addToHistogram(cl_int *hist, cl_float2 rn, float histMin, float binWidth)
+{
+	float rmin = histMin;
+	float rmax = rmin + binWidth;
+	int   found = 0;
+
+	for (int bindex = 0; (bindex < MAX_HIST_BINS) && (found != 2); bindex++)
+	{
+
+		if ((rn.x >= rmin) && (rn.x < rmax))
+		{
+			found += 1;
+			hist[bindex] += 1;
+		}
+
+		if ((rn.y >= rmin) && (rn.y < rmax))
+		{
+			found += 1;
+			hist[bindex] += 1;
+		}
+
+		rmin = rmax;
+		rmax = rmin + binWidth;
+	}
+}
+
+/*
+ * Host pipeline stages, the counterparts of stage_generate, stage_transform
+ * and stage_histogram.
+ */
+struct HostGenerateState
+{
+	PM_PRNG prng;
+	cl_int2 irn[PRNG_CHANNELS];
+	cl_uint next;
+};
+
+struct HostHistogramState
+{
+	cl_int *hist;
+	float   histMin;
+	float   binWidth;
+};
+
+// Packets come out in the order of the reference: channel after channel
+static void hostGenerate(cl_float2& packet, void* user)
+{
+	HostGenerateState *state = (HostGenerateState *)user;
+	int ch = state->next++ % PRNG_CHANNELS;
+
+	state->irn[ch].x = state->prng.rngPM(state->irn[ch].y, ch);
+	state->irn[ch].y = state->prng.rngPM(state->irn[ch].x, ch);
+
+	packet.x = state->irn[ch].x *AM;
+	if (packet.x > RMAX)
+		packet.x = (cl_float)RMAX;
+
+	packet.y = state->irn[ch].y *AM;
+	if (packet.y > RMAX)
+		packet.y = (cl_float)RMAX;
+}
+
+static void hostTransform(cl_float2& packet, void* user)
+{
+	if (*(cl_int *)user == RV_GAUSSIAN)
+	{
+		packet = boxMuller(packet);
+	}
+}
+
+static void hostHistogram(cl_float2& packet, void* user)
+{
+	HostHistogramState *state = (HostHistogramState *)user;
+	addToHistogram(state->hist, packet, state->histMin, state->binWidth);
+}
 
 int
 PIPE_PCK::setupPIPE_PCK()
 {
-	localDevHist = (cl_int *)malloc(MAX_HIST_BINS*sizeof(cl_int));
+	localDevHist = (cl_int *)malloc(histBins*sizeof(cl_int));
 	CHECK_ALLOCATION(localDevHist, "failed to allocate memory (devHist)");
 
-	memset(localDevHist, 0, MAX_HIST_BINS*sizeof(cl_int));
+	memset(localDevHist, 0, histBins*sizeof(cl_int));
 
-	cpuHist = (cl_int *)malloc(MAX_HIST_BINS*sizeof(cl_int));
+	cpuHist = (cl_int *)malloc(histBins*sizeof(cl_int));
 	CHECK_ALLOCATION(cpuHist, "failed to allocate memory (cpuHist)");
 
-	memset(cpuHist, 0, MAX_HIST_BINS*sizeof(cl_int));
+	memset(cpuHist, 0, histBins*sizeof(cl_int));
+
+	zigguratSetup(&zigTables);
+
+	if (runPipeline)
+	{
+		pipelineCpuHist = (cl_int *)malloc(MAX_HIST_BINS*sizeof(cl_int));
+		CHECK_ALLOCATION(pipelineCpuHist, "failed to allocate memory (pipelineCpuHist)");
+
+		memset(pipelineCpuHist, 0, MAX_HIST_BINS*sizeof(cl_int));
+
+		pipelineDevHist = (cl_int *)malloc(MAX_HIST_BINS*sizeof(cl_int));
+		CHECK_ALLOCATION(pipelineDevHist, "failed to allocate memory (pipelineDevHist)");
+
+		hostPipelineHist = (cl_int *)malloc(MAX_HIST_BINS*sizeof(cl_int));
+		CHECK_ALLOCATION(hostPipelineHist, "failed to allocate memory (hostPipelineHist)");
+	}
 
 	return SDK_SUCCESS;
 }
@@ -128,11 +232,48 @@ PIPE_PCK::setupCL()
 
 	devHist = clCreateBuffer(context,
 		CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
-		MAX_HIST_BINS*sizeof(cl_int),
+		histBins*sizeof(cl_int),
 		localDevHist,
 		&status);
 	CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.");
 
+	zigBuffer = clCreateBuffer(context,
+		CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		sizeof(ZigguratTables),
+		&zigTables,
+		&status);
+	CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(zigBuffer)");
+
+	/*
+	* Enough work-groups to fill the device, each one takes its turns on the
+	* batches of the pipe. Every work-group of the sketch flushes a buffer
+	* per SKETCH_BUFFER samples it reads plus a partial one at the end.
+	*/
+	cl_uint groups = deviceInfo.maxComputeUnits * SAMPLER_GROUPS_PER_CU;
+	if (groups > (cl_uint)szPipe / SAMPLER_GROUP_SIZE)
+		groups = szPipe / SAMPLER_GROUP_SIZE;
+	if (groups == 0)
+		groups = 1;
+
+	producerGlobalSize = groups * producerGroupSize;
+	consumerGlobalSize = groups * consumerGroupSize;
+
+	maxCentroids = (2 * szPipe / SKETCH_BUFFER + groups) * sketchCentroidBound(compression);
+
+	centroidBuffer = clCreateBuffer(context,
+		CL_MEM_READ_WRITE,
+		maxCentroids*sizeof(cl_float2),
+		NULL,
+		&status);
+	CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(centroidBuffer)");
+
+	centroidCount = clCreateBuffer(context,
+		CL_MEM_READ_WRITE,
+		sizeof(cl_uint),
+		NULL,
+		&status);
+	CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(centroidCount)");
+
 	//create a CL program using the kernel source
 	buildProgramData buildData;
 	buildData.kernelName
@@ -160,7 +301,7 @@ PIPE_PCK::setupCL()
 	// producer kernel
 	produceKernel = clCreateKernel(
 		program,
-		"pipe_producer",
+		"pipe_sampler",
 		&status);
 	CHECK_OPENCL_ERROR(status, "clCreateKernel failed(produceKernel).");
 
@@ -168,10 +309,15 @@ PIPE_PCK::setupCL()
 		devices[sampleArgs->deviceId]);
 	CHECK_ERROR(status, SDK_SUCCESS, "setKernelWorkGroupInfo() failed");
 
+	if (kernelInfo.kernelWorkGroupSize < producerGroupSize)
+	{
+		OPENCL_EXPECTED_ERROR("Unsupported! pipe_sampler needs work-groups of SAMPLER_GROUP_SIZE");
+	}
+
 	// consumer kernel
 	consumeKernel = clCreateKernel(
 		program,
-		"pipe_consumer",
+		"pipe_sketch",
 		&status);
 	CHECK_OPENCL_ERROR(status, "clCreateKernel failed(consumeKernel).");
 
@@ -179,6 +325,76 @@ PIPE_PCK::setupCL()
 		devices[sampleArgs->deviceId]);
 	CHECK_ERROR(status, SDK_SUCCESS, "setKernelWorkGroupInfo() failed");
 
+	if (kernelInfo.kernelWorkGroupSize < consumerGroupSize)
+	{
+		OPENCL_EXPECTED_ERROR("Unsupported! pipe_sketch needs work-groups of SAMPLER_GROUP_SIZE");
+	}
+
+	// the local histogram comes on top of the sketch buffer
+	if ((cl_ulong)histBins*sizeof(cl_int) + kernelInfo.localMemoryUsed > deviceInfo.localMemSize)
+	{
+		OPENCL_EXPECTED_ERROR("Unsupported! Histogram bins exceed the local memory, use fewer --bins");
+	}
+
+	if (runPipeline)
+	{
+		pipelineHist = clCreateBuffer(context,
+			CL_MEM_READ_WRITE,
+			MAX_HIST_BINS*sizeof(cl_int),
+			NULL,
+			&status);
+		CHECK_OPENCL_ERROR(status, "clCreateBuffer failed.(pipelineHist)");
+
+		// generate -> transform (box muller) -> relays -> histogram
+		pipeline = new PipePipeline();
+		retValue = pipeline->create(context, devices[sampleArgs->deviceId], program, szPipePkt);
+		CHECK_ERROR(retValue, SDK_SUCCESS, "PipePipeline::create() failed");
+
+		retValue = pipeline->addStage("stage_generate", PRNG_CHANNELS, PRNG_CHANNELS);
+		CHECK_ERROR(retValue, SDK_SUCCESS, "PipePipeline::addStage() failed(stage_generate)");
+
+		for (int s = 1; s < pipelineStages - 1; s++)
+		{
+			retValue = pipeline->addStage("stage_transform",
+				PIPELINE_STAGE_GROUPS*PIPELINE_GROUP_SIZE, PIPELINE_GROUP_SIZE);
+			CHECK_ERROR(retValue, SDK_SUCCESS, "PipePipeline::addStage() failed(stage_transform)");
+		}
+
+		retValue = pipeline->addStage("stage_histogram",
+			PIPELINE_STAGE_GROUPS*PIPELINE_GROUP_SIZE, PIPELINE_GROUP_SIZE);
+		CHECK_ERROR(retValue, SDK_SUCCESS, "PipePipeline::addStage() failed(stage_histogram)");
+
+		int last = pipeline->numStages() - 1;
+
+		status = clSetKernelArg(pipeline->stageKernel(0),
+			pipeline->userArg(0),
+			sizeof(cl_int),
+			(void *)(&seed));
+		CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(seed)");
+
+		for (int s = 1; s < last; s++)
+		{
+			// only the first transform draws gaussians, the others relay
+			cl_int stageType = (s == 1) ? rngType : RV_UNIFORM;
+			status = clSetKernelArg(pipeline->stageKernel(s),
+				pipeline->userArg(s),
+				sizeof(cl_int),
+				(void *)(&stageType));
+			CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(rngType)");
+		}
+
+		cl_uint arg = pipeline->userArg(last);
+		status = clSetKernelArg(pipeline->stageKernel(last), arg++, sizeof(cl_mem),
+			(void *)(&pipelineHist));
+		CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(pipelineHist)");
+		status = clSetKernelArg(pipeline->stageKernel(last), arg++, sizeof(cl_float),
+			(void *)(&histMin));
+		CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(histMin)");
+		status = clSetKernelArg(pipeline->stageKernel(last), arg++, sizeof(cl_float),
+			(void *)(&histMax));
+		CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(histMax)");
+	}
+
 	return SDK_SUCCESS;
 }
 
@@ -186,34 +402,69 @@ int
 PIPE_PCK::runCLKernels()
 {
 	cl_int status;
+	cl_int zero = 0;
+	cl_uint packets = szPipe;
+	cl_uint bins = histBins;
+	cl_uint arg = 0;
+
+	status = clEnqueueFillBuffer(commandQueue[1],
+		devHist,
+		&zero,
+		sizeof(cl_int),
+		0,
+		histBins*sizeof(cl_int),
+		0,
+		NULL,
+		NULL);
+	CHECK_OPENCL_ERROR(status, "clEnqueueFillBuffer failed.(devHist)");
+
+	status = clEnqueueFillBuffer(commandQueue[1],
+		centroidCount,
+		&zero,
+		sizeof(cl_uint),
+		0,
+		sizeof(cl_uint),
+		0,
+		NULL,
+		NULL);
+	CHECK_OPENCL_ERROR(status, "clEnqueueFillBuffer failed.(centroidCount)");
 
 	// Set appropriate arguments to the kernel
 	status = clSetKernelArg(produceKernel,
 		0,
 		sizeof(cl_mem),
 		(void *)(&rngPipe));
-
 	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(rngPipe)");
 
 	status = clSetKernelArg(produceKernel,
 		1,
-		sizeof(cl_int),
-		(void *)(&pipePktPerThread));
-
-	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(pipePktPerThread)");
+		sizeof(cl_mem),
+		(void *)(&zigBuffer));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(zigBuffer)");
 
 	status = clSetKernelArg(produceKernel,
 		2,
+		sizeof(cl_uint),
+		(void *)(&packets));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(packets)");
+
+	status = clSetKernelArg(produceKernel,
+		3,
 		sizeof(cl_int),
 		(void *)(&seed));
-
 	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(seed)");
 
 	status = clSetKernelArg(produceKernel,
-		3,
+		4,
 		sizeof(cl_int),
-		(void *)(&rngType));
-	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(rngType)");
+		(void *)(&dist));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(dist)");
+
+	status = clSetKernelArg(produceKernel,
+		5,
+		sizeof(cl_float),
+		(void *)(&gammaShape));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(gammaShape)");
 
 	// Enqueue both the kernels.
 	size_t globalThreads[] = { producerGlobalSize };
@@ -242,29 +493,38 @@ PIPE_PCK::runCLKernels()
 	status = waitForEventAndRelease(&produceEvt);  
 	CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(produceEvt) Failed");
 
-	status = clSetKernelArg(consumeKernel,
-		0,
-		sizeof(cl_mem),
-		(void *)(&rngPipe));
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_mem), (void *)(&rngPipe));
 	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(rngPipe)");
 
-	status = clSetKernelArg(consumeKernel,
-		1,
-		sizeof(cl_mem),
-		(void *)(&devHist));
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_uint), (void *)(&packets));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(packets)");
+
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_mem), (void *)(&devHist));
 	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(devHist)");
 
-	status = clSetKernelArg(consumeKernel,
-		2,
-		sizeof(cl_float),
-		(void *)(&histMin));
-	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(histMin)");
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_uint), (void *)(&bins));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(bins)");
 
-	status = clSetKernelArg(consumeKernel,
-		3,
-		sizeof(cl_float),
-		(void *)(&histMax));
-	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(histMax)");
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_float), (void *)(&sampleMin));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(sampleMin)");
+
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_float), (void *)(&histScale));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(histScale)");
+
+	status = clSetKernelArg(consumeKernel, arg++, histBins*sizeof(cl_int), NULL);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(lhist)");
+
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_mem), (void *)(&centroidBuffer));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(centroidBuffer)");
+
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_mem), (void *)(&centroidCount));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(centroidCount)");
+
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_uint), (void *)(&maxCentroids));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(maxCentroids)");
+
+	status = clSetKernelArg(consumeKernel, arg++, sizeof(cl_float), (void *)(&compression));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg failed.(compression)");
 
 	globalThreads[0] = consumerGlobalSize;
 	localThreads[0] = consumerGroupSize;
@@ -281,16 +541,10 @@ PIPE_PCK::runCLKernels()
 		NULL);
 	CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
 
-	status = clFlush(commandQueue[0]);
-	CHECK_OPENCL_ERROR(status, "clFlush failed(0).");
-
 	status = clFlush(commandQueue[1]);
 	CHECK_OPENCL_ERROR(status, "clFlush failed(1).");
 
 	//wait for kernels to finish
-	status = clFinish(commandQueue[0]);
-	CHECK_OPENCL_ERROR(status, "clFinish failed(0).");
-
 	status = clFinish(commandQueue[1]);
 	CHECK_OPENCL_ERROR(status, "clFinish failed(1).");
 
@@ -300,18 +554,184 @@ PIPE_PCK::runCLKernels()
 		devHist,
 		CL_TRUE,
 		0,
-		(MAX_HIST_BINS)*sizeof(cl_int),
+		histBins*sizeof(cl_int),
 		(void *)localDevHist,
 		0,
 		NULL,
 		NULL);
 	CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.");
 
+	status = clEnqueueReadBuffer(commandQueue[1],
+		centroidCount,
+		CL_TRUE,
+		0,
+		sizeof(cl_uint),
+		(void *)&centroidsWritten,
+		0,
+		NULL,
+		NULL);
+	CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(centroidCount)");
+
+	// the digest is merged on the host once the timed runs are over
+	digest.resize(std::min(centroidsWritten, maxCentroids));
+	if (!digest.empty())
+	{
+		status = clEnqueueReadBuffer(commandQueue[1],
+			centroidBuffer,
+			CL_TRUE,
+			0,
+			digest.size()*sizeof(cl_float2),
+			(void *)&digest[0],
+			0,
+			NULL,
+			NULL);
+		CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(centroidBuffer)");
+	}
+
+	return SDK_SUCCESS;
+}
+
+int
+PIPE_PCK::clearPipelineHist()
+{
+	cl_int zero = 0;
+	cl_int status = clEnqueueFillBuffer(commandQueue[0],
+		pipelineHist,
+		&zero,
+		sizeof(cl_int),
+		0,
+		MAX_HIST_BINS*sizeof(cl_int),
+		0,
+		NULL,
+		NULL);
+	CHECK_OPENCL_ERROR(status, "clEnqueueFillBuffer failed.(pipelineHist)");
+
+	status = clFinish(commandQueue[0]);
+	CHECK_OPENCL_ERROR(status, "clFinish failed(0).");
+
+	return SDK_SUCCESS;
+}
+
+int
+PIPE_PCK::runPipelines()
+{
+	cl_int status;
+	cl_uint packets = szPipe;
+	int stages = pipeline->numStages();
+
+	// one stage after the other: measures each stage's rate and sizes the pipes
+	if (clearPipelineHist() != SDK_SUCCESS ||
+		pipeline->calibrate(packets) != SDK_SUCCESS)
+	{
+		return SDK_FAILURE;
+	}
+
+	if (clearPipelineHist() != SDK_SUCCESS ||
+		pipeline->run(packets, true) != SDK_SUCCESS)
+	{
+		return SDK_FAILURE;
+	}
+
+	pipelineConcurrent = !pipeline->aborted();
+	if (!pipelineConcurrent)
+	{
+		std::cout << "Pipeline stages did not run concurrently on this device, "
+			<< "running them one after the other" << std::endl;
+
+		if (clearPipelineHist() != SDK_SUCCESS ||
+			pipeline->run(packets, false) != SDK_SUCCESS)
+		{
+			return SDK_FAILURE;
+		}
+	}
+
+	status = clEnqueueReadBuffer(commandQueue[0],
+		pipelineHist,
+		CL_TRUE,
+		0,
+		MAX_HIST_BINS*sizeof(cl_int),
+		(void *)pipelineDevHist,
+		0,
+		NULL,
+		NULL);
+	CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed.(pipelineHist)");
+
+	devPipelineTime = pipeline->totalTime();
+	stageNames.clear();
+	devStageTimes.clear();
+	devPipeSizes.clear();
+	for (int s = 0; s < stages; s++)
+	{
+		stageNames.push_back(pipeline->stageName(s));
+		devStageTimes.push_back(pipeline->stageTime(s));
+		if (s < stages - 1)
+			devPipeSizes.push_back(pipeline->pipeSize(s));
+	}
+	devStageStats.assign(pipeline->stats(), pipeline->stats() + stages);
+
+	// the same stages on host threads
+	HostGenerateState generateState;
+	generateState.prng.rngInit(seed);
+	generateState.next = 0;
+	for (int ch = 0; ch < PRNG_CHANNELS; ++ch)
+	{
+		generateState.irn[ch].x = generateState.irn[ch].y = (ch + 1)*(ch + 1);
+	}
+
+	cl_int relayType = RV_UNIFORM;
+
+	HostHistogramState histogramState;
+	histogramState.hist = hostPipelineHist;
+	histogramState.histMin = histMin;
+	histogramState.binWidth = (histMax - histMin) / (float)(MAX_HIST_BINS);
+	memset(hostPipelineHist, 0, MAX_HIST_BINS*sizeof(cl_int));
+
+	HostPipeline<cl_float2> hostPipeline;
+	hostPipeline.addStage(hostGenerate, &generateState);
+	for (int s = 1; s < stages - 1; s++)
+	{
+		hostPipeline.addStage(hostTransform, (s == 1) ? &rngType : &relayType);
+	}
+	hostPipeline.addStage(hostHistogram, &histogramState);
+
+	int timer = sampleTimer->createTimer();
+	sampleTimer->resetTimer(timer);
+	sampleTimer->startTimer(timer);
+
+	hostPipeline.run(packets, HOST_PIPELINE_RING_SIZE);
+
+	sampleTimer->stopTimer(timer);
+	hostPipelineTime = (double)(sampleTimer->readTimer(timer));
+
+	hostStageStats.assign(hostPipeline.stats(), hostPipeline.stats() + stages);
+	hostRingSizes.assign(stages - 1, HOST_PIPELINE_RING_SIZE);
+
 	return SDK_SUCCESS;
 }
 
 void
-PIPE_PCK::sampleCPUReference()
+PIPE_PCK::sampleCPUReference(std::vector<cl_float>& samples)
+{
+	cl_uint groups = (cl_uint)(producerGlobalSize / producerGroupSize);
+
+	samples.resize(2 * (size_t)szPipe);
+	samplerReference(&samples[0], szPipe, groups, (cl_uint)producerGroupSize,
+		seed, dist, gammaShape, &zigTables);
+
+	// bins are found with the same float arithmetic as in pipe_sketch
+	memset(cpuHist, 0, histBins*sizeof(cl_int));
+	for (size_t i = 0; i < samples.size(); ++i)
+	{
+		cl_float pos = (samples[i] - sampleMin)*histScale;
+		if ((pos >= 0) && (pos < (cl_float)histBins))
+		{
+			cpuHist[(int)pos] += 1;
+		}
+	}
+}
+
+void
+PIPE_PCK::pipelineCPUReference()
 {
 	PM_PRNG   pmPRNG;
 	cl_int2   irn[PRNG_CHANNELS];
@@ -362,28 +782,7 @@ PIPE_PCK::sampleCPUReference()
 		// host side histogram
 		for (int ch = 0; ch < PRNG_CHANNELS; ++ch)
 		{
-			float rmin = histMin;
-			float rmax = rmin + binWidth;
-			int   found = 0;
-
-			for (int bindex = 0; (bindex < MAX_HIST_BINS) && (found != 2); bindex++)
-			{
-
-				if ((grn[ch].x >= rmin) && (grn[ch].x < rmax))
-				{
-					found += 1;
-					cpuHist[bindex] += 1;
-				}
-
-				if ((grn[ch].y >= rmin) && (grn[ch].y < rmax))
-				{
-					found += 1;
-					cpuHist[bindex] += 1;
-				}
-
-				rmin = rmax;
-				rmax = rmin + binWidth;
-			}
+			addToHistogram(pipelineCpuHist, grn[ch], histMin, binWidth);
 		}
 	}
 }
@@ -427,7 +826,7 @@ PIPE_PCK::initialize()
 
 	delete sz_pipe_option;
 
-	//pipe size option
+	//seed option
 	Option* seed_option = new Option;
 	CHECK_ALLOCATION(seed_option, "Memory Allocation error.\n");
 
@@ -441,6 +840,68 @@ PIPE_PCK::initialize()
 
 	delete seed_option;
 
+	//sampler and sketch options
+	Option* sketch_option = new Option;
+	CHECK_ALLOCATION(sketch_option, "Memory Allocation error.\n");
+
+	sketch_option->_sVersion = "";
+	sketch_option->_lVersion = "dist";
+	sketch_option->_description = "Sampler distribution: normal, exponential or gamma";
+	sketch_option->_type = CA_ARG_STRING;
+	sketch_option->_value = &distName;
+
+	sampleArgs->AddOption(sketch_option);
+
+	sketch_option->_sVersion = "";
+	sketch_option->_lVersion = "shape";
+	sketch_option->_description = "Shape of the gamma distribution";
+	sketch_option->_type = CA_ARG_FLOAT;
+	sketch_option->_value = &gammaShape;
+
+	sampleArgs->AddOption(sketch_option);
+
+	sketch_option->_sVersion = "";
+	sketch_option->_lVersion = "bins";
+	sketch_option->_description = "Bins of the streaming histogram";
+	sketch_option->_type = CA_ARG_INT;
+	sketch_option->_value = &histBins;
+
+	sampleArgs->AddOption(sketch_option);
+
+	sketch_option->_sVersion = "";
+	sketch_option->_lVersion = "compression";
+	sketch_option->_description = "Compression of the t-digest quantile sketch";
+	sketch_option->_type = CA_ARG_FLOAT;
+	sketch_option->_value = &compression;
+
+	sampleArgs->AddOption(sketch_option);
+
+	delete sketch_option;
+
+	//stage pipeline options
+	Option* pipeline_option = new Option;
+	CHECK_ALLOCATION(pipeline_option, "Memory Allocation error.\n");
+
+	pipeline_option->_sVersion = "";
+	pipeline_option->_lVersion = "pipeline";
+	pipeline_option->_description =
+		"Also run the stage pipeline concurrently on the device and on host threads";
+	pipeline_option->_type = CA_NO_ARGUMENT;
+	pipeline_option->_value = &runPipeline;
+
+	sampleArgs->AddOption(pipeline_option);
+
+	pipeline_option->_sVersion = "";
+	pipeline_option->_lVersion = "stages";
+	pipeline_option->_description =
+		"Pipeline stages: generate, box muller, relays, histogram (at least 3)";
+	pipeline_option->_type = CA_ARG_INT;
+	pipeline_option->_value = &pipelineStages;
+
+	sampleArgs->AddOption(pipeline_option);
+
+	delete pipeline_option;
+
 	return SDK_SUCCESS;
 }
 
@@ -454,9 +915,57 @@ PIPE_PCK::setup()
 	if (szPipe % PRNG_CHANNELS)
 		szPipe = (szPipe / PRNG_CHANNELS)*PRNG_CHANNELS + PRNG_CHANNELS;
 
-	consumerGlobalSize = szPipe;
 	pipePktPerThread = szPipe / PRNG_CHANNELS;
 
+	if (distName.compare("exponential") == 0)
+	{
+		dist = DIST_EXPONENTIAL;
+		sampleMin = 0.0f;
+		sampleMax = 15.0f;
+	}
+	else if (distName.compare("gamma") == 0)
+	{
+		if (!(gammaShape > 0.0f))
+		{
+			std::cout << "Gamma shape must be positive" << std::endl;
+			return SDK_FAILURE;
+		}
+		dist = DIST_GAMMA;
+		sampleMin = 0.0f;
+		sampleMax = gammaShape + 10.0f*sqrtf(gammaShape) + 5.0f;
+	}
+	else if (distName.compare("normal") == 0)
+	{
+		dist = DIST_NORMAL;
+		sampleMin = -5.0f;
+		sampleMax = 5.0f;
+	}
+	else
+	{
+		std::cout << "Unknown distribution " << distName
+			<< ", use normal, exponential or gamma" << std::endl;
+		return SDK_FAILURE;
+	}
+
+	if (histBins < 1)
+	{
+		histBins = DEFAULT_HIST_BINS;
+	}
+	histScale = (cl_float)histBins / (sampleMax - sampleMin);
+
+	if (compression < 10.0f)
+	{
+		std::cout << "Compression below 10, using 10" << std::endl;
+		compression = 10.0f;
+	}
+
+	if (pipelineStages < PIPELINE_MIN_STAGES)
+	{
+		std::cout << "Pipeline needs at least " << PIPELINE_MIN_STAGES
+			<< " stages, using " << PIPELINE_MIN_STAGES << std::endl;
+		pipelineStages = PIPELINE_MIN_STAGES;
+	}
+
 	// create and initialize timers
 	int timer = sampleTimer->createTimer();
 	sampleTimer->resetTimer(timer);
@@ -517,6 +1026,13 @@ PIPE_PCK::run()
 	// Compute kernel time
 	kernelTime = (double)(sampleTimer->readTimer(timer)) / iterations;
 
+	tdigestMerge(digest, compression);
+
+	if (runPipeline && runPipelines() != SDK_SUCCESS)
+	{
+		return SDK_FAILURE;
+	}
+
 	return SDK_SUCCESS;
 }
 
@@ -542,6 +1058,29 @@ PIPE_PCK::cleanup()
 	status = clReleaseMemObject(devHist);
 	CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
 
+	status = clReleaseMemObject(zigBuffer);
+	CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(zigBuffer)");
+
+	status = clReleaseMemObject(centroidBuffer);
+	CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(centroidBuffer)");
+
+	status = clReleaseMemObject(centroidCount);
+	CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(centroidCount)");
+
+	if (pipeline)
+	{
+		status = pipeline->release();
+		CHECK_ERROR(status, SDK_SUCCESS, "PipePipeline::release() failed");
+		delete pipeline;
+		pipeline = NULL;
+	}
+
+	if (pipelineHist)
+	{
+		status = clReleaseMemObject(pipelineHist);
+		CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.(pipelineHist)");
+	}
+
 	for (int i = 0; i < MAX_COMMAND_QUEUE; ++i)
 	{
 		status = clReleaseCommandQueue(commandQueue[i]);
@@ -558,6 +1097,15 @@ PIPE_PCK::cleanup()
 	if (cpuHist)
 		free(cpuHist);
 
+	if (pipelineCpuHist)
+		free(pipelineCpuHist);
+
+	if (pipelineDevHist)
+		free(pipelineDevHist);
+
+	if (hostPipelineHist)
+		free(hostPipelineHist);
+
 	return SDK_SUCCESS;
 }
 
@@ -566,31 +1114,91 @@ PIPE_PCK::verifyResults()
 {
 	if (sampleArgs->verify)
 	{
-		//Find the tolerance limit
-		float fTol = (float)(CONSUMER_GLOBAL_SIZE)*(float)(COMP_TOL) / (float)100.0;
-		int   iTol = (int)(fTol);
-		if (iTol == 0)
-			iTol = 1;
+		std::vector<cl_float> samples;
+		bool passed = true;
 
 		//CPU side histogram computation
-		sampleCPUReference();
-
-		//Compare
-		for (int bin = 0; bin < MAX_HIST_BINS; ++bin)
+		sampleCPUReference(samples);
+
+		/*
+		* The device replays the same streams, but where its exp/log round
+		* differently a rejection step can go the other way and the stream
+		* shifts. Bins are compared within the counting noise of the bin.
+		*/
+		for (int bin = 0; bin < histBins; ++bin)
 		{
 			int diff = localDevHist[bin] - cpuHist[bin];
 
 			if (diff < 0)
 				diff = -diff;
 
-			if (diff > iTol)
+			if (diff > 6.0*sqrt((double)std::max(cpuHist[bin], 1)) + 2.0)
+			{
+				std::cout << "Failed! (histogram bin " << bin << ")\n" << std::endl;
+				passed = false;
+				break;
+			}
+		}
+
+		// rank of the sketch quantiles among the reference samples
+		std::sort(samples.begin(), samples.end());
+		double n = (double)samples.size();
+		quantilesVerified = !digest.empty();
+
+		for (int q = 0; q < SKETCH_QUANTILES && quantilesVerified; ++q)
+		{
+			double p = sketchQuantiles[q];
+			size_t exact = std::min((size_t)(p*n), samples.size() - 1);
+
+			quantileEst[q] = tdigestQuantile(digest, sketchQuantiles[q]);
+			quantileExact[q] = samples[exact];
+			quantileRankErr[q] = fabs((double)(std::lower_bound(samples.begin(),
+				samples.end(), quantileEst[q]) - samples.begin()) / n - p);
+
+			if (passed && quantileRankErr[q] > SKETCH_RANK_TOL + 4.0*sqrt(p*(1.0 - p)/n))
+			{
+				std::cout << "Failed! (quantile " << p << ")\n" << std::endl;
+				passed = false;
+			}
+		}
+
+		//Compare the pipelines
+		if (passed && runPipeline)
+		{
+			//Find the tolerance limit
+			float fTol = (float)(CONSUMER_GLOBAL_SIZE)*(float)(COMP_TOL) / (float)100.0;
+			int   iTol = (int)(fTol);
+			if (iTol == 0)
+				iTol = 1;
+
+			pipelineCPUReference();
+
+			const char *pipelineNames[2] = { "device pipeline", "host pipeline" };
+			cl_int *pipelineHists[2] = { pipelineDevHist, hostPipelineHist };
+
+			for (int p = 0; passed && p < 2; ++p)
 			{
-				std::cout << "Failed! \n" << std::endl;
-				return SDK_SUCCESS;
+				for (int bin = 0; bin < MAX_HIST_BINS; ++bin)
+				{
+					int diff = pipelineHists[p][bin] - pipelineCpuHist[bin];
+
+					if (diff < 0)
+						diff = -diff;
+
+					if (diff > iTol)
+					{
+						std::cout << "Failed! (" << pipelineNames[p] << ")\n" << std::endl;
+						passed = false;
+						break;
+					}
+				}
 			}
 		}
 
-		std::cout << "Passed! \n" << std::endl;
+		if (passed)
+		{
+			std::cout << "Passed! \n" << std::endl;
+		}
 	}
 	return SDK_SUCCESS;
 }
@@ -598,23 +1206,60 @@ PIPE_PCK::verifyResults()
 void
 PIPE_PCK::printStats()
 {
-	std::string strArray[3] =
+	std::string strArray[5] =
 	{
 		"Total Pipe Packets",
 		"Setup Time(sec)",
-		"(Kernel + Transfer)Time(sec)"
+		"(Kernel + Transfer)Time(sec)",
+		"Samples/sec",
+		"Digest Centroids"
 	};
-	std::string stats[3];
+	std::string stats[5];
 
 	sampleTimer->totalTime = setupTime + kernelTime;
 
 	stats[0] = toString(szPipe, std::dec);
 	stats[1] = toString(setupTime, std::dec);
 	stats[2] = toString(kernelTime, std::dec);
+	stats[3] = toString(2.0*szPipe / kernelTime, std::dec);
+	stats[4] = toString(digest.size(), std::dec);
 
 	if (sampleArgs->timing)
 	{
-		printStatistics(strArray, stats, 3);
+		printStatistics(strArray, stats, 5);
+	}
+
+	if (centroidsWritten > maxCentroids)
+	{
+		std::cout << "Sketch dropped " << centroidsWritten - maxCentroids
+			<< " centroids, the quantiles are incomplete" << std::endl;
+	}
+
+	if (quantilesVerified)
+	{
+		std::cout << "Quantiles of the " << distName << " samples (t-digest, compression "
+			<< compression << ")" << std::endl;
+		std::cout << std::setw(10) << "q" << std::setw(14) << "sketch"
+			<< std::setw(14) << "exact" << std::setw(14) << "rank error" << std::endl;
+		for (int q = 0; q < SKETCH_QUANTILES; ++q)
+		{
+			std::cout << std::setw(10) << sketchQuantiles[q]
+				<< std::setw(14) << quantileEst[q]
+				<< std::setw(14) << quantileExact[q]
+				<< std::setw(14) << quantileRankErr[q] << std::endl;
+		}
+	}
+
+	if (runPipeline && !devStageStats.empty())
+	{
+		printPipelineStats(pipelineConcurrent ? "Device pipeline (concurrent stages)"
+			: "Device pipeline (one stage after the other)",
+			stageNames, &devStageStats[0], &devStageTimes[0], &devPipeSizes[0]);
+		std::cout << "Device pipeline time(sec): " << devPipelineTime << std::endl;
+
+		printPipelineStats("Host pipeline (thread per stage)",
+			stageNames, &hostStageStats[0], NULL, &hostRingSizes[0]);
+		std::cout << "Host pipeline time(sec): " << hostPipelineTime << std::endl;
 	}
 
 }
@@ -24,6 +24,9 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "CLUtil.hpp"
 
 #include "ParksMillerPRNG.hpp"
+#include "PipePipeline.hpp"
+#include "HostPipeline.hpp"
+#include "SamplerSketch.hpp"
 
 #define SAMPLE_VERSION				"AMD-APP-SDK-v3.0.130.2"
 #define OCL_COMIPLER_FLAGS			"PipeProducerConsumerKernels_OclFlags.txt"
@@ -32,10 +35,8 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #define PIPE_PKT_PER_THREAD         8
 
 #define PRODUCER_GLOBAL_SIZE        (PRNG_CHANNELS)
-#define PRODUCER_GROUP_SIZE         256
 
 #define CONSUMER_GLOBAL_SIZE        (PIPE_PKT_PER_THREAD*PRODUCER_GLOBAL_SIZE)
-#define CONSUMER_GROUP_SIZE         256
 
 #define PIPE_SIZE                   (CONSUMER_GLOBAL_SIZE)
  
@@ -46,6 +47,21 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 //maximum bins in histogram. this should be multiple of wave-front size.
 #define MAX_HIST_BINS               256
 
+//sampler and sketch defaults
+#define DEFAULT_HIST_BINS           256
+#define DEFAULT_COMPRESSION         100.0f
+#define DEFAULT_GAMMA_SHAPE         2.0f
+//quantile rank error accepted on top of the sampling noise
+#define SKETCH_RANK_TOL             0.01
+#define SKETCH_QUANTILES            9
+
+//stage pipeline: work-groups of the transform and histogram stages
+#define PIPELINE_STAGE_GROUPS       4
+#define PIPELINE_GROUP_SIZE         256
+#define PIPELINE_MIN_STAGES         3
+//packets of each SPSC ring of the host pipeline
+#define HOST_PIPELINE_RING_SIZE     1024
+
 using namespace appsdk;
 
 class PIPE_PCK
@@ -112,16 +128,71 @@ class PIPE_PCK
   /**< seed for rng */
   cl_int   seed;
 
-  /**< histogram size */
-  cl_float histMin;
-  cl_float histMax;
+  /**< distribution of the sampler: normal, exponential or gamma */
+  std::string distName;
+  cl_int   dist;
+  cl_float gammaShape;
+
+  /**< sketch histogram: bins, range and bins per unit */
+  cl_int   histBins;
+  cl_float sampleMin;
+  cl_float sampleMax;
+  cl_float histScale;
+
+  /**< t-digest compression */
+  cl_float compression;
+
+  /**< ziggurat tables and the centroids the sketch kernel appends */
+  ZigguratTables zigTables;
+  cl_mem   zigBuffer;
+  cl_mem   centroidBuffer;
+  cl_mem   centroidCount;
+  cl_uint  maxCentroids;
+  cl_uint  centroidsWritten;
+
+  /**< merged digest of the last run */
+  std::vector<cl_float2> digest;
+
+  /**< quantiles of the digest, the exact ones and the rank errors */
+  cl_float quantileEst[SKETCH_QUANTILES];
+  cl_float quantileExact[SKETCH_QUANTILES];
+  cl_double quantileRankErr[SKETCH_QUANTILES];
+  bool     quantilesVerified;
 
   /**< local histograms */
   cl_int   *localDevHist;
   cl_int   *cpuHist;
 
-  /**< rng type */
+  /**< rng type and histogram range of the Park-Miller pipeline stages */
   cl_int   rngType;
+  cl_float histMin;
+  cl_float histMax;
+  cl_int   *pipelineCpuHist;
+
+  /**< run the stage pipeline on the device and the host */
+  bool     runPipeline;
+
+  /**< stages of the pipeline: generate, transforms, histogram */
+  cl_int   pipelineStages;
+
+  /**< device pipeline and its histogram */
+  PipePipeline *pipeline;
+  cl_mem   pipelineHist;
+  cl_int   *pipelineDevHist;
+
+  /**< host pipeline histogram */
+  cl_int   *hostPipelineHist;
+
+  /**< pipeline results kept for printStats, which runs after cleanup */
+  bool     pipelineConcurrent;
+  cl_double devPipelineTime;
+  cl_double hostPipelineTime;
+  std::vector<std::string>    stageNames;
+  std::vector<PipeStageStats> devStageStats;
+  std::vector<PipeStageStats> hostStageStats;
+  std::vector<double>         devStageTimes;
+  std::vector<cl_uint>        devPipeSizes;
+  std::vector<cl_uint>        hostRingSizes;
 public:
 
   /**< CLCommand argument class */
@@ -139,11 +210,24 @@ public:
     sampleArgs->sampleVerStr = SAMPLE_VERSION;
     sampleArgs->flags        = OCL_COMIPLER_FLAGS;
 
-    producerGroupSize  = PRODUCER_GROUP_SIZE;
-    producerGlobalSize = PRODUCER_GLOBAL_SIZE;
-
-    consumerGroupSize  = CONSUMER_GROUP_SIZE;
-    consumerGlobalSize = CONSUMER_GLOBAL_SIZE;
+    producerGroupSize  = SAMPLER_GROUP_SIZE;
+    producerGlobalSize = SAMPLER_GROUP_SIZE;
+
+    consumerGroupSize  = SAMPLER_GROUP_SIZE;
+    consumerGlobalSize = SAMPLER_GROUP_SIZE;
+
+    distName           = "normal";
+    dist               = DIST_NORMAL;
+    gammaShape         = DEFAULT_GAMMA_SHAPE;
+    histBins           = DEFAULT_HIST_BINS;
+    compression        = DEFAULT_COMPRESSION;
+    zigBuffer          = NULL;
+    centroidBuffer     = NULL;
+    centroidCount      = NULL;
+    maxCentroids       = 0;
+    centroidsWritten   = 0;
+    quantilesVerified  = false;
+    pipelineCpuHist    = NULL;
 
     rngType            = RV_GAUSSIAN;
 
@@ -164,6 +248,16 @@ public:
     szPipe           = PIPE_SIZE;
     szPipePkt        = sizeof(cl_float2);
     pipePktPerThread = PIPE_PKT_PER_THREAD;
+
+    runPipeline        = false;
+    pipelineStages     = PIPELINE_MIN_STAGES;
+    pipeline           = NULL;
+    pipelineHist       = NULL;
+    pipelineDevHist    = NULL;
+    hostPipelineHist   = NULL;
+    pipelineConcurrent = false;
+    devPipelineTime    = 0;
+    hostPipelineTime   = 0;
   }
   
   ~PIPE_PCK()
@@ -193,9 +287,29 @@ public:
   int runCLKernels();
   
   /**
-   * Reference CPU implementation for performance comparison
+   * Runs the stage pipeline on the device, first one stage after the
+   * other to size its pipes, then concurrently; and the same stages on
+   * host threads connected by SPSC rings.
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+   */
+  int runPipelines();
+
+  /**
+   * Clears the device pipeline histogram before a run
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+   */
+  int clearPipelineHist();
+
+  /**
+   * Reference CPU implementation for performance comparison: replays the
+   * sampler streams into [samples] and their histogram into cpuHist
+   */
+  void sampleCPUReference(std::vector<cl_float>& samples);
+
+  /**
+   * Park-Miller / box muller histogram the pipeline stages are checked against
    */
-  void sampleCPUReference();
+  void pipelineCPUReference();
   
   /**
    * Override from SDKSample. Print sample stats.
@@ -133,184 +133,498 @@ float2 box_muller(float2 uniform)
 }  
 
 
+#define SAMPLER_SKETCH_OPENCL_DEVICE
+#include "SamplerSketch.h"
+
+/**
+ * pipe_sampler:
+ * work-groups take turns on the batches of [packets]. every work-item draws
+ * a pair of variates of distribution [dist] (gamma with shape [shape]) from
+ * its own xorshift64* stream, and the work-group writes the pairs to [out]
+ * with one reservation. the ziggurat tables [zt] come from the host.
+ **/
+__kernel void pipe_sampler(__write_only pipe float2           out,
+			   __constant       ZigguratTables  *zt,
+			                    uint             packets,
+			                    uint             seed,
+			                    int              dist,
+			                    float            shape)
+{
+  float2       rn;
+  uint         batch, batches;
+  reserve_id_t rid;
+  ulong        state;
+
+  int lid  = get_local_id(0);
+  int szgr = get_local_size(0);
+
+  state   = samplerSeed(seed, get_global_id(0));
+  batches = packets/szgr;
+
+  for(batch = get_group_id(0); batch < batches; batch += get_num_groups(0))
+    {
+      rn.x = samplerDraw(&state, zt, dist, shape);
+      rn.y = samplerDraw(&state, zt, dist, shape);
+
+      //reserve space in pipe for writing the pairs.
+      rid = work_group_reserve_write_pipe(out, szgr);
+      while(is_valid_reserve_id(rid) == false)
+	rid = work_group_reserve_write_pipe(out, szgr);
+
+      write_pipe(out, rid, lid, &rn);
+      work_group_commit_write_pipe(out, rid);
+    }
+}
+
+/***
+ * sketch_compress:
+ * walks the [n] sorted samples of [x] and groups neighbours into t-digest
+ * centroids (mean, weight). returns their number; when [out] is given they
+ * are written from [out][base] on, dropping those at [capacity] and beyond.
+ ***/
+uint sketch_compress(__local float   *x,
+		     uint             n,
+		     float            delta,
+		     __global float2 *out,
+		     uint             base,
+		     uint             capacity)
+{
+  uint  i;
+  uint  count  = 0;
+  float done   = 0;
+  float sum    = x[0];
+  float weight = 1;
+  float limit  = sketchQLimit(0, delta);
+
+  for(i = 1; i < n; ++i)
+    {
+      if((done + weight + 1)/n <= limit)
+	{
+	  sum    += x[i];
+	  weight += 1;
+	}
+      else
+	{
+	  if(out && base + count < capacity)
+	    out[base + count] = (float2)(sum/weight, weight);
+
+	  count += 1;
+	  done  += weight;
+	  limit  = sketchQLimit(done/n, delta);
+	  sum    = x[i];
+	  weight = 1;
+	}
+    }
+
+  if(out && base + count < capacity)
+    out[base + count] = (float2)(sum/weight, weight);
+
+  return count + 1;
+}
+
+/***
+ * sketch_flush:
+ * sorts the [n] samples of [buf] with a bitonic sort over the whole buffer,
+ * padded with +inf, and appends their centroids to [centroids].
+ ***/
+void sketch_flush(__local float   *buf,
+		  uint             n,
+		  float            delta,
+		  __global float2 *centroids,
+		  __global uint   *centroid_count,
+		  uint             max_centroids)
+{
+  uint i, j, k, ixj;
+  uint count, base;
+
+  int lid  = get_local_id(0);
+  int szgr = get_local_size(0);
+
+  for(i = n + lid; i < SKETCH_BUFFER; i += szgr)
+    buf[i] = INFINITY;
+  work_group_barrier(CLK_LOCAL_MEM_FENCE);
+
+  for(k = 2; k <= SKETCH_BUFFER; k <<= 1)
+    {
+      for(j = k >> 1; j > 0; j >>= 1)
+	{
+	  for(i = lid; i < SKETCH_BUFFER; i += szgr)
+	    {
+	      ixj = i ^ j;
+	      if(ixj > i)
+		{
+		  float a = buf[i];
+		  float b = buf[ixj];
+		  if((a > b) == ((i & k) == 0))
+		    {
+		      buf[i]   = b;
+		      buf[ixj] = a;
+		    }
+		}
+	    }
+	  work_group_barrier(CLK_LOCAL_MEM_FENCE);
+	}
+    }
+
+  //counting first lets one atomic reserve the space for all centroids.
+  if(lid == 0)
+    {
+      count = sketch_compress(buf, n, delta, NULL, 0, 0);
+      base  = atomic_add(centroid_count, count);
+      sketch_compress(buf, n, delta, centroids, base, max_centroids);
+    }
+  work_group_barrier(CLK_LOCAL_MEM_FENCE);
+}
+
 /**
- * pipe_producer:
- * produces [pkt_per_thread] random numbers per thread. takes [seed] as seed to 
- * random number generator. [rng_type] defines the type
- * of random number. pushes random numbers to pipe [rng_pipe] to be used by consumer 
- * kernel.
+ * pipe_sketch:
+ * streaming histogram and quantile sketch service. work-groups take turns
+ * on the batches of the [packets] in [in]; both components of every packet go into a local
+ * histogram of [bins] bins starting at [hist_min], [hist_scale] bins per
+ * unit, and into a buffer which is turned into t-digest centroids of
+ * compression [delta] every SKETCH_BUFFER samples. [hist] and
+ * [centroid_count] have to be cleared before the launch.
  **/
-__kernel void pipe_producer(__write_only pipe float2 rng_pipe, 
-			    int   pkt_per_thread,
-			    int   seed,
-			    int   rng_type)
+__kernel void pipe_sketch(__read_only pipe float2           in,
+			                   uint             packets,
+			  __global         int             *hist,
+			                   uint             bins,
+			                   float            hist_min,
+			                   float            hist_scale,
+			  __local          int             *lhist,
+			  __global         float2          *centroids,
+			  __global         uint            *centroid_count,
+			                   uint             max_centroids,
+			                   float            delta)
 {
-  float2 ufrn;
-  float2 gfrn;
-  int2   irn;
-  int    iter;
-  int    lflag;
+  float2       rn;
+  float        pos;
+  uint         bindex;
+  uint         batch, batches;
+  uint         fill;
+  reserve_id_t rid;
+
+  __local   float  buf[SKETCH_BUFFER];
 
-  __local  int    iv[MAX_NTAB];
+  int lid  = get_local_id(0);
+  int szgr = get_local_size(0);
 
+  for(bindex = lid; bindex < bins; bindex += szgr)
+    {
+      lhist[bindex] = 0;
+    }
+  work_group_barrier(CLK_LOCAL_MEM_FENCE);
+
+  batches = packets/szgr;
+  fill    = 0;
+
+  for(batch = get_group_id(0); batch < batches; batch += get_num_groups(0))
+    {
+      //reserve pipe for reading
+      rid = work_group_reserve_read_pipe(in, szgr);
+      while(is_valid_reserve_id(rid) == false)
+	rid = work_group_reserve_read_pipe(in, szgr);
+
+      read_pipe(in, rid, lid, &rn);
+      work_group_commit_read_pipe(in, rid);
+
+      pos = (rn.x - hist_min)*hist_scale;
+      if((pos >= 0) && (pos < bins))
+	atomic_inc(lhist + (uint)pos);
+
+      pos = (rn.y - hist_min)*hist_scale;
+      if((pos >= 0) && (pos < bins))
+	atomic_inc(lhist + (uint)pos);
+
+      buf[fill + 2*lid]     = rn.x;
+      buf[fill + 2*lid + 1] = rn.y;
+      fill += 2*szgr;
+
+      if(fill == SKETCH_BUFFER)
+	{
+	  sketch_flush(buf, fill, delta, centroids, centroid_count, max_centroids);
+	  fill = 0;
+	}
+    }
+
+  if(fill)
+    sketch_flush(buf, fill, delta, centroids, centroid_count, max_centroids);
+
+  work_group_barrier(CLK_LOCAL_MEM_FENCE);
+
+  //add the local histogram to the global one
+  for(bindex = lid; bindex < bins; bindex += szgr)
+    {
+      if(lhist[bindex])
+	atomic_add((volatile __global int *)(hist + bindex), lhist[bindex]);
+    }
+}
+
+/***
+ * Pipeline stages.
+ * stage_generate -> stage_transform ... -> stage_histogram, connected by
+ * pipes and launched by PipePipeline, which sets the pipes, the stats
+ * block, the stage index and the packet count before each stage's own
+ * arguments. Stages move whole work-groups of packets and give up after
+ * PIPELINE_MAX_SPINS failed reservations in a row, so a device that does
+ * not run them concurrently ends the run instead of hanging it.
+ ***/
+#define PIPE_PIPELINE_OPENCL_DEVICE
+#include "PipePipeline.h"
+
+/***
+ * STAGE_RESERVE:
+ * reserves [n] packets of pipe [p] for the work-group with [reserve],
+ * retrying while the pipe is full or empty. failed attempts are added to
+ * [stalls]; [rid] is left invalid after PIPELINE_MAX_SPINS of them.
+ ***/
+#define STAGE_RESERVE(reserve, p, n, rid, stalls)			\
+  do									\
+    {									\
+      uint spins_ = 0;							\
+      rid = reserve(p, n);						\
+      while(!is_valid_reserve_id(rid) && spins_ < PIPELINE_MAX_SPINS)	\
+	{								\
+	  spins_++;							\
+	  rid = reserve(p, n);						\
+	}								\
+      stalls += spins_;							\
+    } while(0)
+
+/***
+ * STAGE_SAMPLE_FILL:
+ * adds the fill of output pipe [p] in percent to the counters in [st].
+ ***/
+#define STAGE_SAMPLE_FILL(p, st)					\
+  do									\
+    {									\
+      uint fill_ = get_pipe_num_packets(p)*100 / get_pipe_max_packets(p); \
+      st.occupancySum += fill_;						\
+      st.occupancySamples += 1;						\
+      st.occupancyMax = max(st.occupancyMax, fill_);			\
+    } while(0)
+
+/***
+ * stage_report:
+ * adds the counters of a work-group to the stage's entry in the stats
+ * block. all work-items hold the same counters, work-item 0 adds them.
+ ***/
+void stage_report(__global PipeStageStats *stats, PipeStageStats st)
+{
+  if(get_local_id(0) != 0)
+    return;
+
+  atomic_fetch_add_explicit((volatile __global atomic_uint *)&stats->packetsIn, st.packetsIn,
+			    memory_order_relaxed, memory_scope_device);
+  atomic_fetch_add_explicit((volatile __global atomic_uint *)&stats->packetsOut, st.packetsOut,
+			    memory_order_relaxed, memory_scope_device);
+  atomic_fetch_add_explicit((volatile __global atomic_uint *)&stats->readStalls, st.readStalls,
+			    memory_order_relaxed, memory_scope_device);
+  atomic_fetch_add_explicit((volatile __global atomic_uint *)&stats->writeStalls, st.writeStalls,
+			    memory_order_relaxed, memory_scope_device);
+  atomic_fetch_add_explicit((volatile __global atomic_uint *)&stats->occupancySum, st.occupancySum,
+			    memory_order_relaxed, memory_scope_device);
+  atomic_fetch_add_explicit((volatile __global atomic_uint *)&stats->occupancySamples, st.occupancySamples,
+			    memory_order_relaxed, memory_scope_device);
+  atomic_fetch_max_explicit((volatile __global atomic_uint *)&stats->occupancyMax, st.occupancyMax,
+			    memory_order_relaxed, memory_scope_device);
+  atomic_fetch_add_explicit((volatile __global atomic_uint *)&stats->aborted, st.aborted,
+			    memory_order_relaxed, memory_scope_device);
+}
+
+/**
+ * stage_generate:
+ * first stage. one work-group of PRNG_CHANNELS work-items draws uniform
+ * Park-Miller pairs, one channel of the shuffle table each, and writes
+ * them to [out] one work-group batch at a time.
+ **/
+__kernel void stage_generate(__write_only pipe float2          out,
+			     __global         PipeStageStats *stats,
+			                      uint            stage,
+			                      uint            packets,
+			                      int             seed)
+{
+  float2         ufrn;
+  int2           irn;
+  uint           batch, batches;
+  reserve_id_t   rid;
+  PipeStageStats st = { 0 };
+
+  __local  int   iv[MAX_NTAB];
 
   int    lid  = get_local_id(0);
   int    szgr = get_local_size(0);
-  
+
   //initialize random number generator.
   if (lid == 0)
     {
       rng_init(seed, iv);
     }
-  work_group_barrier(CLK_LOCAL_MEM_FENCE|CLK_GLOBAL_MEM_FENCE);
+  work_group_barrier(CLK_LOCAL_MEM_FENCE);
 
-  iter   = 0;
   irn.x  = (lid +1)*(lid +1);
   irn.y  = (lid +1)*(lid +1);
 
-  while(iter < pkt_per_thread)
-    {
-      reserve_id_t rid = work_group_reserve_write_pipe(rng_pipe, szgr);
-      
-      //reserve space in pipe for writing random numbers.
-      while(is_valid_reserve_id(rid) == false)
-	rid = work_group_reserve_write_pipe(rng_pipe, szgr);
-      
-      if(is_valid_reserve_id(rid))
-	{
-	  //draw two unifromly distributed rv.
-          irn.x = rng_pm(irn.y, (iv + lid*NTAB));
-	  work_group_barrier(CLK_LOCAL_MEM_FENCE);
-
-	  irn.y = rng_pm(irn.x, (iv + lid*NTAB));
-	  work_group_barrier(CLK_LOCAL_MEM_FENCE);
+  batches = packets/szgr;
 
-	  ufrn.x = (float)(irn.x)*AM;
-	  if (ufrn.x > RMAX)
-	    ufrn.x = RMAX;
+  for(batch = 0; batch < batches; ++batch)
+    {
+      //every work-item works on its own channel of the shuffle table.
+      irn.x = rng_pm(irn.y, (iv + lid*NTAB));
+      irn.y = rng_pm(irn.x, (iv + lid*NTAB));
 
-	  ufrn.y = (float)(irn.y)*AM;
-	  if (ufrn.y > RMAX)
-	    ufrn.y = RMAX;
+      ufrn.x = (float)(irn.x)*AM;
+      if (ufrn.x > RMAX)
+	ufrn.x = RMAX;
 
-	  //If gaussian distribution is requested, apply box muller transform.
-	  if(rng_type == RV_GAUSSIAN)
-	    {
-	      gfrn = box_muller(ufrn);
-	    }
-	  else
-	    {
-	      gfrn = ufrn;
-	    }
+      ufrn.y = (float)(irn.y)*AM;
+      if (ufrn.y > RMAX)
+	ufrn.y = RMAX;
 
-	  //write into pipe.
-	  write_pipe(rng_pipe,rid,lid, &gfrn);
-	  work_group_commit_write_pipe(rng_pipe, rid);
+      STAGE_RESERVE(work_group_reserve_write_pipe, out, szgr, rid, st.writeStalls);
+      if(!is_valid_reserve_id(rid))
+	{
+	  st.aborted = 1;
+	  break;
 	}
-      
-      work_group_barrier(CLK_GLOBAL_MEM_FENCE);
 
-      iter += 1;
+      write_pipe(out, rid, lid, &ufrn);
+      work_group_commit_write_pipe(out, rid);
+
+      st.packetsOut += szgr;
+      STAGE_SAMPLE_FILL(out, st);
     }
+
+  stage_report(stats + stage, st);
 }
 
 /**
- * pipe_consumer:
- * reads random variables from [rng_pipe] and produces their histogram in [hist]. the
- * histogram is generated for rv between hist_min and hist_max and any other rv out of
- * this range is ignored. the number of bins in histogram are given by MAX_HIST_BINS.
+ * stage_transform:
+ * middle stage. work-groups take turns on the batches, read one from [in],
+ * apply box muller if [rng_type] is RV_GAUSSIAN and write it to [out].
+ * with RV_UNIFORM the stage only relays its packets.
  **/
-
-__kernel void pipe_consumer(__read_only pipe float2          rng_pipe,
-			    __global         int             *hist,
-			                     float           hist_min,
-			                     float           hist_max)
+__kernel void stage_transform(__read_only  pipe float2          in,
+			      __write_only pipe float2          out,
+			      __global          PipeStageStats *stats,
+			                        uint            stage,
+			                        uint            packets,
+			                        int             rng_type)
 {
-  int          bindex;
-  int          found, freq;
-  int          lap, laps;
-  
-  float2       rn;
-  float        bin_width;
-  float        rmin,rmax;
-  
-  __local   int  lhist[MAX_HIST_BINS];
-  
+  float2         rn;
+  uint           batch, batches;
+  reserve_id_t   rid;
+  PipeStageStats st = { 0 };
+
   int lid  = get_local_id(0);
-  int gid  = get_global_id(0);
-  int grid = get_group_id(0);
   int szgr = get_local_size(0);
-  int szgl = get_global_size(0);
 
-  //reset hist
-  laps          = (MAX_HIST_BINS) /szgr;
+  batches = packets/szgr;
 
-  if(grid == 0)
+  for(batch = get_group_id(0); batch < batches; batch += get_num_groups(0))
     {
-      for(lap = 0; lap < laps; ++lap)
+      STAGE_RESERVE(work_group_reserve_read_pipe, in, szgr, rid, st.readStalls);
+      if(!is_valid_reserve_id(rid))
 	{
-	  bindex = lid + lap*szgr;
-	  hist[bindex] = 0;
+	  st.aborted = 1;
+	  break;
 	}
+
+      read_pipe(in, rid, lid, &rn);
+      work_group_commit_read_pipe(in, rid);
+      st.packetsIn += szgr;
+
+      if(rng_type == RV_GAUSSIAN)
+	{
+	  rn = box_muller(rn);
+	}
+
+      STAGE_RESERVE(work_group_reserve_write_pipe, out, szgr, rid, st.writeStalls);
+      if(!is_valid_reserve_id(rid))
+	{
+	  st.aborted = 1;
+	  break;
+	}
+
+      write_pipe(out, rid, lid, &rn);
+      work_group_commit_write_pipe(out, rid);
+
+      st.packetsOut += szgr;
+      STAGE_SAMPLE_FILL(out, st);
     }
 
-  work_group_barrier(CLK_GLOBAL_MEM_FENCE);
+  stage_report(stats + stage, st);
+}
 
-  reserve_id_t rid = work_group_reserve_read_pipe(rng_pipe, szgr);
-      
-  //reserve pipe for reading
-  while(is_valid_reserve_id(rid) == false)
-    rid = work_group_reserve_read_pipe(rng_pipe, szgr);
-      
-  if(is_valid_reserve_id(rid))
+/**
+ * stage_histogram:
+ * last stage. work-groups take turns on the batches of [in] and bin both
+ * components of every packet in a local histogram, which is added to [hist]
+ * at the end. [hist] has to be cleared before the run.
+ **/
+__kernel void stage_histogram(__read_only pipe float2          in,
+			      __global         PipeStageStats *stats,
+			                       uint            stage,
+			                       uint            packets,
+			      __global         int            *hist,
+			                       float           hist_min,
+			                       float           hist_max)
+{
+  float2         rn;
+  float          bin_width;
+  int            bindex;
+  uint           batch, batches;
+  reserve_id_t   rid;
+  PipeStageStats st = { 0 };
+
+  __local   int  lhist[MAX_HIST_BINS];
+
+  int lid  = get_local_id(0);
+  int szgr = get_local_size(0);
+
+  for(bindex = lid; bindex < MAX_HIST_BINS; bindex += szgr)
     {
-      //read random number from the pipe.
-      read_pipe(rng_pipe,rid,lid, &rn);
-      work_group_commit_read_pipe(rng_pipe, rid);
+      lhist[bindex] = 0;
     }
-  
-  //each work-group generates local histogram
-  bin_width = (hist_max - hist_min)/(float)(MAX_HIST_BINS);
+  work_group_barrier(CLK_LOCAL_MEM_FENCE);
 
-  rmin      = hist_min;
-  rmax      = rmin + bin_width;
-  found     = 0;
+  bin_width = (hist_max - hist_min)/(float)(MAX_HIST_BINS);
+  batches   = packets/szgr;
 
-  for(bindex = 0; bindex < MAX_HIST_BINS; bindex++)
+  for(batch = get_group_id(0); batch < batches; batch += get_num_groups(0))
     {
-      if ((rn.x >= rmin) && (rn.x < rmax))
+      STAGE_RESERVE(work_group_reserve_read_pipe, in, szgr, rid, st.readStalls);
+      if(!is_valid_reserve_id(rid))
 	{
-	  found += 1;
+	  st.aborted = 1;
+	  break;
 	}
 
-      if ((rn.y >= rmin) && (rn.y < rmax))
+      read_pipe(in, rid, lid, &rn);
+      work_group_commit_read_pipe(in, rid);
+      st.packetsIn += szgr;
+
+      if((rn.x >= hist_min) && (rn.x < hist_max))
 	{
-	  found += 1;
+	  bindex = min((int)((rn.x - hist_min)/bin_width), MAX_HIST_BINS - 1);
+	  atomic_inc(lhist + bindex);
 	}
 
-      work_group_barrier(CLK_LOCAL_MEM_FENCE);
-      
-      freq  = work_group_reduce_add(found);
-      if (lid == 0)
+      if((rn.y >= hist_min) && (rn.y < hist_max))
 	{
-	  lhist[bindex] = freq;
+	  bindex = min((int)((rn.y - hist_min)/bin_width), MAX_HIST_BINS - 1);
+	  atomic_inc(lhist + bindex);
 	}
-
-      work_group_barrier(CLK_LOCAL_MEM_FENCE);
-
-      rmin  = rmax;
-      rmax  = rmin + bin_width;
-      found = 0;
     }
-  
+
   work_group_barrier(CLK_LOCAL_MEM_FENCE);
 
-  //add all local histograms to global histogram
-  for(lap = 0; lap < laps; ++lap)
+  //add the local histogram to the global one
+  for(bindex = lid; bindex < MAX_HIST_BINS; bindex += szgr)
     {
-      bindex = lid + lap*szgr;
-      atomic_add((volatile __global int *)(hist + bindex), lhist[bindex]);
+      if(lhist[bindex])
+	atomic_add((volatile __global int *)(hist + bindex), lhist[bindex]);
     }
 
-  work_group_barrier(CLK_GLOBAL_MEM_FENCE);
+  stage_report(stats + stage, st);
 }
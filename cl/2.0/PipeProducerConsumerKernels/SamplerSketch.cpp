@@ -0,0 +1,172 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "SamplerSketch.hpp"
+#include <algorithm>
+
+void zigguratSetup(ZigguratTables* zt)
+{
+	const double m1 = 2147483648.0;
+	const double m2 = 4294967296.0;
+	double dn = 3.442619855899, tn = dn, vn = 9.91256303526217e-3;
+	double de = 7.697117470131487, te = de, ve = 3.949659822581572e-3;
+	double q;
+
+	q = vn / exp(-.5 * dn * dn);
+	zt->kn[0] = (cl_uint)((dn / q) * m1);
+	zt->kn[1] = 0;
+	zt->wn[0] = (cl_float)(q / m1);
+	zt->wn[ZIGGURAT_NORMAL_LAYERS - 1] = (cl_float)(dn / m1);
+	zt->fn[0] = 1.0f;
+	zt->fn[ZIGGURAT_NORMAL_LAYERS - 1] = (cl_float)exp(-.5 * dn * dn);
+
+	for (int i = ZIGGURAT_NORMAL_LAYERS - 2; i >= 1; i--)
+	{
+		dn = sqrt(-2. * log(vn / dn + exp(-.5 * dn * dn)));
+		zt->kn[i + 1] = (cl_uint)((dn / tn) * m1);
+		tn = dn;
+		zt->fn[i] = (cl_float)exp(-.5 * dn * dn);
+		zt->wn[i] = (cl_float)(dn / m1);
+	}
+
+	q = ve / exp(-de);
+	zt->ke[0] = (cl_uint)((de / q) * m2);
+	zt->ke[1] = 0;
+	zt->we[0] = (cl_float)(q / m2);
+	zt->we[ZIGGURAT_EXP_LAYERS - 1] = (cl_float)(de / m2);
+	zt->fe[0] = 1.0f;
+	zt->fe[ZIGGURAT_EXP_LAYERS - 1] = (cl_float)exp(-de);
+
+	for (int i = ZIGGURAT_EXP_LAYERS - 2; i >= 1; i--)
+	{
+		de = -log(ve / de + exp(-de));
+		zt->ke[i + 1] = (cl_uint)((de / te) * m2);
+		te = de;
+		zt->fe[i] = (cl_float)exp(-de);
+		zt->we[i] = (cl_float)(de / m2);
+	}
+}
+
+void samplerReference(cl_float* samples, cl_uint packets, cl_uint groups, cl_uint groupSize,
+		      cl_uint seed, cl_int dist, cl_float shape, const ZigguratTables* zt)
+{
+	std::vector<cl_ulong> state(groups * groupSize);
+	for (cl_uint gid = 0; gid < groups * groupSize; gid++)
+		state[gid] = samplerSeed(seed, gid);
+
+	cl_uint batches = packets / groupSize;
+	for (cl_uint batch = 0; batch < batches; batch++)
+	{
+		cl_uint first = (batch % groups) * groupSize;
+		for (cl_uint lid = 0; lid < groupSize; lid++)
+		{
+			cl_float* pair = samples + 2 * ((size_t)batch * groupSize + lid);
+			pair[0] = samplerDraw(&state[first + lid], zt, dist, shape);
+			pair[1] = samplerDraw(&state[first + lid], zt, dist, shape);
+		}
+	}
+}
+
+cl_uint sketchCentroidBound(cl_float compression)
+{
+	// k1 spans delta / 2 in k and a centroid grows k by one, plus the
+	// singletons of the tails where one sample already takes a full step
+	cl_uint bound = (cl_uint)compression + 16;
+	return bound < SKETCH_BUFFER ? bound : SKETCH_BUFFER;
+}
+
+static bool centroidLess(const cl_float2& a, const cl_float2& b)
+{
+	return a.s[0] < b.s[0];
+}
+
+void tdigestMerge(std::vector<cl_float2>& centroids, cl_float compression)
+{
+	if (centroids.empty())
+		return;
+
+	std::sort(centroids.begin(), centroids.end(), centroidLess);
+
+	double total = 0;
+	for (size_t i = 0; i < centroids.size(); i++)
+		total += centroids[i].s[1];
+
+	// Same walk as sketch_compress, over weighted centroids
+	std::vector<cl_float2> digest;
+	double done = 0;
+	double sum = (double)centroids[0].s[0] * centroids[0].s[1];
+	double weight = centroids[0].s[1];
+	double limit = sketchQLimit(0, compression);
+
+	for (size_t i = 1; i < centroids.size(); i++)
+	{
+		double w = centroids[i].s[1];
+		if ((done + weight + w) / total <= limit)
+		{
+			sum += (double)centroids[i].s[0] * w;
+			weight += w;
+		}
+		else
+		{
+			cl_float2 c;
+			c.s[0] = (cl_float)(sum / weight);
+			c.s[1] = (cl_float)weight;
+			digest.push_back(c);
+
+			done += weight;
+			limit = sketchQLimit((cl_float)(done / total), compression);
+			sum = (double)centroids[i].s[0] * w;
+			weight = w;
+		}
+	}
+
+	cl_float2 last;
+	last.s[0] = (cl_float)(sum / weight);
+	last.s[1] = (cl_float)weight;
+	digest.push_back(last);
+
+	centroids.swap(digest);
+}
+
+cl_float tdigestQuantile(const std::vector<cl_float2>& digest, cl_float p)
+{
+	if (digest.empty())
+		return 0;
+
+	double total = 0;
+	for (size_t i = 0; i < digest.size(); i++)
+		total += digest[i].s[1];
+
+	// Interpolate between the centres of the two centroids around the rank
+	double target = p * total;
+	double center = digest[0].s[1] / 2;
+	if (target <= center)
+		return digest[0].s[0];
+
+	double cum = digest[0].s[1];
+	for (size_t i = 1; i < digest.size(); i++)
+	{
+		double next = cum + digest[i].s[1] / 2;
+		if (target <= next)
+		{
+			double t = (target - center) / (next - center);
+			return (cl_float)(digest[i - 1].s[0] + t * (digest[i].s[0] - digest[i - 1].s[0]));
+		}
+		center = next;
+		cum += digest[i].s[1];
+	}
+	return digest.back().s[0];
+}
@@ -0,0 +1,233 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef _SAMPLER_SKETCH_H_
+#define _SAMPLER_SKETCH_H_
+
+/*
+ * Layout shared by the host and the sampler / sketch kernels.
+ *
+ * The sampler draws from a xorshift64* stream per work-item, so any
+ * global size works and every work-item's sequence can be replayed on
+ * the host. Normal and exponential variates come from the Marsaglia-Tsang
+ * ziggurat with the tables below, gamma variates from the Marsaglia-Tsang
+ * squeeze over the normal sampler. The functions are shared by both
+ * sides; results only differ where the device's exp/log round differently.
+ *
+ * The sketch kernel sorts every SKETCH_BUFFER samples a work-group reads
+ * and compresses them into t-digest centroids (k1 scale function); the
+ * host merges the centroids of all buffers into the final digest.
+ */
+
+#ifndef SAMPLER_SKETCH_OPENCL_DEVICE
+#include <CL/cl.h>
+#include <math.h>
+typedef cl_int   sketch_int;
+typedef cl_uint  sketch_uint;
+typedef cl_ulong sketch_ulong;
+typedef cl_float sketch_float;
+#define SKETCH_U64(x)   x##ULL
+#define SKETCH_CONSTANT
+#define SKETCH_ASIN     asinf
+#define SKETCH_SIN      sinf
+#define SKETCH_EXP      expf
+#define SKETCH_LOG      logf
+#define SKETCH_POW      powf
+#define SKETCH_SQRT     sqrtf
+#else
+typedef int      sketch_int;
+typedef uint     sketch_uint;
+typedef ulong    sketch_ulong;
+typedef float    sketch_float;
+#define SKETCH_U64(x)   x##UL
+#define SKETCH_CONSTANT __constant
+#define SKETCH_ASIN     asin
+#define SKETCH_SIN      sin
+#define SKETCH_EXP      exp
+#define SKETCH_LOG      log
+#define SKETCH_POW      pow
+#define SKETCH_SQRT     sqrt
+#endif
+
+enum SAMPLER_DIST
+{
+	DIST_NORMAL,
+	DIST_EXPONENTIAL,
+	DIST_GAMMA
+};
+
+#define ZIGGURAT_NORMAL_LAYERS  128
+#define ZIGGURAT_EXP_LAYERS     256
+#define ZIGGURAT_NORMAL_R       3.442620f       // Start of the normal tail
+#define ZIGGURAT_EXP_R          7.697117f       // Start of the exponential tail
+
+typedef struct
+{
+	sketch_uint  kn[ZIGGURAT_NORMAL_LAYERS];    // Acceptance bound of |hz| per layer
+	sketch_float wn[ZIGGURAT_NORMAL_LAYERS];    // Layer width / 2^31
+	sketch_float fn[ZIGGURAT_NORMAL_LAYERS];    // Density at the layer edge
+	sketch_uint  ke[ZIGGURAT_EXP_LAYERS];
+	sketch_float we[ZIGGURAT_EXP_LAYERS];       // Layer width / 2^32
+	sketch_float fe[ZIGGURAT_EXP_LAYERS];
+} ZigguratTables;
+
+#define SAMPLER_GROUP_SIZE      256
+#define SAMPLER_GROUPS_PER_CU   4               // Work-groups per compute unit, sampler and sketch
+
+// Samples a sketch work-group sorts and compresses at once, a multiple of
+// the samples one batch of float2 packets brings (2 * SAMPLER_GROUP_SIZE)
+#define SKETCH_BUFFER           2048
+
+#define PI_F                    3.14159265f
+
+/*
+ * Start of the stream of work-item 'gid', splitmix64 of the seed
+ */
+static inline sketch_ulong samplerSeed(sketch_ulong seed, sketch_uint gid)
+{
+	sketch_ulong z = seed + (sketch_ulong)(gid + 1) * SKETCH_U64(0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * SKETCH_U64(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * SKETCH_U64(0x94D049BB133111EB);
+	z ^= z >> 31;
+	return z ? z : 1;
+}
+
+/*
+ * Next 32 random bits of a xorshift64* stream
+ */
+static inline sketch_uint samplerNext(sketch_ulong *state)
+{
+	sketch_ulong s = *state;
+	s ^= s >> 12;
+	s ^= s << 25;
+	s ^= s >> 27;
+	*state = s;
+	return (sketch_uint)((s * SKETCH_U64(2685821657736338717)) >> 32);
+}
+
+/*
+ * Uniform in (0, 1): 23 bits and a half, exact in a float and never 0
+ */
+static inline sketch_float samplerUniform(sketch_ulong *state)
+{
+	return ((sketch_float)(samplerNext(state) >> 9) + 0.5f) * (1.0f / 8388608.0f);
+}
+
+static inline sketch_float samplerNormal(sketch_ulong *state, SKETCH_CONSTANT const ZigguratTables *zt)
+{
+	for (;;)
+	{
+		sketch_int hz = (sketch_int)samplerNext(state);
+		sketch_uint iz = (sketch_uint)hz & (ZIGGURAT_NORMAL_LAYERS - 1);
+		sketch_uint magnitude = hz < 0 ? 0u - (sketch_uint)hz : (sketch_uint)hz;
+		sketch_float x = (sketch_float)hz * zt->wn[iz];
+
+		if (magnitude < zt->kn[iz])
+			return x;
+
+		if (iz == 0)
+		{
+			// Tail beyond R
+			sketch_float y;
+			do
+			{
+				x = -SKETCH_LOG(samplerUniform(state)) / ZIGGURAT_NORMAL_R;
+				y = -SKETCH_LOG(samplerUniform(state));
+			} while (y + y < x * x);
+			return hz > 0 ? ZIGGURAT_NORMAL_R + x : -ZIGGURAT_NORMAL_R - x;
+		}
+
+		// Wedge between the layer's rectangle and the density
+		if (zt->fn[iz] + samplerUniform(state) * (zt->fn[iz - 1] - zt->fn[iz]) <
+		    SKETCH_EXP(-0.5f * x * x))
+			return x;
+	}
+}
+
+static inline sketch_float samplerExponential(sketch_ulong *state, SKETCH_CONSTANT const ZigguratTables *zt)
+{
+	for (;;)
+	{
+		sketch_uint jz = samplerNext(state);
+		sketch_uint iz = jz & (ZIGGURAT_EXP_LAYERS - 1);
+		sketch_float x = (sketch_float)jz * zt->we[iz];
+
+		if (jz < zt->ke[iz])
+			return x;
+
+		if (iz == 0)
+			return ZIGGURAT_EXP_R - SKETCH_LOG(samplerUniform(state));
+
+		if (zt->fe[iz] + samplerUniform(state) * (zt->fe[iz - 1] - zt->fe[iz]) <
+		    SKETCH_EXP(-x))
+			return x;
+	}
+}
+
+/*
+ * Marsaglia-Tsang; shapes below 1 draw Gamma(shape + 1) * U^(1 / shape)
+ */
+static inline sketch_float samplerGamma(sketch_ulong *state, SKETCH_CONSTANT const ZigguratTables *zt,
+					sketch_float shape)
+{
+	sketch_float boost = 1;
+	if (shape < 1)
+	{
+		boost = SKETCH_POW(samplerUniform(state), 1 / shape);
+		shape += 1;
+	}
+
+	sketch_float d = shape - 1.0f / 3;
+	sketch_float c = 1 / SKETCH_SQRT(9 * d);
+	for (;;)
+	{
+		sketch_float x = samplerNormal(state, zt);
+		sketch_float v = 1 + c * x;
+		if (v <= 0)
+			continue;
+
+		v = v * v * v;
+		sketch_float u = samplerUniform(state);
+		if (u < 1 - 0.0331f * x * x * x * x ||
+		    SKETCH_LOG(u) < 0.5f * x * x + d * (1 - v + SKETCH_LOG(v)))
+			return d * v * boost;
+	}
+}
+
+static inline sketch_float samplerDraw(sketch_ulong *state, SKETCH_CONSTANT const ZigguratTables *zt,
+				       sketch_int dist, sketch_float shape)
+{
+	if (dist == DIST_EXPONENTIAL)
+		return samplerExponential(state, zt);
+	if (dist == DIST_GAMMA)
+		return samplerGamma(state, zt, shape);
+	return samplerNormal(state, zt);
+}
+
+/*
+ * Fraction of the weight the next t-digest centroid may reach when 'q'
+ * of it is already in earlier centroids: one step of the k1 scale
+ * function k(q) = delta / (2 pi) * asin(2q - 1).
+ */
+static inline sketch_float sketchQLimit(sketch_float q, sketch_float delta)
+{
+	sketch_float k = delta / (2 * PI_F) * SKETCH_ASIN(2 * q - 1) + 1;
+	if (k >= delta / 4)
+		return 1;
+	return (SKETCH_SIN(2 * PI_F / delta * k) + 1) / 2;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef _SAMPLER_SKETCH_HPP_
+#define _SAMPLER_SKETCH_HPP_
+
+#include <vector>
+#include "SamplerSketch.h"
+
+/*
+ * Host side of the sampler and the sketch service: ziggurat tables, a
+ * replay of the sampler kernel's streams and the final t-digest merge.
+ */
+
+// Marsaglia-Tsang zigset, computed in double and stored as the kernels read it
+void zigguratSetup(ZigguratTables* zt);
+
+/*
+ * Draws the 2 * 'packets' samples pipe_sampler writes when launched with
+ * 'groups' work-groups of 'groupSize': work-group g takes batches g,
+ * g + groups, ... and every work-item draws a pair per batch.
+ */
+void samplerReference(cl_float* samples, cl_uint packets, cl_uint groups, cl_uint groupSize,
+		      cl_uint seed, cl_int dist, cl_float shape, const ZigguratTables* zt);
+
+// Centroids per sketch buffer are at most this many for 'compression'
+cl_uint sketchCentroidBound(cl_float compression);
+
+// Sorts centroids (mean, weight) and merges them into a digest of 'compression'
+void tdigestMerge(std::vector<cl_float2>& centroids, cl_float compression);
+
+// Value below which a fraction 'p' of the digest's weight lies
+cl_float tdigestQuantile(const std::vector<cl_float2>& digest, cl_float p);
+
+#endif
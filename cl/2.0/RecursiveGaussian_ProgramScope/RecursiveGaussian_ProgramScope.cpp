@@ -37,7 +37,7 @@ RecursiveGaussian::readInputImage(std::string inputImageName)
     width = inputBitmap.getWidth();
 
     // Check width against blockSizeX
-    if(width % GROUP_SIZE || height % GROUP_SIZE)
+    if(width % GROUP_SIZE)
     {
         char err[2048];
         sprintf(err, "Width should be a multiple of %d \n", GROUP_SIZE);
@@ -48,9 +48,6 @@ RecursiveGaussian::readInputImage(std::string inputImageName)
     // allocate memory for input & output image data
     inputImageData  = (cl_uchar4*)malloc(width * height * sizeof(cl_uchar4));
     CHECK_ALLOCATION(inputImageData, "Failed to allocate memory! (inputImageData)");
-    verificationInput = (cl_uchar4*)malloc(width * height * sizeof(cl_uchar4));
-    CHECK_ALLOCATION(verificationInput,
-                     "Failed to allocate memory! (verificationInput)");
 
     // allocate memory for output image data
     outputImageData = (cl_uchar4*)malloc(width * height * sizeof(cl_uchar4));
@@ -70,24 +67,255 @@ RecursiveGaussian::readInputImage(std::string inputImageName)
 
     // Copy pixel data into inputImageData
     memcpy(inputImageData, pixelData, width * height * sizeof(cl_uchar4));
-    memcpy(verificationInput, pixelData, width * height * sizeof(cl_uchar4));
 
-    // allocate memory for verification output
-    verificationOutput = (cl_uchar4*)malloc(width * height * sizeof(cl_uchar4));
+    return SDK_SUCCESS;
+
+}
+
+
+// float to IEEE half, round to nearest even
+static cl_half
+floatToHalf(float value)
+{
+    cl_uint u;
+    memcpy(&u, &value, sizeof(u));
+
+    cl_uint sign = (u >> 16) & 0x8000;
+    cl_int exponent = (cl_int)((u >> 23) & 0xff) - 127 + 15;
+    cl_uint mantissa = u & 0x7fffff;
+
+    // Inf and NaN
+    if(((u >> 23) & 0xff) == 0xff)
+    {
+        return (cl_half)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+
+    // overflow to Inf
+    if(exponent >= 31)
+    {
+        return (cl_half)(sign | 0x7c00);
+    }
+
+    // subnormal or zero
+    if(exponent <= 0)
+    {
+        if(exponent < -10)
+        {
+            return (cl_half)sign;
+        }
+        mantissa |= 0x800000;
+        cl_uint shift = 14 - exponent;
+        cl_uint bits = mantissa >> shift;
+        cl_uint rest = mantissa & ((1u << shift) - 1);
+        cl_uint halfway = 1u << (shift - 1);
+        if(rest > halfway || (rest == halfway && (bits & 1)))
+        {
+            bits++;
+        }
+        return (cl_half)(sign | bits);
+    }
+
+    // normal, a carry out of the mantissa correctly bumps the exponent
+    cl_uint bits = ((cl_uint)exponent << 10) | (mantissa >> 13);
+    cl_uint rest = mantissa & 0x1fff;
+    if(rest > 0x1000 || (rest == 0x1000 && (bits & 1)))
+    {
+        bits++;
+    }
+    return (cl_half)(sign | bits);
+}
+
+
+// IEEE half to float
+static float
+halfToFloat(cl_half value)
+{
+    cl_uint sign = ((cl_uint)value & 0x8000) << 16;
+    cl_uint exponent = (value >> 10) & 0x1f;
+    cl_uint mantissa = value & 0x3ff;
+    cl_uint u;
+
+    if(exponent == 0x1f)
+    {
+        u = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if(exponent == 0)
+    {
+        float f = (float)ldexp((double)mantissa, -24);
+        return sign ? -f : f;
+    }
+    else
+    {
+        u = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+
+int
+RecursiveGaussian::validateOptions()
+{
+    if(formatName.compare("uchar") == 0)
+    {
+        format = RG_UCHAR;
+        elementSize = sizeof(cl_uchar4);
+    }
+    else if(formatName.compare("float") == 0)
+    {
+        format = RG_FLOAT;
+        elementSize = sizeof(cl_float4);
+    }
+    else if(formatName.compare("half") == 0)
+    {
+        format = RG_HALF;
+        elementSize = 4 * sizeof(cl_half);
+    }
+    else
+    {
+        std::cout << "Unknown format : " << formatName
+                  << " (expected uchar, float or half)" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    if(filterName.compare("deriche2") == 0)
+    {
+        filter = RG_DERICHE2;
+    }
+    else if(filterName.compare("deriche4") == 0)
+    {
+        filter = RG_DERICHE4;
+    }
+    else if(filterName.compare("yvv3") == 0)
+    {
+        filter = RG_YVV3;
+    }
+    else
+    {
+        std::cout << "Unknown filter : " << filterName
+                  << " (expected deriche2, deriche4 or yvv3)" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    if(sigma < 0.5f)
+    {
+        std::cout << "Sigma should be at least 0.5" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    if(batch < 1)
+    {
+        std::cout << "Batch should contain at least 1 image" << std::endl;
+        return SDK_FAILURE;
+    }
+
+    return SDK_SUCCESS;
+}
+
+
+int
+RecursiveGaussian::setupBatch()
+{
+    size_t pixels = width * height;
+
+    batchInput = malloc(pixels * batch * elementSize);
+    CHECK_ALLOCATION(batchInput, "Failed to allocate memory! (batchInput)");
+
+    batchOutput = malloc(pixels * batch * elementSize);
+    CHECK_ALLOCATION(batchOutput, "Failed to allocate memory! (batchOutput)");
+    memset(batchOutput, 0, pixels * batch * elementSize);
+
+    verificationInput = (cl_float4*)malloc(pixels * batch * sizeof(cl_float4));
+    CHECK_ALLOCATION(verificationInput,
+                     "Failed to allocate memory! (verificationInput)");
+
+    verificationOutput = (cl_float4*)malloc(pixels * batch * sizeof(cl_float4));
     CHECK_ALLOCATION(verificationOutput,
                      "Failed to allocate memory! (verificationOutput)");
+    memset(verificationOutput, 0, pixels * batch * sizeof(cl_float4));
 
-    // initialize the data to NULL
-    memset(verificationOutput, 0, width * height * sizeof(cl_uchar4));
+    // odd images are mirrored so that every image of the batch differs.
+    // float and half images hold the bitmap scaled to [0, 1]
+    for(cl_uint b = 0; b < batch; b++)
+    {
+        for(cl_uint y = 0; y < height; y++)
+        {
+            for(cl_uint x = 0; x < width; x++)
+            {
+                cl_uint srcX = (b & 1) ? width - 1 - x : x;
+                const cl_uchar4 &src = inputImageData[y * width + srcX];
+                size_t i = b * pixels + y * width + x;
+
+                for(int c = 0; c < 4; c++)
+                {
+                    float value = src.s[c];
+                    if(format == RG_UCHAR)
+                    {
+                        ((cl_uchar4*)batchInput)[i].s[c] = src.s[c];
+                    }
+                    else if(format == RG_FLOAT)
+                    {
+                        value /= 255.0f;
+                        ((cl_float4*)batchInput)[i].s[c] = value;
+                    }
+                    else
+                    {
+                        cl_half h = floatToHalf(value / 255.0f);
+                        ((cl_half*)batchInput)[4 * i + c] = h;
+                        value = halfToFloat(h);
+                    }
+                    verificationInput[i].s[c] = value;
+                }
+            }
+        }
+    }
 
     return SDK_SUCCESS;
+}
 
+
+cl_float4
+RecursiveGaussian::outputPixel(size_t index)
+{
+    cl_float4 pixel;
+    for(int c = 0; c < 4; c++)
+    {
+        if(format == RG_UCHAR)
+        {
+            pixel.s[c] = ((cl_uchar4*)batchOutput)[index].s[c];
+        }
+        else if(format == RG_FLOAT)
+        {
+            pixel.s[c] = ((cl_float4*)batchOutput)[index].s[c];
+        }
+        else
+        {
+            pixel.s[c] = halfToFloat(((cl_half*)batchOutput)[4 * index + c]);
+        }
+    }
+    return pixel;
 }
 
 
 int
 RecursiveGaussian::writeOutputImage(std::string outputImageName)
 {
+    // convert the first image of the batch back to bitmap data
+    float scale = (format == RG_UCHAR) ? 1.0f : 255.0f;
+    float bias = (format == RG_UCHAR) ? 0.0f : 0.5f;
+    for(cl_uint i = 0; i < width * height; i++)
+    {
+        cl_float4 pixel = outputPixel(i);
+        for(int c = 0; c < 4; c++)
+        {
+            float value = pixel.s[c] * scale + bias;
+            value = value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+            outputImageData[i].s[c] = (cl_uchar)value;
+        }
+    }
+
     // copy output image data back to original pixel data
     memcpy(pixelData, outputImageData, width * height * sizeof(cl_uchar4));
 
@@ -161,12 +389,163 @@ RecursiveGaussian::computeGaussParms(float fSigma, int iOrder, GaussParms* pGP)
 }
 
 
+void
+RecursiveGaussian::computeIIRParms(float fSigma, int iFilter, IIRParms* pIIR)
+{
+    memset(pIIR, 0, sizeof(IIRParms));
+    bool normalise = true;
+
+    switch (iFilter)
+    {
+    case RG_DERICHE2:
+    {
+        // a single section : x[i] + x[i-1] causal, x[i+1] + x[i+2] anticausal
+        computeGaussParms(fSigma, 0, &oclGP);
+        pIIR->n[0][0] = oclGP.a0;
+        pIIR->n[0][1] = oclGP.a1;
+        pIIR->m[0][1] = oclGP.a2;
+        pIIR->m[0][2] = oclGP.a3;
+        pIIR->d[0][0] = oclGP.b1;
+        pIIR->d[0][1] = oclGP.b2;
+        normalise = false;
+    }
+    break;
+    case RG_DERICHE4:
+    {
+        // h(x) = sum over two damped cosines (a cos(wx/s) + c sin(wx/s)) exp(-bx/s),
+        // one second-order section per term
+        const double a[2] = {1.680, -0.6803};
+        const double c[2] = {3.735, -0.2598};
+        const double b[2] = {1.783, 1.723};
+        const double w[2] = {0.6318, 1.997};
+        for(int k = 0; k < 2; k++)
+        {
+            const double r = exp(-b[k] / fSigma);
+            const double theta = w[k] / fSigma;
+            const double n0 = a[k];
+            const double n1 = (c[k] * sin(theta) - a[k] * cos(theta)) * r;
+            const double d1 = -2.0 * r * cos(theta);
+            const double d2 = r * r;
+            pIIR->n[k][0] = (cl_float)n0;
+            pIIR->n[k][1] = (cl_float)n1;
+            pIIR->d[k][0] = (cl_float)d1;
+            pIIR->d[k][1] = (cl_float)d2;
+            // symmetric kernel : the anticausal taps follow from the causal ones
+            pIIR->m[k][1] = (cl_float)(n1 - d1 * n0);
+            pIIR->m[k][2] = (cl_float)(-d2 * n0);
+        }
+    }
+    break;
+    case RG_YVV3:
+    {
+        // Young-van Vliet : B / (1 + d1 z^-1 + d2 z^-2 + d3 z^-3) forward then
+        // backward, split into a real pole and a complex pair by partial fractions
+        const double q = (fSigma >= 2.5f) ? 0.98711 * fSigma - 0.96330
+                         : 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * fSigma);
+        const double q2 = q * q;
+        const double q3 = q2 * q;
+        const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+        const double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+        const double b2 = -(1.4281 * q2 + 1.26661 * q3);
+        const double b3 = 0.422205 * q3;
+        const double B = 1.0 - (b1 + b2 + b3) / b0;
+        const double d1 = -b1 / b0;
+        const double d2 = -b2 / b0;
+        const double d3 = -b3 / b0;
+
+        // real root u of 1 + d1 u + d2 u^2 + d3 u^3, the real pole is 1 / u
+        double u = 1.0;
+        for(int i = 0; i < 50; i++)
+        {
+            u -= (1.0 + d1 * u + d2 * u * u + d3 * u * u * u) /
+                 (d1 + 2.0 * d2 * u + 3.0 * d3 * u * u);
+        }
+        const double p1 = 1.0 / u;
+        const double e1 = d1 + p1;
+        const double e2 = -d3 / p1;
+        const double A = p1 * p1 * B / (p1 * p1 + e1 * p1 + e2);
+        const double C0 = B - A;
+        const double C1 = A * e2 / p1;
+
+        pIIR->n[0][0] = (cl_float)A;
+        pIIR->m[0][0] = (cl_float)A;
+        pIIR->d[0][0] = (cl_float)-p1;
+        pIIR->n[1][0] = (cl_float)C0;
+        pIIR->n[1][1] = (cl_float)C1;
+        pIIR->m[1][0] = (cl_float)C0;
+        pIIR->m[1][1] = (cl_float)C1;
+        pIIR->d[1][0] = (cl_float)e1;
+        pIIR->d[1][1] = (cl_float)e2;
+        pIIR->cascade = 1;
+    }
+    break;
+    default:
+        // note: iFilter is range-checked upstream
+        return;
+    }
+
+    // steady state gains, from the rounded coefficients the kernels use
+    double gainp = 0.0;
+    double gainn = 0.0;
+    for(int k = 0; k < 2; k++)
+    {
+        const double sd = 1.0 + pIIR->d[k][0] + pIIR->d[k][1];
+        gainp += (pIIR->n[k][0] + pIIR->n[k][1]) / sd;
+        gainn += (pIIR->m[k][0] + pIIR->m[k][1] + pIIR->m[k][2]) / sd;
+    }
+
+    // unit DC gain keeps large sigmas from drifting in brightness
+    double scale = 1.0;
+    if(normalise)
+    {
+        scale = pIIR->cascade ? 1.0 / sqrt(gainp * gainn) : 1.0 / (gainp + gainn);
+    }
+
+    for(int k = 0; k < 2; k++)
+    {
+        const double sd = 1.0 + pIIR->d[k][0] + pIIR->d[k][1];
+        for(int j = 0; j < 2; j++)
+        {
+            pIIR->n[k][j] = (cl_float)(pIIR->n[k][j] * scale);
+        }
+        for(int j = 0; j < 3; j++)
+        {
+            pIIR->m[k][j] = (cl_float)(pIIR->m[k][j] * scale);
+        }
+        pIIR->coefp[k] = (cl_float)((pIIR->n[k][0] + pIIR->n[k][1]) / sd);
+        pIIR->coefn[k] = (cl_float)((pIIR->m[k][0] + pIIR->m[k][1] + pIIR->m[k][2]) / sd);
+    }
+}
+
+
+std::string
+RecursiveGaussian::kernelFlags()
+{
+    // program_scope_temp holds the column pass of the whole batch
+    return std::string("-D RG_FORMAT=") + toString(format, std::dec) +
+           std::string(" -D RG_TEMP_PIXELS=") +
+           toString(width * height * batch, std::dec);
+}
+
+
 int
 RecursiveGaussian::genBinaryImage()
 {
+    // The size of program_scope_temp comes from the input image
+    std::string filePath = getPath() + std::string(INPUT_IMAGE);
+    if(readInputImage(filePath) != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
+    if(validateOptions() != SDK_SUCCESS)
+    {
+        return SDK_FAILURE;
+    }
+
     bifData binaryData;
     binaryData.kernelName = std::string("RecursiveGaussian_ProgramScope_Kernels.cl");
-    binaryData.flagsStr = std::string("");
+    binaryData.flagsStr = kernelFlags();
     if(sampleArgs->isComplierFlagsSpecified())
     {
         binaryData.flagsFileName = std::string(sampleArgs->flags.c_str());
@@ -261,6 +640,20 @@ RecursiveGaussian::setupCL()
     }
 
     
+    // the column pass result of the whole batch lives in a program scope variable
+    size_t maxGlobalVariableSize = 0;
+    status = clGetDeviceInfo(devices[sampleArgs->deviceId],
+                             CL_DEVICE_MAX_GLOBAL_VARIABLE_SIZE,
+                             sizeof(size_t),
+                             &maxGlobalVariableSize,
+                             NULL);
+    CHECK_OPENCL_ERROR(status, "clGetDeviceInfo(CL_DEVICE_MAX_GLOBAL_VARIABLE_SIZE) failed.");
+
+    if((size_t)width * height * batch * sizeof(cl_float4) > maxGlobalVariableSize)
+    {
+        OPENCL_EXPECTED_ERROR("Unsupported! Image batch exceeds CL_DEVICE_MAX_GLOBAL_VARIABLE_SIZE, use a smaller batch");
+    }
+
     // Create and initialize memory objects
 
     // Set Persistent memory only for AMD platform
@@ -274,7 +667,7 @@ RecursiveGaussian::setupCL()
     inputImageBuffer = clCreateBuffer(
                            context,
                            inMemFlags,
-                           width * height * pixelSize,
+                           width * height * batch * elementSize,
                            0,
                            &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (inputImageBuffer)");
@@ -282,7 +675,7 @@ RecursiveGaussian::setupCL()
     // Create memory objects for output Image
     outputImageBuffer = clCreateBuffer(context,
                                        CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                                       width * height * pixelSize,
+                                       width * height * batch * elementSize,
                                        NULL,
                                        &status);
     CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (outputImageBuffer)");
@@ -293,7 +686,7 @@ RecursiveGaussian::setupCL()
     buildData.kernelName = std::string("RecursiveGaussian_ProgramScope_Kernels.cl");
     buildData.devices = devices;
     buildData.deviceId = sampleArgs->deviceId;
-    buildData.flagsStr = std::string("");
+    buildData.flagsStr = kernelFlags();
     if(sampleArgs->isLoadBinaryEnabled())
     {
         buildData.binaryName = std::string(sampleArgs->loadBinary.c_str());
@@ -309,11 +702,11 @@ RecursiveGaussian::setupCL()
 
     // get a kernel object handle for a kernel with the given name
 
-    // kernel object for transpose kernel
-    kernelTranspose = clCreateKernel(program,
-                                     "transpose_kernel",
-                                     &status);
-    CHECK_OPENCL_ERROR(status, "clCreateKernel failed.(transpose_kernel)");
+    // kernel object for the row pass
+    kernelRows = clCreateKernel(program,
+                                "RecursiveGaussian_rows",
+                                &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel failed.(RecursiveGaussian_rows)");
 
     // kernel object for recursive gaussian kernel
     kernelRecursiveGaussian = clCreateKernel(program,
@@ -321,10 +714,10 @@ RecursiveGaussian::setupCL()
                               &status);
     CHECK_OPENCL_ERROR(status, "clCreateKernel failed.(RecursiveGaussian_kernel)");
 
-    status = transposeKernelInfo.setKernelWorkGroupInfo(kernelTranspose,
+    status = rowKernelInfo.setKernelWorkGroupInfo(kernelRows,
              devices[sampleArgs->deviceId]);
     CHECK_ERROR(status, SDK_SUCCESS,
-                "transposeKernelInfo.setKernelWorkGroupInfo() failed");
+                "rowKernelInfo.setKernelWorkGroupInfo() failed");
 
     status = RGKernelInfo.setKernelWorkGroupInfo(kernelRecursiveGaussian,
              devices[sampleArgs->deviceId]);
@@ -338,10 +731,31 @@ RecursiveGaussian::setupCL()
         blockSizeY = 1;
     }
 
-    // Calculate 2D block size according to required work-group size by transpose kernel
-    blockSize = (size_t)sqrt((float)transposeKernelInfo.kernelWorkGroupSize);
-    //blockSize should a multiple of power of 2
-    blockSize = (size_t)pow((float)2, (int)(log((float)blockSize) / log((float)2)));
+    // Row kernel : one work-item per row segment, the segments split the row evenly
+    while(rowSegments > rowKernelInfo.kernelWorkGroupSize ||
+            rowSegments > deviceInfo.maxWorkItemSizes[0] ||
+            width % rowSegments)
+    {
+        rowSegments /= 2;
+    }
+
+    // work-items 0..3 build the segment transition matrices
+    if(rowSegments < 4)
+    {
+        std::cout << "Unsupported: Device does not"
+                  "support requested number of work items.";
+        return SDK_FAILURE;
+    }
+
+    // two staged copies of a row plus the segment states
+    cl_ulong rowLocalMemory = rowKernelInfo.localMemoryUsed +
+                              (2 * width + 4 * rowSegments) * sizeof(cl_float4);
+    if(rowLocalMemory > deviceInfo.localMemSize)
+    {
+        std::cout << "Unsupported: Insufficient"
+                  "local memory on device." << std::endl;
+        return SDK_FAILURE;
+    }
 
     return SDK_SUCCESS;
 }
@@ -352,21 +766,17 @@ RecursiveGaussian::runCLKernels()
     cl_int status = CL_SUCCESS;
     cl_int eventStatus = CL_QUEUED;
 
-    // initialize Gaussian parameters
-    float fSigma = 10.0f;               // filter sigma (blur factor)
-    int iOrder = 0;                     // filter order
+    // compute filter coefficients
+    computeIIRParms(sigma, filter, &oclIIR);
 
-    // compute gaussian parameters
-    computeGaussParms(fSigma, iOrder, &oclGP);
-
-    // Write inputImageData to inputImageBuffer on device
+    // Write the batch of input images to inputImageBuffer on device
     cl_event writeEvt;
     status = clEnqueueWriteBuffer(commandQueue,
                                   inputImageBuffer,
                                   CL_FALSE,
                                   0,
-                                  width * height * pixelSize,
-                                  inputImageData,
+                                  width * height * batch * elementSize,
+                                  batchInput,
                                   0,
                                   NULL,
                                   &writeEvt);
@@ -378,7 +788,7 @@ RecursiveGaussian::runCLKernels()
     status = waitForEventAndRelease(&writeEvt);
     CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(writeEvt) Failed");
 
-    // Set appropriate arguments to the kernel (Recursive Gaussian)
+    // Set appropriate arguments to the kernel (Recursive Gaussian, columns)
 
     // input : input buffer image
     status = clSetKernelArg(
@@ -401,18 +811,16 @@ RecursiveGaussian::runCLKernels()
                             sizeof(cl_int),
                             &height);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg(height) failed.");
-    
-    // Gaussian parameters
+
+    // filter coefficients
     status = clSetKernelArg(kernelRecursiveGaussian,
                             3,
-							sizeof(oclGP),
-                            (void *)&oclGP);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(oclGP.coefn) failed.");
-
-
+                            sizeof(IIRParms),
+                            &oclIIR);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(oclIIR) failed.");
 
-    // set global index and group size
-    size_t globalThreads[] = {width, 1};
+    // set global index and group size : one column per work-item, one image per row
+    size_t globalThreads[] = {width, batch};
     size_t localThreads[] = {blockSizeX, blockSizeY};
 
     if(localThreads[0] > deviceInfo.maxWorkItemSizes[0] ||
@@ -443,175 +851,61 @@ RecursiveGaussian::runCLKernels()
     status = waitForEventAndRelease(&ndrEvt);
     CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
 
-    // Set appropriate arguments to the kernel (Transpose)
-
-    // output : input buffer image
-    status = clSetKernelArg(
-                 kernelTranspose,
-                 0,
-                 sizeof(cl_mem),
-                 &inputImageBuffer);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(inputImageBuffer) failed.");
-
-   
-    // local memory for block transpose
-    status = clSetKernelArg(kernelTranspose,
-                            1,
-                            blockSize * blockSize * sizeof(cl_uchar4),
-                            NULL);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(Local) failed.");
-
-    // image width
-    status = clSetKernelArg(kernelTranspose,
-                            2,
-                            sizeof(cl_int),
-                            &width);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(width) failed.");
-
-    // image height
-    status = clSetKernelArg(kernelTranspose,
-                            3,
-                            sizeof(cl_int),
-                            &height);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(height) failed.");
-
-    // block_size
-    status = clSetKernelArg(kernelTranspose,
-                            4,
-                            sizeof(cl_int),
-                            &blockSize);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(blockSize) failed.");
-
-    // group dimensions for transpose kernel
-    size_t localThreadsT[] = {blockSize, blockSize};
-    size_t globalThreadsT[] = {width, height};
-
-    if(localThreadsT[0] > deviceInfo.maxWorkItemSizes[0] ||
-            localThreadsT[1] > deviceInfo.maxWorkItemSizes[1] ||
-            localThreadsT[0] * localThreadsT[1] > deviceInfo.maxWorkGroupSize)
-    {
-        std::cout << "Unsupported: Device does not support requested"
-                  "number of work items.";
-        return SDK_FAILURE;
-    }
-
-    if(transposeKernelInfo.localMemoryUsed > deviceInfo.localMemSize)
-    {
-        std::cout << "Unsupported: Insufficient"
-                  "local memory on device." << std::endl;
-        return SDK_FAILURE;
-    }
-
-    // Enqueue Transpose Kernel
-    status = clEnqueueNDRangeKernel(
-                 commandQueue,
-                 kernelTranspose,
-                 2,
-                 NULL,
-                 globalThreadsT,
-                 localThreadsT,
-                 0,
-                 NULL,
-                 &ndrEvt);
-    CHECK_OPENCL_ERROR(status, "kernelTranspose() failed.");
-
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-
-    status = waitForEventAndRelease(&ndrEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
-
-    /* Set Arguments for Recursive Gaussian Kernel
-    Image is now transposed
-    new_width = height
-    new_height = width */
-
-    // image width : swap with height
-    status = clSetKernelArg(kernelRecursiveGaussian,
-                            1,
-                            sizeof(cl_int),
-                            &height);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(height) failed.");
-
-    // image height
-    status = clSetKernelArg(kernelRecursiveGaussian,
-                            2,
-                            sizeof(cl_int),
-                            &width);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(width) failed.");
-
-    // Set new global index
-    globalThreads[0] = height;
-    globalThreads[1] = 1;
-
-    status = clEnqueueNDRangeKernel(
-                 commandQueue,
-                 kernelRecursiveGaussian,
-                 2,
-                 NULL,
-                 globalThreads,
-                 localThreads,
-                 0,
-                 NULL,
-                 &ndrEvt);
-    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel() failed.");
-
-    status = clFlush(commandQueue);
-    CHECK_OPENCL_ERROR(status, "clFlush() failed.");
-
-    status = waitForEventAndRelease(&ndrEvt);
-    CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
-    // Set Arguments to Transpose Kernel
+    // Set appropriate arguments to the kernel (Recursive Gaussian, rows)
 
     // output : output buffer image
     status = clSetKernelArg(
-                 kernelTranspose,
+                 kernelRows,
                  0,
                  sizeof(cl_mem),
                  &outputImageBuffer);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg(outputImageBuffer) failed.");
 
-   
-    // local memory for block transpose
-    status = clSetKernelArg(kernelTranspose,
+    // local memory for the staged row and the forward result
+    status = clSetKernelArg(kernelRows,
                             1,
-                            blockSize * blockSize * sizeof(cl_uchar4),
+                            width * sizeof(cl_float4),
                             NULL);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg(Local) failed.");
 
-    // image width : is height actually as the image is currently transposed
-    status = clSetKernelArg(kernelTranspose,
+    status = clSetKernelArg(kernelRows,
                             2,
-                            sizeof(cl_int),
-                            &height);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(height) failed.");
+                            width * sizeof(cl_float4),
+                            NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(Local) failed.");
 
-    // image height
-    status = clSetKernelArg(kernelTranspose,
+    // local memory for the segment states
+    status = clSetKernelArg(kernelRows,
                             3,
+                            4 * rowSegments * sizeof(cl_float4),
+                            NULL);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(Local) failed.");
+
+    // image width
+    status = clSetKernelArg(kernelRows,
+                            4,
                             sizeof(cl_int),
                             &width);
     CHECK_OPENCL_ERROR(status, "clSetKernelArg(width) failed.");
 
-    // block_size
-    status = clSetKernelArg(kernelTranspose,
-                            4,
-                            sizeof(cl_int),
-                            &blockSize);
-    CHECK_OPENCL_ERROR(status, "clSetKernelArg(blockSize) failed.");
+    // filter coefficients
+    status = clSetKernelArg(kernelRows,
+                            5,
+                            sizeof(IIRParms),
+                            &oclIIR);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArg(oclIIR) failed.");
 
-    // group dimensions for transpose kernel
-    globalThreadsT[0] = height;
-    globalThreadsT[1] = width;
+    // one work-group per row of every image in the batch
+    size_t globalThreadsR[] = {rowSegments, height * batch};
+    size_t localThreadsR[] = {rowSegments, 1};
 
-    // Enqueue final Transpose Kernel
     status = clEnqueueNDRangeKernel(
                  commandQueue,
-                 kernelTranspose,
+                 kernelRows,
                  2,
                  NULL,
-                 globalThreadsT,
-                 localThreadsT,
+                 globalThreadsR,
+                 localThreadsR,
                  0,
                  NULL,
                  &ndrEvt);
@@ -623,14 +917,14 @@ RecursiveGaussian::runCLKernels()
     status = waitForEventAndRelease(&ndrEvt);
     CHECK_ERROR(status, SDK_SUCCESS, "WaitForEventAndRelease(ndrEvt) Failed");
 
-    // Enqueue read output buffer to outputImageData
+    // Enqueue read output buffer to batchOutput
     cl_event readEvt;
     status = clEnqueueReadBuffer(commandQueue,
                                  outputImageBuffer,
                                  CL_FALSE,
                                  0,
-                                 width * height * sizeof(cl_uchar4),
-                                 outputImageData,
+                                 width * height * batch * elementSize,
+                                 batchOutput,
                                  0,
                                  NULL,
                                  &readEvt);
@@ -671,6 +965,67 @@ RecursiveGaussian::initialize()
     sampleArgs->AddOption(iteration_option);
     delete iteration_option;
 
+    Option* sigma_option = new Option;
+    if(!sigma_option)
+    {
+        error("Memory Allocation error.\n");
+        return SDK_FAILURE;
+    }
+    sigma_option->_sVersion = "s";
+    sigma_option->_lVersion = "sigma";
+    sigma_option->_description = "Filter sigma (blur factor), at least 0.5";
+    sigma_option->_type = CA_ARG_FLOAT;
+    sigma_option->_value = &sigma;
+
+    sampleArgs->AddOption(sigma_option);
+    delete sigma_option;
+
+    Option* filter_option = new Option;
+    if(!filter_option)
+    {
+        error("Memory Allocation error.\n");
+        return SDK_FAILURE;
+    }
+    filter_option->_sVersion = "f";
+    filter_option->_lVersion = "filter";
+    filter_option->_description =
+        "Recursive filter : deriche2, deriche4 or yvv3 (large sigma)";
+    filter_option->_type = CA_ARG_STRING;
+    filter_option->_value = &filterName;
+
+    sampleArgs->AddOption(filter_option);
+    delete filter_option;
+
+    Option* format_option = new Option;
+    if(!format_option)
+    {
+        error("Memory Allocation error.\n");
+        return SDK_FAILURE;
+    }
+    format_option->_sVersion = "fmt";
+    format_option->_lVersion = "format";
+    format_option->_description = "Image format : uchar, float or half (RGBA)";
+    format_option->_type = CA_ARG_STRING;
+    format_option->_value = &formatName;
+
+    sampleArgs->AddOption(format_option);
+    delete format_option;
+
+    Option* batch_option = new Option;
+    if(!batch_option)
+    {
+        error("Memory Allocation error.\n");
+        return SDK_FAILURE;
+    }
+    batch_option->_sVersion = "b";
+    batch_option->_lVersion = "batch";
+    batch_option->_description = "Number of images filtered per launch";
+    batch_option->_type = CA_ARG_INT;
+    batch_option->_value = &batch;
+
+    sampleArgs->AddOption(batch_option);
+    delete batch_option;
+
     return SDK_SUCCESS;
 }
 
@@ -687,6 +1042,13 @@ RecursiveGaussian::setup()
     int status = readInputImage(filePath);
     CHECK_ERROR(status, SDK_SUCCESS, "OpenCL Read Input Image Failed");
 
+    status = validateOptions();
+    CHECK_ERROR(status, SDK_SUCCESS, "Invalid options");
+
+    // replicate the image into a batch in the selected format
+    status = setupBatch();
+    CHECK_ERROR(status, SDK_SUCCESS, "Failed to set up the image batch");
+
     // create and initialize timers
     int timer = sampleTimer->createTimer();
     sampleTimer->resetTimer(timer);
@@ -759,8 +1121,8 @@ RecursiveGaussian::cleanup()
     status = clReleaseKernel(kernelRecursiveGaussian);
     CHECK_OPENCL_ERROR(status, "clReleaseKernel(kernelRecursiveGaussian) failed.");
 
-    status = clReleaseKernel(kernelTranspose);
-    CHECK_OPENCL_ERROR(status, "clReleaseKernel(kernelTranspose) failed.");
+    status = clReleaseKernel(kernelRows);
+    CHECK_OPENCL_ERROR(status, "clReleaseKernel(kernelRows) failed.");
 
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.");
@@ -781,6 +1143,8 @@ RecursiveGaussian::cleanup()
 
     FREE(inputImageData);
     FREE(outputImageData);
+    FREE(batchInput);
+    FREE(batchOutput);
     FREE(verificationInput);
     FREE(verificationOutput);
     FREE(devices);
@@ -789,150 +1153,98 @@ RecursiveGaussian::cleanup()
 }
 
 void
-RecursiveGaussian::recursiveGaussianCPU(cl_uchar4* input, cl_uchar4* output,
-                                        const int width, const int height,
-                                        const float a0, const float a1,
-                                        const float a2, const float a3,
-                                        const float b1, const float b2,
-                                        const float coefp, const float coefn)
+RecursiveGaussian::recursiveGaussianCPU(const cl_float4* input, cl_float4* output,
+                                        const int length, const int stride,
+                                        const IIRParms& p)
 {
 
-    // outer loop over all columns within image
-    for (int X = 0; X < width; X++)
+    // same recursion as the kernels, one channel at a time
+    for (int c = 0; c < 4; c++)
     {
-        // start forward filter pass
-        float xp[4] = {0.0f, 0.0f, 0.0f, 0.0f};  // previous input
-        float yp[4] = {0.0f, 0.0f, 0.0f, 0.0f};  // previous output
-        float yb[4] = {0.0f, 0.0f, 0.0f, 0.0f};  // previous output by 2
-
-        float xc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-        float yc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-
-        for (int Y = 0; Y < height; Y++)
+        // start forward filter pass, primed with the replicated first pixel
+        float xp = input[0].s[c];           // previous input
+        float ya = p.coefp[0] * xp;         // section 0 : previous output
+        float yab = ya;                     // section 0 : previous output by 2
+        float yb = p.coefp[1] * xp;         // section 1 : previous output
+        float ybb = yb;                     // section 1 : previous output by 2
+
+        for (int i = 0; i < length; i++)
         {
-            // output position to write
-            int pos = Y * width + X;
-
-            // convert input element to float4
-            xc[0] = input[pos].s[0];
-            xc[1] = input[pos].s[1];
-            xc[2] = input[pos].s[2];
-            xc[3] = input[pos].s[3];
-
-            yc[0] = (a0 * xc[0]) + (a1 * xp[0]) - (b1 * yp[0]) - (b2 * yb[0]);
-            yc[1] = (a0 * xc[1]) + (a1 * xp[1]) - (b1 * yp[1]) - (b2 * yb[1]);
-            yc[2] = (a0 * xc[2]) + (a1 * xp[2]) - (b1 * yp[2]) - (b2 * yb[2]);
-            yc[3] = (a0 * xc[3]) + (a1 * xp[3]) - (b1 * yp[3]) - (b2 * yb[3]);
-
-            // convert float4 element to output
-            output[pos].s[0] = (cl_uchar)yc[0];
-            output[pos].s[1] = (cl_uchar)yc[1];
-            output[pos].s[2] = (cl_uchar)yc[2];
-            output[pos].s[3] = (cl_uchar)yc[3];
-
-            for (int i = 0; i < 4; i++)
-            {
-                xp[i] = xc[i];
-                yb[i] = yp[i];
-                yp[i] = yc[i];
-            }
+            int pos = i * stride;
+            float xc = input[pos].s[c];
+
+            float yc0 = (p.n[0][0] * xc) + (p.n[0][1] * xp) - (p.d[0][0] * ya) - (p.d[0][1] * yab);
+            float yc1 = (p.n[1][0] * xc) + (p.n[1][1] * xp) - (p.d[1][0] * yb) - (p.d[1][1] * ybb);
+            output[pos].s[c] = yc0 + yc1;
+
+            xp = xc;
+            yab = ya;
+            ya = yc0;
+            ybb = yb;
+            yb = yc1;
         }
 
         // start reverse filter pass: ensures response is symmetrical
-        float xn[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-        float xa[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-        float yn[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-        float ya[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-
-        float fTemp[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-
-        for (int Y = height - 1; Y > -1; Y--)
+        int last = (length - 1) * stride;
+        float sn = p.cascade ? output[last].s[c] : input[last].s[c];   // next input
+        float sa = sn;                                                 // next input by 2
+        ya = p.coefn[0] * sn;
+        yab = ya;
+        yb = p.coefn[1] * sn;
+        ybb = yb;
+
+        for (int i = length - 1; i > -1; i--)
         {
-            int pos = Y * width + X;
-
-            // convert uchar4 to float4
-            xc[0] = input[pos].s[0];
-            xc[1] = input[pos].s[1];
-            xc[2] = input[pos].s[2];
-            xc[3] = input[pos].s[3];
-
-            yc[0] = (a2 * xn[0]) + (a3 * xa[0]) - (b1 * yn[0]) - (b2 * ya[0]);
-            yc[1] = (a2 * xn[1]) + (a3 * xa[1]) - (b1 * yn[1]) - (b2 * ya[1]);
-            yc[2] = (a2 * xn[2]) + (a3 * xa[2]) - (b1 * yn[2]) - (b2 * ya[2]);
-            yc[3] = (a2 * xn[3]) + (a3 * xa[3]) - (b1 * yn[3]) - (b2 * ya[3]);
-
-            for (int i = 0; i< 4; i++)
-            {
-                xa[i] = xn[i];
-                xn[i] = xc[i];
-                ya[i] = yn[i];
-                yn[i] = yc[i];
-            }
-
-            // convert uhcar4 to float4
-            fTemp[0] = output[pos].s[0];
-            fTemp[1] = output[pos].s[1];
-            fTemp[2] = output[pos].s[2];
-            fTemp[3] = output[pos].s[3];
-
-            fTemp[0] += yc[0];
-            fTemp[1] += yc[1];
-            fTemp[2] += yc[2];
-            fTemp[3] += yc[3];
-
-            // convert float4 to uchar4
-            output[pos].s[0] = (cl_uchar)fTemp[0];
-            output[pos].s[1] = (cl_uchar)fTemp[1];
-            output[pos].s[2] = (cl_uchar)fTemp[2];
-            output[pos].s[3] = (cl_uchar)fTemp[3];
+            int pos = i * stride;
+            float fwd = output[pos].s[c];
+            float sc = p.cascade ? fwd : input[pos].s[c];
+
+            float yc0 = (p.m[0][0] * sc) + (p.m[0][1] * sn) + (p.m[0][2] * sa)
+                        - (p.d[0][0] * ya) - (p.d[0][1] * yab);
+            float yc1 = (p.m[1][0] * sc) + (p.m[1][1] * sn) + (p.m[1][2] * sa)
+                        - (p.d[1][0] * yb) - (p.d[1][1] * ybb);
+            output[pos].s[c] = p.cascade ? yc0 + yc1 : fwd + yc0 + yc1;
+
+            sa = sn;
+            sn = sc;
+            yab = ya;
+            ya = yc0;
+            ybb = yb;
+            yb = yc1;
         }
     }
 
 }
 
-void
-RecursiveGaussian::transposeCPU(cl_uchar4* input,
-                                cl_uchar4* output,
-                                const int width,
-                                const int height)
-{
-    // transpose matrix
-    for(int Y = 0; Y < height; Y++)
-    {
-        for(int X = 0; X < width; X++)
-        {
-            output[Y + X * height] = input[X + Y * width];
-        }
-    }
-}
-
 void
 RecursiveGaussian::recursiveGaussianCPUReference()
 {
 
-    // Create a temp uchar4 array
-    cl_uchar4* temp = (cl_uchar4*)malloc(width * height * sizeof(cl_uchar4));
+    // Create a temp float4 array for the column pass
+    cl_float4* temp = (cl_float4*)malloc(width * height * sizeof(cl_float4));
     if(temp == NULL)
     {
         error("Failed to allocate host memory! (temp)");
         return;
     }
 
-    // Call recursive Gaussian CPU
-    recursiveGaussianCPU(verificationInput, temp, width, height,
-                         oclGP.a0, oclGP.a1, oclGP.a2, oclGP.a3,
-                         oclGP.b1, oclGP.b2, oclGP.coefp, oclGP.coefn);
-
-    // Transpose the temp buffer
-    transposeCPU(temp, verificationOutput, width, height);
+    for (cl_uint b = 0; b < batch; b++)
+    {
+        const cl_float4* input = verificationInput + b * width * height;
+        cl_float4* output = verificationOutput + b * width * height;
 
-    // again Call recursive Gaussian CPU
-    recursiveGaussianCPU(verificationOutput, temp, height, width,
-                         oclGP.a0, oclGP.a1, oclGP.a2, oclGP.a3,
-                         oclGP.b1, oclGP.b2, oclGP.coefp, oclGP.coefn);
+        // filter every column
+        for (cl_uint x = 0; x < width; x++)
+        {
+            recursiveGaussianCPU(input + x, temp + x, height, width, oclIIR);
+        }
 
-    // Do a final Transpose
-    transposeCPU(temp, verificationOutput, height, width);
+        // filter every row directly, no transpose needed
+        for (cl_uint y = 0; y < height; y++)
+        {
+            recursiveGaussianCPU(temp + y * width, output + y * width, width, 1, oclIIR);
+        }
+    }
 
     if(temp)
     {
@@ -961,36 +1273,44 @@ RecursiveGaussian::verifyResults()
     {
         recursiveGaussianCPUReference();
 
-        float *outputDevice = new float[width * height * 4];
+        size_t pixels = width * height * batch;
+
+        float *outputDevice = new float[pixels * 4];
         CHECK_ALLOCATION(outputDevice,
                          "Failed to allocate host" "memory! (outputDevice)");
 
-        float *outputReference = new float[width * height * 4];
+        float *outputReference = new float[pixels * 4];
         CHECK_ALLOCATION(outputReference,
                          "Failed to allocate host" "memory! (outputReference)");
 
-        int m = 0;
-
-        // copy uchar4 data to float array
-        for(int i=0; i < (int)(width * height); i++)
+        // copy device data to float array, round the reference to the image format
+        for(size_t i = 0; i < pixels; i++)
         {
-            outputDevice[4 * i + 0] = outputImageData[i].s[0];
-            outputDevice[4 * i + 1] = outputImageData[i].s[1];
-            outputDevice[4 * i + 2] = outputImageData[i].s[2];
-            outputDevice[4 * i + 3] = outputImageData[i].s[3];
-
-            outputReference[4 * i + 0] = verificationOutput[i].s[0];
-            outputReference[4 * i + 1] = verificationOutput[i].s[1];
-            outputReference[4 * i + 2] = verificationOutput[i].s[2];
-            outputReference[4 * i + 3] = verificationOutput[i].s[3];
+            cl_float4 pixel = outputPixel(i);
+            for(int c = 0; c < 4; c++)
+            {
+                float reference = verificationOutput[i].s[c];
+                if(format == RG_UCHAR)
+                {
+                    reference = reference < 0.0f ? 0.0f : (reference > 255.0f ? 255.0f : reference);
+                    reference = (float)(cl_uchar)reference;
+                }
+                else if(format == RG_HALF)
+                {
+                    reference = halfToFloat(floatToHalf(reference));
+                }
+
+                outputDevice[4 * i + c] = pixel.s[c];
+                outputReference[4 * i + c] = reference;
+            }
         }
 
 
         // compare the results and see if they match
         if(compare(outputReference,
                    outputDevice,
-                   width * height,
-                   (float)0.0001))
+                   (int)(pixels * 4),
+                   (float)0.001))
         {
             std::cout <<"Passed!\n" << std::endl;
             delete[] outputDevice;
@@ -1014,23 +1334,32 @@ RecursiveGaussian::printStats()
 {
     if(sampleArgs->timing)
     {
-        std::string strArray[4] =
+        std::string strArray[8] =
         {
             "Width",
             "Height",
+            "Images",
+            "Format",
+            "Filter",
             "Time(sec)",
-            "[Transfer+Kernel]Time(sec)"
+            "[Transfer+Kernel]Time(sec)",
+            "MPixels/s"
         };
-        std::string stats[4];
+        std::string stats[8];
 
         sampleTimer->totalTime = setupTime + kernelTime;
 
         stats[0]  = toString(width, std::dec);
         stats[1]  = toString(height, std::dec);
-        stats[2]  = toString(sampleTimer->totalTime, std::dec);
-        stats[3]  = toString(kernelTime, std::dec);
-
-        printStatistics(strArray, stats, 4);
+        stats[2]  = toString(batch, std::dec);
+        stats[3]  = formatName;
+        stats[4]  = filterName;
+        stats[5]  = toString(sampleTimer->totalTime, std::dec);
+        stats[6]  = toString(kernelTime, std::dec);
+        stats[7]  = toString((double)width * height * batch / kernelTime / 1e6,
+                             std::dec);
+
+        printStatistics(strArray, stats, 8);
     }
 }
 
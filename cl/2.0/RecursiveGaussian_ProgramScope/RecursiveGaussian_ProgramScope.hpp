@@ -33,6 +33,17 @@ using namespace appsdk;
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.1"
 
 #define GROUP_SIZE 256
+#define ROW_SEGMENTS 64                 /**< work-items (line segments) per row in the row pass */
+
+/* image formats, must match RG_FORMAT in the kernel file */
+#define RG_UCHAR 0
+#define RG_FLOAT 1
+#define RG_HALF  2
+
+/* recursive filters */
+#define RG_DERICHE2 0                   /**< Deriche, 2nd order */
+#define RG_DERICHE4 1                   /**< Deriche, 4th order */
+#define RG_YVV3     2                   /**< Young-van Vliet, 3rd order */
 
 /**
 * Custom type for gaussian parameters
@@ -54,6 +65,20 @@ typedef struct _GaussParms
     float coefn;
 } GaussParms, *pGaussParms;
 
+/**
+* Filter coefficients as two second-order sections
+* (same layout as IIRParms in the kernel file)
+*/
+typedef struct _IIRParms
+{
+    cl_float n[2][2];                   /**< causal feed-forward taps x[i], x[i-1] */
+    cl_float m[2][3];                   /**< anticausal feed-forward taps s[i], s[i+1], s[i+2] */
+    cl_float d[2][2];                   /**< feedback taps */
+    cl_float coefp[2];                  /**< causal steady state gain */
+    cl_float coefn[2];                  /**< anticausal steady state gain */
+    cl_int cascade;                     /**< anticausal pass runs on the causal output */
+} IIRParms;
+
 
 
 /**
@@ -66,33 +91,43 @@ class RecursiveGaussian
         cl_double setupTime;                /**< time taken to setup OpenCL resources and building kernel */
         cl_double kernelTime;               /**< time taken to run kernel and read result back */
 
-        cl_uchar4* inputImageData;          /**< Input bitmap data to device */
-        cl_uchar4* outputImageData;         /**< Output from device */
+        cl_uchar4* inputImageData;          /**< Input bitmap data */
+        cl_uchar4* outputImageData;         /**< First output image, as bitmap data */
+        void* batchInput;                   /**< Batch of input images in device format */
+        void* batchOutput;                  /**< Batch of output images from device */
         cl_context context;                 /**< CL context */
         cl_device_id *devices;              /**< CL device list */
         cl_mem inputImageBuffer;            /**< CL memory buffer for input Image*/
         cl_mem outputImageBuffer;           /**< CL memory buffer for Output Image*/
-        cl_uchar4*
+        cl_float4*
         verificationInput;       /**< Input array for reference implementation */
-        cl_uchar4*
+        cl_float4*
         verificationOutput;      /**< Output array for reference implementation */
         cl_command_queue commandQueue;      /**< CL command queue */
         cl_program program;                 /**< CL program  */
-        cl_kernel kernelTranspose;          /**< CL kernel for transpose*/
-        cl_kernel kernelRecursiveGaussian;  /**< CL Kernel for gaussian filter */
+        cl_kernel kernelRecursiveGaussian;  /**< CL Kernel for gaussian filter (columns) */
+        cl_kernel kernelRows;               /**< CL Kernel for gaussian filter (rows) */
         SDKBitMap inputBitmap;              /**< Bitmap class object */
         uchar4* pixelData;                  /**< Pointer to image data */
         cl_uint pixelSize;                  /**< Size of a pixel in BMP format> */
         GaussParms
         oclGP;                   /**< instance of struct to hold gaussian parameters */
+        IIRParms oclIIR;                    /**< Filter coefficients passed to the kernels */
+        cl_float sigma;                     /**< Filter sigma (blur factor) */
+        std::string filterName;             /**< deriche2, deriche4 or yvv3 */
+        std::string formatName;             /**< uchar, float or half */
+        int filter;                         /**< RG_DERICHE2, RG_DERICHE4 or RG_YVV3 */
+        int format;                         /**< RG_UCHAR, RG_FLOAT or RG_HALF */
+        cl_uint batch;                      /**< Number of images filtered per launch */
+        size_t elementSize;                 /**< Size of one pixel in device format */
         cl_uint width;                      /**< Width of image */
         cl_uint height;                     /**< Height of image */
         size_t blockSizeX;                  /**< Work-group size in x-direction */
         size_t blockSizeY;                  /**< Work-group size in y-direction */
-        size_t blockSize;                   /**< block size for transpose kernel */
+        size_t rowSegments;                 /**< Work-group size of the row kernel */
         int iterations;                     /**< Number of iterations for kernel execution */
         SDKDeviceInfo deviceInfo;/**< Structure to store device information*/
-        KernelWorkGroupInfo transposeKernelInfo,
+        KernelWorkGroupInfo rowKernelInfo,
                             RGKernelInfo;/**< Structure to store kernel related info */
 
         SDKTimer *sampleTimer;      /**< SDKTimer object */
@@ -115,6 +150,18 @@ class RecursiveGaussian
         */
         int writeOutputImage(std::string outputImageName);
 
+        /**
+        * Check sigma and batch, resolve the format and filter names
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int validateOptions();
+
+        /**
+        * Build the batch of input images in the selected format
+        * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+        */
+        int setupBatch();
+
         /**
         * Preprocess gaussian parameters
         * @param fSigma sigma value
@@ -123,30 +170,33 @@ class RecursiveGaussian
         */
         void computeGaussParms(float fSigma, int iOrder, GaussParms* pGP);
 
+        /**
+        * Split the selected recursive filter into two second-order sections
+        * @param fSigma sigma value
+        * @param iFilter RG_DERICHE2, RG_DERICHE4 or RG_YVV3
+        * @param pIIR pointer to filter coefficients
+        */
+        void computeIIRParms(float fSigma, int iFilter, IIRParms* pIIR);
+
         /**
         * RecursiveGaussian on CPU (for verification)
+        * Filters one line of the image, a column or a row
         * @param input input image
         * @param output output image
-        * @param width width of image
-        * @param height height of image
-        * @param a0..a3, b1, b2, coefp, coefn gaussian parameters
+        * @param length number of pixels in the line
+        * @param stride distance between two pixels of the line
+        * @param p filter coefficients
         */
-        void recursiveGaussianCPU(cl_uchar4* input, cl_uchar4* output,
-                                  const int width, const int height,
-                                  const float a0, const float a1,
-                                  const float a2, const float a3,
-                                  const float b1, const float b2,
-                                  const float coefp, const float coefn);
+        void recursiveGaussianCPU(const cl_float4* input, cl_float4* output,
+                                  const int length, const int stride,
+                                  const IIRParms& p);
 
         /**
-        * Transpose on CPU (for verification)
-        * @param input input image
-        * @param output output image
-        * @param width width of input image
-        * @param height height of input image
+        * Pixel of the device output batch as float4
+        * @param index pixel index in the batch
+        * @return pixel value
         */
-        void transposeCPU(cl_uchar4* input, cl_uchar4* output,
-                          const int width, const int height);
+        cl_float4 outputPixel(size_t index);
 
         /**
         * Constructor
@@ -155,6 +205,9 @@ class RecursiveGaussian
         RecursiveGaussian()
             : inputImageData(NULL),
               outputImageData(NULL),
+              batchInput(NULL),
+              batchOutput(NULL),
+              verificationInput(NULL),
               verificationOutput(NULL)
         {
             sampleArgs = new CLCommandArgs();
@@ -164,8 +217,15 @@ class RecursiveGaussian
             pixelData = NULL;
             blockSizeX = GROUP_SIZE;
             blockSizeY = 1;
-            blockSize = 1;
+            rowSegments = ROW_SEGMENTS;
             iterations = 1;
+            sigma = 10.0f;
+            filterName = "deriche2";
+            formatName = "uchar";
+            filter = RG_DERICHE2;
+            format = RG_UCHAR;
+            batch = 1;
+            elementSize = sizeof(cl_uchar4);
 	    sampleArgs->flags = OCL2_0_FLAGS ;
         }
 
@@ -179,6 +239,13 @@ class RecursiveGaussian
         */
         int setupRecursiveGaussian();
 
+        /**
+        * Build options of the kernel file, shared by the build and the
+        * binary dump
+        * @return -D options for the format and the batch size
+        */
+        std::string kernelFlags();
+
         /**
          * Override from SDKSample, Generate binary image of given kernel
          * and exit application
@@ -0,0 +1,318 @@
+#ifndef _REGION_GROWING_CCL_
+#define _REGION_GROWING_CCL_
+
+#include "CLUtil.hpp"
+#include "SDKThread.hpp"
+#include "RegionGrowingConst.hpp"
+
+using namespace appsdk;
+
+/*
+ * CCL:
+ * multithreaded host counterpart of the ccl_* kernels. pixels are connected
+ * when 8-neighbors differ by at most 'threshold' in luma. the image is cut
+ * into bands of rows; every thread runs union-find within its band, the
+ * seams between bands are joined afterwards and the threads then point
+ * every pixel at its root. as on the device, a component's root is its
+ * first pixel in raster order and components are numbered in the order of
+ * their roots, so both produce the same labels.
+ */
+class CCL;
+
+/* rows of one thread */
+typedef struct CCLBand
+{
+  CCL*           pCCL;
+  cl_uint        row0;
+  cl_uint        row1;
+} CCLBandType;
+
+class CCL
+{
+public:
+  const cl_uchar4* pImage;
+  cl_int*          pParent;
+  cl_uint*         pLabels;
+  cl_uint          width;
+  cl_uint          height;
+  cl_int           threshold;
+  cl_int           numThreads;
+  cl_uint          numComponents;
+
+  /* constructor and destructor pair */
+  CCL();
+  ~CCL();
+
+  /*
+   * init:
+   * image (luma in x) and parameters, allocates the label buffers.
+   */
+  int     init(const cl_uchar4* pImageData,
+               cl_uint          imageWidth,
+               cl_uint          imageHeight,
+               cl_int           lumaThreshold,
+               cl_int           threads);
+
+  /*
+   * label:
+   * labels the image into pLabels, components numbered from 0.
+   */
+  int     label();
+
+  /*
+   * find, findRoot:
+   * root of pixel x. find halves the path on the way, findRoot only reads.
+   */
+  cl_int  find(cl_int x);
+  cl_int  findRoot(cl_int x) const;
+
+  /*
+   * unite:
+   * joins the trees of a and b below the smaller root.
+   */
+  void    unite(cl_int a, cl_int b);
+
+  /*
+   * connected:
+   * whether pixel i and its neighbor ni belong to one component.
+   */
+  bool    connected(cl_uint i, cl_uint ni) const;
+
+  /*
+   * labelRows:
+   * union-find over rows [row0, row1) without looking above row0.
+   */
+  void    labelRows(cl_uint row0, cl_uint row1);
+
+  /*
+   * joinSeam:
+   * joins row 'row' with the row above it.
+   */
+  void    joinSeam(cl_uint row);
+
+  /*
+   * flattenRows:
+   * root of every pixel of rows [row0, row1) into pLabels.
+   */
+  void    flattenRows(cl_uint row0, cl_uint row1);
+
+  /*
+   * numberComponents:
+   * replaces roots by component numbers in raster order.
+   */
+  void    numberComponents();
+
+  /*
+   * runBands:
+   * runs 'fun' for every band, the last one on the calling thread.
+   */
+  void    runBands(void* (*fun)(void*), CCLBandType* pBands);
+};
+
+void* cclLabelThread(void* data)
+{
+  CCLBandType* pBand = (CCLBandType*)data;
+  pBand->pCCL->labelRows(pBand->row0, pBand->row1);
+  return NULL;
+}
+
+void* cclFlattenThread(void* data)
+{
+  CCLBandType* pBand = (CCLBandType*)data;
+  pBand->pCCL->flattenRows(pBand->row0, pBand->row1);
+  return NULL;
+}
+
+CCL::CCL()
+{
+  pImage        = NULL;
+  pParent       = NULL;
+  pLabels       = NULL;
+  width         = 0;
+  height        = 0;
+  threshold     = RGS_CCL_THRESHOLD;
+  numThreads    = 1;
+  numComponents = 0;
+}
+
+CCL::~CCL()
+{
+  if(pParent)
+    delete [] pParent;
+  if(pLabels)
+    delete [] pLabels;
+}
+
+int CCL::init(const cl_uchar4* pImageData,
+              cl_uint          imageWidth,
+              cl_uint          imageHeight,
+              cl_int           lumaThreshold,
+              cl_int           threads)
+{
+  pImage     = pImageData;
+  width      = imageWidth;
+  height     = imageHeight;
+  threshold  = lumaThreshold;
+
+  /* no more threads than rows */
+  numThreads = threads;
+  if(numThreads > (cl_int)height)
+    numThreads = (cl_int)height;
+  if(numThreads < 1)
+    numThreads = 1;
+
+  if(pParent)
+    delete [] pParent;
+  if(pLabels)
+    delete [] pLabels;
+
+  pParent = new cl_int[width*height];
+  pLabels = new cl_uint[width*height];
+
+  return SDK_SUCCESS;
+}
+
+cl_int CCL::find(cl_int x)
+{
+  while(pParent[x] != x)
+    {
+      pParent[x] = pParent[pParent[x]];
+      x          = pParent[x];
+    }
+  return x;
+}
+
+cl_int CCL::findRoot(cl_int x) const
+{
+  while(pParent[x] != x)
+    x = pParent[x];
+  return x;
+}
+
+void CCL::unite(cl_int a, cl_int b)
+{
+  a = find(a);
+  b = find(b);
+
+  if(a < b)
+    pParent[b] = a;
+  else if(b < a)
+    pParent[a] = b;
+}
+
+bool CCL::connected(cl_uint i, cl_uint ni) const
+{
+  cl_int diff = (cl_int)pImage[i].x - (cl_int)pImage[ni].x;
+  return FABS(diff) <= threshold;
+}
+
+void CCL::labelRows(cl_uint row0, cl_uint row1)
+{
+  /* neighbors preceding a pixel in raster order: left, up-left, up, up-right */
+  int neighX[] = {-1,-1, 0, 1};
+  int neighY[] = { 0,-1,-1,-1};
+
+  for(cl_uint r = row0; r < row1; ++r)
+    {
+      for(cl_uint c = 0; c < width; ++c)
+        {
+          cl_uint i  = TWOD_TO_ONED(c,r,width);
+          pParent[i] = i;
+
+          for(int n = 0; n < 4; ++n)
+            {
+              cl_int nc = (cl_int)c + neighX[n];
+              cl_int nr = (cl_int)r + neighY[n];
+
+              if((nc < 0) || (nc >= (cl_int)width) || (nr < (cl_int)row0))
+                continue;
+
+              cl_uint ni = TWOD_TO_ONED(nc,nr,width);
+              if(connected(i, ni))
+                unite(i, ni);
+            }
+        }
+    }
+}
+
+void CCL::joinSeam(cl_uint row)
+{
+  for(cl_uint c = 0; c < width; ++c)
+    {
+      cl_uint i = TWOD_TO_ONED(c,row,width);
+
+      for(cl_int dc = -1; dc <= 1; ++dc)
+        {
+          cl_int nc = (cl_int)c + dc;
+          if((nc < 0) || (nc >= (cl_int)width))
+            continue;
+
+          cl_uint ni = TWOD_TO_ONED(nc,row - 1,width);
+          if(connected(i, ni))
+            unite(i, ni);
+        }
+    }
+}
+
+void CCL::flattenRows(cl_uint row0, cl_uint row1)
+{
+  /* parents are only read here, so the bands can overlap in their walks */
+  for(cl_uint i = row0*width; i < row1*width; ++i)
+    pLabels[i] = findRoot(i);
+}
+
+void CCL::numberComponents()
+{
+  /* a root comes first in its component, it is numbered before its pixels */
+  numComponents = 0;
+  for(cl_uint i = 0; i < width*height; ++i)
+    {
+      if(pLabels[i] == i)
+        pParent[i] = numComponents++;
+
+      pLabels[i] = pParent[pLabels[i]];
+    }
+}
+
+void CCL::runBands(void* (*fun)(void*), CCLBandType* pBands)
+{
+  SDKThread* pWorkers = new SDKThread[numThreads - 1];
+
+  for(cl_int t = 0; t < numThreads - 1; ++t)
+    pWorkers[t].create(fun, (void*)(pBands + t));
+
+  fun(pBands + numThreads - 1);
+
+  for(cl_int t = 0; t < numThreads - 1; ++t)
+    pWorkers[t].join();
+
+  delete [] pWorkers;
+}
+
+int CCL::label()
+{
+  CCLBandType* pBands = new CCLBandType[numThreads];
+
+  for(cl_int t = 0; t < numThreads; ++t)
+    {
+      pBands[t].pCCL = this;
+      pBands[t].row0 = (cl_uint)(((cl_ulong)height*t)/numThreads);
+      pBands[t].row1 = (cl_uint)(((cl_ulong)height*(t + 1))/numThreads);
+    }
+
+  /* union-find within the bands, then the seams between them */
+  runBands(cclLabelThread, pBands);
+
+  for(cl_int t = 1; t < numThreads; ++t)
+    joinSeam(pBands[t].row0);
+
+  runBands(cclFlattenThread, pBands);
+
+  numberComponents();
+
+  delete [] pBands;
+
+  return SDK_SUCCESS;
+}
+
+#endif
@@ -12,6 +12,12 @@
 #define  RGS_LOCAL_THREADS          64
 #define  RGS_LOCAL_THREADS_2D       4
 
+/* union-find connected component labeling */
+#define  RGS_CCL_TILE               16      /* tile side, one work-group per tile */
+#define  RGS_CCL_LOCAL_THREADS      256
+#define  RGS_CCL_THRESHOLD          8       /* max luma difference of connected neighbors */
+#define  RGS_CCL_MAX_LABELS16       65536
+
 
 /* macros */
 #define  FABS(x)                    (((x) > 0.0) ? (x):-(x))
@@ -24,11 +24,18 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************************************/
 #include "RegionGrowingCPU.hpp"
 #include "RegionGrowingSegmentation.hpp"
+#include <thread>
 
 #ifdef _MSC_VER
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+static int numCPUCores()
+{
+  int cores = (int)std::thread::hardware_concurrency();
+  return cores > 0 ? cores : 1;
+}
+
 int RegionGrowingSegmentation::initialize()
 {
     // Call base class Initialize to get default configuration
@@ -48,6 +55,38 @@ int RegionGrowingSegmentation::initialize()
 
     sampleArgs->AddOption(addtionalOptions);
 
+    addtionalOptions->_sVersion    = "";
+    addtionalOptions->_lVersion    = "ccl";
+    addtionalOptions->_value       = &runCCL;
+    addtionalOptions->_description = "Also label the connected components of the image with union-find";
+    addtionalOptions->_type        = CA_NO_ARGUMENT;
+
+    sampleArgs->AddOption(addtionalOptions);
+
+    addtionalOptions->_sVersion    = "";
+    addtionalOptions->_lVersion    = "threshold";
+    addtionalOptions->_value       = &cclThreshold;
+    addtionalOptions->_description = "Largest luma difference of connected neighbors (--ccl)";
+    addtionalOptions->_type        = CA_ARG_INT;
+
+    sampleArgs->AddOption(addtionalOptions);
+
+    addtionalOptions->_sVersion    = "";
+    addtionalOptions->_lVersion    = "label16";
+    addtionalOptions->_value       = &label16;
+    addtionalOptions->_description = "16-bit component labels when there are few enough components (--ccl)";
+    addtionalOptions->_type        = CA_NO_ARGUMENT;
+
+    sampleArgs->AddOption(addtionalOptions);
+
+    addtionalOptions->_sVersion    = "";
+    addtionalOptions->_lVersion    = "cpuThreads";
+    addtionalOptions->_value       = &cpuThreads;
+    addtionalOptions->_description = "Threads of the host labeling (default: all cores)";
+    addtionalOptions->_type        = CA_ARG_INT;
+
+    sampleArgs->AddOption(addtionalOptions);
+
     delete addtionalOptions;
 
     return SDK_SUCCESS;
@@ -306,6 +345,75 @@ int RegionGrowingSegmentation::setupCL()
   growRegionKernel = clCreateKernel(program, "grow_region", &status);
   CHECK_OPENCL_ERROR(status, "clCreateKernel failed (grow_region).");
   
+  if(runCCL)
+    {
+      if(deviceInfo.maxWorkGroupSize < RGS_CCL_LOCAL_THREADS)
+        {
+          OPENCL_EXPECTED_ERROR("Unsupported device! Labeling needs work-groups of RGS_CCL_LOCAL_THREADS.");
+        }
+
+      cl_uint pixels = width*height;
+      cclGroups      = (pixels + RGS_CCL_LOCAL_THREADS - 1)/RGS_CCL_LOCAL_THREADS;
+
+      /* parent of every pixel, later its root */
+      oclCCLParents = clCreateBuffer(context,
+                                     CL_MEM_READ_WRITE,
+                                     pixels*sizeof(cl_int),
+                                     NULL,
+                                     &status);
+      CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (oclCCLParents)");
+
+      /* roots per work-group, then first label per work-group and the total */
+      oclCCLGroupRoots = clCreateBuffer(context,
+                                        CL_MEM_READ_WRITE,
+                                        (cclGroups + 1)*sizeof(cl_uint),
+                                        NULL,
+                                        &status);
+      CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (oclCCLGroupRoots)");
+
+      oclCCLRootIds = clCreateBuffer(context,
+                                     CL_MEM_READ_WRITE,
+                                     pixels*sizeof(cl_uint),
+                                     NULL,
+                                     &status);
+      CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (oclCCLRootIds)");
+
+      /* large enough for 32-bit labels */
+      oclCCLLabels = clCreateBuffer(context,
+                                    CL_MEM_WRITE_ONLY,
+                                    pixels*sizeof(cl_uint),
+                                    NULL,
+                                    &status);
+      CHECK_OPENCL_ERROR(status, "clCreateBuffer failed. (oclCCLLabels)");
+
+      pCCLLabels = malloc(pixels*sizeof(cl_uint));
+      CHECK_ALLOCATION(pCCLLabels, "Failed to allocate memory! (pCCLLabels)");
+
+      cclTileKernel = clCreateKernel(program, "ccl_tile_label", &status);
+      CHECK_OPENCL_ERROR(status, "clCreateKernel failed (ccl_tile_label).");
+
+      cclMergeKernel = clCreateKernel(program, "ccl_merge_tiles", &status);
+      CHECK_OPENCL_ERROR(status, "clCreateKernel failed (ccl_merge_tiles).");
+
+      cclFlattenKernel = clCreateKernel(program, "ccl_flatten", &status);
+      CHECK_OPENCL_ERROR(status, "clCreateKernel failed (ccl_flatten).");
+
+      cclCountKernel = clCreateKernel(program, "ccl_count_roots", &status);
+      CHECK_OPENCL_ERROR(status, "clCreateKernel failed (ccl_count_roots).");
+
+      cclScanKernel = clCreateKernel(program, "ccl_scan_roots", &status);
+      CHECK_OPENCL_ERROR(status, "clCreateKernel failed (ccl_scan_roots).");
+
+      cclCompactKernel = clCreateKernel(program, "ccl_compact_roots", &status);
+      CHECK_OPENCL_ERROR(status, "clCreateKernel failed (ccl_compact_roots).");
+
+      cclWrite16Kernel = clCreateKernel(program, "ccl_write_labels16", &status);
+      CHECK_OPENCL_ERROR(status, "clCreateKernel failed (ccl_write_labels16).");
+
+      cclWrite32Kernel = clCreateKernel(program, "ccl_write_labels32", &status);
+      CHECK_OPENCL_ERROR(status, "clCreateKernel failed (ccl_write_labels32).");
+    }
+
   /* create additional kernels if host side iteration is enabled */
   if(hostQ)
     {
@@ -501,6 +609,12 @@ int RegionGrowingSegmentation::setup()
       return SDK_FAILURE;
     }
   
+  if(runCCL && (cclThreshold < 0))
+    {
+      std::cout << "Error: --threshold must not be negative." << std::endl;
+      return SDK_FAILURE;
+    }
+
   /* Set up OpenCL  and sample related environment. */
   int status = setupCL();
   if (status != SDK_SUCCESS)
@@ -643,6 +757,171 @@ int RegionGrowingSegmentation::runCLKernels()
   return SDK_SUCCESS;
 }
 
+int RegionGrowingSegmentation::runCCLKernels()
+{
+  cl_int   status;
+  cl_uint  pixels    = width*height;
+  cl_uint  threshold = (cl_uint)cclThreshold;
+
+  /* tiles for the 2-D kernels, pixels for the 1-D ones */
+  size_t   localThreads2D[]  = {RGS_CCL_TILE, RGS_CCL_TILE};
+  size_t   globalThreads2D[] = {((width + RGS_CCL_TILE - 1)/RGS_CCL_TILE)*RGS_CCL_TILE,
+                                ((height + RGS_CCL_TILE - 1)/RGS_CCL_TILE)*RGS_CCL_TILE};
+  size_t   localThreads[]    = {RGS_CCL_LOCAL_THREADS};
+  size_t   globalThreads[]   = {cclGroups*RGS_CCL_LOCAL_THREADS};
+
+  cl_kernel imageKernels[] = {cclTileKernel, cclMergeKernel};
+  for(int k = 0; k < 2; ++k)
+    {
+      status  = clSetKernelArg(imageKernels[k], 0, sizeof(cl_mem), &oclImageBuf);
+      status |= clSetKernelArg(imageKernels[k], 1, sizeof(cl_mem), &oclCCLParents);
+      status |= clSetKernelArg(imageKernels[k], 2, sizeof(cl_uint), &width);
+      status |= clSetKernelArg(imageKernels[k], 3, sizeof(cl_uint), &height);
+      status |= clSetKernelArg(imageKernels[k], 4, sizeof(cl_uint), &threshold);
+      CHECK_OPENCL_ERROR(status, "clSetKernelArg failed (ccl_tile_label/ccl_merge_tiles).");
+
+      status = clEnqueueNDRangeKernel(commandQueue,
+                                      imageKernels[k],
+                                      2,
+                                      NULL,
+                                      globalThreads2D,
+                                      localThreads2D,
+                                      0,
+                                      NULL,
+                                      NULL);
+      CHECK_OPENCL_ERROR(status,
+                         "clEnqueueNDRangeKernel failed (ccl_tile_label/ccl_merge_tiles).");
+    }
+
+  status  = clSetKernelArg(cclFlattenKernel, 0, sizeof(cl_mem), &oclCCLParents);
+  status |= clSetKernelArg(cclFlattenKernel, 1, sizeof(cl_uint), &pixels);
+  CHECK_OPENCL_ERROR(status, "clSetKernelArg failed (ccl_flatten).");
+
+  status = clEnqueueNDRangeKernel(commandQueue,
+                                  cclFlattenKernel,
+                                  1,
+                                  NULL,
+                                  globalThreads,
+                                  localThreads,
+                                  0,
+                                  NULL,
+                                  NULL);
+  CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed (ccl_flatten).");
+
+  /* number the roots in raster order */
+  status  = clSetKernelArg(cclCountKernel, 0, sizeof(cl_mem), &oclCCLParents);
+  status |= clSetKernelArg(cclCountKernel, 1, sizeof(cl_uint), &pixels);
+  status |= clSetKernelArg(cclCountKernel, 2, sizeof(cl_mem), &oclCCLGroupRoots);
+  CHECK_OPENCL_ERROR(status, "clSetKernelArg failed (ccl_count_roots).");
+
+  status = clEnqueueNDRangeKernel(commandQueue,
+                                  cclCountKernel,
+                                  1,
+                                  NULL,
+                                  globalThreads,
+                                  localThreads,
+                                  0,
+                                  NULL,
+                                  NULL);
+  CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed (ccl_count_roots).");
+
+  status  = clSetKernelArg(cclScanKernel, 0, sizeof(cl_mem), &oclCCLGroupRoots);
+  status |= clSetKernelArg(cclScanKernel, 1, sizeof(cl_uint), &cclGroups);
+  CHECK_OPENCL_ERROR(status, "clSetKernelArg failed (ccl_scan_roots).");
+
+  status = clEnqueueNDRangeKernel(commandQueue,
+                                  cclScanKernel,
+                                  1,
+                                  NULL,
+                                  localThreads,
+                                  localThreads,
+                                  0,
+                                  NULL,
+                                  NULL);
+  CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed (ccl_scan_roots).");
+
+  status  = clSetKernelArg(cclCompactKernel, 0, sizeof(cl_mem), &oclCCLParents);
+  status |= clSetKernelArg(cclCompactKernel, 1, sizeof(cl_uint), &pixels);
+  status |= clSetKernelArg(cclCompactKernel, 2, sizeof(cl_mem), &oclCCLGroupRoots);
+  status |= clSetKernelArg(cclCompactKernel, 3, sizeof(cl_mem), &oclCCLRootIds);
+  CHECK_OPENCL_ERROR(status, "clSetKernelArg failed (ccl_compact_roots).");
+
+  status = clEnqueueNDRangeKernel(commandQueue,
+                                  cclCompactKernel,
+                                  1,
+                                  NULL,
+                                  globalThreads,
+                                  localThreads,
+                                  0,
+                                  NULL,
+                                  NULL);
+  CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed (ccl_compact_roots).");
+
+  /* the number of components decides the label width */
+  status = clEnqueueReadBuffer(commandQueue,
+                               oclCCLGroupRoots,
+                               CL_TRUE,
+                               cclGroups*sizeof(cl_uint),
+                               sizeof(cl_uint),
+                               (void *)(&cclComponents),
+                               0,
+                               NULL,
+                               NULL);
+  CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed. (oclCCLGroupRoots)");
+
+  cclLabels16 = label16 && (cclComponents <= RGS_CCL_MAX_LABELS16);
+  if(label16 && !cclLabels16 && !sampleArgs->quiet)
+    {
+      std::cout << cclComponents << " components do not fit 16-bit labels, "
+                << "writing 32-bit labels" << std::endl;
+    }
+
+  cl_kernel writeKernel = cclLabels16 ? cclWrite16Kernel : cclWrite32Kernel;
+
+  status  = clSetKernelArg(writeKernel, 0, sizeof(cl_mem), &oclCCLParents);
+  status |= clSetKernelArg(writeKernel, 1, sizeof(cl_uint), &pixels);
+  status |= clSetKernelArg(writeKernel, 2, sizeof(cl_mem), &oclCCLRootIds);
+  status |= clSetKernelArg(writeKernel, 3, sizeof(cl_mem), &oclCCLLabels);
+  CHECK_OPENCL_ERROR(status, "clSetKernelArg failed (ccl_write_labels).");
+
+  status = clEnqueueNDRangeKernel(commandQueue,
+                                  writeKernel,
+                                  1,
+                                  NULL,
+                                  globalThreads,
+                                  localThreads,
+                                  0,
+                                  NULL,
+                                  NULL);
+  CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed (ccl_write_labels).");
+
+  status = clEnqueueReadBuffer(commandQueue,
+                               oclCCLLabels,
+                               CL_TRUE,
+                               0,
+                               pixels*(cclLabels16 ? sizeof(cl_ushort) : sizeof(cl_uint)),
+                               pCCLLabels,
+                               0,
+                               NULL,
+                               NULL);
+  CHECK_OPENCL_ERROR(status, "clEnqueueReadBuffer failed. (oclCCLLabels)");
+
+  cclLaunches = 7;
+
+  return SDK_SUCCESS;
+}
+
+int RegionGrowingSegmentation::runCCLRef()
+{
+  if(cpuThreads <= 0)
+    {
+      cpuThreads = numCPUCores();
+    }
+
+  cpuCCL.init(pOclImageData, width, height, cclThreshold, cpuThreads);
+  return cpuCCL.label();
+}
+
 int RegionGrowingSegmentation::run()
 {
   if(!sampleArgs->quiet)
@@ -677,6 +956,32 @@ int RegionGrowingSegmentation::run()
       return SDK_FAILURE;
     }
 
+  /* labeling reads the YVU luma, before post processing changes it */
+  if(runCCL)
+    {
+      sampleTimer->resetTimer(timer);
+      sampleTimer->startTimer(timer);
+
+      if(runCCLKernels() != SDK_SUCCESS)
+        {
+          return SDK_FAILURE;
+        }
+
+      sampleTimer->stopTimer(timer);
+      cclKernelTime = (double)(sampleTimer->readTimer(timer));
+
+      sampleTimer->resetTimer(timer);
+      sampleTimer->startTimer(timer);
+
+      if(runCCLRef() != SDK_SUCCESS)
+        {
+          return SDK_FAILURE;
+        }
+
+      sampleTimer->stopTimer(timer);
+      cclHostTime = (double)(sampleTimer->readTimer(timer));
+    }
+
   /* post processing, that is YUV to RGB conversion */
   if (postProcess() != SDK_SUCCESS)
     {
@@ -705,6 +1010,25 @@ void RegionGrowingSegmentation::printStats()
 
         printStatistics(strArray, stats, 4);
 
+        if(runCCL)
+          {
+            std::string cclStrArray[6] = {"Components",
+                                          "Label Bits",
+                                          "Labeling Launches",
+                                          "Labeling Time (sec)",
+                                          "Host Labeling Time (sec)",
+                                          "Host Threads"};
+            std::string cclStats[6];
+
+            cclStats[0] = toString(cclComponents, std::dec);
+            cclStats[1] = toString(cclLabels16 ? 16 : 32, std::dec);
+            cclStats[2] = toString(cclLaunches, std::dec);
+            cclStats[3] = toString(cclKernelTime, std::dec);
+            cclStats[4] = toString(cclHostTime, std::dec);
+            cclStats[5] = toString(cpuCCL.numThreads, std::dec);
+
+            printStatistics(cclStrArray, cclStats, 6);
+          }
     }
 }
 
@@ -728,6 +1052,25 @@ int RegionGrowingSegmentation::cleanup()
 	CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.");
       }
 
+    if(runCCL)
+      {
+        cl_kernel cclKernels[] = {cclTileKernel, cclMergeKernel, cclFlattenKernel,
+                                  cclCountKernel, cclScanKernel, cclCompactKernel,
+                                  cclWrite16Kernel, cclWrite32Kernel};
+        for(int k = 0; k < 8; ++k)
+          {
+            status = clReleaseKernel(cclKernels[k]);
+            CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.");
+          }
+
+        cl_mem cclBuffers[] = {oclCCLParents, oclCCLGroupRoots, oclCCLRootIds, oclCCLLabels};
+        for(int b = 0; b < 4; ++b)
+          {
+            status = clReleaseMemObject(cclBuffers[b]);
+            CHECK_OPENCL_ERROR(status, "clReleaseMemObject failed.");
+          }
+      }
+
     status = clReleaseProgram(program);
     CHECK_OPENCL_ERROR(status, "clReleaseProgram failed.");
 
@@ -755,6 +1098,7 @@ int RegionGrowingSegmentation::cleanup()
     FREE(pVerImageData);
     FREE(pQueuedPixels);
     FREE(pParams);
+    FREE(pCCLLabels);
 
     return SDK_SUCCESS;
 }
@@ -789,10 +1133,77 @@ int RegionGrowingSegmentation::verifyResults()
           std::cout << "\nPassed!\n";
         else
           std::cout << "\nFailed!\n";
+
+        if(runCCL)
+          {
+            if (writeLabelImage(CCL_OUTPUT_IMAGE) != SDK_SUCCESS)
+              {
+                std::cout << "writing image output failed." << std::endl;
+                return SDK_FAILURE;
+              }
+
+            /* labels have to match the host's exactly */
+            if (compareLabels() == SDK_SUCCESS)
+              std::cout << "\nPassed! (labeling)\n";
+            else
+              std::cout << "\nFailed! (labeling)\n";
+          }
       }
     return SDK_SUCCESS;
 }
 
+int RegionGrowingSegmentation::compareLabels()
+{
+  cl_uint count = 0;
+
+  if(cclComponents != cpuCCL.numComponents)
+    {
+      std::cout << "Components: device " << cclComponents;
+      std::cout << ", host " << cpuCCL.numComponents << std::endl;
+      return SDK_FAILURE;
+    }
+
+  for(cl_uint i = 0; i < width*height; ++i)
+    {
+      cl_uint label = cclLabels16 ? ((cl_ushort*)pCCLLabels)[i]
+                                  : ((cl_uint*)pCCLLabels)[i];
+      if(label != cpuCCL.pLabels[i])
+        count++;
+    }
+
+  if(count)
+    {
+      std::cout << "No of mismatching labels " << count << std::endl;
+      return SDK_FAILURE;
+    }
+
+  return SDK_SUCCESS;
+}
+
+int RegionGrowingSegmentation::writeLabelImage(std::string outputImageName)
+{
+  cl_uchar4* pImage = (cl_uchar4*)malloc(width * height * pixelSize);
+  CHECK_ALLOCATION(pImage, "Failed to allocate memory! (pImage)");
+
+  /* neighboring components get far apart gray levels */
+  for(cl_uint i = 0; i < width*height; ++i)
+    {
+      cl_uint label = cclLabels16 ? ((cl_ushort*)pCCLLabels)[i]
+                                  : ((cl_uint*)pCCLLabels)[i];
+      cl_uchar gray = (cl_uchar)(32 + (label*97)%224);
+
+      pImage[i].x = gray;
+      pImage[i].y = gray;
+      pImage[i].z = gray;
+      pImage[i].w = 255;
+    }
+
+  int status = writeOutputImage(outputImageName, pImage);
+  free(pImage);
+
+  return status;
+}
+
 int RegionGrowingSegmentation::compareImages()
 {
   int i;
@@ -28,6 +28,7 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "CLUtil.hpp"
 #include "SDKBitMap.hpp"
 #include "RegionGrowingConst.hpp"
+#include "RegionGrowingCCL.hpp"
 
 using namespace appsdk;
 
@@ -35,6 +36,7 @@ using namespace appsdk;
 #define OCL_OUTPUT_IMAGE "RegionGrowing_ocl_output.bmp"
 #define VER_OUTPUT_IMAGE "RegionGrowing_ver_output.bmp"
 #define SEED_FILE        "RegionGrowing_seeds.txt"
+#define CCL_OUTPUT_IMAGE "RegionGrowing_ccl_output.bmp"
 
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.2"
 
@@ -80,6 +82,37 @@ class RegionGrowingSegmentation
   
   /* cpu reference code class */
   RGS                 cpuRgs;
+
+  /* union-find connected component labeling */
+  bool                runCCL;
+  bool                label16;
+  cl_int              cclThreshold;
+  cl_int              cpuThreads;
+
+  cl_kernel           cclTileKernel;
+  cl_kernel           cclMergeKernel;
+  cl_kernel           cclFlattenKernel;
+  cl_kernel           cclCountKernel;
+  cl_kernel           cclScanKernel;
+  cl_kernel           cclCompactKernel;
+  cl_kernel           cclWrite16Kernel;
+  cl_kernel           cclWrite32Kernel;
+
+  cl_mem              oclCCLParents;
+  cl_mem              oclCCLGroupRoots;
+  cl_mem              oclCCLRootIds;
+  cl_mem              oclCCLLabels;
+
+  cl_uint             cclGroups;        /* work-groups of the 1-D ccl kernels */
+  cl_uint             cclComponents;
+  cl_uint             cclLaunches;
+  bool                cclLabels16;      /* labels of the last run are 16-bit */
+  void*               pCCLLabels;
+  double              cclKernelTime;
+  double              cclHostTime;
+
+  /* multithreaded labeling reference */
+  CCL                 cpuCCL;
 public:
   
   CLCommandArgs*      sampleArgs;
@@ -91,6 +124,17 @@ public:
     sampleArgs->sampleVerStr = SAMPLE_VERSION;
     pixelSize   = sizeof(cl_uchar4);
     hostQ       = false;
+
+    runCCL        = false;
+    label16       = false;
+    cclThreshold  = RGS_CCL_THRESHOLD;
+    cpuThreads    = 0;
+    cclComponents = 0;
+    cclLaunches   = 0;
+    cclLabels16   = false;
+    pCCLLabels    = NULL;
+    cclKernelTime = 0;
+    cclHostTime   = 0;
   }
   
   /**
@@ -120,6 +164,31 @@ public:
    * @return SDK_SUCCESS on success and SDK_FAILURE on failure
    */
   int runRef();
+
+  /**
+   * Connected component labeling of the input luma with the ccl_* kernels,
+   * labels are read back to pCCLLabels.
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+   */
+  int runCCLKernels();
+
+  /**
+   * Multithreaded host labeling for verification
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+   */
+  int runCCLRef();
+
+  /*
+   * Compares device side and host labels.
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure.
+   */
+  int compareLabels();
+
+  /*
+   * Writes the device side labels, one gray level per component.
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure.
+   */
+  int writeLabelImage(std::string outputImageName);
   
   /**
    * Override from SDKSample. Print sample stats.
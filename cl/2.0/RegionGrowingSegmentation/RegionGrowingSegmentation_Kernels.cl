@@ -591,4 +591,303 @@ __kernel void init_kernel(__global uchar4*         pImage,
 
 }
 
+/*
+ * union-find connected component labeling.
+ *
+ * two 8-neighbors belong to the same component when their lumas differ by
+ * at most 'threshold'. every pixel holds the index of its parent in
+ * pLabels; unions always hook the larger root below the smaller one, so
+ * the root of a component is its first pixel in raster order, whatever
+ * order the unions run in.
+ *
+ * ccl_tile_label  -> union-find within a tile in local memory
+ * ccl_merge_tiles -> unions across the tile borders
+ * ccl_flatten     -> every pixel points to its root
+ * ccl_count_roots -> ccl_scan_roots -> ccl_compact_roots -> ccl_write_labels
+ *                 -> roots numbered 0, 1, ... in raster order
+ *
+ * the number of launches does not depend on the image or its regions.
+ */
+
+/* neighbors preceding a pixel in raster order: left, up-left, up, up-right */
+__constant int cclNx[4] = {-1,-1, 0, 1};
+__constant int cclNy[4] = { 0,-1,-1,-1};
+
+int ccl_find_local(volatile __local atomic_int* pParent, int x)
+{
+  int p = atomic_load_explicit(&pParent[x], memory_order_relaxed);
+  while(p != x)
+    {
+      x = p;
+      p = atomic_load_explicit(&pParent[x], memory_order_relaxed);
+    }
+  return x;
+}
+
+int ccl_find(volatile __global atomic_int* pParent, int x)
+{
+  int p = atomic_load_explicit(&pParent[x], memory_order_relaxed);
+  while(p != x)
+    {
+      x = p;
+      p = atomic_load_explicit(&pParent[x], memory_order_relaxed);
+    }
+  return x;
+}
+
+/*
+ * ccl_union_local, ccl_union:
+ * join the trees of a and b. atomic_fetch_min hooks the larger root; when
+ * it was no longer a root, another union got there first and the walk
+ * starts again from what it was hooked to.
+ */
+void ccl_union_local(volatile __local atomic_int* pParent, int a, int b)
+{
+  bool done = false;
+  while(!done)
+    {
+      a = ccl_find_local(pParent, a);
+      b = ccl_find_local(pParent, b);
+
+      if(a < b)
+        {
+          int old = atomic_fetch_min(&pParent[b], a);
+          done    = (old == b);
+          b       = old;
+        }
+      else if(b < a)
+        {
+          int old = atomic_fetch_min(&pParent[a], b);
+          done    = (old == a);
+          a       = old;
+        }
+      else
+        done = true;
+    }
+}
 
+void ccl_union(volatile __global atomic_int* pParent, int a, int b)
+{
+  bool done = false;
+  while(!done)
+    {
+      a = ccl_find(pParent, a);
+      b = ccl_find(pParent, b);
+
+      if(a < b)
+        {
+          int old = atomic_fetch_min(&pParent[b], a);
+          done    = (old == b);
+          b       = old;
+        }
+      else if(b < a)
+        {
+          int old = atomic_fetch_min(&pParent[a], b);
+          done    = (old == a);
+          a       = old;
+        }
+      else
+        done = true;
+    }
+}
+
+/*
+ * ccl_tile_label:
+ * one RGS_CCL_TILE x RGS_CCL_TILE work-group per tile. the tile's pixels
+ * are joined in local memory, then every pixel gets the global index of
+ * its tile-local root as parent.
+ */
+__kernel void ccl_tile_label(__global uchar4*   pImage,
+                             __global int*      pLabels,
+                             uint               width,
+                             uint               height,
+                             uint               threshold)
+{
+  __local atomic_int lParent[RGS_CCL_TILE*RGS_CCL_TILE];
+  __local int        lLuma[RGS_CCL_TILE*RGS_CCL_TILE];
+
+  int  x      = get_global_id(0);
+  int  y      = get_global_id(1);
+  int  lx     = get_local_id(0);
+  int  ly     = get_local_id(1);
+  int  li     = ly*RGS_CCL_TILE + lx;
+  bool inside = (x < (int)width) && (y < (int)height);
+
+  lLuma[li] = inside ? (int)(pImage[TWOD_TO_ONED(x,y,width)].x) : 0;
+  atomic_init(&lParent[li], li);
+  work_group_barrier(CLK_LOCAL_MEM_FENCE);
+
+  if(inside)
+    {
+      for(int n = 0; n < 4; ++n)
+        {
+          int nlx = lx + cclNx[n];
+          int nly = ly + cclNy[n];
+
+          if((nlx < 0) || (nlx >= RGS_CCL_TILE) || (nly < 0) ||
+             (x + cclNx[n] >= (int)width))
+            continue;
+
+          int ni = nly*RGS_CCL_TILE + nlx;
+          if(abs(lLuma[li] - lLuma[ni]) <= threshold)
+            ccl_union_local(lParent, li, ni);
+        }
+    }
+  work_group_barrier(CLK_LOCAL_MEM_FENCE);
+
+  if(inside)
+    {
+      int root = ccl_find_local(lParent, li);
+      int rx   = x - lx + root%RGS_CCL_TILE;
+      int ry   = y - ly + root/RGS_CCL_TILE;
+
+      pLabels[TWOD_TO_ONED(x,y,width)] = TWOD_TO_ONED(rx,ry,width);
+    }
+}
+
+/*
+ * ccl_merge_tiles:
+ * joins every pixel with its connected neighbors in other tiles. only the
+ * pixels on a tile's border have such neighbors.
+ */
+__kernel void ccl_merge_tiles(__global uchar4*   pImage,
+                              __global int*      pLabels,
+                              uint               width,
+                              uint               height,
+                              uint               threshold)
+{
+  int x = get_global_id(0);
+  int y = get_global_id(1);
+
+  if((x >= (int)width) || (y >= (int)height))
+    return;
+
+  int lx = x%RGS_CCL_TILE;
+  int ly = y%RGS_CCL_TILE;
+  if((lx != 0) && (ly != 0) && (lx != RGS_CCL_TILE - 1))
+    return;
+
+  int i    = TWOD_TO_ONED(x,y,width);
+  int luma = pImage[i].x;
+
+  for(int n = 0; n < 4; ++n)
+    {
+      int nx = x + cclNx[n];
+      int ny = y + cclNy[n];
+
+      if((nx < 0) || (ny < 0) || (nx >= (int)width))
+        continue;
+
+      /* same tile: joined by ccl_tile_label */
+      if((nx/RGS_CCL_TILE == x/RGS_CCL_TILE) && (ny/RGS_CCL_TILE == y/RGS_CCL_TILE))
+        continue;
+
+      int ni = TWOD_TO_ONED(nx,ny,width);
+      if(abs(luma - (int)(pImage[ni].x)) <= threshold)
+        ccl_union((volatile __global atomic_int*)pLabels, i, ni);
+    }
+}
+
+/*
+ * ccl_flatten:
+ * points every pixel at its root. a pixel only ever moves up its own
+ * tree, so the other work-items' walks stay valid.
+ */
+__kernel void ccl_flatten(__global int*   pLabels,
+                          uint            n)
+{
+  int i = get_global_id(0);
+
+  if(i < (int)n)
+    {
+      volatile __global atomic_int* pParent = (volatile __global atomic_int*)pLabels;
+      atomic_store_explicit(&pParent[i], ccl_find(pParent, i), memory_order_relaxed);
+    }
+}
+
+/*
+ * ccl_count_roots:
+ * roots found by each work-group.
+ */
+__kernel void ccl_count_roots(__global int*   pLabels,
+                              uint            n,
+                              __global uint*  pGroupRoots)
+{
+  int  i    = get_global_id(0);
+  uint root = ((i < (int)n) && (pLabels[i] == i)) ? 1 : 0;
+  uint sum  = work_group_reduce_add(root);
+
+  if(get_local_id(0) == 0)
+    pGroupRoots[get_group_id(0)] = sum;
+}
+
+/*
+ * ccl_scan_roots:
+ * a single work-group turns the counts into the first label of every
+ * work-group and stores the number of components after them.
+ */
+__kernel void ccl_scan_roots(__global uint*   pGroupRoots,
+                             uint             groups)
+{
+  uint lid   = get_local_id(0);
+  uint szgr  = get_local_size(0);
+  uint carry = 0;
+
+  for(uint base = 0; base < groups; base += szgr)
+    {
+      uint g     = base + lid;
+      uint count = (g < groups) ? pGroupRoots[g] : 0;
+      uint first = work_group_scan_exclusive_add(count);
+      uint total = work_group_reduce_add(count);
+
+      if(g < groups)
+        pGroupRoots[g] = carry + first;
+      carry += total;
+    }
+
+  if(lid == 0)
+    pGroupRoots[groups] = carry;
+}
+
+/*
+ * ccl_compact_roots:
+ * label of every root: the roots before it in raster order.
+ */
+__kernel void ccl_compact_roots(__global int*    pLabels,
+                                uint             n,
+                                __global uint*   pGroupRoots,
+                                __global uint*   pRootIds)
+{
+  int  i     = get_global_id(0);
+  uint root  = ((i < (int)n) && (pLabels[i] == i)) ? 1 : 0;
+  uint index = pGroupRoots[get_group_id(0)] + work_group_scan_exclusive_add(root);
+
+  if(root)
+    pRootIds[i] = index;
+}
+
+/*
+ * ccl_write_labels16, ccl_write_labels32:
+ * final label of every pixel, the label of its root.
+ */
+__kernel void ccl_write_labels16(__global int*      pLabels,
+                                 uint               n,
+                                 __global uint*     pRootIds,
+                                 __global ushort*   pOut)
+{
+  int i = get_global_id(0);
+
+  if(i < (int)n)
+    pOut[i] = (ushort)(pRootIds[pLabels[i]]);
+}
+
+__kernel void ccl_write_labels32(__global int*      pLabels,
+                                 uint               n,
+                                 __global uint*     pRootIds,
+                                 __global uint*     pOut)
+{
+  int i = get_global_id(0);
+
+  if(i < (int)n)
+    pOut[i] = pRootIds[pLabels[i]];
+}
@@ -17,9 +17,14 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #include "SVMAtomicsBinaryTreeInsert.hpp"
 #include "SVMAtomicsBinaryTreeInsert_Host.hpp"
+#include <algorithm>
+#include <vector>
 
 SVMAtomicsBinaryTreeInsert clSVMBinaryTree;
 
+// Zipf exponents of the hash table comparison, 0 is uniform
+static const float hashSkews[HASH_SKEWS] = {0.0f, 0.5f, 0.9f, 0.99f};
+
 int SVMAtomicsBinaryTreeInsert::setupSVMBinaryTree()
 {
   //Ensure that there is atleast 1 node to start with
@@ -172,6 +177,39 @@ int SVMAtomicsBinaryTreeInsert::setupCL(void)
 
   CHECK_ERROR(retValue, SDK_SUCCESS, "clSVMAlloc(svmTreeBuf) failed.");  
 
+  if (hashCompare)
+  {
+    // The hash table kernels are only built with 64-bit atomics
+    hashInsert_kernel = clCreateKernel(program, "hashInsert", &status);
+    if (status != CL_SUCCESS)
+    {
+      std::cout << "Device has no 64-bit atomics, skipping the hash table comparison" << std::endl;
+      hashInsert_kernel = NULL;
+      hashCompare = false;
+      return SDK_SUCCESS;
+    }
+
+    hashLookup_kernel = clCreateKernel(program, "hashLookup", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel::hashLookup failed.");
+
+    hashDelete_kernel = clCreateKernel(program, "hashDelete", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel::hashDelete failed.");
+
+    hashMigrate_kernel = clCreateKernel(program, "hashMigrate", &status);
+    CHECK_OPENCL_ERROR(status, "clCreateKernel::hashMigrate failed.");
+
+    // Read and written by host threads and kernels at the same time
+    flags = CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER;
+    svmKeys = (cl_uint *) clSVMAlloc(context, flags, total_nodes*sizeof(cl_uint), 0);
+    CHECK_ALLOCATION(svmKeys, "clSVMAlloc(svmKeys) failed.");
+
+    svmValues = (cl_uint *) clSVMAlloc(context, flags, total_nodes*sizeof(cl_uint), 0);
+    CHECK_ALLOCATION(svmValues, "clSVMAlloc(svmValues) failed.");
+
+    svmLookup = (cl_uint *) clSVMAlloc(context, flags, total_nodes*sizeof(cl_uint), 0);
+    CHECK_ALLOCATION(svmLookup, "clSVMAlloc(svmLookup) failed.");
+  }
+
   return SDK_SUCCESS;
 }
 
@@ -256,6 +294,277 @@ int SVMAtomicsBinaryTreeInsert::runCLKernels(void)
     return SDK_SUCCESS;
 }
 
+int SVMAtomicsBinaryTreeInsert::enqueueHashKernel(cl_kernel kernel, size_t items)
+{
+    cl_int status;
+
+    status =  kernelInfo.setKernelWorkGroupInfo(kernel,
+	      devices[sampleArgs->deviceId]);
+    CHECK_ERROR(status, SDK_SUCCESS, "setKErnelWorkGroupInfo() failed");
+
+    size_t localThreads = DEFAULT_LOCAL_SIZE;
+    if (localThreads > kernelInfo.kernelWorkGroupSize)
+	localThreads = kernelInfo.kernelWorkGroupSize;
+
+    // Every work-item of a work-group takes part in the counter reductions
+    size_t globalThreads = ((items + localThreads - 1) / localThreads) * localThreads;
+
+    status = clEnqueueNDRangeKernel(
+		 commandQueue,
+		 kernel,
+		 1,
+		 NULL,
+		 &globalThreads,
+		 &localThreads,
+		 0,
+		 NULL,
+		 NULL);
+    CHECK_OPENCL_ERROR(status, "clEnqueueNDRangeKernel failed.");
+
+    status = clFlush(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFlush failed.(commandQueue)");
+
+    return SDK_SUCCESS;
+}
+
+int SVMAtomicsBinaryTreeInsert::resizeHashTable(cl_uint capacity)
+{
+    cl_int status;
+
+    svm_hash_table *bigger = svmHashCreate(context, capacity);
+    CHECK_ALLOCATION(bigger, "svmHashCreate() failed.");
+
+    status = clSetKernelArgSVMPointer(hashMigrate_kernel, 0, (void *)svmHashTable);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(svmHashTable) failed.");
+
+    status = clSetKernelArgSVMPointer(hashMigrate_kernel, 1, (void *)bigger);
+    CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(bigger) failed.");
+
+    if (enqueueHashKernel(hashMigrate_kernel, (size_t)svmHashTable->mask + 1) != SDK_SUCCESS)
+	return SDK_FAILURE;
+
+    status = clFinish(commandQueue);
+    CHECK_OPENCL_ERROR(status, "clFinish failed.(commandQueue)");
+
+    if (bigger->overflow != 0)
+    {
+	std::cout << "Hash table resize to " << capacity << " slots overflowed" << std::endl;
+	svmHashRelease(context, bigger);
+	return SDK_FAILURE;
+    }
+
+    svmHashRelease(context, svmHashTable);
+    svmHashTable = bigger;
+    hashResizes++;
+
+    return SDK_SUCCESS;
+}
+
+int SVMAtomicsBinaryTreeInsert::hashInsertBatch(size_t first, size_t count)
+{
+    cl_int status;
+
+    // Every key of the batch counted as new, duplicates make it an upper bound
+    cl_uint capacity = svmHashGrowCapacity(svmHashTable, (cl_uint)count, hashMaxLoad);
+    if (capacity != 0 && resizeHashTable(capacity) != SDK_SUCCESS)
+	return SDK_FAILURE;
+
+    size_t hostKeys = (size_t)((double)count * ((float)hostCompPercent / 100));
+    size_t deviceKeys = count - hostKeys;
+
+    if (deviceKeys > 0)
+    {
+	cl_uint deviceCount = (cl_uint)deviceKeys;
+
+	status = clSetKernelArgSVMPointer(hashInsert_kernel, 0, (void *)svmHashTable);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(svmHashTable) failed.");
+
+	status = clSetKernelArgSVMPointer(hashInsert_kernel, 1, (void *)(svmKeys + first));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(svmKeys) failed.");
+
+	status = clSetKernelArgSVMPointer(hashInsert_kernel, 2, (void *)(svmValues + first));
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(svmValues) failed.");
+
+	status = clSetKernelArg(hashInsert_kernel, 3, sizeof(cl_uint), &deviceCount);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg(deviceCount) failed.");
+
+	if (enqueueHashKernel(hashInsert_kernel, deviceKeys) != SDK_SUCCESS)
+	    return SDK_FAILURE;
+    }
+
+    // The host threads insert the rest of the batch while the kernel runs
+    if (hostKeys > 0)
+    {
+	size_t hostFirst = first + deviceKeys;
+	long inserted = 0;
+	long overflow = 0;
+
+#pragma omp parallel for reduction(+:inserted,overflow)
+	for (long k = 0; k < (long)hostKeys; k++)
+	{
+	    int result = svmHashInsert(svmHashTable, svmKeys[hostFirst + (size_t)k],
+				       svmValues[hostFirst + (size_t)k]);
+	    if (result > 0)
+		inserted++;
+	    else if (result < 0)
+		overflow++;
+	}
+
+	svmHashAddCounts(svmHashTable, (cl_int)inserted, 0, (cl_uint)overflow);
+    }
+
+    if (deviceKeys > 0)
+    {
+	status = clFinish(commandQueue);
+	CHECK_OPENCL_ERROR(status, "clFinish failed.(commandQueue)");
+    }
+
+    return SDK_SUCCESS;
+}
+
+int SVMAtomicsBinaryTreeInsert::runHashTableComparison()
+{
+    cl_int status;
+    cl_uint count = (cl_uint)total_nodes;
+    size_t half = total_nodes / 2;
+    int timer = sampleTimer->createTimer();
+
+    if (!sampleArgs->quiet)
+    {
+	std::cout << "Comparing the tree with the SVM hash table on " << num_insert
+		  << " keys, max load factor " << hashMaxLoad << std::endl;
+    }
+
+    for (int s = 0; s < HASH_SKEWS; s++)
+    {
+	bool passed = true;
+
+	generateSkewedKeys(svmKeys, total_nodes, localSeed, hashSkews[s]);
+	for (size_t i = 0; i < total_nodes; i++)
+	    svmValues[i] = hashBenchValue(svmKeys[i]);
+
+	/* Tree: the same keys, inserted as in run() */
+	initialize_nodes(svmTreeBuf, total_nodes, localSeed);
+	for (size_t i = 0; i < total_nodes; i++)
+	    svmTreeBuf[i].value = svmKeys[i];
+	svmRoot = cpuMakeBinaryTree(init_tree_insert, svmTreeBuf);
+	currPass = 0;
+
+	sampleTimer->resetTimer(timer);
+	sampleTimer->startTimer(timer);
+
+	if (runCLKernels() != SDK_SUCCESS)
+	    return SDK_FAILURE;
+
+	sampleTimer->stopTimer(timer);
+	bstInsertRate[s] = (double)num_insert / sampleTimer->readTimer(timer);
+
+	// Every node but the root has been linked, count_nodes() could recurse
+	// as deep as the longest run of equal keys
+	for (size_t i = 1; i < total_nodes; i++)
+	    passed = passed && (svmTreeBuf[i].visited == 1);
+
+	/* Hash table: starts small, the initial keys are not timed */
+	svmHashRelease(context, svmHashTable);
+	svmHashTable = svmHashCreate(context, HASH_INITIAL_SLOTS);
+	CHECK_ALLOCATION(svmHashTable, "svmHashCreate() failed.");
+	hashResizes = 0;
+
+	if (hashInsertBatch(0, init_tree_insert) != SDK_SUCCESS)
+	    return SDK_FAILURE;
+
+	sampleTimer->resetTimer(timer);
+	sampleTimer->startTimer(timer);
+
+	for (size_t first = init_tree_insert; first < total_nodes; first += (size_t)hashBatch)
+	{
+	    size_t batch = std::min((size_t)hashBatch, total_nodes - first);
+	    if (hashInsertBatch(first, batch) != SDK_SUCCESS)
+		return SDK_FAILURE;
+	}
+
+	sampleTimer->stopTimer(timer);
+	hashInsertRate[s] = (double)num_insert / sampleTimer->readTimer(timer);
+	hashResizeCount[s] = hashResizes;
+
+	/* Bulk lookup of every key */
+	status = clSetKernelArgSVMPointer(hashLookup_kernel, 0, (void *)svmHashTable);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(svmHashTable) failed.");
+	status = clSetKernelArgSVMPointer(hashLookup_kernel, 1, (void *)svmKeys);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(svmKeys) failed.");
+	status = clSetKernelArgSVMPointer(hashLookup_kernel, 2, (void *)svmLookup);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(svmLookup) failed.");
+	status = clSetKernelArg(hashLookup_kernel, 3, sizeof(cl_uint), &count);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg(count) failed.");
+
+	sampleTimer->resetTimer(timer);
+	sampleTimer->startTimer(timer);
+
+	if (enqueueHashKernel(hashLookup_kernel, total_nodes) != SDK_SUCCESS)
+	    return SDK_FAILURE;
+	status = clFinish(commandQueue);
+	CHECK_OPENCL_ERROR(status, "clFinish failed.(commandQueue)");
+
+	sampleTimer->stopTimer(timer);
+	hashLookupRate[s] = (double)total_nodes / sampleTimer->readTimer(timer);
+
+	passed = passed && (svmHashTable->overflow == 0);
+	for (size_t i = 0; i < total_nodes && passed; i++)
+	    passed = (svmLookup[i] == svmValues[i]);
+
+	/* Bulk delete of the keys of the first half */
+	cl_uint halfCount = (cl_uint)half;
+	status = clSetKernelArgSVMPointer(hashDelete_kernel, 0, (void *)svmHashTable);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(svmHashTable) failed.");
+	status = clSetKernelArgSVMPointer(hashDelete_kernel, 1, (void *)svmKeys);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArgSVMPointer(svmKeys) failed.");
+	status = clSetKernelArg(hashDelete_kernel, 2, sizeof(cl_uint), &halfCount);
+	CHECK_OPENCL_ERROR(status, "clSetKernelArg(halfCount) failed.");
+
+	sampleTimer->resetTimer(timer);
+	sampleTimer->startTimer(timer);
+
+	if (half > 0 && enqueueHashKernel(hashDelete_kernel, half) != SDK_SUCCESS)
+	    return SDK_FAILURE;
+	status = clFinish(commandQueue);
+	CHECK_OPENCL_ERROR(status, "clFinish failed.(commandQueue)");
+
+	sampleTimer->stopTimer(timer);
+	hashDeleteRate[s] = (double)half / sampleTimer->readTimer(timer);
+
+	// A key remains iff it is not in the first half, checked with host lookups
+	std::vector<cl_uint> deleted(svmKeys, svmKeys + half);
+	std::sort(deleted.begin(), deleted.end());
+	std::vector<cl_uint> remaining;
+	for (size_t i = half; i < total_nodes; i++)
+	{
+	    cl_uint key = svmKeys[i];
+	    bool gone = std::binary_search(deleted.begin(), deleted.end(), key);
+	    cl_uint expected = gone ? HASH_NOT_FOUND : svmValues[i];
+	    passed = passed && (svmHashLookup(svmHashTable, key) == expected);
+	    if (!gone)
+		remaining.push_back(key);
+	}
+	for (size_t i = 0; i < half && passed; i++)
+	    passed = (svmHashLookup(svmHashTable, svmKeys[i]) == HASH_NOT_FOUND);
+
+	std::sort(remaining.begin(), remaining.end());
+	size_t distinct = std::unique(remaining.begin(), remaining.end()) - remaining.begin();
+	passed = passed && (svmHashTable->live == (cl_uint)distinct);
+
+	hashPassed[s] = passed;
+
+	if (!sampleArgs->quiet)
+	{
+	    std::cout << "Skew " << hashSkews[s] << " : " << (passed ? "Passed" : "Failed")
+		      << ", " << hashResizes << " resizes, " << svmHashTable->mask + 1
+		      << " slots" << std::endl;
+	}
+    }
+
+    return SDK_SUCCESS;
+}
+
 int SVMAtomicsBinaryTreeInsert::initialize()
 {
   // Call base class Initialize to get default configuration
@@ -316,6 +625,27 @@ int SVMAtomicsBinaryTreeInsert::initialize()
   new_option->_value = &kernelPasses;
   sampleArgs->AddOption(new_option);
 
+  new_option->_sVersion = "";
+  new_option->_lVersion = "hashtable";
+  new_option->_description = "Compare the tree with the SVM hash table at several key skews";
+  new_option->_type = CA_NO_ARGUMENT;
+  new_option->_value = &hashCompare;
+  sampleArgs->AddOption(new_option);
+
+  new_option->_sVersion = "";
+  new_option->_lVersion = "maxload";
+  new_option->_description = "Hash table load factor which triggers a resize (between 0.1 and 0.9)";
+  new_option->_type = CA_ARG_FLOAT;
+  new_option->_value = &hashMaxLoad;
+  sampleArgs->AddOption(new_option);
+
+  new_option->_sVersion = "";
+  new_option->_lVersion = "hashbatch";
+  new_option->_description = "Keys inserted in the hash table between two load factor checks";
+  new_option->_type = CA_ARG_INT;
+  new_option->_value = &hashBatch;
+  sampleArgs->AddOption(new_option);
+
   delete new_option;
   
   return SDK_SUCCESS;
@@ -329,6 +659,12 @@ int SVMAtomicsBinaryTreeInsert::setup()
   {
      return SDK_FAILURE;
   }
+
+  if (hashMaxLoad < 0.1f || hashMaxLoad > 0.9f || hashBatch < 1)
+  {
+     std::cout << "--maxload must be between 0.1 and 0.9 and --hashbatch positive" << std::endl;
+     return SDK_FAILURE;
+  }
   
   int timer = sampleTimer->createTimer();
   sampleTimer->resetTimer(timer);
@@ -349,6 +685,12 @@ int SVMAtomicsBinaryTreeInsert::setup()
 int SVMAtomicsBinaryTreeInsert::run()
 {
     int status = 0;
+
+    // Runs first, the tree below is then rebuilt from the usual random keys
+    if (hashCompare && runHashTableComparison() != SDK_SUCCESS)
+    {
+	return SDK_FAILURE;
+    }
 	
     //create the initial binary tree with init_tree_insert nodes
     status = cpuCreateBinaryTree();
@@ -443,6 +785,34 @@ void SVMAtomicsBinaryTreeInsert::printStats()
         stats[2] = toString(nodesPerSec, std::dec);
 
         printStatistics(strArray, stats, 3);
+
+	if (hashCompare)
+	{
+	    std::string hashArray[7] =
+	    {
+		"Key skew",
+		"Tree inserts/sec",
+		"Hash inserts/sec",
+		"Hash lookups/sec",
+		"Hash deletes/sec",
+		"Hash resizes",
+		"Verified"
+	    };
+	    std::string hashStats[7];
+
+	    for (int s = 0; s < HASH_SKEWS; s++)
+	    {
+		hashStats[0] = toString(hashSkews[s], std::dec);
+		hashStats[1] = toString(bstInsertRate[s], std::dec);
+		hashStats[2] = toString(hashInsertRate[s], std::dec);
+		hashStats[3] = toString(hashLookupRate[s], std::dec);
+		hashStats[4] = toString(hashDeleteRate[s], std::dec);
+		hashStats[5] = toString(hashResizeCount[s], std::dec);
+		hashStats[6] = hashPassed[s] ? "Passed" : "Failed";
+
+		printStatistics(hashArray, hashStats, 7);
+	    }
+	}
     }
 }
 
@@ -631,6 +1001,23 @@ int SVMAtomicsBinaryTreeInsert::cleanup()
 
     clSVMFree(context,svmTreeBuf);
 
+    if (hashInsert_kernel)
+    {
+	svmHashRelease(context, svmHashTable);
+	clSVMFree(context, svmKeys);
+	clSVMFree(context, svmValues);
+	clSVMFree(context, svmLookup);
+
+	status = clReleaseKernel(hashInsert_kernel);
+	CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(hashInsert_kernel)");
+	status = clReleaseKernel(hashLookup_kernel);
+	CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(hashLookup_kernel)");
+	status = clReleaseKernel(hashDelete_kernel);
+	CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(hashDelete_kernel)");
+	status = clReleaseKernel(hashMigrate_kernel);
+	CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(hashMigrate_kernel)");
+    }
+
     status = clReleaseKernel(binTreeInsert_kernel);
     CHECK_OPENCL_ERROR(status, "clReleaseKernel failed.(binTreeInsert_kernel)");
 
@@ -32,9 +32,12 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "CLUtil.hpp"
 
 #include "SVMBinaryNode.h"
+#include "SVMHashTable_Host.hpp"
 
 #define   NUMBER_OF_NODES         1024
 #define   DEFAULT_LOCAL_SIZE      256
+#define   HASH_SKEWS              4       // Key skews of the hash table comparison
+#define   HASH_INITIAL_SLOTS      1024    // Slots of a new hash table, grown by the load factor
 
 using namespace appsdk;
 
@@ -73,6 +76,26 @@ private:
 
   __global node	        *svmTreeBuf;
 
+  /* Hash table comparison */
+  bool			hashCompare;		// Compare the tree with the SVM hash table
+  float			hashMaxLoad;		// Load factor a batch of inserts may not exceed
+  int			hashBatch;		// Keys inserted between two load factor checks
+  cl_kernel             hashInsert_kernel;
+  cl_kernel             hashLookup_kernel;
+  cl_kernel             hashDelete_kernel;
+  cl_kernel             hashMigrate_kernel;
+  svm_hash_table*       svmHashTable;
+  cl_uint*              svmKeys;		// Keys of the current skew, in tree node order
+  cl_uint*              svmValues;		// Value stored for each key
+  cl_uint*              svmLookup;		// Lookup results
+  int			hashResizes;		// Resizes of the current run
+  double		bstInsertRate[HASH_SKEWS];
+  double		hashInsertRate[HASH_SKEWS];
+  double		hashLookupRate[HASH_SKEWS];
+  double		hashDeleteRate[HASH_SKEWS];
+  int			hashResizeCount[HASH_SKEWS];
+  bool			hashPassed[HASH_SKEWS];
+
 public:
   CLCommandArgs*       sampleArgs;   
   int			renderCount;
@@ -107,6 +130,19 @@ public:
     currPass = 0;
     dnodesPerPass = 0;
     hnodesPerPass = 0;
+
+    hashCompare = false;
+    hashMaxLoad = 0.5f;
+    hashBatch = 1 << 20;
+    hashInsert_kernel = NULL;
+    hashLookup_kernel = NULL;
+    hashDelete_kernel = NULL;
+    hashMigrate_kernel = NULL;
+    svmHashTable = NULL;
+    svmKeys = NULL;
+    svmValues = NULL;
+    svmLookup = NULL;
+    hashResizes = 0;
   };
   
   ~SVMAtomicsBinaryTreeInsert()
@@ -276,5 +312,52 @@ public:
  */
   size_t count_nodes(node* root);
 
+  /**
+   *************************************************************************
+   * @fn     runHashTableComparison
+   * @brief  For each key skew inserts the same keys in the tree and in the
+   *         SVM hash table, then looks up all the keys and deletes the
+   *         first half of them in the hash table, and checks the results.
+   *
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure.
+   *************************************************************************
+   */
+  int     runHashTableComparison();
+
+  /**
+   *************************************************************************
+   * @fn     hashInsertBatch
+   * @brief  Inserts svmKeys[first, first + count) in the hash table, the
+   *         device and host threads concurrently with the same split as
+   *         the tree inserts. Resizes the table first when the batch could
+   *         take it above the maximum load factor.
+   *
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure.
+   *************************************************************************
+   */
+  int     hashInsertBatch(size_t first, size_t count);
+
+  /**
+   *************************************************************************
+   * @fn     resizeHashTable
+   * @brief  Moves the live keys into a new table of 'capacity' slots with
+   *         the hashMigrate kernel, dropping the tombstones.
+   *
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure.
+   *************************************************************************
+   */
+  int     resizeHashTable(cl_uint capacity);
+
+  /**
+   *************************************************************************
+   * @fn     enqueueHashKernel
+   * @brief  Enqueues a hash table kernel over 'items' work-items, rounded
+   *         up to whole work-groups, and flushes without waiting.
+   *
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure.
+   *************************************************************************
+   */
+  int     enqueueHashKernel(cl_kernel kernel, size_t items);
+
 };
 #endif
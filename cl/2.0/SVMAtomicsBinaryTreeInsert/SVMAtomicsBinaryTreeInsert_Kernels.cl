@@ -17,6 +17,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #define SVM_DATA_STRUCT_OPENCL_DEVICE
 
 #include "SVMBinaryNode.h"
+#include "SVMHashTable.h"
 
 /*
  * This kernel inserts a node on an BST.
@@ -114,3 +115,188 @@ __kernel void binTreeInsert(
 		
 	}while (!done);
 }
+
+/*
+ * Hash table kernels, see SVMHashTable.h. The slots are 64-bit words and
+ * need the 64-bit atomics, the tree kernel above does not.
+ */
+#if defined(cl_khr_int64_base_atomics) && defined(cl_khr_int64_extended_atomics)
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+#pragma OPENCL EXTENSION cl_khr_int64_extended_atomics : enable
+
+#define HASH_SLOT_ATOMIC(table, slot) ((volatile __global atomic_ulong *)((__global ulong *)((table) + 1) + (slot)))
+#define HASH_COUNTER_ATOMIC(counter)  ((volatile __global atomic_uint *)(counter))
+
+/* 1 when the key is new, 0 when its value was replaced, -1 when the table is full */
+int hashInsertKey(__global svm_hash_table *table, uint key, uint value)
+{
+	uint mask = table->mask;
+	uint slot = hashSlot(key, mask);
+	ulong entry = HASH_ENTRY(key, value);
+
+	for (uint probe = 0; probe <= mask; probe++)
+	{
+		volatile __global atomic_ulong *word = HASH_SLOT_ATOMIC(table, slot);
+		ulong old = atomic_load_explicit(word, memory_order_acquire, memory_scope_all_svm_devices);
+
+		for (;;)
+		{
+			uint found = HASH_ENTRY_KEY(old);
+			if (found != HASH_EMPTY_KEY && found != key)
+				break;		// another key or a tombstone, next slot
+
+			// A failed exchange reloads 'old' with the winner, look at it again
+			if (atomic_compare_exchange_strong_explicit(word, &old, entry,
+					memory_order_acq_rel, memory_order_acquire, memory_scope_all_svm_devices))
+				return (found == HASH_EMPTY_KEY) ? 1 : 0;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+uint hashLookupKey(__global svm_hash_table *table, uint key)
+{
+	uint mask = table->mask;
+	uint slot = hashSlot(key, mask);
+
+	for (uint probe = 0; probe <= mask; probe++)
+	{
+		ulong entry = atomic_load_explicit(HASH_SLOT_ATOMIC(table, slot),
+						   memory_order_acquire, memory_scope_all_svm_devices);
+		uint found = HASH_ENTRY_KEY(entry);
+		if (found == key)
+			return HASH_ENTRY_VALUE(entry);
+		if (found == HASH_EMPTY_KEY)
+			return HASH_NOT_FOUND;
+		slot = (slot + 1) & mask;
+	}
+	return HASH_NOT_FOUND;
+}
+
+/* 1 when the key was deleted, 0 when it was not in the table */
+int hashDeleteKey(__global svm_hash_table *table, uint key)
+{
+	uint mask = table->mask;
+	uint slot = hashSlot(key, mask);
+
+	for (uint probe = 0; probe <= mask; probe++)
+	{
+		volatile __global atomic_ulong *word = HASH_SLOT_ATOMIC(table, slot);
+		ulong old = atomic_load_explicit(word, memory_order_acquire, memory_scope_all_svm_devices);
+
+		for (;;)
+		{
+			uint found = HASH_ENTRY_KEY(old);
+			if (found == HASH_EMPTY_KEY)
+				return 0;
+			if (found != key)
+				break;
+
+			if (atomic_compare_exchange_strong_explicit(word, &old, HASH_ENTRY(HASH_TOMBSTONE_KEY, 0),
+					memory_order_acq_rel, memory_order_acquire, memory_scope_all_svm_devices))
+				return 1;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return 0;
+}
+
+/*
+ * Adds the work-group's totals to the table counters, one atomic per
+ * work-group instead of one per key
+ */
+void hashAddCounts(__global svm_hash_table *table, int inserted, int deleted, uint overflow)
+{
+	int groupInserted = work_group_reduce_add(inserted);
+	int groupDeleted = work_group_reduce_add(deleted);
+	uint groupOverflow = work_group_reduce_add(overflow);
+
+	if (get_local_id(0) == 0)
+	{
+		atomic_fetch_add_explicit(HASH_COUNTER_ATOMIC(&table->used), (uint)groupInserted,
+					  memory_order_relaxed, memory_scope_all_svm_devices);
+		atomic_fetch_add_explicit(HASH_COUNTER_ATOMIC(&table->live), (uint)(groupInserted - groupDeleted),
+					  memory_order_relaxed, memory_scope_all_svm_devices);
+		atomic_fetch_add_explicit(HASH_COUNTER_ATOMIC(&table->overflow), groupOverflow,
+					  memory_order_relaxed, memory_scope_all_svm_devices);
+	}
+}
+
+/*
+ * Bulk kernels. The global size is rounded up to the work-group size so
+ * every work-item reaches the work-group reductions.
+ */
+__kernel void hashInsert(
+			__global svm_hash_table *table,
+			__global const uint *keys,
+			__global const uint *values,
+			const uint count
+			)
+{
+	size_t gidx = get_global_id(0);
+	int inserted = 0;
+	uint overflow = 0;
+
+	if (gidx < count)
+	{
+		int result = hashInsertKey(table, keys[gidx], values[gidx]);
+		inserted = (result > 0) ? 1 : 0;
+		overflow = (result < 0) ? 1 : 0;
+	}
+	hashAddCounts(table, inserted, 0, overflow);
+}
+
+__kernel void hashLookup(
+			__global svm_hash_table *table,
+			__global const uint *keys,
+			__global uint *values,
+			const uint count
+			)
+{
+	size_t gidx = get_global_id(0);
+
+	if (gidx < count)
+		values[gidx] = hashLookupKey(table, keys[gidx]);
+}
+
+__kernel void hashDelete(
+			__global svm_hash_table *table,
+			__global const uint *keys,
+			const uint count
+			)
+{
+	size_t gidx = get_global_id(0);
+	int deleted = 0;
+
+	if (gidx < count)
+		deleted = hashDeleteKey(table, keys[gidx]);
+
+	hashAddCounts(table, 0, deleted, 0);
+}
+
+/* Moves the live keys of 'from' into the bigger 'to', one work-item per slot of 'from' */
+__kernel void hashMigrate(
+			__global svm_hash_table *from,
+			__global svm_hash_table *to
+			)
+{
+	size_t gidx = get_global_id(0);
+	int inserted = 0;
+	uint overflow = 0;
+
+	if (gidx <= from->mask)
+	{
+		ulong entry = *((__global ulong *)(from + 1) + gidx);
+		uint key = HASH_ENTRY_KEY(entry);
+		if (key != HASH_EMPTY_KEY && key != HASH_TOMBSTONE_KEY)
+		{
+			int result = hashInsertKey(to, key, HASH_ENTRY_VALUE(entry));
+			inserted = (result > 0) ? 1 : 0;
+			overflow = (result < 0) ? 1 : 0;
+		}
+	}
+	hashAddCounts(to, inserted, 0, overflow);
+}
+
+#endif
@@ -0,0 +1,77 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef __SVM_HASH_TABLE__
+#define __SVM_HASH_TABLE__
+
+/*
+ * Concurrent hash table in fine-grain SVM, shared by host threads and
+ * kernels. Open addressing with linear probing: every slot is one 64-bit
+ * word holding the key in its high half and the value in its low half, so
+ * a single compare-exchange publishes both and a lookup never sees a half
+ * written entry. Deleting a key leaves a tombstone which keeps the probe
+ * sequences of the other keys intact; tombstones are never reused and are
+ * dropped when the table is resized into a bigger one.
+ *
+ * The table header is followed by its slots in the same allocation.
+ */
+
+#ifndef SVM_DATA_STRUCT_OPENCL_DEVICE
+#include <CL/cl.h>
+typedef cl_uint  hash_uint;
+typedef cl_ulong hash_ulong;
+#else
+typedef uint     hash_uint;
+typedef ulong    hash_ulong;
+#endif
+
+#define HASH_EMPTY_KEY      0u              // Key of a slot never used
+#define HASH_TOMBSTONE_KEY  0xFFFFFFFFu     // Key of a deleted slot
+#define HASH_NOT_FOUND      0xFFFFFFFFu     // Lookup result of a missing key, not a valid value
+
+#define HASH_LINE_UINTS     16              // 64-byte cache line
+
+#define HASH_ENTRY(key, value)  (((hash_ulong)(key) << 32) | (hash_ulong)(value))
+#define HASH_ENTRY_KEY(entry)   ((hash_uint)((entry) >> 32))
+#define HASH_ENTRY_VALUE(entry) ((hash_uint)(entry))
+
+typedef struct
+{
+	hash_uint mask;                         // Number of slots - 1, a power of 2
+	hash_uint pad0[HASH_LINE_UINTS - 1];
+	hash_uint used;                         // Slots holding a key or a tombstone, drives resizing
+	hash_uint pad1[HASH_LINE_UINTS - 1];
+	hash_uint live;                         // Keys in the table
+	hash_uint pad2[HASH_LINE_UINTS - 1];
+	hash_uint overflow;                     // Inserts which found no free slot
+	hash_uint pad3[HASH_LINE_UINTS - 1];
+	/* hash_ulong slots[mask + 1] */
+} svm_hash_table;
+
+/*
+ * First slot of a key, murmur3 finalizer
+ */
+static inline hash_uint hashSlot(hash_uint key, hash_uint mask)
+{
+	key ^= key >> 16;
+	key *= 0x85ebca6bu;
+	key ^= key >> 13;
+	key *= 0xc2b2ae35u;
+	key ^= key >> 16;
+	return key & mask;
+}
+
+#endif //__SVM_HASH_TABLE__
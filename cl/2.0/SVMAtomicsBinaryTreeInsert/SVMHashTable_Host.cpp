@@ -0,0 +1,187 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "SVMHashTable_Host.hpp"
+#include <atomic>
+#include <math.h>
+
+static inline std::atomic<cl_ulong>* slotAtomic(svm_hash_table* table, cl_uint slot)
+{
+	return reinterpret_cast<std::atomic<cl_ulong>*>((cl_ulong*)(table + 1) + slot);
+}
+
+static inline std::atomic<cl_uint>* counterAtomic(cl_uint* counter)
+{
+	return reinterpret_cast<std::atomic<cl_uint>*>(counter);
+}
+
+svm_hash_table* svmHashCreate(cl_context context, cl_uint capacity)
+{
+	cl_uint slots = 1;
+	while (slots < capacity)
+		slots <<= 1;
+
+	svm_hash_table* table = (svm_hash_table*)clSVMAlloc(context,
+			CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER | CL_MEM_SVM_ATOMICS,
+			sizeof(svm_hash_table) + (size_t)slots * sizeof(cl_ulong),
+			HASH_LINE_UINTS * sizeof(cl_uint));
+	if (NULL == table)
+		return NULL;
+
+	table->mask = slots - 1;
+	table->used = 0;
+	table->live = 0;
+	table->overflow = 0;
+
+	cl_ulong* entries = (cl_ulong*)(table + 1);
+	for (cl_uint i = 0; i < slots; i++)
+		entries[i] = HASH_ENTRY(HASH_EMPTY_KEY, 0);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	return table;
+}
+
+void svmHashRelease(cl_context context, svm_hash_table* table)
+{
+	if (NULL != table)
+		clSVMFree(context, table);
+}
+
+int svmHashInsert(svm_hash_table* table, cl_uint key, cl_uint value)
+{
+	cl_uint mask = table->mask;
+	cl_uint slot = hashSlot(key, mask);
+	cl_ulong entry = HASH_ENTRY(key, value);
+
+	for (cl_uint probe = 0; probe <= mask; probe++)
+	{
+		std::atomic<cl_ulong>* word = slotAtomic(table, slot);
+		cl_ulong old = word->load(std::memory_order_acquire);
+
+		for (;;)
+		{
+			cl_uint found = HASH_ENTRY_KEY(old);
+			if (found != HASH_EMPTY_KEY && found != key)
+				break;		// another key or a tombstone, next slot
+
+			// A failed exchange reloads 'old' with the winner, look at it again
+			if (word->compare_exchange_strong(old, entry, std::memory_order_acq_rel,
+							  std::memory_order_acquire))
+				return (found == HASH_EMPTY_KEY) ? 1 : 0;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+cl_uint svmHashLookup(svm_hash_table* table, cl_uint key)
+{
+	cl_uint mask = table->mask;
+	cl_uint slot = hashSlot(key, mask);
+
+	for (cl_uint probe = 0; probe <= mask; probe++)
+	{
+		cl_ulong entry = slotAtomic(table, slot)->load(std::memory_order_acquire);
+		cl_uint found = HASH_ENTRY_KEY(entry);
+		if (found == key)
+			return HASH_ENTRY_VALUE(entry);
+		if (found == HASH_EMPTY_KEY)
+			return HASH_NOT_FOUND;
+		slot = (slot + 1) & mask;
+	}
+	return HASH_NOT_FOUND;
+}
+
+int svmHashDelete(svm_hash_table* table, cl_uint key)
+{
+	cl_uint mask = table->mask;
+	cl_uint slot = hashSlot(key, mask);
+
+	for (cl_uint probe = 0; probe <= mask; probe++)
+	{
+		std::atomic<cl_ulong>* word = slotAtomic(table, slot);
+		cl_ulong old = word->load(std::memory_order_acquire);
+
+		for (;;)
+		{
+			cl_uint found = HASH_ENTRY_KEY(old);
+			if (found == HASH_EMPTY_KEY)
+				return 0;
+			if (found != key)
+				break;
+
+			if (word->compare_exchange_strong(old, HASH_ENTRY(HASH_TOMBSTONE_KEY, 0),
+							  std::memory_order_acq_rel,
+							  std::memory_order_acquire))
+				return 1;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return 0;
+}
+
+void svmHashAddCounts(svm_hash_table* table, cl_int inserted, cl_int deleted, cl_uint overflow)
+{
+	counterAtomic(&table->used)->fetch_add((cl_uint)inserted, std::memory_order_relaxed);
+	counterAtomic(&table->live)->fetch_add((cl_uint)(inserted - deleted), std::memory_order_relaxed);
+	counterAtomic(&table->overflow)->fetch_add(overflow, std::memory_order_relaxed);
+}
+
+cl_uint svmHashGrowCapacity(svm_hash_table* table, cl_uint more, float maxLoad)
+{
+	double slots = (double)table->mask + 1;
+	if ((double)table->used + more <= maxLoad * slots)
+		return 0;
+
+	// Tombstones are dropped by the resize, only the live keys move
+	double needed = ((double)table->live + more) / maxLoad;
+	cl_uint capacity = 1;
+	while (capacity < needed && capacity < 0x80000000u)
+		capacity <<= 1;
+	return capacity;
+}
+
+void generateSkewedKeys(cl_uint* keys, size_t numKeys, int seed, float skew)
+{
+	double ranks = (double)numKeys;
+	double exponent = 1.0 - skew;
+
+	srand(seed);
+	for (size_t i = 0; i < numKeys; i++)
+	{
+		double u = ((double)rand() * ((double)RAND_MAX + 1) + rand()) /
+			   (((double)RAND_MAX + 1) * ((double)RAND_MAX + 1));
+		double rank;
+
+		// Inverse of the continuous Zipf CDF over [1, ranks]
+		if (fabs(exponent) < 1e-6)
+			rank = pow(ranks, u);
+		else
+			rank = pow(u * (pow(ranks, exponent) - 1.0) + 1.0, 1.0 / exponent);
+
+		cl_uint key = (cl_uint)rank;
+
+		// Scatter the ranks over the key space, 31 bits like the tree values
+		key ^= key >> 16;
+		key *= 0x7feb352du;
+		key ^= key >> 15;
+		key *= 0x846ca68bu;
+		key ^= key >> 16;
+		key &= 0x7FFFFFFF;
+
+		keys[i] = (key == HASH_EMPTY_KEY) ? 1 : key;
+	}
+}
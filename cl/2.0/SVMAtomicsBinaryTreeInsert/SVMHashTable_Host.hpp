@@ -0,0 +1,55 @@
+/**********************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+	Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef __SVM_HASH_TABLE_HOST__H
+#define __SVM_HASH_TABLE_HOST__H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "SVMHashTable.h"
+
+/*
+ * Host side of the SVM hash table. Insert, lookup and delete are lock-free
+ * and may run while kernels work on the same table; create, resize and
+ * release may not. Keys HASH_EMPTY_KEY and HASH_TOMBSTONE_KEY and value
+ * HASH_NOT_FOUND are reserved.
+ */
+
+svm_hash_table* svmHashCreate(cl_context context, cl_uint capacity);
+void svmHashRelease(cl_context context, svm_hash_table* table);
+
+// 1 when the key is new, 0 when its value was replaced, -1 when the table is full
+int svmHashInsert(svm_hash_table* table, cl_uint key, cl_uint value);
+cl_uint svmHashLookup(svm_hash_table* table, cl_uint key);
+// 1 when the key was deleted, 0 when it was not in the table
+int svmHashDelete(svm_hash_table* table, cl_uint key);
+
+// Adds what a host batch inserted, deleted or failed to insert to the counters
+void svmHashAddCounts(svm_hash_table* table, cl_int inserted, cl_int deleted, cl_uint overflow);
+
+// Capacity needed to take 'more' new keys without exceeding 'maxLoad', or 0 if the table can take them
+cl_uint svmHashGrowCapacity(svm_hash_table* table, cl_uint more, float maxLoad);
+
+// Keys drawn from a Zipf distribution of exponent 'skew' over 'numKeys' ranks, 0 is uniform
+void generateSkewedKeys(cl_uint* keys, size_t numKeys, int seed, float skew);
+
+// Value the benchmark stores for a key
+static inline cl_uint hashBenchValue(cl_uint key)
+{
+	return (key * 2654435761u) & 0x7FFFFFFF;
+}
+
+#endif